@@ -23,12 +23,12 @@ namespace Ax
 	template< typename T >
 	inline void Construct( T &x )
 	{
-		new( ( void * )&x, Detail::SPlcmntNw() ) T();
+		::new( ( void * )&x, Detail::SPlcmntNw() ) T();
 	}
 	template< typename T >
 	inline void Construct( T &x, const T &y )
 	{
-		new( ( void * )&x, Detail::SPlcmntNw() ) T( y );
+		::new( ( void * )&x, Detail::SPlcmntNw() ) T( y );
 	}
 
 	template< typename T >
@@ -837,8 +837,8 @@ namespace Ax
 		TIntrusiveLink< TElement > *const a = ( TIntrusiveLink< TElement > * )( p );
 		TElement *const b = ( TElement * )( p + sizeof( TIntrusiveLink< TElement > ) );
 
-		new( ( void * )a, Ax::Detail::SPlcmntNw() ) TIntrusiveLink< TElement >( b );
-		new( ( void * )b, Ax::Detail::SPlcmntNw() ) TElement();
+		::new( ( void * )a, Ax::Detail::SPlcmntNw() ) TIntrusiveLink< TElement >( b );
+		::new( ( void * )b, Ax::Detail::SPlcmntNw() ) TElement();
 
 		return a;
 	}
@@ -854,8 +854,8 @@ namespace Ax
 		TIntrusiveLink< TElement > *const a = ( TIntrusiveLink< TElement > * )( p );
 		TElement *const b = ( TElement * )( p + sizeof( TIntrusiveLink< TElement > ) );
 
-		new( ( void * )a, Ax::Detail::SPlcmntNw() ) TIntrusiveLink< TElement >( b );
-		new( ( void * )b, Ax::Detail::SPlcmntNw() ) TElement( element );
+		::new( ( void * )a, Ax::Detail::SPlcmntNw() ) TIntrusiveLink< TElement >( b );
+		::new( ( void * )b, Ax::Detail::SPlcmntNw() ) TElement( element );
 
 		return a;
 	}
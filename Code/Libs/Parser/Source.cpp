@@ -1539,19 +1539,20 @@ namespace Ax { namespace Parser {
 	===========================================================================
 	*/
 
-	CSource::CSource()
+	CSource::CSource( const SMemtag &memtag )
 	: m_Type( ESourceType::Memory )
-	, m_Filename()
+	, m_Filename( memtag )
 	, m_pParent( nullptr )
 	, m_ParentIncludePos( kDefaultPosition )
 	, m_pProcessor( nullptr )
-	, m_ExpandedSources()
-	, m_Text()
+	, m_ExpandedSources( memtag )
+	, m_Text( memtag )
 	, m_Current( 0 )
-	, m_Lines()
-	, m_LineDirectives()
-	, m_Tokens()
+	, m_Lines( memtag )
+	, m_LineDirectives( memtag )
+	, m_Tokens( memtag )
 	, m_CurrentToken( m_Tokens.end() )
+	, m_ProcessedData( memtag )
 	{
 	}
 	CSource::~CSource()
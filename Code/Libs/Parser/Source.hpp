@@ -429,8 +429,8 @@ namespace Ax { namespace Parser {
 	public:
 		static const uintptr		kDefaultPosition = ~uintptr( 0 );
 
-		// Default constructor
-		CSource();
+		// Constructor (the source's text and tokens are allocated with memtag)
+		CSource( const SMemtag &memtag = SMemtag() );
 		// Destructor
 		~CSource();
 
@@ -20,6 +20,9 @@
 #  endif
 # endif
 #endif
+#ifndef PROFILERUNTIME_A
+# define PROFILERUNTIME_A "libclang_rt.profile-x86_64.a"
+#endif
 #ifndef GNU_SYSROOT_DIR
 # define GNU_SYSROOT_DIR "GNU"
 #endif
@@ -41,6 +44,8 @@ namespace Tenshi { namespace Compiler {
 	, m_Obj_CRTBegin()
 	, m_Obj_CRTEnd()
 	, m_Obj_TenshiRuntime()
+	, m_Lib_ProfileRuntime()
+	, m_bProfiling( false )
 	{
 	}
 	MBinutils::~MBinutils()
@@ -208,10 +213,22 @@ namespace Tenshi { namespace Compiler {
 
 		AX_DEBUG_LOG += TENSHIRUNTIME_O ": " + m_Obj_TenshiRuntime;
 
+		// Find LLVM's profile runtime (only needed for instrumented programs)
+		if( GetPath( szBuff, PROFILERUNTIME_A ) && Ax::System::GetModifiedTime( szBuff ) != -1 ) {
+			AX_EXPECT_MEMORY( m_Lib_ProfileRuntime.Assign( szBuff ) );
+
+			AX_DEBUG_LOG += PROFILERUNTIME_A ": " + m_Lib_ProfileRuntime;
+		}
+
 		// Done
 		return true;
 	}
 
+	void MBinutils::SetProfiling( bool bEnabled )
+	{
+		m_bProfiling = bEnabled;
+	}
+
 	int MBinutils::Link( const Ax::String &Output, const Ax::TArray< Ax::String > &InObjects, const SModule::IntrList &InMods ) const
 	{
 		static const Ax::uintptr kExtraReserved = 16;
@@ -253,6 +270,13 @@ namespace Tenshi { namespace Compiler {
 		// Support loading libraries from right next to the executable
 		AX_EXPECT_MEMORY( CommandLine.Append( "-rpath" ) );
 		AX_EXPECT_MEMORY( CommandLine.Append( "@loader_path" ) );
+#endif
+		// Drop every section nothing refers to (the runtime and the program are
+		// built with one section per function and per global)
+#ifdef __APPLE__
+		AX_EXPECT_MEMORY( CommandLine.Append( "-dead_strip" ) );
+#else
+		AX_EXPECT_MEMORY( CommandLine.Append( "--gc-sections" ) );
 #endif
 		AX_EXPECT_MEMORY( CommandLine.Append( m_Obj_CRT2 ) );
 #ifdef _WIN32
@@ -266,6 +290,17 @@ namespace Tenshi { namespace Compiler {
 		}
 		AX_EXPECT_MEMORY( CommandLine.Append( InObjects ) );
 		AX_EXPECT_MEMORY( CommandLine.Append( m_Obj_TenshiRuntime ) );
+		if( m_bProfiling ) {
+			if( m_Lib_ProfileRuntime.IsEmpty() ) {
+				Ax::BasicErrorf( "Could not find \"" PROFILERUNTIME_A "\" to link the profiled program against" );
+				return EXIT_FAILURE;
+			}
+
+			// Nothing in the program refers to the profile writer directly (the
+			// runtime only holds a weak reference to it) so pull it in
+			AX_EXPECT_MEMORY( CommandLine.Append( "--undefined=__llvm_profile_write_file" ) );
+			AX_EXPECT_MEMORY( CommandLine.Append( m_Lib_ProfileRuntime ) );
+		}
 #ifdef _WIN32
 		AX_EXPECT_MEMORY( CommandLine.Append( "-lmingw32" ) );
 		AX_EXPECT_MEMORY( CommandLine.Append( "-lgcc" ) ); //only needed for stack checks
@@ -275,6 +310,7 @@ namespace Tenshi { namespace Compiler {
 #else
 		AX_EXPECT_MEMORY( CommandLine.Append( "-lc" ) );
 		AX_EXPECT_MEMORY( CommandLine.Append( "-lm" ) );
+		AX_EXPECT_MEMORY( CommandLine.Append( "-lpthread" ) ); //PARALLEL FOR workers
 #endif
 
 		// Add modules
@@ -15,6 +15,9 @@ namespace Tenshi { namespace Compiler {
 		bool Init();
 		int Link( const Ax::String &Output, const Ax::TArray< Ax::String > &InObjects, const SModule::IntrList &InMods ) const;
 
+		// Link LLVM's profile runtime into programs (for --profile-generate)
+		void SetProfiling( bool bEnabled );
+
 	private:
 		MBinutils();
 		~MBinutils();
@@ -31,6 +34,8 @@ namespace Tenshi { namespace Compiler {
 		Ax::String					m_Obj_CRTEnd;
 
 		Ax::String					m_Obj_TenshiRuntime;
+		Ax::String					m_Lib_ProfileRuntime;
+		bool						m_bProfiling;
 
 		AX_DELETE_COPYFUNCS(MBinutils);
 	};
@@ -545,6 +545,21 @@ namespace Tenshi { namespace Compiler {
 		return
 			Info.bIsSIMD;
 	}
+	// Check whether a type is a vector, matrix, or quaternion (not SIMD)
+	bool IsVectorOrMatrix( EBuiltinType T )
+	{
+		const SBuiltinTypeInfo &Info = GetBuiltinTypeInfo( T );
+		return
+			!Info.bIsSIMD && Info.cColumns > 1;
+	}
+	// Check whether a type is a float vector (VECTOR2, VECTOR3, or VECTOR4)
+	bool IsFloatVector( EBuiltinType T )
+	{
+		return
+			T == EBuiltinType::Vector2f ||
+			T == EBuiltinType::Vector3f ||
+			T == EBuiltinType::Vector4f;
+	}
 	// Check whether a type is signed
 	bool IsSigned( EBuiltinType T )
 	{
@@ -817,6 +832,16 @@ namespace Tenshi { namespace Compiler {
 			return ECast::None;
 		}
 
+		// Scalars are copied into every component of a vector; anything else
+		// involving vectors or matrices (e.g., VECTOR3 to VECTOR4) has no cast
+		if( IsVectorOrMatrix( FromT ) || IsVectorOrMatrix( ToT ) ) {
+			if( IsFloatVector( ToT ) && IsNumber( FromT ) && !IsVectorOrMatrix( FromT ) && !IsSIMD( FromT ) ) {
+				return ECast::ScalarToVector;
+			}
+
+			return ECast::Invalid;
+		}
+
 		if( ToT == EBuiltinType::Boolean ) {
 			if( IsIntNumber( FromT ) ) {
 				return ECast::IntToBool;
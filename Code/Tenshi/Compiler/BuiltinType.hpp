@@ -171,6 +171,10 @@ namespace Tenshi { namespace Compiler {
 	bool IsRealNumber( EBuiltinType T );
 	// Check whether a type is an SIMD type
 	bool IsSIMD( EBuiltinType T );
+	// Check whether a type is a vector, matrix, or quaternion (not SIMD)
+	bool IsVectorOrMatrix( EBuiltinType T );
+	// Check whether a type is a float vector (VECTOR2, VECTOR3, or VECTOR4)
+	bool IsFloatVector( EBuiltinType T );
 	// Check whether a type is signed
 	bool IsSigned( EBuiltinType T );
 	// Check whether a type is unsigned
@@ -26,8 +26,15 @@ namespace Tenshi { namespace Compiler {
 	, m_pObjFile( nullptr )
 	, m_pAsmFile( nullptr )
 	, m_IntFuncs()
+	, m_IROps()
+	, m_bIRLowered( false )
 	, m_bOptimize( false )
 	, m_bLabelDebugOut( false )
+	, m_bProfileGenerate( false )
+	, m_ProfileUse()
+	, m_cPartitions( 1 )
+	, m_ObjFilename()
+	, m_PartitionObjs()
 	, m_uStringId( 0 )
 	, m_uTypeId( 0 )
 	, m_pRTTITy( nullptr )
@@ -35,8 +42,18 @@ namespace Tenshi { namespace Compiler {
 	, m_pObjFiniFTy( nullptr )
 	, m_pObjCopyFTy( nullptr )
 	, m_pObjMoveFTy( nullptr )
+	, m_pArrayHdrTy( nullptr )
+	, m_pNullArrayHdr( nullptr )
 	, m_LoopPoints()
+	, m_CaseFallthroughs()
+	, m_InductionRanges()
+	, m_ModStates()
+	, m_cParallelRegions( 0 )
+	, m_uParallelBodyId( 0 )
 	{
+		for( llvm::GlobalVariable *&pDesc : m_pVectorTypeDescs ) {
+			pDesc = nullptr;
+		}
 	}
 	MCodeGen::~MCodeGen()
 	{
@@ -56,6 +73,22 @@ namespace Tenshi { namespace Compiler {
 	{
 		m_bLabelDebugOut = bEnabled;
 	}
+	void MCodeGen::SetProfileGenerate( bool bEnabled )
+	{
+		m_bProfileGenerate = bEnabled;
+	}
+	void MCodeGen::SetProfileUse( const char *pszProfileFilename )
+	{
+		AX_EXPECT_MEMORY( m_ProfileUse.Assign( pszProfileFilename ) );
+	}
+	void MCodeGen::SetPartitions( unsigned cPartitions )
+	{
+		m_cPartitions = cPartitions > 0 ? cPartitions : 1;
+	}
+	const Ax::TArray< Ax::String > &MCodeGen::PartitionObjects() const
+	{
+		return m_PartitionObjs;
+	}
 	bool MCodeGen::CanOptimize() const
 	{
 		return m_bOptimize;
@@ -92,15 +125,13 @@ namespace Tenshi { namespace Compiler {
 		//
 		( void )pExprType;
 
-		llvm::Value *const pExprVal = ExprVal.Load();
-
-		llvm::StoreInst *const pStore = m_IRBuilder.CreateStore( pExprVal, DstVar.Translated.pValue, bIsVolatile );
+		llvm::Value *pExprVal = ExprVal.Load();
 
 		if( pExprTypeRef->BuiltinType == EBuiltinType::StringObject ) {
-			RemoveCleanCall( pExprVal );
+			pExprVal = EmitStringOwnership( pExprVal );
 		}
 
-		return pStore;
+		return m_IRBuilder.CreateStore( pExprVal, DstVar.Translated.pValue, bIsVolatile );
 	}
 	llvm::CallInst *MCodeGen::EmitAutoprintCall( llvm::Value *pParm )
 	{
@@ -13,6 +13,96 @@ namespace Tenshi { namespace Compiler {
 
 	typedef Ax::TArray< SMemberInfo >		MemberArray;
 
+	// Flags of TenshiType_s (kTenshiTypeF_ in TenshiRuntime.h)
+	enum ETypeFlags : unsigned
+	{
+		kTypeF_TrivialInit			= 0x01,
+		kTypeF_TrivialFini			= 0x02,
+		kTypeF_TrivialCopy			= 0x04,
+		kTypeF_TrivialMove			= 0x08,
+
+		kTypeF_FullTrivial			= 0x0F
+	};
+	// Key types of teArraySort, and value types of teArrayReduce and
+	// teArrayFind (kTenshiSortKey_ in TenshiRuntime.h)
+	enum ESortKey : unsigned
+	{
+		kSortKey_Int8,
+		kSortKey_Int16,
+		kSortKey_Int32,
+		kSortKey_Int64,
+		kSortKey_UInt8,
+		kSortKey_UInt16,
+		kSortKey_UInt32,
+		kSortKey_UInt64,
+		kSortKey_Float32,
+		kSortKey_Float64,
+		kSortKey_String
+	};
+	// Flags of teArraySort (kTenshiSortF_ in TenshiRuntime.h)
+	enum ESortFlags : unsigned
+	{
+		kSortF_Descending			= 0x01,
+		kSortF_Stable				= 0x02
+	};
+	// Operations of teArrayReduce (kTenshiArrayReduce_ in TenshiRuntime.h)
+	enum EArrayReduce : unsigned
+	{
+		kArrayReduce_Sum,
+		kArrayReduce_Min,
+		kArrayReduce_Max
+	};
+	// Functions of teArrayMath (kTenshiMathBatch_ in TenshiRuntime.h)
+	enum EMathBatch : unsigned
+	{
+		kMathBatch_Sin,
+		kMathBatch_Cos,
+		kMathBatch_Sqrt,
+		kMathBatch_Exp,
+		kMathBatch_Log,
+		kMathBatch_Noise
+	};
+	// Flags of teArrayMath (kTenshiMathBatchF_ in TenshiRuntime.h)
+	enum EMathBatchFlags : unsigned
+	{
+		kMathBatchF_Precise			= 0x01
+	};
+	// Kinds of values of teArrayRandomize (kTenshiRndFill_ in TenshiRuntime.h)
+	enum ERndFill : unsigned
+	{
+		kRndFill_Bits32,
+		kRndFill_Int32,
+		kRndFill_Float32,
+		kRndFill_Float64
+	};
+
+	// Key type of teArraySort for values of the given type (~0U if none)
+	inline unsigned GetSortKey( EBuiltinType Type )
+	{
+		switch( Type )
+		{
+		case EBuiltinType::Int8:			return kSortKey_Int8;
+		case EBuiltinType::Int16:			return kSortKey_Int16;
+		case EBuiltinType::Int32:			return kSortKey_Int32;
+		case EBuiltinType::Int64:			return kSortKey_Int64;
+		case EBuiltinType::Boolean:
+		case EBuiltinType::UInt8:			return kSortKey_UInt8;
+		case EBuiltinType::UInt16:			return kSortKey_UInt16;
+		case EBuiltinType::UInt32:			return kSortKey_UInt32;
+		case EBuiltinType::UInt64:			return kSortKey_UInt64;
+		case EBuiltinType::Float32:			return kSortKey_Float32;
+		case EBuiltinType::Float64:			return kSortKey_Float64;
+		case EBuiltinType::StringObject:	return kSortKey_String;
+		default:
+			break;
+		}
+
+		return ~0U;
+	}
+
+	// Most chunks a PARALLEL FOR is split into (TENSHI_PARALLEL_MAX_CHUNKS)
+	static const unsigned			kMaxParallelChunks = 256;
+
 	inline llvm::StringRef LLVMStr( const char *p, size_t c )
 	{
 		const char *const s = p != nullptr ? p : "";
@@ -45,12 +135,14 @@ namespace Tenshi { namespace Compiler {
 		llvm::Function *			pSafeSync;
 		llvm::Function *			pStrDup;
 		llvm::Function *			pStrConcat;
+		llvm::Function *			pStrAppend;
 		llvm::Function *			pStrFindRm;
 		llvm::Function *			pStrRepeat;
 		llvm::Function *			pStrCatDir;
 		llvm::Function *			pStrReclaim;
 		llvm::Function *			pStrEq;
 		llvm::Function *			pStrCmp;
+		llvm::Function *			pStrHash;
 		llvm::Function *			pCastInt8ToStr;
 		llvm::Function *			pCastInt16ToStr;
 		llvm::Function *			pCastInt32ToStr;
@@ -70,9 +162,43 @@ namespace Tenshi { namespace Compiler {
 		llvm::Function *			pArrayDim;
 		llvm::Function *			pArrayRedim;
 		llvm::Function *			pArrayUndim;
+		llvm::Function *			pArrayCopy;
 
 		llvm::Function *			pArrayGetDimRes;
 		llvm::Function *			pArrayGetCurIdx;
+		llvm::Function *			pArrayIndexError;
+		llvm::Function *			pArraySort;
+		llvm::Function *			pArrayFill;
+		llvm::Function *			pArrayCopyItems;
+		llvm::Function *			pArrayReduce;
+		llvm::Function *			pArrayFind;
+		llvm::Function *			pArrayMath;
+		llvm::Function *			pArrayRandomize;
+
+		llvm::Function *			pParallelChunks;
+		llvm::Function *			pParallelFor;
+		llvm::Function *			pParallelLock;
+		llvm::Function *			pParallelUnlock;
+
+		llvm::Function *			pMapIterFirst;
+		llvm::Function *			pMapIterNext;
+		llvm::Function *			pMapIterIntKey;
+		llvm::Function *			pMapIterStrKey;
+
+		llvm::Function *			pInitModule;
+
+		// What loops count down from (teSyncCountdown); see EmitSyncPoint()
+		llvm::GlobalVariable *		pSyncCountdown;
+	};
+
+	// Operations of the Tenshi IR (see TIR.hpp) that stay abstract until the
+	// module is lowered
+	struct STIROps
+	{
+		// i1 tenshi.sync() -- cooperative sync point; false to stop the loop
+		llvm::Function *			pSync;
+		// void tenshi.bounds.check( i8 *pArrData, uintptr uDim, uintptr uIndex )
+		llvm::Function *			pBoundsCheck;
 	};
 
 	struct SCleanupFunction
@@ -95,6 +221,52 @@ namespace Tenshi { namespace Compiler {
 		llvm::BasicBlock *			pContinueLoop;
 	};
 
+	// A bounds check hoisted into the preheader of a counted loop
+	struct SBoundsGuard
+	{
+		// Array data the guard checks against
+		llvm::Value *				pArrData;
+		// Dimension of the array being checked
+		unsigned					uDim;
+		// True if every value of the iterator is within the dimension
+		llvm::Value *				pGuard;
+		// Checks within the loop the guard makes redundant
+		Ax::TArray< llvm::CallInst * > Checks;
+	};
+	// A counted loop whose iterator only takes values in [first, pLast]
+	struct SInductionRange
+	{
+		// The loop's iterator
+		const SSymbol *				pVar;
+		// Block branching into the loop (where guards are emitted)
+		llvm::BasicBlock *			pPreheader;
+		// Last block of the function before the loop's body was generated
+		llvm::BasicBlock *			pLastBlock;
+		// Blocks of the loop itself (condition, body, and step)
+		llvm::BasicBlock *			pLoopBlocks[ 3 ];
+		// Final value the iterator takes within the loop (as a uintptr)
+		llvm::Value *				pLast;
+		// True if the iterator counts up to pLast from a value of at least 0
+		llvm::Value *				pValid;
+		// Array the loop's end is read from (nullptr if it's constant), and
+		// the value of the array when the loop was entered
+		const SSymbol *				pEndArray;
+		llvm::Value *				pEndArrData;
+		// Guards emitted for this loop
+		Ax::TArray< SBoundsGuard >	Guards;
+	};
+	// State of a module whose init function runs the first time it's used
+	struct SModuleState
+	{
+		// The module
+		const SModule *				pModule;
+		// Nonzero once the runtime has initialized the module
+		llvm::GlobalVariable *		pState;
+		// Last block the state was checked in (checking it again there is
+		// redundant)
+		llvm::BasicBlock *			pCheckedBlock;
+	};
+
 	class MCodeGen
 	{
 	public:
@@ -106,9 +278,16 @@ namespace Tenshi { namespace Compiler {
 
 		void Dump() const;
 
+		llvm::TargetMachine *CreateTargetMachine( const std::string &TripleName ) const;
+
 		bool AddObjOut( llvm::StringRef ObjFilename );
 		bool AddAsmOut( llvm::StringRef AsmFilename );
 
+		// Run the Tenshi IR passes over the module then lower its operations
+		// into LLVM IR (only does anything the first time it's called)
+		void LowerIR();
+		bool IsIRLowered() const;
+
 		bool WriteOutputs();
 		bool WriteIR( llvm::StringRef IRFilename );
 		bool WriteBC( llvm::StringRef BCFilename );
@@ -126,6 +305,10 @@ namespace Tenshi { namespace Compiler {
 		{
 			return m_IRBuilder;
 		}
+		inline const STIROps &IROps() const
+		{
+			return m_IROps;
+		}
 		inline llvm::legacy::FunctionPassManager &FPM()
 		{
 			AX_ASSERT_NOT_NULL( m_pFPM );
@@ -139,6 +322,16 @@ namespace Tenshi { namespace Compiler {
 
 		void SetOptimize( bool bEnabled );
 		void SetLabelDebugLogging( bool bEnabled );
+		// Split the module into this many parts for the backend to work on in
+		// parallel when writing an object file (1 to disable)
+		void SetPartitions( unsigned cPartitions );
+		// Object files written for the parts after the first (the first goes
+		// to the file given to AddObjOut())
+		const Ax::TArray< Ax::String > &PartitionObjects() const;
+		// Instrument the program so running it writes out a profile
+		void SetProfileGenerate( bool bEnabled );
+		// Optimize with the given (merged) profile (empty to disable)
+		void SetProfileUse( const char *pszProfileFilename );
 		bool CanOptimize() const;
 		bool AreLabelsDebugLogged() const;
 
@@ -171,8 +364,11 @@ namespace Tenshi { namespace Compiler {
 		}
 
 		llvm::Value *GetDefaultConstant( EBuiltinType BTy );
+		llvm::Value *EmitConstant( const SConstant &Value );
 		void EmitConstruct( llvm::Value *pStorePtr, const STypeRef &Type );
 		void EmitDestruct( llvm::Value *pStorePtr, const STypeRef &Type );
+		// Replace the (initialized) value at pDstPtr with a copy of pSrcPtr
+		void EmitCopyAssign( llvm::Value *pDstPtr, llvm::Value *pSrcPtr, const STypeRef &Type );
 
 		llvm::Value *EmitCast( ECast CastOp, EBuiltinType DstType, llvm::Value *pSrcVal );
 		llvm::StoreInst *EmitStore( const SSymbol &DstVar, CExpression &Expr );
@@ -199,8 +395,12 @@ namespace Tenshi { namespace Compiler {
 		void CleanTopLevel( llvm::Value *pIgnoreVal = nullptr );
 		// Add a clean-up call to the scope
 		void AddCleanCall( llvm::Function *pFunc, llvm::Value *pArg );
-		// Remove a clean-up call
-		void RemoveCleanCall( llvm::Value *pArg );
+		// Remove a clean-up call (returns false if the value wasn't in the scope)
+		bool RemoveCleanCall( llvm::Value *pArg );
+		// Take ownership of a string for storage (temporaries are moved)
+		llvm::Value *EmitStringOwnership( llvm::Value *pStr );
+		// Assign a string to a variable, reclaiming the variable's old value
+		void EmitStringAssign( SValue &Var, llvm::Value *pStr );
 
 		// Enter a loop
 		bool EnterLoop( llvm::BasicBlock *pBreakLoop, llvm::BasicBlock *pContinueLoop );
@@ -210,6 +410,80 @@ namespace Tenshi { namespace Compiler {
 		void BreakLoop();
 		// Continue a loop
 		void ContinueLoop();
+		// Enter the body of a CASE (pFallthrough is the next CASE's body, if any)
+		bool EnterCase( llvm::BasicBlock *pFallthrough );
+		// Leave the body of a CASE
+		void LeaveCase();
+		// Continue into the next CASE's body
+		void FallthroughCase();
+		// Check whether the current CASE has a CASE following it
+		bool CanFallthroughCase() const;
+		// Find which of the given labels a string is equal to
+		//
+		// Returns the index of the matching label (i32), or -1 if none match.
+		// The string is hashed once, against a perfect hash of the labels
+		// built here, so only one string comparison is made at runtime.
+		llvm::Value *EmitStringDispatch( llvm::Value *pStr, const Ax::TArray< Ax::String > &Labels );
+		// Check whether EXIT can leave the innermost loop (the body of a
+		// PARALLEL FOR enters a loop without a break point)
+		bool CanBreakLoop() const;
+		// Check whether array subscripts get bounds checks
+		bool AreBoundsChecked() const;
+		// Enter a counted loop whose iterator only takes values in [0, pLast]
+		//
+		// pLast and pValid are evaluated in the preheader, and pValid says
+		// whether the iterator really counts up to pLast from a value of at
+		// least 0 (e.g., an empty array's ARRAY COUNT() is -1). If the loop's
+		// end is read from an array, pEndArray is that array; the loop must
+		// not change it.
+		bool EnterInductionRange( const SSymbol &Var, llvm::Value *pLast, llvm::Value *pValid, const SSymbol *pEndArray, llvm::BasicBlock &Preheader, llvm::BasicBlock &LastBlock, llvm::BasicBlock &Cond, llvm::BasicBlock &Body, llvm::BasicBlock &Step );
+		// Leave the current counted loop
+		//
+		// If subscripts within the loop were guarded, the loop is versioned:
+		// the preheader tests every guard once and branches either to the
+		// loop as generated, without the guarded checks, or to a copy of it
+		// that keeps every check. Guards whose assumptions the loop's body
+		// broke (storing to the iterator or passing the array to a call) are
+		// discarded first, leaving their checks in both versions.
+		void LeaveInductionRange( const llvm::Instruction *pStepStore );
+		// Retrieve a hoisted bounds check for indexing an array by the given
+		// variable, or nullptr if that variable is not a known loop iterator
+		llvm::Value *GetBoundsGuard( const SSymbol &IndexVar, llvm::Value *pArrData, unsigned uDim );
+		// Emit a bounds check for a single subscript (pGuard may be nullptr)
+		//
+		// The check itself is a tenshi.bounds.check operation, so checks
+		// made redundant by an earlier one can be found before lowering. A
+		// guarded check is removed from the fast version of its loop.
+		void EmitBoundsCheck( llvm::Value *pArrData, unsigned uDim, llvm::Value *pIndex, llvm::Value *pGuard );
+		// Emit a cooperative sync point at the end of a loop iteration
+		//
+		// Emitted as a tenshi.sync operation; lowering decrements a countdown
+		// local to the function (started from teSyncCountdown) and only calls
+		// into teSafeSync() when it runs out. Branches to Continue unless the
+		// sync callback asked the program to stop, in which case it branches
+		// to Leave. Terminates the current block.
+		void EmitSyncPoint( llvm::BasicBlock &Continue, llvm::BasicBlock &Leave );
+
+		// Create the function the body of a PARALLEL FOR is outlined into
+		//
+		// The function matches TenshiFnParallelBody_t: it takes the loop's
+		// context, the chunk number, and the range of iterations to run.
+		llvm::Function *CreateParallelBody();
+		// Enter the body of a PARALLEL FOR (generated into its own function)
+		//
+		// Within the body no sync points are emitted and calls to functions
+		// that aren't thread-safe are serialized.
+		void EnterParallelRegion();
+		// Leave the body of a PARALLEL FOR
+		void LeaveParallelRegion();
+		// Check whether code is being generated for the body of a PARALLEL FOR
+		bool IsInParallelRegion() const;
+		// Make an outlined body read the values it uses from its caller out
+		// of its context (the first argument)
+		//
+		// OutCaptures receives the values in the order of the returned
+		// context type's fields; the caller stores them into the context.
+		llvm::StructType *CaptureParallelValues( llvm::Function &Body, Ax::TArray< llvm::Value * > &OutCaptures );
 
 		unsigned GetStringId();
 		unsigned GetTypeId();
@@ -220,11 +494,56 @@ namespace Tenshi { namespace Compiler {
 		llvm::FunctionType *GetObjCopyFnTy();
 		llvm::FunctionType *GetObjMoveFnTy();
 
-		void RegisterUDT( STypeInfo &UDT );
+		// Layout of TenshiArray_s (the header preceding all array data)
+		llvm::StructType *GetArrayHeaderType();
+		// Retrieve a pointer to the header of the given array data
+		//
+		// A null array yields a shared zeroed header, so reads through it
+		// behave like the runtime's null checks without any branching.
+		llvm::Value *EmitArrayHeader( llvm::Value *pArrData );
+		// Number of elements in the given dimension (0 if out of range)
+		llvm::Value *EmitArrayDimensionLen( llvm::Value *pArrData, unsigned uDim );
+		// Total number of elements in the array
+		llvm::Value *EmitArrayLen( llvm::Value *pArrData );
+		// The array's current index (as set by the ARRAY INDEX commands)
+		llvm::Value *EmitArrayCurrentIndex( llvm::Value *pArrData );
 
+		void RegisterUDT( STypeInfo &UDT );
+		// Assign the column of each field for a structure-of-arrays type
+		void LayoutColumns( STypeInfo &UDT );
+		// Generate the type description used for arrays of the type
+		void EmitTypeDescriptor( STypeInfo &UDT );
+		// Retrieve the type description for arrays of VECTOR2/3/4 or MATRIX4
+		// (nullptr for any other type)
+		llvm::Constant *GetBuiltinTypeDescriptor( EBuiltinType BTy );
+
+		// Check whether a function's calls are generated inline (e.g., DOT on
+		// vectors) rather than calling into the runtime
+		bool IsIntrinsic( const SFunctionOverload &Func ) const;
+		// Generate the inline code for a call to an intrinsic function
+		llvm::Value *EmitIntrinsic( const SFunctionOverload &Func, llvm::ArrayRef< llvm::Value * > Args );
+		// Multiply a MATRIX4 by another MATRIX4 or by a VECTOR4
+		llvm::Value *EmitMatrixMultiply( llvm::Value *pMat, llvm::Value *pRHS );
+
+		// Make sure a module has been initialized before calling into it
+		void EmitModuleInit( const SModule &Mod );
 		void EmitModuleInfo();
 
 	private:
+		// Give the module's internal symbols names no other unit will have
+		void MakeLocalsUnique();
+		// Write the object file as several parts built in parallel
+		bool EmitPartitions();
+		// Expand Tenshi IR operations into the code implementing them
+		llvm::AllocaInst *EmitSyncCountdown( llvm::Function &Func );
+		llvm::Value *EmitSafeSyncCall( llvm::AllocaInst &Countdown );
+		void ShareSyncCountdown( llvm::Function &Func, llvm::AllocaInst &Countdown );
+		void LowerSyncPoint( llvm::CallInst &Op, llvm::AllocaInst &Countdown );
+		void LowerBoundsCheck( llvm::CallInst &Op );
+
+		// Number of built-in types with array descriptors (see GetBuiltinTypeDescriptor)
+		static const unsigned		kNumVectorTypeDescs = 4;
+
 		llvm::LLVMContext			m_Context;
 		llvm::PassRegistry *		m_pPassReg;
 		llvm::Module *				m_pModule;
@@ -239,9 +558,16 @@ namespace Tenshi { namespace Compiler {
 		llvm::tool_output_file *	m_pObjFile;
 		llvm::tool_output_file *	m_pAsmFile;
 		SInternalFunctions			m_IntFuncs;
+		STIROps						m_IROps;
+		bool						m_bIRLowered;
 		Ax::TArray<SCleanupScope>	m_CleanScopes;
 		bool						m_bOptimize;
 		bool						m_bLabelDebugOut;
+		bool						m_bProfileGenerate;
+		Ax::String					m_ProfileUse;
+		unsigned					m_cPartitions;
+		Ax::String					m_ObjFilename;
+		Ax::TArray< Ax::String >	m_PartitionObjs;
 		unsigned					m_uStringId;
 		unsigned					m_uTypeId;
 		llvm::Type *				m_pRTTITy;
@@ -249,8 +575,18 @@ namespace Tenshi { namespace Compiler {
 		llvm::FunctionType *		m_pObjFiniFTy;
 		llvm::FunctionType *		m_pObjCopyFTy;
 		llvm::FunctionType *		m_pObjMoveFTy;
+		llvm::StructType *			m_pArrayHdrTy;
+		llvm::GlobalVariable *		m_pNullArrayHdr;
+		llvm::GlobalVariable *		m_pVectorTypeDescs[ kNumVectorTypeDescs ];
 		Ax::TArray< STypeInfo * >	m_UserTypes;
 		Ax::TArray< SLoopPoints >	m_LoopPoints;
+		Ax::TArray< llvm::BasicBlock * > m_CaseFallthroughs;
+		Ax::TArray< SInductionRange > m_InductionRanges;
+		Ax::TArray< SModuleState >	m_ModStates;
+		unsigned					m_cParallelRegions;
+		unsigned					m_uParallelBodyId;
+
+		llvm::GlobalVariable *CreateTypeDescriptor( const Ax::String &Name, const Ax::String &Pattern, unsigned uFlags, llvm::Constant *pTySize, llvm::Function *pInitFn, llvm::Function *pFiniFn, llvm::Function *pCopyFn, llvm::Function *pMoveFn );
 
 		MCodeGen();
 		~MCodeGen();
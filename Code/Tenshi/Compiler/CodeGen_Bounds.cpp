@@ -0,0 +1,443 @@
+#include "_PCH.hpp"
+#include "CodeGen.hpp"
+#include "Environment.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	using namespace Ax;
+
+	typedef llvm::SmallPtrSet< const llvm::BasicBlock *, 32 > BlockSet;
+
+	// Gather every block belonging to the loop of the given range
+	//
+	// The loop's body is generated after its own blocks are created, so
+	// everything following the last block at that point is part of the loop.
+	// (Loops declaring labels never enter an induction range, so no earlier
+	// block can be jumped into.)
+	static void GetLoopBlocks( const SInductionRange &Range, BlockSet &OutBlocks )
+	{
+		for( const llvm::BasicBlock *pBlock : Range.pLoopBlocks ) {
+			OutBlocks.insert( pBlock );
+		}
+
+		llvm::Function *const pFunc = Range.pLastBlock->getParent();
+		AX_ASSERT_NOT_NULL( pFunc );
+
+		llvm::Function::iterator Iter = Range.pLastBlock->getIterator();
+		for( ++Iter; Iter != pFunc->end(); ++Iter ) {
+			OutBlocks.insert( &*Iter );
+		}
+	}
+	// Check whether anything in the loop might write to the given variable
+	static bool IsVarWrittenInLoop( llvm::Value *pStorage, const BlockSet &Blocks, const llvm::Instruction *pIgnore )
+	{
+		AX_ASSERT_NOT_NULL( pStorage );
+
+		for( const llvm::User *pUser : pStorage->users() ) {
+			const llvm::Instruction *const pInst = llvm::dyn_cast< llvm::Instruction >( pUser );
+			if( !pInst ) {
+				// Constant expressions (e.g., a cast of a global) can't be tracked
+				return true;
+			}
+
+			if( pInst == pIgnore || !Blocks.count( pInst->getParent() ) ) {
+				continue;
+			}
+
+			// Anything other than a plain load either writes or lets the
+			// address escape
+			if( !llvm::isa< llvm::LoadInst >( pInst ) ) {
+				return true;
+			}
+		}
+
+		// Any function called from the loop could write to a global
+		if( llvm::isa< llvm::GlobalValue >( pStorage ) ) {
+			for( const llvm::BasicBlock *pBlock : Blocks ) {
+				for( const llvm::Instruction &Inst : *pBlock ) {
+					if( llvm::isa< llvm::CallInst >( Inst ) && !llvm::isa< llvm::IntrinsicInst >( Inst ) ) {
+						return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+	// Check whether a call only reads the array it's given (bounds checks)
+	static bool IsReadOnlyCall( const llvm::CallInst &Call, const STIROps &Ops )
+	{
+		const llvm::Function *const pCallee = Call.getCalledFunction();
+		if( !pCallee ) {
+			return false;
+		}
+
+		return pCallee == Ops.pBoundsCheck || pCallee == CG->InternalFuncs().pArrayIndexError;
+	}
+	// Check whether the loop might resize the given array in-place
+	static bool IsArrayChangedInLoop( const llvm::Value *pArrData, const BlockSet &Blocks, const STIROps &Ops )
+	{
+		AX_ASSERT_NOT_NULL( pArrData );
+
+		for( const llvm::User *pUser : pArrData->users() ) {
+			const llvm::Instruction *const pInst = llvm::dyn_cast< llvm::Instruction >( pUser );
+			if( !pInst ) {
+				continue;
+			}
+
+			// Follow casts of the array (as done for subscripts)
+			if( llvm::isa< llvm::CastInst >( pInst ) ) {
+				if( IsArrayChangedInLoop( pInst, Blocks, Ops ) ) {
+					return true;
+				}
+
+				continue;
+			}
+
+			if( !Blocks.count( pInst->getParent() ) ) {
+				continue;
+			}
+
+			// Handing the array to a function lets it modify the header
+			if( llvm::isa< llvm::CallInst >( pInst ) ) {
+				if( IsReadOnlyCall( *llvm::cast< llvm::CallInst >( pInst ), Ops ) ) {
+					continue;
+				}
+
+				return true;
+			}
+
+			// Storing the array somewhere lets anything else modify it
+			if( llvm::isa< llvm::StoreInst >( pInst ) && llvm::cast< llvm::StoreInst >( pInst )->getValueOperand() == pArrData ) {
+				return true;
+			}
+		}
+
+		// Any function called from the loop could redimension a global array
+		if( llvm::isa< llvm::GlobalValue >( pArrData ) ) {
+			for( const llvm::BasicBlock *pBlock : Blocks ) {
+				for( const llvm::Instruction &Inst : *pBlock ) {
+					const llvm::CallInst *const pCall = llvm::dyn_cast< llvm::CallInst >( &Inst );
+					if( pCall != nullptr && !llvm::isa< llvm::IntrinsicInst >( pCall ) && pCall->getCalledFunction() != Ops.pSync && !IsReadOnlyCall( *pCall, Ops ) ) {
+						return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+	// Check whether the loop can be copied as a whole
+	//
+	// Everything the loop computes has to stay within it (the code generator
+	// keeps variables in memory, so only a clean-up registered outside of the
+	// loop's statements would refer to one of its values), and copies of very
+	// large loops aren't worth their size.
+	static bool CanVersionLoop( const BlockSet &Blocks, const Ax::TArray< SCleanupScope > &Scopes )
+	{
+		static const unsigned kMaxVersionedInsts = 4096;
+
+		unsigned cInsts = 0;
+		for( const llvm::BasicBlock *pBlock : Blocks ) {
+			for( const llvm::Instruction &Inst : *pBlock ) {
+				for( const llvm::User *pUser : Inst.users() ) {
+					const llvm::Instruction *const pUserInst = llvm::dyn_cast< llvm::Instruction >( pUser );
+					if( !pUserInst || !Blocks.count( pUserInst->getParent() ) ) {
+						return false;
+					}
+				}
+
+				if( ++cInsts > kMaxVersionedInsts ) {
+					return false;
+				}
+			}
+		}
+
+		for( const SCleanupScope &Scope : Scopes ) {
+			for( const SCleanupFunction &Func : Scope.Funcs ) {
+				const llvm::Instruction *const pInst = llvm::dyn_cast_or_null< llvm::Instruction >( Func.pValue );
+				if( pInst != nullptr && Blocks.count( pInst->getParent() ) ) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool MCodeGen::AreBoundsChecked() const
+	{
+		return g_Env->BuildInfo().SafetyCode != ESafetyCode::Off;
+	}
+
+	bool MCodeGen::EnterInductionRange( const SSymbol &Var, llvm::Value *pLast, llvm::Value *pValid, const SSymbol *pEndArray, llvm::BasicBlock &Preheader, llvm::BasicBlock &LastBlock, llvm::BasicBlock &Cond, llvm::BasicBlock &Body, llvm::BasicBlock &Step )
+	{
+		AX_ASSERT_NOT_NULL( pLast );
+		AX_ASSERT_NOT_NULL( pValid );
+
+		if( !m_InductionRanges.Append() ) {
+			return false;
+		}
+
+		SInductionRange &Range = m_InductionRanges.Last();
+
+		Range.pVar = &Var;
+		Range.pPreheader = &Preheader;
+		Range.pLastBlock = &LastBlock;
+		Range.pLoopBlocks[ 0 ] = &Cond;
+		Range.pLoopBlocks[ 1 ] = &Body;
+		Range.pLoopBlocks[ 2 ] = &Step;
+		Range.pLast = pLast;
+		Range.pValid = pValid;
+		Range.pEndArray = pEndArray;
+		Range.pEndArrData = pEndArray != nullptr ? pEndArray->Translated.pValue : nullptr;
+		Range.Guards.Clear();
+
+		return true;
+	}
+	void MCodeGen::LeaveInductionRange( const llvm::Instruction *pStepStore )
+	{
+		AX_ASSERT_MSG( m_InductionRanges.IsEmpty() == false, "Not in a counted loop!" );
+
+		SInductionRange &Range = m_InductionRanges.Last();
+		AX_ASSERT_NOT_NULL( Range.pVar );
+
+		// Whatever isn't used by the end is deleted again
+		llvm::SmallVector< llvm::WeakVH, 8 > Unused;
+		Unused.push_back( Range.pLast );
+		Unused.push_back( Range.pValid );
+
+		BlockSet Blocks;
+		llvm::Value *pAllGuards = nullptr;
+
+		if( !Range.Guards.IsEmpty() ) {
+			GetLoopBlocks( Range, Blocks );
+
+			// The loop's end is evaluated again on each iteration, so an array
+			// it's read from has to stay as it was
+			const bool bEndChanged =
+				Range.pEndArray != nullptr &&
+				( Range.pEndArray->Translated.pValue != Range.pEndArrData || IsArrayChangedInLoop( Range.pEndArrData, Blocks, m_IROps ) );
+
+			const llvm::BranchInst *const pEntry = llvm::dyn_cast_or_null< llvm::BranchInst >( Range.pPreheader->getTerminator() );
+			const bool bCanVersion =
+				pEntry != nullptr &&
+				pEntry->isUnconditional() &&
+				pEntry->getSuccessor( 0 ) == Range.pLoopBlocks[ 0 ] &&
+				CanVersionLoop( Blocks, m_CleanScopes );
+
+			const bool bBroken = bEndChanged || !bCanVersion || IsVarWrittenInLoop( Range.pVar->Translated.pValue, Blocks, pStepStore );
+
+			llvm::IRBuilderBase::InsertPointGuard SavedIP( m_IRBuilder );
+			if( pEntry != nullptr ) {
+				m_IRBuilder.SetInsertPoint( Range.pPreheader->getTerminator() );
+			}
+
+			// A broken guard leaves its checks in place
+			for( SBoundsGuard &Guard : Range.Guards ) {
+				Unused.push_back( Guard.pGuard );
+
+				if( bBroken || IsArrayChangedInLoop( Guard.pArrData, Blocks, m_IROps ) ) {
+					Guard.Checks.Clear();
+					continue;
+				}
+
+				pAllGuards = pAllGuards != nullptr ? m_IRBuilder.CreateAnd( pAllGuards, Guard.pGuard, "bounds.guards" ) : Guard.pGuard;
+			}
+		}
+
+		const llvm::ConstantInt *const pConstGuards = llvm::dyn_cast_or_null< llvm::ConstantInt >( pAllGuards );
+		const bool bVersion = pAllGuards != nullptr && !pConstGuards;
+		const bool bDropChecks = bVersion || ( pConstGuards != nullptr && pConstGuards->isOne() );
+
+		if( bVersion ) {
+			llvm::Function *const pFunc = Range.pPreheader->getParent();
+			AX_ASSERT_NOT_NULL( pFunc );
+
+			// Copy the loop (keeping its blocks in order) to get the version
+			// with every check
+			llvm::ValueToValueMapTy Map;
+			llvm::SmallVector< llvm::BasicBlock *, 32 > Originals;
+			llvm::SmallVector< llvm::BasicBlock *, 32 > Clones;
+
+			for( llvm::BasicBlock &Block : *pFunc ) {
+				if( Blocks.count( &Block ) ) {
+					Originals.push_back( &Block );
+				}
+			}
+			for( llvm::BasicBlock *pBlock : Originals ) {
+				llvm::BasicBlock *const pClone = llvm::CloneBasicBlock( pBlock, Map, ".checked" );
+				AX_EXPECT_MEMORY( pClone );
+
+				Map[ pBlock ] = pClone;
+				Clones.push_back( pClone );
+			}
+			for( size_t i = 0; i < Clones.size(); ++i ) {
+				llvm::BasicBlock *const pClone = Clones[ i ];
+				pFunc->getBasicBlockList().push_back( pClone );
+
+				for( llvm::Instruction &Inst : *pClone ) {
+					llvm::RemapInstruction( &Inst, Map, llvm::RF_NoModuleLevelChanges | llvm::RF_IgnoreMissingLocals );
+				}
+
+				// Blocks the loop leaves to are now entered from the copy too
+				for( llvm::BasicBlock *pSucc : llvm::successors( pClone ) ) {
+					if( Blocks.count( pSucc ) ) {
+						continue;
+					}
+
+					for( llvm::Instruction &Inst : *pSucc ) {
+						llvm::PHINode *const pPhi = llvm::dyn_cast< llvm::PHINode >( &Inst );
+						if( !pPhi ) {
+							break;
+						}
+
+						const int iIncoming = pPhi->getBasicBlockIndex( Originals[ i ] );
+						if( iIncoming < 0 ) {
+							continue;
+						}
+
+						llvm::Value *const pValue = pPhi->getIncomingValue( ( unsigned )iIncoming );
+						llvm::Value *const pMapped = Map.lookup( pValue );
+
+						pPhi->addIncoming( pMapped != nullptr ? pMapped : pValue, pClone );
+					}
+				}
+			}
+
+			// Test every guard once, on the way into the loop
+			llvm::BranchInst *const pEntry = llvm::cast< llvm::BranchInst >( Range.pPreheader->getTerminator() );
+			llvm::BasicBlock *const pCheckedEntry = llvm::cast< llvm::BasicBlock >( Map.lookup( Range.pLoopBlocks[ 0 ] ) );
+
+			llvm::IRBuilderBase::InsertPointGuard SavedIP( m_IRBuilder );
+			m_IRBuilder.SetInsertPoint( pEntry );
+			m_IRBuilder.CreateCondBr( pAllGuards, Range.pLoopBlocks[ 0 ], pCheckedEntry, llvm::MDBuilder( m_Context ).createBranchWeights( 1023, 1 ) );
+			pEntry->eraseFromParent();
+
+			// Checks an enclosing loop guards are now in the copy as well
+			for( uintptr i = m_InductionRanges.Num() - 1; i > 0; --i ) {
+				for( SBoundsGuard &Guard : m_InductionRanges[ i - 1 ].Guards ) {
+					const uintptr cChecks = Guard.Checks.Num();
+					for( uintptr j = 0; j < cChecks; ++j ) {
+						llvm::Value *const pCopy = Map.lookup( Guard.Checks[ j ] );
+						if( pCopy != nullptr ) {
+							AX_EXPECT_MEMORY( Guard.Checks.Append( llvm::cast< llvm::CallInst >( pCopy ) ) );
+						}
+					}
+				}
+			}
+		}
+
+		// The loop as generated only runs once every guard has passed
+		if( bDropChecks ) {
+			for( SBoundsGuard &Guard : Range.Guards ) {
+				for( llvm::CallInst *pCheck : Guard.Checks ) {
+					pCheck->eraseFromParent();
+				}
+			}
+		}
+
+		for( llvm::WeakVH &Dead : Unused ) {
+			if( Dead != nullptr ) {
+				llvm::RecursivelyDeleteTriviallyDeadInstructions( Dead );
+			}
+		}
+
+		m_InductionRanges.RemoveLast();
+	}
+	llvm::Value *MCodeGen::GetBoundsGuard( const SSymbol &IndexVar, llvm::Value *pArrData, unsigned uDim )
+	{
+		AX_ASSERT_NOT_NULL( pArrData );
+
+		if( g_Env->BuildInfo().SafetyCode == ESafetyCode::Full ) {
+			return nullptr;
+		}
+
+		for( uintptr i = m_InductionRanges.Num(); i > 0; --i ) {
+			SInductionRange &Range = m_InductionRanges[ i - 1 ];
+			if( Range.pVar != &IndexVar ) {
+				continue;
+			}
+
+			// A guard can't be hoisted out of the body of a PARALLEL FOR
+			if( Range.pPreheader->getParent() != m_pCurrentFunc ) {
+				return nullptr;
+			}
+
+			for( const SBoundsGuard &Guard : Range.Guards ) {
+				if( Guard.pArrData == pArrData && Guard.uDim == uDim ) {
+					return Guard.pGuard;
+				}
+			}
+
+			// The array has to exist before the loop for the guard to see it
+			if( llvm::isa< llvm::Instruction >( pArrData ) ) {
+				BlockSet Blocks;
+				GetLoopBlocks( Range, Blocks );
+
+				if( Blocks.count( llvm::cast< llvm::Instruction >( pArrData )->getParent() ) ) {
+					return nullptr;
+				}
+			}
+
+			llvm::Instruction *const pTerm = Range.pPreheader->getTerminator();
+			if( !pTerm ) {
+				return nullptr;
+			}
+
+			llvm::IRBuilderBase::InsertPointGuard SavedIP( m_IRBuilder );
+			m_IRBuilder.SetInsertPoint( pTerm );
+
+			// Subscripts are cast the same way as the iterator's last value
+			llvm::Value *const pDimLen = EmitArrayDimensionLen( pArrData, uDim );
+			llvm::Value *pGuard = m_IRBuilder.CreateICmpUGT( pDimLen, Range.pLast, "bounds.guard" );
+
+			const llvm::ConstantInt *const pConstValid = llvm::dyn_cast< llvm::ConstantInt >( Range.pValid );
+			if( !pConstValid || !pConstValid->isOne() ) {
+				pGuard = m_IRBuilder.CreateAnd( Range.pValid, pGuard, "bounds.guard" );
+			}
+
+			AX_EXPECT_MEMORY( Range.Guards.Append() );
+			SBoundsGuard &Guard = Range.Guards.Last();
+
+			Guard.pArrData = pArrData;
+			Guard.uDim = uDim;
+			Guard.pGuard = pGuard;
+			Guard.Checks.Clear();
+
+			return pGuard;
+		}
+
+		return nullptr;
+	}
+	void MCodeGen::EmitBoundsCheck( llvm::Value *pArrData, unsigned uDim, llvm::Value *pIndex, llvm::Value *pGuard )
+	{
+		AX_ASSERT_NOT_NULL( pArrData );
+		AX_ASSERT_NOT_NULL( pIndex );
+		AX_ASSERT_NOT_NULL( m_IROps.pBoundsCheck );
+
+		llvm::Value *const pArgs[] = {
+			m_IRBuilder.CreatePointerCast( pArrData, m_IRBuilder.getInt8PtrTy() ),
+			llvm::ConstantInt::get( pIndex->getType(), uDim ),
+			pIndex
+		};
+
+		// Expanded into the compare and the call to teArrayIndexError() by
+		// LowerBoundsCheck()
+		llvm::CallInst *const pCheck = m_IRBuilder.CreateCall( m_IROps.pBoundsCheck, pArgs );
+
+		// The guard covers the check within the version of the loop that
+		// runs once it passes (see LeaveInductionRange())
+		if( pGuard != nullptr ) {
+			for( uintptr i = m_InductionRanges.Num(); i > 0; --i ) {
+				for( SBoundsGuard &Guard : m_InductionRanges[ i - 1 ].Guards ) {
+					if( Guard.pGuard == pGuard ) {
+						AX_EXPECT_MEMORY( Guard.Checks.Append( pCheck ) );
+						return;
+					}
+				}
+			}
+		}
+	}
+
+}}
@@ -116,6 +116,28 @@ namespace Tenshi { namespace Compiler {
 			AX_ASSERT_NOT_NULL( m_IntFuncs.pCastUTF16PtrToStr );
 			pInst = m_IRBuilder.CreateCall( m_IntFuncs.pCastUTF16PtrToStr, pSrcVal, "utfwstrtmp" );
 			break;
+
+		case ECast::ScalarToVector:
+			{
+				AX_ASSERT( pDstType->isVectorTy() );
+
+				llvm::Type *const pElemTy = pDstType->getVectorElementType();
+				llvm::Value *pElem = pSrcVal;
+
+				//
+				//	FIXME: The source's signedness isn't known here, so integers
+				//	-      are always converted as signed (except for booleans)
+				//
+				if( pSrcVal->getType()->isIntegerTy( 1 ) ) {
+					pElem = m_IRBuilder.CreateUIToFP( pSrcVal, pElemTy, "booltofloattmp" );
+				} else if( pSrcVal->getType()->isIntegerTy() ) {
+					pElem = m_IRBuilder.CreateSIToFP( pSrcVal, pElemTy, "sinttofloattmp" );
+				} else {
+					pElem = m_IRBuilder.CreateFPCast( pSrcVal, pElemTy, "realcasttmp" );
+				}
+
+				return m_IRBuilder.CreateVectorSplat( pDstType->getVectorNumElements(), pElem, "splattmp" );
+			}
 		}
 
 		AX_ASSERT_NOT_NULL( pInst );
@@ -75,10 +75,10 @@ namespace Tenshi { namespace Compiler {
 		CleanFunc.pFunction = pFunc;
 		CleanFunc.pValue = pArg;
 	}
-	void MCodeGen::RemoveCleanCall( llvm::Value *pArg )
+	bool MCodeGen::RemoveCleanCall( llvm::Value *pArg )
 	{
 		if( m_CleanScopes.IsEmpty() ) {
-			return;
+			return false;
 		}
 
 		SCleanupScope &Scope = m_CleanScopes.Last();
@@ -91,9 +91,38 @@ namespace Tenshi { namespace Compiler {
 
 			if( CleanFunc.pValue == pArg ) {
 				Scope.Funcs.Remove( i );
-				break;
+				return true;
 			}
 		}
+
+		return false;
+	}
+
+	llvm::Value *MCodeGen::EmitStringOwnership( llvm::Value *pStr )
+	{
+		AX_ASSERT_NOT_NULL( pStr );
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pStrDup );
+
+		// A temporary of this statement isn't referenced by anything else, so
+		// its storage can be moved in as-is
+		if( RemoveCleanCall( pStr ) ) {
+			return pStr;
+		}
+
+		// Otherwise the string belongs to something else (e.g., a variable)
+		return m_IRBuilder.CreateCall( m_IntFuncs.pStrDup, pStr, "strcopytmp" );
+	}
+	void MCodeGen::EmitStringAssign( SValue &Var, llvm::Value *pStr )
+	{
+		AX_ASSERT( Var == SValue::kLValue );
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pStrReclaim );
+
+		llvm::Value *const pNewStr = EmitStringOwnership( pStr );
+		llvm::Value *const pOldStr = Var.Load();
+
+		Var.Store( pNewStr );
+
+		m_IRBuilder.CreateCall( m_IntFuncs.pStrReclaim, pOldStr );
 	}
 
 }}
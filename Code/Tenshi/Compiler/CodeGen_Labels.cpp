@@ -124,5 +124,52 @@ namespace Tenshi { namespace Compiler {
 
 		m_IRBuilder.CreateBr( m_LoopPoints.Last().pContinueLoop );
 	}
+	// Enter a case
+	bool MCodeGen::EnterCase( llvm::BasicBlock *pFallthrough )
+	{
+		return m_CaseFallthroughs.Append( pFallthrough );
+	}
+	// Leave a case
+	void MCodeGen::LeaveCase()
+	{
+		AX_ASSERT_MSG( m_CaseFallthroughs.IsEmpty() == false, "Not in a case!" );
+
+		m_CaseFallthroughs.RemoveLast();
+	}
+	// Fall into the next case
+	void MCodeGen::FallthroughCase()
+	{
+		AX_ASSERT_MSG( CanFallthroughCase(), "No case to fall into!" );
+
+		m_IRBuilder.CreateBr( m_CaseFallthroughs.Last() );
+	}
+	// Check whether a case can be fallen out of
+	bool MCodeGen::CanFallthroughCase() const
+	{
+		return !m_CaseFallthroughs.IsEmpty() && m_CaseFallthroughs.Last() != nullptr;
+	}
+	// Check whether a loop can be broken from
+	bool MCodeGen::CanBreakLoop() const
+	{
+		return !m_LoopPoints.IsEmpty() && m_LoopPoints.Last().pBreakLoop != nullptr;
+	}
+	// Emit a sync point
+	void MCodeGen::EmitSyncPoint( llvm::BasicBlock &Continue, llvm::BasicBlock &Leave )
+	{
+		AX_ASSERT_NOT_NULL( m_pCurrentBlock );
+		AX_ASSERT_NOT_NULL( m_IROps.pSync );
+
+		// Worker threads don't sync; the thread running the loop waits for
+		// them without syncing either
+		if( IsInParallelRegion() ) {
+			m_IRBuilder.CreateBr( &Continue );
+			return;
+		}
+
+		// The countdown is expanded by LowerSyncPoint(), after the Tenshi IR
+		// passes have had a chance to drop redundant sync points
+		llvm::Value *const pCanContinue = m_IRBuilder.CreateCall( m_IROps.pSync, llvm::ArrayRef< llvm::Value * >(), "cancontinue" );
+		m_IRBuilder.CreateCondBr( pCanContinue, &Continue, &Leave );
+	}
 
 }}
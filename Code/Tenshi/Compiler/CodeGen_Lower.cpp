@@ -0,0 +1,262 @@
+#include "_PCH.hpp"
+#include "CodeGen.hpp"
+#include "TIR.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	using namespace Ax;
+
+	bool MCodeGen::IsIRLowered() const
+	{
+		return m_bIRLowered;
+	}
+	void MCodeGen::LowerIR()
+	{
+		AX_ASSERT_NOT_NULL( m_pModule );
+
+		if( m_bIRLowered ) {
+			return;
+		}
+		m_bIRLowered = true;
+
+		const STIRContext Ctx = { m_IntFuncs, m_IROps };
+
+		CTIRPassManager Passes;
+
+		Passes.AddStandardPasses();
+		Passes.Run( *m_pModule, Ctx );
+
+		llvm::IRBuilderBase::InsertPointGuard SavedIP( m_IRBuilder );
+
+		// Each lowering splits the block of the operation, so collect them
+		// all up front
+		llvm::SmallVector< llvm::CallInst *, 32 > Ops;
+		for( llvm::Function *pOpFunc : { m_IROps.pSync, m_IROps.pBoundsCheck } ) {
+			AX_ASSERT_NOT_NULL( pOpFunc );
+
+			for( llvm::User *pUser : pOpFunc->users() ) {
+				llvm::CallInst *const pOp = TIRCallTo( pUser, pOpFunc );
+				AX_ASSERT_MSG( pOp != nullptr, "Tenshi IR operation used as a value" );
+
+				Ops.push_back( pOp );
+			}
+		}
+
+		// Each function with sync points gets one countdown for all of them
+		llvm::DenseMap< llvm::Function *, llvm::AllocaInst * > Countdowns;
+
+		for( llvm::CallInst *pOp : Ops ) {
+			if( pOp->getCalledFunction() == m_IROps.pSync ) {
+				llvm::Function *const pFunc = pOp->getParent()->getParent();
+
+				llvm::AllocaInst *&pCountdown = Countdowns[ pFunc ];
+				if( !pCountdown ) {
+					pCountdown = EmitSyncCountdown( *pFunc );
+				}
+
+				LowerSyncPoint( *pOp, *pCountdown );
+			} else {
+				LowerBoundsCheck( *pOp );
+			}
+		}
+
+		for( const auto &Countdown : Countdowns ) {
+			ShareSyncCountdown( *Countdown.first, *Countdown.second );
+		}
+
+		m_IROps.pSync->eraseFromParent();
+		m_IROps.pSync = nullptr;
+
+		m_IROps.pBoundsCheck->eraseFromParent();
+		m_IROps.pBoundsCheck = nullptr;
+	}
+
+	llvm::AllocaInst *MCodeGen::EmitSyncCountdown( llvm::Function &Func )
+	{
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pSyncCountdown );
+
+		llvm::BasicBlock &Entry = Func.getEntryBlock();
+		m_IRBuilder.SetInsertPoint( &Entry, Entry.getFirstInsertionPt() );
+
+		// Nothing else can see this, so it's promoted to a register and the
+		// loops don't touch memory to count down (see ShareSyncCountdown())
+		llvm::AllocaInst *const pCountdown = m_IRBuilder.CreateAlloca( m_IRBuilder.getInt32Ty(), nullptr, "synccount.addr" );
+		AX_EXPECT_MEMORY( pCountdown );
+
+		llvm::LoadInst *const pStart = m_IRBuilder.CreateLoad( m_IntFuncs.pSyncCountdown, "synccount.start" );
+		m_IRBuilder.CreateStore( pStart, pCountdown );
+
+		return pCountdown;
+	}
+	llvm::Value *MCodeGen::EmitSafeSyncCall( llvm::AllocaInst &Countdown )
+	{
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pSafeSync );
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pSyncCountdown );
+
+		llvm::Value *const pCanContinue = m_IRBuilder.CreateCall( m_IntFuncs.pSafeSync, llvm::ArrayRef< llvm::Value * >(), "cancontinue" );
+
+		// teSafeSync() reset the runtime's counter to the current interval
+		llvm::LoadInst *const pRestart = m_IRBuilder.CreateLoad( m_IntFuncs.pSyncCountdown, "synccount.restart" );
+		m_IRBuilder.CreateStore( pRestart, &Countdown );
+
+		return pCanContinue;
+	}
+	// Whether a call might reach a sync point of another function (which
+	// counts down from teSyncCountdown itself)
+	static bool CanCallSyncPoint( const llvm::CallInst &Call )
+	{
+		const llvm::Function *const pCallee = Call.getCalledFunction();
+
+		// The runtime's functions don't count down (teSafeSync() is handled
+		// by EmitSafeSyncCall())
+		return !pCallee || !pCallee->isDeclaration();
+	}
+	void MCodeGen::ShareSyncCountdown( llvm::Function &Func, llvm::AllocaInst &Countdown )
+	{
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pSyncCountdown );
+
+		// The countdown is written back whenever the function returns and
+		// around calls into the program's functions, so the count carries
+		// across calls (e.g., a frame function's loop called from a DO loop)
+		// and a counter zeroed by the host is picked up
+		llvm::SmallVector< llvm::Instruction *, 16 > Exits;
+		llvm::SmallVector< llvm::CallInst *, 16 > Calls;
+		for( llvm::BasicBlock &Block : Func ) {
+			for( llvm::Instruction &Inst : Block ) {
+				if( llvm::isa< llvm::ReturnInst >( &Inst ) ) {
+					Exits.push_back( &Inst );
+					continue;
+				}
+
+				llvm::CallInst *const pCall = llvm::dyn_cast< llvm::CallInst >( &Inst );
+				if( pCall != nullptr && CanCallSyncPoint( *pCall ) ) {
+					Calls.push_back( pCall );
+				}
+			}
+		}
+
+		for( llvm::Instruction *pExit : Exits ) {
+			m_IRBuilder.SetInsertPoint( pExit );
+			m_IRBuilder.CreateStore( m_IRBuilder.CreateLoad( &Countdown, "synccount" ), m_IntFuncs.pSyncCountdown );
+		}
+		for( llvm::CallInst *pCall : Calls ) {
+			m_IRBuilder.SetInsertPoint( pCall );
+			m_IRBuilder.CreateStore( m_IRBuilder.CreateLoad( &Countdown, "synccount" ), m_IntFuncs.pSyncCountdown );
+
+			m_IRBuilder.SetInsertPoint( pCall->getNextNode() );
+			m_IRBuilder.CreateStore( m_IRBuilder.CreateLoad( m_IntFuncs.pSyncCountdown, "synccount.after" ), &Countdown );
+		}
+	}
+	void MCodeGen::LowerSyncPoint( llvm::CallInst &Op, llvm::AllocaInst &Countdown )
+	{
+		llvm::BasicBlock *const pHead = Op.getParent();
+		llvm::Function *const pFunc = pHead->getParent();
+
+		m_IRBuilder.SetInsertPoint( &Op );
+
+		llvm::LoadInst *const pCount = m_IRBuilder.CreateLoad( &Countdown, "synccount" );
+		llvm::Value *const pNewCount = m_IRBuilder.CreateSub( pCount, m_IRBuilder.getInt32( 1 ), "synccount.dec" );
+		m_IRBuilder.CreateStore( pNewCount, &Countdown );
+
+		// Tripping the counter is the rare case; keep the call off the hot path
+		llvm::Value *const pTripped = m_IRBuilder.CreateICmpSLE( pNewCount, m_IRBuilder.getInt32( 0 ), "synctrip" );
+		llvm::MDNode *const pWeights = llvm::MDBuilder( m_Context ).createBranchWeights( 1, 1023 );
+
+		llvm::BasicBlock *const pSyncBlock = llvm::BasicBlock::Create( m_Context, "sync.call", pFunc );
+		AX_EXPECT_MEMORY( pSyncBlock );
+
+		llvm::BranchInst *const pBranch = llvm::dyn_cast< llvm::BranchInst >( pHead->getTerminator() );
+		if( pBranch != nullptr && pBranch->isConditional() && pBranch->getCondition() == &Op && Op.hasOneUse() && pBranch->getSuccessor( 0 ) != pBranch->getSuccessor( 1 ) ) {
+			// As emitted by EmitSyncPoint(): the loop continues straight from
+			// the countdown, and only the call decides whether to leave
+			llvm::BasicBlock *const pContinue = pBranch->getSuccessor( 0 );
+			llvm::BasicBlock *const pLeave = pBranch->getSuccessor( 1 );
+
+			for( llvm::Instruction &Inst : *pContinue ) {
+				llvm::PHINode *const pPhi = llvm::dyn_cast< llvm::PHINode >( &Inst );
+				if( !pPhi ) {
+					break;
+				}
+
+				pPhi->addIncoming( pPhi->getIncomingValueForBlock( pHead ), pSyncBlock );
+			}
+			for( llvm::Instruction &Inst : *pLeave ) {
+				llvm::PHINode *const pPhi = llvm::dyn_cast< llvm::PHINode >( &Inst );
+				if( !pPhi ) {
+					break;
+				}
+
+				pPhi->setIncomingBlock( ( unsigned )pPhi->getBasicBlockIndex( pHead ), pSyncBlock );
+			}
+
+			pBranch->eraseFromParent();
+			Op.eraseFromParent();
+
+			m_IRBuilder.SetInsertPoint( pHead );
+			m_IRBuilder.CreateCondBr( pTripped, pSyncBlock, pContinue, pWeights );
+
+			m_IRBuilder.SetInsertPoint( pSyncBlock );
+			llvm::Value *const pCanContinue = EmitSafeSyncCall( Countdown );
+			m_IRBuilder.CreateCondBr( pCanContinue, pContinue, pLeave );
+
+			return;
+		}
+
+		// Anywhere else, the call's result is merged with "continue" after it
+		llvm::BasicBlock *const pTail = pHead->splitBasicBlock( &Op, "sync.cont" );
+		AX_EXPECT_MEMORY( pTail );
+
+		pHead->getTerminator()->eraseFromParent();
+		m_IRBuilder.SetInsertPoint( pHead );
+		m_IRBuilder.CreateCondBr( pTripped, pSyncBlock, pTail, pWeights );
+
+		m_IRBuilder.SetInsertPoint( pSyncBlock );
+		llvm::Value *const pCanContinue = EmitSafeSyncCall( Countdown );
+		m_IRBuilder.CreateBr( pTail );
+
+		m_IRBuilder.SetInsertPoint( &Op );
+		llvm::PHINode *const pMerged = m_IRBuilder.CreatePHI( Op.getType(), 2, "cancontinue.merged" );
+		pMerged->addIncoming( m_IRBuilder.getTrue(), pHead );
+		pMerged->addIncoming( pCanContinue, pSyncBlock );
+
+		Op.replaceAllUsesWith( pMerged );
+		Op.eraseFromParent();
+	}
+	void MCodeGen::LowerBoundsCheck( llvm::CallInst &Op )
+	{
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pArrayIndexError );
+
+		llvm::Value *const pArrData = Op.getArgOperand( 0 );
+		llvm::Value *const pDim = Op.getArgOperand( 1 );
+		llvm::Value *const pIndex = Op.getArgOperand( 2 );
+
+		AX_ASSERT( llvm::isa< llvm::ConstantInt >( pDim ) );
+		const unsigned uDim = ( unsigned )llvm::cast< llvm::ConstantInt >( pDim )->getZExtValue();
+
+		llvm::BasicBlock *const pHead = Op.getParent();
+		llvm::Function *const pFunc = pHead->getParent();
+
+		// Negative indexes wrap to huge unsigned values, so one compare does
+		m_IRBuilder.SetInsertPoint( &Op );
+		llvm::Value *const pDimLen = EmitArrayDimensionLen( pArrData, uDim );
+		llvm::Value *const pInBounds = m_IRBuilder.CreateICmpULT( pIndex, pDimLen, "bounds.inrange" );
+
+		llvm::BasicBlock *const pOkayBlock = pHead->splitBasicBlock( &Op, "bounds.ok" );
+		llvm::BasicBlock *const pFailBlock = llvm::BasicBlock::Create( m_Context, "bounds.fail", pFunc );
+		AX_EXPECT_MEMORY( pOkayBlock );
+		AX_EXPECT_MEMORY( pFailBlock );
+
+		pHead->getTerminator()->eraseFromParent();
+		m_IRBuilder.SetInsertPoint( pHead );
+		m_IRBuilder.CreateCondBr( pInBounds, pOkayBlock, pFailBlock, llvm::MDBuilder( m_Context ).createBranchWeights( 1023, 1 ) );
+
+		llvm::Value *const pArgs[] = { pArrData, pDim, pIndex };
+
+		m_IRBuilder.SetInsertPoint( pFailBlock );
+		m_IRBuilder.CreateCall( m_IntFuncs.pArrayIndexError, pArgs );
+		m_IRBuilder.CreateUnreachable();
+
+		Op.eraseFromParent();
+	}
+
+}}
@@ -1,6 +1,7 @@
 #include "_PCH.hpp"
 #include "CodeGen.hpp"
 #include "Environment.hpp"
+#include "Module.hpp"
 
 namespace Tenshi { namespace Compiler {
 
@@ -69,6 +70,23 @@ namespace Tenshi { namespace Compiler {
 		return pFunc;
 	}
 
+	llvm::TargetMachine *MCodeGen::CreateTargetMachine( const std::string &TripleName ) const
+	{
+		AX_ASSERT_NOT_NULL( m_pTarget );
+
+		llvm::TargetOptions Opts;
+		Opts.FloatABIType = llvm::FloatABI::Default;
+		Opts.ThreadModel = llvm::ThreadModel::POSIX;
+		Opts.MCOptions.AsmVerbose = true;
+		Opts.MCOptions.ShowMCEncoding = true;
+		// Each function and global gets its own section so the linker can
+		// strip whatever nothing refers to (see MBinutils::Link())
+		Opts.FunctionSections = true;
+		Opts.DataSections = true;
+
+		return m_pTarget->createTargetMachine( TripleName, "x86-64", "", Opts, llvm::Optional<llvm::Reloc::Model>(), llvm::CodeModel::Default, llvm::CodeGenOpt::Default );
+	}
+
 	void MCodeGen::Init()
 	{
 		AX_ASSERT( !IsInitialized() );
@@ -81,6 +99,15 @@ namespace Tenshi { namespace Compiler {
 		m_pObjFiniFTy = nullptr;
 		m_pObjCopyFTy = nullptr;
 		m_pObjMoveFTy = nullptr;
+		m_pArrayHdrTy = nullptr;
+		m_pNullArrayHdr = nullptr;
+		m_cParallelRegions = 0;
+		m_uParallelBodyId = 0;
+		m_ModStates.Clear();
+		m_PartitionObjs.Clear();
+		for( llvm::GlobalVariable *&pDesc : m_pVectorTypeDescs ) {
+			pDesc = nullptr;
+		}
 
 		if( !m_pPassReg ) {
 			LLVMInitializeX86Target();
@@ -143,13 +170,7 @@ namespace Tenshi { namespace Compiler {
 
 		Triple = Triple.get64BitArchVariant();
 
-		llvm::TargetOptions Opts;
-		Opts.FloatABIType = llvm::FloatABI::Default;
-		Opts.ThreadModel = llvm::ThreadModel::POSIX;
-		Opts.MCOptions.AsmVerbose = true;
-		Opts.MCOptions.ShowMCEncoding = true;
-
-		m_pTargetMachine = m_pTarget->createTargetMachine( TripleName, "x86-64", "", Opts, llvm::Optional<llvm::Reloc::Model>(), llvm::CodeModel::Default, llvm::CodeGenOpt::Default );
+		m_pTargetMachine = CreateTargetMachine( TripleName );
 		AX_EXPECT_MEMORY( m_pTargetMachine );
 
 		m_pModule = new llvm::Module( "", m_Context );
@@ -164,6 +185,32 @@ namespace Tenshi { namespace Compiler {
 		m_pPM = new llvm::legacy::PassManager();
 		AX_EXPECT_MEMORY( m_pPM );
 
+		// Drop program functions that are never called and constants that are
+		// never used (e.g., a FUNCTION only referenced from dead code)
+		m_pPM->add( llvm::createGlobalDCEPass() );
+
+		// Profile-guided optimization: either count how often each edge runs
+		// (written out by the runtime's teFini()) or annotate the branches and
+		// functions with the counts from an earlier run. This has to happen
+		// before anything else changes the CFG, or the profile won't match.
+		if( m_bProfileGenerate ) {
+			m_pPM->add( llvm::createPGOInstrumentationGenPass() );
+			m_pPM->add( llvm::createInstrProfilingLegacyPass() );
+		} else if( !m_ProfileUse.IsEmpty() ) {
+			m_pPM->add( llvm::createPGOInstrumentationUsePass( LLVMStr( m_ProfileUse ) ) );
+		}
+
+		// The branch weights and entry counts steer the inliner and the
+		// optimizations here, then block placement when the code is emitted
+		if( m_bOptimize || !m_ProfileUse.IsEmpty() ) {
+			llvm::PassManagerBuilder Builder;
+
+			Builder.OptLevel = 2;
+			Builder.Inliner = llvm::createFunctionInliningPass( Builder.OptLevel, Builder.SizeLevel );
+
+			Builder.populateModulePassManager( *m_pPM );
+		}
+
 		m_pFPM = new llvm::legacy::FunctionPassManager( m_pModule );
 		AX_EXPECT_MEMORY( m_pFPM );
 
@@ -186,12 +233,14 @@ namespace Tenshi { namespace Compiler {
 		m_IntFuncs.pSafeSync			= MakeIntFunc( "teSafeSync"         , 'B', ""   );
 		m_IntFuncs.pStrDup				= MakeIntFunc( "teStrDup"           , 'S', "S"  );
 		m_IntFuncs.pStrConcat			= MakeIntFunc( "teStrConcat"        , 'S', "SS" );
+		m_IntFuncs.pStrAppend			= MakeIntFunc( "teStrAppend"        , 'S', "SS" );
 		m_IntFuncs.pStrFindRm			= MakeIntFunc( "teStrFindRm"        , 'S', "SS" );
 		m_IntFuncs.pStrRepeat			= MakeIntFunc( "teStrRepeat"        , 'S', "SU" );
 		m_IntFuncs.pStrCatDir			= MakeIntFunc( "teStrCatDir"        , 'S', "SS" );
 		m_IntFuncs.pStrReclaim			= MakeIntFunc( "teStrReclaim"       , '0', "S"  );
 		m_IntFuncs.pStrEq				= MakeIntFunc( "teStrEq"			, 'B', "SS" );
 		m_IntFuncs.pStrCmp				= MakeIntFunc( "teStrCmp"			, 'D', "SS" );
+		m_IntFuncs.pStrHash				= MakeIntFunc( "teStrHash"          , 'Q', "SD" );		// s, seed
 		m_IntFuncs.pCastInt8ToStr		= MakeIntFunc( "teCastInt8ToStr"    , 'S', "Y"  );
 		m_IntFuncs.pCastInt16ToStr		= MakeIntFunc( "teCastInt16ToStr"   , 'S', "W"  );
 		m_IntFuncs.pCastInt32ToStr		= MakeIntFunc( "teCastInt32ToStr"   , 'S', "D"  );
@@ -211,8 +260,48 @@ namespace Tenshi { namespace Compiler {
 		m_IntFuncs.pArrayDim			= MakeIntFunc( "teArrayDim"         , 'P', "PUP" );		// pDimensions, cDimensions, pItemType
 		m_IntFuncs.pArrayRedim			= MakeIntFunc( "teArrayRedim"       , 'P', "PPUP" );	// pOldArrayData, pDimensions, cDimensions, pItemType
 		m_IntFuncs.pArrayUndim			= MakeIntFunc( "teArrayUndim"       , 'P', "P" );		// pArrayData
+		m_IntFuncs.pArrayCopy			= MakeIntFunc( "teArrayCopy"        , 'P', "P" );		// pSrcArrayData
 		m_IntFuncs.pArrayGetDimRes		= MakeIntFunc( "teArrayDimensionLen", 'U', "PU" );		// pArrayData, uDim
 		m_IntFuncs.pArrayGetCurIdx		= MakeIntFunc( "teArrayCurrentIndex", 'U', "P" );		// pArrayData
+		m_IntFuncs.pArrayIndexError		= MakeIntFunc( "teArrayIndexError"  , '0', "PUU" );		// pArrayData, uDim, uIndex
+		m_IntFuncs.pArrayIndexError->setDoesNotReturn();
+		m_IntFuncs.pArraySort			= MakeIntFunc( "teArraySort"        , '0', "PUDD" );	// pArrayData, uKeyOffset, KeyType, Flags
+		m_IntFuncs.pArrayFill			= MakeIntFunc( "teArrayFill"        , '0', "PPUU" );	// pArrayData, pValue, uFirst, cItems
+		m_IntFuncs.pArrayCopyItems		= MakeIntFunc( "teArrayCopyItems"   , '0', "PUPUU" );	// pDstArrayData, uDstFirst, pSrcArrayData, uSrcFirst, cItems
+		m_IntFuncs.pArrayReduce			= MakeIntFunc( "teArrayReduce"      , '0', "PDDP" );	// pArrayData, ValueType, Op, pResult
+		m_IntFuncs.pArrayFind			= MakeIntFunc( "teArrayFind"        , 'U', "PDPU" );	// pArrayData, ValueType, pValue, uFirst
+		m_IntFuncs.pArrayMath			= MakeIntFunc( "teArrayMath"        , '0', "PPDD" );	// pDstArrayData, pSrcArrayData, Func, Flags
+		m_IntFuncs.pArrayRandomize		= MakeIntFunc( "teArrayRandomize"   , '0', "PDDOO" );	// pArrayData, RNGNumber, Kind, Low, High
+
+		m_IntFuncs.pParallelChunks		= MakeIntFunc( "teParallelChunks"   , 'D', "Q" );		// cIterations
+		m_IntFuncs.pParallelFor			= MakeIntFunc( "teParallelFor"      , '0', "PPQD" );	// pfnBody, pContext, cIterations, cChunks
+		m_IntFuncs.pParallelLock		= MakeIntFunc( "teParallelLock"     , '0', "" );
+		m_IntFuncs.pParallelUnlock		= MakeIntFunc( "teParallelUnlock"   , '0', "" );
+
+		m_IntFuncs.pMapIterFirst		= MakeIntFunc( "teMapIterFirst"     , 'U', "D" );		// MapNumber
+		m_IntFuncs.pMapIterNext			= MakeIntFunc( "teMapIterNext"      , 'U', "DU" );		// MapNumber, uPos
+		m_IntFuncs.pMapIterIntKey		= MakeIntFunc( "teMapIterIntKey"    , 'Q', "DU" );		// MapNumber, uPos
+		m_IntFuncs.pMapIterStrKey		= MakeIntFunc( "teMapIterStrKey"    , 'S', "DU" );		// MapNumber, uPos
+
+		m_IntFuncs.pInitModule			= MakeIntFunc( "teInitModule"       , '0', "P" );		// pState
+
+		m_IntFuncs.pSyncCountdown		=
+			new llvm::GlobalVariable
+			(
+				*m_pModule,
+				llvm::Type::getInt32Ty( m_Context ),
+				false,
+				llvm::GlobalValue::ExternalLinkage,
+				nullptr,
+				"teSyncCountdown"
+			);
+		AX_EXPECT_MEMORY( m_IntFuncs.pSyncCountdown );
+
+		// Tenshi IR operations; nothing is linked against these, LowerIR()
+		// replaces every call and removes them
+		m_IROps.pSync					= MakeIntFunc( "tenshi.sync"        , 'B', ""    );
+		m_IROps.pBoundsCheck			= MakeIntFunc( "tenshi.bounds.check", '0', "PUU" );	// pArrayData, uDim, uIndex
+		m_bIRLowered = false;
 
 		m_pEntryFunc =
 			llvm::Function::Create
@@ -237,7 +326,8 @@ namespace Tenshi { namespace Compiler {
 	}
 	bool MCodeGen::IsInitialized() const
 	{
-		return m_pModule != nullptr;
+		// The module is gone after a partitioned build (see EmitPartitions())
+		return m_pPM != nullptr;
 	}
 	void MCodeGen::Fini()
 	{
@@ -257,6 +347,9 @@ namespace Tenshi { namespace Compiler {
 
 		delete m_pModule;
 		m_pModule = nullptr;
+
+		// Modules outlive the build, so their declarations have to go too
+		Mods->ClearTranslations();
 	}
 
 	void MCodeGen::CompleteMain()
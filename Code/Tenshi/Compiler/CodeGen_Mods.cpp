@@ -8,6 +8,84 @@ namespace Tenshi { namespace Compiler {
 
 	using namespace Ax;
 
+	// Only modules with an init or fini function need an entry in the tables
+	//
+	// The runtime does nothing else with a module, so listing the others would
+	// only keep their names (and whatever they pull in) in the executable.
+	static bool NeedsModuleEntry( const SModule &Mod )
+	{
+		if( Mod.Type == EModule::Internal ) {
+			return false;
+		}
+
+		return !Mod.InitFunction.Name.IsEmpty() || !Mod.FiniFunction.Name.IsEmpty();
+	}
+
+	void MCodeGen::EmitModuleInit( const SModule &Mod )
+	{
+		// Modules without an init function have nothing to wait for
+		if( Mod.Type == EModule::Internal || Mod.InitFunction.Name.IsEmpty() ) {
+			return;
+		}
+
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pInitModule );
+
+		SModuleState *pModState = nullptr;
+		for( SModuleState &ModState : m_ModStates ) {
+			if( ModState.pModule == &Mod ) {
+				pModState = &ModState;
+				break;
+			}
+		}
+
+		if( !pModState ) {
+			llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( m_Context, ( unsigned int )g_Env->GetPointerSizeInBytes()*8 );
+
+			AX_EXPECT_MEMORY( m_ModStates.Append() );
+			pModState = &m_ModStates.Last();
+
+			pModState->pModule = &Mod;
+			pModState->pState =
+				new llvm::GlobalVariable
+				(
+					*m_pModule,
+					pUIntPtrTy,
+					false,
+					llvm::GlobalValue::LinkageTypes::InternalLinkage,
+					llvm::ConstantInt::get( pUIntPtrTy, 0 ),
+					llvm::Twine( "mod.state." ) + LLVMStr( Mod.Name )
+				);
+			AX_EXPECT_MEMORY( pModState->pState );
+			pModState->pCheckedBlock = nullptr;
+		}
+
+		// Nothing can have happened to the state since the last check here
+		if( pModState->pCheckedBlock == m_IRBuilder.GetInsertBlock() ) {
+			return;
+		}
+
+		llvm::BasicBlock *const pInitBlock = llvm::BasicBlock::Create( m_Context, "mod.init", m_pCurrentFunc );
+		llvm::BasicBlock *const pReadyBlock = llvm::BasicBlock::Create( m_Context, "mod.ready", m_pCurrentFunc );
+		AX_EXPECT_MEMORY( pInitBlock );
+		AX_EXPECT_MEMORY( pReadyBlock );
+
+		// Pairs with the runtime publishing the state once Init has returned
+		llvm::LoadInst *const pState = m_IRBuilder.CreateAlignedLoad( pModState->pState, g_Env->GetPointerSizeInBytes(), "mod.state" );
+		pState->setAtomic( llvm::AtomicOrdering::Acquire );
+
+		llvm::Value *const pIsReady = m_IRBuilder.CreateIsNotNull( pState, "mod.isready" );
+
+		llvm::MDBuilder MDB( m_Context );
+		m_IRBuilder.CreateCondBr( pIsReady, pReadyBlock, pInitBlock, MDB.createBranchWeights( 1023, 1 ) );
+
+		SetCurrentBlock( *pInitBlock );
+		m_IRBuilder.CreateCall( m_IntFuncs.pInitModule, m_IRBuilder.CreatePointerCast( pModState->pState, m_IRBuilder.getInt8PtrTy() ) );
+		m_IRBuilder.CreateBr( pReadyBlock );
+
+		SetCurrentBlock( *pReadyBlock );
+		pModState->pCheckedBlock = pReadyBlock;
+	}
+
 	void MCodeGen::EmitModuleInfo()
 	{
 		llvm::Type *const pBoolTy = llvm::Type::getInt1Ty( m_Context );
@@ -24,17 +102,7 @@ namespace Tenshi { namespace Compiler {
 		llvm::FunctionType *const pModFiniFnTy =
 			llvm::FunctionType::get( pVoidTy, /*isVarArg=*/false );
 
-		TArray<llvm::Constant *> ModNames, ModInits, ModFinis;
-
-		/*
-
-			!!! TODO !!!
-
-			- Create a giant data buffer of all the module names.
-			- Terminating NULs used between elements.
-			- Fill an array with GEP'd pointers into the buffer.
-
-		*/
+		TArray<llvm::Constant *> ModNames, ModInits, ModFinis, ModStates;
 
 		TArray<uint8> ModNameData;
 		TArray<uintptr> DataOffsets;
@@ -42,7 +110,7 @@ namespace Tenshi { namespace Compiler {
 		CProject &CurrProj = Projects->Current();
 
 		for( SModule *pMod = CurrProj.m_Modules.Head(); pMod != nullptr; pMod = pMod->ProjectLink.Next() ) {
-			if( pMod->Type == EModule::Internal ) {
+			if( !NeedsModuleEntry( *pMod ) ) {
 				continue;
 			}
 
@@ -70,13 +138,14 @@ namespace Tenshi { namespace Compiler {
 
 		uintptr uOffsetIndex = 0;
 		for( SModule *pMod = CurrProj.m_Modules.Head(); pMod != nullptr; pMod = pMod->ProjectLink.Next() ) {
-			if( pMod->Type == EModule::Internal ) {
+			if( !NeedsModuleEntry( *pMod ) ) {
 				continue;
 			}
 
 			AX_EXPECT_MEMORY( ModNames.Append() );
 			AX_EXPECT_MEMORY( ModInits.Append() );
 			AX_EXPECT_MEMORY( ModFinis.Append() );
+			AX_EXPECT_MEMORY( ModStates.Append() );
 
 #if 0
 			// FIXME: Unused. Seems like DataOffsets[] is used to reference the module name instead
@@ -125,16 +194,28 @@ namespace Tenshi { namespace Compiler {
 						m_pModule
 					)
 				;
+
+			// Modules that were never checked before a call are initialized at
+			// startup instead (a null state)
+			ModStates.Last() = llvm::ConstantPointerNull::get( pUIntPtrTy->getPointerTo() );
+			for( const SModuleState &ModState : m_ModStates ) {
+				if( ModState.pModule == pMod ) {
+					ModStates.Last() = ModState.pState;
+					break;
+				}
+			}
 		}
 
 		const uintptr cModules = ModNames.Num();
 		AX_ASSERT( ModNames.Num() == ModInits.Num() );
 		AX_ASSERT( ModNames.Num() == ModFinis.Num() );
+		AX_ASSERT( ModNames.Num() == ModStates.Num() );
 
 		// FIXME: The following is a HACK
 		llvm::ArrayType *const pModNamesTy = llvm::ArrayType::get( pStrTy, cModules );
 		llvm::ArrayType *const pModInitsTy = llvm::ArrayType::get( pModInitFnTy->getPointerTo(), cModules );
 		llvm::ArrayType *const pModFinisTy = llvm::ArrayType::get( pModFiniFnTy->getPointerTo(), cModules );
+		llvm::ArrayType *const pModStatesTy = llvm::ArrayType::get( pUIntPtrTy->getPointerTo(), cModules );
 
 		llvm::Constant *const pModNamesInit = llvm::ConstantArray::get( pModNamesTy, LLVMArr( ModNames ) );
 
@@ -168,6 +249,16 @@ namespace Tenshi { namespace Compiler {
 				llvm::ConstantArray::get( pModFinisTy, LLVMArr( ModFinis ) ),
 				"tenshi__modFinis__"
 			);
+		llvm::GlobalVariable *const pModStates =
+			new llvm::GlobalVariable
+			(
+				*m_pModule,
+				pModStatesTy,
+				false,
+				llvm::GlobalValue::LinkageTypes::ExternalLinkage,
+				llvm::ConstantArray::get( pModStatesTy, LLVMArr( ModStates ) ),
+				"tenshi__modStates__"
+			);
 
 		llvm::GlobalVariable *const pNumMods =
 			new llvm::GlobalVariable
@@ -183,6 +274,7 @@ namespace Tenshi { namespace Compiler {
 		((void)pModNames);
 		((void)pModInits);
 		((void)pModFinis);
+		((void)pModStates);
 		((void)pNumMods);
 	}
 
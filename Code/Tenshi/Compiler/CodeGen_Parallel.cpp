@@ -0,0 +1,124 @@
+#include "_PCH.hpp"
+#include "CodeGen.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	using namespace Ax;
+
+	// Check whether a value used by the given function belongs to another one
+	static bool IsForeignValue( const llvm::Function &Func, const llvm::Value *pValue )
+	{
+		if( const llvm::Instruction *const pInst = llvm::dyn_cast< llvm::Instruction >( pValue ) ) {
+			return pInst->getParent()->getParent() != &Func;
+		}
+		if( const llvm::Argument *const pArg = llvm::dyn_cast< llvm::Argument >( pValue ) ) {
+			return pArg->getParent() != &Func;
+		}
+
+		return false;
+	}
+
+	llvm::Function *MCodeGen::CreateParallelBody()
+	{
+		llvm::Type *const pArgTys[] = {
+			m_IRBuilder.getInt8PtrTy(),
+			m_IRBuilder.getInt32Ty(),
+			m_IRBuilder.getInt64Ty(),
+			m_IRBuilder.getInt64Ty()
+		};
+
+		llvm::FunctionType *const pFuncTy = llvm::FunctionType::get( m_IRBuilder.getVoidTy(), pArgTys, false );
+		AX_EXPECT_MEMORY( pFuncTy );
+
+		llvm::Function *const pFunc =
+			llvm::Function::Create
+			(
+				pFuncTy,
+				llvm::GlobalValue::InternalLinkage,
+				"parfor.body" + llvm::Twine( ++m_uParallelBodyId ),
+				m_pModule
+			);
+		AX_EXPECT_MEMORY( pFunc );
+
+		static const char *const pszArgNames[] = { "ctx", "chunk", "first", "last" };
+
+		unsigned i = 0;
+		for( llvm::Argument &Arg : pFunc->args() ) {
+			Arg.setName( pszArgNames[ i++ ] );
+		}
+
+		return pFunc;
+	}
+	void MCodeGen::EnterParallelRegion()
+	{
+		++m_cParallelRegions;
+	}
+	void MCodeGen::LeaveParallelRegion()
+	{
+		AX_ASSERT_MSG( m_cParallelRegions > 0, "Not in a PARALLEL FOR!" );
+
+		--m_cParallelRegions;
+	}
+	bool MCodeGen::IsInParallelRegion() const
+	{
+		return m_cParallelRegions > 0;
+	}
+
+	llvm::StructType *MCodeGen::CaptureParallelValues( llvm::Function &Body, Ax::TArray< llvm::Value * > &OutCaptures )
+	{
+		OutCaptures.Clear();
+
+		// The body was generated as though it were part of its caller, so
+		// anything it refers to from there (mostly the caller's allocas) has
+		// to be handed over through the context
+		llvm::SmallVector< llvm::Use *, 32 > Uses;
+		llvm::SmallVector< llvm::Type *, 16 > FieldTys;
+		llvm::DenseMap< llvm::Value *, unsigned > FieldIndexes;
+
+		for( llvm::BasicBlock &Block : Body ) {
+			for( llvm::Instruction &Inst : Block ) {
+				for( llvm::Use &Operand : Inst.operands() ) {
+					llvm::Value *const pValue = Operand.get();
+					if( !IsForeignValue( Body, pValue ) ) {
+						continue;
+					}
+
+					Uses.push_back( &Operand );
+
+					if( FieldIndexes.count( pValue ) != 0 ) {
+						continue;
+					}
+
+					FieldIndexes[ pValue ] = unsigned( OutCaptures.Num() );
+					AX_EXPECT_MEMORY( OutCaptures.Append( pValue ) );
+					FieldTys.push_back( pValue->getType() );
+				}
+			}
+		}
+
+		if( OutCaptures.IsEmpty() ) {
+			return nullptr;
+		}
+
+		llvm::StructType *const pContextTy = llvm::StructType::create( m_Context, FieldTys, "parfor.ctx" );
+		AX_EXPECT_MEMORY( pContextTy );
+
+		llvm::BasicBlock &Entry = Body.getEntryBlock();
+		llvm::IRBuilder<> EntryBuilder( &Entry, Entry.getFirstInsertionPt() );
+
+		llvm::Value *const pContext = EntryBuilder.CreatePointerCast( &*Body.arg_begin(), pContextTy->getPointerTo(), "ctx.data" );
+
+		llvm::SmallVector< llvm::Value *, 16 > Loaded;
+		for( uintptr i = 0; i < OutCaptures.Num(); ++i ) {
+			llvm::Value *const pField = EntryBuilder.CreateStructGEP( pContextTy, pContext, unsigned( i ) );
+			Loaded.push_back( EntryBuilder.CreateLoad( pField, OutCaptures[ i ]->getName() ) );
+		}
+
+		for( llvm::Use *pUse : Uses ) {
+			pUse->set( Loaded[ FieldIndexes[ pUse->get() ] ] );
+		}
+
+		return pContextTy;
+	}
+
+}}
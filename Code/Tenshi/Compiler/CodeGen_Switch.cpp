@@ -0,0 +1,291 @@
+#include "_PCH.hpp"
+#include "CodeGen.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	using namespace Ax;
+
+	// Fewest labels worth hashing (comparing against each label is cheaper
+	// than the hash below this)
+	static const uintptr			kMinHashedLabels = 4;
+	// Number of seeds tried for each table size before trying a larger table
+	static const uint32				kMaxHashSeeds = 64;
+	// Largest table tried, in slots per label
+	static const uintptr			kMaxSlotsPerLabel = 8;
+
+	// A perfect hash over a set of labels
+	//
+	// The low bits of a label's hash pick its bucket, and the label's slot
+	// is the high bits of the hash xor'd with the bucket's displacement. Each
+	// bucket's displacement is chosen so every label lands in a slot of its
+	// own, so a string can only be equal to the label in the slot it hashes
+	// to.
+	struct SPerfectHash
+	{
+		uint32						uSeed;
+		TArray< uint32 >			Displacements;
+		// Index of the label in each slot (-1 if the slot is empty)
+		TArray< int32 >				Slots;
+	};
+
+	// Must match teStrHash() in the runtime
+	static uint64 HashLabel( const String &Label, uint32 uSeed )
+	{
+		uint64 h = 14695981039346656037ULL ^ uint64( uSeed );
+
+		const char *const p = Label.CString();
+		for( intptr i = 0; i < Label.Len(); ++i ) {
+			h ^= uint64( uint8( p[ i ] ) );
+			h *= 1099511628211ULL;
+		}
+
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+
+		return h;
+	}
+	static uintptr RoundUpPow2( uintptr n )
+	{
+		uintptr r = 1;
+		while( r < n ) {
+			r <<= 1;
+		}
+
+		return r;
+	}
+	static inline uintptr GetHashBucket( uint64 h, uintptr cBuckets )
+	{
+		return uintptr( h ) & ( cBuckets - 1 );
+	}
+	static inline uintptr GetHashSlot( uint64 h, uint32 uDisp, uintptr cSlots )
+	{
+		return uintptr( uint32( h >> 32 ) ^ uDisp ) & ( cSlots - 1 );
+	}
+
+	static bool TryPerfectHash( const TArray< uint64 > &Hashes, uintptr cBuckets, uintptr cSlots, SPerfectHash &OutHash )
+	{
+		const uintptr cLabels = Hashes.Num();
+
+		TArray< uintptr > BucketSizes;
+		TArray< uintptr > Order;
+		AX_EXPECT_MEMORY( BucketSizes.Resize( cBuckets ) );
+		AX_EXPECT_MEMORY( Order.Resize( cLabels ) );
+		AX_EXPECT_MEMORY( OutHash.Displacements.Resize( cBuckets ) );
+		AX_EXPECT_MEMORY( OutHash.Slots.Resize( cSlots ) );
+
+		for( uintptr i = 0; i < cBuckets; ++i ) {
+			BucketSizes[ i ] = 0;
+			OutHash.Displacements[ i ] = 0;
+		}
+		for( uintptr i = 0; i < cSlots; ++i ) {
+			OutHash.Slots[ i ] = -1;
+		}
+		for( uintptr i = 0; i < cLabels; ++i ) {
+			++BucketSizes[ GetHashBucket( Hashes[ i ], cBuckets ) ];
+		}
+
+		// Place the largest buckets first, while most slots are still free
+		// (keeping the labels of each bucket together; there are few enough
+		// labels for an insertion sort)
+		for( uintptr i = 0; i < cLabels; ++i ) {
+			const uintptr uLabel = i;
+			const uintptr uBucket = GetHashBucket( Hashes[ uLabel ], cBuckets );
+
+			uintptr j = i;
+			while( j > 0 ) {
+				const uintptr uOtherBucket = GetHashBucket( Hashes[ Order[ j - 1 ] ], cBuckets );
+				if( BucketSizes[ uOtherBucket ] > BucketSizes[ uBucket ] ) {
+					break;
+				}
+				if( BucketSizes[ uOtherBucket ] == BucketSizes[ uBucket ] && uOtherBucket <= uBucket ) {
+					break;
+				}
+
+				Order[ j ] = Order[ j - 1 ];
+				--j;
+			}
+
+			Order[ j ] = uLabel;
+		}
+
+		uintptr uFirst = 0;
+		while( uFirst < cLabels ) {
+			const uintptr uBucket = GetHashBucket( Hashes[ Order[ uFirst ] ], cBuckets );
+
+			uintptr uEnd = uFirst + 1;
+			while( uEnd < cLabels && GetHashBucket( Hashes[ Order[ uEnd ] ], cBuckets ) == uBucket ) {
+				++uEnd;
+			}
+
+			bool bPlaced = false;
+			for( uint32 uDisp = 0; uDisp < uint32( cSlots ) && !bPlaced; ++uDisp ) {
+				uintptr k = uFirst;
+				while( k < uEnd ) {
+					const uintptr uSlot = GetHashSlot( Hashes[ Order[ k ] ], uDisp, cSlots );
+					if( OutHash.Slots[ uSlot ] != -1 ) {
+						break;
+					}
+
+					OutHash.Slots[ uSlot ] = int32( Order[ k ] );
+					++k;
+				}
+
+				if( k == uEnd ) {
+					OutHash.Displacements[ uBucket ] = uDisp;
+					bPlaced = true;
+					break;
+				}
+
+				// Give back the slots taken by this attempt
+				while( k > uFirst ) {
+					--k;
+					OutHash.Slots[ GetHashSlot( Hashes[ Order[ k ] ], uDisp, cSlots ) ] = -1;
+				}
+			}
+
+			if( !bPlaced ) {
+				return false;
+			}
+
+			uFirst = uEnd;
+		}
+
+		return true;
+	}
+	static bool FindPerfectHash( const TArray< String > &Labels, SPerfectHash &OutHash )
+	{
+		const uintptr cLabels = Labels.Num();
+		AX_ASSERT( cLabels > 0 );
+
+		TArray< uint64 > Hashes;
+		AX_EXPECT_MEMORY( Hashes.Resize( cLabels ) );
+
+		const uintptr cMinSlots = RoundUpPow2( cLabels );
+		for( uintptr cSlots = cMinSlots; cSlots <= cMinSlots*kMaxSlotsPerLabel; cSlots <<= 1 ) {
+			const uintptr cBuckets = RoundUpPow2( ( cLabels + 1 )/2 );
+
+			for( uint32 uSeed = 0; uSeed < kMaxHashSeeds; ++uSeed ) {
+				for( uintptr i = 0; i < cLabels; ++i ) {
+					Hashes[ i ] = HashLabel( Labels[ i ], uSeed );
+				}
+
+				if( TryPerfectHash( Hashes, cBuckets, cSlots, OutHash ) ) {
+					OutHash.uSeed = uSeed;
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	llvm::Value *MCodeGen::EmitStringDispatch( llvm::Value *pStr, const Ax::TArray< Ax::String > &Labels )
+	{
+		AX_ASSERT_NOT_NULL( pStr );
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pStrEq );
+		AX_ASSERT_NOT_NULL( m_IntFuncs.pStrHash );
+
+		llvm::Type *const pInt32Ty = m_IRBuilder.getInt32Ty();
+		llvm::PointerType *const pStrTy = m_IRBuilder.getInt8PtrTy();
+
+		// Empty strings are null at runtime, so an empty label is stored as one
+		TArray< llvm::Constant * > LabelPtrs;
+		AX_EXPECT_MEMORY( LabelPtrs.Reserve( Labels.Num() ) );
+		for( const String &Label : Labels ) {
+			if( Label.IsEmpty() ) {
+				AX_EXPECT_MEMORY( LabelPtrs.Append( llvm::ConstantPointerNull::get( pStrTy ) ) );
+				continue;
+			}
+
+			llvm::Constant *const pInit = llvm::ConstantDataArray::getString( m_Context, LLVMStr( Label ) );
+			llvm::GlobalVariable *const pLabelStr =
+				new llvm::GlobalVariable
+				(
+					*m_pModule,
+					pInit->getType(),
+					true,
+					llvm::GlobalValue::PrivateLinkage,
+					pInit,
+					"case.str"
+				);
+			AX_EXPECT_MEMORY( pLabelStr );
+
+			llvm::Constant *const pIndexes[] = {
+				llvm::ConstantInt::get( pInt32Ty, 0 ),
+				llvm::ConstantInt::get( pInt32Ty, 0 )
+			};
+			AX_EXPECT_MEMORY( LabelPtrs.Append( llvm::ConstantExpr::getInBoundsGetElementPtr( pInit->getType(), pLabelStr, pIndexes ) ) );
+		}
+
+		SPerfectHash Hash;
+		if( Labels.Num() < kMinHashedLabels || !FindPerfectHash( Labels, Hash ) ) {
+			// Compare against each label, last to first, so the first match wins
+			llvm::Value *pIndex = llvm::ConstantInt::get( pInt32Ty, uint64( -1 ), true );
+			for( uintptr i = Labels.Num(); i > 0; --i ) {
+				llvm::Value *const pArgs[] = { pStr, LabelPtrs[ i - 1 ] };
+				llvm::Value *const pIsEq = m_IRBuilder.CreateCall( m_IntFuncs.pStrEq, pArgs, "case.eq" );
+				pIndex = m_IRBuilder.CreateSelect( pIsEq, llvm::ConstantInt::get( pInt32Ty, i - 1 ), pIndex, "case.idx" );
+			}
+
+			return pIndex;
+		}
+
+		const uintptr cBuckets = Hash.Displacements.Num();
+		const uintptr cSlots = Hash.Slots.Num();
+
+		// Tables for the hash
+		TArray< llvm::Constant * > DispInits;
+		TArray< llvm::Constant * > SlotStrInits;
+		TArray< llvm::Constant * > SlotIndexInits;
+		AX_EXPECT_MEMORY( DispInits.Reserve( cBuckets ) );
+		AX_EXPECT_MEMORY( SlotStrInits.Reserve( cSlots ) );
+		AX_EXPECT_MEMORY( SlotIndexInits.Reserve( cSlots ) );
+
+		for( uint32 uDisp : Hash.Displacements ) {
+			AX_EXPECT_MEMORY( DispInits.Append( llvm::ConstantInt::get( pInt32Ty, uDisp ) ) );
+		}
+		for( int32 iLabel : Hash.Slots ) {
+			llvm::Constant *const pSlotStr = iLabel < 0 ? llvm::ConstantPointerNull::get( pStrTy ) : LabelPtrs[ iLabel ];
+
+			AX_EXPECT_MEMORY( SlotStrInits.Append( pSlotStr ) );
+			AX_EXPECT_MEMORY( SlotIndexInits.Append( llvm::ConstantInt::get( pInt32Ty, uint64( int64( iLabel ) ), true ) ) );
+		}
+
+		llvm::ArrayType *const pDispTy = llvm::ArrayType::get( pInt32Ty, cBuckets );
+		llvm::ArrayType *const pSlotStrTy = llvm::ArrayType::get( pStrTy, cSlots );
+		llvm::ArrayType *const pSlotIndexTy = llvm::ArrayType::get( pInt32Ty, cSlots );
+
+		llvm::GlobalVariable *const pDispTable = new llvm::GlobalVariable( *m_pModule, pDispTy, true, llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get( pDispTy, LLVMArr( DispInits ) ), "case.disp" );
+		llvm::GlobalVariable *const pSlotStrTable = new llvm::GlobalVariable( *m_pModule, pSlotStrTy, true, llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get( pSlotStrTy, LLVMArr( SlotStrInits ) ), "case.labels" );
+		llvm::GlobalVariable *const pSlotIndexTable = new llvm::GlobalVariable( *m_pModule, pSlotIndexTy, true, llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get( pSlotIndexTy, LLVMArr( SlotIndexInits ) ), "case.index" );
+		AX_EXPECT_MEMORY( pDispTable );
+		AX_EXPECT_MEMORY( pSlotStrTable );
+		AX_EXPECT_MEMORY( pSlotIndexTable );
+
+		// slot = ( hi32( h ) ^ disp[ lo32( h ) & ( buckets - 1 ) ] ) & ( slots - 1 )
+		llvm::Value *const pHashArgs[] = { pStr, llvm::ConstantInt::get( pInt32Ty, Hash.uSeed ) };
+		llvm::Value *const pHash = m_IRBuilder.CreateCall( m_IntFuncs.pStrHash, pHashArgs, "case.hash" );
+
+		llvm::Value *const pHashLo = m_IRBuilder.CreateTrunc( pHash, pInt32Ty, "case.hash.lo" );
+		llvm::Value *const pHashHi = m_IRBuilder.CreateTrunc( m_IRBuilder.CreateLShr( pHash, 32 ), pInt32Ty, "case.hash.hi" );
+
+		llvm::Value *const pBucket = m_IRBuilder.CreateAnd( pHashLo, llvm::ConstantInt::get( pInt32Ty, cBuckets - 1 ), "case.bucket" );
+		llvm::Value *const pDispIdx[] = { m_IRBuilder.getInt32( 0 ), pBucket };
+		llvm::Value *const pDisp = m_IRBuilder.CreateLoad( m_IRBuilder.CreateInBoundsGEP( pDispTable, pDispIdx ), "case.disp" );
+
+		llvm::Value *const pSlot = m_IRBuilder.CreateAnd( m_IRBuilder.CreateXor( pHashHi, pDisp ), llvm::ConstantInt::get( pInt32Ty, cSlots - 1 ), "case.slot" );
+		llvm::Value *const pSlotIdx[] = { m_IRBuilder.getInt32( 0 ), pSlot };
+		llvm::Value *const pSlotStr = m_IRBuilder.CreateLoad( m_IRBuilder.CreateInBoundsGEP( pSlotStrTable, pSlotIdx ), "case.label" );
+		llvm::Value *const pSlotIndex = m_IRBuilder.CreateLoad( m_IRBuilder.CreateInBoundsGEP( pSlotIndexTable, pSlotIdx ), "case.labelidx" );
+
+		// The one comparison: the string has to actually be the label
+		llvm::Value *const pEqArgs[] = { pStr, pSlotStr };
+		llvm::Value *const pIsEq = m_IRBuilder.CreateCall( m_IntFuncs.pStrEq, pEqArgs, "case.eq" );
+
+		return m_IRBuilder.CreateSelect( pIsEq, pSlotIndex, llvm::ConstantInt::get( pInt32Ty, uint64( -1 ), true ), "case.idx" );
+	}
+
+}}
@@ -17,6 +17,18 @@ namespace Tenshi { namespace Compiler {
 				continue;
 			}
 
+			// UDT destructors take the type first (see GetObjFiniFnTy)
+			if( F.pFunction->arg_size() == 2 ) {
+				llvm::FunctionType *const pFTy = F.pFunction->getFunctionType();
+				llvm::Value *const pArgs[] = {
+					llvm::Constant::getNullValue( pFTy->getParamType( 0 ) ),
+					Builder.CreatePointerCast( F.pValue, pFTy->getParamType( 1 ) )
+				};
+
+				Builder.CreateCall( F.pFunction, pArgs );
+				continue;
+			}
+
 			Builder.CreateCall( F.pFunction, F.pValue );
 		}
 	}
@@ -98,18 +110,19 @@ namespace Tenshi { namespace Compiler {
 			return llvm::VectorType::get( llvm::Type::getInt64Ty( Ctx ), 4 );
 		
 		case EBuiltinType::Vector2f:
-			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 2 );
+			return llvm::VectorType::get( llvm::Type::getFloatTy( Ctx ), 2 );
 		case EBuiltinType::Vector3f:
-			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 3 );
+			return llvm::VectorType::get( llvm::Type::getFloatTy( Ctx ), 3 );
 		case EBuiltinType::Vector4f:
-			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 4 );
+			return llvm::VectorType::get( llvm::Type::getFloatTy( Ctx ), 4 );
 
 		case EBuiltinType::Matrix2f:
 			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 2*2 );
 		case EBuiltinType::Matrix3f:
 			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 3*3 );
 		case EBuiltinType::Matrix4f:
-			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 4*4 );
+			// Stored as four column vectors
+			return llvm::ArrayType::get( llvm::VectorType::get( llvm::Type::getFloatTy( Ctx ), 4 ), 4 );
 		case EBuiltinType::Matrix23f:
 			return llvm::ArrayType::get( llvm::Type::getFloatTy( Ctx ), 2*3 );
 		case EBuiltinType::Matrix24f:
@@ -182,11 +195,52 @@ namespace Tenshi { namespace Compiler {
 
 		case EBuiltinType::StringObject:
 			return llvm::ConstantPointerNull::get( llvm::Type::getInt8PtrTy( C ) );
+
+		case EBuiltinType::Vector2f:
+		case EBuiltinType::Vector3f:
+		case EBuiltinType::Vector4f:
+		case EBuiltinType::Matrix4f:
+			return llvm::Constant::getNullValue( GetBuiltinType( BTy ) );
 		}
 
 		AX_ASSERT_MSG( false, "Unhandled EBuiltinType" );
 		return nullptr;
 	}
+	llvm::Value *MCodeGen::EmitConstant( const SConstant &Value )
+	{
+		AX_ASSERT( Value.IsValid() );
+
+		if( IsString( Value.Type ) ) {
+			char szName[ 64 ];
+			Ax::Format( szName, ".str.%u", GetStringId() );
+
+			const llvm::StringRef textData( Value.Text.CString(), ( size_t )Value.Text.Len() );
+
+			llvm::Value *const pText = m_IRBuilder.CreateGlobalStringPtr( textData, szName );
+			AX_EXPECT_NOT_NULL( pText );
+
+			if( Value.Type == EBuiltinType::ConstUTF8Pointer ) {
+				return pText;
+			}
+
+			// String objects are owned by whoever receives them, same as any
+			// other string operation
+			llvm::CallInst *const pInst = m_IRBuilder.CreateCall( m_IntFuncs.pStrDup, pText, "strconsttmp" );
+			AX_EXPECT_NOT_NULL( pInst );
+
+			AddCleanCall( m_IntFuncs.pStrReclaim, pInst );
+			return pInst;
+		}
+
+		llvm::Type *const pType = GetBuiltinType( Value.Type );
+		AX_ASSERT_NOT_NULL( pType );
+
+		if( IsRealNumber( Value.Type ) ) {
+			return llvm::ConstantFP::get( pType, Value.fValue );
+		}
+
+		return llvm::ConstantInt::get( pType, Value.uValue, IsSigned( Value.Type ) );
+	}
 
 	void MCodeGen::EmitConstruct( llvm::Value *pStorePtr, const STypeRef &Type )
 	{
@@ -209,9 +263,23 @@ namespace Tenshi { namespace Compiler {
 		}
 
 		AX_ASSERT_NOT_NULL( Type.pCustomType );
+		const STypeInfo &UDT = *Type.pCustomType;
 
-		static bool bDidDisplay = false; if( bDidDisplay ) { return; } else { bDidDisplay = true; }
-		AX_DEBUG_LOG += "UDTs not constructed yet";
+		// Plain-old-data is just zeroed in place
+		if( UDT.bIsInitTrivial ) {
+			llvm::Value *const pSize = llvm::ConstantExpr::getSizeOf( Type.Translated.pType );
+			m_IRBuilder.CreateMemSet( pStorePtr, m_IRBuilder.getInt8( 0 ), pSize, 1, Type.IsVolatile() );
+			return;
+		}
+
+		AX_ASSERT_NOT_NULL( UDT.pLLVMInitFn );
+		llvm::FunctionType *const pFTy = UDT.pLLVMInitFn->getFunctionType();
+
+		llvm::Value *const pArgs[] = {
+			llvm::Constant::getNullValue( pFTy->getParamType( 0 ) ),
+			m_IRBuilder.CreatePointerCast( pStorePtr, pFTy->getParamType( 1 ) )
+		};
+		m_IRBuilder.CreateCall( UDT.pLLVMInitFn, pArgs );
 	}
 	void MCodeGen::EmitDestruct( llvm::Value *pStorePtr, const STypeRef &Type )
 	{
@@ -238,9 +306,66 @@ namespace Tenshi { namespace Compiler {
 		}
 
 		AX_ASSERT_NOT_NULL( Type.pCustomType );
+		const STypeInfo &UDT = *Type.pCustomType;
+
+		if( UDT.bIsFiniTrivial ) {
+			return;
+		}
 
-		static bool bDidDisplay = false; if( bDidDisplay ) { return; } else { bDidDisplay = true; }
-		AX_DEBUG_LOG += "UDTs not destructed yet";
+		AX_ASSERT_NOT_NULL( UDT.pLLVMFiniFn );
+		AddCleanCall( UDT.pLLVMFiniFn, pStorePtr );
+	}
+	void MCodeGen::EmitCopyAssign( llvm::Value *pDstPtr, llvm::Value *pSrcPtr, const STypeRef &Type )
+	{
+		AX_ASSERT_NOT_NULL( pDstPtr );
+		AX_ASSERT_NOT_NULL( pSrcPtr );
+		AX_ASSERT( Type.BuiltinType == EBuiltinType::UserDefined );
+		AX_ASSERT( Type.Translated.bDidTranslate == true );
+		AX_ASSERT_NOT_NULL( Type.Translated.pType );
+		AX_ASSERT_NOT_NULL( Type.pCustomType );
+
+		const STypeInfo &UDT = *Type.pCustomType;
+
+		// Plain-old-data is copied in one go (memcpy handles overlapping
+		// self-assignment fine as the bytes are identical)
+		if( UDT.bIsCopyTrivial ) {
+			llvm::Value *const pSize = llvm::ConstantExpr::getSizeOf( Type.Translated.pType );
+			m_IRBuilder.CreateMemCpy( pDstPtr, pSrcPtr, pSize, 1, Type.IsVolatile() );
+			return;
+		}
+
+		if( pDstPtr == pSrcPtr ) {
+			return;
+		}
+
+		AX_ASSERT_NOT_NULL( UDT.pLLVMCopyFn );
+		AX_ASSERT( UDT.bIsFiniTrivial || UDT.pLLVMFiniFn != nullptr );
+
+		llvm::FunctionType *const pFTy = UDT.pLLVMCopyFn->getFunctionType();
+		llvm::Value *const pNullType = llvm::Constant::getNullValue( pFTy->getParamType( 0 ) );
+		llvm::Value *const pDst = m_IRBuilder.CreatePointerCast( pDstPtr, pFTy->getParamType( 1 ) );
+		llvm::Value *const pSrc = m_IRBuilder.CreatePointerCast( pSrcPtr, pFTy->getParamType( 2 ) );
+
+		// Assigning an instance to itself must not destroy it first
+		llvm::BasicBlock *const pCopyBlock = llvm::BasicBlock::Create( m_Context, "copy.do", m_pCurrentFunc );
+		llvm::BasicBlock *const pDoneBlock = llvm::BasicBlock::Create( m_Context, "copy.done", m_pCurrentFunc );
+		AX_EXPECT_MEMORY( pCopyBlock );
+		AX_EXPECT_MEMORY( pDoneBlock );
+
+		m_IRBuilder.CreateCondBr( m_IRBuilder.CreateICmpEQ( pDst, pSrc ), pDoneBlock, pCopyBlock );
+
+		SetCurrentBlock( *pCopyBlock );
+
+		if( !UDT.bIsFiniTrivial ) {
+			llvm::Value *const pFiniArgs[] = { pNullType, pDst };
+			m_IRBuilder.CreateCall( UDT.pLLVMFiniFn, pFiniArgs );
+		}
+
+		llvm::Value *const pCopyArgs[] = { pNullType, pDst, pSrc };
+		m_IRBuilder.CreateCall( UDT.pLLVMCopyFn, pCopyArgs );
+		m_IRBuilder.CreateBr( pDoneBlock );
+
+		SetCurrentBlock( *pDoneBlock );
 	}
 	
 	llvm::Value *MCodeGen::EmitDefaultInstance( const STypeRef &Type )
@@ -388,10 +513,254 @@ namespace Tenshi { namespace Compiler {
 		return m_pObjMoveFTy;
 	}
 
+
+	// Must match the order of the fields in TenshiArray_s
+	enum EArrayHeaderField : unsigned
+	{
+		kArrayHdr_cDimensions,
+		kArrayHdr_uDimensions,
+		kArrayHdr_cItems,
+		kArrayHdr_cItemBytes,
+		kArrayHdr_pItemType,
+		kArrayHdr_uIndex
+	};
+	// TENSHI_ARRAY_MAX_DIMENSIONS
+	static const unsigned kArrayMaxDimensions = 9;
+
+	llvm::StructType *MCodeGen::GetArrayHeaderType()
+	{
+		if( !m_pArrayHdrTy ) {
+			llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( m_Context, g_Env->GetPointerBits() );
+
+			// TenshiArray_s (see TenshiRuntime.h)
+			llvm::Type *const Elements[] = {
+				// cDimensions
+				pUIntPtrTy,
+				// uDimensions
+				llvm::ArrayType::get( pUIntPtrTy, kArrayMaxDimensions ),
+				// cItems
+				pUIntPtrTy,
+				// cItemBytes
+				pUIntPtrTy,
+				// pItemType
+				GetRTTIType()->getPointerTo(),
+				// uIndex
+				pUIntPtrTy
+			};
+
+			m_pArrayHdrTy = llvm::StructType::create( m_Context, Elements, "TenshiArray" );
+			AX_EXPECT_NOT_NULL( m_pArrayHdrTy );
+		}
+
+		return m_pArrayHdrTy;
+	}
+	llvm::Value *MCodeGen::EmitArrayHeader( llvm::Value *pArrData )
+	{
+		AX_ASSERT_NOT_NULL( pArrData );
+
+		llvm::StructType *const pHdrTy = GetArrayHeaderType();
+		llvm::PointerType *const pHdrPtrTy = pHdrTy->getPointerTo();
+
+		if( !m_pNullArrayHdr ) {
+			m_pNullArrayHdr =
+				new llvm::GlobalVariable
+				(
+					*m_pModule,
+					pHdrTy,
+					true,
+					llvm::GlobalValue::PrivateLinkage,
+					llvm::ConstantAggregateZero::get( pHdrTy ),
+					"te.arrayhdr.null"
+				);
+			AX_EXPECT_MEMORY( m_pNullArrayHdr );
+		}
+
+		llvm::Value *const pData = m_IRBuilder.CreatePointerCast( pArrData, pHdrPtrTy, "arr.data" );
+		llvm::Value *const pHdr = m_IRBuilder.CreateInBoundsGEP( pData, m_IRBuilder.getInt32( -1 ), "arr.hdr" );
+		llvm::Value *const pIsNull = m_IRBuilder.CreateIsNull( pData, "arr.isnull" );
+
+		return m_IRBuilder.CreateSelect( pIsNull, m_pNullArrayHdr, pHdr, "arr.hdr.sel" );
+	}
+	llvm::Value *MCodeGen::EmitArrayDimensionLen( llvm::Value *pArrData, unsigned uDim )
+	{
+		// The runtime keeps unused dimensions zeroed, so no need to check
+		// against cDimensions here
+		if( uDim >= kArrayMaxDimensions ) {
+			return llvm::ConstantInt::get( llvm::Type::getIntNTy( m_Context, g_Env->GetPointerBits() ), 0 );
+		}
+
+		llvm::Value *const pHdr = EmitArrayHeader( pArrData );
+		llvm::Value *const pIndices[] = {
+			m_IRBuilder.getInt32( 0 ),
+			m_IRBuilder.getInt32( kArrayHdr_uDimensions ),
+			m_IRBuilder.getInt32( uDim )
+		};
+
+		llvm::Value *const pField = m_IRBuilder.CreateInBoundsGEP( pHdr, pIndices, "arr.dimlen.ptr" );
+		return m_IRBuilder.CreateLoad( pField, "arr.dimlen" );
+	}
+	llvm::Value *MCodeGen::EmitArrayLen( llvm::Value *pArrData )
+	{
+		llvm::Value *const pHdr = EmitArrayHeader( pArrData );
+		llvm::Value *const pField = m_IRBuilder.CreateStructGEP( GetArrayHeaderType(), pHdr, kArrayHdr_cItems, "arr.len.ptr" );
+
+		return m_IRBuilder.CreateLoad( pField, "arr.len" );
+	}
+	llvm::Value *MCodeGen::EmitArrayCurrentIndex( llvm::Value *pArrData )
+	{
+		llvm::Value *const pHdr = EmitArrayHeader( pArrData );
+		llvm::Value *const pField = m_IRBuilder.CreateStructGEP( GetArrayHeaderType(), pHdr, kArrayHdr_uIndex, "arr.curidx.ptr" );
+
+		return m_IRBuilder.CreateLoad( pField, "arr.curidx" );
+	}
+
 	void MCodeGen::RegisterUDT( STypeInfo &UDT )
 	{
 		AX_EXPECT_MEMORY( m_UserTypes.Append( &UDT ) );
 	}
+	void MCodeGen::LayoutColumns( STypeInfo &UDT )
+	{
+		AX_ASSERT( UDT.bIsSoA );
+		AX_ASSERT_NOT_NULL( UDT.pLLVMTy );
+
+		const llvm::DataLayout &DL = m_pModule->getDataLayout();
+
+		// Fields within a column are as far apart as LLVM places them in an
+		// array (e.g., a VECTOR3 takes 16 bytes, not 12)
+		TArray< uint32 > FieldBytes;
+		AX_EXPECT_MEMORY( FieldBytes.Reserve( UDT.Members.Num() ) );
+		for( const SMemberInfo &Member : UDT.Members ) {
+			llvm::Type *const pFieldTy = UDT.pLLVMTy->getStructElementType( ( unsigned )Member.iFieldIndex );
+			AX_EXPECT_MEMORY( FieldBytes.Append( ( uint32 )DL.getTypeAllocSize( pFieldTy ) ) );
+		}
+
+		// Each column holds cItems fields back to back, so a column starts at
+		// cItems times the size of the columns before it. Placing the widest
+		// fields first keeps every column aligned to its field size without
+		// any padding between them.
+		TArray< uintptr > Order;
+		AX_EXPECT_MEMORY( Order.Reserve( UDT.Members.Num() ) );
+
+		// Stable insertion sort (types don't have many fields)
+		for( uintptr iMember = 0; iMember < UDT.Members.Num(); ++iMember ) {
+			AX_EXPECT_MEMORY( Order.Append( iMember ) );
+
+			for( uintptr i = Order.Num() - 1; i > 0 && FieldBytes[ Order[ i - 1 ] ] < FieldBytes[ Order[ i ] ]; --i ) {
+				const uintptr uTemp = Order[ i - 1 ];
+				Order[ i - 1 ] = Order[ i ];
+				Order[ i ] = uTemp;
+			}
+		}
+
+		uint32 uOffset = 0;
+		for( uintptr iMember : Order ) {
+			UDT.Members[ iMember ].uColumnOffset = uOffset;
+			uOffset += FieldBytes[ iMember ];
+		}
+
+		UDT.cColumnBytes = uOffset;
+	}
+	void MCodeGen::EmitTypeDescriptor( STypeInfo &UDT )
+	{
+		AX_ASSERT_NOT_NULL( UDT.pLLVMTy );
+
+		if( UDT.pLLVMTypeDesc != nullptr ) {
+			return;
+		}
+
+		unsigned uFlags = 0;
+		if( UDT.bIsInitTrivial ) { uFlags |= kTypeF_TrivialInit; }
+		if( UDT.bIsFiniTrivial ) { uFlags |= kTypeF_TrivialFini; }
+		if( UDT.bIsCopyTrivial ) { uFlags |= kTypeF_TrivialCopy; }
+		if( UDT.bIsMoveTrivial ) { uFlags |= kTypeF_TrivialMove; }
+
+		// Structure-of-arrays items are spread over the columns, with no padding
+		llvm::Constant *const pTySize =
+			UDT.bIsSoA
+			? llvm::ConstantInt::get( llvm::Type::getInt32Ty( m_Context ), ( uint64_t )UDT.cColumnBytes, false )
+			: llvm::ConstantExpr::getTruncOrBitCast( llvm::ConstantExpr::getSizeOf( UDT.pLLVMTy ), llvm::Type::getInt32Ty( m_Context ) );
+
+		const Ax::String Pattern = GetTypePattern( UDT.Members );
+
+		UDT.pLLVMTypeDesc =
+			CreateTypeDescriptor
+			(
+				UDT.Name,
+				Pattern,
+				uFlags,
+				pTySize,
+				UDT.bIsInitTrivial ? nullptr : UDT.pLLVMInitFn,
+				UDT.bIsFiniTrivial ? nullptr : UDT.pLLVMFiniFn,
+				UDT.bIsCopyTrivial ? nullptr : UDT.pLLVMCopyFn,
+				UDT.bIsMoveTrivial ? nullptr : UDT.pLLVMMoveFn
+			);
+	}
+	llvm::GlobalVariable *MCodeGen::CreateTypeDescriptor( const Ax::String &Name, const Ax::String &Pattern, unsigned uFlags, llvm::Constant *pTySize, llvm::Function *pInitFn, llvm::Function *pFiniFn, llvm::Function *pCopyFn, llvm::Function *pMoveFn )
+	{
+		AX_ASSERT_NOT_NULL( pTySize );
+
+		llvm::Type *const pUInt32Ty = llvm::Type::getInt32Ty( m_Context );
+		llvm::StructType *const pRTTITy = llvm::cast< llvm::StructType >( GetRTTIType() );
+
+		const Ax::String *const pStrings[] = { &Name, &Pattern };
+		llvm::Constant *pStringPtrs[ 2 ];
+
+		for( unsigned i = 0; i < 2; ++i ) {
+			llvm::Constant *const pInit =
+				llvm::ConstantDataArray::getString
+				(
+					m_Context,
+					llvm::StringRef( pStrings[ i ]->CString(), ( size_t )pStrings[ i ]->Len() )
+				);
+
+			llvm::GlobalVariable *const pStr =
+				new llvm::GlobalVariable
+				(
+					*m_pModule,
+					pInit->getType(),
+					true,
+					llvm::GlobalValue::PrivateLinkage,
+					pInit
+				);
+			AX_EXPECT_MEMORY( pStr );
+
+			llvm::Constant *const pIndexes[] = {
+				llvm::ConstantInt::get( pUInt32Ty, 0 ),
+				llvm::ConstantInt::get( pUInt32Ty, 0 )
+			};
+			pStringPtrs[ i ] = llvm::ConstantExpr::getInBoundsGetElementPtr( pInit->getType(), pStr, pIndexes );
+		}
+
+		llvm::Constant *const Members[] = {
+			llvm::ConstantInt::get( pUInt32Ty, ( uint64_t )uFlags, false ),
+			pTySize,
+
+			pStringPtrs[ 0 ],
+			pStringPtrs[ 1 ],
+
+			pInitFn != nullptr ? pInitFn : llvm::Constant::getNullValue( GetObjInitFnTy()->getPointerTo() ),
+			pFiniFn != nullptr ? pFiniFn : llvm::Constant::getNullValue( GetObjFiniFnTy()->getPointerTo() ),
+			pCopyFn != nullptr ? pCopyFn : llvm::Constant::getNullValue( GetObjCopyFnTy()->getPointerTo() ),
+			pMoveFn != nullptr ? pMoveFn : llvm::Constant::getNullValue( GetObjMoveFnTy()->getPointerTo() )
+		};
+
+		char szName[ 128 ];
+		Ax::Format( szName, "te.type.%s", Name.CString() );
+
+		llvm::GlobalVariable *const pDesc =
+			new llvm::GlobalVariable
+			(
+				*m_pModule,
+				pRTTITy,
+				true,
+				llvm::GlobalValue::PrivateLinkage,
+				llvm::ConstantStruct::get( pRTTITy, Members ),
+				szName
+			);
+		AX_EXPECT_MEMORY( pDesc );
+
+		return pDesc;
+	}
 
 	void MCodeGen::EmitReflectionData()
 	{
@@ -484,7 +853,7 @@ namespace Tenshi { namespace Compiler {
 		llvm::Constant *const pNullInitFn = llvm::Constant::getNullValue( GetObjInitFnTy()->getPointerTo() );
 		llvm::Constant *const pNullFiniFn = llvm::Constant::getNullValue( GetObjFiniFnTy()->getPointerTo() );
 		llvm::Constant *const pNullCopyFn = llvm::Constant::getNullValue( GetObjCopyFnTy()->getPointerTo() );
-		llvm::Constant *const pNullMoveFn = llvm::Constant::getNullValue( GetObjFiniFnTy()->getPointerTo() );
+		llvm::Constant *const pNullMoveFn = llvm::Constant::getNullValue( GetObjMoveFnTy()->getPointerTo() );
 
 		Ax::TArray< llvm::Constant * > RTTIData;
 		AX_EXPECT_MEMORY( RTTIData.Reserve( cTypes ) );
@@ -0,0 +1,238 @@
+#include "_PCH.hpp"
+#include "CodeGen.hpp"
+#include "Environment.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	using namespace Ax;
+
+	// Operations lowered directly to vector instructions
+	enum class EIntrinsic
+	{
+		None,
+
+		Dot,
+		Cross,
+		Length,
+		Normalize
+	};
+
+	// Intrinsics are declared by the core module (see Module.cpp) and
+	// recognized by the real name of the overload
+	static EIntrinsic FindIntrinsic( const Ax::String &RealName )
+	{
+		static const struct
+		{
+			const char *			pszRealName;
+			EIntrinsic				Intrinsic;
+		} Table[] = {
+			{ "teVec2Dot",			EIntrinsic::Dot },
+			{ "teVec3Dot",			EIntrinsic::Dot },
+			{ "teVec4Dot",			EIntrinsic::Dot },
+			{ "teVec3Cross",		EIntrinsic::Cross },
+			{ "teVec4Cross",		EIntrinsic::Cross },
+			{ "teVec2Length",		EIntrinsic::Length },
+			{ "teVec3Length",		EIntrinsic::Length },
+			{ "teVec4Length",		EIntrinsic::Length },
+			{ "teVec2Normalize",	EIntrinsic::Normalize },
+			{ "teVec3Normalize",	EIntrinsic::Normalize },
+			{ "teVec4Normalize",	EIntrinsic::Normalize }
+		};
+
+		// Every intrinsic is named "teVec..." so most calls are rejected early
+		if( !RealName.StartsWith( "teVec" ) ) {
+			return EIntrinsic::None;
+		}
+
+		for( const auto &Entry : Table ) {
+			if( RealName == Entry.pszRealName ) {
+				return Entry.Intrinsic;
+			}
+		}
+
+		return EIntrinsic::None;
+	}
+
+	// Add up every component of a vector
+	static llvm::Value *EmitHorizontalAdd( llvm::IRBuilder<> &Builder, llvm::Value *pVec )
+	{
+		const unsigned cElements = pVec->getType()->getVectorNumElements();
+		AX_ASSERT( cElements > 0 );
+
+		llvm::Value *pSum = Builder.CreateExtractElement( pVec, Builder.getInt32( 0 ) );
+		for( unsigned i = 1; i < cElements; ++i ) {
+			pSum = Builder.CreateFAdd( pSum, Builder.CreateExtractElement( pVec, Builder.getInt32( i ) ), "hadd" );
+		}
+
+		return pSum;
+	}
+
+	bool MCodeGen::IsIntrinsic( const SFunctionOverload &Func ) const
+	{
+		return FindIntrinsic( Func.RealName ) != EIntrinsic::None;
+	}
+	llvm::Value *MCodeGen::EmitIntrinsic( const SFunctionOverload &Func, llvm::ArrayRef< llvm::Value * > Args )
+	{
+		const EIntrinsic Intrinsic = FindIntrinsic( Func.RealName );
+		AX_ASSERT( Intrinsic != EIntrinsic::None );
+		AX_ASSERT( Args.size() > 0 && Args[ 0 ]->getType()->isVectorTy() );
+
+		llvm::Value *const pA = Args[ 0 ];
+		llvm::Type *const pVecTy = pA->getType();
+		llvm::Type *const pElemTy = pVecTy->getVectorElementType();
+
+		switch( Intrinsic )
+		{
+		case EIntrinsic::None:
+			break;
+
+		case EIntrinsic::Dot:
+			AX_ASSERT( Args.size() == 2 );
+			return EmitHorizontalAdd( m_IRBuilder, m_IRBuilder.CreateFMul( pA, Args[ 1 ], "dot.mul" ) );
+
+		case EIntrinsic::Cross:
+			{
+				AX_ASSERT( Args.size() == 2 );
+
+				// a.yzx*b.zxy - a.zxy*b.yzx (w, if present, ends up as zero)
+				const unsigned cElements = pVecTy->getVectorNumElements();
+				AX_ASSERT( cElements == 3 || cElements == 4 );
+
+				const uint32_t uYZX[] = { 1, 2, 0, 3 };
+				const uint32_t uZXY[] = { 2, 0, 1, 3 };
+
+				llvm::Value *const pYZX = llvm::ConstantDataVector::get( m_Context, llvm::ArrayRef< uint32_t >( uYZX, cElements ) );
+				llvm::Value *const pZXY = llvm::ConstantDataVector::get( m_Context, llvm::ArrayRef< uint32_t >( uZXY, cElements ) );
+				llvm::Value *const pUndef = llvm::UndefValue::get( pVecTy );
+
+				llvm::Value *const pAYZX = m_IRBuilder.CreateShuffleVector( pA, pUndef, pYZX );
+				llvm::Value *const pAZXY = m_IRBuilder.CreateShuffleVector( pA, pUndef, pZXY );
+				llvm::Value *const pBYZX = m_IRBuilder.CreateShuffleVector( Args[ 1 ], pUndef, pYZX );
+				llvm::Value *const pBZXY = m_IRBuilder.CreateShuffleVector( Args[ 1 ], pUndef, pZXY );
+
+				return
+					m_IRBuilder.CreateFSub
+					(
+						m_IRBuilder.CreateFMul( pAYZX, pBZXY ),
+						m_IRBuilder.CreateFMul( pAZXY, pBYZX ),
+						"cross"
+					);
+			}
+
+		case EIntrinsic::Length:
+		case EIntrinsic::Normalize:
+			{
+				AX_ASSERT( Args.size() == 1 );
+
+				llvm::Function *const pSqrtFn = llvm::Intrinsic::getDeclaration( m_pModule, llvm::Intrinsic::sqrt, pElemTy );
+				AX_EXPECT_MEMORY( pSqrtFn );
+
+				llvm::Value *const pLenSq = EmitHorizontalAdd( m_IRBuilder, m_IRBuilder.CreateFMul( pA, pA, "len.sq" ) );
+				llvm::Value *const pLen = m_IRBuilder.CreateCall( pSqrtFn, pLenSq, "len" );
+
+				if( Intrinsic == EIntrinsic::Length ) {
+					return pLen;
+				}
+
+				const unsigned cElements = pVecTy->getVectorNumElements();
+				return m_IRBuilder.CreateFDiv( pA, m_IRBuilder.CreateVectorSplat( cElements, pLen ), "normalize" );
+			}
+		}
+
+		AX_ASSERT_MSG( false, "Unhandled intrinsic" );
+		return nullptr;
+	}
+
+	llvm::Value *MCodeGen::EmitMatrixMultiply( llvm::Value *pMat, llvm::Value *pRHS )
+	{
+		AX_ASSERT_NOT_NULL( pMat );
+		AX_ASSERT_NOT_NULL( pRHS );
+		AX_ASSERT( pMat->getType()->isArrayTy() );
+
+		const unsigned cColumns = ( unsigned )pMat->getType()->getArrayNumElements();
+
+		llvm::Value *pColumns[ 4 ];
+		AX_ASSERT( cColumns <= 4 );
+		for( unsigned i = 0; i < cColumns; ++i ) {
+			pColumns[ i ] = m_IRBuilder.CreateExtractValue( pMat, i, "mat.col" );
+		}
+
+		// M*v is the sum of each column of M scaled by the matching component
+		// of v, so each product is just splats and multiply-adds
+		auto TransformVector = [&]( llvm::Value *pVec ) -> llvm::Value *
+		{
+			llvm::Value *pResult = nullptr;
+
+			for( unsigned i = 0; i < cColumns; ++i ) {
+				llvm::Value *const pComponent = m_IRBuilder.CreateExtractElement( pVec, m_IRBuilder.getInt32( i ) );
+				llvm::Value *const pSplat = m_IRBuilder.CreateVectorSplat( cColumns, pComponent );
+				llvm::Value *const pScaled = m_IRBuilder.CreateFMul( pColumns[ i ], pSplat, "mat.scale" );
+
+				pResult = !pResult ? pScaled : m_IRBuilder.CreateFAdd( pResult, pScaled, "mat.sum" );
+			}
+
+			return pResult;
+		};
+
+		if( pRHS->getType()->isVectorTy() ) {
+			return TransformVector( pRHS );
+		}
+
+		// Each column of the result is M times that column of the right side
+		llvm::Value *pResult = llvm::UndefValue::get( pRHS->getType() );
+		for( unsigned i = 0; i < cColumns; ++i ) {
+			llvm::Value *const pColumn = TransformVector( m_IRBuilder.CreateExtractValue( pRHS, i ) );
+			pResult = m_IRBuilder.CreateInsertValue( pResult, pColumn, i, "matmul" );
+		}
+
+		return pResult;
+	}
+
+	llvm::Constant *MCodeGen::GetBuiltinTypeDescriptor( EBuiltinType BTy )
+	{
+		static const struct
+		{
+			EBuiltinType			Type;
+			const char *			pszName;
+			const char *			pszPattern;
+		} Table[ kNumVectorTypeDescs ] = {
+			{ EBuiltinType::Vector2f, "vector2", "EF21" },
+			{ EBuiltinType::Vector3f, "vector3", "EF31" },
+			{ EBuiltinType::Vector4f, "vector4", "EF41" },
+			{ EBuiltinType::Matrix4f, "matrix4", "EF44" }
+		};
+
+		for( unsigned i = 0; i < kNumVectorTypeDescs; ++i ) {
+			if( Table[ i ].Type != BTy ) {
+				continue;
+			}
+
+			if( !m_pVectorTypeDescs[ i ] ) {
+				// Items are as far apart as LLVM places them, so VECTOR3 items
+				// take 16 bytes and every item stays 16-byte aligned (the array
+				// header is a multiple of 16 bytes on 64-bit targets)
+				llvm::Constant *const pTySize =
+					llvm::ConstantExpr::getTruncOrBitCast
+					(
+						llvm::ConstantExpr::getSizeOf( GetBuiltinType( BTy ) ),
+						llvm::Type::getInt32Ty( m_Context )
+					);
+
+				m_pVectorTypeDescs[ i ] =
+					CreateTypeDescriptor
+					(
+						Table[ i ].pszName,
+						Table[ i ].pszPattern,
+						kTypeF_FullTrivial,
+						pTySize,
+						nullptr, nullptr, nullptr, nullptr
+					);
+			}
+
+			return llvm::ConstantExpr::getPointerCast( m_pVectorTypeDescs[ i ], llvm::Type::getInt8PtrTy( m_Context ) );
+		}
+
+		return nullptr;
+	}
+
+}}
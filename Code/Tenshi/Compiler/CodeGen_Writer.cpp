@@ -20,6 +20,8 @@ namespace Tenshi { namespace Compiler {
 		const char *const file_p = ObjFilename.data();
 		const std::size_t file_n = ObjFilename.size();
 
+		AX_EXPECT_MEMORY( m_ObjFilename.Assign( file_p, ( Ax::intptr )file_n ) );
+
 		std::error_code EC;
 		m_pObjFile = new llvm::tool_output_file( ObjFilename, EC, llvm::sys::fs::F_None );
 		AX_EXPECT_MEMORY( m_pObjFile );
@@ -50,48 +52,273 @@ namespace Tenshi { namespace Compiler {
 		return true;
 	}
 
+	static double MillisecsSince( Ax::uint64 uStartMicrosecs )
+	{
+		return double( Ax::System::Microseconds() - uStartMicrosecs )/1000.0;
+	}
+
+	// Run the module through the backend, writing the result to the stream
+	static bool EmitFile( llvm::TargetMachine &TM, llvm::Module &Mod, llvm::raw_pwrite_stream &OS, llvm::TargetMachine::CodeGenFileType FileType )
+	{
+		const bool noVerify = false;
+		llvm::legacy::PassManager PM;
+
+		//PM.add( new llvm::DataLayoutPass() );
+
+		if( TM.addPassesToEmitFile( PM, OS, FileType, noVerify ) ) {
+			return false;
+		}
+
+		PM.run( Mod );
+		return true;
+	}
+
+	// Turn the assembly the backend produced into an object file with the
+	// integrated assembler (the same way llvm-mc does) so the module doesn't
+	// have to go through instruction selection and register allocation again
+	static bool AssembleListing( llvm::TargetMachine &TM, llvm::SmallString< 0 > &AsmText, llvm::raw_pwrite_stream &OS )
+	{
+		const llvm::Target &Target = TM.getTarget();
+		const llvm::Triple &Triple = TM.getTargetTriple();
+
+		const llvm::MCRegisterInfo &MRI = *TM.getMCRegisterInfo();
+		const llvm::MCAsmInfo &MAI = *TM.getMCAsmInfo();
+		const llvm::MCInstrInfo &MII = *TM.getMCInstrInfo();
+		const llvm::MCSubtargetInfo &STI = *TM.getMCSubtargetInfo();
+		const llvm::MCTargetOptions &MCOptions = TM.Options.MCOptions;
+
+		llvm::SourceMgr SrcMgr;
+		SrcMgr.AddNewSourceBuffer( llvm::MemoryBuffer::getMemBuffer( llvm::StringRef( AsmText.c_str(), AsmText.size() ), "<assembly listing>" ), llvm::SMLoc() );
+
+		llvm::MCObjectFileInfo MOFI;
+		llvm::MCContext Ctx( &MAI, &MRI, &MOFI, &SrcMgr );
+		MOFI.InitMCObjectFileInfo( Triple, TM.getRelocationModel() == llvm::Reloc::PIC_, TM.getCodeModel(), Ctx );
+
+		// The streamer takes ownership of these
+		llvm::MCCodeEmitter *const pEmitter = Target.createMCCodeEmitter( MII, MRI, Ctx );
+		llvm::MCAsmBackend *const pAsmBackend = Target.createMCAsmBackend( MRI, Triple.getTriple(), TM.getTargetCPU() );
+		if( !pEmitter || !pAsmBackend ) {
+			delete pEmitter;
+			delete pAsmBackend;
+			return false;
+		}
+
+		std::unique_ptr< llvm::MCStreamer > Streamer( Target.createMCObjectStreamer( Triple, Ctx, *pAsmBackend, OS, pEmitter, STI, MCOptions.MCRelaxAll, MCOptions.MCIncrementalLinkerCompatible, false ) );
+		AX_EXPECT_MEMORY( Streamer );
+
+		std::unique_ptr< llvm::MCAsmParser > Parser( llvm::createMCAsmParser( SrcMgr, Ctx, *Streamer, MAI ) );
+		AX_EXPECT_MEMORY( Parser );
+
+		std::unique_ptr< llvm::MCTargetAsmParser > TargetParser( Target.createMCAsmParser( STI, *Parser, MII, MCOptions ) );
+		if( !TargetParser ) {
+			return false;
+		}
+
+		Parser->setTargetParser( *TargetParser );
+
+		// Returns true on failure
+		return !Parser->Run( false );
+	}
+
+	// Name of the object file for the given part ("x.o" -> "x.part1.o")
+	static Ax::String PartitionFilename( const Ax::String &ObjFilename, unsigned uPart )
+	{
+		const Ax::String Ext = ObjFilename.ExtractExtension();
+		const Ax::String Base( ObjFilename, ( Ax::intptr )0, ( Ax::intptr )( ObjFilename.Len() - Ext.Len() ) );
+
+		return Ax::String::Formatted( "%s.part%u%s", Base.CString(), uPart, Ext.CString() );
+	}
+
+	void MCodeGen::MakeLocalsUnique()
+	{
+		AX_ASSERT_NOT_NULL( m_pModule );
+
+		/*
+			The module splitter turns internal symbols into hidden globals so
+			the parts can refer to each other. Hidden still clashes with the
+			same name from another unit when everything gets linked, so prefix
+			them with something particular to this unit first.
+		*/
+		const std::string Prefix = Ax::String::Formatted( "u%08x.", ( unsigned )( size_t )llvm::hash_value( m_pModule->getSourceFileName() ) ).CString();
+
+		auto MakeUnique = [&]( llvm::GlobalValue &GV )
+		{
+			if( !GV.hasLocalLinkage() ) {
+				return;
+			}
+
+			GV.setName( Prefix + ( GV.hasName() ? GV.getName().str() : std::string( "anon" ) ) );
+		};
+
+		for( llvm::Function &Func : *m_pModule ) {
+			MakeUnique( Func );
+		}
+		for( llvm::GlobalVariable &Var : m_pModule->globals() ) {
+			MakeUnique( Var );
+		}
+		for( llvm::GlobalAlias &Alias : m_pModule->aliases() ) {
+			MakeUnique( Alias );
+		}
+	}
+	bool MCodeGen::EmitPartitions()
+	{
+		AX_ASSERT_NOT_NULL( m_pModule );
+		AX_ASSERT_NOT_NULL( m_pObjFile );
+
+		// Never more parts than there are functions to go in them
+		unsigned cFuncs = 0;
+		for( const llvm::Function &Func : *m_pModule ) {
+			cFuncs += +!Func.isDeclaration();
+		}
+		const unsigned cParts = m_cPartitions < cFuncs ? m_cPartitions : cFuncs;
+
+		if( cParts < 2 ) {
+			return EmitFile( *m_pTargetMachine, *m_pModule, m_pObjFile->os(), llvm::TargetMachine::CGFT_ObjectFile );
+		}
+
+		MakeLocalsUnique();
+
+		Ax::TArray< llvm::tool_output_file * > PartFiles;
+		llvm::SmallVector< llvm::raw_pwrite_stream *, 16 > Streams;
+
+		AX_EXPECT_MEMORY( PartFiles.Reserve( cParts - 1 ) );
+		Streams.push_back( &m_pObjFile->os() );
+
+		bool bResult = true;
+		for( unsigned uPart = 1; uPart < cParts; ++uPart ) {
+			const Ax::String PartFilename = PartitionFilename( m_ObjFilename, uPart );
+
+			std::error_code EC;
+			llvm::tool_output_file *const pPartFile = new llvm::tool_output_file( LLVMStr( PartFilename ), EC, llvm::sys::fs::F_None );
+			AX_EXPECT_MEMORY( pPartFile );
+			AX_EXPECT_MEMORY( PartFiles.Append( pPartFile ) );
+
+			if( EC ) {
+				Ax::Errorf( PartFilename, "%s", EC.message().c_str() );
+				bResult = false;
+				break;
+			}
+
+			AX_EXPECT_MEMORY( m_PartitionObjs.Append( PartFilename ) );
+			Streams.push_back( &pPartFile->os() );
+		}
+
+		if( bResult ) {
+			const std::string TripleName = m_pModule->getTargetTriple();
+
+			// Each part is moved into a context of its own and handed to a
+			// thread with a target machine of its own
+			std::unique_ptr< llvm::Module > pRemaining =
+				llvm::splitCodeGen
+				(
+					std::unique_ptr< llvm::Module >( m_pModule ),
+					Streams,
+					llvm::ArrayRef< llvm::raw_pwrite_stream * >(),
+					[this, TripleName]()
+					{
+						return std::unique_ptr< llvm::TargetMachine >( CreateTargetMachine( TripleName ) );
+					},
+					llvm::TargetMachine::CGFT_ObjectFile
+				);
+
+			// The module (and everything in it) is gone once it's been split
+			m_pModule = pRemaining.release();
+			if( !m_pModule ) {
+				m_pEntryFunc = nullptr;
+				m_pCurrentFunc = nullptr;
+				m_pCurrentBlock = nullptr;
+			}
+
+			for( llvm::tool_output_file *pPartFile : PartFiles ) {
+				pPartFile->keep();
+			}
+		} else {
+			m_PartitionObjs.Clear();
+		}
+
+		for( llvm::tool_output_file *pPartFile : PartFiles ) {
+			delete pPartFile;
+		}
+
+		return bResult;
+	}
+
 	bool MCodeGen::WriteOutputs()
 	{
 		AX_ASSERT_NOT_NULL( m_pModule );
 		AX_ASSERT_NOT_NULL( m_pPM );
+		AX_ASSERT_NOT_NULL( m_pTargetMachine );
 
-		m_pPM->run( *m_pModule );
+		m_PartitionObjs.Clear();
 
-		const bool noVerify = false;
+		// Nothing gets written out with Tenshi IR operations left in it
+		LowerIR();
 
-		if( m_pAsmFile != nullptr ) {
-			llvm::legacy::PassManager AsmPM;
-			llvm::raw_pwrite_stream *AsmFOS = &m_pAsmFile->os();
+		Ax::uint64 uStartMicrosecs = Ax::System::Microseconds();
+		m_pPM->run( *m_pModule );
+		g_VerboseLog += Ax::String::Formatted( "IR passes: %.3f ms", MillisecsSince( uStartMicrosecs ) );
 
-			//AsmPM.add( new llvm::DataLayoutPass() );
+		if( m_pAsmFile != nullptr && m_pObjFile != nullptr ) {
+			// Lower the module once, to assembly, then assemble the object
+			// file from that instead of running the backend a second time
+			llvm::SmallString< 0 > AsmText;
 
-			if( m_pTargetMachine->addPassesToEmitFile( AsmPM, *AsmFOS, llvm::TargetMachine::CGFT_AssemblyFile, noVerify ) ) {
-				Ax::BasicErrorf( "Target does not support assembly output" );
-				return false;
+			uStartMicrosecs = Ax::System::Microseconds();
+			{
+				llvm::raw_svector_ostream AsmOS( AsmText );
+				if( !EmitFile( *m_pTargetMachine, *m_pModule, AsmOS, llvm::TargetMachine::CGFT_AssemblyFile ) ) {
+					Ax::BasicErrorf( "Target does not support assembly output" );
+					return false;
+				}
 			}
+			const double BackendMillisecs = MillisecsSince( uStartMicrosecs );
 
-			AsmPM.run( *m_pModule );
+			m_pAsmFile->os() << AsmText.str();
 			m_pAsmFile->keep();
-		}
 
-		delete m_pAsmFile;
-		m_pAsmFile = nullptr;
+			uStartMicrosecs = Ax::System::Microseconds();
+			if( !AssembleListing( *m_pTargetMachine, AsmText, m_pObjFile->os() ) ) {
+				Ax::BasicErrorf( "Failed to assemble the object file from the assembly listing" );
+				return false;
+			}
+			const double AssembleMillisecs = MillisecsSince( uStartMicrosecs );
+
+			m_pObjFile->keep();
 
-		if( m_pObjFile != nullptr ) {
-			llvm::legacy::PassManager ObjPM;
-			llvm::raw_pwrite_stream *ObjFOS = &m_pObjFile->os();
+			g_VerboseLog += Ax::String::Formatted( "Backend: %.3f ms; object assembled from the listing in %.3f ms (saved %.3f ms over lowering the module again)",
+				BackendMillisecs, AssembleMillisecs, BackendMillisecs - AssembleMillisecs );
+		} else if( m_pAsmFile != nullptr ) {
+			uStartMicrosecs = Ax::System::Microseconds();
+			if( !EmitFile( *m_pTargetMachine, *m_pModule, m_pAsmFile->os(), llvm::TargetMachine::CGFT_AssemblyFile ) ) {
+				Ax::BasicErrorf( "Target does not support assembly output" );
+				return false;
+			}
+			m_pAsmFile->keep();
 
-			//ObjPM.add( new llvm::DataLayoutPass() );
+			g_VerboseLog += Ax::String::Formatted( "Backend: %.3f ms", MillisecsSince( uStartMicrosecs ) );
+		} else if( m_pObjFile != nullptr && m_cPartitions > 1 ) {
+			uStartMicrosecs = Ax::System::Microseconds();
+			if( !EmitPartitions() ) {
+				Ax::BasicErrorf( "Failed to write the partitioned object files" );
+				return false;
+			}
+			m_pObjFile->keep();
 
-			if( m_pTargetMachine->addPassesToEmitFile( ObjPM, *ObjFOS, llvm::TargetMachine::CGFT_ObjectFile, noVerify ) ) {
+			g_VerboseLog += Ax::String::Formatted( "Backend: %.3f ms (%u parts)", MillisecsSince( uStartMicrosecs ), 1 + ( unsigned )m_PartitionObjs.Num() );
+		} else if( m_pObjFile != nullptr ) {
+			uStartMicrosecs = Ax::System::Microseconds();
+			if( !EmitFile( *m_pTargetMachine, *m_pModule, m_pObjFile->os(), llvm::TargetMachine::CGFT_ObjectFile ) ) {
 				Ax::BasicErrorf( "Target does not support object output" );
 				return false;
 			}
-
-			ObjPM.run( *m_pModule );
 			m_pObjFile->keep();
+
+			g_VerboseLog += Ax::String::Formatted( "Backend: %.3f ms", MillisecsSince( uStartMicrosecs ) );
 		}
 
+		delete m_pAsmFile;
+		m_pAsmFile = nullptr;
+
 		delete m_pObjFile;
 		m_pObjFile = nullptr;
 
@@ -105,6 +332,8 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		LowerIR();
+
 		OS << *m_pModule;
 		return true;
 	}
@@ -116,6 +345,8 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		LowerIR();
+
 		llvm::WriteBitcodeToFile( m_pModule, OS );
 		return true;
 	}
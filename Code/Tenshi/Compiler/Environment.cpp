@@ -13,7 +13,7 @@ namespace Tenshi { namespace Compiler {
 	}
 
 	CEnvironment::CEnvironment()
-	: m_Dictionary()
+	: m_Dictionary( Ax::SMemtag( kMemtag_Symbols ) )
 	, m_Modules()
 	, m_BuildInfo()
 	, m_IntPtrRTy()
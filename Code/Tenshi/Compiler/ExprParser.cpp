@@ -48,10 +48,374 @@ namespace Tenshi { namespace Compiler {
 		case EBuiltinOp::StrRemove:						return "[str]-";
 		case EBuiltinOp::StrRepeat:						return "[str]*";
 		case EBuiltinOp::StrAddPath:					return "[str]/";
+
+		case EBuiltinOp::MatMul:						return "[mat]*";
 		}
 
 		return "(Op:Unknown)";
 	}
+
+	/*
+	===========================================================================
+
+		CONSTANT FOLDING
+
+		Expressions made up entirely of literals are evaluated during Semant()
+		and are emitted as a single constant by CodeGen(). The evaluation has
+		to match what the generated code (or the runtime) would produce, so
+		anything that can't be reproduced exactly (e.g., division by zero or
+		real-to-string conversion) is left alone.
+
+	===========================================================================
+	*/
+
+	// Longest string that will be produced by folding (avoid bloating the data section)
+	static const uintptr kMaxFoldedStringLen = 4096;
+
+	static bool IsFoldableType( EBuiltinType T )
+	{
+		if( T == EBuiltinType::ConstUTF8Pointer || T == EBuiltinType::StringObject ) {
+			return true;
+		}
+		if( T == EBuiltinType::Float32 || T == EBuiltinType::Float64 ) {
+			return true;
+		}
+
+		return IsIntNumber( T ) && GetBuiltinTypeInfo( T ).cBits <= 64;
+	}
+	static uint64 SignExtendBits( uint64 u, unsigned cBits )
+	{
+		if( cBits >= 64 ) {
+			return u;
+		}
+
+		const uint64 m = uint64( 1 )<<( cBits - 1 );
+		return ( ( u & ( ( m<<1 ) - 1 ) ) ^ m ) - m;
+	}
+	static uint64 ZeroExtendBits( uint64 u, unsigned cBits )
+	{
+		if( cBits >= 64 ) {
+			return u;
+		}
+
+		return u & ( ( uint64( 1 )<<cBits ) - 1 );
+	}
+	// Wrap an integer to the range of the given type
+	static uint64 WrapToType( EBuiltinType T, uint64 u )
+	{
+		const unsigned cBits = GetBuiltinTypeInfo( T ).cBits;
+		return IsSigned( T ) ? SignExtendBits( u, cBits ) : ZeroExtendBits( u, cBits );
+	}
+	// Round a real number to the precision of the given type
+	static double RoundToType( EBuiltinType T, double f )
+	{
+		return T == EBuiltinType::Float32 ? double( float( f ) ) : f;
+	}
+
+	// Apply a cast to a constant
+	static bool FoldCast( ECast CastOp, EBuiltinType DstType, const SConstant &In, SConstant &Out )
+	{
+		AX_ASSERT( In.IsValid() );
+
+		if( !IsFoldableType( DstType ) ) {
+			return false;
+		}
+
+		// Booleans are widened inconsistently by the code generator; leave those be
+		if( In.Type == EBuiltinType::Boolean && CastOp != ECast::None && DstType != EBuiltinType::Boolean ) {
+			return false;
+		}
+
+		const unsigned cSrcBits = GetBuiltinTypeInfo( In.Type ).cBits;
+
+		Out.Type = DstType;
+		Out.uValue = 0;
+		Out.Text.Clear();
+
+		switch( CastOp )
+		{
+		case ECast::None:
+			if( IsString( DstType ) != IsString( In.Type ) || IsRealNumber( DstType ) != IsRealNumber( In.Type ) ) {
+				return false;
+			}
+
+			if( IsString( DstType ) ) {
+				AX_EXPECT_MEMORY( Out.Text.Assign( In.Text ) );
+			} else if( IsRealNumber( DstType ) ) {
+				Out.fValue = RoundToType( DstType, In.fValue );
+			} else {
+				Out.uValue = WrapToType( DstType, In.uValue );
+			}
+			return true;
+
+		case ECast::SignExtend:
+			Out.uValue = WrapToType( DstType, SignExtendBits( In.uValue, cSrcBits ) );
+			return true;
+		case ECast::ZeroExtend:
+			Out.uValue = WrapToType( DstType, ZeroExtendBits( In.uValue, cSrcBits ) );
+			return true;
+		case ECast::SignTrunc:
+		case ECast::ZeroTrunc:
+			Out.uValue = WrapToType( DstType, In.uValue );
+			return true;
+
+		case ECast::RealExtend:
+		case ECast::RealTrunc:
+			Out.fValue = RoundToType( DstType, In.fValue );
+			return true;
+
+		case ECast::SignedIntToFloat:
+			Out.fValue = RoundToType( DstType, double( In.iValue ) );
+			return true;
+		case ECast::UnsignedIntToFloat:
+			Out.fValue = RoundToType( DstType, double( In.uValue ) );
+			return true;
+
+		case ECast::FloatToSignedInt:
+			// Out of range conversions have no defined result
+			if( !( In.fValue > -9223372036854775808.0 - 1.0 && In.fValue < 9223372036854775808.0 ) ) {
+				return false;
+			}
+			Out.uValue = WrapToType( DstType, uint64( int64( In.fValue ) ) );
+			return true;
+		case ECast::FloatToUnsignedInt:
+			if( !( In.fValue > -1.0 && In.fValue < 18446744073709551616.0 ) ) {
+				return false;
+			}
+			Out.uValue = WrapToType( DstType, uint64( In.fValue ) );
+			return true;
+
+		case ECast::IntToBool:
+			Out.uValue = +( In.uValue != 0 );
+			return true;
+		case ECast::FloatToBool:
+			Out.uValue = +( In.fValue < 0.0 || In.fValue > 0.0 );
+			return true;
+		case ECast::PtrToBool:
+			// String constants always have storage
+			Out.uValue = 1;
+			return true;
+
+		case ECast::Int8ToStr:
+		case ECast::Int16ToStr:
+		case ECast::Int32ToStr:
+		case ECast::Int64ToStr:
+			AX_EXPECT_MEMORY( Out.Text.Format( "%lld", ( long long )In.iValue ) );
+			return true;
+		case ECast::UInt8ToStr:
+		case ECast::UInt16ToStr:
+		case ECast::UInt32ToStr:
+		case ECast::UInt64ToStr:
+			AX_EXPECT_MEMORY( Out.Text.Format( "%llu", ( unsigned long long )In.uValue ) );
+			return true;
+
+		case ECast::UTF8PtrToStr:
+			AX_EXPECT_MEMORY( Out.Text.Assign( In.Text ) );
+			return true;
+
+		default:
+			// FIXME: Real-to-string is formatted by the runtime; match it here
+			break;
+		}
+
+		return false;
+	}
+	// Apply a unary operator to a constant (already cast to the operation's type)
+	static bool FoldUnaryOp( EBuiltinOp Op, EBuiltinType Type, const SConstant &In, SConstant &Out )
+	{
+		if( !IsFoldableType( Type ) ) {
+			return false;
+		}
+
+		Out.Type = Type;
+		Out.uValue = 0;
+		Out.Text.Clear();
+
+		switch( Op )
+		{
+		case EBuiltinOp::Neg:
+			if( IsRealNumber( Type ) ) {
+				Out.fValue = -In.fValue;
+				return true;
+			}
+			if( IsIntNumber( Type ) ) {
+				Out.uValue = WrapToType( Type, uint64( 0 ) - In.uValue );
+				return true;
+			}
+			break;
+
+		case EBuiltinOp::RelNot:
+			Out.uValue = +( In.uValue == 0 );
+			return true;
+
+		default:
+			break;
+		}
+
+		return false;
+	}
+	// Apply a binary operator to two constants (already cast to the operation's types)
+	static bool FoldBinaryOp( EBuiltinOp Op, EBuiltinType OpType, EBuiltinType ResultType, const SConstant &L, const SConstant &R, SConstant &Out )
+	{
+		if( !IsFoldableType( OpType ) || !IsFoldableType( ResultType ) ) {
+			return false;
+		}
+
+		Out.Type = ResultType;
+		Out.uValue = 0;
+		Out.Text.Clear();
+
+		const bool bIsString = IsString( OpType );
+		const bool bIsFloat = !bIsString && IsRealNumber( OpType );
+		const bool bIsInt = !bIsString && !bIsFloat;
+		const bool bIsSigned = bIsInt && IsSigned( OpType );
+
+		const unsigned cBits = GetBuiltinTypeInfo( OpType ).cBits;
+
+		if( IsCmpOp( Op ) ) {
+			int iCmp = 0;
+			bool bOrdered = true;
+
+			if( bIsString ) {
+				iCmp = strcmp( L.Text.CString(), R.Text.CString() );
+			} else if( bIsFloat ) {
+				bOrdered = L.fValue == L.fValue && R.fValue == R.fValue;
+				iCmp = L.fValue < R.fValue ? -1 : L.fValue > R.fValue ? 1 : 0;
+			} else if( bIsSigned ) {
+				iCmp = L.iValue < R.iValue ? -1 : L.iValue > R.iValue ? 1 : 0;
+			} else {
+				iCmp = L.uValue < R.uValue ? -1 : L.uValue > R.uValue ? 1 : 0;
+			}
+
+			// All comparisons against NaN are false (ordered comparisons)
+			bool bResult = false;
+			switch( Op )
+			{
+			case EBuiltinOp::CmpEq:		bResult = bOrdered && iCmp == 0; break;
+			case EBuiltinOp::CmpNe:		bResult = bOrdered && iCmp != 0; break;
+			case EBuiltinOp::CmpLt:		bResult = bOrdered && iCmp <  0; break;
+			case EBuiltinOp::CmpGt:		bResult = bOrdered && iCmp >  0; break;
+			case EBuiltinOp::CmpLe:		bResult = bOrdered && iCmp <= 0; break;
+			case EBuiltinOp::CmpGe:		bResult = bOrdered && iCmp >= 0; break;
+			default:
+				return false;
+			}
+
+			Out.uValue = +bResult;
+			return true;
+		}
+
+		switch( Op )
+		{
+		case EBuiltinOp::RelAnd:
+			Out.uValue = +( L.uValue != 0 && R.uValue != 0 );
+			return true;
+		case EBuiltinOp::RelOr:
+			Out.uValue = +( L.uValue != 0 || R.uValue != 0 );
+			return true;
+
+		case EBuiltinOp::StrConcat:
+			if( L.Text.Len() + R.Text.Len() > kMaxFoldedStringLen ) {
+				return false;
+			}
+
+			AX_EXPECT_MEMORY( Out.Text.Assign( L.Text ) );
+			AX_EXPECT_MEMORY( Out.Text.Append( R.Text ) );
+			return true;
+		case EBuiltinOp::StrRepeat:
+			// The runtime yields a null string for empty results; keep that behavior
+			if( L.Text.IsEmpty() || !R.uValue || R.uValue > kMaxFoldedStringLen/L.Text.Len() ) {
+				return false;
+			}
+
+			for( uint64 i = 0; i < R.uValue; ++i ) {
+				AX_EXPECT_MEMORY( Out.Text.Append( L.Text ) );
+			}
+			return true;
+
+		default:
+			break;
+		}
+
+		if( bIsString ) {
+			return false;
+		}
+
+		if( bIsFloat ) {
+			switch( Op )
+			{
+			case EBuiltinOp::Add:	Out.fValue = RoundToType( ResultType, L.fValue + R.fValue ); return true;
+			case EBuiltinOp::Sub:	Out.fValue = RoundToType( ResultType, L.fValue - R.fValue ); return true;
+			case EBuiltinOp::Mul:	Out.fValue = RoundToType( ResultType, L.fValue*R.fValue ); return true;
+			case EBuiltinOp::Div:	Out.fValue = RoundToType( ResultType, L.fValue/R.fValue ); return true;
+			case EBuiltinOp::Mod:	Out.fValue = RoundToType( ResultType, fmod( L.fValue, R.fValue ) ); return true;
+			default:
+				break;
+			}
+
+			return false;
+		}
+
+		AX_ASSERT( bIsInt );
+
+		switch( Op )
+		{
+		case EBuiltinOp::Add:
+			Out.uValue = WrapToType( ResultType, L.uValue + R.uValue );
+			return true;
+		case EBuiltinOp::Sub:
+			Out.uValue = WrapToType( ResultType, L.uValue - R.uValue );
+			return true;
+		case EBuiltinOp::Mul:
+			Out.uValue = WrapToType( ResultType, L.uValue*R.uValue );
+			return true;
+
+		case EBuiltinOp::Div:
+		case EBuiltinOp::Mod:
+			// Division by zero (and overflowing division) is left to run-time
+			if( !R.uValue || ( bIsSigned && cBits == 64 && R.iValue == -1 && L.uValue == ( uint64( 1 )<<63 ) ) ) {
+				return false;
+			}
+
+			if( bIsSigned ) {
+				Out.uValue = WrapToType( ResultType, uint64( Op == EBuiltinOp::Div ? L.iValue/R.iValue : L.iValue%R.iValue ) );
+			} else {
+				Out.uValue = WrapToType( ResultType, Op == EBuiltinOp::Div ? L.uValue/R.uValue : L.uValue%R.uValue );
+			}
+			return true;
+
+		case EBuiltinOp::BitAnd:
+			Out.uValue = WrapToType( ResultType, L.uValue & R.uValue );
+			return true;
+		case EBuiltinOp::BitOr:
+			Out.uValue = WrapToType( ResultType, L.uValue | R.uValue );
+			return true;
+		case EBuiltinOp::BitXor:
+			Out.uValue = WrapToType( ResultType, L.uValue ^ R.uValue );
+			return true;
+
+		case EBuiltinOp::BitSL:
+		case EBuiltinOp::BitSR:
+			// Shifting by the width of the type (or more) has no defined result
+			if( R.uValue >= cBits ) {
+				return false;
+			}
+
+			if( Op == EBuiltinOp::BitSL ) {
+				Out.uValue = WrapToType( ResultType, L.uValue<<R.uValue );
+			} else if( bIsSigned ) {
+				Out.uValue = WrapToType( ResultType, uint64( L.iValue>>R.uValue ) );
+			} else {
+				Out.uValue = WrapToType( ResultType, L.uValue>>R.uValue );
+			}
+			return true;
+
+		default:
+			break;
+		}
+
+		return false;
+	}
 	
 	/*
 	===========================================================================
@@ -144,6 +508,7 @@ namespace Tenshi { namespace Compiler {
 	, m_ValueI( 0 )
 	, m_SizeInBits( 0 )
 	, m_Type()
+	, m_Constant()
 	{
 		memset( &m_CodeGen, 0, sizeof( m_CodeGen ) );
 	}
@@ -155,6 +520,10 @@ namespace Tenshi { namespace Compiler {
 	{
 		return &m_Type;
 	}
+	const SConstant *CLiteralExpr::GetConstant() const
+	{
+		return m_Constant.IsValid() ? &m_Constant : nullptr;
+	}
 
 	Ax::String CLiteralExpr::ToString() const
 	{
@@ -187,6 +556,9 @@ namespace Tenshi { namespace Compiler {
 				}
 
 				m_ValueI = Token().uLiteral;
+
+				m_Constant.Type = m_Type.BuiltinType;
+				m_Constant.fValue = RoundToType( m_Type.BuiltinType, Token().GetEncodedFloat() );
 			} else {
 				const uint64 u = Token().uLiteral;
 				const int64 v_ = ( int64 )u;
@@ -267,6 +639,9 @@ namespace Tenshi { namespace Compiler {
 				}
 
 				m_ValueI = u;
+
+				m_Constant.Type = m_Type.BuiltinType;
+				m_Constant.uValue = WrapToType( m_Type.BuiltinType, u );
 			}
 
 			m_Type.cBytes = m_SizeInBits/8 + ( +( m_SizeInBits%8 != 0 ) );
@@ -281,6 +656,9 @@ namespace Tenshi { namespace Compiler {
 			m_Type.cBytes = ( Ax::uint32 )Token().Data.cBytes;
 			// NOTE: The data shouldn't be actively modified at this point
 			m_pValue = ( Ax::uint8 * )Token().pSource->GetData().Pointer( Token().Data.uOffset );
+
+			m_Constant.Type = m_Type.BuiltinType;
+			AX_EXPECT_MEMORY( m_Constant.Text.Assign( ( const char * )m_pValue, ( intptr )Token().Data.cBytes - 1 ) );
 		}
 
 		return true;
@@ -424,7 +802,24 @@ namespace Tenshi { namespace Compiler {
 
 			if( pSym->pFunc != nullptr ) {
 				AX_ASSERT( !pSym->pFunc->Overloads.IsEmpty() );
-				pSym->Translated.pValue = pSym->pFunc->Overloads.First()->pLLVMFunc;
+
+				// Functions are only declared once something refers to them
+				SFunctionOverload &Overload = *pSym->pFunc->Overloads.First();
+				if( !Overload.GenDecl() ) {
+					Token().Error( "[CodeGen] Failed to declare function" );
+					return SValue();
+				}
+
+				pSym->Translated.pValue = Overload.pLLVMFunc;
+			}
+		}
+
+		// The function might be called through its address at any point later
+		if( m_Semanted.pSym->pFunc != nullptr ) {
+			for( const SFunctionOverload &Overload : m_Semanted.pSym->pFunc->Overloads ) {
+				if( Overload.pModule != nullptr ) {
+					CG->EmitModuleInit( *Overload.pModule );
+				}
 			}
 		}
 
@@ -509,6 +904,16 @@ namespace Tenshi { namespace Compiler {
 		if( m_Semanted.cSwizzleMaxAxes != 0 ) {
 			const SToken &Tok = Token();
 
+			if( GetTypeRows( pType->BuiltinType ) > 1 && !IsSIMD( pType->BuiltinType ) ) {
+				Tok.Error( "Matrices cannot be swizzled" );
+				return false;
+			}
+
+			// SIMD types keep their lanes in rows
+			if( IsSIMD( pType->BuiltinType ) ) {
+				m_Semanted.cSwizzleMaxAxes = ( Ax::uint8 )GetTypeRows( pType->BuiltinType );
+			}
+
 			const EBuiltinType ComponentType = GetVectorTypeComponentType( pType->BuiltinType );
 			const EBuiltinType SwizzleType = GetVectorSwizzleType( ComponentType, ( unsigned )Tok.cLength );
 
@@ -541,6 +946,11 @@ namespace Tenshi { namespace Compiler {
 					Tok.Error( "Invalid swizzle component \'" + Ax::String( pszText[i] ) + "\'; expected x,y,z,w or r,g,b,a" );
 					return false;
 				}
+
+				if( ( Ax::uint8 )v[ i ] >= m_Semanted.cSwizzleMaxAxes ) {
+					Tok.Error( "Swizzle component \'" + Ax::String( pszText[i] ) + "\' is out of range for \"" + pType->ToString() + "\"" );
+					return false;
+				}
 			}
 
 			// Store the parsed swizzle mask
@@ -548,7 +958,12 @@ namespace Tenshi { namespace Compiler {
 
 			// Get the axis type
 			m_Semanted.SwizzleType.BuiltinType = SwizzleType;
+			//
+			//	FIXME: Only single components can be assigned to for now, as
+			//	-      SValue has no way to represent a partial vector store
+			//
 			m_Semanted.SwizzleType.Access =
+				m_Semanted.cSwizzleAxes == 1 &&
 				SwizzleIsLValue( m_Semanted.uSwizzleMask, m_Semanted.cSwizzleAxes, m_Semanted.cSwizzleMaxAxes ) ?
 				EAccess::ReadWrite :
 				EAccess::ReadOnly;
@@ -582,6 +997,10 @@ namespace Tenshi { namespace Compiler {
 	}
 	SValue CMemberExpr::CodeGen()
 	{
+		if( m_Semanted.cSwizzleAxes != 0 ) {
+			return CodeGenSwizzle();
+		}
+
 		AX_ASSERT_NOT_NULL( m_Semanted.pSym );
 		AX_ASSERT_NOT_NULL( m_Semanted.pSym->pVar );
 		AX_ASSERT( m_Semanted.pSym->pVar->iFieldIndex >= 0 );
@@ -599,6 +1018,14 @@ namespace Tenshi { namespace Compiler {
 
 		llvm::ArrayRef< llvm::Value * > ValuesRef( Values );
 
+		// Fields of structure-of-arrays items are stored in separate columns
+		if( m_pLHS->Is( EExprType::ArraySubscript ) ) {
+			CArraySubscriptExpr *const pSubscript = static_cast< CArraySubscriptExpr * >( m_pLHS );
+			if( pSubscript->IsColumnAccess() ) {
+				return pSubscript->CodeGenColumn( *Sym.pVar );
+			}
+		}
+
 		SValue LeftVal = m_pLHS->CodeGen();
 		if( !LeftVal ) {
 			return nullptr;
@@ -617,6 +1044,52 @@ namespace Tenshi { namespace Compiler {
 
 		return SValue( pGEP, LeftVal.IsVolatile() );
 	}
+	SValue CMemberExpr::CodeGenSwizzle()
+	{
+		AX_ASSERT( m_Semanted.cSwizzleAxes > 0 && m_Semanted.cSwizzleAxes <= 4 );
+
+		llvm::IRBuilder<> &Builder = CG->Builder();
+
+		SValue LeftVal = m_pLHS->CodeGen();
+		if( !LeftVal ) {
+			return nullptr;
+		}
+
+		llvm::Type *const pVecTy =
+			LeftVal.IsAddress() ?
+			LeftVal.pLLVMValue->getType()->getPointerElementType() :
+			LeftVal.pLLVMValue->getType();
+		if( !pVecTy->isVectorTy() ) {
+			Token().Error( "[CodeGen] Swizzles are only supported on vector types" );
+			return nullptr;
+		}
+
+		// Axis i is stored in bits 7-6 for i=0, 5-4 for i=1, and so on
+		uint32_t uAxes[ 4 ];
+		for( unsigned i = 0; i < m_Semanted.cSwizzleAxes; ++i ) {
+			uAxes[ i ] = ( m_Semanted.uSwizzleMask>>( 6 - i*2 ) ) & 3;
+		}
+
+		// A single component can be addressed directly (so it can be assigned)
+		if( m_Semanted.cSwizzleAxes == 1 ) {
+			if( LeftVal.IsAddress() ) {
+				llvm::Value *const pIndexes[] = {
+					Builder.getInt32( 0 ),
+					Builder.getInt32( uAxes[ 0 ] )
+				};
+
+				llvm::Value *const pGEP = Builder.CreateInBoundsGEP( LeftVal.pLLVMValue, pIndexes, LLVMStr( Token() ) );
+				return SValue( pGEP, LeftVal.IsVolatile() );
+			}
+
+			return Builder.CreateExtractElement( LeftVal.pLLVMValue, Builder.getInt32( uAxes[ 0 ] ), LLVMStr( Token() ) );
+		}
+
+		llvm::Value *const pVec = LeftVal.Load();
+		llvm::Value *const pMask = llvm::ConstantDataVector::get( CG->Context(), llvm::ArrayRef< uint32_t >( uAxes, m_Semanted.cSwizzleAxes ) );
+
+		return Builder.CreateShuffleVector( pVec, llvm::UndefValue::get( pVecTy ), pMask, LLVMStr( Token() ) );
+	}
 
 
 	/*
@@ -730,13 +1203,17 @@ namespace Tenshi { namespace Compiler {
 
 		return true;
 	}
-	SValue CArraySubscriptExpr::CodeGen()
+	bool CArraySubscriptExpr::IsColumnAccess() const
+	{
+		return
+			m_Semanted.Type.BuiltinType == EBuiltinType::UserDefined &&
+			m_Semanted.Type.pCustomType != nullptr &&
+			m_Semanted.Type.pCustomType->bIsSoA;
+	}
+	llvm::Value *CArraySubscriptExpr::CodeGenIndex( llvm::Type *pArrTy, llvm::Value *&pOutArr )
 	{
-		//
-		//	TODO: Safety code (make sure no index exceeds its bounds)
-		//
-
 		AX_ASSERT_NOT_NULL( m_pLHS );
+		AX_ASSERT_NOT_NULL( pArrTy );
 		AX_ASSERT( m_Semanted.Type.BuiltinType != EBuiltinType::Invalid );
 
 		SValue LHSVal = m_pLHS->CodeGen();
@@ -748,11 +1225,6 @@ namespace Tenshi { namespace Compiler {
 		AX_ASSERT_NOT_NULL( pLHSRTy );
 		AX_ASSERT( pLHSRTy->BuiltinType == EBuiltinType::ArrayObject );
 
-		llvm::Type *const pArrTy = const_cast< STypeRef * >( pLHSRTy )->CodeGen();
-		if( !pArrTy ) {
-			return nullptr;
-		}
-
 		llvm::Value *const pArr = CG->Builder().CreateCast( llvm::CastInst::getCastOpcode( LHSVal.pLLVMValue, false, pArrTy, false ), LHSVal.pLLVMValue, pArrTy );
 		AX_ASSERT_NOT_NULL( pArr );
 
@@ -766,6 +1238,8 @@ namespace Tenshi { namespace Compiler {
 		const unsigned cBits = ( unsigned )g_Env->GetPointerBits();
 		llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( CG->Context(), cBits );
 
+		const bool bCheckBounds = CG->AreBoundsChecked();
+
 		// Calculate the index: Y*X*z + X*y + x
 		for( uintptr i = 0; i < cSubexprs; ++i ) {
 			SExpr &Subexpr = m_pList->Subexpressions()[ i ];
@@ -776,8 +1250,26 @@ namespace Tenshi { namespace Compiler {
 				return nullptr;
 			}
 
+			const STypeRef *const pSubRTy = Subexpr->GetType();
+			AX_ASSERT_NOT_NULL( pSubRTy );
+
+			// Negative subscripts become huge unsigned values here, which the
+			// bounds check then rejects
+			llvm::Value *const pSubIndex = CG->Builder().CreateIntCast( Subval.Load(), pUIntPtrTy, IsSigned( pSubRTy->BuiltinType ), "arr.idx" );
+
+			if( bCheckBounds ) {
+				// Subscripts by a FOR loop's iterator might be checked up front
+				const SSymbol *const pSubSym = Subexpr->Is( EExprType::Name ) ? Subexpr->GetSymbol() : nullptr;
+				llvm::Value *const pGuard =
+					pSubSym != nullptr && pSubSym->pVar != nullptr
+					? CG->GetBoundsGuard( *pSubSym, LHSVal.pLLVMValue, ( unsigned )i )
+					: nullptr;
+
+				CG->EmitBoundsCheck( pArr, ( unsigned )i, pSubIndex, pGuard );
+			}
+
 			if( i == 0 ) {
-				pIndex = Subval.Load();
+				pIndex = pSubIndex;
 			} else {
 				static const char *const pszNames[] = {
 					"arr.res.x", "arr.res.y", "arr.res.z", "arr.res.w",
@@ -788,29 +1280,77 @@ namespace Tenshi { namespace Compiler {
 
 				const unsigned u = ( unsigned )i - 1;
 
-				llvm::Value *const pDimNum = llvm::Constant::getIntegerValue( pUIntPtrTy, llvm::APInt( cBits, ( uint64_t )u, false ) );
-				const char *const pszName = u < kNumNames ? pszNames[ u ] : "";
-
-				llvm::Value *const pArgs[] = {
-					pArr,
-					pDimNum
-				};
-
-				llvm::Value *const pDimRes = CG->Builder().CreateCall( CG->InternalFuncs().pArrayGetDimRes, pArgs, pszName );
+				llvm::Value *const pDimRes = CG->EmitArrayDimensionLen( pArr, u );
+				if( u < kNumNames ) {
+					pDimRes->setName( pszNames[ u ] );
+				}
 
 				pPrevRes = pPrevRes != nullptr ? CG->Builder().CreateMul( pDimRes, pPrevRes ) : pDimRes;
-				pIndex = CG->Builder().CreateAdd( pIndex, CG->Builder().CreateMul( Subval.Load(), pPrevRes ) );
+				pIndex = CG->Builder().CreateAdd( pIndex, CG->Builder().CreateMul( pSubIndex, pPrevRes ) );
 			}
 		}
 
 		if( !cSubexprs ) {
-			pIndex = CG->Builder().CreateCall( CG->InternalFuncs().pArrayGetCurIdx, pArr );
+			pIndex = CG->EmitArrayCurrentIndex( pArr );
+		}
+
+		pOutArr = pArr;
+		return pIndex;
+	}
+	SValue CArraySubscriptExpr::CodeGen()
+	{
+		if( IsColumnAccess() ) {
+			Token().Error( "[CodeGen] Items of SOA arrays can only be accessed through their fields" );
+			return nullptr;
+		}
+
+		const STypeRef *const pLHSRTy = m_pLHS->GetType();
+		AX_ASSERT_NOT_NULL( pLHSRTy );
+
+		llvm::Type *const pArrTy = const_cast< STypeRef * >( pLHSRTy )->CodeGen();
+		if( !pArrTy ) {
+			return nullptr;
+		}
+
+		llvm::Value *pArr = nullptr;
+		llvm::Value *const pIndex = CodeGenIndex( pArrTy, pArr );
+		if( !pIndex ) {
+			return nullptr;
 		}
 
 		llvm::Value *const pElementPtr = CG->Builder().CreateGEP( pArr, pIndex );
 
 		return SValue( SValue::kLValue, pElementPtr );
 	}
+	SValue CArraySubscriptExpr::CodeGenColumn( const SMemberInfo &Field )
+	{
+		AX_ASSERT( IsColumnAccess() );
+		AX_ASSERT( Field.iFieldIndex >= 0 );
+
+		const STypeInfo &UDT = *m_Semanted.Type.pCustomType;
+		AX_ASSERT_NOT_NULL( UDT.pLLVMTy );
+
+		llvm::IRBuilder<> &Builder = CG->Builder();
+
+		llvm::Value *pArr = nullptr;
+		llvm::Value *const pIndex = CodeGenIndex( Builder.getInt8PtrTy(), pArr );
+		if( !pIndex ) {
+			return nullptr;
+		}
+
+		// The field's column starts after the columns placed before it, each
+		// of which holds one field per item
+		llvm::Value *const pNumItems = CG->EmitArrayLen( pArr );
+		llvm::Value *const pColumnOff = Builder.CreateMul( pNumItems, llvm::ConstantInt::get( pNumItems->getType(), Field.uColumnOffset ), "soa.coloff" );
+		llvm::Value *const pColumn = Builder.CreateInBoundsGEP( pArr, pColumnOff, "soa.col" );
+
+		llvm::Type *const pFieldTy = UDT.pLLVMTy->getStructElementType( ( unsigned )Field.iFieldIndex );
+		llvm::Value *const pFieldColumn = Builder.CreatePointerCast( pColumn, pFieldTy->getPointerTo() );
+
+		llvm::Value *const pElementPtr = Builder.CreateInBoundsGEP( pFieldColumn, pIndex, "soa.item" );
+
+		return SValue( pElementPtr, m_Semanted.Type.IsVolatile() );
+	}
 
 
 	/*
@@ -888,6 +1428,22 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		// The caller's thread safety depends on this function's
+		SFunctionOverload *const pCaller = g_Prog->CurrentFunction();
+		if( pCaller != nullptr ) {
+			bool bIsKnown = false;
+			for( const SFunctionOverload *pCallee : pCaller->Callees ) {
+				if( pCallee == m_Semanted.pFuncOverload ) {
+					bIsKnown = true;
+					break;
+				}
+			}
+
+			if( !bIsKnown ) {
+				AX_EXPECT_MEMORY( pCaller->Callees.Append( m_Semanted.pFuncOverload ) );
+			}
+		}
+
 		return true;
 	}
 	SValue CFuncCallExpr::CodeGen()
@@ -896,11 +1452,13 @@ namespace Tenshi { namespace Compiler {
 		AX_ASSERT_NOT_NULL( m_Semanted.pFuncOverload );
 		AX_ASSERT( m_Semanted.Casts.Num() == m_pList->Subexpressions().Num() );
 
-		if( !m_Semanted.pFuncOverload->GenDecl() ) {
+		const bool bIsIntrinsic = CG->IsIntrinsic( *m_Semanted.pFuncOverload );
+
+		if( !bIsIntrinsic && !m_Semanted.pFuncOverload->GenDecl() ) {
 			Token().Error( "[CodeGen] Failed to generate declaration for function" );
 			return nullptr;
 		}
-		AX_ASSERT_NOT_NULL( m_Semanted.pFuncOverload->pLLVMFunc );
+		AX_ASSERT( bIsIntrinsic || m_Semanted.pFuncOverload->pLLVMFunc != nullptr );
 
 		static const uintptr kMaxArgs = 64;
 		llvm::Value *pArgs[ kMaxArgs ];
@@ -958,6 +1516,22 @@ namespace Tenshi { namespace Compiler {
 			++cArgs;
 		}
 
+		if( bIsIntrinsic ) {
+			return CG->EmitIntrinsic( *m_Semanted.pFuncOverload, llvm::ArrayRef< llvm::Value * >( pArgs, cArgs ) );
+		}
+
+		// The module's Init runs the first time any of its commands is called
+		if( m_Semanted.pFuncOverload->pModule != nullptr ) {
+			CG->EmitModuleInit( *m_Semanted.pFuncOverload->pModule );
+		}
+
+		// Functions that aren't thread-safe run one at a time from the body of
+		// a PARALLEL FOR
+		const bool bSerialize = CG->IsInParallelRegion() && !m_Semanted.pFuncOverload->bThreadSafe;
+		if( bSerialize ) {
+			CG->Builder().CreateCall( CG->InternalFuncs().pParallelLock, llvm::ArrayRef< llvm::Value * >() );
+		}
+
 		llvm::Value *const pVal =
 			CG->Builder().CreateCall
 			(
@@ -968,6 +1542,10 @@ namespace Tenshi { namespace Compiler {
 			return nullptr;
 		}
 
+		if( bSerialize ) {
+			CG->Builder().CreateCall( CG->InternalFuncs().pParallelUnlock, llvm::ArrayRef< llvm::Value * >() );
+		}
+
 		const STypeRef *const pType = GetType();
 		if( !!pType && pType->BuiltinType == EBuiltinType::StringObject ) {
 			CG->AddCleanCall( CG->InternalFuncs().pStrReclaim, pVal );
@@ -977,6 +1555,317 @@ namespace Tenshi { namespace Compiler {
 	}
 
 
+	/*
+	===========================================================================
+	
+		ARRAY FUNCTION EXPRESSION
+
+	===========================================================================
+	*/
+	CArrayFuncExpr::CArrayFuncExpr( const SToken &Tok, CParser &Parser )
+	: CExpression( EExprType::ArrayFunction, Tok, Parser )
+	, m_pList( nullptr )
+	, m_Semanted()
+	{
+		m_Semanted.ItemType = EBuiltinType::Invalid;
+		m_Semanted.ValueType = ~0U;
+		m_Semanted.uDim = ~0U;
+	}
+	CArrayFuncExpr::~CArrayFuncExpr()
+	{
+	}
+	const STypeRef *CArrayFuncExpr::GetType() const
+	{
+		AX_ASSERT( m_Semanted.Type.BuiltinType != EBuiltinType::Invalid );
+		return &m_Semanted.Type;
+	}
+	static const char *ArrayFuncName( const SToken &Tok )
+	{
+		if( Tok.IsKeyword( kKeyword_ArraySum ) ) {
+			return "ARRAY SUM";
+		}
+		if( Tok.IsKeyword( kKeyword_ArrayMin ) ) {
+			return "ARRAY MIN";
+		}
+		if( Tok.IsKeyword( kKeyword_ArrayMax ) ) {
+			return "ARRAY MAX";
+		}
+		if( Tok.IsKeyword( kKeyword_ArrayCount ) ) {
+			return "ARRAY COUNT";
+		}
+		if( Tok.IsKeyword( kKeyword_ArrayLen ) ) {
+			return "ARRAY LEN";
+		}
+
+		AX_ASSERT( Tok.IsKeyword( kKeyword_ArrayFind ) );
+		return "ARRAY FIND";
+	}
+	Ax::String CArrayFuncExpr::ToString() const
+	{
+		Ax::String Result;
+
+		if( Token().IsKeyword( kKeyword_ArraySum ) ) {
+			AX_EXPECT_MEMORY( Result.Append( "ArraySum(" ) );
+		} else if( Token().IsKeyword( kKeyword_ArrayMin ) ) {
+			AX_EXPECT_MEMORY( Result.Append( "ArrayMin(" ) );
+		} else if( Token().IsKeyword( kKeyword_ArrayMax ) ) {
+			AX_EXPECT_MEMORY( Result.Append( "ArrayMax(" ) );
+		} else if( Token().IsKeyword( kKeyword_ArrayCount ) ) {
+			AX_EXPECT_MEMORY( Result.Append( "ArrayCount(" ) );
+		} else if( Token().IsKeyword( kKeyword_ArrayLen ) ) {
+			AX_EXPECT_MEMORY( Result.Append( "ArrayLen(" ) );
+		} else {
+			AX_EXPECT_MEMORY( Result.Append( "ArrayFind(" ) );
+		}
+
+		if( m_pList != nullptr ) {
+			AX_EXPECT_MEMORY( Result.Append( m_pList->ToString() ) );
+		}
+		AX_EXPECT_MEMORY( Result.Append( ")" ) );
+
+		return Result;
+	}
+	bool CArrayFuncExpr::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pList );
+
+		const char *const pszName = ArrayFuncName( Token() );
+		const bool bIsFind = Token().IsKeyword( kKeyword_ArrayFind );
+		const bool bIsExtent = Token().IsKeyword( kKeyword_ArrayCount ) || Token().IsKeyword( kKeyword_ArrayLen );
+
+		CExpressionList::ArrayType &Subexprs = m_pList->Subexpressions();
+		if( bIsExtent ) {
+			if( Subexprs.Num() < 1 || Subexprs.Num() > 2 ) {
+				Token().Error( Ax::String( pszName ) + " expects an array, and optionally a dimension" );
+				return false;
+			}
+		} else if( Subexprs.Num() < ( bIsFind ? 2U : 1U ) || Subexprs.Num() > ( bIsFind ? 3U : 1U ) ) {
+			Token().Error( bIsFind ? "ARRAY FIND expects an array, a value, and optionally the index to search from" : Ax::String( pszName ) + " expects an array" );
+			return false;
+		}
+
+		Subexprs[ 0 ].pExpr = ArrayOperand( Subexprs[ 0 ].pExpr );
+		for( SExpr &Subexpr : Subexprs ) {
+			AX_ASSERT_NOT_NULL( Subexpr );
+
+			if( !Subexpr->Semant() ) {
+				return false;
+			}
+		}
+
+		const STypeRef *const pArrRTy = Subexprs[ 0 ]->GetType();
+		if( !pArrRTy || !pArrRTy->IsArray() ) {
+			Subexprs[ 0 ]->Token().Error( Ax::String( pszName ) + " expects an array: \"" + Subexprs[ 0 ]->ToString() + "\"" );
+			return false;
+		}
+
+		AX_ASSERT_NOT_NULL( pArrRTy->pRef );
+		const STypeRef &ItemRTy = *pArrRTy->pRef;
+
+		m_Semanted.ItemType = ItemRTy.BuiltinType;
+
+		// The header is read inline, so the dimension has to be known here
+		if( bIsExtent ) {
+			if( Subexprs.Num() > 1 ) {
+				const SConstant *const pDim = Subexprs[ 1 ]->GetConstant();
+				if( !pDim || !IsIntNumber( pDim->Type ) || ( IsSigned( pDim->Type ) && pDim->iValue < 0 ) || pDim->uValue > 0xFFFF ) {
+					Subexprs[ 1 ]->Token().Error( Ax::String( pszName ) + " expects a constant dimension (0 for the first)" );
+					return false;
+				}
+
+				m_Semanted.uDim = ( unsigned )pDim->uValue;
+			}
+
+			const EBuiltinType ResultType = Token().IsKeyword( kKeyword_ArrayCount ) ? g_Env->GetIntPtrType() : g_Env->GetUIntPtrType();
+
+			m_Semanted.Type.BuiltinType = ResultType;
+			m_Semanted.Type.pCustomType = nullptr;
+			m_Semanted.Type.Access = EAccess::ReadOnly;
+			m_Semanted.Type.bCanReorderMemAccesses = true;
+			m_Semanted.Type.cBytes = GetTypeSize( ResultType );
+			m_Semanted.Type.pRef = nullptr;
+
+			return true;
+		}
+
+		m_Semanted.ValueType = GetSortKey( ItemRTy.BuiltinType );
+		if( m_Semanted.ValueType == ~0U || ( m_Semanted.ValueType == kSortKey_String && Token().IsKeyword( kKeyword_ArraySum ) ) ) {
+			Subexprs[ 0 ]->Token().Error( Ax::String( pszName ) + " cannot operate on items of type \"" + ItemRTy.ToString() + "\"" );
+			return false;
+		}
+
+		EBuiltinType ResultType = ItemRTy.BuiltinType;
+		if( Token().IsKeyword( kKeyword_ArraySum ) ) {
+			if( IsRealNumber( ItemRTy.BuiltinType ) ) {
+				ResultType = EBuiltinType::Float64;
+			} else if( IsSigned( ItemRTy.BuiltinType ) ) {
+				ResultType = EBuiltinType::Int64;
+			} else {
+				ResultType = EBuiltinType::UInt64;
+			}
+		} else if( bIsFind ) {
+			const STypeRef *const pValRTy = Subexprs[ 1 ]->GetType();
+			if( !pValRTy ) {
+				Subexprs[ 1 ]->Token().Error( "ARRAY FIND value has no type" );
+				return false;
+			}
+
+			Subexprs[ 1 ].Cast = STypeRef::Cast( *pValRTy, ItemRTy );
+			if( Subexprs[ 1 ].Cast == ECast::Invalid ) {
+				return STypeRef::CastError( Subexprs[ 1 ]->Token(), *pValRTy, ItemRTy );
+			}
+
+			if( Subexprs.Num() > 2 ) {
+				const STypeRef &UIntPtrRTy = g_Env->GetUIntPtr();
+
+				const STypeRef *const pFirstRTy = Subexprs[ 2 ]->GetType();
+				if( !pFirstRTy ) {
+					Subexprs[ 2 ]->Token().Error( "ARRAY FIND index has no type" );
+					return false;
+				}
+
+				Subexprs[ 2 ].Cast = STypeRef::Cast( *pFirstRTy, UIntPtrRTy );
+				if( Subexprs[ 2 ].Cast == ECast::Invalid ) {
+					return STypeRef::CastError( Subexprs[ 2 ]->Token(), *pFirstRTy, UIntPtrRTy );
+				}
+			}
+
+			ResultType = g_Env->GetIntPtrType();
+		}
+
+		m_Semanted.Type.BuiltinType = ResultType;
+		m_Semanted.Type.pCustomType = nullptr;
+		m_Semanted.Type.Access = EAccess::ReadOnly;
+		m_Semanted.Type.bCanReorderMemAccesses = true;
+		m_Semanted.Type.cBytes = GetTypeSize( ResultType );
+		m_Semanted.Type.pRef = nullptr;
+
+		return true;
+	}
+	const SSymbol *CArrayFuncExpr::GetExtentArray( unsigned &uOutDim ) const
+	{
+		if( !Token().IsKeyword( kKeyword_ArrayCount ) && !Token().IsKeyword( kKeyword_ArrayLen ) ) {
+			return nullptr;
+		}
+
+		AX_ASSERT_NOT_NULL( m_pList );
+		AX_ASSERT( m_pList->Subexpressions().IsEmpty() == false );
+
+		const CExpression *const pArrExpr = m_pList->Subexpressions()[ 0 ].pExpr;
+		if( !pArrExpr->Is( EExprType::Name ) ) {
+			return nullptr;
+		}
+
+		uOutDim = m_Semanted.uDim;
+		return pArrExpr->GetSymbol();
+	}
+	SValue CArrayFuncExpr::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pList );
+		AX_ASSERT( m_Semanted.ValueType != ~0U || Token().IsKeyword( kKeyword_ArrayCount ) || Token().IsKeyword( kKeyword_ArrayLen ) );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pArrayReduce );
+		AX_ASSERT_NOT_NULL( IntFns.pArrayFind );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Function *const pCurrFunc = &CG->CurrentFunction();
+		llvm::IRBuilder<> EntryBlockBuilder( &pCurrFunc->getEntryBlock(), pCurrFunc->getEntryBlock().begin() );
+
+		CExpressionList::ArrayType &Subexprs = m_pList->Subexpressions();
+
+		SValue ArrVal = Subexprs[ 0 ]->CodeGen();
+		if( !ArrVal ) {
+			return nullptr;
+		}
+
+		// The array's value is its data, as with subscripts
+		llvm::Type *const pDataTy = Builder.getInt8PtrTy();
+		llvm::Value *const pArrData = Builder.CreateCast( llvm::CastInst::getCastOpcode( ArrVal.pLLVMValue, false, pDataTy, false ), ArrVal.pLLVMValue, pDataTy );
+
+		llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( Context, ( unsigned )g_Env->GetPointerBits() );
+		llvm::Type *const pUInt32Ty = llvm::Type::getInt32Ty( Context );
+
+		if( Token().IsKeyword( kKeyword_ArrayCount ) || Token().IsKeyword( kKeyword_ArrayLen ) ) {
+			llvm::Value *const pLen =
+				m_Semanted.uDim != ~0U
+				? CG->EmitArrayDimensionLen( pArrData, m_Semanted.uDim )
+				: CG->EmitArrayLen( pArrData );
+
+			if( Token().IsKeyword( kKeyword_ArrayLen ) ) {
+				return pLen;
+			}
+
+			// An empty array's last index is -1
+			return Builder.CreateSub( pLen, llvm::ConstantInt::get( pUIntPtrTy, 1 ), "arrcount" );
+		}
+
+		if( Token().IsKeyword( kKeyword_ArrayFind ) ) {
+			SValue Val = Subexprs[ 1 ]->CodeGen();
+			if( !Val ) {
+				return nullptr;
+			}
+
+			llvm::Value *const pVal = CG->EmitCast( Subexprs[ 1 ].Cast, m_Semanted.ItemType, Val.Load() );
+			if( !pVal ) {
+				return nullptr;
+			}
+
+			// The runtime compares the items against the value in memory
+			llvm::Value *const pValSlot = EntryBlockBuilder.CreateAlloca( CG->GetBuiltinType( m_Semanted.ItemType ), nullptr, "arrfind.value" );
+			Builder.CreateStore( pVal, pValSlot );
+
+			llvm::Value *pFirst = llvm::ConstantInt::get( pUIntPtrTy, 0 );
+			if( Subexprs.Num() > 2 ) {
+				SValue FirstVal = Subexprs[ 2 ]->CodeGen();
+				if( !FirstVal ) {
+					return nullptr;
+				}
+
+				pFirst = CG->EmitCast( Subexprs[ 2 ].Cast, g_Env->GetUIntPtrType(), FirstVal.Load() );
+				if( !pFirst ) {
+					return nullptr;
+				}
+			}
+
+			llvm::Value *const pArgs[] = {
+				pArrData,
+				llvm::ConstantInt::get( pUInt32Ty, m_Semanted.ValueType ),
+				Builder.CreatePointerCast( pValSlot, pDataTy ),
+				pFirst
+			};
+
+			return Builder.CreateCall( IntFns.pArrayFind, pArgs, "arrfind" );
+		}
+
+		unsigned Op = kArrayReduce_Sum;
+		if( Token().IsKeyword( kKeyword_ArrayMin ) ) {
+			Op = kArrayReduce_Min;
+		} else if( Token().IsKeyword( kKeyword_ArrayMax ) ) {
+			Op = kArrayReduce_Max;
+		}
+
+		llvm::Value *const pResultSlot = EntryBlockBuilder.CreateAlloca( CG->GetBuiltinType( m_Semanted.Type.BuiltinType ), nullptr, "arrreduce.result" );
+
+		llvm::Value *const pArgs[] = {
+			pArrData,
+			llvm::ConstantInt::get( pUInt32Ty, m_Semanted.ValueType ),
+			llvm::ConstantInt::get( pUInt32Ty, Op ),
+			Builder.CreatePointerCast( pResultSlot, pDataTy )
+		};
+
+		Builder.CreateCall( IntFns.pArrayReduce, pArgs );
+
+		llvm::Value *const pResult = Builder.CreateLoad( pResultSlot, "arrreduce" );
+		if( m_Semanted.Type.BuiltinType == EBuiltinType::StringObject ) {
+			CG->AddCleanCall( CG->InternalFuncs().pStrReclaim, pResult );
+		}
+
+		return pResult;
+	}
+
+
 	/*
 	===========================================================================
 	
@@ -989,6 +1878,7 @@ namespace Tenshi { namespace Compiler {
 	, m_Operator( EBuiltinOp::None )
 	, m_bIsPostfix( false )
 	, m_pSubexpr( nullptr )
+	, m_Constant()
 	{
 	}
 	CUnaryExpr::~CUnaryExpr()
@@ -1037,6 +1927,10 @@ namespace Tenshi { namespace Compiler {
 
 		return &m_Semanted.Type;
 	}
+	const SConstant *CUnaryExpr::GetConstant() const
+	{
+		return m_Constant.IsValid() ? &m_Constant : nullptr;
+	}
 
 	bool CUnaryExpr::Semant()
 	{
@@ -1117,6 +2011,15 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		// Fold the operation if the subexpression is constant
+		const SConstant *const pSubConst = m_pSubexpr->GetConstant();
+		if( pSubConst != nullptr && ( m_Operator == EBuiltinOp::Neg || m_Operator == EBuiltinOp::RelNot ) ) {
+			SConstant Operand;
+			if( !FoldCast( m_Semanted.RHSCast, m_Semanted.Type.BuiltinType, *pSubConst, Operand ) || !FoldUnaryOp( m_Operator, m_Semanted.Type.BuiltinType, Operand, m_Constant ) ) {
+				m_Constant.Type = EBuiltinType::Invalid;
+			}
+		}
+
 		return true;
 	}
 	SValue CUnaryExpr::CodeGen()
@@ -1124,6 +2027,10 @@ namespace Tenshi { namespace Compiler {
 		AX_ASSERT_NOT_NULL( m_pSubexpr );
 		AX_ASSERT( m_Semanted.RHSCast != ECast::Invalid );
 
+		if( m_Constant.IsValid() ) {
+			return CG->EmitConstant( m_Constant );
+		}
+
 		SValue SrcVal = m_pSubexpr->CodeGen();
 		if( !SrcVal ) {
 			return nullptr;
@@ -1159,6 +2066,10 @@ namespace Tenshi { namespace Compiler {
 			if( IsIntNumber( m_Semanted.Type.BuiltinType ) ) {
 				return CG->Builder().CreateNeg( pSrcVal );
 			}
+			if( IsVectorOrMatrix( m_Semanted.Type.BuiltinType ) && !IsFloatVector( m_Semanted.Type.BuiltinType ) ) {
+				Token().Error( "[CodeGen] Only vectors can be negated, not matrices" );
+				return nullptr;
+			}
 			if( IsRealNumber( m_Semanted.Type.BuiltinType ) ) {
 				return CG->Builder().CreateFNeg( pSrcVal );
 			}
@@ -1192,6 +2103,7 @@ namespace Tenshi { namespace Compiler {
 	, m_pLHS( nullptr )
 	, m_pRHS( nullptr )
 	, m_Semanted()
+	, m_Constant()
 	, m_CodeGen()
 	{
 		memset( &m_Semanted, 0, sizeof( m_Semanted ) );
@@ -1240,6 +2152,10 @@ namespace Tenshi { namespace Compiler {
 	{
 		return &m_Semanted.ResultType;
 	}
+	const SConstant *CBinaryExpr::GetConstant() const
+	{
+		return m_Constant.IsValid() ? &m_Constant : nullptr;
+	}
 
 	bool CBinaryExpr::Semant()
 	{
@@ -1289,6 +2205,26 @@ namespace Tenshi { namespace Compiler {
 			}
 		}
 
+		// Vectors only have component-wise arithmetic, and matrices only have
+		// products (which yield the type of the right-hand side)
+		if( IsVectorOrMatrix( PromotionType ) ) {
+			const bool bIsMatrixProduct =
+				m_Operator == EBuiltinOp::Mul &&
+				pLHSType->BuiltinType == EBuiltinType::Matrix4f &&
+				( pRHSType->BuiltinType == EBuiltinType::Matrix4f || pRHSType->BuiltinType == EBuiltinType::Vector4f );
+
+			if( bIsMatrixProduct ) {
+				m_Operator = EBuiltinOp::MatMul;
+				PromotionType = pRHSType->BuiltinType;
+			} else if( !IsFloatVector( PromotionType ) ) {
+				Token().Error( "Matrices only support MATRIX4*MATRIX4 and MATRIX4*VECTOR4 products" );
+				return false;
+			} else if( m_Operator != EBuiltinOp::Add && m_Operator != EBuiltinOp::Sub && m_Operator != EBuiltinOp::Mul && m_Operator != EBuiltinOp::Div ) {
+				Token().Error( "Invalid operator ('" + Token().GetString() + "') for vectors" );
+				return false;
+			}
+		}
+
 		DstType = IsCmpOp( m_Operator ) ? EBuiltinType::Boolean : PromotionType;
 
 		AX_ASSERT( DstType != EBuiltinType::Invalid );
@@ -1305,6 +2241,11 @@ namespace Tenshi { namespace Compiler {
 		m_Semanted.LHSCast = GetCastForTypes( pLHSType->BuiltinType, PromotionType, ECastMode::Input );
 		m_Semanted.RHSCast = GetCastForTypes( pRHSType->BuiltinType, PromotionType, ECastMode::Input );
 
+		// The matrix is used as-is
+		if( m_Operator == EBuiltinOp::MatMul ) {
+			m_Semanted.LHSCast = ECast::None;
+		}
+
 		if( m_Semanted.LHSCast == ECast::Invalid ) {
 			m_pLHS->Token().Error( "Cannot cast from \"" + pLHSType->ToString() + "\" to \"" + m_Semanted.ResultType.ToString() + "\"" );
 			return false;
@@ -1350,8 +2291,47 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		Fold();
 		return true;
 	}
+	void CBinaryExpr::Fold()
+	{
+		const SConstant *const pLHSConst = m_pLHS->GetConstant();
+		const SConstant *const pRHSConst = m_pRHS->GetConstant();
+
+		if( !pLHSConst ) {
+			return;
+		}
+
+		const EBuiltinType ResultType = m_Semanted.ResultType.BuiltinType;
+		const EBuiltinType LHSType = m_Semanted.PromotionType;
+		const EBuiltinType RHSType = m_Operator == EBuiltinOp::StrRepeat ? g_Env->GetUIntPtrType() : LHSType;
+
+		SConstant LHSVal;
+		if( !FoldCast( m_Semanted.LHSCast, LHSType, *pLHSConst, LHSVal ) ) {
+			return;
+		}
+
+		// The right-hand side is never evaluated if the left-hand side decides the result
+		if( ( m_Operator == EBuiltinOp::RelAnd && !LHSVal.IsTrue() ) || ( m_Operator == EBuiltinOp::RelOr && LHSVal.IsTrue() ) ) {
+			m_Constant.Type = ResultType;
+			m_Constant.uValue = +LHSVal.IsTrue();
+			return;
+		}
+
+		if( !pRHSConst ) {
+			return;
+		}
+
+		SConstant RHSVal;
+		if( !FoldCast( m_Semanted.RHSCast, RHSType, *pRHSConst, RHSVal ) ) {
+			return;
+		}
+
+		if( !FoldBinaryOp( m_Operator, LHSType, ResultType, LHSVal, RHSVal, m_Constant ) ) {
+			m_Constant.Type = EBuiltinType::Invalid;
+		}
+	}
 	SValue CBinaryExpr::CodeGen()
 	{
 		AX_ASSERT_NOT_NULL( m_pLHS );
@@ -1366,6 +2346,11 @@ namespace Tenshi { namespace Compiler {
 										m_Semanted.ResultType.BuiltinType;
 		const EBuiltinType RHSType = m_Operator == EBuiltinOp::StrRepeat ? g_Env->GetUIntPtrType() : LHSType;
 
+		if( m_Constant.IsValid() ) {
+			m_CodeGen.pValue = CG->EmitConstant( m_Constant );
+			return m_CodeGen.pValue;
+		}
+
 		const bool bIsRelOp = IsRelOp( m_Operator );
 
 		llvm::BasicBlock *const pLHSEval = &CG->CurrentBlock();
@@ -1492,7 +2477,13 @@ namespace Tenshi { namespace Compiler {
 			break;
 
 		case EBuiltinOp::StrConcat:
-			pResultVal = CG->Builder().CreateCall( CG->InternalFuncs().pStrConcat, pArgs, "strcattmp" );
+			// When the left side is a temporary (e.g., a chain of a+b+c) its
+			// buffer is grown in place instead of allocating another string
+			if( pLHSVal != pRHSVal && CG->RemoveCleanCall( pLHSVal ) ) {
+				pResultVal = CG->Builder().CreateCall( CG->InternalFuncs().pStrAppend, pArgs, "strapptmp" );
+			} else {
+				pResultVal = CG->Builder().CreateCall( CG->InternalFuncs().pStrConcat, pArgs, "strcattmp" );
+			}
 			CG->AddCleanCall( CG->InternalFuncs().pStrReclaim, pResultVal );
 			break;
 		case EBuiltinOp::StrRemove:
@@ -1508,6 +2499,10 @@ namespace Tenshi { namespace Compiler {
 			CG->AddCleanCall( CG->InternalFuncs().pStrReclaim, pResultVal );
 			break;
 
+		case EBuiltinOp::MatMul:
+			pResultVal = CG->EmitMatrixMultiply( pLHSVal, pRHSVal );
+			break;
+
 		case EBuiltinOp::CmpEq:
 			if( bIsInt ) {
 				pResultVal = CG->Builder().CreateICmpEQ( pLHSVal, pRHSVal, "icmpeqtmp" );
@@ -183,6 +183,7 @@ namespace Tenshi { namespace Compiler {
 		const Ax::uint8 *DataPointer() const;
 
 		virtual const STypeRef *GetType() const AX_OVERRIDE;
+		virtual const SConstant *GetConstant() const AX_OVERRIDE;
 
 		virtual Ax::String ToString() const AX_OVERRIDE;
 
@@ -197,6 +198,8 @@ namespace Tenshi { namespace Compiler {
 		};
 		Ax::uint32					m_SizeInBits;
 		STypeRef					m_Type;
+		// Value of the literal (valid after Semant())
+		SConstant					m_Constant;
 		struct
 		{
 			llvm::Value *			pValue;
@@ -269,6 +272,9 @@ namespace Tenshi { namespace Compiler {
 		// Expression this operates on
 		CExpression *				m_pLHS;
 
+		// Generate the component(s) of a vector selected by the swizzle
+		SValue CodeGenSwizzle();
+
 		// Valid after successful call to Semant()
 		struct
 		{
@@ -305,6 +311,11 @@ namespace Tenshi { namespace Compiler {
 		virtual bool Semant() AX_OVERRIDE;
 		virtual SValue CodeGen() AX_OVERRIDE;
 
+		// Whether items are structure-of-arrays (only fields can be accessed)
+		bool IsColumnAccess() const;
+		// Generate the address of a field of a structure-of-arrays item
+		SValue CodeGenColumn( const SMemberInfo &Field );
+
 	private:
 		// Expression this operates on
 		CExpression *				m_pLHS;
@@ -317,6 +328,9 @@ namespace Tenshi { namespace Compiler {
 			STypeRef				Type;
 		}							m_Semanted;
 
+		// Generate the (bounds checked) item index, and the array cast to pArrTy
+		llvm::Value *CodeGenIndex( llvm::Type *pArrTy, llvm::Value *&pOutArr );
+
 		AX_DELETE_COPYFUNCS(CArraySubscriptExpr);
 	};
 	//
@@ -338,6 +352,16 @@ namespace Tenshi { namespace Compiler {
 		virtual bool Semant() AX_OVERRIDE;
 		virtual SValue CodeGen() AX_OVERRIDE;
 
+		// Expression being called, and the parameters it's called with
+		inline CExpression *Callee() const
+		{
+			return m_pLHS;
+		}
+		inline const CExpressionList &Parameters() const
+		{
+			return *m_pList;
+		}
+
 	private:
 		// Expression this is operating on
 		CExpression *				m_pLHS;
@@ -356,6 +380,83 @@ namespace Tenshi { namespace Compiler {
 		AX_DELETE_COPYFUNCS(CFuncCallExpr);
 	};
 
+	// Array named by an operand of the array commands -- "arr()" names the
+	// whole array, as in the original's array commands
+	inline CExpression *ArrayOperand( CExpression *pExpr )
+	{
+		if( pExpr != nullptr && pExpr->Is( EExprType::FunctionCall ) ) {
+			const CFuncCallExpr *const pCallExpr = static_cast< const CFuncCallExpr * >( pExpr );
+			if( pCallExpr->Parameters().Subexpressions().IsEmpty() ) {
+				return pCallExpr->Callee();
+			}
+		}
+
+		return pExpr;
+	}
+
+	//
+	//	Array Function Expression
+	//	=========================
+	//	Reduces or searches the items of an array, through the runtime's bulk
+	//	array operations:
+	//
+	//		ARRAY SUM( arr() )               sum of the items
+	//		ARRAY MIN( arr() )               smallest item
+	//		ARRAY MAX( arr() )               largest item
+	//		ARRAY FIND( arr(), value )       index of the first item equal to
+	//		ARRAY FIND( arr(), value, first )  value (at or after first), or -1
+	//		ARRAY COUNT( arr() )             last index (-1 if empty)
+	//		ARRAY COUNT( arr(), dim )        last index within one dimension
+	//		ARRAY LEN( arr() )               number of items
+	//		ARRAY LEN( arr(), dim )          number of items in one dimension
+	//
+	//	The items must be numbers, booleans, or strings (not for SUM). SUM is
+	//	64-bit: INT64 for signed items, UINT64 for unsigned items, and DOUBLE
+	//	for reals. MIN and MAX are of the item type, and 0 (or "") for an empty
+	//	array. NaNs are skipped by MIN and MAX, and never found. Indexes count
+	//	the items in memory order, as with ARRAY FILL and ARRAY COPY.
+	//
+	//	COUNT and LEN take items of any type and read the array's header
+	//	inline. The dimension must be a constant (0 for the first).
+	//
+	class CArrayFuncExpr: public CExpression
+	{
+	friend class CParser;
+	public:
+		CArrayFuncExpr( const SToken &Token, CParser &Parser );
+		virtual ~CArrayFuncExpr();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+		virtual const STypeRef *GetType() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual SValue CodeGen() AX_OVERRIDE;
+
+		// Array whose extent this is (for ARRAY COUNT and ARRAY LEN), or
+		// nullptr; uOutDim receives the dimension, or ~0U for all items
+		const SSymbol *GetExtentArray( unsigned &uOutDim ) const;
+
+	private:
+		// Array, and the value and first index for FIND (or the dimension for
+		// COUNT and LEN)
+		CExpressionList *			m_pList;
+
+		// Valid after successful call to Semant()
+		struct
+		{
+			// Type of the result
+			STypeRef				Type;
+			// Type of the array's items
+			EBuiltinType			ItemType;
+			// Value type passed to the runtime (ESortKey)
+			unsigned				ValueType;
+			// Dimension for COUNT and LEN (~0U for all items)
+			unsigned				uDim;
+		}							m_Semanted;
+
+		AX_DELETE_COPYFUNCS(CArrayFuncExpr);
+	};
+
 	//
 	//	Unary Expression
 	//	================
@@ -386,6 +487,7 @@ namespace Tenshi { namespace Compiler {
 
 		virtual Ax::String ToString() const AX_OVERRIDE;
 		virtual const STypeRef *GetType() const AX_OVERRIDE;
+		virtual const SConstant *GetConstant() const AX_OVERRIDE;
 
 		virtual bool Semant() AX_OVERRIDE;
 		virtual SValue CodeGen() AX_OVERRIDE;
@@ -399,6 +501,8 @@ namespace Tenshi { namespace Compiler {
 			STypeRef				Type;
 			ECast					RHSCast;
 		}							m_Semanted;
+		// Folded value (valid after Semant() if the subexpression is constant)
+		SConstant					m_Constant;
 
 		AX_DELETE_COPYFUNCS(CUnaryExpr);
 	};
@@ -418,9 +522,19 @@ namespace Tenshi { namespace Compiler {
 		virtual ~CBinaryExpr();
 
 		EBuiltinOp Operator() const;
+		// Operands of the operation
+		inline const CExpression *LHS() const
+		{
+			return m_pLHS;
+		}
+		inline const CExpression *RHS() const
+		{
+			return m_pRHS;
+		}
 
 		virtual Ax::String ToString() const AX_OVERRIDE;
 		virtual const STypeRef *GetType() const AX_OVERRIDE;
+		virtual const SConstant *GetConstant() const AX_OVERRIDE;
 
 		virtual bool Semant() AX_OVERRIDE;
 		virtual SValue CodeGen() AX_OVERRIDE;
@@ -436,11 +550,15 @@ namespace Tenshi { namespace Compiler {
 			EBuiltinType			PromotionType;
 			STypeRef				ResultType;
 		}							m_Semanted;
+		// Folded value (valid after Semant() if both operands are constant)
+		SConstant					m_Constant;
 		struct
 		{
 			llvm::Value *			pValue;
 		}							m_CodeGen;
 
+		void Fold();
+
 		AX_DELETE_COPYFUNCS(CBinaryExpr);
 	};
 
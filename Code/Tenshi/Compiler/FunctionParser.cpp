@@ -24,6 +24,13 @@ namespace Tenshi { namespace Compiler {
 	}
 	CFunctionDecl::~CFunctionDecl()
 	{
+		for( CParameterDecl *&pParm : m_Parms ) {
+			delete pParm;
+			pParm = nullptr;
+		}
+
+		delete m_pReturnType;
+		m_pReturnType = nullptr;
 	}
 
 	bool CFunctionDecl::Parse()
@@ -233,6 +240,8 @@ namespace Tenshi { namespace Compiler {
 		SFunctionOverload &Fn = *m_Semanted.pOverload;
 
 		Fn.pModule = nullptr;
+		// Until its body shows otherwise (see ResolveThreadSafety())
+		Fn.bThreadSafe = true;
 		AX_EXPECT_MEMORY( Fn.RealName.Assign( "_" ) );
 		AX_EXPECT_MEMORY( Fn.RealName.Append( m_pNameTok->GetPointer(), ( Ax::intptr )m_pNameTok->cLength ) );
 
@@ -322,7 +331,9 @@ namespace Tenshi { namespace Compiler {
 		AX_ASSERT_NOT_NULL( m_Semanted.pOverload );
 
 		g_Prog->PushScope( *m_Semanted.pScope );
+		g_Prog->EnterFunction( *m_Semanted.pOverload );
 		const bool bDidSemant = m_Stmts.Semant();
+		g_Prog->LeaveFunction();
 		g_Prog->PopScope();
 
 		if( !bDidSemant ) {
@@ -331,6 +342,28 @@ namespace Tenshi { namespace Compiler {
 
 		return true;
 	}
+	bool CFunctionDecl::ResolveThreadSafety()
+	{
+		AX_ASSERT_NOT_NULL( m_Semanted.pOverload );
+
+		SFunctionOverload &Fn = *m_Semanted.pOverload;
+		if( !Fn.bThreadSafe ) {
+			return false;
+		}
+
+		// Calling anything that isn't thread-safe makes this function unsafe
+		// too, as the calls within it aren't serialized
+		for( const SFunctionOverload *pCallee : Fn.Callees ) {
+			AX_ASSERT_NOT_NULL( pCallee );
+
+			if( !pCallee->bThreadSafe ) {
+				Fn.bThreadSafe = false;
+				return true;
+			}
+		}
+
+		return false;
+	}
 	bool CFunctionDecl::PreCodeGen()
 	{
 		AX_ASSERT_NOT_NULL( m_Semanted.pSym );
@@ -363,6 +396,10 @@ namespace Tenshi { namespace Compiler {
 		CG->SetCurrentBlock( *pEntry );
 		CG->Builder().SetInsertPoint( pEntry );
 
+		// Only the program itself can call its functions, so any it doesn't
+		// call can be removed before the object is written
+		pFunc->setLinkage( llvm::GlobalValue::InternalLinkage );
+
 		// Prepare the clean-up scope
 		const bool bIsTopLevel = CG->EnterScope();
 		AX_ASSERT( bIsTopLevel );
@@ -455,6 +492,11 @@ namespace Tenshi { namespace Compiler {
 	}
 	CParameterDecl::~CParameterDecl()
 	{
+		delete m_pType;
+		m_pType = nullptr;
+
+		delete m_pDefault;
+		m_pDefault = nullptr;
 	}
 
 	bool CParameterDecl::HasDefault() const
@@ -16,6 +16,8 @@ namespace Tenshi { namespace Compiler {
 	class CFunctionDecl
 	{
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		CFunctionDecl( const SToken &Tok, CParser &Parser );
 		~CFunctionDecl();
 
@@ -25,6 +27,7 @@ namespace Tenshi { namespace Compiler {
 
 		bool PreSemant();
 		bool Semant();
+		bool ResolveThreadSafety();
 		bool PreCodeGen();
 		bool CodeGen();
 
@@ -55,6 +58,8 @@ namespace Tenshi { namespace Compiler {
 	{
 	friend class CFunctionDecl;
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		CParameterDecl();
 		~CParameterDecl();
 
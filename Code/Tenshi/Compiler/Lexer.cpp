@@ -6,10 +6,11 @@ using namespace Ax;
 namespace Tenshi { namespace Compiler {
 
 	CLexer::CLexer()
-	: m_Source()
-	, m_Tokens()
+	: m_Source( Ax::SMemtag( kMemtag_Lexer ) )
+	, m_Tokens( Ax::SMemtag( kMemtag_Lexer ) )
 	, m_CurrentToken( 0 )
-	, m_VirtualTokens()
+	, m_VirtualSource( Ax::SMemtag( kMemtag_Lexer ) )
+	, m_VirtualTokens( Ax::SMemtag( kMemtag_Lexer ) )
 	, m_bDebugPrintTokens( false )
 	, m_IfState( EIfState::None )
 	, m_cEndifs( 0 )
@@ -252,6 +253,19 @@ namespace Tenshi { namespace Compiler {
 		static const SToken NullTok;
 		return NullTok;
 	}
+	void CLexer::ReleaseLookahead()
+	{
+		// Keep the current token so reports still point at it
+		const SToken *const pCurrentTok = m_CurrentToken > 0 ? m_Tokens[ m_CurrentToken - 1 ] : nullptr;
+
+		m_Tokens.Purge();
+		m_CurrentToken = 0;
+
+		if( pCurrentTok != nullptr ) {
+			AX_EXPECT_MEMORY( m_Tokens.Append( pCurrentTok ) );
+			m_CurrentToken = 1;
+		}
+	}
 	void CLexer::Unlex()
 	{
 		if( m_CurrentToken > 0 ) {
@@ -278,6 +292,7 @@ namespace Tenshi { namespace Compiler {
 	{
 		if( !m_CurrentToken ) {
 			m_Source.Report( Sev, Message );
+			return;
 		}
 
 		AX_ASSERT( m_CurrentToken <= m_Tokens.Num() );
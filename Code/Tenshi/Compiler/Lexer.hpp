@@ -2,6 +2,7 @@
 
 #include <Parser/Source.hpp>
 #include "ParserConfig.hpp"
+#include "Memory.hpp"
 
 namespace Tenshi { namespace Compiler {
 
@@ -42,6 +43,10 @@ namespace Tenshi { namespace Compiler {
 		const SToken &Token();
 		// Unread the last token from the stream so the next call to Lex() will return it again
 		void Unlex();
+		// Free the record of tokens read so far (they can't be unread after)
+		//
+		// The tokens themselves stay valid; only the lookahead is released.
+		void ReleaseLookahead();
 
 		// Read the next token on the current line
 		//
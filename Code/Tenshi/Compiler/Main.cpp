@@ -1,12 +1,18 @@
 #include "_PCH.hpp"
 
+#include <Async/CPU.hpp>
+
 #include "Tester.hpp"
 #include "Options.hpp"
 #include "Project.hpp"
 #include "Module.hpp"
+#include "CodeGen.hpp"
+#include "Memory.hpp"
 
 #include "Shell.hpp"
 #include "Binutils.hpp"
+#include "Server.hpp"
+#include "Watch.hpp"
 
 using namespace Tenshi;
 using namespace Tenshi::Compiler;
@@ -288,6 +294,234 @@ namespace Tenshi { namespace Compiler {
 		bool						m_bCompileOnly;
 	};
 
+	class CWatchOption: public IOption
+	{
+	public:
+		CWatchOption()
+		: IOption()
+		, m_bWatch( false )
+		{
+		}
+		virtual ~CWatchOption()
+		{
+		}
+
+		const char *GetLongName() const AX_OVERRIDE		{ return "watch"; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return "Keep rebuilding as the sources change."; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::None; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		bool OnCall( UOptionArg ) AX_OVERRIDE
+		{
+			m_bWatch = true;
+			return true;
+		}
+
+		bool IsSet() const
+		{
+			return m_bWatch;
+		}
+
+	private:
+		bool						m_bWatch;
+	};
+
+	class COptimizeOption: public IOption
+	{
+	public:
+		COptimizeOption()
+		: IOption()
+		, m_bOptimize( false )
+		{
+		}
+		virtual ~COptimizeOption()
+		{
+		}
+
+		char GetShortName() const AX_OVERRIDE			{ return 'O'; }
+		const char *GetLongName() const AX_OVERRIDE		{ return "optimize"; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return "Run the optimization pipeline (inlining, etc) over the program."; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::None; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		bool OnCall( UOptionArg ) AX_OVERRIDE
+		{
+			m_bOptimize = true;
+			return true;
+		}
+
+		bool IsSet() const
+		{
+			return m_bOptimize;
+		}
+
+	private:
+		bool						m_bOptimize;
+	};
+
+	class CPartitionsOption: public IOption
+	{
+	public:
+		CPartitionsOption()
+		: IOption()
+		, m_cPartitions( 1 )
+		{
+		}
+		virtual ~CPartitionsOption()
+		{
+		}
+
+		const char *GetLongName() const AX_OVERRIDE		{ return "codegen-partitions"; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return "Split each object file into this many parts, built in parallel (0 for one per processor)."; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::RangedInteger; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		int GetMinRange() const AX_OVERRIDE				{ return 0; }
+		int GetMaxRange() const AX_OVERRIDE				{ return 256; }
+
+		bool OnCall( UOptionArg Arg ) AX_OVERRIDE
+		{
+			m_cPartitions = Arg.iValue > 0 ? ( unsigned )Arg.iValue : ( unsigned )Ax::Async::GetCPUCoreCount();
+			return true;
+		}
+
+		unsigned GetPartitions() const
+		{
+			return m_cPartitions;
+		}
+
+	private:
+		unsigned					m_cPartitions;
+	};
+
+	class CMemoryReportOption: public IOption
+	{
+	public:
+		CMemoryReportOption()
+		: IOption()
+		, m_bReport( false )
+		{
+		}
+		virtual ~CMemoryReportOption()
+		{
+		}
+
+		const char *GetLongName() const AX_OVERRIDE		{ return "memory-report"; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return "Report the peak RSS and each subsystem's memory high-water mark for every compilation phase."; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::None; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		bool OnCall( UOptionArg ) AX_OVERRIDE
+		{
+			m_bReport = true;
+			return true;
+		}
+
+		bool IsSet() const
+		{
+			return m_bReport;
+		}
+
+	private:
+		bool						m_bReport;
+	};
+
+	class CProfileGenerateOption: public IOption
+	{
+	public:
+		CProfileGenerateOption()
+		: IOption()
+		, m_bProfileGenerate( false )
+		{
+		}
+		virtual ~CProfileGenerateOption()
+		{
+		}
+
+		const char *GetLongName() const AX_OVERRIDE		{ return "profile-generate"; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return "Instrument the program to write a profile when it exits."; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::None; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		bool OnCall( UOptionArg ) AX_OVERRIDE
+		{
+			m_bProfileGenerate = true;
+			return true;
+		}
+
+		bool IsSet() const
+		{
+			return m_bProfileGenerate;
+		}
+
+	private:
+		bool						m_bProfileGenerate;
+	};
+
+	class CProfileUseOption: public IOption
+	{
+	public:
+		CProfileUseOption()
+		: IOption()
+		, m_ProfileFile()
+		{
+		}
+		virtual ~CProfileUseOption()
+		{
+		}
+
+		const char *GetLongName() const AX_OVERRIDE		{ return "profile-use"; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return "Optimize using a profile merged with llvm-profdata."; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::File; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		bool OnCall( UOptionArg Arg ) AX_OVERRIDE
+		{
+			AX_ASSERT_NOT_NULL( Arg.pszValue );
+			AX_ASSERT_MSG( Arg.EnumValue > 0x1000, "Invalid string pointer" );
+
+			char szPath[ PATH_MAX + 1 ];
+			if( !Ax::GetAbsolutePath( szPath, Arg.pszValue ) || Ax::System::GetModifiedTime( szPath ) == -1 ) {
+				Ax::Errorf( Arg.pszValue, "Profile not found" );
+				return false;
+			}
+
+			AX_EXPECT_MEMORY( m_ProfileFile.Assign( szPath ) );
+
+			// The profile the program writes has to be indexed before use
+			if( m_ProfileFile.CaseEndsWith( ".profraw" ) ) {
+				Ax::Errorf( m_ProfileFile, "Raw profiles must be merged first (llvm-profdata merge -o <name>.profdata <name>.profraw)" );
+				return false;
+			}
+
+			return true;
+		}
+
+		bool IsSet() const
+		{
+			return !m_ProfileFile.IsEmpty();
+		}
+		const Ax::String &GetProfileFile() const
+		{
+			return m_ProfileFile;
+		}
+
+	private:
+		Ax::String					m_ProfileFile;
+	};
+
 	class COutputOption: public virtual IOption
 	{
 	public:
@@ -338,6 +572,51 @@ namespace Tenshi { namespace Compiler {
 		Ax::String					m_OutputFile;
 	};
 
+	class CSocketOption: public IOption
+	{
+	public:
+		CSocketOption( const char *pszLongName, const char *pszBriefHelp )
+		: IOption()
+		, m_pszLongName( pszLongName )
+		, m_pszBriefHelp( pszBriefHelp )
+		, m_SocketPath()
+		{
+		}
+		virtual ~CSocketOption()
+		{
+		}
+
+		const char *GetLongName() const AX_OVERRIDE		{ return m_pszLongName; }
+
+		const char *GetBriefHelp() const AX_OVERRIDE	{ return m_pszBriefHelp; }
+
+		EOptionArg GetArgumentType() const AX_OVERRIDE	{ return EOptionArg::File; }
+		bool ShouldShowInHelp() const AX_OVERRIDE		{ return true; }
+
+		bool OnCall( UOptionArg Arg ) AX_OVERRIDE
+		{
+			AX_ASSERT_NOT_NULL( Arg.pszValue );
+			AX_ASSERT_MSG( Arg.EnumValue > 0x1000, "Invalid string pointer" );
+
+			AX_EXPECT_MEMORY( m_SocketPath.Assign( Arg.pszValue ) );
+			return true;
+		}
+
+		bool IsSet() const
+		{
+			return !m_SocketPath.IsEmpty();
+		}
+		const Ax::String &GetSocketPath() const
+		{
+			return m_SocketPath;
+		}
+
+	private:
+		const char *const			m_pszLongName;
+		const char *const			m_pszBriefHelp;
+		Ax::String					m_SocketPath;
+	};
+
 }}
 
 bool ProcessFile( const char *pszInputFile )
@@ -360,20 +639,80 @@ bool ProcessFile( const char *pszInputFile )
 	return true;
 }
 
+int BuildRequest( const SBuildRequest &Request )
+{
+	int ExitStatus = EXIT_SUCCESS;
+
+	// Settings are per build, as the compile server runs builds for
+	// different clients
+	CG->SetOptimize( Request.bOptimize );
+	CG->SetPartitions( Request.cPartitions );
+	CG->SetProfileGenerate( Request.bProfileGenerate );
+	CG->SetProfileUse( Request.ProfileUseFile );
+	Binutils->SetProfiling( Request.bProfileGenerate );
+
+	bool bDidAllSucceed = false;
+	for( const Ax::String &Input : Request.Inputs ) {
+		if( !ProcessFile( Input ) ) {
+			Ax::Errorf( Input, "Failed to process file; ignoring all other inputs" );
+			ExitStatus = EXIT_FAILURE;
+			break;
+		}
+
+		bDidAllSucceed = true;
+	}
+
+	if( bDidAllSucceed ) {
+		if( !Request.OutputFile.IsEmpty() ) {
+			Projects->Current().ApplyLine( "(command-line)", 1, "-TargetPrefix" );
+			Projects->Current().ApplyLine( "(command-line)", 1, "-TargetSuffix" );
+			Projects->Current().ApplyLine( "(command-line)", 1, "Target " + Request.OutputFile.Escape().Quote() );
+		}
+
+		MemTracker->BeginPhase( "(modules)", "load" );
+		Mods->LoadCoreInternal();
+		Mods->LoadCorePlugins();
+		MemTracker->EndPhase();
+
+		if( !Projects->Build() ) {
+			ExitStatus = EXIT_FAILURE;
+		}
+	}
+
+	return ExitStatus;
+}
+
 int main( int argc, char **argv )
 {
 #ifdef _WIN32
 	SendMessageW( GetConsoleWindow(), WM_SETICON, 0, ( LPARAM )LoadIconW( GetModuleHandleW(nullptr), ( LPCWSTR )1 ) );
 #endif
 	Ax::InstallConsoleReporter();
+	MemTracker->Init();
 
 	CHelpOption HelpOpt;
 	CCompileOnlyOption CompOnlyOpt;
 	COutputOption OutputOpt;
+	CWatchOption WatchOpt;
+	COptimizeOption OptimizeOpt;
+	CPartitionsOption PartitionsOpt;
+	CMemoryReportOption MemReportOpt;
+	CProfileGenerateOption ProfileGenOpt;
+	CProfileUseOption ProfileUseOpt;
+	CSocketOption ServerOpt( "server", "Keep running as a compile server listening on the given socket." );
+	CSocketOption ConnectOpt( "connect", "Have the compile server on the given socket do the build." );
 
 	Opts->Register( HelpOpt );
 	Opts->Register( CompOnlyOpt );
 	Opts->Register( OutputOpt );
+	Opts->Register( WatchOpt );
+	Opts->Register( OptimizeOpt );
+	Opts->Register( PartitionsOpt );
+	Opts->Register( MemReportOpt );
+	Opts->Register( ProfileGenOpt );
+	Opts->Register( ProfileUseOpt );
+	Opts->Register( ServerOpt );
+	Opts->Register( ConnectOpt );
 
 	int ExitStatus = EXIT_SUCCESS;
 	bool bProcessArgs = true;
@@ -414,35 +753,61 @@ int main( int argc, char **argv )
 		return ExitStatus;
 	}
 
-	bool bDidAllSucceed = false;
-	for( const char *pszInputFile : Opts->GetInputs() ) {
-		if( !ProcessFile( pszInputFile ) ) {
-			Ax::Errorf( pszInputFile, "Failed to process file; ignoring all other inputs" );
-			ExitStatus = EXIT_FAILURE;
-			break;
-		}
+	MemTracker->SetReporting( MemReportOpt.IsSet() );
 
-		bDidAllSucceed = true;
+	if( ProfileGenOpt.IsSet() && ProfileUseOpt.IsSet() ) {
+		Ax::BasicErrorf( "Cannot both generate and use a profile in the same build" );
+		return EXIT_FAILURE;
 	}
 
-	if( bDidAllSucceed ) {
-		if( OutputOpt.HasOutputFile() ) {
-			Projects->Current().ApplyLine( "(command-line)", 1, "-TargetPrefix" );
-			Projects->Current().ApplyLine( "(command-line)", 1, "-TargetSuffix" );
-			Projects->Current().ApplyLine( "(command-line)", 1, "Target " + OutputOpt.GetOutputFile().Escape().Quote() );
+	if( ServerOpt.IsSet() ) {
+		if( !Opts->GetInputs().IsEmpty() ) {
+			Ax::g_WarningLog += "Ignoring input files given to the compile server";
 		}
-
-		if( CompOnlyOpt.IsSet() ) {
-			AX_DEBUG_LOG += "Compile-only not yet implemented";
+		if( OptimizeOpt.IsSet() || PartitionsOpt.GetPartitions() != 1 || ProfileGenOpt.IsSet() || ProfileUseOpt.IsSet() ) {
+			Ax::g_WarningLog += "Ignoring build settings given to the compile server; each client sends its own";
 		}
 
-		Mods->LoadCoreInternal();
-		Mods->LoadCorePlugins();
+		return Server->Run( ServerOpt.GetSocketPath(), &BuildRequest ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
-		if( !Projects->Build() ) {
-			ExitStatus = EXIT_FAILURE;
+	if( CompOnlyOpt.IsSet() ) {
+		AX_DEBUG_LOG += "Compile-only not yet implemented";
+	}
+
+	SBuildRequest Request;
+
+	for( const char *pszInputFile : Opts->GetInputs() ) {
+		AX_EXPECT_MEMORY( Request.Inputs.Append() );
+		AX_EXPECT_MEMORY( Request.Inputs.Last().Assign( pszInputFile ) );
+	}
+	if( OutputOpt.HasOutputFile() ) {
+		AX_EXPECT_MEMORY( Request.OutputFile.Assign( OutputOpt.GetOutputFile() ) );
+	}
+	Request.bOptimize = OptimizeOpt.IsSet();
+	Request.cPartitions = PartitionsOpt.GetPartitions();
+	Request.bProfileGenerate = ProfileGenOpt.IsSet();
+	if( ProfileUseOpt.IsSet() ) {
+		AX_EXPECT_MEMORY( Request.ProfileUseFile.Assign( ProfileUseOpt.GetProfileFile() ) );
+	}
+
+	if( ConnectOpt.IsSet() ) {
+		if( WatchOpt.IsSet() ) {
+			Ax::g_WarningLog += "Watch mode is not available with the compile server";
 		}
+
+		AX_EXPECT_MEMORY( Request.WorkingDir.Assign( Ax::System::GetDir() ) );
+		return Server->Request( ConnectOpt.GetSocketPath(), Request );
 	}
 
+	ExitStatus = BuildRequest( Request );
+
+	// Errors from the first build get fixed while watching
+	if( WatchOpt.IsSet() ) {
+		return Watcher->Run() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	MemTracker->ReportTotals();
+
 	return ExitStatus;
 }
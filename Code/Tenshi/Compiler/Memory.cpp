@@ -0,0 +1,273 @@
+#include "_PCH.hpp"
+#include "Memory.hpp"
+
+#include <new>
+
+#ifdef _WIN32
+# include <Windows.h>
+# include <Psapi.h>
+#else
+# include <sys/resource.h>
+#endif
+
+namespace Tenshi { namespace Compiler {
+
+	static Ax::String FormatSize( Ax::uint64 cBytes )
+	{
+		if( cBytes < 1024 ) {
+			return Ax::String::Formatted( "%u B", ( unsigned )cBytes );
+		}
+		if( cBytes < 1024*1024 ) {
+			return Ax::String::Formatted( "%.1f KiB", double( cBytes )/1024.0 );
+		}
+
+		return Ax::String::Formatted( "%.1f MiB", double( cBytes )/( 1024.0*1024.0 ) );
+	}
+
+	// Most memory the process has had resident (since the last reset, where
+	// the platform allows one)
+	static Ax::uint64 GetPeakRSS()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS Counters;
+		if( !GetProcessMemoryInfo( GetCurrentProcess(), &Counters, sizeof( Counters ) ) ) {
+			return 0;
+		}
+
+		return Counters.PeakWorkingSetSize;
+#else
+# ifdef __linux__
+		// Unlike ru_maxrss, VmHWM is reset through clear_refs
+		if( FILE *fp = fopen( "/proc/self/status", "r" ) ) {
+			char szLine[ 256 ];
+			unsigned long long cKiB = 0;
+			bool bFound = false;
+
+			while( !bFound && fgets( szLine, sizeof( szLine ), fp ) != nullptr ) {
+				bFound = sscanf( szLine, "VmHWM: %llu kB", &cKiB ) == 1;
+			}
+
+			fclose( fp );
+			if( bFound ) {
+				return ( Ax::uint64 )cKiB*1024;
+			}
+		}
+# endif
+
+		struct rusage Usage;
+		if( getrusage( RUSAGE_SELF, &Usage ) != 0 ) {
+			return 0;
+		}
+
+# ifdef __APPLE__
+		return ( Ax::uint64 )Usage.ru_maxrss;
+# else
+		return ( Ax::uint64 )Usage.ru_maxrss*1024;
+# endif
+#endif
+	}
+	// Start measuring the peak RSS from the current RSS
+	static bool ResetPeakRSS()
+	{
+#ifdef __linux__
+		FILE *const fp = fopen( "/proc/self/clear_refs", "w" );
+		if( !fp ) {
+			return false;
+		}
+
+		// Kernels before 4.0 reject this (which only shows up on the flush)
+		const bool bWrote = fputs( "5", fp ) >= 0;
+		return fclose( fp ) == 0 && bWrote;
+#else
+		return false;
+#endif
+	}
+
+	MMemoryTracker &MMemoryTracker::GetInstance()
+	{
+		static MMemoryTracker instance;
+		return instance;
+	}
+
+	MMemoryTracker::MMemoryTracker()
+	: m_bReporting( false )
+	, m_bCanResetPeakRSS( false )
+	, m_Unit()
+	, m_pszPhase( nullptr )
+	{
+		for( Ax::uintptr &HighWater : m_HighWater ) {
+			HighWater = 0;
+		}
+	}
+	MMemoryTracker::~MMemoryTracker()
+	{
+	}
+
+	void MMemoryTracker::Init()
+	{
+		Ax::SetAllocatorName( "misc", kMemtag_Misc );
+		Ax::SetAllocatorName( "lexer", kMemtag_Lexer );
+		Ax::SetAllocatorName( "ast", kMemtag_AST );
+		Ax::SetAllocatorName( "symbols", kMemtag_Symbols );
+		Ax::SetAllocatorName( "modules", kMemtag_Modules );
+		Ax::SetAllocatorName( "llvm", kMemtag_LLVM );
+	}
+
+	void MMemoryTracker::SetReporting( bool bReport )
+	{
+		m_bReporting = bReport;
+	}
+	bool MMemoryTracker::IsReporting() const
+	{
+		return m_bReporting;
+	}
+
+	void MMemoryTracker::FoldHighWater()
+	{
+		for( int Tag = kMemtag_Misc; Tag < kNumMemtags; ++Tag ) {
+			const Ax::STagStats &Stats = Ax::GetAllocStats( Tag );
+
+			if( m_HighWater[ Tag ] < Stats.MaxMemUsage ) {
+				m_HighWater[ Tag ] = Stats.MaxMemUsage;
+			}
+		}
+	}
+
+	void MMemoryTracker::BeginPhase( const char *pszUnit, const char *pszPhase )
+	{
+		AX_ASSERT_NOT_NULL( pszUnit );
+		AX_ASSERT_NOT_NULL( pszPhase );
+
+		if( !m_bReporting ) {
+			return;
+		}
+
+		EndPhase();
+
+		// Each tag's peak restarts from what it holds now, so the phase's own
+		// high-water mark can be read back at the end
+		FoldHighWater();
+		for( int Tag = kMemtag_Misc; Tag < kNumMemtags; ++Tag ) {
+			Ax::STagStats &Stats = Ax::GetAllocStats( Tag );
+			Stats.MaxMemUsage = Stats.CurMemUsage;
+		}
+
+		m_bCanResetPeakRSS = ResetPeakRSS();
+
+		AX_EXPECT_MEMORY( m_Unit.Assign( pszUnit ) );
+		m_pszPhase = pszPhase;
+	}
+	void MMemoryTracker::EndPhase()
+	{
+		if( !m_bReporting || !m_pszPhase ) {
+			return;
+		}
+
+		Ax::String Report;
+
+		AX_EXPECT_MEMORY( Report.Assign( Ax::String::Formatted( "Memory [%s] %s: peak RSS %s%s; high-water/now",
+			m_Unit.CString(), m_pszPhase, FormatSize( GetPeakRSS() ).CString(),
+			m_bCanResetPeakRSS ? "" : " (process)" ) ) );
+
+		for( int Tag = kMemtag_Misc; Tag < kNumMemtags; ++Tag ) {
+#if !TENSHI_LLVM_MEMTAG_ENABLED
+			if( Tag == kMemtag_LLVM ) {
+				continue;
+			}
+#endif
+			const Ax::STagStats &Stats = Ax::GetAllocStats( Tag );
+
+			AX_EXPECT_MEMORY( Report.Append( Ax::String::Formatted( "%s %s %s/%s",
+				Tag == kMemtag_Misc ? "" : ",", Ax::GetAllocatorName( Tag ),
+				FormatSize( Stats.MaxMemUsage ).CString(), FormatSize( Stats.CurMemUsage ).CString() ) ) );
+		}
+
+		Ax::BasicStatusf( "%s", Report.CString() );
+
+		m_Unit.Clear();
+		m_pszPhase = nullptr;
+	}
+
+	void MMemoryTracker::ReportTotals()
+	{
+		if( !m_bReporting ) {
+			return;
+		}
+
+		EndPhase();
+		FoldHighWater();
+
+		for( int Tag = kMemtag_Misc; Tag < kNumMemtags; ++Tag ) {
+#if !TENSHI_LLVM_MEMTAG_ENABLED
+			if( Tag == kMemtag_LLVM ) {
+				Ax::BasicStatusf( "Memory high-water %s: (not tracked)", Ax::GetAllocatorName( Tag ) );
+				continue;
+			}
+#endif
+			const Ax::STagStats &Stats = Ax::GetAllocStats( Tag );
+
+			Ax::BasicStatusf( "Memory high-water %s: %s (%u allocation%s outstanding)",
+				Ax::GetAllocatorName( Tag ), FormatSize( m_HighWater[ Tag ] ).CString(),
+				( unsigned )( Stats.cAllocs - Stats.cDeallocs ), Stats.cAllocs - Stats.cDeallocs == 1 ? "" : "s" );
+		}
+
+		// Phases reset the peak, so this is only the whole run's without them
+		if( !m_bCanResetPeakRSS ) {
+			Ax::BasicStatusf( "Memory peak RSS: %s", FormatSize( GetPeakRSS() ).CString() );
+		}
+	}
+
+}}
+
+#if TENSHI_LLVM_MEMTAG_ENABLED
+/*
+	The compiler's own classes pick their memtags (TENSHI_MEMTAG_ALLOCS) so
+	what's left going through the global operator new is LLVM's.
+
+	Every form is replaced, including nothrow (some runtimes implement that
+	with malloc directly, which Ax::Dealloc couldn't free).
+*/
+void *operator new( size_t n )
+{
+	return Ax::Alloc( n > 0 ? n : 1, Tenshi::Compiler::kMemtag_LLVM );
+}
+void *operator new[]( size_t n )
+{
+	return Ax::Alloc( n > 0 ? n : 1, Tenshi::Compiler::kMemtag_LLVM );
+}
+void *operator new( size_t n, const std::nothrow_t & ) noexcept
+{
+	return Ax::Alloc( n > 0 ? n : 1, Tenshi::Compiler::kMemtag_LLVM );
+}
+void *operator new[]( size_t n, const std::nothrow_t & ) noexcept
+{
+	return Ax::Alloc( n > 0 ? n : 1, Tenshi::Compiler::kMemtag_LLVM );
+}
+
+void operator delete( void *p ) noexcept
+{
+	Ax::Dealloc( p );
+}
+void operator delete[]( void *p ) noexcept
+{
+	Ax::Dealloc( p );
+}
+void operator delete( void *p, const std::nothrow_t & ) noexcept
+{
+	Ax::Dealloc( p );
+}
+void operator delete[]( void *p, const std::nothrow_t & ) noexcept
+{
+	Ax::Dealloc( p );
+}
+# if defined( __cpp_sized_deallocation )
+void operator delete( void *p, size_t ) noexcept
+{
+	Ax::Dealloc( p );
+}
+void operator delete[]( void *p, size_t ) noexcept
+{
+	Ax::Dealloc( p );
+}
+# endif
+#endif
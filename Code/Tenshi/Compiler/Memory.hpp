@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Allocation/Allocator.hpp>
+#include <Core/Manager.hpp>
+#include <Core/String.hpp>
+
+#include <stddef.h>
+
+// Whether the global operator new (used by LLVM) allocates through Ax::Alloc
+//
+// This costs a tag header on every one of LLVM's allocations, so it can be
+// turned off for builds where that matters more than knowing LLVM's share.
+#ifndef TENSHI_LLVM_MEMTAG_ENABLED
+# define TENSHI_LLVM_MEMTAG_ENABLED AX_MEMTAGS_ENABLED
+#endif
+
+namespace Tenshi { namespace Compiler {
+
+	/*
+	===========================================================================
+
+		MEMORY
+
+		Allocations are tagged with the subsystem they belong to (see
+		Ax::Alloc) so that what each one holds, and the most it ever held, can
+		be reported for each phase of a compilation. Data the later phases
+		don't need is released at the boundary between them (the lexer's
+		lookahead once parsing is done, the parse tree, its tokens, and its
+		symbols once the module has been generated).
+
+	===========================================================================
+	*/
+
+	enum EMemtag
+	{
+		// Anything not given a tag of its own
+		kMemtag_Misc = AX_DEFAULT_MEMTAG,
+		// Source text, tokens, and the lexer's lookahead
+		kMemtag_Lexer,
+		// Parse tree nodes and their type references
+		kMemtag_AST,
+		// Scopes, symbols, and the type information they describe
+		kMemtag_Symbols,
+		// Module declarations loaded from the command files
+		kMemtag_Modules,
+		// Everything allocated through the global operator new (LLVM)
+		kMemtag_LLVM,
+
+		kNumMemtags
+	};
+
+	// Route "new" and "delete" of the class containing this through a memtag
+	//
+	// new( Ax::SMemtag( Tag ) ) overrides the tag for one allocation.
+#define TENSHI_MEMTAG_ALLOCS(Tag)\
+	static void *operator new( size_t n ) { return Ax::Alloc( n, Tag ); }\
+	static void *operator new( size_t n, const Ax::SMemtag &InTag ) { return Ax::Alloc( n, InTag ); }\
+	static void operator delete( void *p ) { Ax::Dealloc( p ); }\
+	static void operator delete( void *p, const Ax::SMemtag & ) { Ax::Dealloc( p ); }
+
+	class MMemoryTracker
+	{
+	public:
+		static MMemoryTracker &GetInstance();
+
+		// Name the memtags (for reports and leak warnings)
+		void Init();
+
+		// Enable or disable reporting each phase as it ends
+		void SetReporting( bool bReport );
+		bool IsReporting() const;
+
+		// Start measuring a phase (ending the current one, if any)
+		void BeginPhase( const char *pszUnit, const char *pszPhase );
+		// Stop measuring the current phase, then report it
+		void EndPhase();
+
+		// Report the most each memtag ever held along with the peak RSS
+		void ReportTotals();
+
+	private:
+		// Whether phases are being measured
+		bool						m_bReporting;
+		// Whether the peak RSS can be reset at the start of a phase
+		bool						m_bCanResetPeakRSS;
+		// Unit the current phase belongs to (empty if no phase is running)
+		Ax::String					m_Unit;
+		// Name of the current phase
+		const char *				m_pszPhase;
+		// Most memory each tag held before the current phase started
+		Ax::uintptr					m_HighWater[ kNumMemtags ];
+
+		MMemoryTracker();
+		~MMemoryTracker();
+
+		void FoldHighWater();
+
+		AX_DELETE_COPYFUNCS(MMemoryTracker);
+	};
+	static Ax::TManager<MMemoryTracker>	MemTracker;
+
+	// Ends the current phase when leaving scope
+	class CMemoryPhaseGuard
+	{
+	public:
+		CMemoryPhaseGuard() {}
+		~CMemoryPhaseGuard() { MemTracker->EndPhase(); }
+
+	private:
+		AX_DELETE_COPYFUNCS(CMemoryPhaseGuard);
+	};
+
+}}
@@ -16,7 +16,8 @@ namespace Tenshi { namespace Compiler {
 	}
 
 	MModules::MModules()
-	: m_Mods()
+	: m_Mods( Ax::SMemtag( kMemtag_Modules ) )
+	, m_Directories( Ax::SMemtag( kMemtag_Modules ) )
 	, m_iCurrentModId( 0 )
 	, m_pCoreMod( nullptr )
 	, m_bLoadedCoreMods( false )
@@ -40,6 +41,7 @@ namespace Tenshi { namespace Compiler {
 
 			// Text
 			".name $core"											NL
+			".threads safe"											NL
 			""														NL
 			"__AUTOPRINT%LS%teAutoPrint"							NL
 			"__SAFELOOP%0%teSafeLoop"								NL
@@ -95,6 +97,7 @@ namespace Tenshi { namespace Compiler {
 			"FIND LAST CHAR$[%IPSS%teStr_FindLastChar"				NL
 			"FIND LAST CHAR$[%IPSD%teStr_FindLastCharAsc"			NL
 			"FIND SUBSTRING$[%IPSS%teStr_FindSubstring"				NL
+			".threads serial"										NL
 			"FIRST TOKEN$[%SSS%teStr_FirstToken"					NL
 			"NEXT TOKEN$[%SSS%teStr_NextToken"						NL
 			"FREE TOKENS$%0%teStr_ClearTokens"						NL
@@ -119,6 +122,28 @@ namespace Tenshi { namespace Compiler {
 			"WRITE MEMBLOCK FLOAT64%LUPO%teWriteMemblockFloat64"	NL
 			"COPY MEMBLOCK%LLUPUPUP%teCopyMemblock"					NL
 			""														NL
+			"MAKE MAP[%L%teAllocMap"								NL
+			"MAKE MAP%L%teMakeMap"									NL
+			"DELETE MAP[%LL%teDeleteMap"							NL
+			"MAP EXIST[%BL%teMapExist"								NL
+			"MAP COUNT[%UPL%teMapCount"								NL
+			"CLEAR MAP%L%teMapClear"								NL
+			// An integer literal takes one cast to either kind of key, and ties
+			// go to the first overload, so the integer key forms come first
+			"MAP INSERT%LRR%teMapInsertInt"							NL
+			"MAP INSERT%LSR%teMapInsertStr"							NL
+			"MAP INSERT%LRS%teMapInsertIntStr"						NL
+			"MAP INSERT%LSS%teMapInsertStrStr"						NL
+			"MAP FIND[%RLR%teMapFindInt"							NL
+			"MAP FIND[%RLS%teMapFindStr"							NL
+			"MAP FIND$[%GLR%teMapFindIntStr"						NL
+			"MAP FIND$[%GLS%teMapFindStrStr"						NL
+			"MAP HAS[%BLR%teMapHasInt"								NL
+			"MAP HAS[%BLS%teMapHasStr"								NL
+			"MAP ERASE[%BLR%teMapEraseInt"							NL
+			"MAP ERASE[%BLS%teMapEraseStr"							NL
+			".threads safe"											NL
+			""														NL
 			"UINT BITS TO FLOAT[%FD%teUintBitsToFloat"				NL
 			"FLOAT TO UINT BITS[%DF%teFloatToUintBits"				NL
 			"IS NAN?[%BF%teIsNAN"									NL
@@ -139,11 +164,13 @@ namespace Tenshi { namespace Compiler {
 			"SQRT[%FF%teSqrt"										NL
 			"ABS[%FF%teAbs"											NL
 			"EXP[%FF%teExp"											NL
+			"LOG[%FF%teLog"											NL
 			"FLOOR[%FF%teFloor"										NL
 			"CEIL[%FF%teCeil"										NL
 			"ROUND[%FF%teRound"										NL
 			"FRAC[%FF%teFrac"										NL
 			"SIGN[%FF%teSign"										NL
+			"NOISE[%FF%teNoise"										NL
 			"MIN[%FFF%teMinF"										NL
 			"MIN[%LLL%teMinI"										NL
 			"MAX[%FFF%teMaxF"										NL
@@ -171,6 +198,17 @@ namespace Tenshi { namespace Compiler {
 			"LENGTH[%FFFF%teLength3D"								NL
 			"DISTANCE[%FFFFF%teDistance2D"							NL
 			"DISTANCE[%FFFFFFF%teDistance3D"						NL
+			"DOT[%FEF21EF21%teVec2Dot"								NL
+			"DOT[%FEF31EF31%teVec3Dot"								NL
+			"DOT[%FEF41EF41%teVec4Dot"								NL
+			"CROSS[%EF31EF31EF31%teVec3Cross"						NL
+			"CROSS[%EF41EF41EF41%teVec4Cross"						NL
+			"LENGTH[%FEF21%teVec2Length"							NL
+			"LENGTH[%FEF31%teVec3Length"							NL
+			"LENGTH[%FEF41%teVec4Length"							NL
+			"NORMALIZE[%EF21EF21%teVec2Normalize"					NL
+			"NORMALIZE[%EF31EF31%teVec3Normalize"					NL
+			"NORMALIZE[%EF41EF41%teVec4Normalize"					NL
 			"PERCENT[%FFF%tePercentF"								NL
 			"PERCENT[%LLL%tePercentI"								NL
 			""														NL
@@ -187,6 +225,7 @@ namespace Tenshi { namespace Compiler {
 			"RGBG#[%FD%teRgbGF"										NL
 			"RGBB#[%FD%teRgbBF"										NL
 			""														NL
+			".threads serial"										NL
 			"MAKE RNG[%L%teAllocRNG"								NL
 			"MAKE RNG%L%teMakeRNG"									NL
 			"DELETE RNG[%LL%teDeleteRNG"							NL
@@ -195,10 +234,24 @@ namespace Tenshi { namespace Compiler {
 			"RNG GENERATE[%DL%teRNGGenerate"						NL
 			"RNG GENERATE[%DLD%teRNGBoundedGenerate"				NL
 			"RNG GENERATE[%LLLL%teRNGRangedGenerate"				NL
+			"RNG ADVANCE%LQ%teRNGAdvance"							NL
+			"RNG SPLIT%LLD%teRNGSplit"								NL
+			"FILL MEMBLOCK RND%LUPUP%teFillMemblockRnd"				NL
+			"FILL MEMBLOCK RND%LUPUPLL%teFillMemblockRndRanged"		NL
+			"FILL MEMBLOCK RND#%LUPUPFF%teFillMemblockRndFloat"		NL
+			""														NL
+			".threads safe"											NL
 			"RANDOMIZE%D%teRandomize"								NL
 			"RND[%D%teRnd"											NL
 			"RND[%DD%teRndBounded"									NL
 			"RND[%LLL%teRndRanged"									NL
+			"RND ADVANCE%Q%teRndAdvance"							NL
+			""														NL
+			".threads serial"										NL
+			"SET WORKER COUNT%D%teSetWorkerCount"					NL
+			".threads safe"											NL
+			"WORKER COUNT[%D%teGetWorkerCount"						NL
+			"PERF TIMER[%Q%tePerfTimer"								NL
 			""														NL
 		);
 #undef NL
@@ -267,6 +320,8 @@ namespace Tenshi { namespace Compiler {
 		Lines = Text.Split( "\n" );
 
 		bool bIgnoring = false;
+		// Set by ".threads safe" for the functions declared after it
+		bool bThreadSafe = false;
 
 		for( Ax::String &Line : Lines ) {
 			++uLineNum;
@@ -410,6 +465,15 @@ namespace Tenshi { namespace Compiler {
 					} else {
 						cExpectedArgs = 2;
 					}
+				} else if( Parts[0] == ".threads" ) {
+					if( Parts.Num() == 2 && ( Parts[1] == "safe" || Parts[1] == "serial" ) ) {
+						bThreadSafe = Parts[1] == "safe";
+					} else if( Parts.Num() == 2 ) {
+						g_ErrorLog( Filename, uLineNum ) += "Directive '.threads' expects \"safe\" or \"serial\"";
+						continue;
+					} else {
+						cExpectedArgs = 2;
+					}
 				} else if( Parts[0] == ".object" ) {
 					if( Parts.Num() == 2 ) {
 						bAssignResult = ObjectFilename.Assign( Parts[1] );
@@ -520,7 +584,7 @@ namespace Tenshi { namespace Compiler {
 				}
 
 				if( !pSym->pFunc ) {
-					pSym->pFunc = new SFunctionInfo();
+					pSym->pFunc = new( Ax::SMemtag( kMemtag_Modules ) ) SFunctionInfo();
 					AX_EXPECT_MEMORY( pSym->pFunc );
 
 					pSym->pFunc->Name = CommandName;
@@ -558,6 +622,7 @@ namespace Tenshi { namespace Compiler {
 				}
 
 				Func.pModule = &Mod;
+				Func.bThreadSafe = bThreadSafe;
 				Func.RealName.Swap( SymbolName );
 
 				InstallKeyword( CommandName, ( void * )pSym, 0, Ax::Parser::EKeywordExists::Ignore );
@@ -621,6 +686,8 @@ namespace Tenshi { namespace Compiler {
 			return;
 		}
 
+		AX_EXPECT_MEMORY( m_Directories.Append( DirectoryName ) );
+
 		Files.FilterExtension( ".commands" );
 
 		g_VerboseLog( DirectoryName ) += "Found " + Ax::String( ( int )Files.Num() ) + " files";
@@ -645,6 +712,36 @@ namespace Tenshi { namespace Compiler {
 		g_VerboseLog( DirectoryName ) += "Successfully loaded " + Ax::String( ( int )cSuccesses ) + " modules";
 	}
 
+	void MModules::ClearTranslations()
+	{
+		for( SModule &Mod : m_Mods ) {
+			for( uintptr i = 0; i < Mod.Definitions.NumSymbols(); ++i ) {
+				SSymbol &Sym = const_cast< SSymbol & >( *Mod.Definitions.Symbol( i ) );
+
+				Sym.Translated.pValue = nullptr;
+
+				if( Sym.pFunc != nullptr ) {
+					for( SFunctionOverload &Overload : Sym.pFunc->Overloads ) {
+						Overload.LLVMTypes.Clear();
+						Overload.pLLVMReturnType = nullptr;
+						Overload.pLLVMFuncType = nullptr;
+						Overload.pLLVMFunc = nullptr;
+					}
+				}
+
+				// The structure type itself lives in the context, which stays
+				if( Sym.pUDT != nullptr ) {
+					Sym.pUDT->pLLVMElementIndex = nullptr;
+					Sym.pUDT->pLLVMTypeDesc = nullptr;
+					Sym.pUDT->pLLVMInitFn = nullptr;
+					Sym.pUDT->pLLVMFiniFn = nullptr;
+					Sym.pUDT->pLLVMCopyFn = nullptr;
+					Sym.pUDT->pLLVMMoveFn = nullptr;
+				}
+			}
+		}
+	}
+
 	const Ax::TList< SModule > &MModules::List() const
 	{
 		return m_Mods;
@@ -654,4 +751,9 @@ namespace Tenshi { namespace Compiler {
 		return m_Mods;
 	}
 
+	const Ax::TArray< Ax::String > &MModules::Directories() const
+	{
+		return m_Directories;
+	}
+
 }}
@@ -102,14 +102,22 @@ namespace Tenshi { namespace Compiler {
 		SModule *LoadFromFile( const Ax::String &Filename );
 		void LoadDirectory( const Ax::String &DirectoryName );
 
+		// Forget the declarations generated for every module's symbols (they
+		// belonged to the LLVM module that was just deleted)
+		void ClearTranslations();
+
 		const Ax::TList< SModule > &List() const;
 		Ax::TList< SModule > &List();
 
+		// Directories module declarations were loaded from
+		const Ax::TArray< Ax::String > &Directories() const;
+
 	private:
 		MModules();
 		~MModules();
 
 		Ax::TList< SModule >		m_Mods;
+		Ax::TArray< Ax::String >	m_Directories;
 		int							m_iCurrentModId;
 
 		SModule *					m_pCoreMod;
@@ -51,6 +51,7 @@ namespace Tenshi { namespace Compiler {
 	, m_bInFunction( false )
 	, m_bInCase( false )
 	, m_bInLoop( false )
+	, m_bInParallel( false )
 	, m_pFunction( nullptr )
 	, m_pScope( nullptr )
 	{
@@ -73,6 +74,9 @@ namespace Tenshi { namespace Compiler {
 			m_bInCase = true;
 		} else if( Type == EStmtSeqType::LoopBlock ) {
 			m_bInLoop = true;
+		} else if( Type == EStmtSeqType::ParallelBlock ) {
+			m_bInLoop = true;
+			m_bInParallel = true;
 		}
 	}
 	EStmtSeqType CStatementSequence::Type() const
@@ -89,6 +93,7 @@ namespace Tenshi { namespace Compiler {
 		m_bInFunction |= OtherSeq.m_bInFunction;
 		m_bInCase |= OtherSeq.m_bInCase;
 		m_bInLoop |= OtherSeq.m_bInLoop;
+		m_bInParallel |= OtherSeq.m_bInParallel;
 
 		if( m_Type == EStmtSeqType::Function || m_pFunction != nullptr ) {
 			m_bInFunction = true;
@@ -99,6 +104,10 @@ namespace Tenshi { namespace Compiler {
 		if( m_Type == EStmtSeqType::LoopBlock ) {
 			m_bInLoop = true;
 		}
+		if( m_Type == EStmtSeqType::ParallelBlock ) {
+			m_bInLoop = true;
+			m_bInParallel = true;
+		}
 	}
 	bool CStatementSequence::InFunction() const
 	{
@@ -112,6 +121,10 @@ namespace Tenshi { namespace Compiler {
 	{
 		return m_bInLoop;
 	}
+	bool CStatementSequence::InParallel() const
+	{
+		return m_bInParallel;
+	}
 
 	void CStatementSequence::SetFunction( SSymbol *pSym )
 	{
@@ -190,6 +203,19 @@ namespace Tenshi { namespace Compiler {
 		return Result;
 	}
 
+	bool CStatementSequence::DeclaresLabels() const
+	{
+		for( const CStatement *const &pStmt : m_Statements ) {
+			AX_ASSERT_NOT_NULL( pStmt );
+
+			if( pStmt->DeclaresLabels() ) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
 	bool CStatementSequence::Semant()
 	{
 		for( CStatement *const &pStmt : m_Statements ) {
@@ -293,6 +319,11 @@ namespace Tenshi { namespace Compiler {
 
 		case EStmtType::AssignVar:						return "AssignVar";
 		case EStmtType::InvokeFunction:					return "InvokeFunction";
+		case EStmtType::SortArrayStmt:					return "SortArrayStmt";
+		case EStmtType::ArrayFillStmt:					return "ArrayFillStmt";
+		case EStmtType::ArrayCopyStmt:					return "ArrayCopyStmt";
+		case EStmtType::ArrayMathStmt:					return "ArrayMathStmt";
+		case EStmtType::ArrayRndStmt:					return "ArrayRndStmt";
 
 		case EStmtType::IfBlock:						return "IfBlock";
 		case EStmtType::SelectBlock:					return "SelectBlock";
@@ -302,6 +333,8 @@ namespace Tenshi { namespace Compiler {
 		case EStmtType::WhileBlock:						return "WhileBlock";
 		case EStmtType::RepeatBlock:					return "RepeatBlock";
 		case EStmtType::ForNextBlock:					return "ForNextBlock";
+		case EStmtType::ParallelForBlock:				return "ParallelForBlock";
+		case EStmtType::ForEachBlock:					return "ForEachBlock";
 
 		case EStmtType::GotoStmt:                       return "GotoStmt";
 		case EStmtType::FallthroughStmt:                return "FallthroughStmt";
@@ -310,6 +343,11 @@ namespace Tenshi { namespace Compiler {
 		return "(unknown)";
 	}
 
+	bool CStatement::DeclaresLabels() const
+	{
+		return m_Type == EStmtType::LabelDecl;
+	}
+
 	bool CStatement::Semant()
 	{
 		return true;
@@ -370,6 +408,7 @@ namespace Tenshi { namespace Compiler {
 		case EExprType::Member:				return "Member";
 		case EExprType::ArraySubscript:		return "ArraySubscript";
 		case EExprType::FunctionCall:		return "FunctionCall";
+		case EExprType::ArrayFunction:		return "ArrayFunction";
 		case EExprType::UnaryOp:			return "UnaryOp";
 		case EExprType::BinaryOp:			return "BinaryOp";
 		}
@@ -398,6 +437,10 @@ namespace Tenshi { namespace Compiler {
 	{
 		return nullptr;
 	}
+	const SConstant *CExpression::GetConstant() const
+	{
+		return nullptr;
+	}
 	bool CExpression::IsLValue() const
 	{
 		const STypeRef *const pType = GetType();
@@ -6,6 +6,7 @@
 #include "Lexer.hpp"
 #include "Operator.hpp"
 #include "BuiltinType.hpp"
+#include "Memory.hpp"
 
 namespace Tenshi { namespace Compiler {
 
@@ -38,7 +39,9 @@ namespace Tenshi { namespace Compiler {
 		Function,
 		SelectBlock,
 		CaseBlock,
-		LoopBlock
+		LoopBlock,
+		// Body of a PARALLEL FOR (also a loop)
+		ParallelBlock
 	};
 	enum class EStmtType
 	{
@@ -55,6 +58,11 @@ namespace Tenshi { namespace Compiler {
 
 		AssignVar,
 		InvokeFunction,
+		SortArrayStmt,
+		ArrayFillStmt,
+		ArrayCopyStmt,
+		ArrayMathStmt,
+		ArrayRndStmt,
 
 		IfBlock,
 		SelectBlock,
@@ -64,6 +72,8 @@ namespace Tenshi { namespace Compiler {
 		WhileBlock,
 		RepeatBlock,
 		ForNextBlock,
+		ParallelForBlock,
+		ForEachBlock,
 	};
 	enum class EExprType
 	{
@@ -75,6 +85,7 @@ namespace Tenshi { namespace Compiler {
 		Member,
 		ArraySubscript,
 		FunctionCall,
+		ArrayFunction,
 		UnaryOp,
 		BinaryOp
 	};
@@ -160,6 +171,53 @@ namespace Tenshi { namespace Compiler {
 		void Store( SValue FromVal );
 	};
 
+	//
+	//	Constant value, as determined during semantic analysis
+	//
+	//	Expressions that only depend on literals are evaluated by Semant() and
+	//	report their value through CExpression::GetConstant(). Integers are
+	//	stored extended to 64-bits (sign- or zero-extended as per the type),
+	//	real numbers are stored as doubles (rounded to the precision of the
+	//	type), and strings are stored in Text.
+	//
+	struct SConstant
+	{
+		// Type of the value (Invalid if the value is not known)
+		EBuiltinType				Type;
+		union
+		{
+			Ax::uint64				uValue;
+			Ax::int64				iValue;
+			double					fValue;
+		};
+		// Text of the value (only valid for strings)
+		Ax::String					Text;
+
+		inline SConstant()
+		: Type( EBuiltinType::Invalid )
+		, uValue( 0 )
+		, Text()
+		{
+		}
+
+		inline bool IsValid() const
+		{
+			return Type != EBuiltinType::Invalid;
+		}
+		// Whether the value would pass a condition (as in an IF statement)
+		inline bool IsTrue() const
+		{
+			if( IsString( Type ) ) {
+				return true;
+			}
+			if( IsRealNumber( Type ) ) {
+				return fValue != 0.0;
+			}
+
+			return uValue != 0;
+		}
+	};
+
 	//
 	//	Type Particle: Used by CTypeDecl during parsing to determine how a type
 	//	is made up
@@ -284,6 +342,8 @@ namespace Tenshi { namespace Compiler {
 	class CTypeDecl
 	{
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		CTypeDecl( const SToken &Tok, CParser &Parser );
 		~CTypeDecl();
 
@@ -312,6 +372,8 @@ namespace Tenshi { namespace Compiler {
 	//
 	struct STypeRef
 	{
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		// The built-in type (valid if pCustomType is NULL)
 		EBuiltinType				BuiltinType;
 		// The custom type (valid if BuiltinType == EBuiltinType::UserDefined)
@@ -409,6 +471,7 @@ namespace Tenshi { namespace Compiler {
 		bool InFunction() const;
 		bool InCase() const;
 		bool InLoop() const;
+		bool InParallel() const;
 
 		void SetFunction( SSymbol *pSym );
 		void SetScope( CScope *pScope );
@@ -447,6 +510,9 @@ namespace Tenshi { namespace Compiler {
 
 		Ax::String ToString() const;
 
+		// Whether any statement (including nested statements) declares a label
+		bool DeclaresLabels() const;
+
 		bool Semant();
 		bool CodeGen();
 
@@ -456,6 +522,7 @@ namespace Tenshi { namespace Compiler {
 		bool						m_bInFunction;
 		bool						m_bInCase;
 		bool						m_bInLoop;
+		bool						m_bInParallel;
 
 		SSymbol *					m_pFunction;
 		CScope *					m_pScope;
@@ -466,6 +533,8 @@ namespace Tenshi { namespace Compiler {
 	friend class CParser;
 	friend class CStatementSequence;
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		virtual ~CStatement();
 
 		inline bool Is( EStmtType InType ) const { return m_Type == InType; }
@@ -478,6 +547,7 @@ namespace Tenshi { namespace Compiler {
 		CStatementSequence &GetSequence() const;
 
 		virtual Ax::String ToString() const;
+		virtual bool DeclaresLabels() const;
 
 		virtual bool Semant();
 		virtual bool CodeGen();
@@ -504,6 +574,8 @@ namespace Tenshi { namespace Compiler {
 	{
 	friend class CParser;
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		virtual ~CExpression();
 
 		inline bool Is( EExprType InType ) const { return m_Type == InType; }
@@ -518,6 +590,8 @@ namespace Tenshi { namespace Compiler {
 		virtual Ax::String ToString() const;
 		virtual const SSymbol *GetSymbol() const;
 		virtual const STypeRef *GetType() const;
+		// Value of the expression if known at compile-time (valid after Semant())
+		virtual const SConstant *GetConstant() const;
 		bool IsLValue() const;
 
 		virtual bool Semant();
@@ -52,7 +52,9 @@ namespace Tenshi { namespace Compiler {
 		StrConcat,
 		StrRemove,
 		StrRepeat,
-		StrAddPath
+		StrAddPath,
+
+		MatMul
 	};
 
 	enum class ECast
@@ -92,7 +94,9 @@ namespace Tenshi { namespace Compiler {
 		Float64ToStr,
 
 		UTF8PtrToStr,
-		UTF16PtrToStr
+		UTF16PtrToStr,
+
+		ScalarToVector
 	};
 
 	struct SOperator
@@ -77,6 +77,19 @@ namespace Tenshi { namespace Compiler {
 	}
 	CParser::~CParser()
 	{
+		// The program's symbols point into the tree and its tokens
+		if( g_Prog->HasParser() && &g_Prog->Parser() == this ) {
+			g_Prog->ClearParser();
+		}
+
+		for( CFunctionDecl *&pFunc : m_FuncDecls ) {
+			delete pFunc;
+			pFunc = nullptr;
+		}
+		for( CUserDefinedType *&pType : m_Types ) {
+			delete pType;
+			pType = nullptr;
+		}
 	}
 
 	bool CParser::LoadFile( const char *pszFilename, Ax::EEncoding Encoding )
@@ -153,6 +166,9 @@ namespace Tenshi { namespace Compiler {
 			}
 		}
 
+		// Nothing is unread past this point
+		m_Lexer.ReleaseLookahead();
+
 		return true;
 	}
 	bool CParser::ParseStatement( CStatementSequence &DstSeq )
@@ -248,9 +264,19 @@ namespace Tenshi { namespace Compiler {
 
 				case kKeyword_Goto:
 				case kKeyword_Gosub:
+					if( DstSeq.InParallel() ) {
+						m_Lexer.Error( "GOTO and GOSUB cannot be used inside of a PARALLEL FOR" );
+						return false;
+					}
+
 					return ParseGotoGosub( tok, DstSeq );
 				
 				case kKeyword_GoBack:
+					if( DstSeq.InParallel() ) {
+						m_Lexer.Error( "GOBACK cannot be used inside of a PARALLEL FOR" );
+						return false;
+					}
+
 					return ParseReturn( tok, DstSeq );
 
 				case kKeyword_Do:
@@ -261,6 +287,27 @@ namespace Tenshi { namespace Compiler {
 					return ParseRepeatLoop( tok, DstSeq );
 				case kKeyword_For:
 					return ParseForLoop( tok, DstSeq );
+				case kKeyword_ParallelFor:
+					return ParseParallelForLoop( tok, DstSeq );
+				case kKeyword_ForEach:
+					return ParseForEachLoop( tok, DstSeq );
+
+				case kKeyword_SortArray:
+				case kKeyword_StableSortArray:
+					return ParseSortArray( tok, DstSeq );
+				case kKeyword_ArrayFill:
+					return ParseArrayFill( tok, DstSeq );
+				case kKeyword_ArrayCopy:
+					return ParseArrayCopy( tok, DstSeq );
+				case kKeyword_ArraySin:
+				case kKeyword_ArrayCos:
+				case kKeyword_ArraySqrt:
+				case kKeyword_ArrayExp:
+				case kKeyword_ArrayLog:
+				case kKeyword_ArrayNoise:
+					return ParseArrayMath( tok, DstSeq );
+				case kKeyword_ArrayRnd:
+					return ParseArrayRnd( tok, DstSeq );
 
 				case kKeyword_Select:
 					return ParseSelect( tok, DstSeq );
@@ -298,7 +345,13 @@ namespace Tenshi { namespace Compiler {
 					return ParseFallthrough( tok, DstSeq );
 
 				case kKeyword_Local:
+					return ParseVariableDeclaration( tok, DstSeq );
 				case kKeyword_Global:
+					if( DstSeq.InParallel() ) {
+						m_Lexer.Error( "GLOBALs cannot be declared inside of a PARALLEL FOR" );
+						return false;
+					}
+
 					return ParseVariableDeclaration( tok, DstSeq );
 
 				case kKeyword_Type:
@@ -321,6 +374,10 @@ namespace Tenshi { namespace Compiler {
 						m_Lexer.Error( "EXITFUNCTION can only be used inside of a FUNCTION/ENDFUNCTION block" );
 						return false;
 					}
+					if( DstSeq.InParallel() ) {
+						m_Lexer.Error( "EXITFUNCTION cannot be used inside of a PARALLEL FOR" );
+						return false;
+					}
 
 					return ParseExitFunction( tok, DstSeq );
 
@@ -422,6 +479,34 @@ namespace Tenshi { namespace Compiler {
 	{
 		return DstSeq.NewStmt< CForLoopStmt >( Tok, *this ).Parse();
 	}
+	bool CParser::ParseParallelForLoop( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CParallelForStmt >( Tok, *this ).Parse();
+	}
+	bool CParser::ParseForEachLoop( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CForEachStmt >( Tok, *this ).Parse();
+	}
+	bool CParser::ParseSortArray( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CSortArrayStmt >( Tok, *this ).Parse();
+	}
+	bool CParser::ParseArrayFill( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CArrayFillStmt >( Tok, *this ).Parse();
+	}
+	bool CParser::ParseArrayCopy( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CArrayCopyStmt >( Tok, *this ).Parse();
+	}
+	bool CParser::ParseArrayMath( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CArrayMathStmt >( Tok, *this ).Parse();
+	}
+	bool CParser::ParseArrayRnd( const SToken &Tok, CStatementSequence &DstSeq )
+	{
+		return DstSeq.NewStmt< CArrayRndStmt >( Tok, *this ).Parse();
+	}
 	bool CParser::ParseSelect( const SToken &Tok, CStatementSequence &DstSeq )
 	{
 		return DstSeq.NewStmt< CSelectStmt >( Tok, *this ).Parse();
@@ -510,6 +595,23 @@ namespace Tenshi { namespace Compiler {
 			return pNode;
 		}
 
+		if( Tok.IsKeyword( kKeyword_ArraySum ) || Tok.IsKeyword( kKeyword_ArrayMin ) || Tok.IsKeyword( kKeyword_ArrayMax ) || Tok.IsKeyword( kKeyword_ArrayFind ) || Tok.IsKeyword( kKeyword_ArrayCount ) || Tok.IsKeyword( kKeyword_ArrayLen ) ) {
+			if( !m_Lexer.Expect( ETokenType::Punctuation, "(" ) ) {
+				return nullptr;
+			}
+
+			CArrayFuncExpr *const pArrFuncExpr = new CArrayFuncExpr( Tok, *this );
+			AX_EXPECT_MEMORY( pArrFuncExpr );
+
+			pArrFuncExpr->m_pList = ParseExpressionList( &m_Lexer.Token() );
+			if( !pArrFuncExpr->m_pList ) {
+				delete pArrFuncExpr;
+				return nullptr;
+			}
+
+			return pArrFuncExpr;
+		}
+
 		m_Lexer.Unlex();
 		return ParseNameTerminal();
 	}
@@ -65,6 +65,13 @@ namespace Tenshi { namespace Compiler {
 		bool ParseWhileLoop( const SToken &Tok, CStatementSequence &DstSeq );
 		bool ParseRepeatLoop( const SToken &Tok, CStatementSequence &DstSeq );
 		bool ParseForLoop( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseParallelForLoop( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseForEachLoop( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseSortArray( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseArrayFill( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseArrayCopy( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseArrayMath( const SToken &Tok, CStatementSequence &DstSeq );
+		bool ParseArrayRnd( const SToken &Tok, CStatementSequence &DstSeq );
 		bool ParseSelect( const SToken &Tok, CStatementSequence &DstSeq );
 		bool ParseIf( const SToken &Tok, CStatementSequence &DstSeq );
 		bool ParseVariableDeclaration( const SToken &Tok, CStatementSequence &DstSeq );
@@ -168,6 +168,7 @@ namespace Tenshi { namespace Compiler {
 			Ax::Parser::SKeyword( "UNTIL",				kKeyword_Until ),
 			Ax::Parser::SKeyword( "FOR",				kKeyword_For ),
 			Ax::Parser::SKeyword( "FOREACH",			kKeyword_ForEach ),
+			Ax::Parser::SKeyword( "FOR EACH",			kKeyword_ForEach ),
 			Ax::Parser::SKeyword( "TO",					kKeyword_To ),
 			Ax::Parser::SKeyword( "IN",					kKeyword_In ),
 			Ax::Parser::SKeyword( "STEP",				kKeyword_Step ),
@@ -211,6 +212,25 @@ namespace Tenshi { namespace Compiler {
 			Ax::Parser::SKeyword( "THREAD FN",			kKeyword_ThreadFunction ),
 			Ax::Parser::SKeyword( "PARALLEL FOR",		kKeyword_ParallelFor ),
 			Ax::Parser::SKeyword( "PARALLEL FOREACH",	kKeyword_ParallelForEach ),
+			Ax::Parser::SKeyword( "REDUCE",				kKeyword_Reduce ),
+
+			Ax::Parser::SKeyword( "SORT ARRAY",			kKeyword_SortArray ),
+			Ax::Parser::SKeyword( "STABLE SORT ARRAY",	kKeyword_StableSortArray ),
+			Ax::Parser::SKeyword( "ARRAY FILL",			kKeyword_ArrayFill ),
+			Ax::Parser::SKeyword( "ARRAY COPY",			kKeyword_ArrayCopy ),
+			Ax::Parser::SKeyword( "ARRAY SUM",			kKeyword_ArraySum ),
+			Ax::Parser::SKeyword( "ARRAY MIN",			kKeyword_ArrayMin ),
+			Ax::Parser::SKeyword( "ARRAY MAX",			kKeyword_ArrayMax ),
+			Ax::Parser::SKeyword( "ARRAY FIND",			kKeyword_ArrayFind ),
+			Ax::Parser::SKeyword( "ARRAY COUNT",		kKeyword_ArrayCount ),
+			Ax::Parser::SKeyword( "ARRAY LEN",			kKeyword_ArrayLen ),
+			Ax::Parser::SKeyword( "ARRAY SIN",			kKeyword_ArraySin ),
+			Ax::Parser::SKeyword( "ARRAY COS",			kKeyword_ArrayCos ),
+			Ax::Parser::SKeyword( "ARRAY SQRT",			kKeyword_ArraySqrt ),
+			Ax::Parser::SKeyword( "ARRAY EXP",			kKeyword_ArrayExp ),
+			Ax::Parser::SKeyword( "ARRAY LOG",			kKeyword_ArrayLog ),
+			Ax::Parser::SKeyword( "ARRAY NOISE",		kKeyword_ArrayNoise ),
+			Ax::Parser::SKeyword( "ARRAY RND",			kKeyword_ArrayRnd ),
 
 			Ax::Parser::SKeyword( "INT8",				kKeyword_Int8 ),
 			Ax::Parser::SKeyword( "INT16",				kKeyword_Int16 ),
@@ -256,6 +276,10 @@ namespace Tenshi { namespace Compiler {
 			Ax::Parser::SKeyword( "DOUBLE INTEGER",		kKeyword_Int64 ),
 			Ax::Parser::SKeyword( "FLOAT",				kKeyword_Float32 ),
 			Ax::Parser::SKeyword( "DOUBLE FLOAT",		kKeyword_Float64 ),
+			Ax::Parser::SKeyword( "VEC2",				kKeyword_Vector2 ),
+			Ax::Parser::SKeyword( "VEC3",				kKeyword_Vector3 ),
+			Ax::Parser::SKeyword( "VEC4",				kKeyword_Vector4 ),
+			Ax::Parser::SKeyword( "MAT4",				kKeyword_Matrix4 ),
 
 			Ax::Parser::SKeyword( "END",				kKeyword_RT_End ),
 			Ax::Parser::SKeyword( "DATA",				kKeyword_RT_Data ),
@@ -84,6 +84,25 @@ namespace Tenshi { namespace Compiler {
 		kKeyword_ThreadFunction,
 		kKeyword_ParallelFor,
 		kKeyword_ParallelForEach,
+		kKeyword_Reduce,
+
+		kKeyword_SortArray,
+		kKeyword_StableSortArray,
+		kKeyword_ArrayFill,
+		kKeyword_ArrayCopy,
+		kKeyword_ArraySum,
+		kKeyword_ArrayMin,
+		kKeyword_ArrayMax,
+		kKeyword_ArrayFind,
+		kKeyword_ArrayCount,
+		kKeyword_ArrayLen,
+		kKeyword_ArraySin,
+		kKeyword_ArrayCos,
+		kKeyword_ArraySqrt,
+		kKeyword_ArrayExp,
+		kKeyword_ArrayLog,
+		kKeyword_ArrayNoise,
+		kKeyword_ArrayRnd,
 
 		kKeyword_Type_Start__,
 			kKeyword_Int8 = kKeyword_Type_Start__,
@@ -53,6 +53,20 @@ namespace Tenshi { namespace Compiler {
 			}
 		}
 
+		// Now that every call is known, mark the functions that call unsafe
+		// functions (directly or not) as unsafe themselves. This repeats until
+		// nothing changes, so recursive calls settle too.
+		bool bChanged;
+		do {
+			bChanged = false;
+			for( CFunctionDecl *pFunc : m_FuncDecls ) {
+				AX_ASSERT_NOT_NULL( pFunc );
+				if( pFunc->ResolveThreadSafety() ) {
+					bChanged = true;
+				}
+			}
+		} while( bChanged );
+
 		return true;
 	}
 
@@ -64,8 +64,11 @@ namespace Tenshi { namespace Compiler {
 	{
 		// Do not generate calls to SYNC in any loop except DO/LOOP
 		Off,
-		// Generate calls to SYNC in all loops except FOR/NEXT
-		On
+		// Generate calls to SYNC in all loops except FOR/NEXT, and check array
+		// subscripts (checks proven redundant in FOR/NEXT loops are hoisted)
+		On,
+		// Same as On, but keep every array bounds check (for debug builds)
+		Full
 	};
 	enum class EExecutable
 	{
@@ -18,6 +18,7 @@ namespace Tenshi { namespace Compiler {
 	: m_pParser( nullptr )
 	, m_GlobalScope()
 	, m_ScopeStack()
+	, m_pCurrentFunc( nullptr )
 	, m_GlobalSpace( 0 )
 	, m_ROMSpace( 0 )
 	{
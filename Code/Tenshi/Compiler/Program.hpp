@@ -62,6 +62,11 @@ namespace Tenshi { namespace Compiler {
 		const CScope &GlobalScope() const;
 		CScope &GlobalScope();
 
+		void EnterFunction( SFunctionOverload &Func );
+		void LeaveFunction();
+		SFunctionOverload *CurrentFunction();
+		void MarkThreadUnsafe();
+
 		Ax::uint32 AddGlobalSpace( Ax::uint32 cBytes );
 		Ax::uint32 TotalGlobalSpace() const;
 
@@ -73,6 +78,7 @@ namespace Tenshi { namespace Compiler {
 
 		CScope						m_GlobalScope;
 		Ax::TArray< CScope * >		m_ScopeStack;
+		SFunctionOverload *			m_pCurrentFunc;
 
 		Ax::uint32					m_GlobalSpace;
 		Ax::uint32					m_ROMSpace;
@@ -103,6 +109,29 @@ namespace Tenshi { namespace Compiler {
 		return *m_pParser;
 	}
 
+	inline void CProgram::EnterFunction( SFunctionOverload &Func )
+	{
+		AX_ASSERT_IS_NULL( m_pCurrentFunc );
+		m_pCurrentFunc = &Func;
+	}
+	inline void CProgram::LeaveFunction()
+	{
+		AX_ASSERT_NOT_NULL( m_pCurrentFunc );
+		m_pCurrentFunc = nullptr;
+	}
+	inline SFunctionOverload *CProgram::CurrentFunction()
+	{
+		return m_pCurrentFunc;
+	}
+	// Make the function being semanted (if any) run one call at a time from
+	// a PARALLEL FOR, for code that would be serialized in the loop's body
+	inline void CProgram::MarkThreadUnsafe()
+	{
+		if( m_pCurrentFunc != nullptr ) {
+			m_pCurrentFunc->bThreadSafe = false;
+		}
+	}
+
 	inline void CProgram::PushErrorToken( const SToken &Token )
 	{
 		Parser().PushErrorToken( Token );
@@ -6,6 +6,7 @@
 
 #include "Parser.hpp"
 #include "CodeGen.hpp"
+#include "Memory.hpp"
 
 #include "Binutils.hpp"
 
@@ -128,6 +129,22 @@ namespace Tenshi { namespace Compiler {
 		m_Projects.Clear();
 	}
 
+	void MProjects::GetSourceFiles( Ax::TArray< Ax::String > &OutFiles ) const
+	{
+		for( const CProject &Proj : m_Projects ) {
+			Proj.GetSourceFiles( OutFiles );
+		}
+	}
+	bool MProjects::InvalidateSource( const char *pszSourceFilename )
+	{
+		bool bFound = false;
+		for( CProject &Proj : m_Projects ) {
+			bFound |= Proj.InvalidateSource( pszSourceFilename );
+		}
+
+		return bFound;
+	}
+
 	static Ax::String Plural( unsigned x, const char *name, const char *plural = "s", const char *nonplural = "" )
 	{
 		return Ax::String::Formatted( "%u %s%s", x, name, x == 1 ? nonplural : plural );
@@ -667,6 +684,28 @@ namespace Tenshi { namespace Compiler {
 			return true;
 		}
 
+		// [[ SafetyCode <Off|On|Full> ]] :: Set the level of runtime checks generated
+		if( Cmd == "SafetyCode" ) {
+			if( !HasParm( Tokens, cTokens, Diag, Cmd ) ) {
+				return false;
+			}
+
+			const SProjToken &Arg = Tokens[ uArg + 0 ];
+
+			if( Arg == "Off" ) {
+				m_BuildInfo.SafetyCode = ESafetyCode::Off;
+			} else if( Arg == "On" ) {
+				m_BuildInfo.SafetyCode = ESafetyCode::On;
+			} else if( Arg == "Full" ) {
+				m_BuildInfo.SafetyCode = ESafetyCode::Full;
+			} else {
+				Diag.Error( Arg, "Unknown safety code level (expected Off, On, or Full)" );
+				return false;
+			}
+
+			return true;
+		}
+
 		// [[ EmitLLVMText <Output Filename> ]] :: List the LLVM IR
 		if( Cmd == "EmitLLVMText" ) {
 			if( !HasParm( Tokens, cTokens, Diag, Cmd ) ) {
@@ -935,7 +974,17 @@ namespace Tenshi { namespace Compiler {
 				AX_EXPECT_MEMORY( Objects.Append( Unit.ObjectFilename ) );
 			}
 
+			// Keep the object file from the last build if nothing changed
+			if( !Unit.bNeedsBuild && Ax::System::GetModifiedTime( Unit.ObjectFilename ) != -1 ) {
+				Ax::g_VerboseLog( Unit.SourceFilename ) += "Up to date";
+				AX_EXPECT_MEMORY( Objects.Append( Unit.PartObjectFilenames ) );
+				++cSuccesses;
+				continue;
+			}
+
 			if( Unit.Build() ) {
+				Unit.bNeedsBuild = false;
+				AX_EXPECT_MEMORY( Objects.Append( Unit.PartObjectFilenames ) );
 				++cSuccesses;
 			} else {
 				++cFailures;
@@ -949,6 +998,31 @@ namespace Tenshi { namespace Compiler {
 		return !cFailures;
 	}
 
+	void CProject::GetSourceFiles( Ax::TArray< Ax::String > &OutFiles ) const
+	{
+		for( const SCompilation &Unit : m_Compilations ) {
+			if( Unit.SourceFilename.IsEmpty() ) {
+				continue;
+			}
+
+			AX_EXPECT_MEMORY( OutFiles.Append( Unit.SourceFilename ) );
+		}
+	}
+	bool CProject::InvalidateSource( const char *pszSourceFilename )
+	{
+		AX_ASSERT_NOT_NULL( pszSourceFilename );
+
+		bool bFound = false;
+		for( SCompilation &Unit : m_Compilations ) {
+			if( Unit.SourceFilename == pszSourceFilename ) {
+				Unit.bNeedsBuild = true;
+				bFound = true;
+			}
+		}
+
+		return bFound;
+	}
+
 	void CProject::TouchModule( SModule &Mod )
 	{
 		if( m_pCurrentCompilation != nullptr && Mod.SourceLink.List() != &m_pCurrentCompilation->Modules ) {
@@ -967,58 +1041,74 @@ namespace Tenshi { namespace Compiler {
 			return true;
 		}
 
-		// Parse the source
-		CParser Parser;
+		CMemoryPhaseGuard PhaseGuard;
 
-		if( CG->IsInitialized() ) {
-			CG->Fini();
-		}
+		unsigned cSuccesses = 0;
 
-		CG->Init();
+		// The parser owns the tree, its tokens, and the symbols naming them;
+		// the backend needs none of that, so it's released before running
+		{
+			CParser Parser;
 
-		if( !Parser.LoadFile( SourceFilename ) ) {
-			Ax::Errorf( SourceFilename, "Failed to load file text" );
-			return false;
-		}
+			if( CG->IsInitialized() ) {
+				CG->Fini();
+			}
 
-		unsigned cSuccesses = 0;
+			CG->Init();
+
+			// Profiles tell internal functions in different units apart by this
+			CG->Module().setSourceFileName( LLVMStr( SourceFilename ) );
 
-		if( !ASListFilename.IsEmpty() ) {
-			Ax::g_VerboseLog( SourceFilename ) += "Assembly listing: " + ASListFilename;
+			MemTracker->BeginPhase( SourceFilename, "parse" );
 
-			if( !CG->AddAsmOut( LLVMStr( ASListFilename ) ) ) {
-				Ax::Errorf( ASListFilename, "Failed to add assembly listing" );
+			if( !Parser.LoadFile( SourceFilename ) ) {
+				Ax::Errorf( SourceFilename, "Failed to load file text" );
 				return false;
 			}
 
-			++cSuccesses;
-		}
-		if( !ObjectFilename.IsEmpty() ) {
-			Ax::g_VerboseLog( SourceFilename ) += "Object file: " + ObjectFilename;
+			if( !ASListFilename.IsEmpty() ) {
+				Ax::g_VerboseLog( SourceFilename ) += "Assembly listing: " + ASListFilename;
 
-			if( !CG->AddObjOut( LLVMStr( ObjectFilename ) ) ) {
-				Ax::Errorf( ObjectFilename, "Failed to add object file output" );
+				if( !CG->AddAsmOut( LLVMStr( ASListFilename ) ) ) {
+					Ax::Errorf( ASListFilename, "Failed to add assembly listing" );
+					return false;
+				}
+
+				++cSuccesses;
+			}
+			if( !ObjectFilename.IsEmpty() ) {
+				Ax::g_VerboseLog( SourceFilename ) += "Object file: " + ObjectFilename;
+
+				if( !CG->AddObjOut( LLVMStr( ObjectFilename ) ) ) {
+					Ax::Errorf( ObjectFilename, "Failed to add object file output" );
+					return false;
+				}
+
+				++cSuccesses;
+			}
+
+			if( !Parser.ParseProgram() ) {
+				Ax::Errorf( SourceFilename, "Compilation failed (Syntax)" );
 				return false;
 			}
 
-			++cSuccesses;
-		}
+			MemTracker->BeginPhase( SourceFilename, "semant" );
 
-		if( !Parser.ParseProgram() ) {
-			Ax::Errorf( SourceFilename, "Compilation failed (Syntax)" );
-			return false;
-		}
+			if( !Parser.Semant() ) {
+				Ax::Errorf( SourceFilename, "Compilation failed (Semantics)" );
+				return false;
+			}
 
-		if( !Parser.Semant() ) {
-			Ax::Errorf( SourceFilename, "Compilation failed (Semantics)" );
-			return false;
-		}
+			MemTracker->BeginPhase( SourceFilename, "codegen" );
 
-		if( !Parser.CodeGen() ) {
-			Ax::Errorf( SourceFilename, "Compilation failed (Translation)" );
-			return false;
+			if( !Parser.CodeGen() ) {
+				Ax::Errorf( SourceFilename, "Compilation failed (Translation)" );
+				return false;
+			}
 		}
 
+		MemTracker->BeginPhase( SourceFilename, "backend" );
+
 		if( !IRListFilename.IsEmpty() ) {
 			Ax::g_VerboseLog( SourceFilename ) += "IR listing: " + IRListFilename;
 
@@ -1039,7 +1129,11 @@ namespace Tenshi { namespace Compiler {
 			}
 		}
 
-		CG->WriteOutputs();
+		if( !CG->WriteOutputs() ) {
+			return false;
+		}
+
+		AX_EXPECT_MEMORY( PartObjectFilenames.Assign( CG->PartitionObjects() ) );
 
 		return cSuccesses > 0;
 	}
@@ -84,6 +84,8 @@ namespace Tenshi { namespace Compiler {
 
 		// Optional object filename (outputs to the object file format)
 		Ax::String					ObjectFilename;
+		// Object files for the other parts of a partitioned build (see --codegen-partitions)
+		Ax::TArray< Ax::String >	PartObjectFilenames;
 		// Optional bitcode filename (outputs to LLVM bitcode file; .bc)
 		Ax::String					LLVMBCFilename;
 		// Optional IR listing filename (outputs text representation of the module's LLVM IR; .ll)
@@ -94,14 +96,19 @@ namespace Tenshi { namespace Compiler {
 		// Modules referenced by this compilation (only valid while this is active)
 		SModule::IntrList			Modules;
 
+		// Whether the source has to be (re)compiled on the next build
+		bool						bNeedsBuild;
+
 		inline SCompilation()
 		: Settings()
 		, SourceFilename()
 		, ObjectFilename()
+		, PartObjectFilenames()
 		, LLVMBCFilename()
 		, IRListFilename()
 		, ASListFilename()
 		, Modules()
+		, bNeedsBuild( true )
 		{
 		}
 		inline ~SCompilation()
@@ -211,8 +218,17 @@ namespace Tenshi { namespace Compiler {
 		bool ApplyLine( const char *pszFilename, Ax::uint32 uLine, const char *pszLineStart, const char *pszLineEnd = nullptr );
 
 		// Build the project (returns false if it failed)
+		//
+		// Units that built successfully before and haven't been invalidated
+		// since are not compiled again; their object files are relinked.
 		bool Build();
 
+		// Add the absolute path of each source file to the array
+		void GetSourceFiles( Ax::TArray< Ax::String > &OutFiles ) const;
+		// Have the unit compiling the given source file rebuilt on the next
+		// build (returns false if no unit compiles it)
+		bool InvalidateSource( const char *pszSourceFilename );
+
 		// Add the module to the current compilation/project
 		void TouchModule( SModule &Mod );
 
@@ -292,6 +308,12 @@ namespace Tenshi { namespace Compiler {
 
 		bool Build();
 
+		// Add the source files of every project to the array
+		void GetSourceFiles( Ax::TArray< Ax::String > &OutFiles ) const;
+		// Have every unit compiling the given source file rebuilt on the next
+		// build (returns false if no project uses it)
+		bool InvalidateSource( const char *pszSourceFilename );
+
 	private:
 		Ax::TList< Ax::String >		m_ProjectDirs;
 		CProject::List				m_Projects;
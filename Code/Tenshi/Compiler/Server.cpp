@@ -0,0 +1,409 @@
+#include "_PCH.hpp"
+#include "Server.hpp"
+#include "Module.hpp"
+#include "Project.hpp"
+
+#ifndef _WIN32
+# include <errno.h>
+# include <signal.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+#endif
+
+namespace Tenshi { namespace Compiler {
+
+	/*
+		A request is a list of NUL-terminated strings: the protocol version,
+		the working directory, the output file (empty to keep the project's),
+		the build's settings ("1" or "0" to optimize, the number of codegen
+		partitions, "1" or "0" to generate a profile, and the profile to use
+		or an empty string), then one string per input. The client shuts
+		down its end of the connection once the request is written.
+
+		The response is the build's exit status on a line of its own followed
+		by the text of every report made during the build.
+	*/
+	static const char *const kProtocolVersion = "tenshi-build-2";
+
+	MServer &MServer::GetInstance()
+	{
+		static MServer instance;
+		return instance;
+	}
+
+	MServer::MServer()
+	{
+	}
+	MServer::~MServer()
+	{
+	}
+
+#ifndef _WIN32
+	// Collects the reports made while serving a request
+	class CRequestReporter: public virtual Ax::IReporter
+	{
+	public:
+		CRequestReporter()
+		: Ax::IReporter()
+		, m_Text()
+		{
+		}
+		virtual ~CRequestReporter()
+		{
+		}
+
+		void Report( const Ax::SReportDetails &Details, const char *pszMessage ) AX_OVERRIDE
+		{
+			AX_ASSERT_NOT_NULL( pszMessage );
+
+			// Same layout as the console reporter, minus the colors
+			if( Details.pszFile != nullptr ) {
+				AX_EXPECT_MEMORY( m_Text.Append( Details.pszFile ) );
+				if( Details.uLine > 0 ) {
+					if( Details.uColumn > 0 ) {
+						AX_EXPECT_MEMORY( m_Text.AppendFormat( "(%u,%u)", Details.uLine, Details.uColumn ) );
+					} else {
+						AX_EXPECT_MEMORY( m_Text.AppendFormat( "(%u)", Details.uLine ) );
+					}
+				}
+				AX_EXPECT_MEMORY( m_Text.Append( ": " ) );
+			}
+
+			switch( Details.Severity ) {
+			case Ax::ESeverity::Verbose:
+			case Ax::ESeverity::Normal:
+				break;
+			case Ax::ESeverity::Debug:
+				AX_EXPECT_MEMORY( m_Text.Append( "***DEBUG***: " ) );
+				break;
+			case Ax::ESeverity::Hint:
+				AX_EXPECT_MEMORY( m_Text.Append( "HINT: " ) );
+				break;
+			case Ax::ESeverity::Warning:
+				AX_EXPECT_MEMORY( m_Text.Append( "WARNING: " ) );
+				break;
+			case Ax::ESeverity::Error:
+				AX_EXPECT_MEMORY( m_Text.Append( "ERROR: " ) );
+				break;
+			}
+
+			AX_EXPECT_MEMORY( m_Text.Append( pszMessage ) );
+			AX_EXPECT_MEMORY( m_Text.Append( '\n' ) );
+		}
+
+		const Ax::String &Text() const
+		{
+			return m_Text;
+		}
+
+	private:
+		Ax::String					m_Text;
+	};
+
+	static bool MakeAddress( sockaddr_un &OutAddr, const char *pszSocketPath )
+	{
+		memset( &OutAddr, 0, sizeof( OutAddr ) );
+		OutAddr.sun_family = AF_UNIX;
+
+		const size_t cPath = strlen( pszSocketPath );
+		if( cPath >= sizeof( OutAddr.sun_path ) ) {
+			Ax::Errorf( pszSocketPath, "Socket path is too long (at most %u characters)", ( unsigned )sizeof( OutAddr.sun_path ) - 1 );
+			return false;
+		}
+
+		memcpy( OutAddr.sun_path, pszSocketPath, cPath );
+		return true;
+	}
+	static int ConnectTo( const sockaddr_un &Addr )
+	{
+		const int Fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if( Fd < 0 ) {
+			return -1;
+		}
+
+		if( connect( Fd, ( const sockaddr * )&Addr, sizeof( Addr ) ) != 0 ) {
+			close( Fd );
+			return -1;
+		}
+
+		return Fd;
+	}
+
+	static bool WriteAll( int Fd, const char *pData, size_t cBytes )
+	{
+		while( cBytes > 0 ) {
+			const ssize_t cWritten = write( Fd, pData, cBytes );
+			if( cWritten < 0 ) {
+				if( errno == EINTR ) {
+					continue;
+				}
+
+				return false;
+			}
+
+			pData += cWritten;
+			cBytes -= ( size_t )cWritten;
+		}
+
+		return true;
+	}
+	static bool ReadAll( int Fd, Ax::TArray< char > &OutData )
+	{
+		char Buffer[ 4096 ];
+
+		for(;;) {
+			const ssize_t cRead = read( Fd, Buffer, sizeof( Buffer ) );
+			if( cRead < 0 ) {
+				if( errno == EINTR ) {
+					continue;
+				}
+
+				return false;
+			}
+			if( !cRead ) {
+				return true;
+			}
+
+			AX_EXPECT_MEMORY( OutData.Append( ( size_t )cRead, Buffer ) );
+		}
+	}
+
+	static bool ParseFlag( const char *pszField, bool &bOutFlag )
+	{
+		if( strcmp( pszField, "0" ) != 0 && strcmp( pszField, "1" ) != 0 ) {
+			return false;
+		}
+
+		bOutFlag = *pszField == '1';
+		return true;
+	}
+	static bool ParseRequest( const Ax::TArray< char > &Data, SBuildRequest &OutRequest )
+	{
+		if( Data.IsEmpty() || Data.Last() != '\0' ) {
+			return false;
+		}
+
+		const char *p = Data.Pointer();
+		const char *const e = Data.Pointer() + Data.Num();
+		Ax::uintptr uField = 0;
+
+		while( p < e ) {
+			const size_t cField = strlen( p );
+
+			switch( uField++ ) {
+			case 0:
+				if( strcmp( p, kProtocolVersion ) != 0 ) {
+					return false;
+				}
+				break;
+			case 1:
+				AX_EXPECT_MEMORY( OutRequest.WorkingDir.Assign( p, ( Ax::intptr )cField ) );
+				break;
+			case 2:
+				AX_EXPECT_MEMORY( OutRequest.OutputFile.Assign( p, ( Ax::intptr )cField ) );
+				break;
+			case 3:
+				if( !ParseFlag( p, OutRequest.bOptimize ) ) {
+					return false;
+				}
+				break;
+			case 4: {
+				char *pEnd = nullptr;
+				const unsigned long cPartitions = strtoul( p, &pEnd, 10 );
+				if( !cField || *pEnd != '\0' || cPartitions < 1 || cPartitions > 256 ) {
+					return false;
+				}
+				OutRequest.cPartitions = ( unsigned )cPartitions;
+				break;
+			}
+			case 5:
+				if( !ParseFlag( p, OutRequest.bProfileGenerate ) ) {
+					return false;
+				}
+				break;
+			case 6:
+				AX_EXPECT_MEMORY( OutRequest.ProfileUseFile.Assign( p, ( Ax::intptr )cField ) );
+				break;
+			default:
+				AX_EXPECT_MEMORY( OutRequest.Inputs.Append() );
+				AX_EXPECT_MEMORY( OutRequest.Inputs.Last().Assign( p, ( Ax::intptr )cField ) );
+				break;
+			}
+
+			p += cField + 1;
+		}
+
+		return uField >= 7 && !OutRequest.WorkingDir.IsEmpty();
+	}
+
+	static void Respond( int Fd, int ExitStatus, const Ax::String &Text )
+	{
+		const Ax::String Status = Ax::String::Formatted( "%i\n", ExitStatus );
+
+		// There's nobody left to report to if the client went away
+		if( WriteAll( Fd, Status.CString(), Status.Len() ) ) {
+			WriteAll( Fd, Text.CString(), Text.Len() );
+		}
+	}
+	static void ServeRequest( int Fd, FnBuild pfnBuild )
+	{
+		Ax::TArray< char > Data;
+		SBuildRequest Request;
+
+		if( !ReadAll( Fd, Data ) || !ParseRequest( Data, Request ) ) {
+			Respond( Fd, EXIT_FAILURE, "ERROR: Malformed build request\n" );
+			return;
+		}
+
+		if( !Ax::System::SetDir( Request.WorkingDir ) ) {
+			Respond( Fd, EXIT_FAILURE, Request.WorkingDir + ": ERROR: Could not enter the working directory\n" );
+			return;
+		}
+
+		CRequestReporter Reporter;
+		Ax::AddReporter( &Reporter );
+
+		const Ax::uint64 uStartMicrosecs = Ax::System::Microseconds();
+		const int ExitStatus = pfnBuild( Request );
+		const Ax::uint64 uEndMicrosecs = Ax::System::Microseconds();
+
+		Ax::g_VerboseLog += Ax::String::Formatted( "Served build in %.3f ms", double( uEndMicrosecs - uStartMicrosecs )/1000.0 );
+
+		Ax::RemoveReporter( &Reporter );
+
+		// Nothing from this build carries over into the next
+		Projects->Clear();
+
+		Respond( Fd, ExitStatus, Reporter.Text() );
+	}
+#endif
+
+	bool MServer::Run( const char *pszSocketPath, FnBuild pfnBuild )
+	{
+		AX_ASSERT_NOT_NULL( pszSocketPath );
+		AX_ASSERT_NOT_NULL( pfnBuild );
+
+#ifdef _WIN32
+		Ax::BasicErrorf( "The compile server is not supported on this platform" );
+		return false;
+#else
+		sockaddr_un Addr;
+		if( !MakeAddress( Addr, pszSocketPath ) ) {
+			return false;
+		}
+
+		// Don't take the socket over from a server that's still running, but
+		// do clean up after one that wasn't shut down properly
+		const int ProbeFd = ConnectTo( Addr );
+		if( ProbeFd >= 0 ) {
+			close( ProbeFd );
+			Ax::Errorf( pszSocketPath, "A compile server is already running on this socket" );
+			return false;
+		}
+		unlink( pszSocketPath );
+
+		const int ListenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if( ListenFd < 0 ) {
+			Ax::Errorf( pszSocketPath, "Could not create socket: %s", strerror( errno ) );
+			return false;
+		}
+		if( bind( ListenFd, ( const sockaddr * )&Addr, sizeof( Addr ) ) != 0 || listen( ListenFd, 8 ) != 0 ) {
+			Ax::Errorf( pszSocketPath, "Could not listen on socket: %s", strerror( errno ) );
+			close( ListenFd );
+			return false;
+		}
+
+		// A client going away mid-response shouldn't take the server with it
+		signal( SIGPIPE, SIG_IGN );
+
+		// Load everything a build needs before the first request comes in
+		Mods->LoadCoreInternal();
+		Mods->LoadCorePlugins();
+
+		Ax::BasicStatusf( "Serving builds on \"%s\"", pszSocketPath );
+
+		bool bResult = true;
+		for(;;) {
+			const int ClientFd = accept( ListenFd, nullptr, nullptr );
+			if( ClientFd < 0 ) {
+				if( errno == EINTR ) {
+					continue;
+				}
+
+				Ax::Errorf( pszSocketPath, "Could not accept connection: %s", strerror( errno ) );
+				bResult = false;
+				break;
+			}
+
+			ServeRequest( ClientFd, pfnBuild );
+			close( ClientFd );
+		}
+
+		close( ListenFd );
+		unlink( pszSocketPath );
+
+		return bResult;
+#endif
+	}
+	int MServer::Request( const char *pszSocketPath, const SBuildRequest &Request )
+	{
+		AX_ASSERT_NOT_NULL( pszSocketPath );
+
+#ifdef _WIN32
+		Ax::BasicErrorf( "The compile server is not supported on this platform" );
+		return EXIT_FAILURE;
+#else
+		sockaddr_un Addr;
+		if( !MakeAddress( Addr, pszSocketPath ) ) {
+			return EXIT_FAILURE;
+		}
+
+		Ax::TArray< char > Data;
+
+		AX_EXPECT_MEMORY( Data.Append( strlen( kProtocolVersion ) + 1, kProtocolVersion ) );
+		AX_EXPECT_MEMORY( Data.Append( Request.WorkingDir.Len() + 1, Request.WorkingDir.CString() ) );
+		AX_EXPECT_MEMORY( Data.Append( Request.OutputFile.Len() + 1, Request.OutputFile.CString() ) );
+
+		const Ax::String Partitions = Ax::String::Formatted( "%u", Request.cPartitions );
+		AX_EXPECT_MEMORY( Data.Append( 2, Request.bOptimize ? "1" : "0" ) );
+		AX_EXPECT_MEMORY( Data.Append( Partitions.Len() + 1, Partitions.CString() ) );
+		AX_EXPECT_MEMORY( Data.Append( 2, Request.bProfileGenerate ? "1" : "0" ) );
+		AX_EXPECT_MEMORY( Data.Append( Request.ProfileUseFile.Len() + 1, Request.ProfileUseFile.CString() ) );
+
+		for( const Ax::String &Input : Request.Inputs ) {
+			AX_EXPECT_MEMORY( Data.Append( Input.Len() + 1, Input.CString() ) );
+		}
+
+		const int Fd = ConnectTo( Addr );
+		if( Fd < 0 ) {
+			Ax::Errorf( pszSocketPath, "Could not connect to the compile server: %s", strerror( errno ) );
+			return EXIT_FAILURE;
+		}
+
+		Ax::TArray< char > Response;
+
+		const bool bSent = WriteAll( Fd, Data.Pointer(), Data.Num() ) && shutdown( Fd, SHUT_WR ) == 0;
+		const bool bReceived = bSent && ReadAll( Fd, Response );
+
+		close( Fd );
+
+		if( !bReceived || !Response.Append( '\0' ) ) {
+			Ax::Errorf( pszSocketPath, "Lost connection to the compile server" );
+			return EXIT_FAILURE;
+		}
+
+		const char *const pszStatus = Response.Pointer();
+		const char *const pszText = strchr( pszStatus, '\n' );
+		if( !pszText ) {
+			Ax::Errorf( pszSocketPath, "Malformed response from the compile server" );
+			return EXIT_FAILURE;
+		}
+
+		fputs( pszText + 1, stderr );
+		return atoi( pszStatus );
+#endif
+	}
+
+}}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Collections/Array.hpp>
+
+#include <Core/Manager.hpp>
+#include <Core/String.hpp>
+
+namespace Tenshi { namespace Compiler {
+
+	// A single build, either run directly or handed to the compile server
+	struct SBuildRequest
+	{
+		// Directory relative paths in the request are resolved from
+		Ax::String					WorkingDir;
+		// Target file (empty to keep the project's own)
+		Ax::String					OutputFile;
+		// Source and project files to build
+		Ax::TArray< Ax::String >	Inputs;
+
+		// Run the optimization pipeline over the program (-O)
+		bool						bOptimize;
+		// Parts each object file is split into (--codegen-partitions)
+		unsigned					cPartitions;
+		// Instrument the program to write a profile (--profile-generate)
+		bool						bProfileGenerate;
+		// Merged profile to optimize with (--profile-use; empty for none)
+		Ax::String					ProfileUseFile;
+
+		inline SBuildRequest()
+		: WorkingDir()
+		, OutputFile()
+		, Inputs()
+		, bOptimize( false )
+		, cPartitions( 1 )
+		, bProfileGenerate( false )
+		, ProfileUseFile()
+		{
+		}
+	};
+
+	// Run a build, returning the exit status for it
+	typedef int( *FnBuild )( const SBuildRequest &Request );
+
+	/*
+	===========================================================================
+
+		COMPILE SERVER
+
+		Keeps the loaded modules, keyword tables, and LLVM's target state
+		around between builds. Clients (the compiler run with --connect) send
+		their build over a local socket and print the diagnostics sent back.
+
+	===========================================================================
+	*/
+	class MServer
+	{
+	public:
+		static MServer &GetInstance();
+
+		// Serve build requests on the given socket (only returns on failure)
+		bool Run( const char *pszSocketPath, FnBuild pfnBuild );
+		// Have the server on the given socket run a build, writing out the
+		// diagnostics it produced (returns the build's exit status)
+		int Request( const char *pszSocketPath, const SBuildRequest &Request );
+
+	private:
+		MServer();
+		~MServer();
+
+		AX_DELETE_COPYFUNCS(MServer);
+	};
+	static Ax::TManager<MServer>	Server;
+
+}}
@@ -9,6 +9,7 @@
 #include "Program.hpp"
 #include "ExprParser.hpp"
 #include "CodeGen.hpp"
+#include "Environment.hpp"
 
 namespace Tenshi { namespace Compiler {
 
@@ -21,6 +22,11 @@ namespace Tenshi { namespace Compiler {
 		m_Stmts.Inherit( Seq );
 	}
 
+	bool CBlockStatement::DeclaresLabels() const
+	{
+		return m_Stmts.DeclaresLabels();
+	}
+
 	bool CBlockStatement::Semant()
 	{
 		return m_Stmts.Semant();
@@ -77,6 +83,10 @@ namespace Tenshi { namespace Compiler {
 
 		if( Token().IsString() ) {
 			m_Semanted.bIsAutoprint = true;
+
+			// Printing is serialized in a PARALLEL FOR, but not from within
+			// a function called from one
+			g_Prog->MarkThreadUnsafe();
 		}
 
 		return true;
@@ -92,7 +102,16 @@ namespace Tenshi { namespace Compiler {
 		}
 
 		if( m_Semanted.bIsAutoprint ) {
+			// Keep lines printed from a PARALLEL FOR whole
+			if( CG->IsInParallelRegion() ) {
+				CG->Builder().CreateCall( CG->InternalFuncs().pParallelLock, llvm::ArrayRef< llvm::Value * >() );
+			}
+
 			CG->Builder().CreateCall( CG->InternalFuncs().pAutoprint, Val.Load(), "" );
+
+			if( CG->IsInParallelRegion() ) {
+				CG->Builder().CreateCall( CG->InternalFuncs().pParallelUnlock, llvm::ArrayRef< llvm::Value * >() );
+			}
 		}
 
 		CG->CleanScope();
@@ -337,6 +356,11 @@ namespace Tenshi { namespace Compiler {
 		switch( m_Type )
 		{
 		case ELoopFlow::Break:
+			if( !CG->CanBreakLoop() ) {
+				Token().Error( "EXIT cannot leave a PARALLEL FOR" );
+				return false;
+			}
+
 			CG->BreakLoop();
 			return true;
 
@@ -360,6 +384,20 @@ namespace Tenshi { namespace Compiler {
 	===========================================================================
 	*/
 	
+	// WHILE and REPEAT loops only sync when safety code is enabled
+	static bool IsLoopSyncEnabled()
+	{
+		return g_Env->BuildInfo().SafetyCode != ESafetyCode::Off;
+	}
+	// A function whose loops sync pumps the host's events, so it has to be
+	// called one at a time from a PARALLEL FOR
+	static void MarkLoopSyncs( bool bSyncs )
+	{
+		if( bSyncs ) {
+			g_Prog->MarkThreadUnsafe();
+		}
+	}
+
 	CDoLoopStmt::CDoLoopStmt( const SToken &Tok, CParser &Parser )
 	: CBlockStatement( EStmtSeqType::LoopBlock, EStmtType::DoLoopBlock, Tok, Parser )
 	, m_pLoopToken( nullptr )
@@ -413,6 +451,8 @@ namespace Tenshi { namespace Compiler {
 	bool CDoLoopStmt::Semant()
 	{
 		AX_ASSERT_NOT_NULL( m_pLoopToken );
+
+		MarkLoopSyncs( true );
 		return CBlockStatement::Semant();
 	}
 	bool CDoLoopStmt::CodeGen()
@@ -433,9 +473,7 @@ namespace Tenshi { namespace Compiler {
 
 		CG->LeaveLoop();
 
-		llvm::ArrayRef<llvm::Value*> args;
-		llvm::Value *const pCanContinue = CG->Builder().CreateCall( CG->InternalFuncs().pSafeSync, args, "cancontinue" );
-		CG->Builder().CreateCondBr( pCanContinue, pLoopEnter, pLoopLeave );
+		CG->EmitSyncPoint( *pLoopEnter, *pLoopLeave );
 
 		CG->SetCurrentBlock( *pLoopLeave );
 
@@ -522,6 +560,7 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		MarkLoopSyncs( IsLoopSyncEnabled() );
 		return CBlockStatement::Semant();
 	}
 	bool CWhileLoopStmt::CodeGen()
@@ -552,7 +591,13 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
-		CG->Builder().CreateBr( pLoopEnter );
+		// A constant-false condition means the body can never run
+		const SConstant *const pCond = m_pCondition->GetConstant();
+		if( IsLoopSyncEnabled() && !( pCond != nullptr && !pCond->IsTrue() ) ) {
+			CG->EmitSyncPoint( *pLoopEnter, *pLoopLeave );
+		} else {
+			CG->Builder().CreateBr( pLoopEnter );
+		}
 		CG->SetCurrentBlock( *pLoopLeave );
 
 		CG->LeaveLoop();
@@ -641,6 +686,7 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		MarkLoopSyncs( IsLoopSyncEnabled() );
 		if( !CBlockStatement::Semant() ) {
 			return false;
 		}
@@ -662,7 +708,13 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
-		CG->Builder().CreateBr( pLoopStep );
+		// A constant-true condition means the body only ever runs once
+		const SConstant *const pCond = m_pCondition->GetConstant();
+		if( IsLoopSyncEnabled() && !( pCond != nullptr && pCond->IsTrue() ) ) {
+			CG->EmitSyncPoint( *pLoopStep, *pLoopLeave );
+		} else {
+			CG->Builder().CreateBr( pLoopStep );
+		}
 		CG->SetCurrentBlock( *pLoopStep );
 
 		llvm::Value *const pCondVal = CG->EmitCondition( *m_pCondition );
@@ -688,7 +740,11 @@ namespace Tenshi { namespace Compiler {
 	*/
 	
 	CForLoopStmt::CForLoopStmt( const SToken &Tok, CParser &Parser )
-	: CBlockStatement( EStmtSeqType::LoopBlock, EStmtType::ForNextBlock, Tok, Parser )
+	: CForLoopStmt( EStmtSeqType::LoopBlock, EStmtType::ForNextBlock, Tok, Parser )
+	{
+	}
+	CForLoopStmt::CForLoopStmt( EStmtSeqType SeqType, EStmtType Type, const SToken &Tok, CParser &Parser )
+	: CBlockStatement( SeqType, Type, Tok, Parser )
 	, m_pVarToken( nullptr )
 	, m_pToUntilToken( nullptr )
 	, m_pStepToken( nullptr )
@@ -715,10 +771,17 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		return ParseBody( "FOR/NEXT" );
+	}
+
+	bool CForLoopStmt::ParseBody( const char *pszLoopName )
+	{
+		AX_ASSERT_NOT_NULL( pszLoopName );
+
 		for(;;) {
 			const SToken &CheckTok = Lexer().Lex();
 			if( !CheckTok || !CheckTok.StartsLine() ) {
-				Lexer().Expected( "Expected a statement on a new line in FOR/NEXT" );
+				Lexer().Expected( Ax::String( "Expected a statement on a new line in " ) + pszLoopName );
 				return false;
 			}
 
@@ -903,6 +966,21 @@ namespace Tenshi { namespace Compiler {
 
 		m_Semant.pVar = pVarSym;
 
+		if( !SemantRange( pVarSym->pVar->Type ) ) {
+			return false;
+		}
+
+		if( !CBlockStatement::Semant() ) {
+			return false;
+		}
+
+		return true;
+	}
+	bool CForLoopStmt::SemantRange( const STypeRef &IterRTy )
+	{
+		AX_ASSERT_NOT_NULL( m_pInitExpr );
+		AX_ASSERT_NOT_NULL( m_pCondExpr );
+
 		if( !m_pInitExpr->Semant() ) {
 			return false;
 		}
@@ -913,7 +991,7 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
-		const STypeRef *const pIterRTy = &pVarSym->pVar->Type;
+		const STypeRef *const pIterRTy = &IterRTy;
 
 		m_Semant.InitCast = STypeRef::Cast( *pInitRTy, *pIterRTy );
 		if( m_Semant.InitCast == ECast::Invalid ) {
@@ -954,12 +1032,94 @@ namespace Tenshi { namespace Compiler {
 			m_Semant.StepCast = ECast::Invalid;
 		}
 
-		if( !CBlockStatement::Semant() ) {
+		return true;
+	}
+	// Retrieve a constant as a signed 64-bit integer, if it is one
+	static bool GetConstantInt( const SConstant &Value, Ax::int64 &iOutValue )
+	{
+		if( !IsIntNumber( Value.Type ) ) {
+			return false;
+		}
+
+		if( IsSigned( Value.Type ) ) {
+			iOutValue = Value.iValue;
+			return true;
+		}
+
+		if( Value.uValue > Ax::uint64( INT64_MAX ) ) {
 			return false;
 		}
 
+		iOutValue = Ax::int64( Value.uValue );
 		return true;
 	}
+	// Check whether an expression only adds constants to or subtracts them
+	// from the extent of one array (e.g., "ARRAY COUNT( a() ) - 1")
+	static bool IsArrayExtent( const CExpression &Expr, const SSymbol *&pInOutArray )
+	{
+		if( Expr.GetConstant() != nullptr ) {
+			return IsIntNumber( Expr.GetConstant()->Type );
+		}
+
+		if( Expr.Is( EExprType::ArrayFunction ) ) {
+			unsigned uDim = ~0U;
+			const SSymbol *const pArray = static_cast< const CArrayFuncExpr & >( Expr ).GetExtentArray( uDim );
+			if( !pArray || !pArray->pVar || ( pInOutArray != nullptr && pInOutArray != pArray ) ) {
+				return false;
+			}
+
+			pInOutArray = pArray;
+			return true;
+		}
+
+		if( Expr.Is( EExprType::BinaryOp ) ) {
+			const CBinaryExpr &BinExpr = static_cast< const CBinaryExpr & >( Expr );
+			if( BinExpr.Operator() != EBuiltinOp::Add && BinExpr.Operator() != EBuiltinOp::Sub ) {
+				return false;
+			}
+
+			AX_ASSERT_NOT_NULL( BinExpr.LHS() );
+			AX_ASSERT_NOT_NULL( BinExpr.RHS() );
+
+			return IsArrayExtent( *BinExpr.LHS(), pInOutArray ) && IsArrayExtent( *BinExpr.RHS(), pInOutArray );
+		}
+
+		return false;
+	}
+	bool CForLoopStmt::HasCountedRange( const SSymbol *&pOutEndArray ) const
+	{
+		AX_ASSERT_NOT_NULL( m_Semant.pVar );
+		AX_ASSERT_NOT_NULL( m_Semant.pVar->pVar );
+
+		pOutEndArray = nullptr;
+
+		// Labels within the body could be jumped to from outside the loop
+		if( DeclaresLabels() ) {
+			return false;
+		}
+
+		const EBuiltinType VarType = m_Semant.pVar->pVar->Type.BuiltinType;
+		if( !IsIntNumber( VarType ) ) {
+			return false;
+		}
+
+		Ax::int64 iStep = 1;
+		if( m_pStepExpr != nullptr ) {
+			const SConstant *const pStep = m_pStepExpr->GetConstant();
+			if( !pStep || !GetConstantInt( *pStep, iStep ) ) {
+				return false;
+			}
+		}
+
+		// The loop only ends on equality, so any other step could skip it
+		if( iStep != 1 ) {
+			return false;
+		}
+
+		// The end is evaluated on every iteration, so it has to be one that
+		// can't change while the loop runs
+		return IsArrayExtent( *m_pCondExpr, pOutEndArray );
+	}
 	bool CForLoopStmt::CodeGen()
 	{
 		AX_ASSERT_NOT_NULL( m_pVarToken );
@@ -1025,6 +1185,40 @@ namespace Tenshi { namespace Compiler {
 
 		const bool bIsFP = pVarSym->Translated.pValue->getType()->isFloatingPointTy();
 
+		const SSymbol *pEndArray = nullptr;
+		const bool bHasRange = CG->AreBoundsChecked() && HasCountedRange( pEndArray );
+		if( bHasRange ) {
+			// Evaluate the end ahead of the loop as well, for the guards
+			SValue PreEndVal = m_pCondExpr->CodeGen();
+			if( !PreEndVal ) {
+				return false;
+			}
+			llvm::Value *const pEndVal = CG->EmitCast( m_Semant.CondCast, VarRTy.BuiltinType, PreEndVal.Load() );
+			if( !pEndVal ) {
+				return false;
+			}
+
+			llvm::Type *const pVarTy = pEndVal->getType();
+			const bool bIsSigned = IsSigned( VarRTy.BuiltinType );
+
+			// The iterator only stops once it's equal to the end, so it has to
+			// start within [0, end] to stay in that range
+			llvm::Value *pValid =
+				bIsSigned
+				? Builder.CreateICmpSLE( pInitVal, pEndVal, "for.valid" )
+				: Builder.CreateICmpULE( pInitVal, pEndVal, "for.valid" )
+				;
+			if( bIsSigned ) {
+				pValid = Builder.CreateAnd( Builder.CreateICmpSGE( pInitVal, llvm::ConstantInt::get( pVarTy, 0 ) ), pValid, "for.valid" );
+			}
+
+			llvm::Value *const pLastVal = bIsUntil ? Builder.CreateSub( pEndVal, llvm::ConstantInt::get( pVarTy, 1 ) ) : pEndVal;
+			llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( Context, ( unsigned )g_Env->GetPointerBits() );
+			llvm::Value *const pLast = Builder.CreateIntCast( pLastVal, pUIntPtrTy, bIsSigned, "for.last" );
+
+			AX_EXPECT_MEMORY( CG->EnterInductionRange( *pVarSym, pLast, pValid, pEndArray, CG->CurrentBlock(), *pLeaveLabel, *pEnterLabel, *pLoopOrCondLabel, *pStepLabel ) );
+		}
+
 		CG->EnterLoop( pLeaveLabel, pStepLabel );
 
 		for( unsigned int i = 0; i < 2; ++i ) {
@@ -1065,55 +1259,1719 @@ namespace Tenshi { namespace Compiler {
 				return false;
 			}
 
-			Builder.CreateCondBr( pCondVal, pLeaveLabel, bIsUntil ? pLoopOrCondLabel : pStepLabel );
+			Builder.CreateCondBr( pCondVal, pLeaveLabel, bIsUntil ? pLoopOrCondLabel : pStepLabel );
+		}
+
+		CG->SetCurrentBlock( *pStepLabel );
+
+		SValue PreStepVal;
+		if( m_pStepExpr != nullptr ) {
+			PreStepVal = m_pStepExpr->CodeGen();
+			if( !PreStepVal ) {
+				return false;
+			}
+		} else {
+			PreStepVal = llvm::ConstantInt::get( llvm::Type::getInt32Ty( Context ), llvm::APInt( 32, 1, true ) );
+			if( !PreStepVal ) {
+				Token().Error( "[CodeGen] Failed to generate step constant" );
+				return false;
+			}
+
+			m_Semant.StepCast = GetCastForTypes( EBuiltinType::Int32, VarRTy.BuiltinType, ECastMode::Input );
+			if( m_Semant.StepCast == ECast::Invalid ) {
+				Token().Error( "[CodeGen] Invalid implicit cast for step expression" );
+				return false;
+			}
+		}
+
+		AX_ASSERT( m_Semant.StepCast != ECast::Invalid );
+
+		llvm::Value *const pStepVal = CG->EmitCast( m_Semant.StepCast, VarRTy.BuiltinType, PreStepVal.Load() );
+		if( !pStepVal ) {
+			Token().Error( "[CodeGen] Failed to generate step cast" );
+			return false;
+		}
+
+		llvm::Value *const pLoadedVarVal = Builder.CreateLoad( pVarSym->Translated.pValue );
+		llvm::Value *const pSteppedVal =
+			( bIsFP )
+			? Builder.CreateFAdd( pLoadedVarVal, pStepVal )
+			: Builder.CreateAdd( pLoadedVarVal, pStepVal )
+			;
+		llvm::StoreInst *const pStepStore = Builder.CreateStore( pSteppedVal, pVarSym->Translated.pValue );
+		Builder.CreateBr( pEnterLabel );
+
+		if( bHasRange ) {
+			CG->LeaveInductionRange( pStepStore );
+		}
+
+		CG->SetCurrentBlock( *pLeaveLabel );
+		if( pLeaveLabel != &CG->CurrentFunction().back() ) {
+			pLeaveLabel->moveAfter( &CG->CurrentFunction().back() );
+		}
+		pStepLabel->moveBefore( pLeaveLabel );
+
+		CG->LeaveLoop();
+		return true;
+	}
+
+
+	/*
+	===========================================================================
+
+		PARALLEL FOR/NEXT LOOP STATEMENT
+
+	===========================================================================
+	*/
+
+	CParallelForStmt::CParallelForStmt( const SToken &Tok, CParser &Parser )
+	: CForLoopStmt( EStmtSeqType::ParallelBlock, EStmtType::ParallelForBlock, Tok, Parser )
+	, m_Reductions()
+	, m_ParSemant()
+	{
+		m_ParSemant.pScope = nullptr;
+		m_ParSemant.iStep = 1;
+	}
+
+	bool CParallelForStmt::Parse()
+	{
+		AX_ASSERT( Token().IsKeyword( kKeyword_ParallelFor ) );
+
+		if( !ParseInit() ) {
+			return false;
+		}
+		if( !ParseCond() ) {
+			return false;
+		}
+		if( !ParseStep() ) {
+			return false;
+		}
+		if( !ParseReduce() ) {
+			return false;
+		}
+
+		return ParseBody( "PARALLEL FOR/NEXT" );
+	}
+	bool CParallelForStmt::ParseReduce()
+	{
+		const SToken &Tok = Lexer().CheckLine( ETokenType::Name );
+		if( !Tok ) {
+			return true;
+		}
+		if( !Tok.IsKeyword( kKeyword_Reduce ) ) {
+			Lexer().Unlex();
+			return true;
+		}
+
+		do {
+			SReduction Reduction;
+
+			Reduction.pOpToken = &Lexer().ExpectLine( ETokenType::Punctuation, "+", ETokenType::Name );
+			if( !*Reduction.pOpToken ) {
+				return false;
+			}
+
+			if( Reduction.pOpToken->IsPunctuation( "+" ) ) {
+				Reduction.Op = EReduceOp::Add;
+			} else if( Reduction.pOpToken->CaseCmp( "MIN" ) ) {
+				Reduction.Op = EReduceOp::Min;
+			} else if( Reduction.pOpToken->CaseCmp( "MAX" ) ) {
+				Reduction.Op = EReduceOp::Max;
+			} else {
+				Lexer().Expected( "Expected +, MIN, or MAX in REDUCE" );
+				return false;
+			}
+
+			Reduction.pVarToken = &Lexer().ExpectLine( ETokenType::Name );
+			if( !*Reduction.pVarToken ) {
+				return false;
+			}
+			if( Reduction.pVarToken->IsKeyword() ) {
+				Lexer().Expected( "Expected non-keyword for variable name" );
+				return false;
+			}
+
+			Reduction.pVar = nullptr;
+
+			AX_EXPECT_MEMORY( m_Reductions.Append( Reduction ) );
+		} while( Lexer().CheckLine( ETokenType::Punctuation, "," ) );
+
+		return true;
+	}
+
+	Ax::String CParallelForStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( "Parallel" ) );
+		AX_EXPECT_MEMORY( Result.Append( CForLoopStmt::ToString() ) );
+
+		for( const SReduction &Reduction : m_Reductions ) {
+			AX_EXPECT_MEMORY( Result.Append( "\n\treduce:" ) );
+			AX_EXPECT_MEMORY( Result.Append( Reduction.pOpToken->GetString() ) );
+			AX_EXPECT_MEMORY( Result.Append( " " ) );
+			AX_EXPECT_MEMORY( Result.Append( Reduction.pVarToken->GetString() ) );
+		}
+
+		return Result;
+	}
+
+	bool CParallelForStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pVarToken );
+		AX_ASSERT_NOT_NULL( m_pToUntilToken );
+		AX_ASSERT_NOT_NULL( m_pNextToken );
+		AX_ASSERT_NOT_NULL( m_pInitExpr );
+		AX_ASSERT_NOT_NULL( m_pCondExpr );
+
+		// The body runs in another function, so nothing can jump into it
+		if( DeclaresLabels() ) {
+			Token().Error( "Labels cannot be declared inside of a PARALLEL FOR" );
+			return false;
+		}
+
+		Ax::String VarName;
+		AX_EXPECT_MEMORY( VarName.Assign( m_pVarToken->GetString() ) );
+
+		// The iterator takes the type of a variable of the same name, but each
+		// chunk works on its own copy (declared in the loop's scope below)
+		STypeRef IterRTy;
+
+		const SSymbol *const pOuterSym = g_Prog->FindSymbol( VarName );
+		if( pOuterSym != nullptr ) {
+			if( !pOuterSym->pVar ) {
+				m_pVarToken->Error( "Non-variable used as iterator in PARALLEL FOR" );
+				return false;
+			}
+
+			if( IsIntNumber( pOuterSym->pVar->Type.BuiltinType ) ) {
+				IterRTy.BuiltinType = pOuterSym->pVar->Type.BuiltinType;
+				IterRTy.cBytes = pOuterSym->pVar->Type.cBytes;
+			}
+		} else if( !STypeRef::Semant( IterRTy, *m_pVarToken, nullptr ) ) {
+			return false;
+		}
+
+		if( !IsIntNumber( IterRTy.BuiltinType ) || IsRealNumber( IterRTy.BuiltinType ) ) {
+			m_pVarToken->Error( "PARALLEL FOR requires an integer iterator" );
+			return false;
+		}
+
+		// Bounds are evaluated before the loop, outside of its scope
+		if( !SemantRange( IterRTy ) ) {
+			return false;
+		}
+
+		m_ParSemant.iStep = 1;
+		if( m_pStepExpr != nullptr ) {
+			const SConstant *const pStep = m_pStepExpr->GetConstant();
+			if( !pStep || !GetConstantInt( *pStep, m_ParSemant.iStep ) || m_ParSemant.iStep == 0 ) {
+				m_pStepExpr->Token().Error( "STEP of a PARALLEL FOR must be a non-zero integer constant" );
+				return false;
+			}
+		}
+
+		for( SReduction &Reduction : m_Reductions ) {
+			AX_ASSERT_NOT_NULL( Reduction.pVarToken );
+
+			const SSymbol *const pSym = g_Prog->FindSymbol( Reduction.pVarToken->GetString() );
+			if( !pSym || !pSym->pVar ) {
+				Reduction.pVarToken->Error( "REDUCE requires a variable declared before the PARALLEL FOR" );
+				return false;
+			}
+
+			if( pSym == pOuterSym ) {
+				Reduction.pVarToken->Error( "The iterator of a PARALLEL FOR cannot be reduced" );
+				return false;
+			}
+
+			const EBuiltinType VarType = pSym->pVar->Type.BuiltinType;
+			if( !IsNumber( VarType ) || IsSIMD( VarType ) || IsVectorOrMatrix( VarType ) ) {
+				Reduction.pVarToken->Error( "REDUCE requires a scalar numeric variable" );
+				return false;
+			}
+
+			for( const SReduction &Other : m_Reductions ) {
+				if( &Other == &Reduction ) {
+					break;
+				}
+
+				if( Other.pVar == pSym ) {
+					Reduction.pVarToken->Error( "Variable is already reduced by this PARALLEL FOR" );
+					return false;
+				}
+			}
+
+			Reduction.pVar = const_cast< SSymbol * >( pSym );
+		}
+
+		static unsigned uParallelForId = 0;
+
+		Ax::String Prefix;
+		AX_EXPECT_MEMORY( Prefix.Format( "_parfor%u#", ++uParallelForId ) );
+
+		m_ParSemant.pScope = g_Prog->CurrentScope().AddScope( Prefix );
+		AX_EXPECT_MEMORY( m_ParSemant.pScope );
+
+		SSymbol *const pVarSym = m_ParSemant.pScope->AddSymbol( VarName );
+		if( !pVarSym ) {
+			m_pVarToken->Error( "Failed to declare PARALLEL FOR iterator" );
+			return false;
+		}
+
+		pVarSym->pDeclToken = m_pVarToken;
+		pVarSym->pVar = new SMemberInfo();
+		AX_EXPECT_MEMORY( pVarSym->pVar );
+
+		pVarSym->pVar->Name.Swap( VarName );
+		pVarSym->pVar->PassBy = EPassBy::Direct;
+		pVarSym->pVar->PassMod = EPassMod::Direct;
+		pVarSym->pVar->uOffset = 0;
+		pVarSym->pVar->Type.BuiltinType = IterRTy.BuiltinType;
+		pVarSym->pVar->Type.cBytes = IterRTy.cBytes;
+
+		m_Semant.pVar = pVarSym;
+		m_Semant.bOwnsVar = true;
+
+		g_Prog->PushScope( *m_ParSemant.pScope );
+		const bool bDidSemant = CBlockStatement::Semant();
+		g_Prog->PopScope();
+
+		return bDidSemant;
+	}
+
+	// Compute the number of iterations a PARALLEL FOR will run
+	//
+	// Bounds are 64-bit (extended as the iterator's type dictates) and the step
+	// is a non-zero constant.
+	static llvm::Value *EmitTripCount( llvm::IRBuilder<> &Builder, llvm::Value *pFirst, llvm::Value *pEnd, Ax::int64 iStep, bool bIsUntil, bool bIsSigned )
+	{
+		AX_ASSERT_NOT_NULL( pFirst );
+		AX_ASSERT_NOT_NULL( pEnd );
+		AX_ASSERT( iStep != 0 );
+
+		// Count from the lower bound up, whichever way the loop runs
+		llvm::Value *pLow = pFirst;
+		llvm::Value *pHigh = pEnd;
+		Ax::uint64 uStride = Ax::uint64( iStep );
+		if( iStep < 0 ) {
+			pLow = pEnd;
+			pHigh = pFirst;
+			uStride = Ax::uint64( -( iStep + 1 ) ) + 1;
+		}
+
+		llvm::Value *pIsEmpty = nullptr;
+		if( bIsUntil ) {
+			pIsEmpty = bIsSigned ? Builder.CreateICmpSGE( pLow, pHigh ) : Builder.CreateICmpUGE( pLow, pHigh );
+		} else {
+			pIsEmpty = bIsSigned ? Builder.CreateICmpSGT( pLow, pHigh ) : Builder.CreateICmpUGT( pLow, pHigh );
+		}
+
+		llvm::Value *pSpan = Builder.CreateSub( pHigh, pLow, "parfor.span" );
+		if( bIsUntil ) {
+			pSpan = Builder.CreateSub( pSpan, Builder.getInt64( 1 ) );
+		}
+
+		llvm::Value *const pCount = Builder.CreateAdd( Builder.CreateUDiv( pSpan, Builder.getInt64( uStride ) ), Builder.getInt64( 1 ) );
+		return Builder.CreateSelect( pIsEmpty, Builder.getInt64( 0 ), pCount, "parfor.count" );
+	}
+	// Retrieve the value a reduction starts each chunk with
+	static llvm::Constant *GetReductionIdentity( EReduceOp Op, EBuiltinType VarType, llvm::Type *pVarTy )
+	{
+		AX_ASSERT_NOT_NULL( pVarTy );
+
+		if( pVarTy->isFloatingPointTy() ) {
+			switch( Op )
+			{
+			case EReduceOp::Add:
+				return llvm::ConstantFP::get( pVarTy, 0.0 );
+			case EReduceOp::Min:
+				return llvm::ConstantFP::get( pVarTy, HUGE_VAL );
+			case EReduceOp::Max:
+				return llvm::ConstantFP::get( pVarTy, -HUGE_VAL );
+			}
+		}
+
+		AX_ASSERT( pVarTy->isIntegerTy() );
+		const unsigned cBits = pVarTy->getIntegerBitWidth();
+		const bool bIsSigned = IsSigned( VarType );
+
+		switch( Op )
+		{
+		case EReduceOp::Add:
+			return llvm::ConstantInt::get( pVarTy, 0 );
+		case EReduceOp::Min:
+			return llvm::ConstantInt::get( pVarTy->getContext(), bIsSigned ? llvm::APInt::getSignedMaxValue( cBits ) : llvm::APInt::getMaxValue( cBits ) );
+		case EReduceOp::Max:
+			return llvm::ConstantInt::get( pVarTy->getContext(), bIsSigned ? llvm::APInt::getSignedMinValue( cBits ) : llvm::APInt::getMinValue( cBits ) );
+		}
+
+		AX_ASSERT_MSG( false, "Unreachable" );
+		return nullptr;
+	}
+	// Combine two partial results of a reduction
+	static llvm::Value *EmitReduction( llvm::IRBuilder<> &Builder, EReduceOp Op, EBuiltinType VarType, llvm::Value *pLHS, llvm::Value *pRHS )
+	{
+		AX_ASSERT_NOT_NULL( pLHS );
+		AX_ASSERT_NOT_NULL( pRHS );
+
+		const bool bIsFP = pLHS->getType()->isFloatingPointTy();
+		const bool bIsSigned = IsSigned( VarType );
+
+		llvm::Value *pTakeRHS = nullptr;
+		switch( Op )
+		{
+		case EReduceOp::Add:
+			return bIsFP ? Builder.CreateFAdd( pLHS, pRHS, "reduce.add" ) : Builder.CreateAdd( pLHS, pRHS, "reduce.add" );
+
+		case EReduceOp::Min:
+			pTakeRHS =
+				bIsFP ? Builder.CreateFCmpOLT( pRHS, pLHS ) :
+				bIsSigned ? Builder.CreateICmpSLT( pRHS, pLHS ) : Builder.CreateICmpULT( pRHS, pLHS );
+			return Builder.CreateSelect( pTakeRHS, pRHS, pLHS, "reduce.min" );
+
+		case EReduceOp::Max:
+			pTakeRHS =
+				bIsFP ? Builder.CreateFCmpOGT( pRHS, pLHS ) :
+				bIsSigned ? Builder.CreateICmpSGT( pRHS, pLHS ) : Builder.CreateICmpUGT( pRHS, pLHS );
+			return Builder.CreateSelect( pTakeRHS, pRHS, pLHS, "reduce.max" );
+		}
+
+		AX_ASSERT_MSG( false, "Unreachable" );
+		return nullptr;
+	}
+	bool CParallelForStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pVarToken );
+		AX_ASSERT_NOT_NULL( m_pToUntilToken );
+		AX_ASSERT_NOT_NULL( m_pInitExpr );
+		AX_ASSERT_NOT_NULL( m_pCondExpr );
+		AX_ASSERT_NOT_NULL( m_Semant.pVar );
+		AX_ASSERT_NOT_NULL( m_Semant.pVar->pVar );
+		AX_ASSERT( m_Semant.InitCast != ECast::Invalid );
+		AX_ASSERT( m_Semant.CondCast != ECast::Invalid );
+
+		const bool bIsUntil = m_pToUntilToken->IsKeyword( kKeyword_Until );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Function *const pParentFunc = &CG->CurrentFunction();
+		const SInternalFunctions &IntFuncs = CG->InternalFuncs();
+
+		SSymbol *const pVarSym = m_Semant.pVar;
+		const STypeRef &VarRTy = pVarSym->pVar->Type;
+		const bool bIsSigned = IsSigned( VarRTy.BuiltinType );
+
+		llvm::Type *const pVarTy = pVarSym->pVar->Type.CodeGen();
+		if( !pVarTy ) {
+			return false;
+		}
+
+		llvm::Type *const pInt64Ty = Builder.getInt64Ty();
+		llvm::Type *const pInt8PtrTy = Builder.getInt8PtrTy();
+
+		// Both bounds are evaluated once, on the thread starting the loop
+		SValue PreInitVal = m_pInitExpr->CodeGen();
+		if( !PreInitVal ) {
+			return false;
+		}
+		llvm::Value *const pInitVal = CG->EmitCast( m_Semant.InitCast, VarRTy.BuiltinType, PreInitVal.Load() );
+		if( !pInitVal ) {
+			return false;
+		}
+
+		SValue PreEndVal = m_pCondExpr->CodeGen();
+		if( !PreEndVal ) {
+			return false;
+		}
+		llvm::Value *const pEndVal = CG->EmitCast( m_Semant.CondCast, VarRTy.BuiltinType, PreEndVal.Load() );
+		if( !pEndVal ) {
+			return false;
+		}
+
+		llvm::Value *const pFirst = bIsSigned ? Builder.CreateSExt( pInitVal, pInt64Ty ) : Builder.CreateZExt( pInitVal, pInt64Ty );
+		llvm::Value *const pEnd = bIsSigned ? Builder.CreateSExt( pEndVal, pInt64Ty ) : Builder.CreateZExt( pEndVal, pInt64Ty );
+
+		llvm::Value *const pCount = EmitTripCount( Builder, pFirst, pEnd, m_ParSemant.iStep, bIsUntil, bIsSigned );
+		llvm::Value *const pChunks = Builder.CreateCall( IntFuncs.pParallelChunks, pCount, "parfor.chunks" );
+
+		// Each chunk leaves its part of every reduction in a slot of its own
+		Ax::TArray< llvm::Value * > Partials;
+		Ax::TArray< llvm::Value * > SharedVars;
+		AX_EXPECT_MEMORY( Partials.Reserve( m_Reductions.Num() ) );
+		AX_EXPECT_MEMORY( SharedVars.Reserve( m_Reductions.Num() ) );
+		{
+			llvm::IRBuilder<> EntryBlockBuilder( &pParentFunc->getEntryBlock(), pParentFunc->getEntryBlock().begin() );
+
+			for( const SReduction &Reduction : m_Reductions ) {
+				AX_ASSERT_NOT_NULL( Reduction.pVar );
+				AX_ASSERT_NOT_NULL( Reduction.pVar->Translated.pValue );
+
+				llvm::Type *const pRedTy = Reduction.pVar->pVar->Type.CodeGen();
+				if( !pRedTy ) {
+					return false;
+				}
+
+				llvm::Type *const pSlotsTy = llvm::ArrayType::get( pRedTy, kMaxParallelChunks );
+				AX_EXPECT_MEMORY( Partials.Append( EntryBlockBuilder.CreateAlloca( pSlotsTy, nullptr, "parfor.partials" ) ) );
+				AX_EXPECT_MEMORY( SharedVars.Append( Reduction.pVar->Translated.pValue ) );
+			}
+		}
+
+		//
+		//	Generate the body into its own function
+		//
+
+		llvm::BasicBlock *const pParentBlock = &CG->CurrentBlock();
+
+		llvm::Function *const pBody = CG->CreateParallelBody();
+		AX_EXPECT_MEMORY( pBody );
+
+		llvm::Function::arg_iterator Arg = pBody->arg_begin();
+		++Arg;
+		llvm::Value *const pChunkArg = &*Arg++;
+		llvm::Value *const pFirstArg = &*Arg++;
+		llvm::Value *const pLastArg = &*Arg;
+
+		llvm::BasicBlock *const pBodyEntry = llvm::BasicBlock::Create( Context, "entry", pBody );
+		llvm::BasicBlock *const pCondLabel = llvm::BasicBlock::Create( Context, "parfor.cond", pBody );
+		llvm::BasicBlock *const pLoopLabel = llvm::BasicBlock::Create( Context, "parfor.body", pBody );
+		llvm::BasicBlock *const pStepLabel = llvm::BasicBlock::Create( Context, "parfor.step", pBody );
+		llvm::BasicBlock *const pDoneLabel = llvm::BasicBlock::Create( Context, "parfor.done", pBody );
+		AX_EXPECT_MEMORY( pBodyEntry );
+		AX_EXPECT_MEMORY( pCondLabel );
+		AX_EXPECT_MEMORY( pLoopLabel );
+		AX_EXPECT_MEMORY( pStepLabel );
+		AX_EXPECT_MEMORY( pDoneLabel );
+
+		CG->SetCurrentBlock( *pBodyEntry );
+		CG->EnterParallelRegion();
+
+		pVarSym->Translated.pValue = Builder.CreateAlloca( pVarTy, nullptr, LLVMStr( m_pVarToken ) );
+		AX_EXPECT_MEMORY( pVarSym->Translated.pValue );
+
+		// Within the body each reduced variable names the chunk's accumulator
+		Ax::TArray< llvm::Value * > Accumulators;
+		AX_EXPECT_MEMORY( Accumulators.Reserve( m_Reductions.Num() ) );
+		for( SReduction &Reduction : m_Reductions ) {
+			llvm::Type *const pRedTy = Reduction.pVar->pVar->Type.CodeGen();
+			llvm::Value *const pAccum = Builder.CreateAlloca( pRedTy, nullptr, "reduce.accum" );
+			Builder.CreateStore( GetReductionIdentity( Reduction.Op, Reduction.pVar->pVar->Type.BuiltinType, pRedTy ), pAccum );
+
+			AX_EXPECT_MEMORY( Accumulators.Append( pAccum ) );
+			Reduction.pVar->Translated.pValue = pAccum;
+		}
+
+		llvm::Value *const pIndex = Builder.CreateAlloca( pInt64Ty, nullptr, "parfor.index" );
+		Builder.CreateStore( pFirstArg, pIndex );
+
+		CG->SetCurrentBlock( *pCondLabel );
+		llvm::Value *const pCondIndex = Builder.CreateLoad( pIndex );
+		Builder.CreateCondBr( Builder.CreateICmpULT( pCondIndex, pLastArg ), pLoopLabel, pDoneLabel );
+
+		CG->SetCurrentBlock( *pLoopLabel );
+		llvm::Value *const pOffset = Builder.CreateMul( Builder.CreateLoad( pIndex ), Builder.getInt64( Ax::uint64( m_ParSemant.iStep ) ) );
+		llvm::Value *const pIterVal = Builder.CreateTrunc( Builder.CreateAdd( pFirst, pOffset ), pVarTy );
+		Builder.CreateStore( pIterVal, pVarSym->Translated.pValue );
+
+		// EXIT has nowhere to go; REPEAT LOOP moves on to the next iteration
+		CG->EnterLoop( nullptr, pStepLabel );
+		const bool bDidBody = CBlockStatement::CodeGen();
+		CG->LeaveLoop();
+
+		if( bDidBody ) {
+			CG->SetCurrentBlock( *pStepLabel );
+			Builder.CreateStore( Builder.CreateAdd( Builder.CreateLoad( pIndex ), Builder.getInt64( 1 ) ), pIndex );
+			Builder.CreateBr( pCondLabel );
+
+			CG->SetCurrentBlock( *pDoneLabel );
+			for( uintptr i = 0; i < m_Reductions.Num(); ++i ) {
+				llvm::Value *const pIndices[] = { Builder.getInt32( 0 ), pChunkArg };
+				llvm::Value *const pSlot = Builder.CreateInBoundsGEP( Partials[ i ], pIndices );
+				Builder.CreateStore( Builder.CreateLoad( Accumulators[ i ] ), pSlot );
+			}
+			Builder.CreateRetVoid();
+		}
+
+		CG->LeaveParallelRegion();
+		for( uintptr i = 0; i < m_Reductions.Num(); ++i ) {
+			m_Reductions[ i ].pVar->Translated.pValue = SharedVars[ i ];
+		}
+
+		if( !bDidBody ) {
+			return false;
+		}
+
+		Ax::TArray< llvm::Value * > Captures;
+		llvm::StructType *const pContextTy = CG->CaptureParallelValues( *pBody, Captures );
+
+		if( llvm::verifyFunction( *pBody ) ) {
+			Token().Warn( "[CodeGen] Broken PARALLEL FOR body" );
+#if AX_DEBUG_ENABLED
+			pBody->dump();
+#else
+			return false;
+#endif
+		}
+
+		if( CG->CanOptimize() ) {
+			CG->FPM().run( *pBody );
+		}
+
+		//
+		//	Run the loop
+		//
+
+		CG->SetCurrentBlock( *pParentBlock );
+
+		llvm::Value *pContext = llvm::ConstantPointerNull::get( llvm::cast< llvm::PointerType >( pInt8PtrTy ) );
+		if( pContextTy != nullptr ) {
+			llvm::IRBuilder<> EntryBlockBuilder( &pParentFunc->getEntryBlock(), pParentFunc->getEntryBlock().begin() );
+			llvm::Value *const pContextVar = EntryBlockBuilder.CreateAlloca( pContextTy, nullptr, "parfor.ctx" );
+
+			for( uintptr i = 0; i < Captures.Num(); ++i ) {
+				Builder.CreateStore( Captures[ i ], Builder.CreateStructGEP( pContextTy, pContextVar, unsigned( i ) ) );
+			}
+
+			pContext = Builder.CreatePointerCast( pContextVar, pInt8PtrTy );
+		}
+
+		llvm::Value *const pArgs[] = {
+			Builder.CreatePointerCast( pBody, pInt8PtrTy ),
+			pContext,
+			pCount,
+			pChunks
+		};
+		Builder.CreateCall( IntFuncs.pParallelFor, pArgs );
+
+		if( m_Reductions.IsEmpty() ) {
+			return true;
+		}
+
+		// Combine the chunks' results in order
+		llvm::BasicBlock *const pReduceCond = llvm::BasicBlock::Create( Context, "parfor.reduce", pParentFunc );
+		llvm::BasicBlock *const pReduceBody = llvm::BasicBlock::Create( Context, "parfor.reduce.body", pParentFunc );
+		llvm::BasicBlock *const pReduceDone = llvm::BasicBlock::Create( Context, "parfor.reduce.end", pParentFunc );
+		AX_EXPECT_MEMORY( pReduceCond );
+		AX_EXPECT_MEMORY( pReduceBody );
+		AX_EXPECT_MEMORY( pReduceDone );
+
+		llvm::Value *pChunkIndex = nullptr;
+		{
+			llvm::IRBuilder<> EntryBlockBuilder( &pParentFunc->getEntryBlock(), pParentFunc->getEntryBlock().begin() );
+			pChunkIndex = EntryBlockBuilder.CreateAlloca( Builder.getInt32Ty(), nullptr, "parfor.chunk" );
+		}
+		Builder.CreateStore( Builder.getInt32( 0 ), pChunkIndex );
+
+		CG->SetCurrentBlock( *pReduceCond );
+		llvm::Value *const pChunk = Builder.CreateLoad( pChunkIndex );
+		Builder.CreateCondBr( Builder.CreateICmpULT( pChunk, pChunks ), pReduceBody, pReduceDone );
+
+		CG->SetCurrentBlock( *pReduceBody );
+		for( uintptr i = 0; i < m_Reductions.Num(); ++i ) {
+			const SReduction &Reduction = m_Reductions[ i ];
+			const STypeRef &RedRTy = Reduction.pVar->pVar->Type;
+
+			llvm::Value *const pIndices[] = { Builder.getInt32( 0 ), pChunk };
+			llvm::Value *const pPartial = Builder.CreateLoad( Builder.CreateInBoundsGEP( Partials[ i ], pIndices ) );
+			llvm::Value *const pTotal = Builder.CreateLoad( SharedVars[ i ], RedRTy.IsVolatile() );
+
+			llvm::Value *const pResult = EmitReduction( Builder, Reduction.Op, RedRTy.BuiltinType, pTotal, pPartial );
+			Builder.CreateStore( pResult, SharedVars[ i ], RedRTy.IsVolatile() );
+		}
+		Builder.CreateStore( Builder.CreateAdd( pChunk, Builder.getInt32( 1 ) ), pChunkIndex );
+		Builder.CreateBr( pReduceCond );
+
+		CG->SetCurrentBlock( *pReduceDone );
+		return true;
+	}
+
+
+	/*
+	===========================================================================
+
+		FOREACH/NEXT LOOP STATEMENT
+
+	===========================================================================
+	*/
+
+	CForEachStmt::CForEachStmt( const SToken &Tok, CParser &Parser )
+	: CBlockStatement( EStmtSeqType::LoopBlock, EStmtType::ForEachBlock, Tok, Parser )
+	, m_pVarToken( nullptr )
+	, m_pNextToken( nullptr )
+	, m_pMapExpr( nullptr )
+	, m_Semant()
+	{
+		memset( &m_Semant, 0, sizeof( m_Semant ) );
+	}
+
+	bool CForEachStmt::Parse()
+	{
+		AX_ASSERT( Token().IsKeyword( kKeyword_ForEach ) );
+
+		const SToken &VarTok = Lexer().ExpectLine( ETokenType::Name );
+		if( !VarTok ) {
+			return false;
+		}
+		if( VarTok.IsKeyword() ) {
+			Lexer().Expected( "Expected non-keyword for variable name" );
+			return false;
+		}
+
+		m_pVarToken = &VarTok;
+
+		const SToken &InTok = Lexer().Expect( ETokenType::Name );
+		if( !InTok ) {
+			return false;
+		}
+		if( !InTok.IsKeyword( kKeyword_In ) ) {
+			Lexer().Expected( "Expected IN" );
+			return false;
+		}
+
+		m_pMapExpr = Parser().ParseExpression();
+		if( !m_pMapExpr ) {
+			return false;
+		}
+
+		for(;;) {
+			const SToken &CheckTok = Lexer().Lex();
+			if( !CheckTok || !CheckTok.StartsLine() ) {
+				Lexer().Expected( "Expected a statement on a new line in FOREACH/NEXT" );
+				return false;
+			}
+
+			if( CheckTok.IsKeyword( kKeyword_Next ) ) {
+				m_pNextToken = &CheckTok;
+
+				if( Lexer().CheckLine( Ax::Parser::ETokenType::Name ) ) {
+					if( Lexer().Token() != *m_pVarToken ) {
+						Lexer().Expected( "Expected FOREACH variable name (" + m_pVarToken->GetString() + ")" );
+						return false;
+					}
+				}
+
+				break;
+			}
+
+			Lexer().Unlex();
+			if( !Parser().ParseStatement( m_Stmts ) ) {
+				return false;
+			}
+		}
+
+		AX_ASSERT_NOT_NULL( m_pNextToken );
+		return true;
+	}
+
+	Ax::String CForEachStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( "ForEach var:" ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pVarToken != nullptr ? m_pVarToken->GetString() : "(null)" ) );
+		AX_EXPECT_MEMORY( Result.Append( " in:" ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pMapExpr != nullptr ? m_pMapExpr->ToString() : "(null)" ) );
+
+		if( m_Stmts.begin() != m_Stmts.end() ) {
+			AX_EXPECT_MEMORY( Result.Append( "\n" ) );
+
+			Ax::String TempResult = m_Stmts.ToString();
+			AX_EXPECT_MEMORY( TempResult.TabSelf() );
+
+			AX_EXPECT_MEMORY( Result.Append( TempResult ) );
+		}
+
+		return Result;
+	}
+
+	bool CForEachStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pVarToken );
+		AX_ASSERT_NOT_NULL( m_pNextToken );
+		AX_ASSERT_NOT_NULL( m_pMapExpr );
+
+		SSymbol *pVarSym = nullptr;
+		Ax::String VarName;
+
+		AX_EXPECT_MEMORY( VarName.Assign( m_pVarToken->GetString() ) );
+
+		m_Semant.bOwnsVar = false;
+		pVarSym = const_cast< SSymbol * >( g_Prog->FindSymbol( VarName ) );
+		if( !pVarSym ) {
+			pVarSym = g_Prog->AddSymbol( VarName );
+			if( !pVarSym ) {
+				return false;
+			}
+
+			pVarSym->pDeclToken = m_pVarToken;
+			pVarSym->pVar = new SMemberInfo();
+			AX_EXPECT_MEMORY( pVarSym->pVar );
+
+			m_Semant.bOwnsVar = true;
+
+			pVarSym->pVar->Name.Swap( VarName );
+			pVarSym->pVar->PassBy = EPassBy::Direct;
+			pVarSym->pVar->PassMod = EPassMod::Direct;
+			pVarSym->pVar->uOffset = 0;
+			if( !STypeRef::Semant( pVarSym->pVar->Type, *m_pVarToken, nullptr ) ) {
+				return false;
+			}
+		} else if( !pVarSym->pVar ) {
+			m_pVarToken->Error( "Non-variable used as key in FOREACH loop" );
+			return false;
+		}
+
+		const EBuiltinType VarType = pVarSym->pVar->Type.BuiltinType;
+		if( VarType != EBuiltinType::StringObject && !IsIntNumber( VarType ) ) {
+			m_pVarToken->Error( "FOREACH key variable must be a string or an integer" );
+			return false;
+		}
+
+		m_Semant.pVar = pVarSym;
+
+		if( !m_pMapExpr->Semant() ) {
+			return false;
+		}
+
+		const STypeRef *const pMapRTy = m_pMapExpr->GetType();
+		if( !pMapRTy ) {
+			m_pMapExpr->Token().Error( "No type" );
+			return false;
+		}
+
+		// Maps are referred to by their number, as with MEMBLOCKs
+		m_Semant.MapCast = pMapRTy->BuiltinType != EBuiltinType::UserDefined ? GetCastForTypes( pMapRTy->BuiltinType, EBuiltinType::Int32, ECastMode::Input ) : ECast::Invalid;
+		if( m_Semant.MapCast == ECast::Invalid || !IsIntNumber( pMapRTy->BuiltinType ) ) {
+			m_pMapExpr->Token().Error( "FOREACH expects a map number after IN" );
+			return false;
+		}
+
+		MarkLoopSyncs( IsLoopSyncEnabled() );
+		if( !CBlockStatement::Semant() ) {
+			return false;
+		}
+
+		return true;
+	}
+
+	bool CForEachStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pVarToken );
+		AX_ASSERT_NOT_NULL( m_pMapExpr );
+		AX_ASSERT_NOT_NULL( m_Semant.pVar );
+		AX_ASSERT( m_Semant.MapCast != ECast::Invalid );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pMapIterFirst );
+		AX_ASSERT_NOT_NULL( IntFns.pMapIterNext );
+		AX_ASSERT_NOT_NULL( IntFns.pMapIterIntKey );
+		AX_ASSERT_NOT_NULL( IntFns.pMapIterStrKey );
+		AX_ASSERT_NOT_NULL( IntFns.pStrReclaim );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::Function *const pCurrFunc = &CG->CurrentFunction();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+
+		AX_ASSERT_NOT_NULL( pCurrFunc );
+
+		llvm::IRBuilder<> EntryBlockBuilder( &pCurrFunc->getEntryBlock(), pCurrFunc->getEntryBlock().begin() );
+
+		SSymbol *const pVarSym = m_Semant.pVar;
+		const STypeRef &VarRTy = pVarSym->pVar->Type;
+		if( m_Semant.bOwnsVar ) {
+			llvm::Type *const pVarTy = pVarSym->pVar->Type.CodeGen();
+			if( !pVarTy ) {
+				return false;
+			}
+
+			pVarSym->Translated.pValue = EntryBlockBuilder.CreateAlloca( pVarTy, nullptr, LLVMStr( m_pVarToken ) );
+			if( !pVarSym->Translated.pValue ) {
+				m_pVarToken->Error( "[CodeGen] Failed to generate 'alloca' instruction for loop key" );
+				return false;
+			}
+
+			// The key strings are owned by the variable
+			CG->EmitConstruct( pVarSym->Translated.pValue, VarRTy );
+			CG->EmitDestruct( pVarSym->Translated.pValue, VarRTy );
+		}
+
+		AX_ASSERT_NOT_NULL( pVarSym->Translated.pValue );
+
+		SValue PreMapVal = m_pMapExpr->CodeGen();
+		if( !PreMapVal ) {
+			return false;
+		}
+
+		llvm::Value *const pMapVal = CG->EmitCast( m_Semant.MapCast, EBuiltinType::Int32, PreMapVal.Load() );
+		if( !pMapVal ) {
+			return false;
+		}
+
+		// The map is evaluated once; the cursor is the entry's position + 1
+		llvm::Value *const pCursor = EntryBlockBuilder.CreateAlloca( IntFns.pMapIterFirst->getReturnType(), nullptr, "foreach.pos" );
+		if( !pCursor ) {
+			Token().Error( "[CodeGen] Failed to generate 'alloca' instruction for FOREACH cursor" );
+			return false;
+		}
+
+		Builder.CreateStore( Builder.CreateCall( IntFns.pMapIterFirst, pMapVal, "foreach.first" ), pCursor );
+
+		llvm::BasicBlock *const pEnterLabel = llvm::BasicBlock::Create( Context, "foreach.begin", pCurrFunc );
+		llvm::BasicBlock *const pBodyLabel = llvm::BasicBlock::Create( Context, "foreach.body", pCurrFunc );
+		llvm::BasicBlock *const pStepLabel = llvm::BasicBlock::Create( Context, "foreach.step", pCurrFunc );
+		llvm::BasicBlock *const pLeaveLabel = llvm::BasicBlock::Create( Context, "foreach.end", pCurrFunc );
+
+		if( !pEnterLabel || !pBodyLabel || !pStepLabel || !pLeaveLabel ) {
+			Token().Error( "[CodeGen] One or more BasicBlocks failed to generate for FOREACH/NEXT" );
+			return false;
+		}
+
+		CG->EnterLoop( pLeaveLabel, pStepLabel );
+
+		CG->SetCurrentBlock( *pEnterLabel );
+
+		llvm::Value *const pPos = Builder.CreateLoad( pCursor, "foreach.cur" );
+		llvm::Value *const pIsDone = Builder.CreateICmpEQ( pPos, llvm::ConstantInt::get( pPos->getType(), 0 ) );
+		Builder.CreateCondBr( pIsDone, pLeaveLabel, pBodyLabel );
+
+		CG->SetCurrentBlock( *pBodyLabel );
+
+		llvm::Value *const pArgs[] = { pMapVal, pPos };
+		if( VarRTy.BuiltinType == EBuiltinType::StringObject ) {
+			// The runtime returns a new string; the variable takes it over
+			llvm::Value *const pKey = Builder.CreateCall( IntFns.pMapIterStrKey, pArgs, "foreach.key" );
+			llvm::Value *const pOldKey = Builder.CreateLoad( pVarSym->Translated.pValue, VarRTy.IsVolatile() );
+
+			Builder.CreateStore( pKey, pVarSym->Translated.pValue, VarRTy.IsVolatile() );
+			Builder.CreateCall( IntFns.pStrReclaim, pOldKey );
+		} else {
+			llvm::Value *const pPreKey = Builder.CreateCall( IntFns.pMapIterIntKey, pArgs, "foreach.key" );
+
+			const ECast KeyCast = GetCastForTypes( EBuiltinType::Int64, VarRTy.BuiltinType, ECastMode::Input );
+			AX_ASSERT( KeyCast != ECast::Invalid );
+
+			llvm::Value *const pKey = CG->EmitCast( KeyCast, VarRTy.BuiltinType, pPreKey );
+			if( !pKey ) {
+				return false;
+			}
+
+			Builder.CreateStore( pKey, pVarSym->Translated.pValue, VarRTy.IsVolatile() );
+		}
+
+		if( !CBlockStatement::CodeGen() ) {
+			return false;
+		}
+
+		CG->SetCurrentBlock( *pStepLabel );
+
+		// The entry may have been erased in the body; its position is still
+		// where the next one is searched from
+		llvm::Value *const pStepArgs[] = { pMapVal, pPos };
+		Builder.CreateStore( Builder.CreateCall( IntFns.pMapIterNext, pStepArgs, "foreach.next" ), pCursor );
+
+		if( IsLoopSyncEnabled() ) {
+			CG->EmitSyncPoint( *pEnterLabel, *pLeaveLabel );
+		} else {
+			Builder.CreateBr( pEnterLabel );
+		}
+
+		CG->SetCurrentBlock( *pLeaveLabel );
+		if( pLeaveLabel != &CG->CurrentFunction().back() ) {
+			pLeaveLabel->moveAfter( &CG->CurrentFunction().back() );
+		}
+		pStepLabel->moveBefore( pLeaveLabel );
+
+		CG->LeaveLoop();
+		return true;
+	}
+
+
+	/*
+	===========================================================================
+
+		SORT ARRAY STATEMENT
+
+	===========================================================================
+	*/
+
+	CSortArrayStmt::CSortArrayStmt( const SToken &Tok, CParser &Parser )
+	: CStatement( EStmtType::SortArrayStmt, Tok, Parser )
+	, m_pArrayExpr( nullptr )
+	, m_pFieldToken( nullptr )
+	, m_bDescending( false )
+	, m_Semant()
+	{
+		memset( &m_Semant, 0, sizeof( m_Semant ) );
+	}
+
+	bool CSortArrayStmt::Parse()
+	{
+		AX_ASSERT( Token().IsKeyword( kKeyword_SortArray ) || Token().IsKeyword( kKeyword_StableSortArray ) );
+
+		m_pArrayExpr = Parser().ParseExpression();
+		if( !m_pArrayExpr ) {
+			return false;
+		}
+
+		m_pArrayExpr = ArrayOperand( m_pArrayExpr );
+
+		// BY, ASCENDING, and DESCENDING are only words here, not keywords
+		const SToken *pTok = &Lexer().CheckLine( ETokenType::Name );
+		if( *pTok && pTok->CaseCmp( "BY" ) ) {
+			m_pFieldToken = &Lexer().ExpectLine( ETokenType::Name );
+			if( !*m_pFieldToken ) {
+				return false;
+			}
+
+			pTok = &Lexer().CheckLine( ETokenType::Name );
+		}
+
+		if( *pTok ) {
+			if( pTok->CaseCmp( "DESCENDING" ) ) {
+				m_bDescending = true;
+			} else if( !pTok->CaseCmp( "ASCENDING" ) ) {
+				Lexer().Unlex();
+			}
+		}
+
+		return true;
+	}
+
+	Ax::String CSortArrayStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( Token().IsKeyword( kKeyword_StableSortArray ) ? "StableSortArray " : "SortArray " ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pArrayExpr != nullptr ? m_pArrayExpr->ToString() : "(null)" ) );
+		if( m_pFieldToken != nullptr ) {
+			AX_EXPECT_MEMORY( Result.Append( " by:" ) );
+			AX_EXPECT_MEMORY( Result.Append( m_pFieldToken->GetString() ) );
+		}
+		AX_EXPECT_MEMORY( Result.Append( m_bDescending ? " descending" : " ascending" ) );
+
+		return Result;
+	}
+
+	bool CSortArrayStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pArrayExpr );
+
+		if( !m_pArrayExpr->Semant() ) {
+			return false;
+		}
+
+		const STypeRef *const pArrRTy = m_pArrayExpr->GetType();
+		if( !pArrRTy || !pArrRTy->IsArray() ) {
+			m_pArrayExpr->Token().Error( "SORT ARRAY expects an array: \"" + m_pArrayExpr->ToString() + "\"" );
+			return false;
+		}
+
+		AX_ASSERT_NOT_NULL( pArrRTy->pRef );
+		const STypeRef &ItemRTy = *pArrRTy->pRef;
+
+		const STypeRef *pKeyRTy = &ItemRTy;
+		if( ItemRTy.BuiltinType == EBuiltinType::UserDefined ) {
+			AX_ASSERT_NOT_NULL( ItemRTy.pCustomType );
+			AX_ASSERT_NOT_NULL( ItemRTy.pCustomType->pScope );
+
+			const STypeInfo &ItemType = *ItemRTy.pCustomType;
+			if( ItemType.bIsSoA ) {
+				m_pArrayExpr->Token().Error( "SORT ARRAY cannot sort structure-of-arrays items (type \"" + ItemType.Name + "\")" );
+				return false;
+			}
+			if( !m_pFieldToken ) {
+				m_pArrayExpr->Token().Error( "SORT ARRAY needs BY <field> to sort items of type \"" + ItemType.Name + "\"" );
+				return false;
+			}
+
+			const SSymbol *const pFieldSym = ItemType.pScope->FindSymbol( *m_pFieldToken, ESearchArea::ThisScopeOnly );
+			if( !pFieldSym || !pFieldSym->pVar ) {
+				m_pFieldToken->Error( "No field by the name of \"" + m_pFieldToken->GetString() + "\" in type \"" + ItemType.Name + "\"" );
+				return false;
+			}
+
+			AX_ASSERT( pFieldSym->pVar->iFieldIndex >= 0 );
+
+			m_Semant.pItemType = &ItemType;
+			m_Semant.pField = pFieldSym->pVar;
+			pKeyRTy = &pFieldSym->pVar->Type;
+		} else if( m_pFieldToken != nullptr ) {
+			m_pFieldToken->Error( "BY names a field, but the items of \"" + m_pArrayExpr->ToString() + "\" aren't of a user-defined type" );
+			return false;
+		}
+
+		m_Semant.KeyType = GetSortKey( pKeyRTy->BuiltinType );
+		if( m_Semant.KeyType == ~0U ) {
+			( m_pFieldToken != nullptr ? *m_pFieldToken : m_pArrayExpr->Token() ).Error( "SORT ARRAY cannot sort by values of type \"" + pKeyRTy->ToString() + "\"" );
+			return false;
+		}
+
+		return true;
+	}
+
+	bool CSortArrayStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pArrayExpr );
+		AX_ASSERT( m_Semant.KeyType != ~0U );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pArraySort );
+
+		llvm::IRBuilder<> &Builder = CG->Builder();
+
+		SValue ArrVal = m_pArrayExpr->CodeGen();
+		if( !ArrVal ) {
+			return false;
+		}
+
+		// The array's value is its data, as with subscripts
+		llvm::Type *const pDataTy = Builder.getInt8PtrTy();
+		llvm::Value *const pArrData = Builder.CreateCast( llvm::CastInst::getCastOpcode( ArrVal.pLLVMValue, false, pDataTy, false ), ArrVal.pLLVMValue, pDataTy );
+
+		Ax::uint64 uKeyOffset = 0;
+		if( m_Semant.pField != nullptr ) {
+			AX_ASSERT_NOT_NULL( m_Semant.pItemType );
+			AX_ASSERT_NOT_NULL( m_Semant.pItemType->pLLVMTy );
+
+			const llvm::DataLayout &DL = CG->Module().getDataLayout();
+			llvm::StructType *const pItemTy = llvm::cast< llvm::StructType >( m_Semant.pItemType->pLLVMTy );
+
+			uKeyOffset = DL.getStructLayout( pItemTy )->getElementOffset( ( unsigned )m_Semant.pField->iFieldIndex );
+		}
+
+		unsigned Flags = 0;
+		if( m_bDescending ) {
+			Flags |= kSortF_Descending;
+		}
+		if( Token().IsKeyword( kKeyword_StableSortArray ) ) {
+			Flags |= kSortF_Stable;
+		}
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( Context, ( unsigned )g_Env->GetPointerBits() );
+		llvm::Type *const pUInt32Ty = llvm::Type::getInt32Ty( Context );
+
+		llvm::Value *const pArgs[] = {
+			pArrData,
+			llvm::ConstantInt::get( pUIntPtrTy, uKeyOffset ),
+			llvm::ConstantInt::get( pUInt32Ty, m_Semant.KeyType ),
+			llvm::ConstantInt::get( pUInt32Ty, Flags )
+		};
+
+		Builder.CreateCall( IntFns.pArraySort, pArgs );
+		return true;
+	}
+
+
+	/*
+	===========================================================================
+
+		ARRAY FILL/COPY/MATH STATEMENTS
+
+	===========================================================================
+	*/
+
+	// Check an array operand of the array commands, returning its item type
+	static const STypeRef *SemantArrayOperand( const char *pszCommand, SExpr &Operand )
+	{
+		AX_ASSERT_NOT_NULL( Operand );
+
+		Operand.pExpr = ArrayOperand( Operand.pExpr );
+		if( !Operand->Semant() ) {
+			return nullptr;
+		}
+
+		const STypeRef *const pArrRTy = Operand->GetType();
+		if( !pArrRTy || !pArrRTy->IsArray() ) {
+			Operand->Token().Error( Ax::String( pszCommand ) + " expects an array: \"" + Operand->ToString() + "\"" );
+			return nullptr;
+		}
+
+		AX_ASSERT_NOT_NULL( pArrRTy->pRef );
+		const STypeRef &ItemRTy = *pArrRTy->pRef;
+
+		if( ItemRTy.IsArray() ) {
+			Operand->Token().Error( Ax::String( pszCommand ) + " cannot operate on arrays of arrays: \"" + Operand->ToString() + "\"" );
+			return nullptr;
+		}
+		if( ItemRTy.BuiltinType == EBuiltinType::UserDefined ) {
+			AX_ASSERT_NOT_NULL( ItemRTy.pCustomType );
+
+			if( ItemRTy.pCustomType->bIsSoA ) {
+				Operand->Token().Error( Ax::String( pszCommand ) + " cannot operate on structure-of-arrays items (type \"" + ItemRTy.pCustomType->Name + "\")" );
+				return nullptr;
+			}
+		}
+
+		return &ItemRTy;
+	}
+	// Check an item index or count of the array commands (passed as uintptr)
+	static bool SemantArrayIndex( SExpr &Operand )
+	{
+		AX_ASSERT_NOT_NULL( Operand );
+
+		if( !Operand->Semant() ) {
+			return false;
+		}
+
+		const STypeRef &UIntPtrRTy = g_Env->GetUIntPtr();
+
+		const STypeRef *const pRTy = Operand->GetType();
+		if( !pRTy ) {
+			Operand->Token().Error( "Array index has no type" );
+			return false;
+		}
+
+		Operand.Cast = STypeRef::Cast( *pRTy, UIntPtrRTy );
+		if( Operand.Cast == ECast::Invalid ) {
+			return STypeRef::CastError( Operand->Token(), *pRTy, UIntPtrRTy );
+		}
+
+		return true;
+	}
+	static llvm::Value *CodeGenArrayOperand( SExpr &Operand )
+	{
+		SValue ArrVal = Operand->CodeGen();
+		if( !ArrVal ) {
+			return nullptr;
+		}
+
+		// The array's value is its data, as with subscripts
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Type *const pDataTy = Builder.getInt8PtrTy();
+
+		return Builder.CreateCast( llvm::CastInst::getCastOpcode( ArrVal.pLLVMValue, false, pDataTy, false ), ArrVal.pLLVMValue, pDataTy );
+	}
+	static llvm::Value *CodeGenArrayIndex( SExpr &Operand )
+	{
+		SValue Val = Operand->CodeGen();
+		if( !Val ) {
+			return nullptr;
+		}
+
+		return CG->EmitCast( Operand.Cast, g_Env->GetUIntPtrType(), Val.Load() );
+	}
+
+	CArrayFillStmt::CArrayFillStmt( const SToken &Tok, CParser &Parser )
+	: CStatement( EStmtType::ArrayFillStmt, Tok, Parser )
+	, m_pArgs( nullptr )
+	{
+	}
+
+	bool CArrayFillStmt::Parse()
+	{
+		AX_ASSERT( Token().IsKeyword( kKeyword_ArrayFill ) );
+
+		m_pArgs = Parser().ParseExpressionList();
+		return m_pArgs != nullptr;
+	}
+
+	Ax::String CArrayFillStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( "ArrayFill " ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pArgs != nullptr ? m_pArgs->ToString() : "(null)" ) );
+
+		return Result;
+	}
+
+	bool CArrayFillStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+		if( Args.Num() < 2 || Args.Num() > 4 ) {
+			Token().Error( "ARRAY FILL expects an array, a value, and optionally the first item and a count" );
+			return false;
+		}
+
+		const STypeRef *const pItemRTy = SemantArrayOperand( "ARRAY FILL", Args[ 0 ] );
+		if( !pItemRTy ) {
+			return false;
+		}
+
+		if( !Args[ 1 ]->Semant() ) {
+			return false;
+		}
+
+		const STypeRef *const pValRTy = Args[ 1 ]->GetType();
+		if( !pValRTy ) {
+			Args[ 1 ]->Token().Error( "ARRAY FILL value has no type" );
+			return false;
+		}
+
+		// Items of a user-defined type are copied from a variable of the type
+		if( pItemRTy->BuiltinType == EBuiltinType::UserDefined ) {
+			if( pValRTy->BuiltinType != EBuiltinType::UserDefined || pValRTy->pCustomType != pItemRTy->pCustomType ) {
+				return STypeRef::CastError( Args[ 1 ]->Token(), *pValRTy, *pItemRTy );
+			}
+
+			Args[ 1 ].Cast = ECast::None;
+		} else {
+			Args[ 1 ].Cast = STypeRef::Cast( *pValRTy, *pItemRTy );
+			if( Args[ 1 ].Cast == ECast::Invalid ) {
+				return STypeRef::CastError( Args[ 1 ]->Token(), *pValRTy, *pItemRTy );
+			}
+		}
+
+		for( uintptr i = 2; i < Args.Num(); ++i ) {
+			if( !SemantArrayIndex( Args[ i ] ) ) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool CArrayFillStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pArrayFill );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Type *const pDataTy = Builder.getInt8PtrTy();
+		llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( Context, ( unsigned )g_Env->GetPointerBits() );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+
+		const STypeRef *const pArrRTy = Args[ 0 ]->GetType();
+		AX_ASSERT( pArrRTy != nullptr && pArrRTy->pRef != nullptr );
+		const EBuiltinType ItemType = pArrRTy->pRef->BuiltinType;
+
+		llvm::Value *const pArrData = CodeGenArrayOperand( Args[ 0 ] );
+		if( !pArrData ) {
+			return false;
+		}
+
+		SValue Val = Args[ 1 ]->CodeGen();
+		if( !Val ) {
+			return false;
+		}
+
+		// The runtime copies the value from memory into each item
+		llvm::Value *pValPtr = nullptr;
+		if( ItemType == EBuiltinType::UserDefined ) {
+			if( !Val.IsAddress() ) {
+				Args[ 1 ]->Token().Error( "Expected variable, not constant" );
+				return false;
+			}
+
+			pValPtr = Val.Address();
+		} else {
+			llvm::Value *const pVal = CG->EmitCast( Args[ 1 ].Cast, ItemType, Val.Load() );
+			if( !pVal ) {
+				return false;
+			}
+
+			llvm::Function *const pCurrFunc = &CG->CurrentFunction();
+			llvm::IRBuilder<> EntryBlockBuilder( &pCurrFunc->getEntryBlock(), pCurrFunc->getEntryBlock().begin() );
+
+			pValPtr = EntryBlockBuilder.CreateAlloca( CG->GetBuiltinType( ItemType ), nullptr, "arrfill.value" );
+			Builder.CreateStore( pVal, pValPtr );
+		}
+
+		llvm::Value *pFirst = llvm::ConstantInt::get( pUIntPtrTy, 0 );
+		if( Args.Num() > 2 && !( pFirst = CodeGenArrayIndex( Args[ 2 ] ) ) ) {
+			return false;
+		}
+
+		// No count fills to the end
+		llvm::Value *pCount = llvm::Constant::getAllOnesValue( pUIntPtrTy );
+		if( Args.Num() > 3 && !( pCount = CodeGenArrayIndex( Args[ 3 ] ) ) ) {
+			return false;
+		}
+
+		llvm::Value *const pArgs[] = {
+			pArrData,
+			Builder.CreatePointerCast( pValPtr, pDataTy ),
+			pFirst,
+			pCount
+		};
+
+		Builder.CreateCall( IntFns.pArrayFill, pArgs );
+		return true;
+	}
+
+	CArrayCopyStmt::CArrayCopyStmt( const SToken &Tok, CParser &Parser )
+	: CStatement( EStmtType::ArrayCopyStmt, Tok, Parser )
+	, m_pArgs( nullptr )
+	{
+	}
+
+	bool CArrayCopyStmt::Parse()
+	{
+		AX_ASSERT( Token().IsKeyword( kKeyword_ArrayCopy ) );
+
+		m_pArgs = Parser().ParseExpressionList();
+		return m_pArgs != nullptr;
+	}
+
+	Ax::String CArrayCopyStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( "ArrayCopy " ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pArgs != nullptr ? m_pArgs->ToString() : "(null)" ) );
+
+		return Result;
+	}
+
+	bool CArrayCopyStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+		if( Args.Num() != 2 && Args.Num() != 4 && Args.Num() != 5 ) {
+			Token().Error( "ARRAY COPY expects two arrays, or each array followed by its first item, and optionally a count" );
+			return false;
+		}
+
+		const uintptr uSrc = Args.Num() == 2 ? 1 : 2;
+
+		const STypeRef *const pDstItemRTy = SemantArrayOperand( "ARRAY COPY", Args[ 0 ] );
+		if( !pDstItemRTy ) {
+			return false;
+		}
+		const STypeRef *const pSrcItemRTy = SemantArrayOperand( "ARRAY COPY", Args[ uSrc ] );
+		if( !pSrcItemRTy ) {
+			return false;
+		}
+
+		if( pDstItemRTy->BuiltinType != pSrcItemRTy->BuiltinType || pDstItemRTy->pCustomType != pSrcItemRTy->pCustomType ) {
+			Args[ uSrc ]->Token().Error( "ARRAY COPY needs arrays with the same type of items (\"" + pDstItemRTy->ToString() + "\" and \"" + pSrcItemRTy->ToString() + "\")" );
+			return false;
+		}
+
+		for( uintptr i = 1; i < Args.Num(); ++i ) {
+			if( i != uSrc && !SemantArrayIndex( Args[ i ] ) ) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool CArrayCopyStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pArrayCopyItems );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Type *const pUIntPtrTy = llvm::Type::getIntNTy( Context, ( unsigned )g_Env->GetPointerBits() );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+
+		llvm::Value *const pZero = llvm::ConstantInt::get( pUIntPtrTy, 0 );
+
+		// dst, src -- or -- dst, dstfirst, src, srcfirst [, count]
+		llvm::Value *pArgs[] = {
+			nullptr,
+			pZero,
+			nullptr,
+			pZero,
+			llvm::Constant::getAllOnesValue( pUIntPtrTy )
+		};
+
+		if( Args.Num() == 2 ) {
+			if( !( pArgs[ 0 ] = CodeGenArrayOperand( Args[ 0 ] ) ) || !( pArgs[ 2 ] = CodeGenArrayOperand( Args[ 1 ] ) ) ) {
+				return false;
+			}
+		} else {
+			for( uintptr i = 0; i < Args.Num(); ++i ) {
+				pArgs[ i ] = i == 0 || i == 2 ? CodeGenArrayOperand( Args[ i ] ) : CodeGenArrayIndex( Args[ i ] );
+				if( !pArgs[ i ] ) {
+					return false;
+				}
+			}
+		}
+
+		Builder.CreateCall( IntFns.pArrayCopyItems, pArgs );
+		return true;
+	}
+
+	struct SArrayMathKeyword
+	{
+		EKeyword					Keyword;
+		const char *				pszCommand;
+		const char *				pszName;
+		EMathBatch					Func;
+	};
+	static const SArrayMathKeyword g_ArrayMathKeywords[] = {
+		{ kKeyword_ArraySin  , "ARRAY SIN"  , "ArraySin"  , kMathBatch_Sin   },
+		{ kKeyword_ArrayCos  , "ARRAY COS"  , "ArrayCos"  , kMathBatch_Cos   },
+		{ kKeyword_ArraySqrt , "ARRAY SQRT" , "ArraySqrt" , kMathBatch_Sqrt  },
+		{ kKeyword_ArrayExp  , "ARRAY EXP"  , "ArrayExp"  , kMathBatch_Exp   },
+		{ kKeyword_ArrayLog  , "ARRAY LOG"  , "ArrayLog"  , kMathBatch_Log   },
+		{ kKeyword_ArrayNoise, "ARRAY NOISE", "ArrayNoise", kMathBatch_Noise }
+	};
+	static const SArrayMathKeyword &GetArrayMathKeyword( const SToken &Tok )
+	{
+		for( const SArrayMathKeyword &Entry : g_ArrayMathKeywords ) {
+			if( Tok.IsKeyword( Entry.Keyword ) ) {
+				return Entry;
+			}
+		}
+
+		AX_ASSERT_MSG( false, "Not an array math keyword" );
+		return g_ArrayMathKeywords[ 0 ];
+	}
+
+	CArrayMathStmt::CArrayMathStmt( const SToken &Tok, CParser &Parser )
+	: CStatement( EStmtType::ArrayMathStmt, Tok, Parser )
+	, m_pArgs( nullptr )
+	, m_bPrecise( false )
+	{
+	}
+
+	bool CArrayMathStmt::Parse()
+	{
+		m_pArgs = Parser().ParseExpressionList();
+		if( !m_pArgs ) {
+			return false;
+		}
+
+		// PRECISE is only a word here, not a keyword
+		const SToken &Tok = Lexer().CheckLine( ETokenType::Name );
+		if( Tok ) {
+			if( Tok.CaseCmp( "PRECISE" ) ) {
+				m_bPrecise = true;
+			} else {
+				Lexer().Unlex();
+			}
+		}
+
+		return true;
+	}
+
+	Ax::String CArrayMathStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( GetArrayMathKeyword( Token() ).pszName ) );
+		AX_EXPECT_MEMORY( Result.Append( " " ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pArgs != nullptr ? m_pArgs->ToString() : "(null)" ) );
+		if( m_bPrecise ) {
+			AX_EXPECT_MEMORY( Result.Append( " precise" ) );
+		}
+
+		return Result;
+	}
+
+	bool CArrayMathStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		const char *const pszCommand = GetArrayMathKeyword( Token() ).pszCommand;
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+		if( Args.Num() < 1 || Args.Num() > 2 ) {
+			Token().Error( Ax::String( pszCommand ) + " expects an array, and optionally a source array" );
+			return false;
+		}
+
+		for( uintptr i = 0; i < Args.Num(); ++i ) {
+			const STypeRef *const pItemRTy = SemantArrayOperand( pszCommand, Args[ i ] );
+			if( !pItemRTy ) {
+				return false;
+			}
+
+			if( pItemRTy->BuiltinType != EBuiltinType::Float32 ) {
+				Args[ i ]->Token().Error( Ax::String( pszCommand ) + " needs an array of FLOAT items, not \"" + pItemRTy->ToString() + "\"" );
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool CArrayMathStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pArrayMath );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Type *const pUInt32Ty = llvm::Type::getInt32Ty( Context );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+
+		llvm::Value *const pDstData = CodeGenArrayOperand( Args[ 0 ] );
+		if( !pDstData ) {
+			return false;
+		}
+
+		// With one array, the results replace its items
+		llvm::Value *pSrcData = pDstData;
+		if( Args.Num() > 1 && !( pSrcData = CodeGenArrayOperand( Args[ 1 ] ) ) ) {
+			return false;
+		}
+
+		llvm::Value *const pArgs[] = {
+			pDstData,
+			pSrcData,
+			llvm::ConstantInt::get( pUInt32Ty, GetArrayMathKeyword( Token() ).Func ),
+			llvm::ConstantInt::get( pUInt32Ty, m_bPrecise ? kMathBatchF_Precise : 0 )
+		};
+
+		Builder.CreateCall( IntFns.pArrayMath, pArgs );
+		return true;
+	}
+
+	CArrayRndStmt::CArrayRndStmt( const SToken &Tok, CParser &Parser )
+	: CStatement( EStmtType::ArrayRndStmt, Tok, Parser )
+	, m_pArgs( nullptr )
+	, m_Kind( kRndFill_Bits32 )
+	{
+	}
+
+	bool CArrayRndStmt::Parse()
+	{
+		AX_ASSERT( Token().IsKeyword( kKeyword_ArrayRnd ) );
+
+		m_pArgs = Parser().ParseExpressionList();
+		return m_pArgs != nullptr;
+	}
+
+	Ax::String CArrayRndStmt::ToString() const
+	{
+		Ax::String Result;
+
+		AX_EXPECT_MEMORY( Result.Append( "ArrayRnd " ) );
+		AX_EXPECT_MEMORY( Result.Append( m_pArgs != nullptr ? m_pArgs->ToString() : "(null)" ) );
+
+		return Result;
+	}
+
+	bool CArrayRndStmt::Semant()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+		if( Args.Num() != 1 && Args.Num() != 3 && Args.Num() != 4 ) {
+			Token().Error( "ARRAY RND expects an array, and optionally the low and high bounds and an RNG number" );
+			return false;
+		}
+
+		const STypeRef *const pItemRTy = SemantArrayOperand( "ARRAY RND", Args[ 0 ] );
+		if( !pItemRTy ) {
+			return false;
+		}
+
+		const bool bRanged = Args.Num() > 1;
+
+		// Drawing from a shared RNG has to be serialized (see CodeGen())
+		if( Args.Num() > 3 ) {
+			g_Prog->MarkThreadUnsafe();
+		}
+
+		switch( pItemRTy->BuiltinType )
+		{
+		case EBuiltinType::Int32:
+		case EBuiltinType::UInt32:
+			m_Kind = bRanged ? kRndFill_Int32 : kRndFill_Bits32;
+			break;
+
+		case EBuiltinType::Float32:
+			m_Kind = kRndFill_Float32;
+			break;
+
+		case EBuiltinType::Float64:
+			m_Kind = kRndFill_Float64;
+			break;
+
+		default:
+			Args[ 0 ]->Token().Error( "ARRAY RND needs an array of INTEGER, DWORD, FLOAT, or DOUBLE FLOAT items, not \"" + pItemRTy->ToString() + "\"" );
+			return false;
+		}
+
+		// The bounds are passed as doubles, which hold any INTEGER exactly;
+		// the RNG number as it is to RNG GENERATE
+		for( uintptr i = 1; i < Args.Num(); ++i ) {
+			if( !Args[ i ]->Semant() ) {
+				return false;
+			}
+
+			const STypeRef *const pRTy = Args[ i ]->GetType();
+			if( !pRTy ) {
+				Args[ i ]->Token().Error( "No type" );
+				return false;
+			}
+
+			const EBuiltinType ArgType = i < 3 ? EBuiltinType::Float64 : EBuiltinType::UInt32;
+
+			Args[ i ].Cast = pRTy->BuiltinType != EBuiltinType::UserDefined ? GetCastForTypes( pRTy->BuiltinType, ArgType, ECastMode::Input ) : ECast::Invalid;
+			if( Args[ i ].Cast == ECast::Invalid || ( i == 3 && !IsIntNumber( pRTy->BuiltinType ) ) ) {
+				Args[ i ]->Token().Error( i < 3 ? "ARRAY RND expects a number for each bound" : "ARRAY RND expects an RNG number after the bounds" );
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool CArrayRndStmt::CodeGen()
+	{
+		AX_ASSERT_NOT_NULL( m_pArgs );
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		AX_ASSERT_NOT_NULL( IntFns.pArrayRandomize );
+
+		llvm::LLVMContext &Context = CG->Context();
+		llvm::IRBuilder<> &Builder = CG->Builder();
+		llvm::Type *const pUInt32Ty = llvm::Type::getInt32Ty( Context );
+		llvm::Type *const pDoubleTy = llvm::Type::getDoubleTy( Context );
+
+		CExpressionList::ArrayType &Args = m_pArgs->Subexpressions();
+
+		// pArrayData, RNGNumber (0 for the default generator), Kind, Low, High
+		llvm::Value *pArgs[] = {
+			nullptr,
+			llvm::ConstantInt::get( pUInt32Ty, 0 ),
+			llvm::ConstantInt::get( pUInt32Ty, m_Kind ),
+			llvm::ConstantFP::get( pDoubleTy, 0.0 ),
+			llvm::ConstantFP::get( pDoubleTy, 1.0 )
+		};
+
+		if( !( pArgs[ 0 ] = CodeGenArrayOperand( Args[ 0 ] ) ) ) {
+			return false;
 		}
 
-		CG->SetCurrentBlock( *pStepLabel );
-
-		SValue PreStepVal;
-		if( m_pStepExpr != nullptr ) {
-			PreStepVal = m_pStepExpr->CodeGen();
-			if( !PreStepVal ) {
-				return false;
-			}
-		} else {
-			PreStepVal = llvm::ConstantInt::get( llvm::Type::getInt32Ty( Context ), llvm::APInt( 32, 1, true ) );
-			if( !PreStepVal ) {
-				Token().Error( "[CodeGen] Failed to generate step constant" );
+		for( uintptr i = 1; i < Args.Num(); ++i ) {
+			SValue Val = Args[ i ]->CodeGen();
+			if( !Val ) {
 				return false;
 			}
 
-			m_Semant.StepCast = GetCastForTypes( EBuiltinType::Int32, VarRTy.BuiltinType, ECastMode::Input );
-			if( m_Semant.StepCast == ECast::Invalid ) {
-				Token().Error( "[CodeGen] Invalid implicit cast for step expression" );
+			llvm::Value *const pVal = CG->EmitCast( Args[ i ].Cast, i < 3 ? EBuiltinType::Float64 : EBuiltinType::UInt32, Val.Load() );
+			if( !pVal ) {
 				return false;
 			}
-		}
 
-		AX_ASSERT( m_Semant.StepCast != ECast::Invalid );
+			pArgs[ i < 3 ? i + 2 : 1 ] = pVal;
+		}
 
-		llvm::Value *const pStepVal = CG->EmitCast( m_Semant.StepCast, VarRTy.BuiltinType, PreStepVal.Load() );
-		if( !pStepVal ) {
-			Token().Error( "[CodeGen] Failed to generate step cast" );
-			return false;
+		// The default generator is each thread's own, but an RNG is shared
+		const bool bSerialize = Args.Num() > 3 && CG->IsInParallelRegion();
+		if( bSerialize ) {
+			Builder.CreateCall( IntFns.pParallelLock, llvm::ArrayRef< llvm::Value * >() );
 		}
 
-		llvm::Value *const pLoadedVarVal = Builder.CreateLoad( pVarSym->Translated.pValue );
-		llvm::Value *const pSteppedVal =
-			( bIsFP )
-			? Builder.CreateFAdd( pLoadedVarVal, pStepVal )
-			: Builder.CreateAdd( pLoadedVarVal, pStepVal )
-			;
-		Builder.CreateStore( pSteppedVal, pVarSym->Translated.pValue );
-		Builder.CreateBr( pEnterLabel );
+		Builder.CreateCall( IntFns.pArrayRandomize, pArgs );
 
-		CG->SetCurrentBlock( *pLeaveLabel );
-		if( pLeaveLabel != &CG->CurrentFunction().back() ) {
-			pLeaveLabel->moveAfter( &CG->CurrentFunction().back() );
+		if( bSerialize ) {
+			Builder.CreateCall( IntFns.pParallelUnlock, llvm::ArrayRef< llvm::Value * >() );
 		}
-		pStepLabel->moveBefore( pLeaveLabel );
 
-		CG->LeaveLoop();
 		return true;
 	}
 
@@ -1131,6 +2989,7 @@ namespace Tenshi { namespace Compiler {
 	, m_pCaseDefaultToken( nullptr )
 	, m_pEndselectToken( nullptr )
 	, m_pSelectExpr( nullptr )
+	, m_CompareType( EBuiltinType::Invalid )
 	{
 	}
 
@@ -1207,6 +3066,23 @@ namespace Tenshi { namespace Compiler {
 		return Result;
 	}
 
+	// Check whether two CASE values (already converted to the same type) match
+	static bool AreCaseValuesEqual( const SConstant &A, const SConstant &B )
+	{
+		if( IsString( A.Type ) ) {
+			return A.Text == B.Text;
+		}
+		if( IsRealNumber( A.Type ) ) {
+			return A.fValue == B.fValue;
+		}
+
+		// Values of 128-bit types keep the sign of the constant
+		const bool bIsANegative = IsSigned( A.Type ) && A.iValue < 0;
+		const bool bIsBNegative = IsSigned( B.Type ) && B.iValue < 0;
+
+		return A.uValue == B.uValue && bIsANegative == bIsBNegative;
+	}
+
 	bool CSelectStmt::Semant()
 	{
 		AX_ASSERT_NOT_NULL( m_pSelectExpr );
@@ -1216,33 +3092,218 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
+		const STypeRef *const pSelectType = m_pSelectExpr->GetType();
+		const EBuiltinType SelectType = pSelectType != nullptr ? pSelectType->BuiltinType : EBuiltinType::Invalid;
+
+		switch( SelectType )
+		{
+		case EBuiltinType::StringObject:
+		case EBuiltinType::ConstUTF8Pointer:
+			m_CompareType = EBuiltinType::StringObject;
+			break;
+
+		case EBuiltinType::Float16:
+		case EBuiltinType::Float32:
+		case EBuiltinType::Float64:
+		case EBuiltinType::Boolean:
+			m_CompareType = SelectType;
+			break;
+
+		default:
+			if( !IsIntNumber( SelectType ) ) {
+				m_pSelectExpr->Token().Error( "SELECT expression must be an integer, real, or string" );
+				return false;
+			}
+
+			m_CompareType = SelectType;
+			break;
+		}
+
 		if( !CBlockStatement::Semant() ) {
 			return false;
 		}
 
-		return false;
+		// Every statement of a SELECT is a CASE (see Parse())
+		Ax::TArray< const CSelectCaseStmt * > Cases;
+		for( const CStatement *pStmt : m_Stmts ) {
+			AX_ASSERT_NOT_NULL( pStmt );
+			AX_ASSERT( pStmt->Is( EStmtType::CaseStmt ) );
+
+			AX_EXPECT_MEMORY( Cases.Append( static_cast< const CSelectCaseStmt * >( pStmt ) ) );
+		}
+
+		// A value can only select one CASE
+		for( Ax::uintptr uCase = 0; uCase < Cases.Num(); ++uCase ) {
+			const CSelectCaseStmt &Case = *Cases[ uCase ];
+
+			for( Ax::uintptr uValue = 0; uValue < Case.Values().Num(); ++uValue ) {
+				const SConstant &Value = Case.Values()[ uValue ];
+
+				for( Ax::uintptr uOtherCase = 0; uOtherCase <= uCase; ++uOtherCase ) {
+					const CSelectCaseStmt &OtherCase = *Cases[ uOtherCase ];
+					const Ax::uintptr cOtherValues = uOtherCase == uCase ? uValue : OtherCase.Values().Num();
+
+					for( Ax::uintptr uOtherValue = 0; uOtherValue < cOtherValues; ++uOtherValue ) {
+						if( !AreCaseValuesEqual( Value, OtherCase.Values()[ uOtherValue ] ) ) {
+							continue;
+						}
+
+						Case.ValueExpression( uValue )->Token().Error( "Duplicate CASE value" );
+						OtherCase.ValueExpression( uOtherValue )->Token().Report( ESeverity::Normal, "Declared here" );
+						return false;
+					}
+				}
+			}
+		}
+
+		if( !Cases.IsEmpty() && Cases.Last()->Fallthrough() != nullptr ) {
+			Cases.Last()->Fallthrough()->Token().Error( "FALLTHROUGH in the last CASE has no CASE to fall into" );
+			return false;
+		}
+
+		return true;
 	}
 	bool CSelectStmt::CodeGen()
 	{
 		AX_ASSERT_NOT_NULL( m_pSelectExpr );
 		AX_ASSERT_NOT_NULL( m_pEndselectToken );
+		AX_ASSERT( m_CompareType != EBuiltinType::Invalid );
+
+		// Each case's body gets its own block, placed in order after the
+		// dispatch (so FALLTHROUGH can branch into the next case's body)
+		Ax::TArray< CSelectCaseStmt * > Cases;
+		Ax::TArray< llvm::BasicBlock * > CaseBlocks;
+		Ax::TArray< llvm::BasicBlock * > ValueBlocks;
+		llvm::BasicBlock *pDefaultBlock = nullptr;
+
+		for( CStatement *pStmt : m_Stmts ) {
+			CSelectCaseStmt *const pCase = static_cast< CSelectCaseStmt * >( pStmt );
+
+			llvm::BasicBlock *const pCaseBlock = llvm::BasicBlock::Create( CG->Context(), pCase->IsDefault() ? "case.default" : "case" );
+			AX_EXPECT_MEMORY( pCaseBlock );
+
+			AX_EXPECT_MEMORY( Cases.Append( pCase ) );
+			AX_EXPECT_MEMORY( CaseBlocks.Append( pCaseBlock ) );
+
+			for( Ax::uintptr i = 0; i < pCase->Values().Num(); ++i ) {
+				AX_EXPECT_MEMORY( ValueBlocks.Append( pCaseBlock ) );
+			}
+
+			if( pCase->IsDefault() ) {
+				pDefaultBlock = pCaseBlock;
+			}
+		}
+
+		llvm::BasicBlock *const pLeaveBlock = llvm::BasicBlock::Create( CG->Context(), "select.end" );
+		AX_EXPECT_MEMORY( pLeaveBlock );
+
+		// The expression (and anything its evaluation allocated) only has to
+		// live until the dispatch is done
+		CG->EnterScope();
 
 		m_GeneratedExpressionValue = m_pSelectExpr->CodeGen();
 		if( !m_GeneratedExpressionValue ) {
+			CG->LeaveScope();
 			return false;
 		}
 
-		llvm::BasicBlock *const pLeaveLabel = llvm::BasicBlock::Create( CG->Context(), "select.end", &CG->CurrentFunction() );
+		llvm::Value *const pSelectVal = m_GeneratedExpressionValue.Load();
+		AX_ASSERT_NOT_NULL( pSelectVal );
 
-		if( !CBlockStatement::CodeGen() ) {
-			return false;
+		// Integers switch on the value itself; reals and strings are first
+		// mapped to the index of the matching value (-1 if none match)
+		llvm::Value *pSwitchVal = nullptr;
+		Ax::TArray< llvm::ConstantInt * > SwitchConsts;
+		AX_EXPECT_MEMORY( SwitchConsts.Reserve( ValueBlocks.Num() ) );
+
+		if( IsString( m_CompareType ) ) {
+			Ax::TArray< Ax::String > Labels;
+			AX_EXPECT_MEMORY( Labels.Reserve( ValueBlocks.Num() ) );
+
+			for( const CSelectCaseStmt *pCase : Cases ) {
+				for( const SConstant &Value : pCase->Values() ) {
+					AX_EXPECT_MEMORY( Labels.Append( Value.Text ) );
+				}
+			}
+
+			pSwitchVal = CG->EmitStringDispatch( pSelectVal, Labels );
+		} else if( IsRealNumber( m_CompareType ) ) {
+			llvm::Type *const pSelectTy = pSelectVal->getType();
+			if( !pSelectTy->isFloatingPointTy() ) {
+				m_pSelectExpr->Token().Error( "[CodeGen] SELECT expression is not a real number" );
+				CG->LeaveScope();
+				return false;
+			}
+
+			// Compare against each value, last to first, so the first match wins
+			pSwitchVal = CG->Builder().getInt32( -1 );
+
+			Ax::uint32 uIndex = ( Ax::uint32 )ValueBlocks.Num();
+			for( Ax::uintptr uCase = Cases.Num(); uCase > 0; --uCase ) {
+				const Ax::TArray< SConstant > &Values = Cases[ uCase - 1 ]->Values();
+
+				for( Ax::uintptr uValue = Values.Num(); uValue > 0; --uValue ) {
+					--uIndex;
+
+					llvm::Value *const pValue = llvm::ConstantFP::get( pSelectTy, Values[ uValue - 1 ].fValue );
+					llvm::Value *const pIsEq = CG->Builder().CreateFCmpOEQ( pSelectVal, pValue, "case.eq" );
+
+					pSwitchVal = CG->Builder().CreateSelect( pIsEq, CG->Builder().getInt32( uIndex ), pSwitchVal, "case.idx" );
+				}
+			}
+		} else {
+			llvm::IntegerType *const pSelectTy = llvm::dyn_cast< llvm::IntegerType >( pSelectVal->getType() );
+			if( !pSelectTy ) {
+				m_pSelectExpr->Token().Error( "[CodeGen] SELECT expression is not an integer" );
+				CG->LeaveScope();
+				return false;
+			}
+
+			pSwitchVal = pSelectVal;
+			for( const CSelectCaseStmt *pCase : Cases ) {
+				for( const SConstant &Value : pCase->Values() ) {
+					AX_EXPECT_MEMORY( SwitchConsts.Append( llvm::ConstantInt::get( pSelectTy, Value.uValue, IsSigned( Value.Type ) ) ) );
+				}
+			}
 		}
 
-		CG->SetCurrentBlock( *pLeaveLabel );
-		if( pLeaveLabel != &CG->CurrentFunction().back() ) {
-			pLeaveLabel->moveAfter( &CG->CurrentFunction().back() );
+		AX_ASSERT_NOT_NULL( pSwitchVal );
+
+		if( SwitchConsts.IsEmpty() ) {
+			for( Ax::uintptr i = 0; i < ValueBlocks.Num(); ++i ) {
+				AX_EXPECT_MEMORY( SwitchConsts.Append( CG->Builder().getInt32( ( Ax::uint32 )i ) ) );
+			}
+		}
+
+		CG->CleanScope();
+		CG->LeaveScope();
+
+		// LLVM picks the lowering (jump table, bit tests, or a binary search)
+		// from the values
+		llvm::SwitchInst *const pSwitch = CG->Builder().CreateSwitch( pSwitchVal, pDefaultBlock != nullptr ? pDefaultBlock : pLeaveBlock, ( unsigned )ValueBlocks.Num() );
+		AX_EXPECT_MEMORY( pSwitch );
+
+		for( Ax::uintptr i = 0; i < ValueBlocks.Num(); ++i ) {
+			pSwitch->addCase( SwitchConsts[ i ], ValueBlocks[ i ] );
+		}
+
+		for( Ax::uintptr uCase = 0; uCase < Cases.Num(); ++uCase ) {
+			CG->SetCurrentBlock( *CaseBlocks[ uCase ] );
+
+			AX_EXPECT_MEMORY( CG->EnterCase( uCase + 1 < Cases.Num() ? CaseBlocks[ uCase + 1 ] : nullptr ) );
+			const bool bGenerated = Cases[ uCase ]->CodeGen();
+			CG->LeaveCase();
+
+			if( !bGenerated ) {
+				return false;
+			}
+
+			if( !CG->CurrentBlock().getTerminator() ) {
+				CG->Builder().CreateBr( pLeaveBlock );
+			}
 		}
 
+		CG->SetCurrentBlock( *pLeaveBlock );
 		return true;
 	}
 
@@ -1259,7 +3320,9 @@ namespace Tenshi { namespace Compiler {
 	: CBlockStatement( EStmtSeqType::CaseBlock, EStmtType::CaseStmt, Tok, Parser )
 	, m_SelectStmt( Stmt )
 	, m_bIsDefault( false )
-	, m_pExpr( nullptr )
+	, m_Exprs()
+	, m_Values()
+	, m_pFallthrough( nullptr )
 	{
 	}
 	
@@ -1268,10 +3331,14 @@ namespace Tenshi { namespace Compiler {
 		AX_ASSERT( Token().IsKeyword( kKeyword_Case ) || Token().IsKeyword( kKeyword_CaseDefault ) );
 
 		if( Token().IsKeyword( kKeyword_Case ) ) {
-			m_pExpr = Parser().ParseExpression();
-			if( !m_pExpr ) {
-				return false;
-			}
+			do {
+				CExpression *const pExpr = Parser().ParseExpression();
+				if( !pExpr ) {
+					return false;
+				}
+
+				AX_EXPECT_MEMORY( m_Exprs.Append( pExpr ) );
+			} while( Lexer().CheckLine( ETokenType::Punctuation, "," ) );
 		} else {
 			m_bIsDefault = true;
 		}
@@ -1287,8 +3354,8 @@ namespace Tenshi { namespace Compiler {
 			if( CheckTok.IsKeyword( kKeyword_EndCase ) ) {
 				break;
 			}
-			// Allow "case" and "case default" to be used to end the current case
-			if( CheckTok.IsKeyword( kKeyword_Case ) || CheckTok.IsKeyword( kKeyword_CaseDefault ) ) {
+			// Allow "case", "case default", and "endselect" to end the current case
+			if( CheckTok.IsKeyword( kKeyword_Case ) || CheckTok.IsKeyword( kKeyword_CaseDefault ) || CheckTok.IsKeyword( kKeyword_EndSelect ) ) {
 				Lexer().Unlex();
 				break;
 			}
@@ -1299,9 +3366,7 @@ namespace Tenshi { namespace Compiler {
 			}
 		}
 
-		if( !Token().IsKeyword( kKeyword_CaseDefault ) ) {
-			AX_ASSERT_NOT_NULL( m_pExpr );
-		}
+		AX_ASSERT( m_bIsDefault == m_Exprs.IsEmpty() );
 		return true;
 	}
 
@@ -1310,11 +3375,16 @@ namespace Tenshi { namespace Compiler {
 		Ax::String Result;
 
 		AX_EXPECT_MEMORY( Result.Append( "Case expr:" ) );
-		if( m_pExpr != nullptr ) {
-			AX_ASSERT( m_bIsDefault == false );
-			AX_EXPECT_MEMORY( Result.Append( m_pExpr->ToString() ) );
+		if( !m_bIsDefault ) {
+			for( Ax::uintptr i = 0; i < m_Exprs.Num(); ++i ) {
+				AX_ASSERT_NOT_NULL( m_Exprs[ i ] );
+
+				if( i > 0 ) {
+					AX_EXPECT_MEMORY( Result.Append( ", " ) );
+				}
+				AX_EXPECT_MEMORY( Result.Append( m_Exprs[ i ]->ToString() ) );
+			}
 		} else {
-			AX_ASSERT( m_bIsDefault == true );
 			AX_EXPECT_MEMORY( Result.Append( "default" ) );
 		}
 
@@ -1330,47 +3400,125 @@ namespace Tenshi { namespace Compiler {
 		return Result;
 	}
 
-	bool CSelectCaseStmt::Semant()
+	bool CSelectCaseStmt::SemantValue( const CExpression &Expr, SConstant &OutValue ) const
 	{
-		AX_ASSERT_NOT_NULL( m_pExpr );
+		const SConstant *const pConst = Expr.GetConstant();
+		if( !pConst || !pConst->IsValid() ) {
+			Expr.Token().Error( "CASE value must be a constant" );
+			return false;
+		}
 
-		if( !m_pExpr->Semant() ) {
+		const EBuiltinType CompareType = m_SelectStmt.CompareType();
+		AX_ASSERT( CompareType != EBuiltinType::Invalid );
+
+		OutValue.Type = CompareType;
+
+		if( IsString( CompareType ) ) {
+			if( !IsString( pConst->Type ) ) {
+				Expr.Token().Error( "CASE value must be a string to match the SELECT expression" );
+				return false;
+			}
+
+			OutValue.Text = pConst->Text;
+			return true;
+		}
+
+		if( !IsNumber( pConst->Type ) && pConst->Type != EBuiltinType::Boolean ) {
+			Expr.Token().Error( "CASE value must be a number to match the SELECT expression" );
 			return false;
 		}
 
-		if( !CBlockStatement::Semant() ) {
+		if( IsRealNumber( CompareType ) ) {
+			double fValue = pConst->fValue;
+			if( !IsRealNumber( pConst->Type ) ) {
+				fValue = IsSigned( pConst->Type ) ? double( pConst->iValue ) : double( pConst->uValue );
+			}
+
+			// Compared at the precision of the SELECT expression
+			if( CompareType == EBuiltinType::Float32 ) {
+				fValue = double( float( fValue ) );
+			}
+
+			OutValue.fValue = fValue;
+			return true;
+		}
+
+		if( IsRealNumber( pConst->Type ) ) {
+			Expr.Token().Error( "CASE value must be an integer to match the SELECT expression" );
 			return false;
 		}
 
-		//
-		//	TODO: Does the parent select statement already have this?
-		//	-     Maybe this should be done in the parent select though
-		//
+		const unsigned cBits = CompareType == EBuiltinType::Boolean ? 1 : GetTypeSize( CompareType )*8;
 
-		return false;
+		// Every constant fits a 64-bit type; 128-bit types take the constant
+		// sign-extended if it's signed
+		if( cBits >= 64 ) {
+			if( cBits > 64 ) {
+				OutValue.Type = IsSigned( pConst->Type ) ? EBuiltinType::Int128 : EBuiltinType::UInt128;
+			}
+
+			OutValue.uValue = pConst->uValue;
+			return true;
+		}
+
+		// The value has to fit in the type, either as signed or unsigned
+		const Ax::uint64 uMask = ( Ax::uint64( 1 ) << cBits ) - 1;
+		const bool bIsNegative = IsSigned( pConst->Type ) && pConst->iValue < 0;
+
+		const bool bFits =
+			bIsNegative
+			? pConst->iValue >= -Ax::int64( Ax::uint64( 1 ) << ( cBits - 1 ) )
+			: pConst->uValue <= uMask;
+		if( !bFits ) {
+			Expr.Token().Error( "CASE value is out of range for the SELECT expression" );
+			return false;
+		}
+
+		OutValue.uValue = pConst->uValue & uMask;
+		return true;
 	}
-	bool CSelectCaseStmt::CodeGen()
+	bool CSelectCaseStmt::Semant()
 	{
-		// TODO
+		AX_ASSERT( m_bIsDefault == m_Exprs.IsEmpty() );
 
-		AX_ASSERT_NOT_NULL( m_pExpr );
+		AX_EXPECT_MEMORY( m_Values.Resize( m_Exprs.Num() ) );
+		for( Ax::uintptr i = 0; i < m_Exprs.Num(); ++i ) {
+			AX_ASSERT_NOT_NULL( m_Exprs[ i ] );
 
-		const SValue &TopExprVal = m_SelectStmt.ExpressionValue();
+			if( !m_Exprs[ i ]->Semant() ) {
+				return false;
+			}
+
+			if( !SemantValue( *m_Exprs[ i ], m_Values[ i ] ) ) {
+				return false;
+			}
+		}
 
-		SValue CaseExprVal = m_pExpr->CodeGen();
-		if( !CaseExprVal ) {
+		if( !CBlockStatement::Semant() ) {
 			return false;
 		}
 
-		// if topexprval == caseexprvall then block statements, else
-		// try next case
-		((void)TopExprVal);
+		// FALLTHROUGH leaves the case, so nothing can follow it
+		m_pFallthrough = nullptr;
+		for( const CStatement *pStmt : m_Stmts ) {
+			AX_ASSERT_NOT_NULL( pStmt );
 
-		if( !CBlockStatement::CodeGen() ) {
-			return false;
+			if( m_pFallthrough != nullptr ) {
+				pStmt->Token().Error( "Statements after FALLTHROUGH can never run" );
+				return false;
+			}
+
+			if( pStmt->Is( EStmtType::FallthroughStmt ) ) {
+				m_pFallthrough = pStmt;
+			}
 		}
 
-		return false;
+		return true;
+	}
+	bool CSelectCaseStmt::CodeGen()
+	{
+		// The parent SELECT dispatches to this case's block and ends it
+		return CBlockStatement::CodeGen();
 	}
 
 
@@ -1404,8 +3552,14 @@ namespace Tenshi { namespace Compiler {
 
 	bool CCaseFallthroughStmt::CodeGen()
 	{
-		// TODO
-		return false;
+		// The SELECT rejects a FALLTHROUGH in its last case
+		if( !CG->CanFallthroughCase() ) {
+			Token().Error( "[CodeGen] FALLTHROUGH has no CASE to fall into" );
+			return false;
+		}
+
+		CG->FallthroughCase();
+		return true;
 	}
 
 
@@ -1466,7 +3620,6 @@ namespace Tenshi { namespace Compiler {
 					return false;
 				}
 
-				AX_EXPECT_MEMORY( m_ElseStmts.Append( &ElseIfNode ) );
 				pCurrentStmts = &ElseIfNode.m_Stmts;
 				continue;
 			}
@@ -1574,29 +3727,70 @@ namespace Tenshi { namespace Compiler {
 
 		return true;
 	}
+	bool CIfStmt::DeclaresLabels() const
+	{
+		if( m_Stmts.DeclaresLabels() ) {
+			return true;
+		}
+
+		for( const CIfStmt *pElse : m_ElseStmts ) {
+			AX_ASSERT_NOT_NULL( pElse );
+
+			if( pElse->DeclaresLabels() ) {
+				return true;
+			}
+		}
+
+		return false;
+	}
 	bool CIfStmt::CodeGen()
 	{
 		AX_ASSERT( m_bIsElse || m_pCondition != nullptr );
 		AX_ASSERT( CG->HasCurrentFunction() );
 
-		// Create this block
-		m_CodeGen.pDestBlock = llvm::BasicBlock::Create( CG->Context(), "if.then", &CG->CurrentFunction() );
-		if( !m_CodeGen.pDestBlock ) {
-			Token().Error( "[CodeGen] Failed to generate if block" );
-			return false;
+		// Find the statements that can actually be reached (this and any
+		// following else statements) -- conditions folded during Semant()
+		// decide this up front
+		//
+		// NOTE: A dead branch is still generated if it declares a label, as a
+		// -     GOTO elsewhere might jump into it. (Its label blocks are only
+		// -     given a parent when the branch is generated.)
+		Ax::TArray< CIfStmt * > LiveStmts;
+
+		bool bAnyAlwaysTaken = false;
+		CIfStmt *pCheckStmt = this;
+		CIfStmt **ppCheckNext = m_ElseStmts.begin();
+		while( pCheckStmt != nullptr ) {
+			const SConstant *const pCond = pCheckStmt->m_pCondition != nullptr ? pCheckStmt->m_pCondition->GetConstant() : nullptr;
+
+			const bool bIsAlwaysTaken = !pCheckStmt->m_pCondition || ( pCond != nullptr && pCond->IsTrue() );
+			const bool bIsNeverTaken = bAnyAlwaysTaken || ( pCond != nullptr && !pCond->IsTrue() );
+
+			if( !bIsNeverTaken || pCheckStmt->DeclaresLabels() ) {
+				AX_EXPECT_MEMORY( LiveStmts.Append( pCheckStmt ) );
+			}
+
+			// Nothing following an unconditional branch can be reached, other
+			// than through a label
+			bAnyAlwaysTaken |= bIsAlwaysTaken;
+
+			pCheckStmt = ppCheckNext != m_ElseStmts.end() ? *ppCheckNext : nullptr;
+			++ppCheckNext;
 		}
 
-		// Generate the else blocks following this (for LLVM to generate code into)
-		if( !m_bIsElse ) {
-			for( CIfStmt *pStmt : m_ElseStmts ) {
-				AX_ASSERT_NOT_NULL( pStmt );
-				AX_ASSERT( pStmt->m_bIsElse );
+		// Nothing to generate if none of the branches can be taken
+		if( LiveStmts.IsEmpty() ) {
+			return true;
+		}
 
-				pStmt->m_CodeGen.pDestBlock = llvm::BasicBlock::Create( CG->Context(), "if.else", &CG->CurrentFunction() );
-				if( !pStmt->m_CodeGen.pDestBlock ) {
-					Token().Error( "[CodeGen] Failed to generate else block" );
-					return false;
-				}
+		// Create the blocks for each statement (for LLVM to generate code into)
+		for( CIfStmt *pStmt : LiveStmts ) {
+			AX_ASSERT_NOT_NULL( pStmt );
+
+			pStmt->m_CodeGen.pDestBlock = llvm::BasicBlock::Create( CG->Context(), pStmt == this ? "if.then" : "if.else", &CG->CurrentFunction() );
+			if( !pStmt->m_CodeGen.pDestBlock ) {
+				Token().Error( pStmt == this ? "[CodeGen] Failed to generate if block" : "[CodeGen] Failed to generate else block" );
+				return false;
 			}
 		}
 
@@ -1607,24 +3801,22 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
-		// For each if statement (including this and any following else statements)
-		CIfStmt *pGenStmt = this;
-		CIfStmt **ppNext = m_ElseStmts.begin();
-		while( pGenStmt != nullptr ) {
-			// Prepare the next if statement in advance
-			CIfStmt *const pNextStmt = ppNext != m_ElseStmts.end() ? *ppNext : nullptr;
-			++ppNext;
+		// For each reachable if statement
+		for( Ax::uintptr uStmt = 0; uStmt < LiveStmts.Num(); ++uStmt ) {
+			CIfStmt *const pGenStmt = LiveStmts[ uStmt ];
+			AX_ASSERT_NOT_NULL( pGenStmt );
 
 			// The next block represents where execution jumps to if this conditional fails
-			llvm::BasicBlock *const pNextBlock = pNextStmt != nullptr ? pNextStmt->m_CodeGen.pDestBlock : pEndifBlock;
+			llvm::BasicBlock *const pNextBlock = uStmt + 1 < LiveStmts.Num() ? LiveStmts[ uStmt + 1 ]->m_CodeGen.pDestBlock : pEndifBlock;
 			AX_ASSERT_NOT_NULL( pNextBlock );
 
 			// Generate code in this statement's local block
 			AX_ASSERT_NOT_NULL( pGenStmt->m_CodeGen.pDestBlock );
 			CG->SetCurrentBlock( *pGenStmt->m_CodeGen.pDestBlock );
 
-			// Generate the conditional for this statement
-			if( pGenStmt->m_pCondition != nullptr ) {
+			// Generate the conditional for this statement (unless it's known to pass)
+			const SConstant *const pCond = pGenStmt->m_pCondition != nullptr ? pGenStmt->m_pCondition->GetConstant() : nullptr;
+			if( pGenStmt->m_pCondition != nullptr && !( pCond != nullptr && pCond->IsTrue() ) ) {
 				llvm::Value *const pCondVal = CG->EmitCondition( *pGenStmt->m_pCondition );
 				if( !pCondVal ) {
 					Token().Error( "[CodeGen] Condition was not emitted for IF/ELSEIF" );
@@ -1661,9 +3853,6 @@ namespace Tenshi { namespace Compiler {
 			}
 			printf( "\n" );
 #endif
-
-			// Go to the next if statement
-			pGenStmt = pNextStmt;
 		}
 
 		// New code should emit after the ENDIF
@@ -2052,6 +4241,21 @@ namespace Tenshi { namespace Compiler {
 	}
 	static llvm::Value *RTyToTypePtr( const STypeRef &RTy )
 	{
+		if( RTy.BuiltinType == EBuiltinType::UserDefined ) {
+			AX_ASSERT_NOT_NULL( RTy.pCustomType );
+
+			llvm::GlobalVariable *const pTypeDesc = RTy.pCustomType->pLLVMTypeDesc;
+			if( !pTypeDesc ) {
+				return nullptr;
+			}
+
+			return llvm::ConstantExpr::getPointerCast( pTypeDesc, llvm::Type::getInt8PtrTy( CG->Context() ) );
+		}
+
+		if( IsVectorOrMatrix( RTy.BuiltinType ) ) {
+			return CG->GetBuiltinTypeDescriptor( RTy.BuiltinType );
+		}
+
 		const int TypeId = GetBuiltinTypeId( RTy.BuiltinType );
 		if( TypeId <= 0 ) {
 			return nullptr;
@@ -2426,18 +4630,35 @@ namespace Tenshi { namespace Compiler {
 			return false;
 		}
 
-		llvm::Value *const pVal = CG->EmitCast( m_Semanted.CastOp, m_Semanted.CastType, PrecastVal.Load() );
-		AX_EXPECT_MEMORY( pVal );
-
 		if( m_CompoundOp != EBuiltinOp::None ) {
 			Token().Error( "[CodeGen] Compound operators not yet supported" );
 			return false;
 		}
 
-		Var.Store( pVal );
+		// UDT instances are copied in memory rather than loaded as a whole
+		if( m_Semanted.CastType == EBuiltinType::UserDefined && m_Semanted.CastOp == ECast::None && PrecastVal.IsAddress() ) {
+			STypeRef *const pVarType = const_cast< STypeRef * >( m_pVarExpr->GetType() );
+			AX_ASSERT_NOT_NULL( pVarType );
+
+			if( !pVarType->CodeGen() ) {
+				return false;
+			}
+
+			CG->EmitCopyAssign( Var.Address(), PrecastVal.Address(), *pVarType );
+
+			CG->CleanScope();
+			CG->LeaveScope();
+
+			return true;
+		}
+
+		llvm::Value *const pVal = CG->EmitCast( m_Semanted.CastOp, m_Semanted.CastType, PrecastVal.Load() );
+		AX_EXPECT_MEMORY( pVal );
 
-		if( m_Semanted.CastOp == ECast::None && m_Semanted.CastType == EBuiltinType::StringObject ) {
-			CG->RemoveCleanCall( pVal );
+		if( m_Semanted.CastType == EBuiltinType::StringObject ) {
+			CG->EmitStringAssign( Var, pVal );
+		} else {
+			Var.Store( pVal );
 		}
 
 		CG->CleanScope( pVal );
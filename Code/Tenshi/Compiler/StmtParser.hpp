@@ -18,6 +18,12 @@ namespace Tenshi { namespace Compiler {
 		Local,
 		Global
 	};
+	enum class EReduceOp
+	{
+		Add,
+		Min,
+		Max
+	};
 
 	//
 	//	Block Statement
@@ -37,6 +43,7 @@ namespace Tenshi { namespace Compiler {
 		virtual ~CBlockStatement() {}
 
 		virtual void SetSequence( CStatementSequence &Seq ) AX_OVERRIDE;
+		virtual bool DeclaresLabels() const AX_OVERRIDE;
 
 		virtual bool Semant() AX_OVERRIDE;
 		virtual bool CodeGen() AX_OVERRIDE;
@@ -213,6 +220,9 @@ namespace Tenshi { namespace Compiler {
 	//	Do-Loops are always "safe" in that they call SYNC regardless of whether
 	//	safety code is enabled or not.
 	//
+	//	A SYNC in a loop is only an inline countdown check; the runtime is
+	//	called once every few iterations (see MCodeGen::EmitSyncPoint).
+	//
 	//	# <doloopstmt> ::= "DO" <loop-stmt-sequence> "LOOP"
 	//	#                ;
 	//
@@ -241,7 +251,8 @@ namespace Tenshi { namespace Compiler {
 	//	iteration.
 	//
 	//	While-Loops will have a SYNC call generated at the end of the loop's
-	//	iteration only if safety code is enabled.
+	//	iteration only if safety code is enabled. No SYNC is generated if the
+	//	condition is constant-false as the body can never run.
 	//
 	//	# <whileloopstmt> ::= "WHILE" <condition-expr> <loop-stmt-sequence> "ENDWHILE"
 	//	#                   ;
@@ -272,7 +283,8 @@ namespace Tenshi { namespace Compiler {
 	//	iteration.
 	//
 	//	Repeat-Loops will have a SYNC call generated at the end of the loop's
-	//	iteration only if safety code is enabled.
+	//	iteration only if safety code is enabled. No SYNC is generated if the
+	//	condition is constant-true as the body only runs once.
 	//
 	//	# <repeatloopstmt> ::= "REPEAT" <loop-stmt-sequence> "UNTIL" <condition-expr>
 	//	#                    ;
@@ -318,6 +330,14 @@ namespace Tenshi { namespace Compiler {
 	//	states how far to increment the passed-variable after each iteration of
 	//	the loop.
 	//
+	//	When the loop steps by one and its end is a constant, ARRAY COUNT or
+	//	ARRAY LEN of an array, or a sum or difference of those, array
+	//	subscripts indexed directly by the loop's variable are bounds-checked
+	//	once before the loop instead of on every access. The loop is
+	//	versioned: a copy keeping every check runs if the checks before it
+	//	fail. (Unless the body assigns to the variable or could change the
+	//	array.)
+	//
 	//	# <forloopstmt> ::= "FOR" <varname> "=" <expr> ( "TO" | "UNTIL" ) <expr>
 	//	#                   ( "STEP" <expr> )?
 	//	#                       <loop-stmt-sequence>
@@ -337,7 +357,9 @@ namespace Tenshi { namespace Compiler {
 		virtual bool Semant() AX_OVERRIDE;
 		virtual bool CodeGen() AX_OVERRIDE;
 
-	private:
+	protected:
+		CForLoopStmt( EStmtSeqType SeqType, EStmtType Type, const SToken &Tok, CParser &Parser );
+
 		const SToken *				m_pVarToken;
 		const SToken *				m_pToUntilToken;
 		const SToken *				m_pStepToken;
@@ -358,15 +380,340 @@ namespace Tenshi { namespace Compiler {
 		bool ParseInit();
 		bool ParseCond();
 		bool ParseStep();
+		bool ParseBody( const char *pszLoopName );
+
+		bool SemantRange( const STypeRef &IterRTy );
+
+		bool HasCountedRange( const SSymbol *&pOutEndArray ) const;
 
 		AX_DELETE_COPYFUNCS(CForLoopStmt);
 	};
 	//
+	//	Parallel For-Loop Statement
+	//	===========================
+	//	Represents a FOR/NEXT loop whose iterations are run in parallel.
+	//
+	//	The iteration range is split into chunks that the runtime's worker
+	//	threads claim from each other (see teParallelFor). The body is
+	//	outlined into its own function, so:
+	//
+	//		- The iterator and any LOCALs declared in the body are private to
+	//		- each chunk. The iterator must be an integer and the STEP must be
+	//		- a non-zero integer constant.
+	//
+	//		- Every other variable is shared. Nothing stops two iterations
+	//		- from writing the same variable; use REDUCE for totals.
+	//
+	//		- Each REDUCE variable gets a private copy per chunk, starting at
+	//		- zero (+), the largest value (MIN), or the smallest value (MAX).
+	//		- The copies are combined into the variable in chunk order after
+	//		- the loop, so the result doesn't depend on the number of workers.
+	//
+	//		- Calls to functions that aren't marked thread-safe (see the
+	//		- ".threads" module directive) are serialized.
+	//
+	//	Unlike FOR/NEXT, the number of iterations is computed once, before the
+	//	loop runs, so the end doesn't have to be hit exactly. Labels, GOTO,
+	//	GOSUB, EXIT, and GLOBAL declarations aren't allowed in the body.
+	//
+	//	# <parforstmt> ::= "PARALLEL FOR" <varname> "=" <expr>
+	//	#                  ( "TO" | "UNTIL" ) <expr> ( "STEP" <expr> )?
+	//	#                  ( "REDUCE" <reduction> ( "," <reduction> )* )?
+	//	#                      <loop-stmt-sequence>
+	//	#                  "NEXT" <varname>?
+	//	#                ;
+	//	# <reduction> ::= ( "+" | "MIN" | "MAX" ) <varname>
+	//	#               ;
+	//
+	class CParallelForStmt: public CForLoopStmt
+	{
+	public:
+		CParallelForStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CParallelForStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		struct SReduction
+		{
+			const SToken *			pOpToken;
+			const SToken *			pVarToken;
+			EReduceOp				Op;
+			SSymbol *				pVar;
+		};
+
+		Ax::TArray< SReduction >	m_Reductions;
+
+		struct
+		{
+			CScope *				pScope;
+			Ax::int64				iStep;
+		}							m_ParSemant;
+
+		bool ParseReduce();
+
+		AX_DELETE_COPYFUNCS(CParallelForStmt);
+	};
+	//
+	//	For-Each Loop Statement
+	//	=======================
+	//	Represents a loop over the keys of a MAP (see MAKE MAP), in the order
+	//	they were inserted.
+	//
+	//	The variable is given each key in turn. A string variable receives
+	//	integer keys as text; an integer variable receives string keys as 0.
+	//	Keys may be erased from the map in the body (including the current
+	//	one); keys inserted in the body might not be visited.
+	//
+	//	# <foreachstmt> ::= ( "FOREACH" | "FOR EACH" ) <varname> "IN" <expr>
+	//	#                       <loop-stmt-sequence>
+	//	#                   "NEXT" <varname>?
+	//	#                 ;
+	//
+	class CForEachStmt: public CBlockStatement
+	{
+	public:
+		CForEachStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CForEachStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		const SToken *				m_pVarToken;
+		const SToken *				m_pNextToken;
+		CExpression *				m_pMapExpr;
+
+		struct
+		{
+			SSymbol *				pVar;
+			bool					bOwnsVar;
+			ECast					MapCast;
+		}							m_Semant;
+
+		AX_DELETE_COPYFUNCS(CForEachStmt);
+	};
+	//
+	//	Sort Array Statement
+	//	====================
+	//	Represents sorting the items of an array in place, by their values or,
+	//	for arrays of a user-defined type, by one field of each.
+	//
+	//	Items of a multi-dimensional array are sorted in memory order, as if
+	//	the array had one dimension. Numeric keys (of any integer or floating-
+	//	point type) are radix sorted; string keys are compared. STABLE SORT
+	//	ARRAY keeps items with equal keys in the order they were in. Large
+	//	arrays are sorted on the PARALLEL FOR workers (see teArraySort()).
+	//
+	//	Structure-of-arrays items can't be sorted yet, as their fields aren't
+	//	stored together.
+	//
+	//	# <sortarraystmt> ::= ( "SORT ARRAY" | "STABLE SORT ARRAY" ) <expr>
+	//	#                     ( "(" ")" )? ( "BY" <fieldname> )?
+	//	#                     ( "ASCENDING" | "DESCENDING" )?
+	//	#                   ;
+	//
+	class CSortArrayStmt: public CStatement
+	{
+	public:
+		CSortArrayStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CSortArrayStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		CExpression *				m_pArrayExpr;
+		const SToken *				m_pFieldToken;
+		bool						m_bDescending;
+
+		struct
+		{
+			// Type of the items, if they're of a user-defined type
+			const STypeInfo *		pItemType;
+			// Field the items are sorted by (null to sort by the whole item)
+			const SMemberInfo *		pField;
+			// Key type passed to teArraySort (ESortKey)
+			unsigned				KeyType;
+		}							m_Semant;
+
+		AX_DELETE_COPYFUNCS(CSortArrayStmt);
+	};
+	//
+	//	Array Fill Statement
+	//	====================
+	//	Sets items of an array to a value: all of them, or count items from
+	//	first (to the end if there's no count).
+	//
+	//	As with SORT ARRAY, the items of a multi-dimensional array are indexed
+	//	in memory order, and the range is clipped to the array. Trivial items
+	//	are filled by block copies, on the PARALLEL FOR workers for large
+	//	ranges (see teArrayFill()); strings and other items are copied one at
+	//	a time.
+	//
+	//	# <arrayfillstmt> ::= "ARRAY FILL" <expr> ( "(" ")" )? "," <expr>
+	//	#                     ( "," <expr> ( "," <expr> )? )?
+	//	#                   ;
+	//
+	class CArrayFillStmt: public CStatement
+	{
+	public:
+		CArrayFillStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CArrayFillStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		// Array, value, and optionally the first item and count
+		CExpressionList *			m_pArgs;
+
+		AX_DELETE_COPYFUNCS(CArrayFillStmt);
+	};
+	//
+	//	Array Copy Statement
+	//	====================
+	//	Copies items from one array into another (or into another part of the
+	//	same array) with the same type of items. With just the two arrays, the
+	//	source's items are copied over the start of the destination.
+	//
+	//	Ranges are clipped to both arrays, and may overlap. Trivial items are
+	//	copied as memory, on the PARALLEL FOR workers for large ranges (see
+	//	teArrayCopyItems()).
+	//
+	//	# <arraycopystmt> ::= "ARRAY COPY" <expr> ( "(" ")" )? "," <expr> ( "(" ")" )?
+	//	#                   | "ARRAY COPY" <expr> ( "(" ")" )? "," <expr> ","
+	//	#                     <expr> ( "(" ")" )? "," <expr> ( "," <expr> )?
+	//	#                   ;
+	//
+	class CArrayCopyStmt: public CStatement
+	{
+	public:
+		CArrayCopyStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CArrayCopyStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		// Destination and source, or the destination, its first item, the
+		// source, its first item, and optionally the count
+		CExpressionList *			m_pArgs;
+
+		AX_DELETE_COPYFUNCS(CArrayCopyStmt);
+	};
+	//
+	//	Array Math Statement
+	//	====================
+	//	Applies SIN, COS, SQRT, EXP, LOG, or NOISE to each item of a FLOAT
+	//	array, in place, or to the items of a source array with the results
+	//	stored in the destination (as many items as the shorter array has).
+	//
+	//	The runtime works on four items at a time with SSE2, and splits large
+	//	arrays across the PARALLEL FOR workers (see teMathBatch()). PRECISE
+	//	gives exactly the results of the scalar functions instead.
+	//
+	//	# <arraymathstmt> ::= <arraymathkeyword> <expr> ( "(" ")" )?
+	//	#                     ( "," <expr> ( "(" ")" )? )? "PRECISE"?
+	//	#                   ;
+	//	# <arraymathkeyword> ::= "ARRAY SIN" | "ARRAY COS" | "ARRAY SQRT"
+	//	#                      | "ARRAY EXP" | "ARRAY LOG" | "ARRAY NOISE"
+	//	#                      ;
+	//
+	class CArrayMathStmt: public CStatement
+	{
+	public:
+		CArrayMathStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CArrayMathStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		// Destination, and optionally the source
+		CExpressionList *			m_pArgs;
+		// Whether PRECISE was given
+		bool						m_bPrecise;
+
+		AX_DELETE_COPYFUNCS(CArrayMathStmt);
+	};
+	//
+	//	Array Rnd Statement
+	//	===================
+	//	Fills an array with random values from the default generator, or from
+	//	the given RNG. INTEGER and DWORD items get values in [low, high), as
+	//	with RND( low, high ), or all 32 bits without a range. FLOAT and DOUBLE
+	//	FLOAT items get values in [low, high), or [0, 1) without a range.
+	//
+	//	The values are the same however many PARALLEL FOR workers the runtime
+	//	splits the array across, and the generator is left after the values
+	//	used (see tePCGFill()).
+	//
+	//	# <arrayrndstmt> ::= "ARRAY RND" <expr> ( "(" ")" )?
+	//	#                    ( "," <expr> "," <expr> ( "," <expr> )? )?
+	//	#                  ;
+	//
+	class CArrayRndStmt: public CStatement
+	{
+	public:
+		CArrayRndStmt( const SToken &Tok, CParser &Parser );
+		virtual ~CArrayRndStmt() {}
+
+		bool Parse();
+
+		virtual Ax::String ToString() const AX_OVERRIDE;
+
+		virtual bool Semant() AX_OVERRIDE;
+		virtual bool CodeGen() AX_OVERRIDE;
+
+	private:
+		// The array, and optionally the low and high bounds and the RNG
+		CExpressionList *			m_pArgs;
+		// Kind of values (ERndFill), from the type of the items
+		unsigned					m_Kind;
+
+		AX_DELETE_COPYFUNCS(CArrayRndStmt);
+	};
+	//
 	//	Select Statement
 	//	================
 	//	Represents the equivalent of a C switch-block.
 	//
-	//	TODO: Explain better.
+	//	The expression may be an integer, real, or string. Each CASE lists one
+	//	or more constants to compare the expression against; the first CASE
+	//	with a matching constant is run, or CASE DEFAULT if none match.
+	//
+	//	Integer (and boolean) expressions are dispatched by a single LLVM
+	//	switch, which LLVM lowers to jump tables, bit tests, or a binary search
+	//	as suits the values. String expressions are hashed against a perfect
+	//	hash of the CASE labels built by the compiler, so only one string
+	//	comparison is made (see MCodeGen::EmitStringDispatch()). Real
+	//	expressions compare against each value in turn.
 	//
 	//	# <selectstmt> ::= "SELECT" <expr> <casestmt>+ "ENDSELECT"
 	//	#                ;
@@ -392,12 +739,18 @@ namespace Tenshi { namespace Compiler {
 		{
 			return m_GeneratedExpressionValue;
 		}
+		// Built-in type the CASE values are compared as (valid after Semant())
+		inline EBuiltinType CompareType() const
+		{
+			return m_CompareType;
+		}
 
 	private:
 		const SToken *				m_pCaseDefaultToken;
 		const SToken *				m_pEndselectToken;
 		CExpression *				m_pSelectExpr;
 		SValue						m_GeneratedExpressionValue;
+		EBuiltinType				m_CompareType;
 
 		AX_DELETE_COPYFUNCS(CSelectStmt);
 	};
@@ -406,9 +759,10 @@ namespace Tenshi { namespace Compiler {
 	//	========================
 	//	Represents one clause of a SELECT statement.
 	//
-	//	TODO: Explain better.
+	//	The values must be constants of a type the SELECT expression can be
+	//	compared with, and no value may appear in more than one CASE.
 	//
-	//	# <casestmt> ::= "CASE" <const-expr> <case-stmt-sequence> "ENDCASE"
+	//	# <casestmt> ::= "CASE" <const-expr> ( "," <const-expr> )* <case-stmt-sequence> "ENDCASE"
 	//	#              | "CASE DEFAULT" <case-stmt-sequence> "ENDCASE"
 	//	#              ;
 	//
@@ -425,10 +779,33 @@ namespace Tenshi { namespace Compiler {
 		virtual bool Semant() AX_OVERRIDE;
 		virtual bool CodeGen() AX_OVERRIDE;
 
+		inline bool IsDefault() const
+		{
+			return m_bIsDefault;
+		}
+		// Constant of each value, converted to the SELECT's CompareType()
+		inline const Ax::TArray< SConstant > &Values() const
+		{
+			return m_Values;
+		}
+		inline const CExpression *ValueExpression( Ax::uintptr uIndex ) const
+		{
+			return m_Exprs[ uIndex ];
+		}
+		// The FALLTHROUGH ending this case (nullptr if there isn't one)
+		inline const CStatement *Fallthrough() const
+		{
+			return m_pFallthrough;
+		}
+
 	private:
 		CSelectStmt &				m_SelectStmt;
 		bool						m_bIsDefault;
-		CExpression *				m_pExpr;
+		Ax::TArray< CExpression * >	m_Exprs;
+		Ax::TArray< SConstant >		m_Values;
+		const CStatement *			m_pFallthrough;
+
+		bool SemantValue( const CExpression &Expr, SConstant &OutValue ) const;
 
 		AX_DELETE_COPYFUNCS(CSelectCaseStmt);
 	};
@@ -478,6 +855,10 @@ namespace Tenshi { namespace Compiler {
 	//	============
 	//	Represents a conditional-flow action (if statement).
 	//
+	//	Branches with a condition that is known at compile-time are pruned
+	//	during code generation: a branch that can never be taken is not
+	//	emitted, and a branch that is always taken ends the chain.
+	//
 	//	TODO: Explain better.
 	//
 	//	TODO: Grammar.
@@ -491,6 +872,7 @@ namespace Tenshi { namespace Compiler {
 		bool Parse();
 
 		virtual Ax::String ToString() const AX_OVERRIDE;
+		virtual bool DeclaresLabels() const AX_OVERRIDE;
 
 		virtual bool Semant() AX_OVERRIDE;
 		virtual bool CodeGen() AX_OVERRIDE;
@@ -8,9 +8,9 @@ namespace Tenshi { namespace Compiler {
 
 	CScope::CScope()
 	: m_pParent( nullptr )
-	, m_Subscopes()
-	, m_Symbols()
-	, m_NamePrefix()
+	, m_Subscopes( Ax::SMemtag( kMemtag_Symbols ) )
+	, m_Symbols( Ax::SMemtag( kMemtag_Symbols ) )
+	, m_NamePrefix( Ax::SMemtag( kMemtag_Symbols ) )
 	, m_pDictionary( nullptr )
 	, m_pSearchFrom( nullptr )
 	, m_pOwnerSym( nullptr )
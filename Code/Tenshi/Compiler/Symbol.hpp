@@ -4,6 +4,8 @@
 #include <Collections/Dictionary.hpp>
 #include <Core/Logger.hpp>
 
+#include "Memory.hpp"
+
 namespace Ax { namespace Parser {
 
 	struct SToken;
@@ -35,6 +37,8 @@ namespace Tenshi { namespace Compiler {
 	// Defines an item within a scope
 	struct SSymbol
 	{
+		TENSHI_MEMTAG_ALLOCS(kMemtag_Symbols)
+
 		// The token this symbol was declared with (e.g., a "function" token)
 		const Ax::Parser::SToken *	pDeclToken;
 		// The token pointing to this symbol's name
@@ -117,6 +121,8 @@ namespace Tenshi { namespace Compiler {
 	class CScope
 	{
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_Symbols)
+
 		CScope();
 		~CScope();
 
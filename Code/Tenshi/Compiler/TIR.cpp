@@ -0,0 +1,66 @@
+#include "_PCH.hpp"
+#include "TIR.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	llvm::CallInst *TIRCallTo( llvm::Value *pValue, const llvm::Function *pFunc )
+	{
+		llvm::CallInst *const pCall = llvm::dyn_cast_or_null< llvm::CallInst >( pValue );
+		if( !pCall || !pFunc || pCall->getCalledFunction() != pFunc ) {
+			return nullptr;
+		}
+
+		return pCall;
+	}
+
+	CTIRPassManager::CTIRPassManager()
+	: m_Passes()
+	{
+	}
+	CTIRPassManager::~CTIRPassManager()
+	{
+		for( ITIRPass *pPass : m_Passes ) {
+			delete pPass;
+		}
+	}
+
+	void CTIRPassManager::Add( ITIRPass *pPass )
+	{
+		AX_ASSERT_NOT_NULL( pPass );
+		AX_EXPECT_MEMORY( m_Passes.Append( pPass ) );
+	}
+	void CTIRPassManager::AddStandardPasses()
+	{
+		// The string passes go first: fusing an append onto a literal's copy
+		// leaves the literal read in place, which the second pass relies on
+		Add( new CStrAppendFusionPass() );
+		Add( new CStrLiteralPass() );
+		Add( new CBoundsCheckPass() );
+		Add( new CSyncPointPass() );
+	}
+
+	void CTIRPassManager::Run( llvm::Module &Mod, const STIRContext &Ctx )
+	{
+		for( ITIRPass *pPass : m_Passes ) {
+			AX_ASSERT_NOT_NULL( pPass );
+
+			const Ax::uint64 uStartMicrosecs = Ax::System::Microseconds();
+			unsigned cChanges = 0;
+
+			for( llvm::Function &Func : Mod ) {
+				if( Func.isDeclaration() ) {
+					continue;
+				}
+
+				cChanges += pPass->Run( Func, Ctx );
+			}
+
+			const Ax::uint64 uEndMicrosecs = Ax::System::Microseconds();
+
+			Ax::g_VerboseLog += Ax::String::Formatted( "Tenshi IR pass %s: %u change%s in %.3f ms",
+				pPass->GetName(), cChanges, cChanges == 1 ? "" : "s",
+				double( uEndMicrosecs - uStartMicrosecs )/1000.0 );
+		}
+	}
+
+}}
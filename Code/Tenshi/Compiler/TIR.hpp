@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Collections/Array.hpp>
+
+#include "CodeGen.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	/*
+	===========================================================================
+
+		TENSHI IR
+
+		The nodes generate LLVM IR directly (so everything is in SSA form
+		already), but operations with a meaning specific to the language are
+		kept recognizable until the module is finished: sync points and array
+		bounds checks are calls to "tenshi.*" operations (STIROps), and calls
+		into the runtime are identified by the function they call (e.g.,
+		teStrDup). The passes here rewrite those while that meaning is still
+		visible, then MCodeGen::LowerIR() expands the operations into the code
+		implementing them, before any of LLVM's own passes run.
+
+	===========================================================================
+	*/
+
+	// What the passes have to work with
+	struct STIRContext
+	{
+		const SInternalFunctions &	IntFuncs;
+		const STIROps &				Ops;
+	};
+
+	// Retrieve the call if the value is a direct call to the given function
+	llvm::CallInst *TIRCallTo( llvm::Value *pValue, const llvm::Function *pFunc );
+
+	class ITIRPass
+	{
+	public:
+		ITIRPass() {}
+		virtual ~ITIRPass() {}
+
+		// Name the pass is logged under
+		virtual const char *GetName() const = 0;
+		// Run the pass over a function, returning the number of changes made
+		virtual unsigned Run( llvm::Function &Func, const STIRContext &Ctx ) = 0;
+	};
+
+	class CTIRPassManager
+	{
+	public:
+		CTIRPassManager();
+		~CTIRPassManager();
+
+		// Add a pass to run after the others (the manager deletes it)
+		void Add( ITIRPass *pPass );
+		// Add every pass, in the order they're meant to run
+		void AddStandardPasses();
+
+		// Run the passes over each function defined in the module
+		void Run( llvm::Module &Mod, const STIRContext &Ctx );
+
+	private:
+		Ax::TArray< ITIRPass * >	m_Passes;
+
+		AX_DELETE_COPYFUNCS(CTIRPassManager);
+	};
+
+	/*
+		The passes (TIR_Passes.cpp)
+	*/
+
+	// teStrAppend( teStrDup( x ), y ) => teStrConcat( x, y )
+	//
+	// A concatenation starting with a string literal makes a temporary copy
+	// of the literal just to grow it; concatenating onto the literal itself
+	// makes one copy fewer.
+	class CStrAppendFusionPass: public virtual ITIRPass
+	{
+	public:
+		const char *GetName() const AX_OVERRIDE { return "str-append-fusion"; }
+		unsigned Run( llvm::Function &Func, const STIRContext &Ctx ) AX_OVERRIDE;
+	};
+	// Read string literals in place instead of through a temporary copy
+	//
+	// A literal is copied into a string temporary wherever it's used (e.g.,
+	// comparing against one). When the temporary is only ever read by the
+	// runtime and then reclaimed, the copy and the reclaim are dropped.
+	class CStrLiteralPass: public virtual ITIRPass
+	{
+	public:
+		const char *GetName() const AX_OVERRIDE { return "str-literals"; }
+		unsigned Run( llvm::Function &Func, const STIRContext &Ctx ) AX_OVERRIDE;
+	};
+	// Remove bounds checks that repeat an earlier one
+	//
+	// Within each run of blocks that can only be entered from the previous
+	// one, a check of the same array, dimension, and subscript as a check
+	// already made is dropped. Reads of the same variable count as the same
+	// value until something might have stored to it.
+	class CBoundsCheckPass: public virtual ITIRPass
+	{
+	public:
+		const char *GetName() const AX_OVERRIDE { return "bounds-checks"; }
+		unsigned Run( llvm::Function &Func, const STIRContext &Ctx ) AX_OVERRIDE;
+	};
+	// Remove sync points from loops that already sync every iteration
+	//
+	// When a sync point dominates another within the second one's loop (as
+	// an inner loop's does for its outer loop, if the inner loop always runs)
+	// the countdown already ticks on every iteration of that loop.
+	class CSyncPointPass: public virtual ITIRPass
+	{
+	public:
+		const char *GetName() const AX_OVERRIDE { return "sync-points"; }
+		unsigned Run( llvm::Function &Func, const STIRContext &Ctx ) AX_OVERRIDE;
+	};
+
+}}
@@ -0,0 +1,609 @@
+#include "_PCH.hpp"
+#include "TIR.hpp"
+
+namespace Tenshi { namespace Compiler {
+
+	using namespace Ax;
+
+	// Check whether a value is a (non-empty) string literal
+	//
+	// Empty literals are left alone: their copies are null, which isn't the
+	// same as an empty string to everything in the runtime.
+	static bool IsStringLiteral( const llvm::Value *pStr )
+	{
+		llvm::StringRef Text;
+		return llvm::getConstantStringInfo( pStr, Text ) && !Text.empty();
+	}
+	// Check whether a runtime function only reads the string passed as the
+	// given argument (never keeping, freeing, or changing it)
+	static bool OnlyReadsString( const llvm::CallInst &Call, unsigned uArg, const SInternalFunctions &IntFuncs )
+	{
+		const llvm::Function *const pFunc = Call.getCalledFunction();
+		if( !pFunc || uArg >= Call.getNumArgOperands() ) {
+			return false;
+		}
+
+		// teStrAppend() grows its first argument in place
+		if( pFunc == IntFuncs.pStrAppend ) {
+			return uArg == 1;
+		}
+
+		return
+			pFunc == IntFuncs.pAutoprint ||
+			pFunc == IntFuncs.pStrDup ||
+			pFunc == IntFuncs.pStrConcat ||
+			pFunc == IntFuncs.pStrFindRm ||
+			pFunc == IntFuncs.pStrRepeat ||
+			pFunc == IntFuncs.pStrCatDir ||
+			pFunc == IntFuncs.pStrEq ||
+			pFunc == IntFuncs.pStrCmp ||
+			pFunc == IntFuncs.pStrHash;
+	}
+
+	/*
+	===========================================================================
+
+		STRING APPEND FUSION
+
+	===========================================================================
+	*/
+
+	unsigned CStrAppendFusionPass::Run( llvm::Function &Func, const STIRContext &Ctx )
+	{
+		llvm::SmallVector< llvm::CallInst *, 16 > Appends;
+
+		for( llvm::BasicBlock &Block : Func ) {
+			for( llvm::Instruction &Inst : Block ) {
+				llvm::CallInst *const pAppend = TIRCallTo( &Inst, Ctx.IntFuncs.pStrAppend );
+				if( !pAppend ) {
+					continue;
+				}
+
+				// The copy has to belong to the append alone, and what it
+				// copies can't have changed in between (so only literals)
+				llvm::CallInst *const pDup = TIRCallTo( pAppend->getArgOperand( 0 ), Ctx.IntFuncs.pStrDup );
+				if( !pDup || !pDup->hasOneUse() || !IsStringLiteral( pDup->getArgOperand( 0 ) ) ) {
+					continue;
+				}
+
+				Appends.push_back( pAppend );
+			}
+		}
+
+		for( llvm::CallInst *pAppend : Appends ) {
+			llvm::CallInst *const pDup = llvm::cast< llvm::CallInst >( pAppend->getArgOperand( 0 ) );
+
+			llvm::Value *const pArgs[] = {
+				pDup->getArgOperand( 0 ),
+				pAppend->getArgOperand( 1 )
+			};
+
+			llvm::CallInst *const pConcat = llvm::CallInst::Create( Ctx.IntFuncs.pStrConcat, pArgs, "strcattmp", pAppend );
+			AX_EXPECT_MEMORY( pConcat );
+
+			pAppend->replaceAllUsesWith( pConcat );
+			pAppend->eraseFromParent();
+			pDup->eraseFromParent();
+		}
+
+		return ( unsigned )Appends.size();
+	}
+
+	/*
+	===========================================================================
+
+		STRING LITERALS
+
+	===========================================================================
+	*/
+
+	unsigned CStrLiteralPass::Run( llvm::Function &Func, const STIRContext &Ctx )
+	{
+		llvm::SmallVector< llvm::CallInst *, 16 > Copies;
+
+		for( llvm::BasicBlock &Block : Func ) {
+			for( llvm::Instruction &Inst : Block ) {
+				llvm::CallInst *const pDup = TIRCallTo( &Inst, Ctx.IntFuncs.pStrDup );
+				if( !pDup || !IsStringLiteral( pDup->getArgOperand( 0 ) ) ) {
+					continue;
+				}
+
+				// Every use has to either read the copy or reclaim it
+				bool bOnlyRead = true;
+				for( const llvm::Use &U : pDup->uses() ) {
+					const llvm::CallInst *const pUser = llvm::dyn_cast< llvm::CallInst >( U.getUser() );
+					if( pUser != nullptr && pUser->getCalledFunction() == Ctx.IntFuncs.pStrReclaim ) {
+						continue;
+					}
+
+					if( !pUser || !OnlyReadsString( *pUser, U.getOperandNo(), Ctx.IntFuncs ) ) {
+						bOnlyRead = false;
+						break;
+					}
+				}
+
+				if( bOnlyRead ) {
+					Copies.push_back( pDup );
+				}
+			}
+		}
+
+		for( llvm::CallInst *pDup : Copies ) {
+			llvm::SmallVector< llvm::CallInst *, 4 > Reclaims;
+			for( llvm::User *pUser : pDup->users() ) {
+				llvm::CallInst *const pReclaim = TIRCallTo( pUser, Ctx.IntFuncs.pStrReclaim );
+				if( pReclaim != nullptr ) {
+					Reclaims.push_back( pReclaim );
+				}
+			}
+
+			for( llvm::CallInst *pReclaim : Reclaims ) {
+				pReclaim->eraseFromParent();
+			}
+
+			pDup->replaceAllUsesWith( pDup->getArgOperand( 0 ) );
+			pDup->eraseFromParent();
+		}
+
+		return ( unsigned )Copies.size();
+	}
+
+	/*
+	===========================================================================
+
+		BOUNDS CHECKS
+
+	===========================================================================
+	*/
+
+	// Most values and checks remembered at a time (the oldest are forgotten)
+	static const uintptr kMaxAvailable = 64;
+
+	// A value computed along the current run of blocks
+	struct SAvailValue
+	{
+		// Opcode of the instruction computing the value
+		unsigned					uOpcode;
+		// Type of the value
+		llvm::Type *				pType;
+		// Leaders of the operands (only the address for a load)
+		llvm::Value *				pOperands[ 2 ];
+		// Object a load reads from (nullptr for anything else)
+		llvm::Value *				pObject;
+		// First instruction found computing the value
+		llvm::Value *				pLeader;
+	};
+	// A bounds check made along the current run of blocks
+	struct SAvailCheck
+	{
+		llvm::Value *				pArrData;
+		llvm::Value *				pDim;
+		llvm::Value *				pIndex;
+	};
+	// What's known at the end of a block
+	struct SBoundsPath
+	{
+		llvm::BasicBlock *			pBlock;
+		TArray< SAvailValue >		Values;
+		TArray< SAvailCheck >		Checks;
+	};
+
+	class CBoundsCheckWalker
+	{
+	public:
+		CBoundsCheckWalker( llvm::Function &Func, const STIRContext &Ctx )
+		: m_Func( Func )
+		, m_Ctx( Ctx )
+		, m_DataLayout( Func.getParent()->getDataLayout() )
+		, m_Leaders()
+		, m_Unaliased()
+		, m_Stored()
+		, m_cRemoved( 0 )
+		{
+		}
+
+		unsigned Run()
+		{
+			TArray< SBoundsPath > Pending;
+
+			// Start from each block that isn't only entered from one other
+			for( llvm::BasicBlock &Block : m_Func ) {
+				if( Block.getSinglePredecessor() != nullptr ) {
+					continue;
+				}
+
+				AX_EXPECT_MEMORY( Pending.Append() );
+				Pending.Last().pBlock = &Block;
+			}
+
+			while( !Pending.IsEmpty() ) {
+				SBoundsPath Path( Pending.Last() );
+				Pending.RemoveLast();
+
+				for(;;) {
+					VisitBlock( Path );
+
+					// Whatever was known carries into the blocks only this
+					// one leads to
+					llvm::BasicBlock *pNext = nullptr;
+					for( llvm::BasicBlock *pSucc : llvm::successors( Path.pBlock ) ) {
+						if( pSucc->getSinglePredecessor() != Path.pBlock ) {
+							continue;
+						}
+
+						if( !pNext ) {
+							pNext = pSucc;
+							continue;
+						}
+
+						AX_EXPECT_MEMORY( Pending.Append( Path ) );
+						Pending.Last().pBlock = pSucc;
+					}
+
+					if( !pNext ) {
+						break;
+					}
+
+					Path.pBlock = pNext;
+				}
+			}
+
+			return m_cRemoved;
+		}
+
+	private:
+		llvm::Function &			m_Func;
+		const STIRContext &			m_Ctx;
+		const llvm::DataLayout &	m_DataLayout;
+		llvm::DenseMap< llvm::Value *, llvm::Value * > m_Leaders;
+		llvm::DenseMap< llvm::Value *, bool > m_Unaliased;
+		llvm::DenseMap< llvm::Value *, bool > m_Stored;
+		unsigned					m_cRemoved;
+
+		template< typename tElement >
+		static void MakeAvailable( TArray< tElement > &Arr, const tElement &Element )
+		{
+			if( Arr.Num() >= kMaxAvailable ) {
+				Arr.Remove( 0 );
+			}
+
+			AX_EXPECT_MEMORY( Arr.Append( Element ) );
+		}
+
+		llvm::Value *Leader( llvm::Value *pValue ) const
+		{
+			const auto Found = m_Leaders.find( pValue );
+			return Found != m_Leaders.end() ? Found->second : pValue;
+		}
+
+		// Check whether an object is only ever loaded from or stored to
+		// directly (so no other pointer can point into it)
+		bool IsUnaliased( llvm::Value *pObject )
+		{
+			const auto Found = m_Unaliased.find( pObject );
+			if( Found != m_Unaliased.end() ) {
+				return Found->second;
+			}
+
+			const llvm::GlobalVariable *const pGlobal = llvm::dyn_cast< llvm::GlobalVariable >( pObject );
+			bool bUnaliased = llvm::isa< llvm::AllocaInst >( pObject ) || ( pGlobal != nullptr && pGlobal->hasLocalLinkage() );
+
+			if( bUnaliased ) {
+				for( const llvm::User *pUser : pObject->users() ) {
+					if( llvm::isa< llvm::LoadInst >( pUser ) ) {
+						continue;
+					}
+
+					const llvm::StoreInst *const pStore = llvm::dyn_cast< llvm::StoreInst >( pUser );
+					if( pStore != nullptr && pStore->getValueOperand() != pObject ) {
+						continue;
+					}
+
+					bUnaliased = false;
+					break;
+				}
+			}
+
+			m_Unaliased[ pObject ] = bUnaliased;
+			return bUnaliased;
+		}
+		static bool IsVariable( const llvm::Value *pObject )
+		{
+			return llvm::isa< llvm::AllocaInst >( pObject ) || llvm::isa< llvm::GlobalVariable >( pObject );
+		}
+		// Check whether a variable's address might have been written to memory
+		//
+		// Passing the address to a call is fine: calls hand back what they
+		// allocated, not what they were given.
+		bool IsAddressStored( llvm::Value *pObject )
+		{
+			const auto Found = m_Stored.find( pObject );
+			if( Found != m_Stored.end() ) {
+				return Found->second;
+			}
+
+			bool bStored = false;
+			for( const llvm::User *pUser : pObject->users() ) {
+				if( llvm::isa< llvm::LoadInst >( pUser ) || llvm::isa< llvm::CallInst >( pUser ) ) {
+					continue;
+				}
+
+				const llvm::StoreInst *const pStore = llvm::dyn_cast< llvm::StoreInst >( pUser );
+				if( pStore != nullptr && pStore->getValueOperand() != pObject ) {
+					continue;
+				}
+
+				// Anything else (e.g., a field's address) might end up anywhere
+				bStored = true;
+				break;
+			}
+
+			m_Stored[ pObject ] = bStored;
+			return bStored;
+		}
+		bool MayAlias( llvm::Value *pObjectA, llvm::Value *pObjectB )
+		{
+			if( pObjectA == pObjectB ) {
+				return true;
+			}
+
+			if( llvm::isIdentifiedObject( pObjectA ) && llvm::isIdentifiedObject( pObjectB ) ) {
+				return false;
+			}
+
+			if( IsUnaliased( pObjectA ) || IsUnaliased( pObjectB ) ) {
+				return false;
+			}
+
+			// Pointers the program reads out of memory point into memory the
+			// runtime allocated (array data, strings), never at a variable,
+			// unless the variable's address was written somewhere itself
+			if( llvm::isa< llvm::LoadInst >( pObjectA ) && IsVariable( pObjectB ) ) {
+				return IsAddressStored( pObjectB );
+			}
+			if( llvm::isa< llvm::LoadInst >( pObjectB ) && IsVariable( pObjectA ) ) {
+				return IsAddressStored( pObjectA );
+			}
+
+			return true;
+		}
+
+		// Forget the loads a store might have changed
+		void ForgetStored( SBoundsPath &Path, llvm::Value *pObject )
+		{
+			for( uintptr i = Path.Values.Num(); i > 0; --i ) {
+				const SAvailValue &Value = Path.Values[ i - 1 ];
+
+				if( Value.pObject != nullptr && MayAlias( Value.pObject, pObject ) ) {
+					Path.Values.Remove( i - 1 );
+				}
+			}
+		}
+		// Forget everything a call might have changed
+		//
+		// The call might resize an array it has been given in place, so the
+		// checks go too.
+		void ForgetCalled( SBoundsPath &Path )
+		{
+			for( uintptr i = Path.Values.Num(); i > 0; --i ) {
+				const SAvailValue &Value = Path.Values[ i - 1 ];
+
+				if( Value.pObject != nullptr && !( llvm::isa< llvm::AllocaInst >( Value.pObject ) && IsUnaliased( Value.pObject ) ) ) {
+					Path.Values.Remove( i - 1 );
+				}
+			}
+
+			Path.Checks.Clear();
+		}
+
+		// Find (or remember) the value computed by an instruction
+		void Number( SBoundsPath &Path, llvm::Instruction &Inst, llvm::Value *pOperand0, llvm::Value *pOperand1, llvm::Value *pObject )
+		{
+			for( const SAvailValue &Value : Path.Values ) {
+				if( Value.uOpcode != Inst.getOpcode() || Value.pType != Inst.getType() ) {
+					continue;
+				}
+				if( Value.pOperands[ 0 ] != pOperand0 || Value.pOperands[ 1 ] != pOperand1 ) {
+					continue;
+				}
+
+				m_Leaders[ &Inst ] = Value.pLeader;
+				return;
+			}
+
+			SAvailValue Value;
+
+			Value.uOpcode = Inst.getOpcode();
+			Value.pType = Inst.getType();
+			Value.pOperands[ 0 ] = pOperand0;
+			Value.pOperands[ 1 ] = pOperand1;
+			Value.pObject = pObject;
+			Value.pLeader = &Inst;
+
+			MakeAvailable( Path.Values, Value );
+		}
+
+		void VisitBlock( SBoundsPath &Path )
+		{
+			for( llvm::BasicBlock::iterator Iter = Path.pBlock->begin(); Iter != Path.pBlock->end(); ) {
+				llvm::Instruction &Inst = *Iter++;
+
+				if( llvm::CallInst *const pCheck = TIRCallTo( &Inst, m_Ctx.Ops.pBoundsCheck ) ) {
+					SAvailCheck Check;
+
+					Check.pArrData = Leader( pCheck->getArgOperand( 0 ) );
+					Check.pDim = pCheck->getArgOperand( 1 );
+					Check.pIndex = Leader( pCheck->getArgOperand( 2 ) );
+
+					bool bRepeated = false;
+					for( const SAvailCheck &Made : Path.Checks ) {
+						if( Made.pArrData == Check.pArrData && Made.pDim == Check.pDim && Made.pIndex == Check.pIndex ) {
+							bRepeated = true;
+							break;
+						}
+					}
+
+					if( bRepeated ) {
+						pCheck->eraseFromParent();
+						++m_cRemoved;
+					} else {
+						MakeAvailable( Path.Checks, Check );
+					}
+
+					continue;
+				}
+
+				if( llvm::LoadInst *const pLoad = llvm::dyn_cast< llvm::LoadInst >( &Inst ) ) {
+					if( pLoad->isSimple() ) {
+						llvm::Value *const pAddr = pLoad->getPointerOperand();
+						Number( Path, Inst, pAddr, nullptr, llvm::GetUnderlyingObject( pAddr, m_DataLayout ) );
+					}
+
+					continue;
+				}
+
+				if( llvm::StoreInst *const pStore = llvm::dyn_cast< llvm::StoreInst >( &Inst ) ) {
+					ForgetStored( Path, llvm::GetUnderlyingObject( pStore->getPointerOperand(), m_DataLayout ) );
+					continue;
+				}
+
+				if( llvm::isa< llvm::CastInst >( Inst ) ) {
+					Number( Path, Inst, Leader( Inst.getOperand( 0 ) ), nullptr, nullptr );
+					continue;
+				}
+				if( llvm::isa< llvm::BinaryOperator >( Inst ) ) {
+					Number( Path, Inst, Leader( Inst.getOperand( 0 ) ), Leader( Inst.getOperand( 1 ) ), nullptr );
+					continue;
+				}
+
+				if( llvm::CallInst *const pCall = llvm::dyn_cast< llvm::CallInst >( &Inst ) ) {
+					if( !pCall->onlyReadsMemory() ) {
+						ForgetCalled( Path );
+					}
+
+					continue;
+				}
+
+				if( Inst.mayWriteToMemory() ) {
+					ForgetCalled( Path );
+				}
+			}
+		}
+	};
+
+	unsigned CBoundsCheckPass::Run( llvm::Function &Func, const STIRContext &Ctx )
+	{
+		if( !Ctx.Ops.pBoundsCheck || Ctx.Ops.pBoundsCheck->use_empty() ) {
+			return 0;
+		}
+
+		CBoundsCheckWalker Walker( Func, Ctx );
+		return Walker.Run();
+	}
+
+	/*
+	===========================================================================
+
+		SYNC POINTS
+
+	===========================================================================
+	*/
+
+	// Where a sync point's loop goes when the program is asked to stop, past
+	// any blocks that only branch on; nullptr if the result isn't branched on
+	// directly
+	static llvm::BasicBlock *GetSyncLeave( llvm::CallInst &Sync )
+	{
+		llvm::BranchInst *const pBranch = llvm::dyn_cast< llvm::BranchInst >( Sync.getParent()->getTerminator() );
+		if( !pBranch || !pBranch->isConditional() || pBranch->getCondition() != &Sync || !Sync.hasOneUse() ) {
+			return nullptr;
+		}
+
+		llvm::BasicBlock *pLeave = pBranch->getSuccessor( 1 );
+		for( unsigned cForwards = 0; cForwards < 8; ++cForwards ) {
+			llvm::BranchInst *const pForward = llvm::dyn_cast< llvm::BranchInst >( &pLeave->front() );
+			if( !pForward || pForward->isConditional() ) {
+				break;
+			}
+
+			pLeave = pForward->getSuccessor( 0 );
+		}
+
+		return pLeave;
+	}
+	// Take out a sync point, leaving its loop to always continue
+	static void RemoveSyncPoint( llvm::CallInst &Sync )
+	{
+		llvm::BasicBlock *const pBlock = Sync.getParent();
+		llvm::BranchInst *const pBranch = llvm::cast< llvm::BranchInst >( pBlock->getTerminator() );
+
+		AX_ASSERT( pBranch->isConditional() && pBranch->getCondition() == &Sync );
+
+		llvm::BasicBlock *const pContinue = pBranch->getSuccessor( 0 );
+		llvm::BasicBlock *const pLeave = pBranch->getSuccessor( 1 );
+
+		pLeave->removePredecessor( pBlock );
+
+		llvm::BranchInst::Create( pContinue, pBranch );
+		pBranch->eraseFromParent();
+
+		Sync.eraseFromParent();
+	}
+
+	unsigned CSyncPointPass::Run( llvm::Function &Func, const STIRContext &Ctx )
+	{
+		llvm::SmallVector< llvm::CallInst *, 16 > SyncPoints;
+
+		for( llvm::BasicBlock &Block : Func ) {
+			for( llvm::Instruction &Inst : Block ) {
+				llvm::CallInst *const pSync = TIRCallTo( &Inst, Ctx.Ops.pSync );
+				if( pSync != nullptr ) {
+					SyncPoints.push_back( pSync );
+				}
+			}
+		}
+
+		if( SyncPoints.size() < 2 ) {
+			return 0;
+		}
+
+		llvm::DominatorTree DomTree( Func );
+		llvm::LoopInfo Loops( DomTree );
+
+		// Find them all before removing any; a sync point made redundant by
+		// one that's redundant itself is still covered, by whichever made
+		// that one redundant (dominance being transitive, and both leaving
+		// to the same place)
+		//
+		// The other sync point has to leave to the same place as this one.
+		// Otherwise (e.g., an inner loop's sync) a request to stop would only
+		// leave the inner loop, and this loop would carry on without ever
+		// asking again.
+		llvm::SmallVector< llvm::CallInst *, 16 > Redundant;
+		for( llvm::CallInst *pSync : SyncPoints ) {
+			const llvm::Loop *const pLoop = Loops.getLoopFor( pSync->getParent() );
+			if( !pLoop ) {
+				continue;
+			}
+
+			llvm::BasicBlock *const pLeave = GetSyncLeave( *pSync );
+			if( !pLeave ) {
+				continue;
+			}
+
+			for( llvm::CallInst *pOther : SyncPoints ) {
+				if( pOther != pSync && pLoop->contains( pOther->getParent() ) && GetSyncLeave( *pOther ) == pLeave && DomTree.dominates( pOther, pSync ) ) {
+					Redundant.push_back( pSync );
+					break;
+				}
+			}
+		}
+
+		for( llvm::CallInst *pSync : Redundant ) {
+			RemoveSyncPoint( *pSync );
+		}
+
+		return ( unsigned )Redundant.size();
+	}
+
+}}
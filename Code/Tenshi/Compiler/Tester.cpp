@@ -7,6 +7,7 @@
 #include "FunctionParser.hpp"
 #include "Program.hpp"
 #include "CodeGen.hpp"
+#include "Environment.hpp"
 
 #include <Core/Logger.hpp>
 
@@ -640,6 +641,11 @@ namespace Tenshi { namespace Compiler {
 				continue;
 			}
 
+			if( Tokens[ 0 ] == "lower" ) {
+				CG->LowerIR();
+				continue;
+			}
+
 			if( Tokens[ 0 ] == "load-mod" ) {
 				if( Tokens.Num() < 2 ) {
 					Ax::Errorf( Filename, "Expected module name for load-mod" );
@@ -751,6 +757,27 @@ namespace Tenshi { namespace Compiler {
 				CG->SetOptimize( false );
 				continue;
 			}
+			if( Tokens[ 0 ] == "safety" ) {
+				if( Tokens.Num() < 2 ) {
+					Ax::Errorf( Filename, "Expected off, on, or full for safety" );
+					return false;
+				}
+
+				SBuildInfo BuildInfo = g_Env->BuildInfo();
+				if( Tokens[ 1 ] == "off" ) {
+					BuildInfo.SafetyCode = ESafetyCode::Off;
+				} else if( Tokens[ 1 ] == "on" ) {
+					BuildInfo.SafetyCode = ESafetyCode::On;
+				} else if( Tokens[ 1 ] == "full" ) {
+					BuildInfo.SafetyCode = ESafetyCode::Full;
+				} else {
+					Ax::Errorf( Filename, "Unknown safety level <%s>", Tokens[ 1 ].CString() );
+					return false;
+				}
+				g_Env->SetBuildInfo( BuildInfo );
+
+				continue;
+			}
 			if( Tokens[ 0 ] == "+labeldebug" ) {
 				CG->SetLabelDebugLogging( true );
 				continue;
@@ -90,6 +90,9 @@ namespace Tenshi { namespace Compiler {
 		if( bIsMoveTrivial ) {
 			AX_EXPECT_MEMORY( Result.Append( " +trivmove" ) );
 		}
+		if( bIsSoA ) {
+			AX_EXPECT_MEMORY( Result.Append( " +soa" ) );
+		}
 
 		AX_EXPECT_MEMORY( Result.Append( "\n{\n" ) );
 
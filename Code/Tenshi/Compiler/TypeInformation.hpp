@@ -147,6 +147,8 @@ namespace Tenshi { namespace Compiler {
 	// Information about a single type member
 	struct SMemberInfo
 	{
+		TENSHI_MEMTAG_ALLOCS(kMemtag_Symbols)
+
 		// Name of the member
 		Ax::String					Name;
 		// Reference to the type
@@ -159,6 +161,8 @@ namespace Tenshi { namespace Compiler {
 		Ax::uint32					uOffset;
 		// The field index of this member
 		Ax::intptr					iFieldIndex;
+		// Offset of this member's column per array item (structure-of-arrays types only)
+		Ax::uint32					uColumnOffset;
 
 		inline SMemberInfo()
 		: Name()
@@ -167,6 +171,7 @@ namespace Tenshi { namespace Compiler {
 		, PassMod( EPassMod::Direct )
 		, uOffset( 0 )
 		, iFieldIndex( -1 )
+		, uColumnOffset( 0 )
 		{
 		}
 
@@ -175,6 +180,8 @@ namespace Tenshi { namespace Compiler {
 	// Information about a custom user type
 	struct STypeInfo
 	{
+		TENSHI_MEMTAG_ALLOCS(kMemtag_Symbols)
+
 		// Name of the type
 		Ax::String					Name;
 		// All members available in this type
@@ -191,6 +198,10 @@ namespace Tenshi { namespace Compiler {
 		bool						bIsCopyTrivial;
 		// Whether moving the type is trivial (simple memcpy from src to dst, and zero out src)
 		bool						bIsMoveTrivial;
+		// Whether arrays of the type store each field in its own column (structure-of-arrays)
+		bool						bIsSoA;
+		// Size of one item across all columns (structure-of-arrays types only)
+		Ax::uint32					cColumnBytes;
 		// Scope of the type (where all fields are stored for look-ups)
 		CScope *					pScope;
 		// LLVM type for this structure
@@ -198,6 +209,8 @@ namespace Tenshi { namespace Compiler {
 
 		// Index to the function in the global type description table
 		llvm::Constant *			pLLVMElementIndex;
+		// Type description handed to the runtime's array functions (TenshiType_s)
+		llvm::GlobalVariable *		pLLVMTypeDesc;
 
 		// Constructor function
 		llvm::Function *			pLLVMInitFn;
@@ -223,6 +236,12 @@ namespace Tenshi { namespace Compiler {
 		Ax::String					ParmTypePattern;
 		// Where the function came from
 		SModule *					pModule;
+		// Whether the function can be called from several threads at once
+		// (calls to other functions within a PARALLEL FOR are serialized)
+		bool						bThreadSafe;
+		// Functions called from this one, if it's the program's own (its
+		// bThreadSafe is worked out from theirs; see CParser::Semant)
+		Ax::TArray< const SFunctionOverload * > Callees;
 
 		// List of LLVM parameter types
 		Ax::TArray< llvm::Type * >	LLVMTypes;
@@ -239,6 +258,8 @@ namespace Tenshi { namespace Compiler {
 		, Parameters()
 		, ParmTypePattern()
 		, pModule( nullptr )
+		, bThreadSafe( false )
+		, Callees()
 		, LLVMTypes()
 		, pLLVMReturnType( nullptr )
 		, pLLVMFuncType( nullptr )
@@ -252,6 +273,8 @@ namespace Tenshi { namespace Compiler {
 	// Information about a function
 	struct SFunctionInfo
 	{
+		TENSHI_MEMTAG_ALLOCS(kMemtag_Symbols)
+
 		// Name of the function
 		Ax::String					Name;
 		// Function overloads
@@ -16,12 +16,19 @@ namespace Tenshi { namespace Compiler {
 	, m_Lexer( Parser.Lexer() )
 	, m_pNameTok( nullptr )
 	, m_pEndtypeTok( nullptr )
+	, m_pSoATok( nullptr )
 	, m_pTypeInfo( nullptr )
 	{
 		memset( &m_CodeGen, 0, sizeof( m_CodeGen ) );
 	}
 	CUserDefinedType::~CUserDefinedType()
 	{
+		// The type information outlives this (symbols and type references
+		// point to it)
+		for( CUDTField *&pField : m_Fields ) {
+			delete pField;
+			pField = nullptr;
+		}
 	}
 
 	bool CUserDefinedType::Parse()
@@ -39,6 +46,12 @@ namespace Tenshi { namespace Compiler {
 
 		m_pNameTok = &NameTok;
 
+		// "TYPE <name> SOA" lays out arrays of the type as structure-of-arrays
+		const SToken &SoATok = m_Lexer.CheckLine( ETokenType::Name, "soa" );
+		if( SoATok ) {
+			m_pSoATok = &SoATok;
+		}
+
 		for(;;) {
 			const SToken &CheckTok = m_Lexer.Lex();
 			if( !CheckTok || !CheckTok.StartsLine() ) {
@@ -186,9 +199,12 @@ namespace Tenshi { namespace Compiler {
 		m_pTypeInfo->bIsFiniTrivial = true;
 		m_pTypeInfo->bIsCopyTrivial = true;
 		m_pTypeInfo->bIsMoveTrivial = true;
+		m_pTypeInfo->bIsSoA = m_pSoATok != nullptr;
+		m_pTypeInfo->cColumnBytes = 0;
 
 		m_pTypeInfo->pLLVMTy = nullptr;
 		m_pTypeInfo->pLLVMElementIndex = nullptr;
+		m_pTypeInfo->pLLVMTypeDesc = nullptr;
 		m_pTypeInfo->pLLVMInitFn = nullptr;
 		m_pTypeInfo->pLLVMFiniFn = nullptr;
 		m_pTypeInfo->pLLVMCopyFn = nullptr;
@@ -217,6 +233,16 @@ namespace Tenshi { namespace Compiler {
 		}
 		g_Prog->PopScope();
 
+		// Columns are split apart per field, so every field must be plain data
+		if( m_pTypeInfo->bIsSoA ) {
+			for( const SMemberInfo &Member : m_pTypeInfo->Members ) {
+				if( Member.Type.BuiltinType == EBuiltinType::UserDefined || !IsTrivial( Member.Type.BuiltinType ) ) {
+					m_pSoATok->Error( "SOA types can only have fields of plain built-in types (\"" + Member.Name + "\" is not)" );
+					return false;
+				}
+			}
+		}
+
 		AX_ASSERT_NOT_NULL( m_pTypeInfo );
 		Ax::uintptr uFieldIndex = 0;
 		for( CUDTField *const pField : m_Fields ) {
@@ -251,6 +277,35 @@ namespace Tenshi { namespace Compiler {
 
 		return pFunc;
 	}
+	// Retrieve an instance parameter of one of the RTTI functions
+	static llvm::Value *GetInstanceArg( llvm::IRBuilder<> &IRBuilder, llvm::Function *pFunc, unsigned uArg, llvm::Type *pStructTy )
+	{
+		AX_ASSERT_NOT_NULL( pFunc );
+		AX_ASSERT( uArg < pFunc->arg_size() );
+
+		llvm::Function::arg_iterator Arg = pFunc->arg_begin();
+		for( unsigned i = 0; i < uArg; ++i ) {
+			++Arg;
+		}
+
+		return IRBuilder.CreatePointerCast( &*Arg, pStructTy->getPointerTo() );
+	}
+	// Call one of the RTTI functions of a field's type directly
+	static void CallFieldFn( llvm::IRBuilder<> &IRBuilder, llvm::Function *pFieldFn, llvm::Value *pDst, llvm::Value *pSrc = nullptr )
+	{
+		AX_ASSERT_NOT_NULL( pFieldFn );
+		AX_ASSERT_NOT_NULL( pDst );
+
+		llvm::FunctionType *const pFTy = pFieldFn->getFunctionType();
+
+		llvm::Value *const pArgs[] = {
+			llvm::Constant::getNullValue( pFTy->getParamType( 0 ) ),
+			IRBuilder.CreatePointerCast( pDst, pFTy->getParamType( 1 ) ),
+			pSrc != nullptr ? IRBuilder.CreatePointerCast( pSrc, pFTy->getParamType( 2 ) ) : nullptr
+		};
+
+		IRBuilder.CreateCall( pFieldFn, llvm::ArrayRef< llvm::Value * >( pArgs, pSrc != nullptr ? 3 : 2 ) );
+	}
 
 	bool CUserDefinedType::CodeGen()
 	{
@@ -302,11 +357,35 @@ namespace Tenshi { namespace Compiler {
 		AX_EXPECT_MEMORY( CopyName.Append( "Copy" ) );
 		AX_EXPECT_MEMORY( MoveName.Append( "Move" ) );
 
+		//
+		//	Each operation is generated for the type directly (rather than
+		//	walking the type's pattern at runtime) so the fields of the type are
+		//	handled inline. Everything trivial is done with one memset/memcpy of
+		//	the whole instance and only the fields owning memory are visited.
+		//
+
+		const SInternalFunctions &IntFns = CG->InternalFuncs();
+		llvm::Type *const pStructTy = m_pTypeInfo->pLLVMTy;
+		llvm::Value *const pSize = llvm::ConstantExpr::getSizeOf( pStructTy );
+
 		// Constructor
 		if( !m_pTypeInfo->bIsInitTrivial ) {
 			m_pTypeInfo->pLLVMInitFn =
 				BeginFunc( Builder, CG->GetObjInitFnTy(), LLVMStr( InitName ) );
 
+			llvm::Value *const pInst = GetInstanceArg( Builder, m_pTypeInfo->pLLVMInitFn, 1, pStructTy );
+			Builder.CreateMemSet( pInst, Builder.getInt8( 0 ), pSize, 1 );
+
+			for( const SMemberInfo &Member : m_pTypeInfo->Members ) {
+				const STypeInfo *const pFieldUDT = Member.Type.pCustomType;
+				if( Member.Type.BuiltinType != EBuiltinType::UserDefined || pFieldUDT->bIsInitTrivial ) {
+					continue;
+				}
+
+				llvm::Value *const pField = Builder.CreateStructGEP( pStructTy, pInst, ( unsigned )Member.iFieldIndex );
+				CallFieldFn( Builder, pFieldUDT->pLLVMInitFn, pField );
+			}
+
 			llvm::ConstantInt *const pRetVal =
 				llvm::ConstantInt::get
 				(
@@ -323,6 +402,33 @@ namespace Tenshi { namespace Compiler {
 			m_pTypeInfo->pLLVMFiniFn =
 				BeginFunc( Builder, CG->GetObjFiniFnTy(), LLVMStr( FiniName ) );
 
+			llvm::Value *const pInst = GetInstanceArg( Builder, m_pTypeInfo->pLLVMFiniFn, 1, pStructTy );
+
+			for( const SMemberInfo &Member : m_pTypeInfo->Members ) {
+				const STypeInfo *const pFieldUDT = Member.Type.pCustomType;
+				llvm::Value *pField = nullptr;
+
+				switch( Member.Type.BuiltinType ) {
+				case EBuiltinType::StringObject:
+					pField = Builder.CreateStructGEP( pStructTy, pInst, ( unsigned )Member.iFieldIndex );
+					Builder.CreateCall( IntFns.pStrReclaim, Builder.CreateLoad( pField ) );
+					break;
+				case EBuiltinType::ArrayObject:
+					pField = Builder.CreateStructGEP( pStructTy, pInst, ( unsigned )Member.iFieldIndex );
+					Builder.CreateCall( IntFns.pArrayUndim, Builder.CreatePointerCast( Builder.CreateLoad( pField ), Builder.getInt8PtrTy() ) );
+					break;
+				case EBuiltinType::UserDefined:
+					if( !pFieldUDT->bIsFiniTrivial ) {
+						pField = Builder.CreateStructGEP( pStructTy, pInst, ( unsigned )Member.iFieldIndex );
+						CallFieldFn( Builder, pFieldUDT->pLLVMFiniFn, pField );
+					}
+					break;
+				default:
+					// FIXME: Lists and trees (once supported)
+					break;
+				}
+			}
+
 			Builder.CreateRetVoid();
 		}
 
@@ -331,6 +437,49 @@ namespace Tenshi { namespace Compiler {
 			m_pTypeInfo->pLLVMCopyFn =
 				BeginFunc( Builder, CG->GetObjCopyFnTy(), LLVMStr( CopyName ) );
 
+			llvm::Value *const pDst = GetInstanceArg( Builder, m_pTypeInfo->pLLVMCopyFn, 1, pStructTy );
+			llvm::Value *const pSrc = GetInstanceArg( Builder, m_pTypeInfo->pLLVMCopyFn, 2, pStructTy );
+
+			// Copy everything, then make deep copies of anything owned
+			Builder.CreateMemCpy( pDst, pSrc, pSize, 1 );
+
+			for( const SMemberInfo &Member : m_pTypeInfo->Members ) {
+				const STypeInfo *const pFieldUDT = Member.Type.pCustomType;
+				const unsigned uField = ( unsigned )Member.iFieldIndex;
+
+				switch( Member.Type.BuiltinType ) {
+				case EBuiltinType::StringObject:
+					Builder.CreateStore
+					(
+						Builder.CreateCall( IntFns.pStrDup, Builder.CreateLoad( Builder.CreateStructGEP( pStructTy, pSrc, uField ) ) ),
+						Builder.CreateStructGEP( pStructTy, pDst, uField )
+					);
+					break;
+				case EBuiltinType::ArrayObject:
+					{
+						llvm::Value *const pDstField = Builder.CreateStructGEP( pStructTy, pDst, uField );
+						llvm::Value *const pSrcArr = Builder.CreateLoad( Builder.CreateStructGEP( pStructTy, pSrc, uField ) );
+						llvm::Value *const pNewArr = Builder.CreateCall( IntFns.pArrayCopy, Builder.CreatePointerCast( pSrcArr, Builder.getInt8PtrTy() ) );
+
+						Builder.CreateStore( Builder.CreatePointerCast( pNewArr, pSrcArr->getType() ), pDstField );
+					}
+					break;
+				case EBuiltinType::UserDefined:
+					if( !pFieldUDT->bIsCopyTrivial ) {
+						CallFieldFn
+						(
+							Builder, pFieldUDT->pLLVMCopyFn,
+							Builder.CreateStructGEP( pStructTy, pDst, uField ),
+							Builder.CreateStructGEP( pStructTy, pSrc, uField )
+						);
+					}
+					break;
+				default:
+					// FIXME: Lists and trees (once supported)
+					break;
+				}
+			}
+
 			Builder.CreateRetVoid();
 		}
 
@@ -339,9 +488,22 @@ namespace Tenshi { namespace Compiler {
 			m_pTypeInfo->pLLVMMoveFn =
 				BeginFunc( Builder, CG->GetObjMoveFnTy(), LLVMStr( MoveName ) );
 
+			llvm::Value *const pDst = GetInstanceArg( Builder, m_pTypeInfo->pLLVMMoveFn, 1, pStructTy );
+			llvm::Value *const pSrc = GetInstanceArg( Builder, m_pTypeInfo->pLLVMMoveFn, 2, pStructTy );
+
+			// Owned memory is only ever referenced through pointers, so taking
+			// the bytes and nulling the source moves every field
+			Builder.CreateMemCpy( pDst, pSrc, pSize, 1 );
+			Builder.CreateMemSet( pSrc, Builder.getInt8( 0 ), pSize, 1 );
+
 			Builder.CreateRetVoid();
 		}
 
+		if( m_pTypeInfo->bIsSoA ) {
+			CG->LayoutColumns( *m_pTypeInfo );
+		}
+
+		CG->EmitTypeDescriptor( *m_pTypeInfo );
 		CG->RegisterUDT( *m_pTypeInfo );
 
 		return true;
@@ -377,6 +539,8 @@ namespace Tenshi { namespace Compiler {
 	}
 	CUDTField::~CUDTField()
 	{
+		delete m_pType;
+		m_pType = nullptr;
 	}
 
 	Ax::String CUDTField::ToString() const
@@ -441,7 +605,8 @@ namespace Tenshi { namespace Compiler {
 		} else {
 			const bool bIsTrivial = IsTrivial( Info.Type.BuiltinType );
 
-			DstInfo.bIsInitTrivial &= bIsTrivial;
+			// Every built-in type starts out as zero (strings and arrays are
+			// null) so initialization never depends on the field
 			DstInfo.bIsFiniTrivial &= bIsTrivial;
 			DstInfo.bIsCopyTrivial &= bIsTrivial;
 			DstInfo.bIsMoveTrivial &= bIsTrivial;
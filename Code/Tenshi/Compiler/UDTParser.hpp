@@ -13,6 +13,8 @@ namespace Tenshi { namespace Compiler {
 	class CUserDefinedType
 	{
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		CUserDefinedType( const SToken &Tok, CParser &Parser );
 		~CUserDefinedType();
 
@@ -32,6 +34,7 @@ namespace Tenshi { namespace Compiler {
 		CLexer &					m_Lexer;
 		const SToken *				m_pNameTok;
 		const SToken *				m_pEndtypeTok;
+		const SToken *				m_pSoATok;
 		STypeInfo *					m_pTypeInfo;
 		Ax::TArray< CUDTField * >	m_Fields;
 		struct
@@ -46,6 +49,8 @@ namespace Tenshi { namespace Compiler {
 	{
 	friend class CUserDefinedType;
 	public:
+		TENSHI_MEMTAG_ALLOCS(kMemtag_AST)
+
 		CUDTField( const SToken &Tok, CParser &Parser );
 		~CUDTField();
 
@@ -0,0 +1,259 @@
+#include "_PCH.hpp"
+#include "Watch.hpp"
+#include "Module.hpp"
+#include "Project.hpp"
+
+#ifdef __linux__
+# include <errno.h>
+# include <poll.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/inotify.h>
+#endif
+
+namespace Tenshi { namespace Compiler {
+
+	/*
+		Editors tend to save in bursts (write a temporary, rename it over the
+		original, touch a backup) so changes are collected until nothing has
+		happened for this long before rebuilding.
+	*/
+	static const int kDebounceMillisecs = 100;
+
+	MWatcher &MWatcher::GetInstance()
+	{
+		static MWatcher instance;
+		return instance;
+	}
+
+	MWatcher::MWatcher()
+	{
+	}
+	MWatcher::~MWatcher()
+	{
+	}
+
+#ifdef __linux__
+	// A directory being watched
+	struct SWatchDir
+	{
+		// Watch descriptor from inotify
+		int							Wd;
+		// Path to the directory (ending with a slash)
+		Ax::String					Path;
+		// Whether module declarations or libraries are found here
+		bool						bModules;
+	};
+
+	// The changes collected since the last rebuild
+	struct SWatchChanges
+	{
+		// Number of source files that changed
+		unsigned					cSources;
+		// Whether a module library changed (needs relinking)
+		bool						bModules;
+		// Whether a module's declarations changed (can't be picked up)
+		bool						bDeclarations;
+	};
+
+	static bool AddWatch( int Fd, Ax::TArray< SWatchDir > &Dirs, const Ax::String &Path, bool bModules )
+	{
+		Ax::String DirPath;
+		AX_EXPECT_MEMORY( DirPath.Assign( Path.IsEmpty() ? "./" : Path.CString() ) );
+		if( !DirPath.EndsWith( "/" ) ) {
+			AX_EXPECT_MEMORY( DirPath.Append( '/' ) );
+		}
+
+		for( SWatchDir &Dir : Dirs ) {
+			if( Dir.Path == DirPath ) {
+				Dir.bModules |= bModules;
+				return true;
+			}
+		}
+
+		const int Wd = inotify_add_watch( Fd, DirPath, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE );
+		if( Wd < 0 ) {
+			Ax::Warnf( DirPath, "Could not watch directory: %s", strerror( errno ) );
+			return false;
+		}
+
+		AX_EXPECT_MEMORY( Dirs.Append() );
+		SWatchDir &Dir = Dirs.Last();
+
+		Dir.Wd = Wd;
+		AX_EXPECT_MEMORY( Dir.Path.Assign( DirPath ) );
+		Dir.bModules = bModules;
+
+		return true;
+	}
+
+	static const SWatchDir *FindWatch( const Ax::TArray< SWatchDir > &Dirs, int Wd )
+	{
+		for( const SWatchDir &Dir : Dirs ) {
+			if( Dir.Wd == Wd ) {
+				return &Dir;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// Read the pending events, noting what they mean for the next build
+	static bool ReadEvents( int Fd, const Ax::TArray< SWatchDir > &Dirs, SWatchChanges &Changes )
+	{
+		alignas( inotify_event ) char Buffer[ 4096 ];
+
+		const ssize_t cRead = read( Fd, Buffer, sizeof( Buffer ) );
+		if( cRead < 0 ) {
+			return errno == EINTR || errno == EAGAIN;
+		}
+
+		Ax::String Filename;
+		for( const char *p = Buffer; p < Buffer + cRead; ) {
+			const inotify_event &Event = *( const inotify_event * )p;
+			p += sizeof( inotify_event ) + Event.len;
+
+			const SWatchDir *const pDir = FindWatch( Dirs, Event.wd );
+			if( !pDir || !Event.len ) {
+				continue;
+			}
+
+			AX_EXPECT_MEMORY( Filename.Assign( pDir->Path ) );
+			AX_EXPECT_MEMORY( Filename.Append( Event.name ) );
+
+			if( Projects->InvalidateSource( Filename ) ) {
+				Ax::g_VerboseLog( Filename ) += "Changed";
+				++Changes.cSources;
+				continue;
+			}
+
+			if( !pDir->bModules ) {
+				continue;
+			}
+
+			if( Filename.CaseEndsWith( ".commands" ) ) {
+				Changes.bDeclarations = true;
+			} else {
+				Changes.bModules = true;
+			}
+		}
+
+		return true;
+	}
+
+	// Wait for a change, then keep collecting until things settle down
+	static bool WaitForChanges( int Fd, const Ax::TArray< SWatchDir > &Dirs, SWatchChanges &Changes )
+	{
+		pollfd Poll;
+
+		Poll.fd = Fd;
+		Poll.events = POLLIN;
+		Poll.revents = 0;
+
+		int Timeout = -1;
+		for(;;) {
+			const int r = poll( &Poll, 1, Timeout );
+			if( r < 0 ) {
+				if( errno == EINTR ) {
+					continue;
+				}
+
+				return false;
+			}
+
+			if( !r ) {
+				return true;
+			}
+
+			if( !ReadEvents( Fd, Dirs, Changes ) ) {
+				return false;
+			}
+
+			if( Changes.cSources > 0 || Changes.bModules || Changes.bDeclarations ) {
+				Timeout = kDebounceMillisecs;
+			}
+		}
+	}
+#endif
+
+	bool MWatcher::Run()
+	{
+#ifndef __linux__
+		Ax::BasicErrorf( "Watch mode is not supported on this platform" );
+		return false;
+#else
+		Ax::TArray< Ax::String > Sources;
+		Projects->GetSourceFiles( Sources );
+
+		if( Sources.IsEmpty() ) {
+			Ax::BasicErrorf( "No source files to watch" );
+			return false;
+		}
+
+		const int Fd = inotify_init1( IN_CLOEXEC );
+		if( Fd < 0 ) {
+			Ax::BasicErrorf( "Could not initialize inotify: %s", strerror( errno ) );
+			return false;
+		}
+
+		Ax::TArray< SWatchDir > Dirs;
+
+		for( const Ax::String &Source : Sources ) {
+			AddWatch( Fd, Dirs, Source.ExtractDirectory(), false );
+		}
+
+		// Module directories are loaded recursively, but inotify isn't
+		for( const Ax::String &ModDir : Mods->Directories() ) {
+			AddWatch( Fd, Dirs, ModDir, true );
+
+			Ax::System::CFileList Files;
+			if( !Ax::System::EnumFileTree( Files, ModDir ) ) {
+				continue;
+			}
+
+			for( Ax::uintptr i = 0; i < Files.Num(); ++i ) {
+				AddWatch( Fd, Dirs, Ax::String( Files.GetFile( i ) ).ExtractDirectory(), true );
+			}
+		}
+
+		if( Dirs.IsEmpty() ) {
+			close( Fd );
+			return false;
+		}
+
+		Ax::BasicStatusf( "Watching %u file%s for changes", ( unsigned )Sources.Num(), Sources.Num() == 1 ? "" : "s" );
+
+		bool bResult = true;
+		for(;;) {
+			SWatchChanges Changes = { 0, false, false };
+
+			if( !WaitForChanges( Fd, Dirs, Changes ) ) {
+				Ax::BasicErrorf( "Could not read file changes: %s", strerror( errno ) );
+				bResult = false;
+				break;
+			}
+
+			if( Changes.bDeclarations ) {
+				Ax::g_WarningLog += "Module declarations changed; restart to pick them up";
+			}
+
+			if( !Changes.cSources && !Changes.bModules ) {
+				continue;
+			}
+
+			const Ax::uint64 uStartMicrosecs = Ax::System::Microseconds();
+			const bool bBuilt = Projects->Build();
+			const Ax::uint64 uEndMicrosecs = Ax::System::Microseconds();
+
+			Ax::BasicStatusf( "%s (%u changed file%s) in %.3f ms",
+				bBuilt ? "Rebuilt" : "Rebuild failed",
+				Changes.cSources, Changes.cSources == 1 ? "" : "s",
+				double( uEndMicrosecs - uStartMicrosecs )/1000.0 );
+		}
+
+		close( Fd );
+		return bResult;
+#endif
+	}
+
+}}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Core/Manager.hpp>
+
+namespace Tenshi { namespace Compiler {
+
+	/*
+	===========================================================================
+
+		WATCHER
+
+		Watches the source files of the loaded projects along with the module
+		directories, then rebuilds whenever they change. Only the units whose
+		sources changed are compiled again; everything else (module tables,
+		object files from the last build) is reused before relinking.
+
+	===========================================================================
+	*/
+	class MWatcher
+	{
+	public:
+		static MWatcher &GetInstance();
+
+		// Rebuild the loaded projects as their files change (only returns on
+		// failure)
+		bool Run();
+
+	private:
+		MWatcher();
+		~MWatcher();
+
+		AX_DELETE_COPYFUNCS(MWatcher);
+	};
+	static Ax::TManager<MWatcher>	Watcher;
+
+}}
@@ -44,6 +44,7 @@ EXPORT int teSafeSync( void )
 {
 	return 1;
 }
+EXPORT int teSyncCountdown = 1024;
 
 EXPORT void DbgTrace_( const char *file, unsigned int line, const char *func,
 const char *format, ... )
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Builds PGOBench without a profile, then with one gathered from a training
+# run, and runs both so their times can be compared. Needs llvm-profdata (from
+# the same LLVM the compiler was built against) and the compiler on the PATH
+# as "Tenshi" (or set TENSHI).
+#
+# All three builds are optimized (-O); the instrumented and profile-guided
+# builds have to agree on that, or the profile won't match the program.
+#
+
+TENSHI="${TENSHI:-Tenshi}"
+PROFDATA="${PROFDATA:-llvm-profdata}"
+
+set -e
+cd "$(dirname "$0")"
+
+echo "== Plain build"
+"$TENSHI" -O -o "PGO Bench" PGOBench.teproj
+"./PGO Bench"
+
+echo "== Training run"
+rm -f PGOBench.profraw
+"$TENSHI" -O --profile-generate -o "PGO Bench" PGOBench.teproj
+LLVM_PROFILE_FILE=PGOBench.profraw "./PGO Bench"
+"$PROFDATA" merge -o PGOBench.profdata PGOBench.profraw
+
+echo "== Profile-guided build"
+"$TENSHI" -O --profile-use=PGOBench.profdata -o "PGO Bench" PGOBench.teproj
+"./PGO Bench"
@@ -0,0 +1,62 @@
+/*
+	Shared by the runtime benchmarks. Each benchmark is one file, linked
+	with TenshiRuntime.c by bench.sh; it stands in for the compiled program
+	by defining TenshiMain, and this defines the (empty) module and type
+	tables the compiler would otherwise emit.
+*/
+
+#ifndef TENSHI_BENCH_H
+#define TENSHI_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TENSHI_STATIC_LINK_ENABLED  1
+#include "../TenshiRuntime.h"
+
+const char *                        tenshi__modNames__[ 1 ];
+void *                              tenshi__modInits__[ 1 ];
+void *                              tenshi__modFinis__[ 1 ];
+TenshiUIntPtr_t *                   tenshi__modStates__[ 1 ];
+TenshiUIntPtr_t                     tenshi__numMods__ = 0;
+TenshiType_t                        tenshi__types__[ 1 ];
+TenshiUInt32_t                      tenshi__numTypes__ = 0;
+
+static TenshiUInt32_t g_Seed = 2463534242U;
+
+static TenshiUInt32_t NextRand( void )
+{
+	g_Seed ^= g_Seed << 13;
+	g_Seed ^= g_Seed >> 17;
+	g_Seed ^= g_Seed << 5;
+
+	return g_Seed;
+}
+
+/* wall time since uStart (a tePerfTimer reading), so parallel work counts once */
+static double Seconds( TenshiUInt64_t uStart )
+{
+	return ( double )( tePerfTimer() - uStart )/1000000.0;
+}
+
+static int g_cFailures = 0;
+
+#define CHECK(Expr_)\
+	do {\
+		if( !( Expr_ ) ) {\
+			fprintf( stderr, "%s(%i): check failed: %s\n", __FILE__, __LINE__, #Expr_ );\
+			++g_cFailures;\
+		}\
+	} while( 0 )
+
+/* exit with a failure status if any CHECK failed */
+static void FinishChecks( void )
+{
+	if( g_cFailures > 0 ) {
+		fprintf( stderr, "%i check%s failed\n", g_cFailures, g_cFailures == 1 ? "" : "s" );
+		exit( EXIT_FAILURE );
+	}
+}
+
+#endif
@@ -0,0 +1,585 @@
+/*
+	Times ARRAY FILL, ARRAY COPY, ARRAY SUM, ARRAY MIN and ARRAY FIND
+	against the loops a Tenshi program would otherwise write, after checking
+	them against those same loops for every kind of item, over clipped and
+	overlapping ranges, and with NaNs and null strings in the way. Sizes on
+	either side of BULK_PARALLEL_MIN cover both the single thread and the
+	parallel paths.
+
+	Run with "bench.sh Bulk".
+*/
+
+#include "Bench.h"
+
+#include <math.h>
+
+#ifndef BENCH_ITEMS
+# define BENCH_ITEMS                ( 1<<23 )
+#endif
+#ifndef BENCH_ROUNDS
+# define BENCH_ROUNDS               8
+#endif
+
+typedef struct Triple_s {
+	TenshiInt32_t                   x, y, z;
+} Triple_t;
+
+static void *DimArray( TenshiUIntPtr_t cItems, TenshiUIntPtr_t cItemBytes, TenshiType_t *pItemType )
+{
+	memset( ( void * )pItemType, 0, sizeof( *pItemType ) );
+	pItemType->Flags = kTenshiTypeF_FullTrivial;
+	pItemType->cBytes = cItemBytes;
+
+	return teArrayDim( &cItems, 1, pItemType );
+}
+
+static int CompareStrings( const char *a, const char *b )
+{
+	return strcmp( a != NULL ? a : "", b != NULL ? b : "" );
+}
+
+static void CheckFillAndCopy( TenshiUIntPtr_t cItems )
+{
+	TenshiType_t ItemType, OtherType;
+	TenshiInt32_t *pInts;
+	TenshiInt32_t *pCopy;
+	TenshiInt32_t *pExpected;
+	Triple_t *pTriples;
+	Triple_t Value;
+	TenshiUIntPtr_t uFirst;
+	TenshiUIntPtr_t cFill;
+	TenshiUIntPtr_t i;
+
+	pInts = ( TenshiInt32_t * )DimArray( cItems, sizeof( *pInts ), &ItemType );
+	pCopy = ( TenshiInt32_t * )DimArray( cItems, sizeof( *pCopy ), &OtherType );
+	pExpected = ( TenshiInt32_t * )malloc( cItems*sizeof( *pExpected ) );
+
+	for( i = 0; i < cItems; ++i ) {
+		pInts[ i ] = ( TenshiInt32_t )i;
+	}
+
+	/* a range running past the end stops at it */
+	uFirst = cItems/3;
+	cFill = cItems;
+	teArrayFill( ( void * )pInts, &( TenshiInt32_t ){ -7 }, uFirst, cFill );
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( pInts[ i ] == ( i < uFirst ? ( TenshiInt32_t )i : -7 ) );
+	}
+	teArrayFill( ( void * )pInts, &( TenshiInt32_t ){ 0 }, 0, TENSHI_ARRAY_INVALID_INDEX );
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( pInts[ i ] == 0 );
+	}
+	teArrayFill( ( void * )pInts, &( TenshiInt32_t ){ 1 }, cItems, 10 );
+	CHECK( pInts[ cItems - 1 ] == 0 );
+
+	/* into another array, then over itself both ways */
+	for( i = 0; i < cItems; ++i ) {
+		pInts[ i ] = ( TenshiInt32_t )NextRand();
+	}
+	teArrayCopyItems( ( void * )pCopy, 0, ( const void * )pInts, 0, TENSHI_ARRAY_INVALID_INDEX );
+	CHECK( memcmp( ( const void * )pCopy, ( const void * )pInts, cItems*sizeof( *pInts ) ) == 0 );
+
+	memcpy( ( void * )pExpected, ( const void * )pInts, cItems*sizeof( *pInts ) );
+	memmove( ( void * )( pExpected + cItems/4 ), ( const void * )pExpected, ( cItems - cItems/4 )*sizeof( *pInts ) );
+	teArrayCopyItems( ( void * )pInts, cItems/4, ( const void * )pInts, 0, cItems );
+	CHECK( memcmp( ( const void * )pExpected, ( const void * )pInts, cItems*sizeof( *pInts ) ) == 0 );
+
+	memmove( ( void * )pExpected, ( const void * )( pExpected + cItems/2 ), ( cItems - cItems/2 )*sizeof( *pInts ) );
+	teArrayCopyItems( ( void * )pInts, 0, ( const void * )pInts, cItems/2, cItems );
+	CHECK( memcmp( ( const void * )pExpected, ( const void * )pInts, cItems*sizeof( *pInts ) ) == 0 );
+
+	teArrayUndim( ( void * )pCopy );
+	teArrayUndim( ( void * )pInts );
+	free( ( void * )pExpected );
+
+	/* items that aren't a power of two in size, or a repeated byte */
+	pTriples = ( Triple_t * )DimArray( cItems, sizeof( *pTriples ), &ItemType );
+	Value.x = 1;
+	Value.y = -2;
+	Value.z = 3;
+	teArrayFill( ( void * )pTriples, &Value, 1, cItems - 2 );
+	for( i = 1; i + 1 < cItems; ++i ) {
+		CHECK( memcmp( ( const void * )&pTriples[ i ], ( const void * )&Value, sizeof( Value ) ) == 0 );
+	}
+	if( cItems > 1 ) {
+		CHECK( pTriples[ 0 ].x == 0 && pTriples[ cItems - 1 ].z == 0 );
+	}
+	teArrayUndim( ( void * )pTriples );
+}
+
+/* with the item type a program's STRING arrays have */
+static void CheckStringItems( TenshiUIntPtr_t cItems )
+{
+	TenshiUIntPtr_t cDims;
+	char **ppStrs;
+	char **ppCopy;
+	char *pszValue;
+	TenshiUIntPtr_t i;
+
+	cDims = cItems;
+	ppStrs = ( char ** )teArrayDim( &cDims, 1, TENSHI_TYPE_STRING );
+	ppCopy = ( char ** )teArrayDim( &cDims, 1, TENSHI_TYPE_STRING );
+
+	/*
+		each item gets its own copy and the old ones are released; the value
+		is a temporary, reclaimed right after the call as a program does
+	*/
+	pszValue = teStrDup( "filled" );
+	teArrayFill( ( void * )ppStrs, ( const void * )&pszValue, 0, cItems );
+	teArrayFill( ( void * )ppStrs, ( const void * )&pszValue, 0, cItems );
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( ppStrs[ i ] != NULL && ppStrs[ i ] != pszValue );
+		CHECK( i == 0 || ppStrs[ i ] != ppStrs[ i - 1 ] );
+	}
+	teStrReclaim( pszValue );
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( strcmp( ppStrs[ i ], "filled" ) == 0 );
+	}
+
+	/* the value can be an item being replaced */
+	teStrReclaim( ppStrs[ 0 ] );
+	ppStrs[ 0 ] = teStrDup( "first" );
+	teArrayFill( ( void * )ppStrs, ( const void * )&ppStrs[ 0 ], 0, cItems );
+	CHECK( strcmp( ppStrs[ cItems - 1 ], "first" ) == 0 );
+
+	for( i = 0; i < cItems; ++i ) {
+		teStrReclaim( ppStrs[ i ] );
+		ppStrs[ i ] = i % 5 != 0 ? teStr_Bin( ( TenshiUInt32_t )i ) : NULL;
+	}
+	teArrayCopyItems( ( void * )ppCopy, 0, ( const void * )ppStrs, 0, cItems );
+	teArrayCopyItems( ( void * )ppStrs, 1, ( const void * )ppStrs, 0, cItems );
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( CompareStrings( ppStrs[ i ], ppCopy[ i > 0 ? i - 1 : 0 ] ) == 0 );
+		CHECK( ppCopy[ i ] == NULL || ppCopy[ i ] != ppStrs[ i ] );
+	}
+
+	/* assigning to an item of one array leaves the other's alone */
+	for( i = 0; i < cItems; ++i ) {
+		teStrReclaim( ppStrs[ i ] );
+		ppStrs[ i ] = teStrDup( "reassigned" );
+	}
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( ppCopy[ i ] == NULL || strcmp( ppCopy[ i ], "reassigned" ) != 0 );
+	}
+
+	teArrayUndim( ( void * )ppCopy );
+	teArrayUndim( ( void * )ppStrs );
+}
+
+/* what a program's STRING arrays (and UDT copies of array fields) do */
+static void CheckStringArrays( void )
+{
+	TenshiUIntPtr_t Dims[ 2 ];
+	char **ppStrs;
+	char **ppCopy;
+	char Expected[ 16 ];
+	TenshiUIntPtr_t x, y;
+
+	Dims[ 0 ] = 4;
+	Dims[ 1 ] = 3;
+	ppStrs = ( char ** )teArrayDim( Dims, 2, TENSHI_TYPE_STRING );
+	for( y = 0; y < 3; ++y ) {
+		for( x = 0; x < 4; ++x ) {
+			CHECK( ppStrs[ y*4 + x ] == NULL );
+			sprintf( Expected, "%u,%u", ( unsigned )x, ( unsigned )y );
+			ppStrs[ y*4 + x ] = teStrDup( Expected );
+		}
+	}
+
+	/* each copy owns its strings */
+	ppCopy = ( char ** )teArrayCopy( ( const void * )ppStrs );
+	for( x = 0; x < 12; ++x ) {
+		CHECK( ppCopy[ x ] != ppStrs[ x ] && strcmp( ppCopy[ x ], ppStrs[ x ] ) == 0 );
+	}
+	teArrayUndim( ( void * )ppStrs );
+
+	/* items keep their place in each dimension; new ones are empty */
+	Dims[ 0 ] = 2;
+	Dims[ 1 ] = 5;
+	ppCopy = ( char ** )teArrayRedim( ( void * )ppCopy, Dims, 2, TENSHI_TYPE_STRING );
+	for( y = 0; y < 5; ++y ) {
+		for( x = 0; x < 2; ++x ) {
+			if( y < 3 ) {
+				sprintf( Expected, "%u,%u", ( unsigned )x, ( unsigned )y );
+				CHECK( ppCopy[ y*2 + x ] != NULL && strcmp( ppCopy[ y*2 + x ], Expected ) == 0 );
+			} else {
+				CHECK( ppCopy[ y*2 + x ] == NULL );
+			}
+		}
+	}
+
+	Dims[ 0 ] = 3;
+	ppCopy = ( char ** )teArrayRedim( ( void * )ppCopy, Dims, 1, TENSHI_TYPE_STRING );
+	CHECK( strcmp( ppCopy[ 0 ], "0,0" ) == 0 && strcmp( ppCopy[ 1 ], "1,0" ) == 0 && ppCopy[ 2 ] == NULL );
+	teArrayUndim( ( void * )ppCopy );
+}
+
+static void CheckReduce( TenshiUIntPtr_t cItems, char ( *pNames )[ 16 ] )
+{
+	TenshiType_t ItemType;
+	TenshiInt32_t *pInts;
+	TenshiUInt16_t *pShorts;
+	TenshiInt64_t *pLongs;
+	float *pFloats;
+	double *pDoubles;
+	const char **ppStrs;
+	TenshiInt64_t iSum, iResult;
+	TenshiUInt64_t uSum, uResult;
+	TenshiInt32_t iMin, iMax, iValue;
+	TenshiUInt16_t uMax, uShortResult;
+	double Sum, Result;
+	float fMin, fMax, fResult;
+	const char *pszMin;
+	const char *pszMax;
+	char *pszResult;
+	TenshiUIntPtr_t uAt;
+	TenshiUIntPtr_t i;
+
+	/* int32, with the SSE2 kernels */
+	pInts = ( TenshiInt32_t * )DimArray( cItems, sizeof( *pInts ), &ItemType );
+	iSum = 0;
+	iMin = 0x7FFFFFFF;
+	iMax = -0x7FFFFFFF - 1;
+	for( i = 0; i < cItems; ++i ) {
+		pInts[ i ] = ( TenshiInt32_t )NextRand();
+		iSum += pInts[ i ];
+		iMin = pInts[ i ] < iMin ? pInts[ i ] : iMin;
+		iMax = pInts[ i ] > iMax ? pInts[ i ] : iMax;
+	}
+	teArrayReduce( ( const void * )pInts, kTenshiSortKey_Int32, kTenshiArrayReduce_Sum, ( void * )&iResult );
+	CHECK( iResult == iSum );
+	teArrayReduce( ( const void * )pInts, kTenshiSortKey_Int32, kTenshiArrayReduce_Min, ( void * )&iValue );
+	CHECK( iValue == iMin );
+	teArrayReduce( ( const void * )pInts, kTenshiSortKey_Int32, kTenshiArrayReduce_Max, ( void * )&iValue );
+	CHECK( iValue == iMax );
+
+	/* the first match, from where the search starts */
+	uAt = NextRand() % cItems;
+	iValue = pInts[ uAt ];
+	for( i = 0; pInts[ i ] != iValue; ++i ) {
+	}
+	CHECK( teArrayFind( ( const void * )pInts, kTenshiSortKey_Int32, ( const void * )&iValue, 0 ) == ( TenshiIntPtr_t )i );
+	CHECK( teArrayFind( ( const void * )pInts, kTenshiSortKey_Int32, ( const void * )&iValue, uAt ) == ( TenshiIntPtr_t )uAt );
+	pInts[ cItems - 1 ] = 12345;
+	for( i = 0; pInts[ i ] != 12345; ++i ) {
+	}
+	CHECK( teArrayFind( ( const void * )pInts, kTenshiSortKey_Int32, ( const void * )&( TenshiInt32_t ){ 12345 }, 0 ) == ( TenshiIntPtr_t )i );
+	for( i = 0; i < cItems; ++i ) {
+		pInts[ i ] &= ~1;
+	}
+	CHECK( teArrayFind( ( const void * )pInts, kTenshiSortKey_Int32, ( const void * )&( TenshiInt32_t ){ 3 }, 0 ) == -1 );
+	CHECK( teArrayFind( ( const void * )pInts, kTenshiSortKey_Int32, ( const void * )&pInts[ 0 ], cItems ) == -1 );
+	teArrayUndim( ( void * )pInts );
+
+	/* unsigned and 64-bit, with the plain loops */
+	pShorts = ( TenshiUInt16_t * )DimArray( cItems, sizeof( *pShorts ), &ItemType );
+	uSum = 0;
+	uMax = 0;
+	for( i = 0; i < cItems; ++i ) {
+		pShorts[ i ] = ( TenshiUInt16_t )NextRand();
+		uSum += pShorts[ i ];
+		uMax = pShorts[ i ] > uMax ? pShorts[ i ] : uMax;
+	}
+	teArrayReduce( ( const void * )pShorts, kTenshiSortKey_UInt16, kTenshiArrayReduce_Sum, ( void * )&uResult );
+	CHECK( uResult == uSum );
+	teArrayReduce( ( const void * )pShorts, kTenshiSortKey_UInt16, kTenshiArrayReduce_Max, ( void * )&uShortResult );
+	CHECK( uShortResult == uMax );
+	uAt = NextRand() % cItems;
+	for( i = 0; pShorts[ i ] != pShorts[ uAt ]; ++i ) {
+	}
+	CHECK( teArrayFind( ( const void * )pShorts, kTenshiSortKey_UInt16, ( const void * )&pShorts[ uAt ], 0 ) == ( TenshiIntPtr_t )i );
+	teArrayUndim( ( void * )pShorts );
+
+	pLongs = ( TenshiInt64_t * )DimArray( cItems, sizeof( *pLongs ), &ItemType );
+	uSum = 0;
+	for( i = 0; i < cItems; ++i ) {
+		pLongs[ i ] = -( TenshiInt64_t )( ( ( TenshiUInt64_t )NextRand() << 31 ) ^ NextRand() );
+		uSum += ( TenshiUInt64_t )pLongs[ i ];
+	}
+	teArrayReduce( ( const void * )pLongs, kTenshiSortKey_Int64, kTenshiArrayReduce_Sum, ( void * )&uResult );
+	CHECK( uResult == uSum );
+	teArrayReduce( ( const void * )pLongs, kTenshiSortKey_Int64, kTenshiArrayReduce_Max, ( void * )&iResult );
+	CHECK( iResult <= 0 );
+	teArrayUndim( ( void * )pLongs );
+
+	/* floats, with NaNs to skip */
+	pFloats = ( float * )DimArray( cItems, sizeof( *pFloats ), &ItemType );
+	pDoubles = ( double * )DimArray( cItems, sizeof( *pDoubles ), &ItemType );
+	Sum = 0.0;
+	fMin = 1e30f;
+	fMax = -1e30f;
+	for( i = 0; i < cItems; ++i ) {
+		pFloats[ i ] = ( float )( NextRand() % 2001 ) - 1000.0f;
+		pDoubles[ i ] = pFloats[ i ]/8.0;
+		Sum += pFloats[ i ];
+		fMin = pFloats[ i ] < fMin ? pFloats[ i ] : fMin;
+		fMax = pFloats[ i ] > fMax ? pFloats[ i ] : fMax;
+	}
+	teArrayReduce( ( const void * )pFloats, kTenshiSortKey_Float32, kTenshiArrayReduce_Sum, ( void * )&Result );
+	CHECK( Result == Sum );
+	teArrayReduce( ( const void * )pDoubles, kTenshiSortKey_Float64, kTenshiArrayReduce_Sum, ( void * )&Result );
+	CHECK( Result == Sum/8.0 );
+
+	pFloats[ 0 ] = NAN;
+	pDoubles[ 0 ] = NAN;
+	pFloats[ cItems/2 ] = NAN;
+	pDoubles[ cItems/2 ] = NAN;
+	if( cItems > 2 ) {
+		fMin = 1e30f;
+		fMax = -1e30f;
+		for( i = 0; i < cItems; ++i ) {
+			if( !isnan( pFloats[ i ] ) ) {
+				fMin = pFloats[ i ] < fMin ? pFloats[ i ] : fMin;
+				fMax = pFloats[ i ] > fMax ? pFloats[ i ] : fMax;
+			}
+		}
+		teArrayReduce( ( const void * )pFloats, kTenshiSortKey_Float32, kTenshiArrayReduce_Min, ( void * )&fResult );
+		CHECK( fResult == fMin );
+		teArrayReduce( ( const void * )pFloats, kTenshiSortKey_Float32, kTenshiArrayReduce_Max, ( void * )&fResult );
+		CHECK( fResult == fMax );
+		teArrayReduce( ( const void * )pDoubles, kTenshiSortKey_Float64, kTenshiArrayReduce_Min, ( void * )&Result );
+		CHECK( Result == fMin/8.0 );
+		teArrayReduce( ( const void * )pDoubles, kTenshiSortKey_Float64, kTenshiArrayReduce_Max, ( void * )&Result );
+		CHECK( Result == fMax/8.0 );
+
+		for( i = 0; pFloats[ i ] != pFloats[ cItems - 1 ]; ++i ) {
+		}
+		CHECK( teArrayFind( ( const void * )pFloats, kTenshiSortKey_Float32, ( const void * )&pFloats[ cItems - 1 ], 0 ) == ( TenshiIntPtr_t )i );
+		for( i = 0; pDoubles[ i ] != pDoubles[ cItems - 1 ]; ++i ) {
+		}
+		CHECK( teArrayFind( ( const void * )pDoubles, kTenshiSortKey_Float64, ( const void * )&pDoubles[ cItems - 1 ], 0 ) == ( TenshiIntPtr_t )i );
+	}
+	CHECK( teArrayFind( ( const void * )pFloats, kTenshiSortKey_Float32, ( const void * )&( float ){ NAN }, 0 ) == -1 );
+	CHECK( teArrayFind( ( const void * )pDoubles, kTenshiSortKey_Float64, ( const void * )&( double ){ 1.0/16.0 }, 0 ) == -1 );
+
+	/* nothing but NaNs has no minimum */
+	teArrayFill( ( void * )pFloats, ( const void * )&( float ){ NAN }, 0, cItems );
+	teArrayReduce( ( const void * )pFloats, kTenshiSortKey_Float32, kTenshiArrayReduce_Min, ( void * )&fResult );
+	CHECK( fResult == 0.0f );
+	teArrayUndim( ( void * )pDoubles );
+	teArrayUndim( ( void * )pFloats );
+
+	/* strings, null being empty */
+	ppStrs = ( const char ** )DimArray( cItems, sizeof( *ppStrs ), &ItemType );
+	pszMin = pNames[ 0 ];
+	pszMax = pNames[ 0 ];
+	for( i = 0; i < cItems; ++i ) {
+		ppStrs[ i ] = pNames[ i ];
+		pszMin = CompareStrings( ppStrs[ i ], pszMin ) < 0 ? ppStrs[ i ] : pszMin;
+		pszMax = CompareStrings( ppStrs[ i ], pszMax ) > 0 ? ppStrs[ i ] : pszMax;
+	}
+	teArrayReduce( ( const void * )ppStrs, kTenshiSortKey_String, kTenshiArrayReduce_Min, ( void * )&pszResult );
+	CHECK( pszResult != pszMin && CompareStrings( pszResult, pszMin ) == 0 );
+	teStrReclaim( pszResult );
+	teArrayReduce( ( const void * )ppStrs, kTenshiSortKey_String, kTenshiArrayReduce_Max, ( void * )&pszResult );
+	CHECK( CompareStrings( pszResult, pszMax ) == 0 );
+	teStrReclaim( pszResult );
+
+	uAt = NextRand() % cItems;
+	for( i = 0; strcmp( ppStrs[ i ], pNames[ uAt ] ) != 0; ++i ) {
+	}
+	pszMin = pNames[ uAt ];
+	CHECK( teArrayFind( ( const void * )ppStrs, kTenshiSortKey_String, ( const void * )&pszMin, 0 ) == ( TenshiIntPtr_t )i );
+
+	ppStrs[ cItems - 1 ] = NULL;
+	teArrayReduce( ( const void * )ppStrs, kTenshiSortKey_String, kTenshiArrayReduce_Min, ( void * )&pszResult );
+	CHECK( pszResult == NULL );
+	CHECK( teArrayFind( ( const void * )ppStrs, kTenshiSortKey_String, ( const void * )&( const char * ){ "" }, 0 ) == ( TenshiIntPtr_t )( cItems - 1 ) );
+	teArrayUndim( ( void * )ppStrs );
+}
+
+static void CheckBulk( void )
+{
+	static const TenshiUIntPtr_t Sizes[] = { 1, 3, 17, 1000, 524288 + 37, 2000000 };
+	static const TenshiUInt32_t Workers[] = { 1, 3, 4 };
+	static char Names[ 2000000 ][ 16 ];
+	TenshiType_t ItemType;
+	TenshiUInt16_t *pShorts;
+	TenshiInt64_t iResult;
+	TenshiUIntPtr_t i;
+	TenshiUInt32_t w;
+
+	for( i = 0; i < sizeof( Names )/sizeof( Names[ 0 ] ); ++i ) {
+		sprintf( Names[ i ], "n%u", ( unsigned )( NextRand() % 10000000 ) );
+	}
+
+	for( w = 0; w < sizeof( Workers )/sizeof( Workers[ 0 ] ); ++w ) {
+		teSetWorkerCount( Workers[ w ] );
+
+		for( i = 0; i < sizeof( Sizes )/sizeof( Sizes[ 0 ] ); ++i ) {
+			CheckFillAndCopy( Sizes[ i ] );
+			CheckStringItems( Sizes[ i ] < 100000 ? Sizes[ i ] : 100000 );
+			CheckReduce( Sizes[ i ], Names );
+		}
+	}
+	teSetWorkerCount( 0 );
+
+	CheckStringArrays();
+
+	/* items of the wrong type are refused, leaving a zero result */
+	pShorts = ( TenshiUInt16_t * )DimArray( 2, sizeof( *pShorts ), &ItemType );
+	iResult = 99;
+	teArrayReduce( ( const void * )pShorts, kTenshiSortKey_Int64, kTenshiArrayReduce_Sum, ( void * )&iResult );
+	CHECK( iResult == 0 );
+	CHECK( teArrayFind( ( const void * )pShorts, kTenshiSortKey_Int32, ( const void * )&( TenshiInt32_t ){ 0 }, 0 ) == -1 );
+	teArrayUndim( ( void * )pShorts );
+
+	iResult = 99;
+	teArrayReduce( NULL, kTenshiSortKey_Int32, kTenshiArrayReduce_Sum, ( void * )&iResult );
+	CHECK( iResult == 0 );
+}
+
+static void Bench( void )
+{
+	TenshiType_t ItemType;
+	TenshiInt32_t *pInts;
+	TenshiInt32_t *pCopy;
+	float *pFloats;
+	TenshiInt64_t iSum, iResult;
+	TenshiInt32_t iMin, iValue;
+	double Sum, Result;
+	TenshiIntPtr_t iFound;
+	TenshiUInt64_t uStart;
+	TenshiUIntPtr_t i;
+	TenshiUInt32_t r;
+	double LoopFill, BulkFill;
+	double LoopCopy, BulkCopy;
+	double LoopSum, BulkSum;
+	double LoopMin, BulkMin;
+	double LoopFloatSum, BulkFloatSum;
+	double LoopFind, BulkFind;
+
+	pInts = ( TenshiInt32_t * )DimArray( BENCH_ITEMS, sizeof( *pInts ), &ItemType );
+	pCopy = ( TenshiInt32_t * )DimArray( BENCH_ITEMS, sizeof( *pCopy ), &ItemType );
+	pFloats = ( float * )DimArray( BENCH_ITEMS, sizeof( *pFloats ), &ItemType );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( i = 0; i < BENCH_ITEMS; ++i ) {
+			pInts[ i ] = ( TenshiInt32_t )r + 100;
+		}
+	}
+	LoopFill = Seconds( uStart );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		teArrayFill( ( void * )pInts, ( const void * )&( TenshiInt32_t ){ ( TenshiInt32_t )r + 100 }, 0, BENCH_ITEMS );
+	}
+	BulkFill = Seconds( uStart );
+
+	for( i = 0; i < BENCH_ITEMS; ++i ) {
+		pInts[ i ] = ( TenshiInt32_t )( NextRand() >> 4 );
+		pFloats[ i ] = ( float )( NextRand() % 1000 )/16.0f;
+	}
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( i = 0; i < BENCH_ITEMS; ++i ) {
+			pCopy[ i ] = pInts[ i ];
+		}
+	}
+	LoopCopy = Seconds( uStart );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		teArrayCopyItems( ( void * )pCopy, 0, ( const void * )pInts, 0, BENCH_ITEMS );
+	}
+	BulkCopy = Seconds( uStart );
+
+	iSum = 0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( i = 0; i < BENCH_ITEMS; ++i ) {
+			iSum += pCopy[ i ];
+		}
+	}
+	LoopSum = Seconds( uStart );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		teArrayReduce( ( const void * )pInts, kTenshiSortKey_Int32, kTenshiArrayReduce_Sum, ( void * )&iResult );
+		iSum -= iResult;
+	}
+	BulkSum = Seconds( uStart );
+	CHECK( iSum == 0 );
+
+	iMin = 0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		iMin = pInts[ 0 ];
+		for( i = 1; i < BENCH_ITEMS; ++i ) {
+			if( pInts[ i ] < iMin ) {
+				iMin = pInts[ i ];
+			}
+		}
+	}
+	LoopMin = Seconds( uStart );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		teArrayReduce( ( const void * )pInts, kTenshiSortKey_Int32, kTenshiArrayReduce_Min, ( void * )&iValue );
+	}
+	BulkMin = Seconds( uStart );
+	CHECK( iValue == iMin );
+
+	Sum = 0.0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		Sum = 0.0;
+		for( i = 0; i < BENCH_ITEMS; ++i ) {
+			Sum += pFloats[ i ];
+		}
+	}
+	LoopFloatSum = Seconds( uStart );
+
+	Result = 0.0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		teArrayReduce( ( const void * )pFloats, kTenshiSortKey_Float32, kTenshiArrayReduce_Sum, ( void * )&Result );
+	}
+	BulkFloatSum = Seconds( uStart );
+	/* sixteenths add up exactly either way */
+	CHECK( Result == Sum );
+
+	/* a value that isn't there, so every item is looked at */
+	iFound = 0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		iFound = -1;
+		for( i = 0; i < BENCH_ITEMS; ++i ) {
+			if( pInts[ i ] == -1 ) {
+				iFound = ( TenshiIntPtr_t )i;
+				break;
+			}
+		}
+	}
+	LoopFind = Seconds( uStart );
+	CHECK( iFound == -1 );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		iFound = teArrayFind( ( const void * )pInts, kTenshiSortKey_Int32, ( const void * )&( TenshiInt32_t ){ -1 }, 0 );
+	}
+	BulkFind = Seconds( uStart );
+	CHECK( iFound == -1 );
+
+	teArrayUndim( ( void * )pFloats );
+	teArrayUndim( ( void * )pCopy );
+	teArrayUndim( ( void * )pInts );
+
+	printf( "%u items, %u rounds, %u workers\n", ( unsigned )BENCH_ITEMS, ( unsigned )BENCH_ROUNDS, ( unsigned )teGetWorkerCount() );
+	printf( "  fill:      loop %.3f s, array fill %.3f s (%.1fx)\n", LoopFill, BulkFill, BulkFill > 0.0 ? LoopFill/BulkFill : 0.0 );
+	printf( "  copy:      loop %.3f s, array copy %.3f s (%.1fx)\n", LoopCopy, BulkCopy, BulkCopy > 0.0 ? LoopCopy/BulkCopy : 0.0 );
+	printf( "  int sum:   loop %.3f s, array sum %.3f s (%.1fx)\n", LoopSum, BulkSum, BulkSum > 0.0 ? LoopSum/BulkSum : 0.0 );
+	printf( "  int min:   loop %.3f s, array min %.3f s (%.1fx)\n", LoopMin, BulkMin, BulkMin > 0.0 ? LoopMin/BulkMin : 0.0 );
+	printf( "  float sum: loop %.3f s, array sum %.3f s (%.1fx)\n", LoopFloatSum, BulkFloatSum, BulkFloatSum > 0.0 ? LoopFloatSum/BulkFloatSum : 0.0 );
+	printf( "  find:      loop %.3f s, array find %.3f s (%.1fx)\n", LoopFind, BulkFind, BulkFind > 0.0 ? LoopFind/BulkFind : 0.0 );
+}
+
+void TenshiMain( void )
+{
+	CheckBulk();
+	Bench();
+
+	FinishChecks();
+}
@@ -0,0 +1,371 @@
+/*
+	Times FOR loops over 2D arrays as the compiler generates them with every
+	subscript bounds-checked, and as it generates them once the loops are
+	versioned on checks made before each loop (see CodeGen_Bounds.cpp), with
+	unchecked loops ("SAFETY OFF") for reference. The loops are written out
+	here the way the lowered code runs them:
+
+		- A check compares the subscript against the dimension's length read
+		  from the array's header, and calls teArrayIndexError() (which doesn't
+		  return) when it's out of range. A check that repeats one made earlier
+		  in the same iteration is left out, as the bounds-checks pass does.
+		- Only subscripts that are the iterator itself are guarded, so the
+		  checks of x - 1 and x + 1 in the blur stay in the versioned loops.
+
+	The C compiler can keep the header's fields in registers across stores to
+	the items, which the generated code can't always do; if anything that
+	flatters the checked loops.
+
+	Run with "bench.sh Grid".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_WIDTH
+# define BENCH_WIDTH                1024
+#endif
+#ifndef BENCH_HEIGHT
+# define BENCH_HEIGHT               768
+#endif
+#ifndef BENCH_ROUNDS
+# define BENCH_ROUNDS               32
+#endif
+
+#define HEADER( p_ )                ( ( const TenshiArray_t * )( const void * )( p_ ) - 1 )
+#define DIMLEN( p_, d_ )            ( HEADER( p_ )->uDimensions[ d_ ] )
+#define ITEM( p_, x_, y_ )          ( p_ )[ ( TenshiUIntPtr_t )( TenshiIntPtr_t )( x_ ) + ( TenshiUIntPtr_t )( TenshiIntPtr_t )( y_ )*DIMLEN( p_, 0 ) ]
+
+/* tenshi.bounds.check, as LowerBoundsCheck() expands it */
+#define CHECK_INDEX( p_, d_, i_ )\
+	do {\
+		if( ( TenshiUIntPtr_t )( TenshiIntPtr_t )( i_ ) >= DIMLEN( p_, d_ ) ) {\
+			teArrayIndexError( ( const void * )( p_ ), ( d_ ), ( TenshiUIntPtr_t )( TenshiIntPtr_t )( i_ ) );\
+			abort();\
+		}\
+	} while( 0 )
+
+/* "bounds.guard" for an iterator running from 0 (or more) to iLast */
+#define GUARD( p_, d_, iLast_ )     ( ( iLast_ ) >= 0 && DIMLEN( p_, d_ ) > ( TenshiUIntPtr_t )( TenshiIntPtr_t )( iLast_ ) )
+
+typedef enum
+{
+	kVersion_Checked,
+	kVersion_Versioned,
+	kVersion_Unchecked,
+
+	kNumVersions
+} EVersion_t;
+
+static const char *const g_pszVersionNames[ kNumVersions ] = {
+	"checked", "versioned", "unchecked"
+};
+
+static TenshiType_t g_ItemType;
+
+static TenshiInt32_t *DimGrid( TenshiUIntPtr_t cWidth, TenshiUIntPtr_t cHeight )
+{
+	TenshiUIntPtr_t Dims[ 2 ];
+
+	Dims[ 0 ] = cWidth;
+	Dims[ 1 ] = cHeight;
+
+	memset( ( void * )&g_ItemType, 0, sizeof( g_ItemType ) );
+	g_ItemType.Flags = kTenshiTypeF_FullTrivial;
+	g_ItemType.cBytes = sizeof( TenshiInt32_t );
+
+	return ( TenshiInt32_t * )teArrayDim( Dims, 2, &g_ItemType );
+}
+
+/*
+	for y = 0 until h
+		for x = 0 until w
+			image(x, y) = x*y
+*/
+static void FillChecked( TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t x, y;
+
+	for( y = 0; y < h; ++y ) {
+		for( x = 0; x < w; ++x ) {
+			CHECK_INDEX( pImage, 0, x );
+			CHECK_INDEX( pImage, 1, y );
+			ITEM( pImage, x, y ) = x*y;
+		}
+	}
+}
+static void FillVersioned( TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t x, y;
+
+	if( !GUARD( pImage, 1, h - 1 ) ) {
+		FillChecked( pImage, w, h );
+		return;
+	}
+
+	for( y = 0; y < h; ++y ) {
+		if( !GUARD( pImage, 0, w - 1 ) ) {
+			for( x = 0; x < w; ++x ) {
+				CHECK_INDEX( pImage, 0, x );
+				ITEM( pImage, x, y ) = x*y;
+			}
+			continue;
+		}
+
+		for( x = 0; x < w; ++x ) {
+			ITEM( pImage, x, y ) = x*y;
+		}
+	}
+}
+static void FillUnchecked( TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t x, y;
+
+	for( y = 0; y < h; ++y ) {
+		for( x = 0; x < w; ++x ) {
+			ITEM( pImage, x, y ) = x*y;
+		}
+	}
+}
+
+/*
+	for y = 0 to h - 1
+		for x = 1 to w - 2
+			blurred(x, y) = image(x - 1, y) + image(x, y) + image(x + 1, y)
+*/
+static void BlurChecked( TenshiInt32_t *pBlurred, const TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t x, y;
+
+	for( y = 0; y <= h - 1; ++y ) {
+		for( x = 1; x <= w - 2; ++x ) {
+			CHECK_INDEX( pImage, 0, x - 1 );
+			CHECK_INDEX( pImage, 1, y );
+			CHECK_INDEX( pImage, 0, x );
+			CHECK_INDEX( pImage, 0, x + 1 );
+			CHECK_INDEX( pBlurred, 0, x );
+			CHECK_INDEX( pBlurred, 1, y );
+			ITEM( pBlurred, x, y ) = ITEM( pImage, x - 1, y ) + ITEM( pImage, x, y ) + ITEM( pImage, x + 1, y );
+		}
+	}
+}
+static void BlurVersioned( TenshiInt32_t *pBlurred, const TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t x, y;
+
+	if( !GUARD( pImage, 1, h - 1 ) || !GUARD( pBlurred, 1, h - 1 ) ) {
+		BlurChecked( pBlurred, pImage, w, h );
+		return;
+	}
+
+	for( y = 0; y <= h - 1; ++y ) {
+		if( !( w - 2 >= 1 && GUARD( pImage, 0, w - 2 ) && GUARD( pBlurred, 0, w - 2 ) ) ) {
+			for( x = 1; x <= w - 2; ++x ) {
+				CHECK_INDEX( pImage, 0, x - 1 );
+				CHECK_INDEX( pImage, 0, x );
+				CHECK_INDEX( pImage, 0, x + 1 );
+				CHECK_INDEX( pBlurred, 0, x );
+				ITEM( pBlurred, x, y ) = ITEM( pImage, x - 1, y ) + ITEM( pImage, x, y ) + ITEM( pImage, x + 1, y );
+			}
+			continue;
+		}
+
+		for( x = 1; x <= w - 2; ++x ) {
+			CHECK_INDEX( pImage, 0, x - 1 );
+			CHECK_INDEX( pImage, 0, x + 1 );
+			ITEM( pBlurred, x, y ) = ITEM( pImage, x - 1, y ) + ITEM( pImage, x, y ) + ITEM( pImage, x + 1, y );
+		}
+	}
+}
+static void BlurUnchecked( TenshiInt32_t *pBlurred, const TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t x, y;
+
+	for( y = 0; y <= h - 1; ++y ) {
+		for( x = 1; x <= w - 2; ++x ) {
+			ITEM( pBlurred, x, y ) = ITEM( pImage, x - 1, y ) + ITEM( pImage, x, y ) + ITEM( pImage, x + 1, y );
+		}
+	}
+}
+
+/*
+	for y = 0 to array count(image(), 1)
+		for x = 0 until array len(image(), 0)
+			image(x, y) = image(x, y)/2
+*/
+static void HalveChecked( TenshiInt32_t *pImage )
+{
+	TenshiInt32_t x, y;
+
+	for( y = 0; y <= ( TenshiInt32_t )DIMLEN( pImage, 1 ) - 1; ++y ) {
+		for( x = 0; x < ( TenshiInt32_t )DIMLEN( pImage, 0 ); ++x ) {
+			CHECK_INDEX( pImage, 0, x );
+			CHECK_INDEX( pImage, 1, y );
+			ITEM( pImage, x, y ) = ITEM( pImage, x, y )/2;
+		}
+	}
+}
+static void HalveVersioned( TenshiInt32_t *pImage )
+{
+	const TenshiInt32_t iLastY = ( TenshiInt32_t )DIMLEN( pImage, 1 ) - 1;
+	TenshiInt32_t x, y;
+
+	if( !GUARD( pImage, 1, iLastY ) ) {
+		HalveChecked( pImage );
+		return;
+	}
+
+	for( y = 0; y <= iLastY; ++y ) {
+		const TenshiInt32_t iEndX = ( TenshiInt32_t )DIMLEN( pImage, 0 );
+
+		if( !GUARD( pImage, 0, iEndX - 1 ) ) {
+			for( x = 0; x < iEndX; ++x ) {
+				CHECK_INDEX( pImage, 0, x );
+				ITEM( pImage, x, y ) = ITEM( pImage, x, y )/2;
+			}
+			continue;
+		}
+
+		for( x = 0; x < iEndX; ++x ) {
+			ITEM( pImage, x, y ) = ITEM( pImage, x, y )/2;
+		}
+	}
+}
+static void HalveUnchecked( TenshiInt32_t *pImage )
+{
+	TenshiInt32_t x, y;
+
+	for( y = 0; y <= ( TenshiInt32_t )DIMLEN( pImage, 1 ) - 1; ++y ) {
+		for( x = 0; x < ( TenshiInt32_t )DIMLEN( pImage, 0 ); ++x ) {
+			ITEM( pImage, x, y ) = ITEM( pImage, x, y )/2;
+		}
+	}
+}
+
+static void Fill( EVersion_t Version, TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	switch( Version ) {
+	case kVersion_Checked:		FillChecked( pImage, w, h ); break;
+	case kVersion_Versioned:	FillVersioned( pImage, w, h ); break;
+	default:					FillUnchecked( pImage, w, h ); break;
+	}
+}
+static void Blur( EVersion_t Version, TenshiInt32_t *pBlurred, const TenshiInt32_t *pImage, TenshiInt32_t w, TenshiInt32_t h )
+{
+	switch( Version ) {
+	case kVersion_Checked:		BlurChecked( pBlurred, pImage, w, h ); break;
+	case kVersion_Versioned:	BlurVersioned( pBlurred, pImage, w, h ); break;
+	default:					BlurUnchecked( pBlurred, pImage, w, h ); break;
+	}
+}
+static void Halve( EVersion_t Version, TenshiInt32_t *pImage )
+{
+	switch( Version ) {
+	case kVersion_Checked:		HalveChecked( pImage ); break;
+	case kVersion_Versioned:	HalveVersioned( pImage ); break;
+	default:					HalveUnchecked( pImage ); break;
+	}
+}
+
+/* every version has to compute the same grids, including when the guards fail */
+static void CheckGrids( TenshiInt32_t w, TenshiInt32_t h )
+{
+	TenshiInt32_t *pImages[ kNumVersions ];
+	TenshiInt32_t *pBlurred[ kNumVersions ];
+	TenshiUIntPtr_t cBytes;
+	unsigned v;
+
+	cBytes = ( TenshiUIntPtr_t )w*( TenshiUIntPtr_t )h*sizeof( TenshiInt32_t );
+
+	for( v = 0; v < kNumVersions; ++v ) {
+		pImages[ v ] = DimGrid( ( TenshiUIntPtr_t )w, ( TenshiUIntPtr_t )h );
+		pBlurred[ v ] = DimGrid( ( TenshiUIntPtr_t )w, ( TenshiUIntPtr_t )h );
+
+		Fill( ( EVersion_t )v, pImages[ v ], w, h );
+		Blur( ( EVersion_t )v, pBlurred[ v ], pImages[ v ], w, h );
+		Halve( ( EVersion_t )v, pImages[ v ] );
+	}
+
+	for( v = 1; v < kNumVersions; ++v ) {
+		CHECK( memcmp( ( const void * )pImages[ v ], ( const void * )pImages[ 0 ], cBytes ) == 0 );
+		CHECK( memcmp( ( const void * )pBlurred[ v ], ( const void * )pBlurred[ 0 ], cBytes ) == 0 );
+	}
+
+	if( w > 2 && h > 1 ) {
+		CHECK( ITEM( pImages[ 0 ], 2, 1 ) == 1 );
+		CHECK( ITEM( pBlurred[ 0 ], 1, 1 ) == 0 + 1 + 2 );
+	}
+
+	for( v = 0; v < kNumVersions; ++v ) {
+		teArrayUndim( ( void * )pBlurred[ v ] );
+		teArrayUndim( ( void * )pImages[ v ] );
+	}
+}
+static void CheckVersions( void )
+{
+	unsigned i;
+
+	/* 1 wide leaves the blur's range empty (its guard fails) */
+	CheckGrids( 1, 1 );
+	CheckGrids( 1, 5 );
+	CheckGrids( 3, 2 );
+	CheckGrids( 17, 9 );
+	CheckGrids( 64, 48 );
+
+	for( i = 0; i < 16; ++i ) {
+		CheckGrids( ( TenshiInt32_t )( 1 + NextRand()%80 ), ( TenshiInt32_t )( 1 + NextRand()%60 ) );
+	}
+}
+
+static void Bench( void )
+{
+	TenshiInt32_t *pImage;
+	TenshiInt32_t *pBlurred;
+	TenshiUInt64_t uStart;
+	double FillTime[ kNumVersions ];
+	double BlurTime[ kNumVersions ];
+	double HalveTime[ kNumVersions ];
+	unsigned r, v;
+
+	pImage = DimGrid( BENCH_WIDTH, BENCH_HEIGHT );
+	pBlurred = DimGrid( BENCH_WIDTH, BENCH_HEIGHT );
+
+	for( v = 0; v < kNumVersions; ++v ) {
+		uStart = tePerfTimer();
+		for( r = 0; r < BENCH_ROUNDS; ++r ) {
+			Fill( ( EVersion_t )v, pImage, BENCH_WIDTH, BENCH_HEIGHT );
+		}
+		FillTime[ v ] = Seconds( uStart );
+
+		uStart = tePerfTimer();
+		for( r = 0; r < BENCH_ROUNDS; ++r ) {
+			Blur( ( EVersion_t )v, pBlurred, pImage, BENCH_WIDTH, BENCH_HEIGHT );
+		}
+		BlurTime[ v ] = Seconds( uStart );
+
+		uStart = tePerfTimer();
+		for( r = 0; r < BENCH_ROUNDS; ++r ) {
+			Halve( ( EVersion_t )v, pImage );
+		}
+		HalveTime[ v ] = Seconds( uStart );
+	}
+
+	teArrayUndim( ( void * )pBlurred );
+	teArrayUndim( ( void * )pImage );
+
+	printf( "%ux%u grid of INTEGER, %u rounds\n", ( unsigned )BENCH_WIDTH, ( unsigned )BENCH_HEIGHT, ( unsigned )BENCH_ROUNDS );
+	for( v = 0; v < kNumVersions; ++v ) {
+		printf( "  %-9s  fill %.3f s, blur %.3f s, halve %.3f s\n", g_pszVersionNames[ v ], FillTime[ v ], BlurTime[ v ], HalveTime[ v ] );
+	}
+	printf( "  versioned vs. checked: fill %.1fx, blur %.1fx, halve %.1fx\n",
+		FillTime[ kVersion_Versioned ] > 0.0 ? FillTime[ kVersion_Checked ]/FillTime[ kVersion_Versioned ] : 0.0,
+		BlurTime[ kVersion_Versioned ] > 0.0 ? BlurTime[ kVersion_Checked ]/BlurTime[ kVersion_Versioned ] : 0.0,
+		HalveTime[ kVersion_Versioned ] > 0.0 ? HalveTime[ kVersion_Checked ]/HalveTime[ kVersion_Versioned ] : 0.0 );
+}
+
+void TenshiMain( void )
+{
+	CheckVersions();
+	Bench();
+
+	FinishChecks();
+}
@@ -0,0 +1,212 @@
+/*
+	Times walking a linked list and reaching its items by position, after
+	checking that positional access agrees with a plain array through
+	inserts and deletes anywhere in the list (which exercise the index).
+
+	Run with "bench.sh List".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_ITEMS
+# define BENCH_ITEMS                ( 1<<20 )
+#endif
+#ifndef BENCH_LOOKUPS
+# define BENCH_LOOKUPS              ( 1<<16 )
+#endif
+#ifndef BENCH_ROUNDS
+# define BENCH_ROUNDS               4
+#endif
+
+static void InitItemType( TenshiType_t *pItemType )
+{
+	memset( ( void * )pItemType, 0, sizeof( *pItemType ) );
+	pItemType->Flags = kTenshiTypeF_FullTrivial;
+	pItemType->cBytes = sizeof( TenshiInt64_t );
+}
+
+static TenshiInt64_t ItemValue( TenshiList_t *pList, TenshiUIntPtr_t uIndex )
+{
+	const TenshiInt64_t *pValue;
+
+	pValue = ( const TenshiInt64_t * )teListAt( pList, uIndex );
+	return pValue != NULL ? *pValue : -1;
+}
+
+static void CheckList( void )
+{
+	enum { kMaxItems = 20000, kSteps = 60000 };
+
+	static TenshiInt64_t Mirror[ kMaxItems ];
+	TenshiType_t ItemType;
+	TenshiList_t *pList;
+	TenshiListItem_t *pNode;
+	TenshiUIntPtr_t cItems;
+	TenshiUIntPtr_t uPos;
+	TenshiUIntPtr_t i;
+	TenshiInt64_t iNext;
+	TenshiInt64_t *pValue;
+	unsigned uStep;
+	unsigned uPass;
+
+	InitItemType( &ItemType );
+	pList = teNewList( &ItemType );
+	CHECK( pList != NULL );
+	if( !pList ) {
+		return;
+	}
+
+	/* the second pass runs over the slabs and free items the first left */
+	for( uPass = 0; uPass < 2; ++uPass ) {
+		cItems = 0;
+		iNext = 0;
+
+		for( uStep = 0; uStep < kSteps; ++uStep ) {
+			const TenshiUInt32_t r = NextRand();
+
+			if( cItems < kMaxItems && ( cItems == 0 || r%8 < 5 ) ) {
+				if( r%3 == 0 || cItems == 0 ) {
+					pValue = ( TenshiInt64_t * )teListAddToBack( pList );
+					uPos = cItems;
+				} else {
+					uPos = ( r >> 8 )%cItems;
+					pValue = ( TenshiInt64_t * )teListNodeItem( teListInsertBeforeNode( pList, teListNodeAt( pList, uPos ) ) );
+				}
+
+				CHECK( pValue != NULL );
+				if( !pValue ) {
+					break;
+				}
+
+				*pValue = iNext;
+				memmove( ( void * )&Mirror[ uPos + 1 ], ( const void * )&Mirror[ uPos ], ( cItems - uPos )*sizeof( Mirror[ 0 ] ) );
+				Mirror[ uPos ] = iNext++;
+				++cItems;
+			} else if( cItems > 0 ) {
+				uPos = r%4 == 0 ? cItems - 1 : ( r >> 8 )%cItems;
+				pNode = teListNodeAt( pList, uPos );
+
+				CHECK( pNode != NULL && *( TenshiInt64_t * )teListNodeItem( pNode ) == Mirror[ uPos ] );
+				teListDeleteNode( pList, pNode );
+
+				memmove( ( void * )&Mirror[ uPos ], ( const void * )&Mirror[ uPos + 1 ], ( cItems - uPos - 1 )*sizeof( Mirror[ 0 ] ) );
+				--cItems;
+			}
+
+			if( uStep%997 == 0 ) {
+				for( i = 0; i < cItems; i += 1 + NextRand()%37 ) {
+					CHECK( ItemValue( pList, i ) == Mirror[ i ] );
+				}
+			}
+		}
+
+		CHECK( teListLen( pList ) == cItems );
+		CHECK( teListAt( pList, cItems ) == NULL );
+
+		/* walking it and reaching it by position (backward) see the same order */
+		i = 0;
+		for( pValue = ( TenshiInt64_t * )teListFront( pList ); pValue != NULL; pValue = ( TenshiInt64_t * )teListNext( pValue ) ) {
+			CHECK( i < cItems && *pValue == Mirror[ i ] );
+			++i;
+		}
+		CHECK( i == cItems );
+		for( i = cItems; i > 0; --i ) {
+			CHECK( ItemValue( pList, i - 1 ) == Mirror[ i - 1 ] );
+		}
+
+		if( uPass == 0 ) {
+			while( !teListIsEmpty( pList ) ) {
+				teListDeleteFront( pList );
+			}
+		}
+	}
+
+	teEmptyList( pList );
+	CHECK( teListLen( pList ) == 0 && teListAt( pList, 0 ) == NULL );
+
+	pValue = ( TenshiInt64_t * )teListAddToBack( pList );
+	CHECK( pValue != NULL && ItemValue( pList, 0 ) == 0 );
+
+	teDeleteList( pList );
+}
+
+static void Bench( void )
+{
+	TenshiType_t ItemType;
+	TenshiList_t *pList;
+	TenshiInt64_t *pValue;
+	TenshiInt64_t iSum;
+	TenshiInt64_t iExpected;
+	TenshiUInt32_t i;
+	TenshiUInt32_t r;
+	TenshiUInt64_t uStart;
+	double Build, Walk, InOrder, Random;
+
+	InitItemType( &ItemType );
+	pList = teNewList( &ItemType );
+	if( !pList ) {
+		CHECK( pList != NULL );
+		return;
+	}
+
+	uStart = tePerfTimer();
+	for( i = 0; i < BENCH_ITEMS; ++i ) {
+		pValue = ( TenshiInt64_t * )teListAddToBack( pList );
+		if( !pValue ) {
+			CHECK( pValue != NULL );
+			teDeleteList( pList );
+			return;
+		}
+
+		*pValue = i;
+	}
+	Build = Seconds( uStart );
+
+	iExpected = ( TenshiInt64_t )BENCH_ITEMS*( BENCH_ITEMS - 1 )/2*BENCH_ROUNDS;
+
+	iSum = 0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( pValue = ( TenshiInt64_t * )teListFront( pList ); pValue != NULL; pValue = ( TenshiInt64_t * )teListNext( pValue ) ) {
+			iSum += *pValue;
+		}
+	}
+	Walk = Seconds( uStart );
+	CHECK( iSum == iExpected );
+
+	iSum = 0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( i = 0; i < BENCH_ITEMS; ++i ) {
+			iSum += *( TenshiInt64_t * )teListAt( pList, i );
+		}
+	}
+	InOrder = Seconds( uStart );
+	CHECK( iSum == iExpected );
+
+	iSum = 0;
+	uStart = tePerfTimer();
+	for( i = 0; i < BENCH_LOOKUPS; ++i ) {
+		const TenshiUInt32_t uIndex = NextRand()%BENCH_ITEMS;
+
+		iSum += *( TenshiInt64_t * )teListAt( pList, uIndex ) - uIndex;
+	}
+	Random = Seconds( uStart );
+	CHECK( iSum == 0 );
+
+	printf( "%u items, %u rounds\n", ( unsigned )BENCH_ITEMS, ( unsigned )BENCH_ROUNDS );
+	printf( "  add to back:            %.3f s\n", Build );
+	printf( "  walk (next):            %.3f s\n", Walk );
+	printf( "  by position, in order:  %.3f s\n", InOrder );
+	printf( "  by position, random:    %.3f s for %u lookups\n", Random, ( unsigned )BENCH_LOOKUPS );
+
+	teDeleteList( pList );
+}
+
+void TenshiMain( void )
+{
+	CheckList();
+	Bench();
+
+	FinishChecks();
+}
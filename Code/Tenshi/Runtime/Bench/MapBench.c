@@ -0,0 +1,166 @@
+/*
+	Compares MAP lookups against the runtime's binary tree, after checking
+	that the map agrees with a plain array through inserts, erases (which
+	exercise the incremental resize), and iteration.
+
+	Run with "bench.sh Map".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_KEYS
+# define BENCH_KEYS                 ( 1<<20 )
+#endif
+#ifndef BENCH_ROUNDS
+# define BENCH_ROUNDS               4
+#endif
+
+static void CheckMap( void )
+{
+	enum { kKeys = 50000 };
+
+	static TenshiInt64_t Values[ kKeys ];
+	static TenshiBoolean_t Present[ kKeys ];
+	TenshiIndex_t m;
+	TenshiUIntPtr_t cExpected;
+	TenshiUIntPtr_t cVisited;
+	TenshiUIntPtr_t uPos;
+	TenshiUInt32_t i;
+	TenshiUInt32_t k;
+	char szKey[ 32 ];
+	char *pszValue;
+
+	m = teAllocMap();
+	CHECK( teMapExist( m ) );
+
+	cExpected = 0;
+	for( i = 0; i < kKeys*8; ++i ) {
+		k = NextRand() % kKeys;
+
+		if( NextRand() % 3 == 0 ) {
+			CHECK( teMapEraseInt( m, k ) == Present[ k ] );
+			cExpected -= Present[ k ] ? 1 : 0;
+			Present[ k ] = TENSHI_FALSE;
+		} else {
+			teMapInsertInt( m, k, ( TenshiInt64_t )i );
+			cExpected += Present[ k ] ? 0 : 1;
+			Present[ k ] = TENSHI_TRUE;
+			Values[ k ] = ( TenshiInt64_t )i;
+		}
+	}
+
+	CHECK( teMapCount( m ) == cExpected );
+	for( k = 0; k < kKeys; ++k ) {
+		CHECK( teMapHasInt( m, k ) == Present[ k ] );
+		if( Present[ k ] ) {
+			CHECK( teMapFindInt( m, k ) == Values[ k ] );
+		}
+	}
+
+	cVisited = 0;
+	for( uPos = teMapIterFirst( m ); uPos != 0; uPos = teMapIterNext( m, uPos ) ) {
+		CHECK( Present[ teMapIterIntKey( m, uPos ) ] );
+		++cVisited;
+	}
+	CHECK( cVisited == cExpected );
+
+	teMapClear( m );
+	CHECK( teMapCount( m ) == 0 );
+	CHECK( teMapIterFirst( m ) == 0 );
+
+	for( k = 0; k < 1000; ++k ) {
+		sprintf( szKey, "key%u", k );
+		teMapInsertStrStr( m, szKey, szKey + 3 );
+	}
+	teMapInsertInt( m, 17, 42 );
+	teMapInsertStr( m, NULL, 7 );
+
+	CHECK( teMapCount( m ) == 1002 );
+	CHECK( teMapHasStr( m, "" ) && teMapFindStr( m, "" ) == 7 );
+	CHECK( !teMapHasStr( m, "17" ) && !teMapHasInt( m, 999 ) );
+
+	pszValue = teMapFindStrStr( m, "key999" );
+	CHECK( pszValue != NULL && strcmp( pszValue, "999" ) == 0 );
+	teStrReclaim( pszValue );
+
+	pszValue = teMapFindIntStr( m, 17 );
+	CHECK( pszValue != NULL && strcmp( pszValue, "42" ) == 0 );
+	teStrReclaim( pszValue );
+
+	CHECK( teMapFindStrStr( m, "missing" ) == NULL );
+
+	m = teDeleteMap( m );
+	CHECK( m == 0 );
+}
+
+static void Bench( void )
+{
+	static TenshiInt32_t Keys[ BENCH_KEYS ];
+	TenshiType_t ItemType;
+	TenshiBTree_t *pTree;
+	TenshiIndex_t m;
+	TenshiInt64_t iSum;
+	TenshiUInt32_t i;
+	TenshiUInt32_t r;
+	TenshiUInt64_t uStart;
+	double TreeInsert, TreeFind;
+	double MapInsert, MapFind;
+
+	for( i = 0; i < BENCH_KEYS; ++i ) {
+		Keys[ i ] = ( TenshiInt32_t )( NextRand() & 0x7FFFFFFF );
+	}
+
+	memset( ( void * )&ItemType, 0, sizeof( ItemType ) );
+	ItemType.Flags = kTenshiTypeF_FullTrivial;
+	ItemType.cBytes = sizeof( TenshiInt64_t );
+
+	pTree = teNewBTree( &ItemType );
+	m = teAllocMap();
+
+	uStart = tePerfTimer();
+	for( i = 0; i < BENCH_KEYS; ++i ) {
+		*( TenshiInt64_t * )teBTreeLookup( pTree, Keys[ i ] ) = i;
+	}
+	TreeInsert = Seconds( uStart );
+
+	uStart = tePerfTimer();
+	for( i = 0; i < BENCH_KEYS; ++i ) {
+		teMapInsertInt( m, Keys[ i ], i );
+	}
+	MapInsert = Seconds( uStart );
+
+	iSum = 0;
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( i = 0; i < BENCH_KEYS; ++i ) {
+			iSum += *( TenshiInt64_t * )teBTreeFind( pTree, Keys[ i ] );
+		}
+	}
+	TreeFind = Seconds( uStart );
+
+	uStart = tePerfTimer();
+	for( r = 0; r < BENCH_ROUNDS; ++r ) {
+		for( i = 0; i < BENCH_KEYS; ++i ) {
+			iSum -= teMapFindInt( m, Keys[ i ] );
+		}
+	}
+	MapFind = Seconds( uStart );
+
+	/* both hold the last value inserted for a duplicate key */
+	CHECK( iSum == 0 );
+
+	printf( "%u keys, %u lookup rounds\n", ( unsigned )BENCH_KEYS, ( unsigned )BENCH_ROUNDS );
+	printf( "  btree: insert %.3f s, find %.3f s\n", TreeInsert, TreeFind );
+	printf( "  map:   insert %.3f s, find %.3f s (%.1fx)\n", MapInsert, MapFind, MapFind > 0.0 ? TreeFind/MapFind : 0.0 );
+
+	teDeleteMap( m );
+	teDeleteBTree( pTree );
+}
+
+void TenshiMain( void )
+{
+	CheckMap();
+	Bench();
+
+	FinishChecks();
+}
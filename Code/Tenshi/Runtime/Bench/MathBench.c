@@ -0,0 +1,432 @@
+/*
+	Times the batch math functions (ARRAY SIN and the rest) against calling
+	the scalar ones for each value, after checking how far the SSE2 versions
+	stray from the exact results, that the precise mode matches the scalar
+	functions exactly, and that a value's result doesn't depend on where it
+	falls in the run (or on the number of workers).
+
+	Run with "bench.sh Math".
+*/
+
+#include "Bench.h"
+
+#include <float.h>
+#include <math.h>
+
+#ifndef BENCH_VALUES
+# define BENCH_VALUES               ( 1<<20 )
+#endif
+#ifndef BENCH_ROUNDS
+# define BENCH_ROUNDS               8
+#endif
+
+/* as the runtime decides; without SSE2 every batch is the scalar function */
+#ifndef SSE2_ENABLED
+# if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define SSE2_ENABLED              1
+# else
+#  define SSE2_ENABLED              0
+# endif
+#endif
+
+#define CHECK_VALUES                ( 1<<18 )
+/* long enough for the runtime to split the run across workers */
+#define PARALLEL_VALUES             ( ( 1<<17 ) + 3 )
+
+/* the bounds documented in "Unified Array System.txt" */
+#define MAX_ULPS_SINCOS             2.0
+#define MAX_ULPS_EXP                2.0
+#define MAX_ULPS_LOG                2.0
+
+static const char *const g_pszFuncNames[ kTenshiNumMathBatches ] = {
+	"sin", "cos", "sqrt", "exp", "log", "noise"
+};
+static float( TENSHI_CALL *const g_pfnScalar[ kTenshiNumMathBatches ] )( float ) = {
+	&teSin, &teCos, &teSqrt, &teExp, &teLog, &teNoise
+};
+
+static float FloatFromBits( TenshiUInt32_t u )
+{
+	float f;
+
+	memcpy( ( void * )&f, ( const void * )&u, sizeof( f ) );
+	return f;
+}
+static int SameFloat( float a, float b )
+{
+	return memcmp( ( const void * )&a, ( const void * )&b, sizeof( a ) ) == 0 || ( a != a && b != b );
+}
+static float RandRange( float lo, float hi )
+{
+	return lo + ( hi - lo )*( float )( NextRand() >> 8 )/16777216.0f;
+}
+
+/* distance from the exact result in units of the float nearest it */
+static double UlpError( float x, double Exact )
+{
+	float Nearest;
+	double Ulp;
+
+	if( x != x || Exact != Exact ) {
+		return x != x && Exact != Exact ? 0.0 : HUGE_VAL;
+	}
+	Nearest = fabsf( ( float )Exact );
+	if( isinf( Nearest ) || isinf( x ) ) {
+		return fabsf( x ) == Nearest ? 0.0 : HUGE_VAL;
+	}
+
+	Ulp = ( double )nextafterf( Nearest, HUGE_VALF ) - ( double )Nearest;
+	if( Ulp < ( double )FLT_MIN*FLT_EPSILON ) {
+		Ulp = ( double )FLT_MIN*FLT_EPSILON;
+	}
+
+	return fabs( ( double )x - Exact )/Ulp;
+}
+/* sine of whole degrees, reduced exactly so multiples of 90 come out exact */
+static double ExactSinDeg( double Deg )
+{
+	double Rad;
+	int Quadrant;
+
+	Deg = fmod( Deg, 360.0 );
+	Quadrant = ( int )floor( Deg/90.0 + 0.5 );
+	Rad = ( Deg - 90.0*Quadrant )*( 3.14159265358979323846/180.0 );
+
+	switch( Quadrant & 3 ) {
+	case 1:
+		return cos( Rad );
+	case 2:
+		return -sin( Rad );
+	case 3:
+		return -cos( Rad );
+	}
+
+	return sin( Rad );
+}
+static double ExactResult( TenshiUInt32_t Func, float x )
+{
+	switch( Func ) {
+	case kTenshiMathBatch_Sin:
+		return ExactSinDeg( ( double )x );
+	case kTenshiMathBatch_Cos:
+		return ExactSinDeg( ( double )x + 90.0 );
+	case kTenshiMathBatch_Exp:
+		return exp( ( double )x );
+	case kTenshiMathBatch_Log:
+		return x < 0.0f ? ( double )NAN : log( ( double )x );
+	}
+
+	return 0.0;
+}
+/* the edge cases (huge angles, denormals, overflow) unless bTypical */
+static void FillInputs( TenshiUInt32_t Func, float *pValues, TenshiUIntPtr_t cValues, int bTypical )
+{
+	TenshiUIntPtr_t i;
+
+	for( i = 0; i < cValues; ++i ) {
+		switch( Func ) {
+		case kTenshiMathBatch_Sin:
+		case kTenshiMathBatch_Cos:
+			pValues[ i ] = bTypical || i%8 != 0 ? RandRange( -720.0f, 720.0f ) : RandRange( -1e7f, 1e7f );
+			break;
+		case kTenshiMathBatch_Exp:
+			pValues[ i ] = bTypical ? RandRange( -20.0f, 20.0f ) : RandRange( -104.0f, 89.0f );
+			break;
+		case kTenshiMathBatch_Sqrt:
+		case kTenshiMathBatch_Log:
+			/* every positive float, denormals included */
+			pValues[ i ] = bTypical ? RandRange( 0.001f, 1000.0f ) : FloatFromBits( 1 + NextRand()%0x7F7FFFFFU );
+			break;
+		case kTenshiMathBatch_Noise:
+			pValues[ i ] = bTypical || i%4 != 0 ? RandRange( -1000.0f, 1000.0f ) : ( float )( ( TenshiInt32_t )( NextRand()%4001 ) - 2000 )*0.5f;
+			break;
+		}
+	}
+}
+
+static void *DimArray( TenshiUIntPtr_t cItems, TenshiUIntPtr_t cItemBytes, TenshiType_t *pItemType )
+{
+	memset( ( void * )pItemType, 0, sizeof( *pItemType ) );
+	pItemType->Flags = kTenshiTypeF_FullTrivial;
+	pItemType->cBytes = cItemBytes;
+
+	return teArrayDim( &cItems, 1, pItemType );
+}
+
+static void CheckFloor( void )
+{
+	/* teNoise() relies on it; these used to truncate */
+	CHECK( teFloor( -0.5f ) == -1.0f );
+	CHECK( teFloor( -2.5f ) == -3.0f );
+	CHECK( teFloor( -0.25f ) == -1.0f );
+	CHECK( teFloor( -1.3f ) == -2.0f );
+	CHECK( teFloor( -2.0f ) == -2.0f );
+	CHECK( teFloor( 2.75f ) == 2.0f );
+	CHECK( teFloor( 0.0f ) == 0.0f );
+	CHECK( teFloor( -1e20f ) == -1e20f );
+	CHECK( teFloor( 3e9f ) == 3e9f );
+	CHECK( teFloor( NAN ) != teFloor( NAN ) );
+}
+
+static void CheckSpecials( void )
+{
+	static const float In[] = {
+		0.0f, -0.0f, HUGE_VALF, -HUGE_VALF, NAN, -1.0f, 100.0f, -100.0f, 1e-40f, 88.7f, 90.0f, -270.0f, 1e30f
+	};
+	enum { kIn = sizeof( In )/sizeof( In[ 0 ] ) };
+	float Out[ kIn ];
+	TenshiUIntPtr_t i;
+
+	teMathBatch( Out, In, kIn, kTenshiMathBatch_Exp, 0 );
+	CHECK( Out[ 0 ] == 1.0f && Out[ 1 ] == 1.0f );
+	CHECK( Out[ 2 ] == HUGE_VALF && Out[ 3 ] == 0.0f );
+	CHECK( Out[ 4 ] != Out[ 4 ] );
+	CHECK( Out[ 6 ] == HUGE_VALF && Out[ 12 ] == HUGE_VALF );
+	CHECK( UlpError( Out[ 7 ], exp( ( double )In[ 7 ] ) ) <= MAX_ULPS_EXP );
+	CHECK( UlpError( Out[ 9 ], exp( ( double )In[ 9 ] ) ) <= MAX_ULPS_EXP );
+
+	teMathBatch( Out, In, kIn, kTenshiMathBatch_Log, 0 );
+	CHECK( Out[ 0 ] == -HUGE_VALF && Out[ 1 ] == -HUGE_VALF );
+	CHECK( Out[ 2 ] == HUGE_VALF );
+	CHECK( Out[ 3 ] != Out[ 3 ] && Out[ 4 ] != Out[ 4 ] && Out[ 5 ] != Out[ 5 ] );
+	CHECK( UlpError( Out[ 8 ], log( ( double )In[ 8 ] ) ) <= MAX_ULPS_LOG );
+
+#if SSE2_ENABLED
+	teMathBatch( Out, In, kIn, kTenshiMathBatch_Sin, 0 );
+	CHECK( Out[ 0 ] == 0.0f );
+	CHECK( Out[ 2 ] != Out[ 2 ] && Out[ 3 ] != Out[ 3 ] && Out[ 4 ] != Out[ 4 ] );
+	CHECK( Out[ 10 ] == 1.0f && Out[ 11 ] == 1.0f );
+	CHECK( UlpError( Out[ 12 ], ExactResult( kTenshiMathBatch_Sin, In[ 12 ] ) ) <= MAX_ULPS_SINCOS );
+
+	teMathBatch( Out, In, kIn, kTenshiMathBatch_Cos, 0 );
+	CHECK( Out[ 0 ] == 1.0f && Out[ 1 ] == 1.0f );
+	CHECK( Out[ 10 ] == 0.0f && Out[ 11 ] == 0.0f );
+#endif
+
+	/* in place */
+	memcpy( ( void * )Out, ( const void * )In, sizeof( In ) );
+	teMathBatch( Out, Out, kIn, kTenshiMathBatch_Sqrt, 0 );
+	for( i = 0; i < kIn; ++i ) {
+		CHECK( SameFloat( Out[ i ], teSqrt( In[ i ] ) ) );
+	}
+}
+
+static void CheckAccuracy( void )
+{
+	float *pIn;
+	float *pOut;
+	float *pPrecise;
+	double MaxUlps;
+	double Ulps;
+	TenshiUInt32_t Func;
+	TenshiUIntPtr_t cMismatches;
+	TenshiUIntPtr_t i;
+
+	pIn = ( float * )malloc( CHECK_VALUES*sizeof( float ) );
+	pOut = ( float * )malloc( CHECK_VALUES*sizeof( float ) );
+	pPrecise = ( float * )malloc( CHECK_VALUES*sizeof( float ) );
+
+	printf( "max error of the batch versions (in units in the last place):\n" );
+
+	for( Func = 0; Func < kTenshiNumMathBatches; ++Func ) {
+		FillInputs( Func, pIn, CHECK_VALUES, 0 );
+
+		teMathBatch( pOut, pIn, CHECK_VALUES, Func, 0 );
+		teMathBatch( pPrecise, pIn, CHECK_VALUES, Func, kTenshiMathBatchF_Precise );
+
+		/* the precise mode is the scalar function */
+		cMismatches = 0;
+		for( i = 0; i < CHECK_VALUES; ++i ) {
+			cMismatches += !SameFloat( pPrecise[ i ], g_pfnScalar[ Func ]( pIn[ i ] ) );
+		}
+		CHECK( cMismatches == 0 );
+
+		if( !SSE2_ENABLED || Func == kTenshiMathBatch_Sqrt || Func == kTenshiMathBatch_Noise ) {
+			cMismatches = 0;
+			for( i = 0; i < CHECK_VALUES; ++i ) {
+				cMismatches += !SameFloat( pOut[ i ], pPrecise[ i ] );
+			}
+			CHECK( cMismatches == 0 );
+
+			printf( "  %-5s  same as the scalar function\n", g_pszFuncNames[ Func ] );
+			continue;
+		}
+
+		MaxUlps = 0.0;
+		for( i = 0; i < CHECK_VALUES; ++i ) {
+			Ulps = UlpError( pOut[ i ], ExactResult( Func, pIn[ i ] ) );
+			if( Ulps > MaxUlps ) {
+				MaxUlps = Ulps;
+			}
+		}
+
+		printf( "  %-5s  %.2f\n", g_pszFuncNames[ Func ], MaxUlps );
+		switch( Func ) {
+		case kTenshiMathBatch_Sin:
+		case kTenshiMathBatch_Cos:
+			CHECK( MaxUlps <= MAX_ULPS_SINCOS );
+			break;
+		case kTenshiMathBatch_Exp:
+			CHECK( MaxUlps <= MAX_ULPS_EXP );
+			break;
+		case kTenshiMathBatch_Log:
+			CHECK( MaxUlps <= MAX_ULPS_LOG );
+			break;
+		}
+	}
+
+	free( ( void * )pPrecise );
+	free( ( void * )pOut );
+	free( ( void * )pIn );
+}
+
+static void CheckRuns( void )
+{
+	static const TenshiUIntPtr_t Sizes[] = { 1, 3, 4, 5, 17, 1000, PARALLEL_VALUES };
+	static const TenshiUInt32_t Workers[] = { 1, 3, 4 };
+	float *pIn;
+	float *pOut;
+	float Single;
+	TenshiUInt32_t Func;
+	TenshiUIntPtr_t cMismatches;
+	TenshiUIntPtr_t s, w, i;
+
+	pIn = ( float * )malloc( PARALLEL_VALUES*sizeof( float ) );
+	pOut = ( float * )malloc( PARALLEL_VALUES*sizeof( float ) );
+
+	for( Func = 0; Func < kTenshiNumMathBatches; ++Func ) {
+		FillInputs( Func, pIn, PARALLEL_VALUES, 0 );
+
+		for( w = 0; w < sizeof( Workers )/sizeof( Workers[ 0 ] ); ++w ) {
+			teSetWorkerCount( Workers[ w ] );
+
+			for( s = 0; s < sizeof( Sizes )/sizeof( Sizes[ 0 ] ); ++s ) {
+				memset( ( void * )pOut, 0xFF, Sizes[ s ]*sizeof( float ) );
+				teMathBatch( pOut, pIn, Sizes[ s ], Func, 0 );
+
+				cMismatches = 0;
+				for( i = 0; i < Sizes[ s ]; i += 1 + i/64 ) {
+					teMathBatch( &Single, pIn + i, 1, Func, 0 );
+					cMismatches += !SameFloat( pOut[ i ], Single );
+				}
+				CHECK( cMismatches == 0 );
+			}
+		}
+	}
+
+	teSetWorkerCount( 0 );
+
+	/* nothing to do, or not a function */
+	teMathBatch( pOut, pIn, 0, kTenshiMathBatch_Sin, 0 );
+	pOut[ 0 ] = 5.0f;
+	teMathBatch( pOut, pIn, 1, kTenshiNumMathBatches, 0 );
+	CHECK( pOut[ 0 ] == 5.0f );
+
+	free( ( void * )pOut );
+	free( ( void * )pIn );
+}
+
+static void CheckArrays( void )
+{
+	TenshiType_t DstType, SrcType, DoubleType;
+	float *pDst;
+	float *pSrc;
+	double *pDoubles;
+	TenshiUIntPtr_t i;
+
+	pDst = ( float * )DimArray( 100, sizeof( *pDst ), &DstType );
+	pSrc = ( float * )DimArray( 37, sizeof( *pSrc ), &SrcType );
+	pDoubles = ( double * )DimArray( 37, sizeof( *pDoubles ), &DoubleType );
+
+	for( i = 0; i < 100; ++i ) {
+		pDst[ i ] = -1.0f;
+	}
+	for( i = 0; i < 37; ++i ) {
+		pSrc[ i ] = ( float )i*10.0f;
+	}
+
+	/* as many items as the shorter array has */
+	teArrayMath( ( void * )pDst, ( const void * )pSrc, kTenshiMathBatch_Sqrt, 0 );
+	for( i = 0; i < 100; ++i ) {
+		CHECK( pDst[ i ] == ( i < 37 ? teSqrt( pSrc[ i ] ) : -1.0f ) );
+	}
+
+	teArrayMath( ( void * )pSrc, ( const void * )pSrc, kTenshiMathBatch_Cos, kTenshiMathBatchF_Precise );
+	for( i = 0; i < 37; ++i ) {
+		CHECK( SameFloat( pSrc[ i ], teCos( ( float )i*10.0f ) ) );
+	}
+
+	/* DOUBLE items are left alone */
+	pDoubles[ 0 ] = 4.0;
+	teArrayMath( ( void * )pDoubles, ( const void * )pDoubles, kTenshiMathBatch_Sqrt, 0 );
+	CHECK( pDoubles[ 0 ] == 4.0 );
+
+	teArrayMath( NULL, ( const void * )pSrc, kTenshiMathBatch_Sin, 0 );
+
+	teArrayUndim( ( void * )pDoubles );
+	teArrayUndim( ( void * )pSrc );
+	teArrayUndim( ( void * )pDst );
+}
+
+static void Bench( void )
+{
+	float *pIn;
+	float *pOut;
+	double Loop, Batch;
+	double Sum;
+	TenshiUInt32_t Func;
+	TenshiUInt32_t r;
+	TenshiUIntPtr_t i;
+	TenshiUInt64_t uStart;
+	float( TENSHI_CALL *pfnScalar )( float );
+
+	pIn = ( float * )malloc( BENCH_VALUES*sizeof( float ) );
+	pOut = ( float * )malloc( BENCH_VALUES*sizeof( float ) );
+
+	printf( "%u values, %u rounds, %u worker%s\n", ( unsigned )BENCH_VALUES, ( unsigned )BENCH_ROUNDS,
+		( unsigned )teGetWorkerCount(), teGetWorkerCount() == 1 ? "" : "s" );
+
+	Sum = 0.0;
+	for( Func = 0; Func < kTenshiNumMathBatches; ++Func ) {
+		FillInputs( Func, pIn, BENCH_VALUES, 1 );
+		pfnScalar = g_pfnScalar[ Func ];
+
+		uStart = tePerfTimer();
+		for( r = 0; r < BENCH_ROUNDS; ++r ) {
+			for( i = 0; i < BENCH_VALUES; ++i ) {
+				pOut[ i ] = pfnScalar( pIn[ i ] );
+			}
+			Sum += pOut[ r ];
+		}
+		Loop = Seconds( uStart );
+
+		uStart = tePerfTimer();
+		for( r = 0; r < BENCH_ROUNDS; ++r ) {
+			teMathBatch( pOut, pIn, BENCH_VALUES, Func, 0 );
+			Sum += pOut[ r ];
+		}
+		Batch = Seconds( uStart );
+
+		printf( "  %-5s  loop %.3f s, batch %.3f s (%.1fx)\n", g_pszFuncNames[ Func ], Loop, Batch, Batch > 0.0 ? Loop/Batch : 0.0 );
+	}
+
+	/* keep the loops from being thrown away */
+	if( Sum == 12345.0 ) {
+		printf( "\n" );
+	}
+
+	free( ( void * )pOut );
+	free( ( void * )pIn );
+}
+
+void TenshiMain( void )
+{
+	CheckFloor();
+	CheckSpecials();
+	CheckAccuracy();
+	CheckRuns();
+	CheckArrays();
+	Bench();
+
+	FinishChecks();
+}
@@ -0,0 +1,392 @@
+/*
+	Times the random number generator in values per second: RND one value
+	per call, RNG GENERATE (which looks the generator up in its pool for
+	each value), and the bulk fills behind ARRAY RND and FILL MEMBLOCK RND.
+	First checks that jumping ahead matches stepping, that the fills give
+	the same values as calling the generator for each (with any number of
+	workers), and that PARALLEL FOR chunks see the same streams no matter
+	how many threads run them.
+
+	Run with "bench.sh Rng".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_VALUES
+# define BENCH_VALUES               ( 1<<22 )
+#endif
+#ifndef BENCH_ROUNDS
+# define BENCH_ROUNDS               8
+#endif
+
+/* long enough for the runtime to split the fill across workers */
+#define PARALLEL_VALUES             ( ( 1<<17 ) + 3 )
+
+static const char *const g_pszKindNames[ kTenshiNumRndFills ] = {
+	"dword", "integer", "float", "double"
+};
+
+static void *DimArray( TenshiUIntPtr_t cItems, TenshiUIntPtr_t cItemBytes, TenshiType_t *pItemType )
+{
+	memset( ( void * )pItemType, 0, sizeof( *pItemType ) );
+	pItemType->Flags = kTenshiTypeF_FullTrivial;
+	pItemType->cBytes = cItemBytes;
+
+	return teArrayDim( &cItems, 1, pItemType );
+}
+
+static TenshiUIntPtr_t ValueBytes( TenshiUInt32_t Kind )
+{
+	return Kind == kTenshiRndFill_Float64 ? sizeof( double ) : sizeof( TenshiUInt32_t );
+}
+/* the value the fill should store next, from calls to tePCGRnd() */
+static void ExpectedValue( TenshiPCGState_t *r, TenshiUInt32_t Kind, double Low, double High, void *pDst )
+{
+	TenshiUInt32_t a, b;
+	TenshiUInt32_t uBound;
+	TenshiUInt64_t uBits;
+	TenshiInt32_t iValue;
+	float fValue;
+	double dValue;
+
+	switch( Kind ) {
+	case kTenshiRndFill_Bits32:
+		a = tePCGRnd( r );
+		memcpy( pDst, ( const void * )&a, 4 );
+		break;
+	case kTenshiRndFill_Int32:
+		a = tePCGRnd( r );
+		b = tePCGRnd( r );
+		uBound = ( TenshiUInt32_t )( TenshiInt32_t )High - ( TenshiUInt32_t )( TenshiInt32_t )Low;
+		uBits = ( TenshiUInt64_t )a*uBound + ( ( ( TenshiUInt64_t )b*uBound ) >> 32 );
+		iValue = ( TenshiInt32_t )( ( TenshiUInt32_t )( TenshiInt32_t )Low + ( TenshiUInt32_t )( uBits >> 32 ) );
+		memcpy( pDst, ( const void * )&iValue, 4 );
+		break;
+	case kTenshiRndFill_Float32:
+		a = tePCGRnd( r );
+		fValue = ( float )Low + ( float )( a >> 8 )*( 1.0f/16777216.0f )*( float )( High - Low );
+		memcpy( pDst, ( const void * )&fValue, 4 );
+		break;
+	case kTenshiRndFill_Float64:
+		a = tePCGRnd( r );
+		b = tePCGRnd( r );
+		uBits = ( ( TenshiUInt64_t )a << 32 | b ) >> 11;
+		dValue = Low + ( double )uBits*( 1.0/9007199254740992.0 )*( High - Low );
+		memcpy( pDst, ( const void * )&dValue, 8 );
+		break;
+	}
+}
+static int SameState( const TenshiPCGState_t *a, const TenshiPCGState_t *b )
+{
+	return a->state == b->state && a->inc == b->inc;
+}
+
+static void CheckJumps( void )
+{
+	TenshiPCGState_t r, s;
+	TenshiUInt32_t i;
+
+	tePCGRandomize( &r, 1234 );
+	s = r;
+	for( i = 0; i < 12345; ++i ) {
+		( void )tePCGRnd( &s );
+	}
+	tePCGAdvance( &r, 12345 );
+	CHECK( SameState( &r, &s ) );
+
+	tePCGAdvance( &r, 0 );
+	CHECK( SameState( &r, &s ) );
+
+	/* the period is 2^64 */
+	tePCGAdvance( &r, ~( TenshiUInt64_t )0 );
+	( void )tePCGRnd( &r );
+	CHECK( SameState( &r, &s ) );
+
+	tePCGSplit( &r, &s, 0 );
+	CHECK( SameState( &r, &s ) );
+	tePCGSplit( &r, &s, 3 );
+	tePCGAdvance( &s, ( TenshiUInt64_t )3 << 40 );
+	CHECK( SameState( &r, &s ) );
+}
+
+static void CheckFill( TenshiUInt32_t Kind, double Low, double High, TenshiUIntPtr_t cValues )
+{
+	TenshiPCGState_t r, s;
+	TenshiUInt8_t *pBuffer;
+	TenshiUInt8_t Expected[ 8 ];
+	TenshiUIntPtr_t cBytes;
+	TenshiUIntPtr_t cMismatches;
+	TenshiUIntPtr_t cOutside;
+	TenshiInt32_t iValue;
+	float fValue;
+	double dValue;
+	TenshiUIntPtr_t i;
+
+	cBytes = ValueBytes( Kind );
+
+	/* one byte in, so the values aren't aligned */
+	pBuffer = ( TenshiUInt8_t * )malloc( cValues*cBytes + 2 );
+	pBuffer[ 1 + cValues*cBytes ] = 0xA5;
+
+	tePCGRandomize( &r, NextRand() );
+	s = r;
+	tePCGFill( &r, ( void * )( pBuffer + 1 ), cValues, Kind, Low, High );
+
+	cMismatches = 0;
+	cOutside = 0;
+	for( i = 0; i < cValues; ++i ) {
+		ExpectedValue( &s, Kind, Low, High, ( void * )Expected );
+		cMismatches += memcmp( ( const void * )( pBuffer + 1 + i*cBytes ), ( const void * )Expected, cBytes ) != 0;
+
+		switch( Kind ) {
+		case kTenshiRndFill_Int32:
+			memcpy( ( void * )&iValue, ( const void * )Expected, 4 );
+			cOutside += Low < High && ( iValue < ( TenshiInt32_t )Low || iValue >= ( TenshiInt32_t )High );
+			cOutside += Low == High && iValue != ( TenshiInt32_t )Low;
+			break;
+		case kTenshiRndFill_Float32:
+			memcpy( ( void * )&fValue, ( const void * )Expected, 4 );
+			cOutside += fValue < ( float )Low || fValue > ( float )High;
+			break;
+		case kTenshiRndFill_Float64:
+			memcpy( ( void * )&dValue, ( const void * )Expected, 8 );
+			cOutside += dValue < Low || dValue >= High;
+			break;
+		}
+	}
+	CHECK( cMismatches == 0 );
+	CHECK( cOutside == 0 );
+	CHECK( SameState( &r, &s ) );
+	CHECK( pBuffer[ 1 + cValues*cBytes ] == 0xA5 );
+
+	free( ( void * )pBuffer );
+}
+static void CheckFills( void )
+{
+	static const TenshiUIntPtr_t Sizes[] = { 1, 2, 3, 4, 5, 7, 100, PARALLEL_VALUES };
+	static const TenshiUInt32_t Workers[] = { 1, 3, 4 };
+	TenshiUIntPtr_t s, w;
+
+	for( w = 0; w < sizeof( Workers )/sizeof( Workers[ 0 ] ); ++w ) {
+		teSetWorkerCount( Workers[ w ] );
+
+		for( s = 0; s < sizeof( Sizes )/sizeof( Sizes[ 0 ] ); ++s ) {
+			CheckFill( kTenshiRndFill_Bits32, 0.0, 0.0, Sizes[ s ] );
+			CheckFill( kTenshiRndFill_Int32, 1.0, 7.0, Sizes[ s ] );
+			CheckFill( kTenshiRndFill_Int32, -2000000000.0, 2000000000.0, Sizes[ s ] );
+			CheckFill( kTenshiRndFill_Int32, 5.0, 5.0, Sizes[ s ] );
+			CheckFill( kTenshiRndFill_Float32, -1.0, 1.0, Sizes[ s ] );
+			CheckFill( kTenshiRndFill_Float64, 0.0, 1.0, Sizes[ s ] );
+			CheckFill( kTenshiRndFill_Float64, 100.0, 200.0, Sizes[ s ] );
+		}
+	}
+
+	teSetWorkerCount( 0 );
+}
+
+#define LOOP_ITERATIONS             10000
+
+static void TENSHI_CALL DrawEach_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	TenshiUInt32_t *pValues;
+	TenshiInt64_t i;
+
+	( void )uChunk;
+
+	pValues = ( TenshiUInt32_t * )pContext;
+	for( i = iFirst; i < iLast; ++i ) {
+		pValues[ i ] = teRnd();
+	}
+}
+static void TENSHI_CALL DrawNothing_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	( void )pContext;
+	( void )uChunk;
+	( void )iFirst;
+	( void )iLast;
+}
+/* a PARALLEL FOR drawing RND for each iteration, then RND after it */
+static TenshiUInt32_t RunLoop( TenshiUInt32_t *pValues )
+{
+	teParallelFor( &DrawEach_f, ( void * )pValues, LOOP_ITERATIONS, teParallelChunks( LOOP_ITERATIONS ) );
+	return teRnd();
+}
+static void CheckLoopStreams( void )
+{
+	static const TenshiUInt32_t Workers[] = { 3, 4 };
+	TenshiUInt32_t *pFirst, *pSecond, *pValues;
+	TenshiUInt32_t uAfter, uAfterFirst;
+	TenshiUInt32_t a, b;
+	TenshiUIntPtr_t cSame;
+	TenshiUIntPtr_t w, i;
+
+	pFirst = ( TenshiUInt32_t * )malloc( LOOP_ITERATIONS*sizeof( TenshiUInt32_t ) );
+	pSecond = ( TenshiUInt32_t * )malloc( LOOP_ITERATIONS*sizeof( TenshiUInt32_t ) );
+	pValues = ( TenshiUInt32_t * )malloc( LOOP_ITERATIONS*sizeof( TenshiUInt32_t ) );
+
+	teSetWorkerCount( 1 );
+	teRandomize( 77 );
+	uAfterFirst = RunLoop( pFirst );
+	( void )RunLoop( pSecond );
+
+	/* the second loop got other streams */
+	cSame = 0;
+	for( i = 0; i < LOOP_ITERATIONS; ++i ) {
+		cSame += pFirst[ i ] == pSecond[ i ];
+	}
+	CHECK( cSame < 10 );
+
+	/* and more threads see the same values */
+	for( w = 0; w < sizeof( Workers )/sizeof( Workers[ 0 ] ); ++w ) {
+		teSetWorkerCount( Workers[ w ] );
+		teRandomize( 77 );
+
+		uAfter = RunLoop( pValues );
+		CHECK( uAfter == uAfterFirst );
+		CHECK( memcmp( ( const void * )pValues, ( const void * )pFirst, LOOP_ITERATIONS*sizeof( TenshiUInt32_t ) ) == 0 );
+	}
+
+	/* a loop that draws nothing leaves the generator be */
+	teRandomize( 5 );
+	teParallelFor( &DrawNothing_f, NULL, LOOP_ITERATIONS, teParallelChunks( LOOP_ITERATIONS ) );
+	a = teRnd();
+	teRandomize( 5 );
+	b = teRnd();
+	CHECK( a == b );
+
+	teSetWorkerCount( 0 );
+
+	free( ( void * )pValues );
+	free( ( void * )pSecond );
+	free( ( void * )pFirst );
+}
+
+static void CheckCommands( void )
+{
+	TenshiType_t IntType, DoubleType;
+	TenshiUInt32_t *pInts;
+	double *pDoubles;
+	TenshiIndex_t RNGNumber;
+	TenshiIndex_t MemblockNumber;
+	const TenshiUInt8_t *pMem;
+	float fValue;
+	TenshiUIntPtr_t cMismatches;
+	TenshiUIntPtr_t i;
+
+	pInts = ( TenshiUInt32_t * )DimArray( 1000, sizeof( *pInts ), &IntType );
+	pDoubles = ( double * )DimArray( 10, sizeof( *pDoubles ), &DoubleType );
+
+	/* the default generator, as RND would give */
+	teRandomize( 9 );
+	teArrayRandomize( ( void * )pInts, 0, kTenshiRndFill_Bits32, 0.0, 0.0 );
+	teRandomize( 9 );
+	cMismatches = 0;
+	for( i = 0; i < 1000; ++i ) {
+		cMismatches += pInts[ i ] != teRnd();
+	}
+	CHECK( cMismatches == 0 );
+
+	/* an RNG, as RNG GENERATE would give, and carried on from */
+	RNGNumber = teAllocRNG();
+	teRandomizeRNG( RNGNumber, 9 );
+	teArrayRandomize( ( void * )pInts, RNGNumber, kTenshiRndFill_Bits32, 0.0, 0.0 );
+	teRandomizeRNG( RNGNumber, 9 );
+	teRNGAdvance( RNGNumber, 999 );
+	CHECK( pInts[ 999 ] == teRNGGenerate( RNGNumber ) );
+
+	/* items of the wrong size are left alone */
+	pDoubles[ 0 ] = 4.0;
+	teArrayRandomize( ( void * )pDoubles, 0, kTenshiRndFill_Float32, 0.0, 1.0 );
+	CHECK( pDoubles[ 0 ] == 4.0 );
+
+	/* FLOATs one byte into a memblock, and nothing past its end */
+	MemblockNumber = teAllocMemblock( 4*100 + 1 );
+	pMem = ( const TenshiUInt8_t * )teGetMemblockPtr( MemblockNumber );
+	teFillMemblockRndFloat( MemblockNumber, 1, 100, 2.0f, 3.0f );
+	for( i = 0; i < 100; ++i ) {
+		memcpy( ( void * )&fValue, ( const void * )( pMem + 1 + i*4 ), 4 );
+		CHECK( fValue >= 2.0f && fValue <= 3.0f );
+	}
+	teFillMemblockRndRanged( MemblockNumber, 2, 100, 0, 10 );
+	CHECK( memcmp( ( const void * )&fValue, ( const void * )( pMem + 1 + 99*4 ), 4 ) == 0 );
+
+	teDeleteMemblock( MemblockNumber );
+	teDeleteRNG( RNGNumber );
+	teArrayUndim( ( void * )pDoubles );
+	teArrayUndim( ( void * )pInts );
+}
+
+static void PrintRate( const char *pszName, double fSeconds )
+{
+	printf( "  %-22s %8.1f M values/s\n", pszName, fSeconds > 0.0 ? ( double )BENCH_VALUES*BENCH_ROUNDS/fSeconds/1e6 : 0.0 );
+}
+
+static void Bench( void )
+{
+	TenshiPCGState_t r;
+	TenshiIndex_t RNGNumber;
+	TenshiUInt32_t *pValues;
+	TenshiUInt32_t uSum;
+	TenshiUInt32_t Kind;
+	TenshiUInt32_t Round;
+	TenshiUIntPtr_t i;
+	TenshiUInt64_t uStart;
+	char szName[ 32 ];
+
+	pValues = ( TenshiUInt32_t * )malloc( BENCH_VALUES*sizeof( double ) );
+	RNGNumber = teAllocRNG();
+
+	printf( "%u values, %u rounds, %u worker%s\n", ( unsigned )BENCH_VALUES, ( unsigned )BENCH_ROUNDS,
+		( unsigned )teGetWorkerCount(), teGetWorkerCount() == 1 ? "" : "s" );
+
+	uSum = 0;
+
+	uStart = tePerfTimer();
+	for( Round = 0; Round < BENCH_ROUNDS; ++Round ) {
+		for( i = 0; i < BENCH_VALUES; ++i ) {
+			pValues[ i ] = teRnd();
+		}
+		uSum += pValues[ Round ];
+	}
+	PrintRate( "RND loop", Seconds( uStart ) );
+
+	uStart = tePerfTimer();
+	for( Round = 0; Round < BENCH_ROUNDS; ++Round ) {
+		for( i = 0; i < BENCH_VALUES; ++i ) {
+			pValues[ i ] = teRNGGenerate( RNGNumber );
+		}
+		uSum += pValues[ Round ];
+	}
+	PrintRate( "RNG GENERATE loop", Seconds( uStart ) );
+
+	tePCGRandomize( &r, 1 );
+	for( Kind = 0; Kind < kTenshiNumRndFills; ++Kind ) {
+		uStart = tePerfTimer();
+		for( Round = 0; Round < BENCH_ROUNDS; ++Round ) {
+			tePCGFill( &r, ( void * )pValues, BENCH_VALUES, Kind, 0.0, 100.0 );
+			uSum += pValues[ Round ];
+		}
+
+		sprintf( szName, "fill (%s)", g_pszKindNames[ Kind ] );
+		PrintRate( szName, Seconds( uStart ) );
+	}
+
+	/* keep the loops from being thrown away */
+	if( uSum == 12345 ) {
+		printf( "\n" );
+	}
+
+	teDeleteRNG( RNGNumber );
+	free( ( void * )pValues );
+}
+
+void TenshiMain( void )
+{
+	CheckJumps();
+	CheckFills();
+	CheckLoopStreams();
+	CheckCommands();
+	Bench();
+
+	FinishChecks();
+}
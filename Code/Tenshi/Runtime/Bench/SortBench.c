@@ -0,0 +1,345 @@
+/*
+	Times SORT ARRAY against a heap sort written the way a Tenshi program
+	would have to write it (and against the C library's qsort), after
+	checking its order for every kind of key, ascending and descending, by
+	field, and that the stable sort keeps items with equal keys in order.
+	Sizes on either side of SORT_PARALLEL_MIN cover both the single thread
+	and the parallel paths.
+
+	Run with "bench.sh Sort".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_ITEMS
+# define BENCH_ITEMS                ( 1<<22 )
+#endif
+
+typedef struct Record_s {
+	TenshiInt32_t                   iId;
+	float                           fScore;
+	const char *                    pszName;
+	TenshiUInt16_t                  uGroup;
+} Record_t;
+
+static void *DimArray( TenshiUIntPtr_t cItems, TenshiUIntPtr_t cItemBytes, TenshiType_t *pItemType )
+{
+	memset( ( void * )pItemType, 0, sizeof( *pItemType ) );
+	pItemType->Flags = kTenshiTypeF_FullTrivial;
+	pItemType->cBytes = cItemBytes;
+
+	return teArrayDim( &cItems, 1, pItemType );
+}
+
+static int CompareStrings( const char *a, const char *b )
+{
+	return strcmp( a != NULL ? a : "", b != NULL ? b : "" );
+}
+
+static void CheckIntegers( TenshiUIntPtr_t cItems )
+{
+	TenshiType_t ItemType;
+	TenshiInt32_t *pInts;
+	TenshiInt64_t *pLongs;
+	TenshiUInt8_t *pBytes;
+	TenshiUIntPtr_t i;
+
+	pInts = ( TenshiInt32_t * )DimArray( cItems, sizeof( *pInts ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		pInts[ i ] = ( TenshiInt32_t )NextRand();
+	}
+	teArraySort( ( void * )pInts, 0, kTenshiSortKey_Int32, 0 );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pInts[ i - 1 ] <= pInts[ i ] );
+	}
+	teArraySort( ( void * )pInts, 0, kTenshiSortKey_Int32, kTenshiSortF_Descending );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pInts[ i - 1 ] >= pInts[ i ] );
+	}
+	teArrayUndim( ( void * )pInts );
+
+	pLongs = ( TenshiInt64_t * )DimArray( cItems, sizeof( *pLongs ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		pLongs[ i ] = ( TenshiInt64_t )( ( ( TenshiUInt64_t )NextRand() << 32 ) | NextRand() );
+	}
+	teArraySort( ( void * )pLongs, 0, kTenshiSortKey_Int64, 0 );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pLongs[ i - 1 ] <= pLongs[ i ] );
+	}
+	teArrayUndim( ( void * )pLongs );
+
+	/* few distinct keys, so most radix passes are skipped */
+	pBytes = ( TenshiUInt8_t * )DimArray( cItems, sizeof( *pBytes ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		pBytes[ i ] = ( TenshiUInt8_t )( NextRand() % 5 );
+	}
+	teArraySort( ( void * )pBytes, 0, kTenshiSortKey_UInt8, kTenshiSortF_Descending );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pBytes[ i - 1 ] >= pBytes[ i ] );
+	}
+	teArrayUndim( ( void * )pBytes );
+}
+
+static void CheckFloats( TenshiUIntPtr_t cItems )
+{
+	TenshiType_t ItemType;
+	double *pDoubles;
+	float *pFloats;
+	TenshiUIntPtr_t i;
+
+	pFloats = ( float * )DimArray( cItems, sizeof( *pFloats ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		pFloats[ i ] = ( float )( ( TenshiInt32_t )NextRand() )/1024.0f;
+	}
+	pFloats[ 0 ] = -0.0f;
+	pFloats[ cItems - 1 ] = 0.0f;
+	teArraySort( ( void * )pFloats, 0, kTenshiSortKey_Float32, 0 );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pFloats[ i - 1 ] <= pFloats[ i ] );
+	}
+	teArrayUndim( ( void * )pFloats );
+
+	pDoubles = ( double * )DimArray( cItems, sizeof( *pDoubles ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		pDoubles[ i ] = ( double )( ( TenshiInt32_t )NextRand() )*1e-3;
+	}
+	teArraySort( ( void * )pDoubles, 0, kTenshiSortKey_Float64, kTenshiSortF_Descending );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pDoubles[ i - 1 ] >= pDoubles[ i ] );
+	}
+	teArrayUndim( ( void * )pDoubles );
+}
+
+static void CheckStrings( TenshiUIntPtr_t cItems, char ( *pNames )[ 16 ] )
+{
+	TenshiType_t ItemType;
+	const char **ppStrs;
+	TenshiUIntPtr_t i;
+
+	ppStrs = ( const char ** )DimArray( cItems, sizeof( *ppStrs ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		ppStrs[ i ] = NextRand() % 50 != 0 ? pNames[ i ] : NULL;
+	}
+
+	teArraySort( ( void * )ppStrs, 0, kTenshiSortKey_String, 0 );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( CompareStrings( ppStrs[ i - 1 ], ppStrs[ i ] ) <= 0 );
+	}
+
+	teArraySort( ( void * )ppStrs, 0, kTenshiSortKey_String, kTenshiSortF_Descending );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( CompareStrings( ppStrs[ i - 1 ], ppStrs[ i ] ) >= 0 );
+	}
+
+	/* already sorted, and all equal: pdqsort's best and worst patterns */
+	teArraySort( ( void * )ppStrs, 0, kTenshiSortKey_String, kTenshiSortF_Descending );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( CompareStrings( ppStrs[ i - 1 ], ppStrs[ i ] ) >= 0 );
+	}
+	for( i = 0; i < cItems; ++i ) {
+		ppStrs[ i ] = "same";
+	}
+	teArraySort( ( void * )ppStrs, 0, kTenshiSortKey_String, 0 );
+	CHECK( strcmp( ppStrs[ cItems/2 ], "same" ) == 0 );
+
+	teArrayUndim( ( void * )ppStrs );
+}
+
+static void CheckRecords( TenshiUIntPtr_t cItems, char ( *pNames )[ 16 ] )
+{
+	TenshiType_t ItemType;
+	Record_t *pRecs;
+	TenshiUIntPtr_t i;
+
+	pRecs = ( Record_t * )DimArray( cItems, sizeof( *pRecs ), &ItemType );
+	for( i = 0; i < cItems; ++i ) {
+		pRecs[ i ].iId = ( TenshiInt32_t )i;
+		pRecs[ i ].fScore = ( float )( NextRand() % 1000 ) - 500.0f;
+		pRecs[ i ].pszName = pNames[ NextRand() % 100 ];
+		pRecs[ i ].uGroup = ( TenshiUInt16_t )( NextRand() % 7 );
+	}
+
+	/* stable sorts by the group, then by the score, leave ties by the id */
+	teArraySort( ( void * )pRecs, offsetof( Record_t, uGroup ), kTenshiSortKey_UInt16, kTenshiSortF_Stable );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pRecs[ i - 1 ].uGroup < pRecs[ i ].uGroup || ( pRecs[ i - 1 ].uGroup == pRecs[ i ].uGroup && pRecs[ i - 1 ].iId < pRecs[ i ].iId ) );
+	}
+	teArraySort( ( void * )pRecs, offsetof( Record_t, fScore ), kTenshiSortKey_Float32, kTenshiSortF_Stable | kTenshiSortF_Descending );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( pRecs[ i - 1 ].fScore > pRecs[ i ].fScore || ( pRecs[ i - 1 ].fScore == pRecs[ i ].fScore && ( pRecs[ i - 1 ].uGroup < pRecs[ i ].uGroup || ( pRecs[ i - 1 ].uGroup == pRecs[ i ].uGroup && pRecs[ i - 1 ].iId < pRecs[ i ].iId ) ) ) );
+	}
+
+	/* by the id again, then a stable sort by the name */
+	teArraySort( ( void * )pRecs, offsetof( Record_t, iId ), kTenshiSortKey_Int32, 0 );
+	for( i = 0; i < cItems; ++i ) {
+		CHECK( pRecs[ i ].iId == ( TenshiInt32_t )i );
+	}
+	teArraySort( ( void * )pRecs, offsetof( Record_t, pszName ), kTenshiSortKey_String, kTenshiSortF_Stable );
+	for( i = 1; i < cItems; ++i ) {
+		CHECK( strcmp( pRecs[ i - 1 ].pszName, pRecs[ i ].pszName ) < 0 || ( pRecs[ i - 1 ].pszName == pRecs[ i ].pszName && pRecs[ i - 1 ].iId < pRecs[ i ].iId ) );
+	}
+
+	teArrayUndim( ( void * )pRecs );
+}
+
+static void CheckSort( void )
+{
+	static const TenshiUIntPtr_t Sizes[] = { 2, 3, 17, 100, 1000, 65536 + 37, 300000 };
+	/* an odd count leaves a run unpaired in the parallel merge */
+	static const TenshiUInt32_t Workers[] = { 1, 3, 4 };
+	static char Names[ 300000 ][ 16 ];
+	TenshiUIntPtr_t i;
+	TenshiUInt32_t w;
+
+	/* long enough for some to share the compared prefix */
+	for( i = 0; i < sizeof( Names )/sizeof( Names[ 0 ] ); ++i ) {
+		sprintf( Names[ i ], "%s%u", NextRand() % 2 ? "name" : "nameplate", ( unsigned )( NextRand() % 1000000 ) );
+	}
+
+	for( w = 0; w < sizeof( Workers )/sizeof( Workers[ 0 ] ); ++w ) {
+		teSetWorkerCount( Workers[ w ] );
+
+		for( i = 0; i < sizeof( Sizes )/sizeof( Sizes[ 0 ] ); ++i ) {
+			CheckIntegers( Sizes[ i ] );
+			CheckFloats( Sizes[ i ] );
+			CheckStrings( Sizes[ i ], Names );
+			CheckRecords( Sizes[ i ], Names );
+		}
+	}
+	teSetWorkerCount( 0 );
+
+	/* a key past the end of the items is refused, leaving them as they were */
+	{
+		TenshiType_t ItemType;
+		TenshiUInt16_t *pShorts;
+
+		pShorts = ( TenshiUInt16_t * )DimArray( 2, sizeof( *pShorts ), &ItemType );
+		pShorts[ 0 ] = 2;
+		pShorts[ 1 ] = 1;
+		teArraySort( ( void * )pShorts, 0, kTenshiSortKey_UInt32, 0 );
+		CHECK( pShorts[ 0 ] == 2 && pShorts[ 1 ] == 1 );
+		teArrayUndim( ( void * )pShorts );
+	}
+}
+
+/* what a Tenshi program has to do without SORT ARRAY: no recursion, no calls */
+static void ScriptHeapSort( TenshiInt32_t *pItems, TenshiUIntPtr_t cItems )
+{
+	TenshiUIntPtr_t uStart, uEnd;
+	TenshiUIntPtr_t uRoot, uChild;
+	TenshiInt32_t iTemp;
+
+	uStart = cItems/2;
+	uEnd = cItems;
+	while( uEnd > 1 ) {
+		if( uStart > 0 ) {
+			--uStart;
+		} else {
+			--uEnd;
+			iTemp = pItems[ uEnd ];
+			pItems[ uEnd ] = pItems[ 0 ];
+			pItems[ 0 ] = iTemp;
+		}
+
+		uRoot = uStart;
+		while( uRoot*2 + 1 < uEnd ) {
+			uChild = uRoot*2 + 1;
+			if( uChild + 1 < uEnd && pItems[ uChild ] < pItems[ uChild + 1 ] ) {
+				++uChild;
+			}
+			if( pItems[ uRoot ] >= pItems[ uChild ] ) {
+				break;
+			}
+
+			iTemp = pItems[ uRoot ];
+			pItems[ uRoot ] = pItems[ uChild ];
+			pItems[ uChild ] = iTemp;
+			uRoot = uChild;
+		}
+	}
+}
+
+static int CompareInt32( const void *a, const void *b )
+{
+	const TenshiInt32_t x = *( const TenshiInt32_t * )a;
+	const TenshiInt32_t y = *( const TenshiInt32_t * )b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+static int CompareRefs( const void *a, const void *b )
+{
+	return strcmp( *( const char *const * )a, *( const char *const * )b );
+}
+
+static void Bench( void )
+{
+	static TenshiInt32_t Source[ BENCH_ITEMS ];
+	static char Names[ BENCH_ITEMS ][ 12 ];
+	TenshiType_t ItemType;
+	TenshiInt32_t *pInts;
+	const char **ppStrs;
+	TenshiUInt64_t uStart;
+	TenshiUIntPtr_t i;
+	double ScriptInts, QsortInts, SortInts;
+	double QsortStrs, SortStrs;
+
+	for( i = 0; i < BENCH_ITEMS; ++i ) {
+		Source[ i ] = ( TenshiInt32_t )NextRand();
+		sprintf( Names[ i ], "%08x", ( unsigned )NextRand() );
+	}
+
+	pInts = ( TenshiInt32_t * )DimArray( BENCH_ITEMS, sizeof( *pInts ), &ItemType );
+
+	memcpy( ( void * )pInts, ( const void * )Source, sizeof( Source ) );
+	uStart = tePerfTimer();
+	ScriptHeapSort( pInts, BENCH_ITEMS );
+	ScriptInts = Seconds( uStart );
+
+	memcpy( ( void * )pInts, ( const void * )Source, sizeof( Source ) );
+	uStart = tePerfTimer();
+	qsort( ( void * )pInts, BENCH_ITEMS, sizeof( *pInts ), &CompareInt32 );
+	QsortInts = Seconds( uStart );
+
+	memcpy( ( void * )pInts, ( const void * )Source, sizeof( Source ) );
+	uStart = tePerfTimer();
+	teArraySort( ( void * )pInts, 0, kTenshiSortKey_Int32, 0 );
+	SortInts = Seconds( uStart );
+
+	for( i = 1; i < BENCH_ITEMS; ++i ) {
+		CHECK( pInts[ i - 1 ] <= pInts[ i ] );
+	}
+	teArrayUndim( ( void * )pInts );
+
+	ppStrs = ( const char ** )DimArray( BENCH_ITEMS, sizeof( *ppStrs ), &ItemType );
+
+	for( i = 0; i < BENCH_ITEMS; ++i ) {
+		ppStrs[ i ] = Names[ i ];
+	}
+	uStart = tePerfTimer();
+	qsort( ( void * )ppStrs, BENCH_ITEMS, sizeof( *ppStrs ), &CompareRefs );
+	QsortStrs = Seconds( uStart );
+
+	for( i = 0; i < BENCH_ITEMS; ++i ) {
+		ppStrs[ i ] = Names[ i ];
+	}
+	uStart = tePerfTimer();
+	teArraySort( ( void * )ppStrs, 0, kTenshiSortKey_String, 0 );
+	SortStrs = Seconds( uStart );
+
+	for( i = 1; i < BENCH_ITEMS; ++i ) {
+		CHECK( strcmp( ppStrs[ i - 1 ], ppStrs[ i ] ) <= 0 );
+	}
+	teArrayUndim( ( void * )ppStrs );
+
+	printf( "%u items, %u workers\n", ( unsigned )BENCH_ITEMS, ( unsigned )teGetWorkerCount() );
+	printf( "  integers: script heap sort %.3f s, qsort %.3f s, sort array %.3f s (%.1fx)\n", ScriptInts, QsortInts, SortInts, SortInts > 0.0 ? ScriptInts/SortInts : 0.0 );
+	printf( "  strings:  qsort %.3f s, sort array %.3f s (%.1fx)\n", QsortStrs, SortStrs, SortStrs > 0.0 ? QsortStrs/SortStrs : 0.0 );
+}
+
+void TenshiMain( void )
+{
+	CheckSort();
+	Bench();
+
+	FinishChecks();
+}
@@ -0,0 +1,283 @@
+/*
+	Counts the allocations made by string concatenation chains, the way the
+	compiler used to generate them (a new string from teStrConcat for every
+	"+") against the way it generates them now (the chain's first temporary
+	grown with teStrAppend), then times both. Each chain is run as the
+	assignment statement it comes from:
+
+		- Literals are read in place (the str-literals pass drops their copies).
+		- Numbers are converted to temporary strings, reclaimed at the end of
+		  the statement along with any other temporaries.
+		- The result is moved into the variable and its old value reclaimed.
+
+	An allocation is a call that returns a new block: teStrConcat, a number's
+	conversion, or a teStrAppend whose realloc had to move the string. A
+	teStrAppend that grew the string where it was is counted separately.
+
+	Run with "bench.sh Str".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_ITEMS
+# define BENCH_ITEMS                ( 1<<18 )
+#endif
+
+#define MAX_OPERANDS                16
+
+typedef enum
+{
+	kOperand_Variable,
+	kOperand_Literal,
+	kOperand_Integer
+} EOperand_t;
+
+typedef struct Operand_s {
+	EOperand_t                      Kind;
+	const char *                    pszText;
+	TenshiInt32_t                   iValue;
+} Operand_t;
+
+typedef struct Chain_s {
+	const char *                    pszSource;
+	unsigned                        cOperands;
+	Operand_t                       Operands[ MAX_OPERANDS ];
+} Chain_t;
+
+typedef struct Counts_s {
+	unsigned long                   cAllocs;
+	unsigned long                   cGrownInPlace;
+} Counts_t;
+
+static const Chain_t g_Chains[] = {
+	{
+		"s = a + \", \" + b + \"!\"",
+		4, {
+			{ kOperand_Variable, "Hello", 0 },
+			{ kOperand_Literal, ", ", 0 },
+			{ kOperand_Variable, "World", 0 },
+			{ kOperand_Literal, "!", 0 }
+		}
+	},
+	{
+		"s = a + i + b",
+		3, {
+			{ kOperand_Variable, "Hello", 0 },
+			{ kOperand_Integer, NULL, 12345 },
+			{ kOperand_Variable, "World", 0 }
+		}
+	},
+	{
+		"s = i + \": \" + a",
+		3, {
+			{ kOperand_Integer, NULL, 7 },
+			{ kOperand_Literal, ": ", 0 },
+			{ kOperand_Variable, "Hello", 0 }
+		}
+	},
+	{
+		"line = \"Item \" + i + \": \" + name + \" (\" + n + \" left)\"",
+		7, {
+			{ kOperand_Literal, "Item ", 0 },
+			{ kOperand_Integer, NULL, 42 },
+			{ kOperand_Literal, ": ", 0 },
+			{ kOperand_Variable, "Potion of Minor Healing", 0 },
+			{ kOperand_Literal, " (", 0 },
+			{ kOperand_Integer, NULL, 3 },
+			{ kOperand_Literal, " left)", 0 }
+		}
+	},
+	{
+		"csv = x + \",\" + y + \",\" + z + \",\" + w + \",\" + v + \",\" + u",
+		11, {
+			{ kOperand_Variable, "1.5", 0 },
+			{ kOperand_Literal, ",", 0 },
+			{ kOperand_Variable, "-2.25", 0 },
+			{ kOperand_Literal, ",", 0 },
+			{ kOperand_Variable, "3.125", 0 },
+			{ kOperand_Literal, ",", 0 },
+			{ kOperand_Variable, "0", 0 },
+			{ kOperand_Literal, ",", 0 },
+			{ kOperand_Variable, "17", 0 },
+			{ kOperand_Literal, ",", 0 },
+			{ kOperand_Variable, "255", 0 }
+		}
+	}
+};
+
+/* the operand as a string; numbers become temporaries of the statement */
+static char *OperandString( const Operand_t *pOperand, char **ppTemps, unsigned *pcTemps, int *pbIsTemp, Counts_t *pCounts )
+{
+	char *p;
+
+	if( pOperand->Kind != kOperand_Integer ) {
+		*pbIsTemp = 0;
+		return ( char * )pOperand->pszText;
+	}
+
+	p = teCastInt32ToStr( pOperand->iValue );
+	++pCounts->cAllocs;
+
+	ppTemps[ ( *pcTemps )++ ] = p;
+	*pbIsTemp = 1;
+
+	return p;
+}
+
+/*
+	runs one chain as "Var = <chain>", growing the first temporary when
+	bAppend is set; returns the variable's new value
+*/
+static char *RunChain( const Chain_t *pChain, int bAppend, char *pOldVar, Counts_t *pCounts )
+{
+	char *pTemps[ MAX_OPERANDS*2 ];
+	unsigned cTemps;
+	char *pLeft, *pRight, *p;
+	int bLeftIsTemp, bRightIsTemp;
+	unsigned i, j;
+
+	cTemps = 0;
+
+	pLeft = OperandString( &pChain->Operands[ 0 ], pTemps, &cTemps, &bLeftIsTemp, pCounts );
+	for( i = 1; i < pChain->cOperands; ++i ) {
+		pRight = OperandString( &pChain->Operands[ i ], pTemps, &cTemps, &bRightIsTemp, pCounts );
+
+		if( bAppend && bLeftIsTemp ) {
+			/* the temporary is taken back from the clean-up list... */
+			for( j = 0; j < cTemps; ++j ) {
+				if( pTemps[ j ] == pLeft ) {
+					pTemps[ j ] = pTemps[ --cTemps ];
+					break;
+				}
+			}
+
+			p = teStrAppend( pLeft, pRight );
+			if( p != pLeft ) {
+				++pCounts->cAllocs;
+			} else {
+				++pCounts->cGrownInPlace;
+			}
+		} else {
+			p = teStrConcat( pLeft, pRight );
+			++pCounts->cAllocs;
+		}
+
+		/* ...and the result goes on it in its place */
+		pTemps[ cTemps++ ] = p;
+
+		pLeft = p;
+		bLeftIsTemp = 1;
+	}
+
+	/* the result is a temporary, so it's moved into the variable */
+	for( j = 0; j < cTemps; ++j ) {
+		if( pTemps[ j ] == pLeft ) {
+			pTemps[ j ] = pTemps[ --cTemps ];
+			break;
+		}
+	}
+	teStrReclaim( pOldVar );
+
+	for( j = 0; j < cTemps; ++j ) {
+		teStrReclaim( pTemps[ j ] );
+	}
+
+	return pLeft;
+}
+
+static void CheckChains( void )
+{
+	Counts_t Counts;
+	char *pPerLink, *pAppended;
+	size_t i;
+
+	for( i = 0; i < sizeof( g_Chains )/sizeof( g_Chains[ 0 ] ); ++i ) {
+		memset( ( void * )&Counts, 0, sizeof( Counts ) );
+
+		pPerLink = RunChain( &g_Chains[ i ], 0, NULL, &Counts );
+		pAppended = RunChain( &g_Chains[ i ], 1, NULL, &Counts );
+
+		CHECK( pPerLink != NULL && pAppended != NULL );
+		CHECK( strcmp( pPerLink, pAppended ) == 0 );
+
+		teStrReclaim( pAppended );
+		teStrReclaim( pPerLink );
+	}
+
+	/* random chains of every kind of operand; NULL is the empty string */
+	for( i = 0; i < 256; ++i ) {
+		static const char *const pszTexts[] = {
+			NULL, "x", ", ", "Hello", "0123456789abcdef", "0123456789abcdef0123456789abcdef0123456789abcdef"
+		};
+		Chain_t Chain;
+		unsigned j;
+
+		Chain.pszSource = "random";
+		Chain.cOperands = 2 + NextRand()%( MAX_OPERANDS - 1 );
+		for( j = 0; j < Chain.cOperands; ++j ) {
+			Chain.Operands[ j ].Kind = ( EOperand_t )( NextRand()%3 );
+			Chain.Operands[ j ].pszText = pszTexts[ NextRand()%( sizeof( pszTexts )/sizeof( pszTexts[ 0 ] ) ) ];
+			Chain.Operands[ j ].iValue = ( TenshiInt32_t )NextRand();
+		}
+
+		pPerLink = RunChain( &Chain, 0, NULL, &Counts );
+		pAppended = RunChain( &Chain, 1, NULL, &Counts );
+
+		CHECK( strcmp( pPerLink != NULL ? pPerLink : "", pAppended != NULL ? pAppended : "" ) == 0 );
+
+		teStrReclaim( pAppended );
+		teStrReclaim( pPerLink );
+	}
+
+	pAppended = RunChain( &g_Chains[ 0 ], 1, NULL, &Counts );
+	CHECK( strcmp( pAppended, "Hello, World!" ) == 0 );
+	teStrReclaim( pAppended );
+
+	pAppended = RunChain( &g_Chains[ 3 ], 1, NULL, &Counts );
+	CHECK( strcmp( pAppended, "Item 42: Potion of Minor Healing (3 left)" ) == 0 );
+	teStrReclaim( pAppended );
+}
+
+static void Bench( void )
+{
+	Counts_t Counts[ 2 ];
+	double Times[ 2 ];
+	TenshiUInt64_t uStart;
+	char *pVar;
+	size_t i;
+	unsigned long n;
+	int bAppend;
+
+	printf( "%u runs of each chain; allocations per run (in-place growths)\n", ( unsigned )BENCH_ITEMS );
+
+	for( i = 0; i < sizeof( g_Chains )/sizeof( g_Chains[ 0 ] ); ++i ) {
+		for( bAppend = 0; bAppend < 2; ++bAppend ) {
+			memset( ( void * )&Counts[ bAppend ], 0, sizeof( Counts[ bAppend ] ) );
+
+			pVar = NULL;
+			uStart = tePerfTimer();
+			for( n = 0; n < BENCH_ITEMS; ++n ) {
+				pVar = RunChain( &g_Chains[ i ], bAppend, pVar, &Counts[ bAppend ] );
+			}
+			Times[ bAppend ] = Seconds( uStart );
+			teStrReclaim( pVar );
+		}
+
+		printf( "  %s\n", g_Chains[ i ].pszSource );
+		printf( "    per link   %5.2f allocs,         %6.1f ns\n",
+			( double )Counts[ 0 ].cAllocs/BENCH_ITEMS,
+			Times[ 0 ]*1e9/BENCH_ITEMS );
+		printf( "    appended   %5.2f allocs (%4.2f), %6.1f ns\n",
+			( double )Counts[ 1 ].cAllocs/BENCH_ITEMS,
+			( double )Counts[ 1 ].cGrownInPlace/BENCH_ITEMS,
+			Times[ 1 ]*1e9/BENCH_ITEMS );
+	}
+}
+
+void TenshiMain( void )
+{
+	CheckChains();
+	Bench();
+
+	FinishChecks();
+}
@@ -0,0 +1,130 @@
+/*
+	Times a loop's sync points the way the compiler generates them: a
+	countdown from teSyncCountdown kept in a local, with teSafeSync called
+	each time it runs out. First checks that teSafeSync calls the host only
+	from outside of PARALLEL FOR bodies (a FUNCTION with a loop may be called
+	from one), with any number of workers.
+
+	Run with "bench.sh Sync".
+*/
+
+#include "Bench.h"
+
+#ifndef BENCH_ITERATIONS
+# define BENCH_ITERATIONS           ( 1<<26 )
+#endif
+
+#define LOOP_ITERATIONS             ( ( 1<<12 ) + 5 )
+
+/* the host's sync; asks the program to stop when bQuit is set */
+static volatile int g_cHostSyncs = 0;
+static volatile int g_bQuit = 0;
+
+static int TENSHI_CALL HostSync_f( void )
+{
+	++g_cHostSyncs;
+	return !g_bQuit;
+}
+
+/* a loop body calling a FUNCTION whose own loop syncs on every iteration */
+static void TENSHI_CALL SyncEach_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	int *pbLeft;
+	TenshiInt64_t i;
+
+	( void )uChunk;
+
+	pbLeft = ( int * )pContext;
+	for( i = iFirst; i < iLast; ++i ) {
+		if( !teSafeSync() ) {
+			pbLeft[ i ] = 1;
+		}
+	}
+}
+
+static void CheckSync( void )
+{
+	static const TenshiUInt32_t Workers[] = { 1, 3, 4 };
+	TenshiRuntimeGlob_t *pGlob;
+	int *pbLeft;
+	TenshiUIntPtr_t w, i;
+
+	pGlob = teGetGlob();
+	pGlob->pfnSafeSyncCallback = &HostSync_f;
+
+	/* outside of a loop the host is asked every time */
+	g_bQuit = 0;
+	g_cHostSyncs = 0;
+	CHECK( teSafeSync() == 1 );
+	CHECK( g_cHostSyncs == 1 );
+	CHECK( teSyncCountdown == ( TenshiInt32_t )( pGlob->cSyncInterval & 0x7FFFFFFF ) );
+
+	g_bQuit = 1;
+	CHECK( teSafeSync() == 0 );
+	CHECK( g_cHostSyncs == 2 );
+
+	/* within one it isn't, even when the program is being stopped */
+	pbLeft = ( int * )malloc( LOOP_ITERATIONS*sizeof( int ) );
+	for( w = 0; w < sizeof( Workers )/sizeof( Workers[ 0 ] ); ++w ) {
+		teSetWorkerCount( Workers[ w ] );
+
+		memset( ( void * )pbLeft, 0, LOOP_ITERATIONS*sizeof( int ) );
+		g_cHostSyncs = 0;
+
+		teParallelFor( &SyncEach_f, ( void * )pbLeft, LOOP_ITERATIONS, teParallelChunks( LOOP_ITERATIONS ) );
+
+		CHECK( g_cHostSyncs == 0 );
+		for( i = 0; i < LOOP_ITERATIONS; ++i ) {
+			if( pbLeft[ i ] ) {
+				break;
+			}
+		}
+		CHECK( i == LOOP_ITERATIONS );
+	}
+	teSetWorkerCount( 0 );
+	free( ( void * )pbLeft );
+
+	/* and after it, it's asked again */
+	g_cHostSyncs = 0;
+	CHECK( teSafeSync() == 0 );
+	CHECK( g_cHostSyncs == 1 );
+
+	g_bQuit = 0;
+}
+
+static void Bench( void )
+{
+	TenshiUInt64_t uStart;
+	TenshiInt32_t iCountdown;
+	double Time;
+	unsigned long n;
+
+	g_cHostSyncs = 0;
+
+	/* as LowerSyncPoint and ShareSyncCountdown generate it */
+	uStart = tePerfTimer();
+	iCountdown = teSyncCountdown;
+	for( n = 0; n < BENCH_ITERATIONS; ++n ) {
+		if( --iCountdown <= 0 ) {
+			if( !teSafeSync() ) {
+				break;
+			}
+			iCountdown = teSyncCountdown;
+		}
+	}
+	teSyncCountdown = iCountdown;
+	Time = Seconds( uStart );
+
+	CHECK( n == BENCH_ITERATIONS );
+
+	printf( "%u iterations, a sync every %u\n", ( unsigned )BENCH_ITERATIONS, ( unsigned )teGetGlob()->cSyncInterval );
+	printf( "  %6.2f ns per iteration, %i host syncs\n", Time*1e9/BENCH_ITERATIONS, g_cHostSyncs );
+}
+
+void TenshiMain( void )
+{
+	CheckSync();
+	Bench();
+
+	FinishChecks();
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# Builds one of the runtime benchmarks with the runtime, then runs it:
+#
+#   bench.sh Map [compiler flags...]
+#   bench.sh List [compiler flags...]
+#   bench.sh Sort [compiler flags...]
+#   bench.sh Bulk [compiler flags...]
+#   bench.sh Math [compiler flags...]
+#   bench.sh Rng [compiler flags...]
+#   bench.sh Grid [compiler flags...]
+#   bench.sh Str [compiler flags...]
+#   bench.sh Sync [compiler flags...]
+#
+# Each checks its collection before timing it. Pass -DSSE2_ENABLED=0 to time
+# the map's portable group probing, the bulk operations' plain loops, or the
+# batch math's scalar functions, instead.
+#
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 <Map|List|Sort|Bulk|Math|Rng|Grid|Str|Sync> [compiler flags...]" >&2
+	exit 1
+fi
+
+BENCH="$1"
+shift
+
+CFLAGS="-W -Wall -pedantic -std=gnu99 -O2"
+
+# The runtime spells out its CRT constructor's calling convention
+case "$(uname -s)" in
+	MINGW*|MSYS*|CYGWIN*) ;;
+	*) CFLAGS="$CFLAGS -D__cdecl=" ;;
+esac
+
+set -e
+cd "$(dirname "$0")"
+
+gcc $CFLAGS "$@" -o "${BENCH}Bench" ../TenshiRuntime.c "${BENCH}Bench.c" -lm -lpthread
+"./${BENCH}Bench"
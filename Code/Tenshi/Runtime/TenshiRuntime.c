@@ -1,5 +1,6 @@
 #ifdef _WIN32
 # define TENSHI_FUNC                __declspec( dllexport )
+# define TENSHI_DATA                extern __declspec( dllexport )
 # if defined( __GNUC__ )
 #  include <_mingw.h>
 #  undef MINGW_HAS_SECURE_API       /* No, you really don't. */
@@ -9,6 +10,10 @@
 # include <Windows.h>
 # undef min
 # undef max
+#else
+# include <pthread.h>
+# include <time.h>
+# include <unistd.h>
 #endif
 
 #define TENSHI_STATIC_LINK_ENABLED  1
@@ -30,6 +35,12 @@
 # define CURRENT_FUNCTION           __func__
 #endif
 
+#ifdef _MSC_VER
+# define THREAD_LOCAL               __declspec( thread )
+#else
+# define THREAD_LOCAL               __thread
+#endif
+
 #ifndef TRACE_ENABLED
 # ifdef _DEBUG
 #  define TRACE_ENABLED             1
@@ -53,6 +64,17 @@
 # endif
 #endif
 
+#ifndef SSE2_ENABLED
+# if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define SSE2_ENABLED              1
+# else
+#  define SSE2_ENABLED              0
+# endif
+#endif
+#if SSE2_ENABLED
+# include <emmintrin.h>
+#endif
+
 #if TRACE_ENABLED
 # define TRACE(...)                 teLogf(\
 										TELOG_DEBUG | TENSHI_FACILITY | TELOG_C_TRACE,\
@@ -90,6 +112,9 @@ static struct TenshiEngineTypes_s   g_EngineTypes;
 static struct TenshiMemblockAPI_s   g_MemblockAPI;
 static struct TenshiLoggingAPI_s    g_LoggingAPI;
 static TenshiObjectPool_t *         g_RNGPool;
+static TenshiObjectPool_t *         g_MapPool;
+
+static void teStopWorkers( void );
 
 
 /*
@@ -518,6 +543,44 @@ TENSHI_FUNC void TENSHI_CALL teRuntimeError( TenshiReportFacility_t Facility, co
 
 
 
+/*
+===============================================================================
+
+	SYNCHRONIZATION
+
+===============================================================================
+*/
+
+#ifdef _MSC_VER
+# define teAtomicClaim(p_)          ( ( TenshiUInt32_t )InterlockedIncrement( ( volatile LONG * )( p_ ) ) - 1 )
+#else
+# define teAtomicClaim(p_)          __sync_fetch_and_add( ( p_ ), 1 )
+#endif
+
+#ifdef _WIN32
+typedef SRWLOCK                     TenshiMutex_t;
+typedef CONDITION_VARIABLE          TenshiCondVar_t;
+typedef HANDLE                      TenshiThread_t;
+# define TENSHI_MUTEX_INIT          SRWLOCK_INIT
+# define TENSHI_CONDVAR_INIT        CONDITION_VARIABLE_INIT
+# define teMutexLock(p_)            AcquireSRWLockExclusive( p_ )
+# define teMutexUnlock(p_)          ReleaseSRWLockExclusive( p_ )
+# define teCondWait(c_,m_)          SleepConditionVariableSRW( ( c_ ), ( m_ ), INFINITE, 0 )
+# define teCondBroadcast(c_)        WakeAllConditionVariable( c_ )
+#else
+typedef pthread_mutex_t             TenshiMutex_t;
+typedef pthread_cond_t              TenshiCondVar_t;
+typedef pthread_t                   TenshiThread_t;
+# define TENSHI_MUTEX_INIT          PTHREAD_MUTEX_INITIALIZER
+# define TENSHI_CONDVAR_INIT        PTHREAD_COND_INITIALIZER
+# define teMutexLock(p_)            pthread_mutex_lock( p_ )
+# define teMutexUnlock(p_)          pthread_mutex_unlock( p_ )
+# define teCondWait(c_,m_)          pthread_cond_wait( ( c_ ), ( m_ ) )
+# define teCondBroadcast(c_)        pthread_cond_broadcast( c_ )
+#endif
+
+
+
 /*
 ===============================================================================
 
@@ -532,14 +595,48 @@ typedef void( TENSHI_CALL *FnPluginFini_t )( void );
 extern const char *                 tenshi__modNames__[];
 extern FnPluginInit_t               tenshi__modInits__[];
 extern FnPluginFini_t               tenshi__modFinis__[];
+extern TenshiUIntPtr_t *            tenshi__modStates__[];
 
 extern TenshiUIntPtr_t              tenshi__numMods__;
 
+/*
+	A module's Init runs the first time the program calls into the module
+	rather than at startup, so a program only pays for the modules it
+	actually uses. The compiler gives each such module a state word, checks
+	it before calling any of the module's commands, and calls teInitModule()
+	while it is still zero. Once set, the state holds the order the module
+	was initialized in (starting at 1) so FiniModules() can close modules in
+	reverse.
+
+	Modules without a state (no Init, or never checked by the compiler) are
+	initialized at startup, and closed after the others.
+*/
+
+static TenshiMutex_t                g_ModLock = TENSHI_MUTEX_INIT;
+static TenshiUIntPtr_t              g_cLazyMods = 0;
+
+#ifdef _MSC_VER
+# define teAtomicPublish(p_,v_)     ( ( void )InterlockedExchangePointer( ( PVOID volatile * )( p_ ), ( PVOID )( v_ ) ) )
+#else
+# define teAtomicPublish(p_,v_)     __atomic_store_n( ( p_ ), ( v_ ), __ATOMIC_RELEASE )
+#endif
+
 static const char *StrOrNull( const char *p )
 {
 	return !!p ? p : "(null)";
 }
 
+static void CloseModule( TenshiUIntPtr_t i )
+{
+	TRACE( "Closing module '%s'...", StrOrNull( tenshi__modNames__[ i ] ) );
+
+	if( !tenshi__modFinis__[ i ] ) {
+		return;
+	}
+
+	tenshi__modFinis__[ i ]();
+}
+
 static void InitModules( void )
 {
 	TenshiUIntPtr_t i;
@@ -555,6 +652,10 @@ static void InitModules( void )
 			TRACE( "Module '%s' has no initialization routine... Skipping.", pszModName );
 			continue;
 		}
+		if( tenshi__modStates__[ i ] != NULL ) {
+			TRACE( "Module '%s' is initialized on first use... Skipping.", pszModName );
+			continue;
+		}
 
 		TRACE( "Initializing module '%s'...", pszModName );
 		if( tenshi__modInits__[ i ]( &g_RTGlob ) & 1 ) {
@@ -565,13 +666,11 @@ static void InitModules( void )
 		TRACE( "Module initialization failed." );
 		while( i > 0 ) {
 			--i;
-			TRACE( "Closing module '%s'...",
-				StrOrNull( tenshi__modNames__[ i ] ) );
-			if( !tenshi__modFinis__[ i ] ) {
+			if( tenshi__modStates__[ i ] != NULL ) {
 				continue;
 			}
 
-			tenshi__modFinis__[ i ]();
+			CloseModule( i );
 		}
 
 		fprintf( stderr, "ERROR: Failed to initialize module \"%s\"\n", pszModName );
@@ -584,31 +683,114 @@ static void InitModules( void )
 }
 static void FiniModules( void )
 {
-	TenshiUIntPtr_t i;
+	TenshiUIntPtr_t i, j;
 
 	TRACE( "Enter" );
 
+	/* modules initialized on first use, in reverse */
+	for( j = g_cLazyMods; j > 0; --j ) {
+		for( i = 0; i < tenshi__numMods__; ++i ) {
+			if( tenshi__modStates__[ i ] != NULL && *tenshi__modStates__[ i ] == j ) {
+				CloseModule( i );
+				break;
+			}
+		}
+	}
+
+	/* modules initialized at startup */
 	i = tenshi__numMods__;
 	while( i > 0 ) {
 		--i;
 
-#if TRACE_ENABLED
-		const char *pszModName;
-		
-		pszModName = StrOrNull( tenshi__modNames__[ i ] );
-
-		TRACE( "Closing module '%s'...", pszModName );
-#endif
-		if( !tenshi__modFinis__[ i ] ) {
+		if( tenshi__modStates__[ i ] != NULL ) {
 			continue;
 		}
 
-		tenshi__modFinis__[ i ]();
+		CloseModule( i );
 	}
 
 	TRACE( "Leave" );
 }
 
+TENSHI_FUNC void TENSHI_CALL teInitModule( TenshiUIntPtr_t *pState )
+{
+	TenshiUIntPtr_t i;
+	const char *pszModName;
+
+	teMutexLock( &g_ModLock );
+
+	/* another thread may have finished it while this one waited */
+	if( *pState != 0 ) {
+		teMutexUnlock( &g_ModLock );
+		return;
+	}
+
+	for( i = 0; i < tenshi__numMods__; ++i ) {
+		if( tenshi__modStates__[ i ] == pState ) {
+			break;
+		}
+	}
+
+	if( i == tenshi__numMods__ || !tenshi__modInits__[ i ] ) {
+		TRACE( "Unknown module state %p", ( void * )pState );
+		teMutexUnlock( &g_ModLock );
+		return;
+	}
+
+	pszModName = StrOrNull( tenshi__modNames__[ i ] );
+
+	TRACE( "Initializing module '%s'...", pszModName );
+	if( !( tenshi__modInits__[ i ]( &g_RTGlob ) & 1 ) ) {
+		TRACE( "Module initialization failed." );
+		teMutexUnlock( &g_ModLock );
+
+		fprintf( stderr, "ERROR: Failed to initialize module \"%s\"\n", pszModName );
+		exit( EXIT_FAILURE );
+	}
+	TRACE( "Module initialization succeeded." );
+
+	/* only publish the state once everything Init did is visible */
+	teAtomicPublish( pState, ++g_cLazyMods );
+
+	teMutexUnlock( &g_ModLock );
+}
+
+
+/*
+===============================================================================
+
+	PROFILING
+
+===============================================================================
+*/
+
+/*
+	Programs built with --profile-generate carry LLVM's instrumentation and
+	are linked against its profile runtime. Defining __llvm_profile_runtime
+	here keeps that runtime from installing its own exit handler, so the
+	profile is written from teFini() instead, after the modules have shut
+	down. Other programs never pull the profile writer in.
+*/
+#if defined( __GNUC__ ) && !defined( _WIN32 )
+int                                 __llvm_profile_runtime;
+extern int                          __llvm_profile_write_file( void ) __attribute__((weak));
+#endif
+
+static void WriteProfile( void )
+{
+#if defined( __GNUC__ ) && !defined( _WIN32 )
+	if( !__llvm_profile_write_file ) {
+		return;
+	}
+
+	if( __llvm_profile_write_file() != 0 ) {
+		teLogf( TELOG_WARN | TENSHI_FACILITY, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Failed to write the profile" );
+	}
+#endif
+}
+
 
 /*
 ===============================================================================
@@ -620,6 +802,12 @@ static void FiniModules( void )
 
 static const TenshiUIntPtr_t kNumAgesPerIndex = sizeof( TenshiUIntPtr_t )*8/4;
 
+#ifndef DEFAULT_SYNC_INTERVAL
+# define DEFAULT_SYNC_INTERVAL      1024
+#endif
+
+TenshiInt32_t                       teSyncCountdown = DEFAULT_SYNC_INTERVAL;
+
 extern TenshiUInt32_t               tenshi__numTypes__;
 extern TenshiType_t                 tenshi__types__[];
 
@@ -653,6 +841,9 @@ CTOR( teInitGlob )
 	g_RTGlob.pMemblockAPI = &g_MemblockAPI;
 	g_RTGlob.pLoggingAPI = &g_LoggingAPI;
 
+	g_RTGlob.cSyncInterval = DEFAULT_SYNC_INTERVAL;
+	teSyncCountdown = DEFAULT_SYNC_INTERVAL;
+
 	g_EngineTypes.pfnAllocPool = &teAllocEnginePool;
 	g_EngineTypes.pfnObjectExists = &teEngineObjectExists;
 	g_EngineTypes.pfnReserveObjects = &teReserveIndexes;
@@ -683,11 +874,13 @@ CTOR( teInitGlob )
 	g_MemblockAPI.pfnGetMemblockSize = &teGetMemblockSize;
 
 	g_RNGPool = teAllocEnginePool( &teRNGAlloc_f, &teRNGDealloc_f );
+	g_MapPool = teAllocEnginePool( &teMapAlloc_f, &teMapDealloc_f );
 
 	InitModules();
 }
 static void __cdecl teFini( void )
 {
+	teStopWorkers();
 	FiniModules();
 
 	while( g_EngineTypes.cTypes > 0 ) {
@@ -696,6 +889,8 @@ static void __cdecl teFini( void )
 	}
 
 	g_RTGlob.pEngineTypes = NULL;
+
+	WriteProfile();
 }
 
 TENSHI_FUNC TenshiRuntimeGlob_t *TENSHI_CALL teGetGlob( void )
@@ -706,9 +901,12 @@ TENSHI_FUNC TenshiRuntimeGlob_t *TENSHI_CALL teGetGlob( void )
 #undef TENSHI_FACILITY
 #define TENSHI_FACILITY             kTenshiLog_CoreRT_Memory
 
+static TenshiUIntPtr_t GetAllocBytes( TenshiUIntPtr_t cBytes )
+{
+	return cBytes + ( cBytes%16 != 0 ? cBytes + 16 - ( cBytes%16 ) : 0 );
+}
 TENSHI_FUNC void *TENSHI_CALL teAlloc( TenshiUIntPtr_t cBytes, int Memtag )
 {
-	TenshiUIntPtr_t cAllocBytes;
 	void *p;
 
 	( void )Memtag;
@@ -717,14 +915,37 @@ TENSHI_FUNC void *TENSHI_CALL teAlloc( TenshiUIntPtr_t cBytes, int Memtag )
 		return NULL;
 	}
 
-	cAllocBytes = cBytes + ( cBytes%16 != 0 ? cBytes + 16 - ( cBytes%16 ) : 0 );
-	p = malloc( cAllocBytes );
+	p = malloc( GetAllocBytes( cBytes ) );
 #if MEMTRACE_ENABLED
 	TRACE( "p=%p :: +%u byte%s",
 		p, ( unsigned int )cBytes, cBytes == 1 ? "" : "s" );
 #endif
 	return p;
 }
+TENSHI_FUNC void *TENSHI_CALL teRealloc( void *pData, TenshiUIntPtr_t cBytes, int Memtag )
+{
+	void *p;
+
+	if( !pData ) {
+		return teAlloc( cBytes, Memtag );
+	}
+
+	if( cBytes == 0 ) {
+		teDealloc( pData );
+		return NULL;
+	}
+
+	/*
+		Allocations are padded (see GetAllocBytes) so growing by a little
+		usually stays within the same block
+	*/
+	p = realloc( pData, GetAllocBytes( cBytes ) );
+#if MEMTRACE_ENABLED
+	TRACE( "p=%p -> %p :: =%u byte%s",
+		pData, p, ( unsigned int )cBytes, cBytes == 1 ? "" : "s" );
+#endif
+	return p;
+}
 TENSHI_FUNC void TENSHI_CALL teDealloc( void *pData )
 {
 #if MEMTRACE_ENABLED
@@ -746,8 +967,19 @@ TENSHI_FUNC void TENSHI_CALL teAutoprint( const char *pszText )
 		printf( "%s\n", pszText != NULL ? pszText : "" );
 	}
 }
+
+/* number of PARALLEL FOR bodies this thread is running (see teRunChunks) */
+static THREAD_LOCAL TenshiUInt32_t g_cLoopBodies = 0;
+
 TENSHI_FUNC int TENSHI_CALL teSafeSync( void )
 {
+	teSyncCountdown = ( TenshiInt32_t )( g_RTGlob.cSyncInterval & 0x7FFFFFFF );
+
+	/* the host's events are only pumped from outside of parallel loops */
+	if( g_cLoopBodies > 0 ) {
+		return 1;
+	}
+
 	if( g_RTGlob.pfnSafeSyncCallback != NULL ) {
 		return g_RTGlob.pfnSafeSyncCallback();
 	}
@@ -1112,6 +1344,40 @@ TENSHI_FUNC char *TENSHI_CALL teStrConcat( const char *a, const char *b )
 
 	return p;
 }
+TENSHI_FUNC char *TENSHI_CALL teStrAppend( char *a, const char *b )
+{
+	size_t alen, blen;
+	char *p;
+
+#if STRTRACE_ENABLED
+	TRACE( "a=%p, b=%p", ( const void * )a, ( const void * )b );
+#endif
+
+	/*
+		`a` is a temporary owned by the caller; it is grown in place (when
+		possible) rather than being copied into a new string
+	*/
+	if( !a ) {
+		return teStrDup( b );
+	}
+
+	if( !b || *b == '\0' ) {
+		return a;
+	}
+
+	alen = strlen( a );
+	blen = strlen( b );
+
+	p = ( char * )teRealloc( a, alen + blen + 1, TENSHI_MEMTAG_STRING );
+	if( !p ) {
+		fprintf( stderr, "ERROR: Out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+
+	memcpy( p + alen, b, blen + 1 );
+
+	return p;
+}
 TENSHI_FUNC char *TENSHI_CALL teStrFindRm( const char *a, const char *b )
 {
 #define MAX_OCCURRENCES 512
@@ -1634,6 +1900,33 @@ TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teStrEqCase( const char *a, const char *
 #endif
 			;
 }
+/*
+	Hash used by SELECT to dispatch on strings (64-bit FNV-1a, with the seed
+	mixed into the offset basis, followed by MurmurHash3's finalizer so the
+	seed reaches every bit of short strings). The compiler hashes each CASE
+	label the same way when it builds the dispatch table, so the two must
+	match. A null string hashes the same as an empty one.
+*/
+TENSHI_FUNC TenshiUInt64_t TENSHI_CALL teStrHash( const char *s, TenshiUInt32_t seed )
+{
+	TenshiUInt64_t h;
+
+	h = 14695981039346656037ULL ^ ( TenshiUInt64_t )seed;
+	if( s != NULL ) {
+		while( *s != '\0' ) {
+			h ^= ( TenshiUInt64_t )( unsigned char )*s++;
+			h *= 1099511628211ULL;
+		}
+	}
+
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
 
 TENSHI_FUNC char *TENSHI_CALL teStr_Left( const char *s, TenshiIntPtr_t n )
 {
@@ -2076,13 +2369,26 @@ TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teIsTypeTrivial( const TenshiType_t *pTy
 #define teTypeHasTrivialCopy(pType_) (!(pType_) || ((pType_)->Flags & kTenshiTypeF_TrivialCopy))
 #define teTypeHasTrivialMove(pType_) (!(pType_) || ((pType_)->Flags & kTenshiTypeF_TrivialMove))
 
+/*
+	Trivial operations have no function (see the flags) and are done on the
+	instance's memory directly
+*/
 TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teInitTypeInstance( TenshiType_t *pType, void *pInstance )
 {
-	return pType != NULL ? pType->pfnInit( pType, pInstance ) : TENSHI_FALSE;
+	if( !pType ) {
+		return TENSHI_FALSE;
+	}
+
+	if( teTypeHasTrivialInit( pType ) ) {
+		memset( pInstance, 0, pType->cBytes );
+		return TENSHI_TRUE;
+	}
+
+	return pType->pfnInit( pType, pInstance );
 }
 TENSHI_FUNC void TENSHI_CALL teFiniTypeInstance( TenshiType_t *pType, void *pInstance )
 {
-	if( !pType || !pInstance ) {
+	if( !pType || !pInstance || teTypeHasTrivialFini( pType ) ) {
 		return;
 	}
 
@@ -2094,6 +2400,11 @@ TENSHI_FUNC void TENSHI_CALL teCopyTypeInstance( TenshiType_t *pType, void *pDst
 		return;
 	}
 
+	if( teTypeHasTrivialCopy( pType ) ) {
+		memcpy( pDstInstance, pSrcInstance, pType->cBytes );
+		return;
+	}
+
 	pType->pfnCopy( pType, pDstInstance, pSrcInstance );
 }
 TENSHI_FUNC void TENSHI_CALL teMoveTypeInstance( TenshiType_t *pType, void *pDstInstance, void *pSrcInstance )
@@ -2102,6 +2413,11 @@ TENSHI_FUNC void TENSHI_CALL teMoveTypeInstance( TenshiType_t *pType, void *pDst
 		return;
 	}
 
+	if( teTypeHasTrivialMove( pType ) ) {
+		memcpy( pDstInstance, pSrcInstance, pType->cBytes );
+		return;
+	}
+
 	pType->pfnMove( pType, pDstInstance, pSrcInstance );
 }
 
@@ -2273,6 +2589,8 @@ TENSHI_FUNC TenshiType_t *TENSHI_CALL teFixType( TenshiType_t *p )
 		NativeTy[ 15 ].pszName = "boolean";
 		NativeTy[ 15 ].pszPattern = "B";
 
+		/* each string item owns its memory, so it's copied and released */
+		NativeTy[ 16 ].Flags = 0;
 		NativeTy[ 16 ].pszName = "string";
 		NativeTy[ 16 ].pszPattern = "G";
 		NativeTy[ 16 ].pfnInit = &teStrInstance_Init_f;
@@ -2471,21 +2789,18 @@ TENSHI_FUNC void *TENSHI_CALL teArrayRedim( void *pOldArrayData, const TenshiUIn
 	TenshiUIntPtr_t cDataBytes;
 	TenshiUIntPtr_t cBytes;
 	TenshiUIntPtr_t i;
-	TenshiUIntPtr_t uOldBases       [ TENSHI_ARRAY_MAX_DIMENSIONS ];
-	TenshiUIntPtr_t uNewBases       [ TENSHI_ARRAY_MAX_DIMENSIONS ];
-	void *pOldBaseAddr;
-	void *pNewBaseAddr;
-	TenshiUIntPtr_t uOldBaseAddr;
-	TenshiUIntPtr_t uNewBaseAddr;
-	TenshiUIntPtr_t cMoveDims;
-	TenshiUIntPtr_t uDim;
-	TenshiUIntPtr_t uDstDimAddr;
-	TenshiUIntPtr_t uSrcDimAddr;
-	TenshiUIntPtr_t cOldItems;
-	TenshiUIntPtr_t cNewItems;
+	TenshiUIntPtr_t uCoords         [ TENSHI_ARRAY_MAX_DIMENSIONS ];
+	TenshiUIntPtr_t cOldDims        [ TENSHI_ARRAY_MAX_DIMENSIONS ];
+	TenshiUIntPtr_t cRowItems;
+	TenshiUIntPtr_t cRows;
 	TenshiUIntPtr_t cMoveItems;
-	TenshiUIntPtr_t cMakeItems;
+	TenshiUIntPtr_t uRow;
+	TenshiUIntPtr_t uOldItem;
+	TenshiUIntPtr_t uOldStride;
 	TenshiUIntPtr_t uItem;
+	TenshiUInt8_t *pDstRow;
+	TenshiUInt8_t *pSrcRow;
+	int bInOld;
 
 	TRACE( "Enter" );
 
@@ -2525,78 +2840,132 @@ TENSHI_FUNC void *TENSHI_CALL teArrayRedim( void *pOldArrayData, const TenshiUIn
 	}
 	pArr->cDimensions = cDimensions;
 
-	uOldBases[ 0 ] = 0;
-	for( i = 1; i < pOldArray->cDimensions; ++i ) {
-		uOldBases[ i ] = uOldBases[ i - 1 ] + pOldArray->uDimensions[ i ];
-	}
-
-	uNewBases[ 0 ] = 0;
-	for( i = 1; i < cDimensions; ++i ) {
-		uNewBases[ i ] = uNewBases[ i - 1 ] + pDimensions[ i ];
-	}
-
 	pArr->cItems = cItems;
 	pArr->cItemBytes = pOldArray->cItemBytes;
 	pArr->pItemType = pOldArray->pItemType;
 	pArr->uIndex = 0;
 
-	pOldBaseAddr = DataFromArray( pOldArray );
-	pNewBaseAddr = DataFromArray( pArr );
-
-	uOldBaseAddr = ( TenshiUIntPtr_t )pOldBaseAddr;
-	uNewBaseAddr = ( TenshiUIntPtr_t )pNewBaseAddr;
-
-	cMoveDims = pOldArray->cDimensions < cDimensions ? pOldArray->cDimensions : cDimensions;
-	
-	for( uDim = 0; uDim < cMoveDims; ++uDim ) {
-		uDstDimAddr = uNewBaseAddr + uNewBases[ uDim ];
-		uSrcDimAddr = uOldBaseAddr + uOldBases[ uDim ];
+	/*
+		The first dimension varies fastest, so the items are rows of the first
+		dimension's length. Each row of the new array that was also in the old
+		one (dimensions either array lacks count as one long) takes as much of
+		the old row as fits, and every other item starts out new.
+	*/
+	for( i = 0; i < TENSHI_ARRAY_MAX_DIMENSIONS; ++i ) {
+		cOldDims[ i ] = i < pOldArray->cDimensions ? pOldArray->uDimensions[ i ] : 1;
+		uCoords[ i ] = 0;
+	}
+	if( !pOldArray->cItems ) {
+		cOldDims[ 0 ] = 0;
+	}
+
+	cRowItems = cDimensions > 0 ? pDimensions[ 0 ] : 0;
+	cRows = cRowItems > 0 ? cItems/cRowItems : 0;
+	cMoveItems = cRowItems < cOldDims[ 0 ] ? cRowItems : cOldDims[ 0 ];
+
+	pDstRow = ( TenshiUInt8_t * )DataFromArray( pArr );
+	for( uRow = 0; uRow < cRows; ++uRow ) {
+		bInOld = 1;
+		uOldItem = 0;
+		uOldStride = cOldDims[ 0 ];
+		for( i = 1; i < TENSHI_ARRAY_MAX_DIMENSIONS; ++i ) {
+			if( uCoords[ i ] >= cOldDims[ i ] ) {
+				bInOld = 0;
+				break;
+			}
 
-		cOldItems = pOldArray->uDimensions[ uDim ];
-		cNewItems = pArr->uDimensions[ uDim ];
+			uOldItem += uCoords[ i ]*uOldStride;
+			uOldStride *= cOldDims[ i ];
+		}
 
-		cMoveItems = cOldItems < cNewItems ? cOldItems : cNewItems;
-		cMakeItems = cOldItems < cNewItems ? cNewItems - cOldItems : 0;
+		uItem = 0;
+		if( bInOld && cMoveItems > 0 ) {
+			pSrcRow = ( TenshiUInt8_t * )pOldArrayData + uOldItem*pArr->cItemBytes;
 
-		if( teTypeHasTrivialMove( pItemType ) ) {
-			memcpy( ( void * )uDstDimAddr, ( const void * )uSrcDimAddr, cMoveItems*pArr->cItemBytes );
-		} else {
-			for( uItem = 0; uItem < cMoveItems; ++uItem ) {
-				teMoveTypeInstance( pItemType, ( void * )uDstDimAddr, ( void * )uSrcDimAddr );
-				uDstDimAddr += pArr->cItemBytes;
-				uSrcDimAddr += pArr->cItemBytes;
+			if( teTypeHasTrivialMove( pItemType ) ) {
+				memcpy( ( void * )pDstRow, ( const void * )pSrcRow, cMoveItems*pArr->cItemBytes );
+				/* so that finalizing the old array doesn't release them */
+				if( !teTypeHasTrivialFini( pItemType ) ) {
+					memset( ( void * )pSrcRow, 0, cMoveItems*pArr->cItemBytes );
+				}
+			} else {
+				for( ; uItem < cMoveItems; ++uItem ) {
+					teMoveTypeInstance( pItemType, ( void * )( pDstRow + uItem*pArr->cItemBytes ), ( void * )( pSrcRow + uItem*pArr->cItemBytes ) );
+				}
 			}
+			uItem = cMoveItems;
 		}
+
 		if( teTypeHasTrivialInit( pItemType ) ) {
-			memset( ( void * )( uDstDimAddr + cMoveItems*pArr->cItemBytes ), 0, cMakeItems*pArr->cItemBytes );
+			memset( ( void * )( pDstRow + uItem*pArr->cItemBytes ), 0, ( cRowItems - uItem )*pArr->cItemBytes );
 		} else {
-			for( uItem = 0; uItem < cMakeItems; ++uItem ) {
-				teInitTypeInstance( pItemType, ( void * )uDstDimAddr );
-				uDstDimAddr += pArr->cItemBytes;
+			for( ; uItem < cRowItems; ++uItem ) {
+				teInitTypeInstance( pItemType, ( void * )( pDstRow + uItem*pArr->cItemBytes ) );
 			}
 		}
-	}
-	
-	teArrayUndim( pOldArrayData );
 
-	while( uDim < cDimensions ) {
-		uDstDimAddr = uNewBaseAddr + uNewBases[ uDim ];
-		cMakeItems = pArr->uDimensions[ uDim ];
+		pDstRow += cRowItems*pArr->cItemBytes;
 
-		if( teTypeHasTrivialInit( pItemType ) ) {
-			memset( ( void * )uDstDimAddr, 0, cMakeItems*pArr->cItemBytes );
-		} else {
-			for( uItem = 0; uItem < cMakeItems; ++uItem ) {
-				teInitTypeInstance( pItemType, ( void * )uDstDimAddr );
-				uDstDimAddr += pArr->cItemBytes;
+		for( i = 1; i < cDimensions; ++i ) {
+			if( ++uCoords[ i ] < pDimensions[ i ] ) {
+				break;
 			}
+			uCoords[ i ] = 0;
 		}
+	}
+
+	/* moved-from items are left empty, so this releases only what was dropped */
+	teArrayUndim( pOldArrayData );
+
+	TRACE( "Leave: Success; pNewBaseAddr=%p", DataFromArray( pArr ) );
+	return DataFromArray( pArr );
+}
+
+TENSHI_FUNC void *TENSHI_CALL teArrayCopy( const void *pSrcArrayData )
+{
+	const TenshiArray_t *pSrcArr;
+	TenshiArray_t *pArr;
+	TenshiUIntPtr_t cDataBytes;
+	void *pBaseData;
+
+	TRACE( "pSrcArrayData=%p", pSrcArrayData );
+
+	if( !pSrcArrayData ) {
+		return NULL;
+	}
+
+	pSrcArr = ArrayFromConstData( pSrcArrayData );
+	cDataBytes = pSrcArr->cItemBytes*pSrcArr->cItems;
+
+	pArr = ( TenshiArray_t * )teAlloc( sizeof( TenshiArray_t ) + cDataBytes, g_RTGlob.iCurrentMemtag );
+	if( !pArr ) {
+		TRACE( "Leave: Alloc failed" );
+		return NULL;
+	}
+
+	memcpy( ( void * )pArr, ( const void * )pSrcArr, sizeof( TenshiArray_t ) );
+	pArr->uIndex = 0;
+
+	pBaseData = DataFromArray( pArr );
+
+	/* plain-old-data items are copied in one go */
+	if( teTypeHasTrivialCopy( pArr->pItemType ) ) {
+		memcpy( pBaseData, pSrcArrayData, cDataBytes );
+	} else {
+		TenshiUIntPtr_t uDstAddr;
+		TenshiUIntPtr_t uSrcAddr;
+		TenshiUIntPtr_t i;
 
-		++uDim;
+		uDstAddr = ( TenshiUIntPtr_t )pBaseData;
+		uSrcAddr = ( TenshiUIntPtr_t )pSrcArrayData;
+		for( i = 0; i < pArr->cItems; ++i ) {
+			teCopyTypeInstance( pArr->pItemType, ( void * )uDstAddr, ( const void * )uSrcAddr );
+			uDstAddr += pArr->cItemBytes;
+			uSrcAddr += pArr->cItemBytes;
+		}
 	}
 
-	TRACE( "Leave: Success; pNewBaseAddr=%p",  pNewBaseAddr );
-	return pNewBaseAddr;
+	return pBaseData;
 }
 
 TENSHI_FUNC void *TENSHI_CALL teArrayInsertElements( void *pArrayData, TenshiUIntPtr_t uBefore, const void *pItems, TenshiUIntPtr_t cItems )
@@ -2950,857 +3319,3896 @@ TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teArrayDimensionLen( const void *pArrayD
 	pArr = ArrayFromConstData( pArrayData );
 	return uDim < pArr->cDimensions ? pArr->uDimensions[ uDim ] : 0;
 }
+TENSHI_FUNC void TENSHI_CALL teArrayIndexError( const void *pArrayData, TenshiUIntPtr_t uDim, TenshiUIntPtr_t uIndex )
+{
+	teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+		( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+		"Array index %lli is out of bounds for dimension %u (%u element%s)",
+		( long long )( TenshiIntPtr_t )uIndex, ( unsigned )uDim,
+		( unsigned )teArrayDimensionLen( pArrayData, uDim ),
+		teArrayDimensionLen( pArrayData, uDim ) == 1 ? "" : "s" );
+
+	teRuntimeError( TENSHI_FACILITY, TENSHI_MODNAME, TE_ERR_ARRAYBOUNDS );
+}
 
 
 /*
 ===============================================================================
 
-	LINKED LIST
+	ARRAY SORTING
 
 ===============================================================================
 */
 
+/*
+	SORT ARRAY orders an array's items by a key within each of them: the
+	whole item, or one field of a user-defined type.
+
+	Numeric keys are mapped to unsigned integers that compare the same way
+	(flipping the sign bit of integers, and every bit of negative floats; then
+	every bit again for a descending sort) and sorted with an LSD radix sort,
+	a byte per pass, skipping the bytes every key shares. The radix sort is
+	stable, so it serves STABLE SORT ARRAY as well.
+
+	String keys are compared, by their first eight bytes (kept beside the
+	key) before the rest: pattern-defeating quicksort (pdqsort) orders them,
+	or a merge sort when the sort has to be stable.
+
+	Either way the keys are sorted along with the positions of their items,
+	which are then moved to their new places in one pass. Items are moved as
+	bytes, as everything a Tenshi value owns is referred to by pointer.
+
+	Arrays of SORT_PARALLEL_MIN items or more are sorted on the PARALLEL FOR
+	workers: each radix pass counts and scatters its chunks of the keys in
+	parallel, and chunks of string keys are sorted in parallel, then merged
+	pairwise.
+*/
+
 #undef TENSHI_FACILITY
-#define TENSHI_FACILITY             kTenshiLog_CoreRT_List
+#define TENSHI_FACILITY             kTenshiLog_CoreRT_Array
 
-static void List_FixCachedIndex( TenshiList_t *pList, TenshiListItem_t *pItem )
-{
-	if( pItem != pList->pCachedIndex ) {
-		pList->pCachedIndex = NULL;
-		pList->uCachedIndex = 0;
-		return;
+/* arrays with fewer items are sorted on the calling thread */
+#ifndef SORT_PARALLEL_MIN
+# define SORT_PARALLEL_MIN          65536
+#endif
+/* fewer numeric keys than this are insertion sorted rather than radix sorted */
+#define SORT_RADIX_MIN              64
+/* ranges of string keys shorter than this are insertion sorted */
+#define SORT_INSERTION_MAX          24
+/* pdqsort takes the median of three medians as its pivot above this */
+#define SORT_NINTHER_MIN            128
+/* the merge sort starts from insertion sorted runs of this length */
+#define SORT_MERGE_RUN              32
+
+typedef struct SortRef_s {
+	/* the key's first bytes, big-endian, so most compares needn't follow it */
+	TenshiUInt64_t                  uPrefix;
+	const char *                    pszKey;
+	TenshiUIntPtr_t                 uIndex;
+} SortRef_t;
+
+typedef struct SortJob_s {
+	TenshiUInt8_t *                 pItems;
+	TenshiUIntPtr_t                 cItems;
+	TenshiUIntPtr_t                 cItemBytes;
+	TenshiUIntPtr_t                 uKeyOffset;
+	TenshiUInt32_t                  KeyType;
+	TenshiUInt32_t                  Flags;
+
+	/* chunks each parallel step is split into (1 runs it on this thread) */
+	TenshiUInt32_t                  cChunks;
+
+	/* numeric keys and their items' positions (null for plain arrays) */
+	TenshiUInt64_t *                pKeys;
+	TenshiUIntPtr_t *               pIndex;
+	/* where a radix pass scatters them to */
+	TenshiUInt64_t *                pKeysOut;
+	TenshiUIntPtr_t *               pIndexOut;
+	/* per chunk: counts of each digit, then where its first item of each goes */
+	TenshiUIntPtr_t *               pCounts;
+	/* position of the digit the current pass sorts by */
+	unsigned                        uShift;
+	/* per chunk: bits set in any of its keys, and in all of them */
+	TenshiUInt64_t                  uKeyOr[ TENSHI_PARALLEL_MAX_WORKERS ];
+	TenshiUInt64_t                  uKeyAnd[ TENSHI_PARALLEL_MAX_WORKERS ];
+
+	/* string keys and their items' positions, and room to merge them */
+	SortRef_t *                     pRefs;
+	SortRef_t *                     pRefsOut;
+	/* start of each sorted run of pRefs, and the end of the last */
+	TenshiUIntPtr_t                 uRuns[ TENSHI_PARALLEL_MAX_WORKERS + 1 ];
+	TenshiUInt32_t                  cRuns;
+
+	/* items in their sorted order, before they're copied back */
+	TenshiUInt8_t *                 pGather;
+} SortJob_t;
+
+static const TenshiUInt8_t g_SortKeyBytes[ kTenshiNumSortKeys ] = {
+	1, 2, 4, 8,
+	1, 2, 4, 8,
+	4, 8,
+	sizeof( char * )
+};
+
+static TENSHI_FORCEINLINE TenshiUInt64_t Sort_KeyMask( TenshiUInt32_t KeyType )
+{
+	return g_SortKeyBytes[ KeyType ] == 8 ? ~( TenshiUInt64_t )0 : ( ( TenshiUInt64_t )1 << g_SortKeyBytes[ KeyType ]*8 ) - 1;
+}
+
+/* map a numeric key to an unsigned integer that sorts in the same order */
+static TENSHI_FORCEINLINE TenshiUInt64_t Sort_LoadKey( const void *pKey, TenshiUInt32_t KeyType, TenshiUInt32_t Flags )
+{
+	TenshiUInt64_t uKey;
+	TenshiUInt32_t uBits32;
+	TenshiUInt64_t uBits64;
+
+	switch( KeyType ) {
+	case kTenshiSortKey_Int8:
+		uKey = ( TenshiUInt8_t )*( const TenshiInt8_t * )pKey ^ 0x80U;
+		break;
+	case kTenshiSortKey_Int16:
+		uKey = ( TenshiUInt16_t )*( const TenshiInt16_t * )pKey ^ 0x8000U;
+		break;
+	case kTenshiSortKey_Int32:
+		uKey = ( TenshiUInt32_t )*( const TenshiInt32_t * )pKey ^ 0x80000000U;
+		break;
+	case kTenshiSortKey_Int64:
+		uKey = ( TenshiUInt64_t )*( const TenshiInt64_t * )pKey ^ 0x8000000000000000ULL;
+		break;
+	case kTenshiSortKey_UInt8:
+		uKey = *( const TenshiUInt8_t * )pKey;
+		break;
+	case kTenshiSortKey_UInt16:
+		uKey = *( const TenshiUInt16_t * )pKey;
+		break;
+	case kTenshiSortKey_UInt32:
+		uKey = *( const TenshiUInt32_t * )pKey;
+		break;
+	case kTenshiSortKey_Float32:
+		memcpy( ( void * )&uBits32, pKey, sizeof( uBits32 ) );
+		uKey = uBits32 & 0x80000000U ? ( TenshiUInt32_t )~uBits32 : uBits32 | 0x80000000U;
+		break;
+	case kTenshiSortKey_Float64:
+		memcpy( ( void * )&uBits64, pKey, sizeof( uBits64 ) );
+		uKey = uBits64 & 0x8000000000000000ULL ? ~uBits64 : uBits64 | 0x8000000000000000ULL;
+		break;
+	default:
+		uKey = *( const TenshiUInt64_t * )pKey;
+		break;
+	}
+
+	return Flags & kTenshiSortF_Descending ? ~uKey & Sort_KeyMask( KeyType ) : uKey;
+}
+/* undo Sort_LoadKey() */
+static TENSHI_FORCEINLINE void Sort_StoreKey( void *pKey, TenshiUInt64_t uKey, TenshiUInt32_t KeyType, TenshiUInt32_t Flags )
+{
+	TenshiUInt32_t uBits32;
+	TenshiUInt64_t uBits64;
+
+	if( Flags & kTenshiSortF_Descending ) {
+		uKey = ~uKey & Sort_KeyMask( KeyType );
+	}
+
+	switch( KeyType ) {
+	case kTenshiSortKey_Int8:
+		*( TenshiUInt8_t * )pKey = ( TenshiUInt8_t )( uKey ^ 0x80U );
+		break;
+	case kTenshiSortKey_Int16:
+		*( TenshiUInt16_t * )pKey = ( TenshiUInt16_t )( uKey ^ 0x8000U );
+		break;
+	case kTenshiSortKey_Int32:
+		*( TenshiUInt32_t * )pKey = ( TenshiUInt32_t )( uKey ^ 0x80000000U );
+		break;
+	case kTenshiSortKey_Int64:
+		*( TenshiUInt64_t * )pKey = uKey ^ 0x8000000000000000ULL;
+		break;
+	case kTenshiSortKey_UInt8:
+		*( TenshiUInt8_t * )pKey = ( TenshiUInt8_t )uKey;
+		break;
+	case kTenshiSortKey_UInt16:
+		*( TenshiUInt16_t * )pKey = ( TenshiUInt16_t )uKey;
+		break;
+	case kTenshiSortKey_UInt32:
+		*( TenshiUInt32_t * )pKey = ( TenshiUInt32_t )uKey;
+		break;
+	case kTenshiSortKey_Float32:
+		uBits32 = uKey & 0x80000000U ? ( TenshiUInt32_t )uKey & 0x7FFFFFFFU : ( TenshiUInt32_t )~uKey;
+		memcpy( pKey, ( const void * )&uBits32, sizeof( uBits32 ) );
+		break;
+	case kTenshiSortKey_Float64:
+		uBits64 = uKey & 0x8000000000000000ULL ? uKey & 0x7FFFFFFFFFFFFFFFULL : ~uKey;
+		memcpy( pKey, ( const void * )&uBits64, sizeof( uBits64 ) );
+		break;
+	default:
+		*( TenshiUInt64_t * )pKey = uKey;
+		break;
+	}
+}
+
+static TenshiUInt64_t Sort_KeyPrefix( const char *pszKey )
+{
+	TenshiUInt64_t uPrefix;
+	unsigned i;
+
+	uPrefix = 0;
+	for( i = 0; i < 8; ++i ) {
+		uPrefix <<= 8;
+		if( pszKey != NULL && *pszKey != '\0' ) {
+			uPrefix |= ( TenshiUInt8_t )*pszKey++;
+		}
 	}
 
-	if( pItem->pNext != NULL ) {
-		pList->pCachedIndex = pList->pCachedIndex->pNext;
-	} else if( pItem->pPrev != NULL ) {
-		pList->pCachedIndex = pList->pCachedIndex->pPrev;
-		--pList->uCachedIndex;
-	} else {
-		pList->pCachedIndex = NULL;
-		pList->uCachedIndex = 0;
-	}
+	return uPrefix;
 }
-static void List_Unlink( TenshiList_t *pList, TenshiListItem_t *pItem )
+static TENSHI_FORCEINLINE int Sort_Less( const SortRef_t *a, const SortRef_t *b, TenshiUInt32_t Flags )
 {
-	List_FixCachedIndex( pList, pItem );
+	const SortRef_t *x;
+	const SortRef_t *y;
 
-	if( pItem->pPrev != NULL ) {
-		pItem->pPrev->pNext = pItem->pNext;
+	if( Flags & kTenshiSortF_Descending ) {
+		x = b;
+		y = a;
 	} else {
-		pList->pHead = pItem->pNext;
+		x = a;
+		y = b;
 	}
 
-	if( pItem->pNext != NULL ) {
-		pItem->pNext->pPrev = pItem->pPrev;
-	} else {
-		pList->pTail = pItem->pPrev;
+	if( x->uPrefix != y->uPrefix ) {
+		return x->uPrefix < y->uPrefix;
 	}
 
-	pItem->pPrev = NULL;
-	pItem->pNext = NULL;
-
-	if( pList->pCurr == pItem ) {
-		pList->pCurr = NULL;
+	/* equal prefixes ending early are the whole of equal keys */
+	if( !( x->uPrefix & 0xFF ) ) {
+		return 0;
 	}
 
-	if( pList->pCachedIndex == pItem ) {
-		if( pList->pCachedIndex->pNext == NULL ) {
-			pList->pCachedIndex = pList->pCachedIndex->pPrev;
-			if( pList->pCachedIndex != NULL ) {
-				--pList->uCachedIndex;
-			}
-		}
-	} else {
-		pList->uCachedIndex = 0;
-		pList->pCachedIndex = NULL;
-	}
+	return strcmp( x->pszKey + 8, y->pszKey + 8 ) < 0;
 }
 
-TENSHI_FUNC TenshiList_t *TENSHI_CALL teNewList( TenshiType_t *pItemType )
+static TENSHI_FORCEINLINE void Sort_SwapRefs( SortRef_t *a, SortRef_t *b )
 {
-	TenshiList_t *pList;
+	SortRef_t Temp;
 
-	if( !pItemType ) {
-		return NULL;
-	}
+	Temp = *a;
+	*a = *b;
+	*b = Temp;
+}
 
-	pList = ( TenshiList_t * )teAlloc( sizeof( TenshiList_t ), g_RTGlob.iCurrentMemtag );
-	if( !pList ) {
-		return NULL;
-	}
+/* -------------------------------------------------------------------------- */
 
-	pList->pHead = NULL;
-	pList->pTail = NULL;
-	pList->pCurr = NULL;
+static void TENSHI_CALL Sort_LoadKeys_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	SortJob_t *pJob;
+	const TenshiUInt8_t *pKey;
+	TenshiUInt64_t uKey;
+	TenshiUInt64_t uOr;
+	TenshiUInt64_t uAnd;
+	TenshiUIntPtr_t i;
 
-	pList->cItems = 0;
-	pList->cItemBytes = pItemType->cBytes;
-	pList->pItemType = pItemType;
+	pJob = ( SortJob_t * )pContext;
 
-	pList->uCachedIndex = 0;
-	pList->pCachedIndex = NULL;
+	uOr = 0;
+	uAnd = ~( TenshiUInt64_t )0;
 
-	return pList;
+	pKey = pJob->pItems + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes + pJob->uKeyOffset;
+	for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+		uKey = Sort_LoadKey( ( const void * )pKey, pJob->KeyType, pJob->Flags );
+		pKey += pJob->cItemBytes;
+
+		pJob->pKeys[ i ] = uKey;
+		if( pJob->pIndex != NULL ) {
+			pJob->pIndex[ i ] = i;
+		}
+
+		uOr |= uKey;
+		uAnd &= uKey;
+	}
+
+	pJob->uKeyOr[ uChunk ] = uOr;
+	pJob->uKeyAnd[ uChunk ] = uAnd;
 }
-TENSHI_FUNC TenshiList_t *TENSHI_CALL teDeleteList( TenshiList_t *pList )
+static void TENSHI_CALL Sort_StoreKeys_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
 {
-	if( !pList ) {
-		return NULL;
-	}
+	SortJob_t *pJob;
+	TenshiUInt8_t *pItem;
+	TenshiUIntPtr_t i;
 
-	teEmptyList( pList );
-	teDealloc( ( void * )pList );
+	( void )uChunk;
 
-	return NULL;
+	pJob = ( SortJob_t * )pContext;
+
+	pItem = pJob->pItems + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes;
+	for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+		Sort_StoreKey( ( void * )pItem, pJob->pKeys[ i ], pJob->KeyType, pJob->Flags );
+		pItem += pJob->cItemBytes;
+	}
 }
 
-TENSHI_FUNC void *TENSHI_CALL teListNodeItem( TenshiListItem_t *pItem )
+static void TENSHI_CALL Sort_RadixCount_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
 {
-	if( !pItem ) {
-		return NULL;
-	}
+	SortJob_t *pJob;
+	TenshiUIntPtr_t *pCounts;
+	TenshiUIntPtr_t i;
 
-	return ( void * )( pItem + 1 );
+	pJob = ( SortJob_t * )pContext;
+	pCounts = pJob->pCounts + uChunk*256;
+
+	memset( ( void * )pCounts, 0, 256*sizeof( *pCounts ) );
+	for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+		++pCounts[ ( pJob->pKeys[ i ] >> pJob->uShift ) & 0xFF ];
+	}
 }
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListNodeFromItem( void *pData )
+static void TENSHI_CALL Sort_RadixScatter_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
 {
-	if( !pData ) {
-		return NULL;
+	SortJob_t *pJob;
+	TenshiUIntPtr_t *pNext;
+	TenshiUIntPtr_t uDst;
+	TenshiUIntPtr_t i;
+
+	pJob = ( SortJob_t * )pContext;
+	pNext = pJob->pCounts + uChunk*256;
+
+	if( !pJob->pIndex ) {
+		for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+			uDst = pNext[ ( pJob->pKeys[ i ] >> pJob->uShift ) & 0xFF ]++;
+			pJob->pKeysOut[ uDst ] = pJob->pKeys[ i ];
+		}
+
+		return;
 	}
 
-	return ( ( TenshiListItem_t * )pData ) - 1;
+	for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+		uDst = pNext[ ( pJob->pKeys[ i ] >> pJob->uShift ) & 0xFF ]++;
+		pJob->pKeysOut[ uDst ] = pJob->pKeys[ i ];
+		pJob->pIndexOut[ uDst ] = pJob->pIndex[ i ];
+	}
 }
 
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListFrontNode( TenshiList_t *pList )
+/* stable; for too few keys to be worth a radix pass */
+static void Sort_InsertKeys( TenshiUInt64_t *pKeys, TenshiUIntPtr_t *pIndex, TenshiUIntPtr_t cKeys )
 {
-	return pList != NULL ? pList->pHead : NULL;
+	TenshiUInt64_t uKey;
+	TenshiUIntPtr_t uIndex;
+	TenshiUIntPtr_t i, j;
+
+	for( i = 1; i < cKeys; ++i ) {
+		uKey = pKeys[ i ];
+		uIndex = pIndex != NULL ? pIndex[ i ] : 0;
+
+		for( j = i; j > 0 && pKeys[ j - 1 ] > uKey; --j ) {
+			pKeys[ j ] = pKeys[ j - 1 ];
+			if( pIndex != NULL ) {
+				pIndex[ j ] = pIndex[ j - 1 ];
+			}
+		}
+
+		pKeys[ j ] = uKey;
+		if( pIndex != NULL ) {
+			pIndex[ j ] = uIndex;
+		}
+	}
 }
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListBackNode( TenshiList_t *pList )
-{
-	return pList != NULL ? pList->pTail : NULL;
+static void Sort_Radix( SortJob_t *pJob )
+{
+	TenshiUInt64_t uVarying;
+	TenshiUInt64_t uOr;
+	TenshiUInt64_t uAnd;
+	TenshiUInt64_t *pSwapKeys;
+	TenshiUIntPtr_t *pSwapIndex;
+	TenshiUIntPtr_t *pCount;
+	TenshiUIntPtr_t uPos;
+	TenshiUIntPtr_t cDigit;
+	TenshiUInt32_t uChunk;
+	unsigned uDigit;
+	unsigned cBits;
+
+	uOr = 0;
+	uAnd = ~( TenshiUInt64_t )0;
+	for( uChunk = 0; uChunk < pJob->cChunks; ++uChunk ) {
+		uOr |= pJob->uKeyOr[ uChunk ];
+		uAnd &= pJob->uKeyAnd[ uChunk ];
+	}
+	uVarying = uOr ^ uAnd;
+
+	cBits = g_SortKeyBytes[ pJob->KeyType ]*8;
+	for( pJob->uShift = 0; pJob->uShift < cBits; pJob->uShift += 8 ) {
+		/* every key has the same digit here */
+		if( !( ( uVarying >> pJob->uShift ) & 0xFF ) ) {
+			continue;
+		}
+
+		teParallelFor( &Sort_RadixCount_f, ( void * )pJob, pJob->cItems, pJob->cChunks );
+
+		/* each chunk's items of a digit go after those of the chunks before */
+		uPos = 0;
+		for( uDigit = 0; uDigit < 256; ++uDigit ) {
+			for( uChunk = 0; uChunk < pJob->cChunks; ++uChunk ) {
+				pCount = &pJob->pCounts[ uChunk*256 + uDigit ];
+				cDigit = *pCount;
+				*pCount = uPos;
+				uPos += cDigit;
+			}
+		}
+
+		teParallelFor( &Sort_RadixScatter_f, ( void * )pJob, pJob->cItems, pJob->cChunks );
+
+		pSwapKeys = pJob->pKeys;
+		pJob->pKeys = pJob->pKeysOut;
+		pJob->pKeysOut = pSwapKeys;
+
+		pSwapIndex = pJob->pIndex;
+		pJob->pIndex = pJob->pIndexOut;
+		pJob->pIndexOut = pSwapIndex;
+	}
 }
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL tePreviousListNode( TenshiListItem_t *pNode )
+
+/* -------------------------------------------------------------------------- */
+
+static void Sort_InsertRefs( SortRef_t *pFirst, SortRef_t *pLast, TenshiUInt32_t Flags )
 {
-	return pNode != NULL ? pNode->pPrev : NULL;
+	SortRef_t Temp;
+	SortRef_t *pCur;
+	SortRef_t *pSift;
+
+	if( pFirst == pLast ) {
+		return;
+	}
+
+	for( pCur = pFirst + 1; pCur != pLast; ++pCur ) {
+		if( !Sort_Less( pCur, pCur - 1, Flags ) ) {
+			continue;
+		}
+
+		Temp = *pCur;
+		pSift = pCur;
+		do {
+			*pSift = *( pSift - 1 );
+			--pSift;
+		} while( pSift != pFirst && Sort_Less( &Temp, pSift - 1, Flags ) );
+
+		*pSift = Temp;
+	}
 }
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teNextListNode( TenshiListItem_t *pNode )
+/* as Sort_InsertRefs(), for a range with a no-greater key just before it */
+static void Sort_InsertRefsUnguarded( SortRef_t *pFirst, SortRef_t *pLast, TenshiUInt32_t Flags )
 {
-	return pNode != NULL ? pNode->pNext : NULL;
-}
+	SortRef_t Temp;
+	SortRef_t *pCur;
+	SortRef_t *pSift;
 
-TENSHI_FUNC void *TENSHI_CALL teListFront( TenshiList_t *pList )
+	for( pCur = pFirst + 1; pCur < pLast; ++pCur ) {
+		if( !Sort_Less( pCur, pCur - 1, Flags ) ) {
+			continue;
+		}
+
+		Temp = *pCur;
+		pSift = pCur;
+		do {
+			*pSift = *( pSift - 1 );
+			--pSift;
+		} while( Sort_Less( &Temp, pSift - 1, Flags ) );
+
+		*pSift = Temp;
+	}
+}
+/* insertion sort that gives up (returning false) after moving a few keys */
+static int Sort_InsertRefsPartial( SortRef_t *pFirst, SortRef_t *pLast, TenshiUInt32_t Flags )
 {
-	return teListNodeItem( pList != NULL ? pList->pHead : NULL );
+	SortRef_t Temp;
+	SortRef_t *pCur;
+	SortRef_t *pSift;
+	TenshiUIntPtr_t cMoved;
+
+	if( pFirst == pLast ) {
+		return 1;
+	}
+
+	cMoved = 0;
+	for( pCur = pFirst + 1; pCur != pLast; ++pCur ) {
+		if( !Sort_Less( pCur, pCur - 1, Flags ) ) {
+			continue;
+		}
+
+		Temp = *pCur;
+		pSift = pCur;
+		do {
+			*pSift = *( pSift - 1 );
+			--pSift;
+		} while( pSift != pFirst && Sort_Less( &Temp, pSift - 1, Flags ) );
+
+		*pSift = Temp;
+
+		cMoved += ( TenshiUIntPtr_t )( pCur - pSift );
+		if( cMoved > 8 ) {
+			return pCur + 1 == pLast;
+		}
+	}
+
+	return 1;
 }
-TENSHI_FUNC void *TENSHI_CALL teListBack( TenshiList_t *pList )
+
+static void Sort_Sort3Refs( SortRef_t *a, SortRef_t *b, SortRef_t *c, TenshiUInt32_t Flags )
 {
-	return teListNodeItem( pList != NULL ? pList->pTail : NULL );
+	if( Sort_Less( b, a, Flags ) ) {
+		Sort_SwapRefs( a, b );
+	}
+	if( Sort_Less( c, b, Flags ) ) {
+		Sort_SwapRefs( b, c );
+	}
+	if( Sort_Less( b, a, Flags ) ) {
+		Sort_SwapRefs( a, b );
+	}
 }
-TENSHI_FUNC void *TENSHI_CALL teListPrevious( void *pData )
+
+static void Sort_SiftDownRefs( SortRef_t *pRefs, TenshiUIntPtr_t uRoot, TenshiUIntPtr_t cRefs, TenshiUInt32_t Flags )
 {
-	TenshiListItem_t *pItem;
+	TenshiUIntPtr_t uChild;
 
-	if( !pData ) {
-		return NULL;
-	}
+	for(;;) {
+		uChild = uRoot*2 + 1;
+		if( uChild >= cRefs ) {
+			break;
+		}
 
-	pItem = ( ( TenshiListItem_t * )pData ) - 1;
-	return teListNodeItem( pItem->pPrev );
+		if( uChild + 1 < cRefs && Sort_Less( &pRefs[ uChild ], &pRefs[ uChild + 1 ], Flags ) ) {
+			++uChild;
+		}
+		if( !Sort_Less( &pRefs[ uRoot ], &pRefs[ uChild ], Flags ) ) {
+			break;
+		}
+
+		Sort_SwapRefs( &pRefs[ uRoot ], &pRefs[ uChild ] );
+		uRoot = uChild;
+	}
 }
-TENSHI_FUNC void *TENSHI_CALL teListNext( void *pData )
+/* pdqsort's way out of a run of bad pivots */
+static void Sort_HeapRefs( SortRef_t *pRefs, TenshiUIntPtr_t cRefs, TenshiUInt32_t Flags )
 {
-	TenshiListItem_t *pItem;
+	TenshiUIntPtr_t i;
 
-	if( !pData ) {
-		return NULL;
+	for( i = cRefs/2; i > 0; --i ) {
+		Sort_SiftDownRefs( pRefs, i - 1, cRefs, Flags );
+	}
+	for( i = cRefs; i > 1; --i ) {
+		Sort_SwapRefs( &pRefs[ 0 ], &pRefs[ i - 1 ] );
+		Sort_SiftDownRefs( pRefs, 0, i - 1, Flags );
 	}
-
-	pItem = ( ( TenshiListItem_t * )pData ) - 1;
-	return teListNodeItem( pItem->pNext );
 }
 
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListInsertBeforeNode( TenshiList_t *pList, TenshiListItem_t *pAfterNode )
+/*
+	partition around *pFirst, keys equal to it going right; sets
+	*pbPartitioned if nothing had to be swapped
+*/
+static SortRef_t *Sort_PartitionRight( SortRef_t *pFirst, SortRef_t *pLast, TenshiUInt32_t Flags, int *pbPartitioned )
 {
-	TenshiListItem_t *pBeforeNode;
+	SortRef_t Pivot;
+	SortRef_t *pLeft;
+	SortRef_t *pRight;
+	SortRef_t *pPivot;
 
-	if( !pList ) {
-		return NULL;
-	}
+	Pivot = *pFirst;
+	pLeft = pFirst;
+	pRight = pLast;
 
-	pBeforeNode = ( TenshiListItem_t * )teAlloc( sizeof( TenshiListItem_t ) + pList->cItemBytes, g_RTGlob.iCurrentMemtag );
-	if( !pBeforeNode || !teInitTypeInstance( pList->pItemType, teListNodeItem( pBeforeNode ) ) ) {
-		return NULL;
+	while( Sort_Less( ++pLeft, &Pivot, Flags ) ) {
 	}
 
-	if( !pAfterNode ) {
-		pBeforeNode->pPrev = pList->pTail;
-		pBeforeNode->pNext = NULL;
+	/* with nothing smaller than the pivot on the left, guard the right scan */
+	if( pLeft - 1 == pFirst ) {
+		while( pLeft < pRight && !Sort_Less( --pRight, &Pivot, Flags ) ) {
+		}
 	} else {
-		pBeforeNode->pPrev = pAfterNode->pPrev;
-		pBeforeNode->pNext = pAfterNode;
+		while( !Sort_Less( --pRight, &Pivot, Flags ) ) {
+		}
 	}
 
-	if( pBeforeNode->pPrev != NULL ) {
-		pBeforeNode->pPrev->pNext = pBeforeNode;
-	} else {
-		pList->pHead = pBeforeNode;
+	*pbPartitioned = pLeft >= pRight;
+
+	while( pLeft < pRight ) {
+		Sort_SwapRefs( pLeft, pRight );
+		while( Sort_Less( ++pLeft, &Pivot, Flags ) ) {
+		}
+		while( !Sort_Less( --pRight, &Pivot, Flags ) ) {
+		}
 	}
-	if( pBeforeNode->pNext != NULL ) {
-		pBeforeNode->pNext->pPrev = pBeforeNode;
+
+	pPivot = pLeft - 1;
+	*pFirst = *pPivot;
+	*pPivot = Pivot;
+
+	return pPivot;
+}
+/* partition around *pFirst, keys equal to it going left */
+static SortRef_t *Sort_PartitionLeft( SortRef_t *pFirst, SortRef_t *pLast, TenshiUInt32_t Flags )
+{
+	SortRef_t Pivot;
+	SortRef_t *pLeft;
+	SortRef_t *pRight;
+
+	Pivot = *pFirst;
+	pLeft = pFirst;
+	pRight = pLast;
+
+	while( Sort_Less( &Pivot, --pRight, Flags ) ) {
+	}
+
+	if( pRight + 1 == pLast ) {
+		while( pLeft < pRight && !Sort_Less( &Pivot, ++pLeft, Flags ) ) {
+		}
 	} else {
-		pList->pTail = pBeforeNode;
+		while( !Sort_Less( &Pivot, ++pLeft, Flags ) ) {
+		}
 	}
 
-	++pList->cItems;
+	while( pLeft < pRight ) {
+		Sort_SwapRefs( pLeft, pRight );
+		while( Sort_Less( &Pivot, --pRight, Flags ) ) {
+		}
+		while( !Sort_Less( &Pivot, ++pLeft, Flags ) ) {
+		}
+	}
 
-	pList->uCachedIndex = 0;
-	pList->pCachedIndex = NULL;
+	*pFirst = *pRight;
+	*pRight = Pivot;
 
-	return pBeforeNode;
-}
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListInsertAfterNode( TenshiList_t *pList, TenshiListItem_t *pBeforeNode )
-{
-	return teListInsertBeforeNode( pList, pBeforeNode != NULL ? pBeforeNode->pNext : NULL );
+	return pRight;
 }
 
-TENSHI_FUNC void *TENSHI_CALL teListInsertBefore( TenshiList_t *pList, void *pAfter )
-{
-	return teListNodeItem( teListInsertBeforeNode( pList, teListNodeFromItem( pAfter ) ) );
-}
-TENSHI_FUNC void *TENSHI_CALL teListInsertAfter( TenshiList_t *pList, void *pBefore )
+static void Sort_PdqRefs( SortRef_t *pFirst, SortRef_t *pLast, TenshiUInt32_t Flags, unsigned cBadAllowed, int bLeftmost )
 {
-	return teListNodeItem( teListInsertAfterNode( pList, teListNodeFromItem( pBefore ) ) );
+	SortRef_t *pPivot;
+	TenshiUIntPtr_t cRefs;
+	TenshiUIntPtr_t cHalf;
+	TenshiUIntPtr_t cLeft;
+	TenshiUIntPtr_t cRight;
+	int bPartitioned;
+
+	for(;;) {
+		cRefs = ( TenshiUIntPtr_t )( pLast - pFirst );
+
+		if( cRefs < SORT_INSERTION_MAX ) {
+			if( bLeftmost ) {
+				Sort_InsertRefs( pFirst, pLast, Flags );
+			} else {
+				Sort_InsertRefsUnguarded( pFirst, pLast, Flags );
+			}
+
+			return;
+		}
+
+		cHalf = cRefs/2;
+		if( cRefs > SORT_NINTHER_MIN ) {
+			Sort_Sort3Refs( pFirst, pFirst + cHalf, pLast - 1, Flags );
+			Sort_Sort3Refs( pFirst + 1, pFirst + ( cHalf - 1 ), pLast - 2, Flags );
+			Sort_Sort3Refs( pFirst + 2, pFirst + ( cHalf + 1 ), pLast - 3, Flags );
+			Sort_Sort3Refs( pFirst + ( cHalf - 1 ), pFirst + cHalf, pFirst + ( cHalf + 1 ), Flags );
+			Sort_SwapRefs( pFirst, pFirst + cHalf );
+		} else {
+			Sort_Sort3Refs( pFirst + cHalf, pFirst, pLast - 1, Flags );
+		}
+
+		/*
+			a pivot no greater than the key before this range means the range
+			has many keys equal to it; put them all to the left and skip them
+		*/
+		if( !bLeftmost && !Sort_Less( pFirst - 1, pFirst, Flags ) ) {
+			pFirst = Sort_PartitionLeft( pFirst, pLast, Flags ) + 1;
+			continue;
+		}
+
+		pPivot = Sort_PartitionRight( pFirst, pLast, Flags, &bPartitioned );
+
+		cLeft = ( TenshiUIntPtr_t )( pPivot - pFirst );
+		cRight = ( TenshiUIntPtr_t )( pLast - ( pPivot + 1 ) );
+
+		if( cLeft < cRefs/8 || cRight < cRefs/8 ) {
+			/* too many bad pivots; heapsort can't go quadratic */
+			if( --cBadAllowed == 0 ) {
+				Sort_HeapRefs( pFirst, cRefs, Flags );
+				return;
+			}
+
+			/* break up whatever pattern led to the bad pivot */
+			if( cLeft >= SORT_INSERTION_MAX ) {
+				Sort_SwapRefs( pFirst, pFirst + cLeft/4 );
+				Sort_SwapRefs( pPivot - 1, pPivot - cLeft/4 );
+
+				if( cLeft > SORT_NINTHER_MIN ) {
+					Sort_SwapRefs( pFirst + 1, pFirst + ( cLeft/4 + 1 ) );
+					Sort_SwapRefs( pFirst + 2, pFirst + ( cLeft/4 + 2 ) );
+					Sort_SwapRefs( pPivot - 2, pPivot - ( cLeft/4 + 1 ) );
+					Sort_SwapRefs( pPivot - 3, pPivot - ( cLeft/4 + 2 ) );
+				}
+			}
+			if( cRight >= SORT_INSERTION_MAX ) {
+				Sort_SwapRefs( pPivot + 1, pPivot + ( 1 + cRight/4 ) );
+				Sort_SwapRefs( pLast - 1, pLast - cRight/4 );
+
+				if( cRight > SORT_NINTHER_MIN ) {
+					Sort_SwapRefs( pPivot + 2, pPivot + ( 2 + cRight/4 ) );
+					Sort_SwapRefs( pPivot + 3, pPivot + ( 3 + cRight/4 ) );
+					Sort_SwapRefs( pLast - 2, pLast - ( 1 + cRight/4 ) );
+					Sort_SwapRefs( pLast - 3, pLast - ( 2 + cRight/4 ) );
+				}
+			}
+		} else if( bPartitioned && Sort_InsertRefsPartial( pFirst, pPivot, Flags ) && Sort_InsertRefsPartial( pPivot + 1, pLast, Flags ) ) {
+			/* the range was (nearly) sorted already */
+			return;
+		}
+
+		Sort_PdqRefs( pFirst, pPivot, Flags, cBadAllowed, bLeftmost );
+
+		pFirst = pPivot + 1;
+		bLeftmost = 0;
+	}
 }
 
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListInsertNode( TenshiList_t *pList )
+/* stable merge of two sorted ranges into pDst */
+static void Sort_MergeRefs( SortRef_t *pDst, const SortRef_t *pLeft, const SortRef_t *pLeftEnd, const SortRef_t *pRight, const SortRef_t *pRightEnd, TenshiUInt32_t Flags )
 {
-	return teListInsertBeforeNode( pList, pList != NULL ? pList->pCurr : NULL );
+	while( pLeft != pLeftEnd && pRight != pRightEnd ) {
+		if( Sort_Less( pRight, pLeft, Flags ) ) {
+			*pDst++ = *pRight++;
+		} else {
+			*pDst++ = *pLeft++;
+		}
+	}
+
+	if( pLeft != pLeftEnd ) {
+		memcpy( ( void * )pDst, ( const void * )pLeft, ( TenshiUIntPtr_t )( pLeftEnd - pLeft )*sizeof( *pDst ) );
+	} else if( pRight != pRightEnd ) {
+		memcpy( ( void * )pDst, ( const void * )pRight, ( TenshiUIntPtr_t )( pRightEnd - pRight )*sizeof( *pDst ) );
+	}
 }
-TENSHI_FUNC void *TENSHI_CALL teListInsert( TenshiList_t *pList )
+/* stable; pScratch has room for as many refs */
+static void Sort_MergeSortRefs( SortRef_t *pRefs, SortRef_t *pScratch, TenshiUIntPtr_t cRefs, TenshiUInt32_t Flags )
 {
-	return teListNodeItem( teListInsertNode( pList ) );
-}
+	SortRef_t *pSrc;
+	SortRef_t *pDst;
+	SortRef_t *pSwap;
+	TenshiUIntPtr_t cRun;
+	TenshiUIntPtr_t uMid;
+	TenshiUIntPtr_t uEnd;
+	TenshiUIntPtr_t i;
+
+	for( i = 0; i < cRefs; i += SORT_MERGE_RUN ) {
+		uEnd = cRefs - i > SORT_MERGE_RUN ? i + SORT_MERGE_RUN : cRefs;
+		Sort_InsertRefs( pRefs + i, pRefs + uEnd, Flags );
+	}
+
+	pSrc = pRefs;
+	pDst = pScratch;
+	for( cRun = SORT_MERGE_RUN; cRun < cRefs; cRun *= 2 ) {
+		for( i = 0; i < cRefs; i += cRun*2 ) {
+			uMid = cRefs - i > cRun ? i + cRun : cRefs;
+			uEnd = cRefs - uMid > cRun ? uMid + cRun : cRefs;
+
+			Sort_MergeRefs( pDst + i, pSrc + i, pSrc + uMid, pSrc + uMid, pSrc + uEnd, Flags );
+		}
+
+		pSwap = pSrc;
+		pSrc = pDst;
+		pDst = pSwap;
+	}
+
+	if( pSrc != pRefs ) {
+		memcpy( ( void * )pRefs, ( const void * )pSrc, cRefs*sizeof( *pRefs ) );
+	}
+}
+static void Sort_SortRefs( SortRef_t *pRefs, SortRef_t *pScratch, TenshiUIntPtr_t cRefs, TenshiUInt32_t Flags )
+{
+	unsigned cBadAllowed;
+	TenshiUIntPtr_t n;
+
+	if( Flags & kTenshiSortF_Stable ) {
+		Sort_MergeSortRefs( pRefs, pScratch, cRefs, Flags );
+		return;
+	}
+
+	/* log2 of the count */
+	cBadAllowed = 0;
+	for( n = cRefs; n > 1; n /= 2 ) {
+		++cBadAllowed;
+	}
+
+	Sort_PdqRefs( pRefs, pRefs + cRefs, Flags, cBadAllowed + 1, 1 );
+}
+
+static void TENSHI_CALL Sort_LoadRefs_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	SortJob_t *pJob;
+	const TenshiUInt8_t *pKey;
+	TenshiUIntPtr_t i;
+
+	( void )uChunk;
+
+	pJob = ( SortJob_t * )pContext;
+
+	pKey = pJob->pItems + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes + pJob->uKeyOffset;
+	for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+		pJob->pRefs[ i ].pszKey = *( const char *const * )pKey;
+		pJob->pRefs[ i ].uPrefix = Sort_KeyPrefix( pJob->pRefs[ i ].pszKey );
+		pJob->pRefs[ i ].uIndex = i;
+		pKey += pJob->cItemBytes;
+	}
+}
+static void TENSHI_CALL Sort_SortChunk_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	SortJob_t *pJob;
+
+	pJob = ( SortJob_t * )pContext;
+
+	pJob->uRuns[ uChunk ] = ( TenshiUIntPtr_t )iFirst;
+	Sort_SortRefs( pJob->pRefs + iFirst, pJob->pRefsOut + iFirst, ( TenshiUIntPtr_t )( iLast - iFirst ), pJob->Flags );
+}
+/* each iteration merges a pair of runs (or copies the last, unpaired one) */
+static void TENSHI_CALL Sort_MergeRuns_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	SortJob_t *pJob;
+	TenshiUIntPtr_t uLeft, uMid, uEnd;
+	TenshiInt64_t iPair;
+
+	( void )uChunk;
+
+	pJob = ( SortJob_t * )pContext;
+
+	for( iPair = iFirst; iPair < iLast; ++iPair ) {
+		uLeft = pJob->uRuns[ iPair*2 ];
+		uMid = pJob->uRuns[ iPair*2 + 1 ];
+		uEnd = ( TenshiUInt32_t )iPair*2 + 2 <= pJob->cRuns ? pJob->uRuns[ iPair*2 + 2 ] : uMid;
+
+		Sort_MergeRefs( pJob->pRefsOut + uLeft, pJob->pRefs + uLeft, pJob->pRefs + uMid, pJob->pRefs + uMid, pJob->pRefs + uEnd, pJob->Flags );
+	}
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void TENSHI_CALL Sort_Gather_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	SortJob_t *pJob;
+	TenshiUInt8_t *pDst;
+	TenshiUIntPtr_t uSrc;
+	TenshiUIntPtr_t i;
+
+	( void )uChunk;
+
+	pJob = ( SortJob_t * )pContext;
+
+	pDst = pJob->pGather + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes;
+	for( i = ( TenshiUIntPtr_t )iFirst; i < ( TenshiUIntPtr_t )iLast; ++i ) {
+		uSrc = pJob->pRefs != NULL ? pJob->pRefs[ i ].uIndex : pJob->pIndex[ i ];
+
+		memcpy( ( void * )pDst, ( const void * )( pJob->pItems + uSrc*pJob->cItemBytes ), pJob->cItemBytes );
+		pDst += pJob->cItemBytes;
+	}
+}
+/* move the items to the order of the sorted positions */
+static TenshiBoolean_t Sort_Gather( SortJob_t *pJob )
+{
+	pJob->pGather = ( TenshiUInt8_t * )teAlloc( pJob->cItems*pJob->cItemBytes, CURRENT_MEMTAG );
+	if( !pJob->pGather ) {
+		return TENSHI_FALSE;
+	}
+
+	teParallelFor( &Sort_Gather_f, ( void * )pJob, pJob->cItems, pJob->cChunks );
+	memcpy( ( void * )pJob->pItems, ( const void * )pJob->pGather, pJob->cItems*pJob->cItemBytes );
+
+	teDealloc( ( void * )pJob->pGather );
+	pJob->pGather = NULL;
+
+	return TENSHI_TRUE;
+}
+
+static TenshiBoolean_t Sort_ByNumber( SortJob_t *pJob, TenshiBoolean_t bWholeItem )
+{
+	TenshiUInt8_t *pScratch;
+	TenshiUIntPtr_t cBytes;
+	TenshiBoolean_t bOk;
+	TenshiUIntPtr_t n;
+
+	n = pJob->cItems;
+
+	/* keys and their scattered copies, then the positions and theirs */
+	cBytes = n*2*sizeof( TenshiUInt64_t ) + ( bWholeItem ? 0 : n*2*sizeof( TenshiUIntPtr_t ) );
+
+	pScratch = ( TenshiUInt8_t * )teAlloc( cBytes, CURRENT_MEMTAG );
+	pJob->pCounts = ( TenshiUIntPtr_t * )teAlloc( pJob->cChunks*256*sizeof( TenshiUIntPtr_t ), CURRENT_MEMTAG );
+	if( !pScratch || !pJob->pCounts ) {
+		teDealloc( ( void * )pJob->pCounts );
+		teDealloc( ( void * )pScratch );
+		return TENSHI_FALSE;
+	}
+
+	pJob->pKeys = ( TenshiUInt64_t * )pScratch;
+	pJob->pKeysOut = pJob->pKeys + n;
+	if( !bWholeItem ) {
+		pJob->pIndex = ( TenshiUIntPtr_t * )( pJob->pKeysOut + n );
+		pJob->pIndexOut = pJob->pIndex + n;
+	}
+
+	teParallelFor( &Sort_LoadKeys_f, ( void * )pJob, n, pJob->cChunks );
+
+	if( n < SORT_RADIX_MIN ) {
+		Sort_InsertKeys( pJob->pKeys, pJob->pIndex, n );
+	} else {
+		Sort_Radix( pJob );
+	}
+
+	/* the keys of plain arrays are their items */
+	bOk = TENSHI_TRUE;
+	if( bWholeItem ) {
+		teParallelFor( &Sort_StoreKeys_f, ( void * )pJob, n, pJob->cChunks );
+	} else {
+		bOk = Sort_Gather( pJob );
+	}
+
+	teDealloc( ( void * )pJob->pCounts );
+	teDealloc( ( void * )pScratch );
+
+	return bOk;
+}
+static TenshiBoolean_t Sort_ByString( SortJob_t *pJob, TenshiBoolean_t bWholeItem )
+{
+	SortRef_t *pScratch;
+	SortRef_t *pSwap;
+	TenshiBoolean_t bOk;
+	TenshiUIntPtr_t n;
+	TenshiUInt32_t cPairs;
+	TenshiUInt32_t i;
+
+	n = pJob->cItems;
+
+	pScratch = ( SortRef_t * )teAlloc( n*2*sizeof( SortRef_t ), CURRENT_MEMTAG );
+	if( !pScratch ) {
+		return TENSHI_FALSE;
+	}
+
+	pJob->pRefs = pScratch;
+	pJob->pRefsOut = pScratch + n;
+
+	teParallelFor( &Sort_LoadRefs_f, ( void * )pJob, n, pJob->cChunks );
+
+	if( pJob->cChunks == 1 ) {
+		Sort_SortRefs( pJob->pRefs, pJob->pRefsOut, n, pJob->Flags );
+	} else {
+		/* sort a run per chunk, then merge the runs pairwise */
+		teParallelFor( &Sort_SortChunk_f, ( void * )pJob, n, pJob->cChunks );
+
+		pJob->cRuns = pJob->cChunks;
+		pJob->uRuns[ pJob->cRuns ] = n;
+
+		while( pJob->cRuns > 1 ) {
+			cPairs = ( pJob->cRuns + 1 )/2;
+			teParallelFor( &Sort_MergeRuns_f, ( void * )pJob, cPairs, cPairs );
+
+			for( i = 0; i < cPairs; ++i ) {
+				pJob->uRuns[ i ] = pJob->uRuns[ i*2 ];
+			}
+			pJob->cRuns = cPairs;
+			pJob->uRuns[ pJob->cRuns ] = n;
+
+			pSwap = pJob->pRefs;
+			pJob->pRefs = pJob->pRefsOut;
+			pJob->pRefsOut = pSwap;
+		}
+	}
+
+	bOk = TENSHI_TRUE;
+	if( bWholeItem ) {
+		/* the keys of plain arrays are their items */
+		for( i = 0; i < n; ++i ) {
+			( ( const char ** )pJob->pItems )[ i ] = pJob->pRefs[ i ].pszKey;
+		}
+	} else {
+		bOk = Sort_Gather( pJob );
+	}
+
+	teDealloc( ( void * )pScratch );
+	return bOk;
+}
+
+TENSHI_FUNC void TENSHI_CALL teArraySort( void *pArrayData, TenshiUIntPtr_t uKeyOffset, TenshiUInt32_t KeyType, TenshiUInt32_t Flags )
+{
+	TenshiArray_t *pArr;
+	SortJob_t *pJob;
+	TenshiBoolean_t bWholeItem;
+	TenshiBoolean_t bOk;
+	TenshiUInt32_t cWorkers;
+
+	if( !pArrayData ) {
+		return;
+	}
+
+	pArr = ArrayFromData( pArrayData );
+	if( pArr->cItems < 2 ) {
+		return;
+	}
+
+	if( KeyType >= kTenshiNumSortKeys || uKeyOffset + g_SortKeyBytes[ KeyType ] > pArr->cItemBytes ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Sort key (type %u at byte %u) doesn't fit in the array's %u-byte items",
+			( unsigned )KeyType, ( unsigned )uKeyOffset, ( unsigned )pArr->cItemBytes );
+		return;
+	}
+
+	/* too big for the stack with the per chunk arrays */
+	pJob = ( SortJob_t * )teAlloc( sizeof( *pJob ), CURRENT_MEMTAG );
+	if( !pJob ) {
+		return;
+	}
+
+	memset( ( void * )pJob, 0, sizeof( *pJob ) );
+	pJob->pItems = ( TenshiUInt8_t * )pArrayData;
+	pJob->cItems = pArr->cItems;
+	pJob->cItemBytes = pArr->cItemBytes;
+	pJob->uKeyOffset = uKeyOffset;
+	pJob->KeyType = KeyType;
+	pJob->Flags = Flags;
+
+	pJob->cChunks = 1;
+	if( pArr->cItems >= SORT_PARALLEL_MIN ) {
+		cWorkers = teGetWorkerCount();
+		pJob->cChunks = cWorkers < TENSHI_PARALLEL_MAX_WORKERS ? cWorkers : TENSHI_PARALLEL_MAX_WORKERS;
+	}
+
+	bWholeItem = uKeyOffset == 0 && pArr->cItemBytes == g_SortKeyBytes[ KeyType ];
+
+	if( KeyType == kTenshiSortKey_String ) {
+		bOk = Sort_ByString( pJob, bWholeItem );
+	} else {
+		bOk = Sort_ByNumber( pJob, bWholeItem );
+	}
+
+	if( !bOk ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_NOMEM, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Not enough memory to sort %u items", ( unsigned )pArr->cItems );
+	}
+
+	teDealloc( ( void * )pJob );
+}
+
+
+/*
+===============================================================================
+
+	ARRAY BULK OPERATIONS
+
+===============================================================================
+*/
+
+/*
+	ARRAY FILL and ARRAY COPY, and the ARRAY SUM, MIN, MAX and FIND
+	functions, work on a range of an array's items (in memory order) in one
+	call, rather than the generated code visiting each item in turn.
+
+	Items that copy trivially are filled by copying the value into the first
+	item of the range, then copying the filled part over the rest, doubling
+	it up to BULK_FILL_BLOCK bytes; and copied with memcpy, or memmove within
+	one array. Other items (strings, and types that hold them) are finalized
+	and copied one at a time.
+
+	Sums, minimums, maximums and searches over int32, float32 and float64
+	items use SSE2 where it's available, four or two items at a time; the
+	other types have a plain loop each, for the C compiler to vectorize as it
+	can. Sums are kept in 64 bits, so int32 items don't overflow them. NaNs
+	are skipped by MIN and MAX (which are 0 for an array of nothing else) and
+	never found by FIND.
+
+	Ranges of BULK_PARALLEL_MIN bytes or more are split across the PARALLEL
+	FOR workers, and the chunks' results combined in order, so a float sum
+	depends only on the number of workers. A search looks through the first
+	BULK_PARALLEL_MIN bytes on the calling thread first, so finding an early
+	item doesn't cost a pass over the whole array.
+*/
+
+#undef TENSHI_FACILITY
+#define TENSHI_FACILITY             kTenshiLog_CoreRT_Array
+
+/* ranges spanning fewer bytes are handled on the calling thread */
+#ifndef BULK_PARALLEL_MIN
+# define BULK_PARALLEL_MIN          ( 1<<21 )
+#endif
+/* the most a fill copies in one go, so what it copies from stays in cache */
+#define BULK_FILL_BLOCK             4096
+
+typedef union BulkValue_u {
+	TenshiInt64_t                   i;
+	TenshiUInt64_t                  u;
+	double                          f;
+	const char *                    psz;
+} BulkValue_t;
+
+typedef struct BulkJob_s {
+	TenshiUInt8_t *                 pDst;
+	const TenshiUInt8_t *           pSrc;
+	TenshiUIntPtr_t                 cItemBytes;
+	TenshiUInt32_t                  ValueType;
+	TenshiUInt32_t                  Op;
+	/* the value to fill with or search for */
+	const void *                    pValue;
+
+	/* per chunk: its result and whether it has one, or its first match (or -1) */
+	BulkValue_t                     Partial[ TENSHI_PARALLEL_MAX_WORKERS ];
+	TenshiBoolean_t                 bPartial[ TENSHI_PARALLEL_MAX_WORKERS ];
+	TenshiIntPtr_t                  iFound[ TENSHI_PARALLEL_MAX_WORKERS ];
+} BulkJob_t;
+
+/* index of the lowest set bit of a four bit mask */
+static const TenshiUInt8_t g_BulkLowestBit[ 16 ] = {
+	0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
+/* chunks to split cBytes of items into */
+static TenshiUInt32_t Bulk_ChunkCount( TenshiUIntPtr_t cBytes )
+{
+	TenshiUInt32_t cWorkers;
+
+	if( cBytes < BULK_PARALLEL_MIN ) {
+		return 1;
+	}
+
+	cWorkers = teGetWorkerCount();
+	return cWorkers < TENSHI_PARALLEL_MAX_WORKERS ? cWorkers : TENSHI_PARALLEL_MAX_WORKERS;
+}
+/* items of the range starting at uFirst that are within cTotal items */
+static TENSHI_FORCEINLINE TenshiUIntPtr_t Bulk_ClipRange( TenshiUIntPtr_t cTotal, TenshiUIntPtr_t uFirst, TenshiUIntPtr_t cItems )
+{
+	if( uFirst >= cTotal ) {
+		return 0;
+	}
+
+	return cItems < cTotal - uFirst ? cItems : cTotal - uFirst;
+}
+/* strings compare as they do everywhere else, null being empty */
+static TENSHI_FORCEINLINE int Bulk_StrCmp( const char *a, const char *b )
+{
+	return strcmp( a != NULL ? a : "", b != NULL ? b : "" );
+}
+
+/*
+ *  FILL AND COPY
+ */
+
+/* fill n items at pDst with the trivially copied value at pValue */
+static void Bulk_FillTrivial( TenshiUInt8_t *pDst, TenshiUIntPtr_t n, TenshiUIntPtr_t cItemBytes, const void *pValue )
+{
+	const TenshiUInt8_t *pValueBytes;
+	TenshiUIntPtr_t cBytes;
+	TenshiUIntPtr_t cBlock;
+	TenshiUIntPtr_t cDone;
+	TenshiUIntPtr_t cCopy;
+	TenshiUIntPtr_t i;
+
+	if( !n ) {
+		return;
+	}
+
+	pValueBytes = ( const TenshiUInt8_t * )pValue;
+	cBytes = n*cItemBytes;
+
+	/* zero, most often */
+	for( i = 1; i < cItemBytes; ++i ) {
+		if( pValueBytes[ i ] != pValueBytes[ 0 ] ) {
+			break;
+		}
+	}
+	if( i >= cItemBytes ) {
+		memset( ( void * )pDst, pValueBytes[ 0 ], cBytes );
+		return;
+	}
+
+#if SSE2_ENABLED
+	/* items that evenly divide a vector are stored a vector at a time */
+	if( 16 % cItemBytes == 0 ) {
+		TenshiUInt8_t Pattern[ 16 ];
+		__m128i v;
+
+		for( i = 0; i < 16; i += cItemBytes ) {
+			memcpy( ( void * )&Pattern[ i ], pValue, cItemBytes );
+		}
+		v = _mm_loadu_si128( ( const __m128i * )Pattern );
+
+		for( cDone = 0; cDone + 16 <= cBytes; cDone += 16 ) {
+			_mm_storeu_si128( ( __m128i * )( pDst + cDone ), v );
+		}
+		memcpy( ( void * )( pDst + cDone ), ( const void * )Pattern, cBytes - cDone );
+		return;
+	}
+#endif
+
+	memcpy( ( void * )pDst, pValue, cItemBytes );
+
+	/* the block is always a whole number of items */
+	cBlock = cItemBytes;
+	for( cDone = cItemBytes; cDone < cBytes; cDone += cCopy ) {
+		cCopy = cBytes - cDone < cBlock ? cBytes - cDone : cBlock;
+		memcpy( ( void * )( pDst + cDone ), ( const void * )pDst, cCopy );
+
+		if( cBlock < BULK_FILL_BLOCK ) {
+			cBlock += cCopy;
+		}
+	}
+}
+static void TENSHI_CALL Bulk_Fill_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	const BulkJob_t *pJob;
+
+	( void )uChunk;
+
+	pJob = ( const BulkJob_t * )pContext;
+	Bulk_FillTrivial( pJob->pDst + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes, ( TenshiUIntPtr_t )( iLast - iFirst ), pJob->cItemBytes, pJob->pValue );
+}
+static void TENSHI_CALL Bulk_Copy_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	const BulkJob_t *pJob;
+	TenshiUIntPtr_t uOffset;
+
+	( void )uChunk;
+
+	pJob = ( const BulkJob_t * )pContext;
+	uOffset = ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes;
+	memcpy( ( void * )( pJob->pDst + uOffset ), ( const void * )( pJob->pSrc + uOffset ), ( TenshiUIntPtr_t )( iLast - iFirst )*pJob->cItemBytes );
+}
+
+TENSHI_FUNC void TENSHI_CALL teArrayFill( void *pArrayData, const void *pValue, TenshiUIntPtr_t uFirst, TenshiUIntPtr_t cItems )
+{
+	TenshiArray_t *pArr;
+	TenshiType_t *pType;
+	BulkJob_t Job;
+	TenshiUInt8_t *pItem;
+	void *pCopy;
+	TenshiUIntPtr_t i;
+
+	if( !pArrayData || !pValue ) {
+		return;
+	}
+
+	pArr = ArrayFromData( pArrayData );
+	cItems = Bulk_ClipRange( pArr->cItems, uFirst, cItems );
+	if( !cItems ) {
+		return;
+	}
+
+	pType = pArr->pItemType;
+	pItem = ( TenshiUInt8_t * )pArrayData + uFirst*pArr->cItemBytes;
+
+	if( teTypeHasTrivialCopy( pType ) ) {
+		Job.pDst = pItem;
+		Job.cItemBytes = pArr->cItemBytes;
+		Job.pValue = pValue;
+
+		teParallelFor( &Bulk_Fill_f, ( void * )&Job, cItems, Bulk_ChunkCount( cItems*pArr->cItemBytes ) );
+		return;
+	}
+
+	/* the value might be one of the items about to be replaced */
+	pCopy = teAlloc( pArr->cItemBytes, CURRENT_MEMTAG );
+	if( !pCopy ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_NOMEM, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Not enough memory to fill %u items", ( unsigned )cItems );
+		return;
+	}
+	teCopyTypeInstance( pType, pCopy, pValue );
+
+	for( i = 0; i < cItems; ++i ) {
+		teFiniTypeInstance( pType, ( void * )pItem );
+		teCopyTypeInstance( pType, ( void * )pItem, ( const void * )pCopy );
+		pItem += pArr->cItemBytes;
+	}
+
+	teFiniTypeInstance( pType, pCopy );
+	teDealloc( pCopy );
+}
+TENSHI_FUNC void TENSHI_CALL teArrayCopyItems( void *pDstArrayData, TenshiUIntPtr_t uDstFirst, const void *pSrcArrayData, TenshiUIntPtr_t uSrcFirst, TenshiUIntPtr_t cItems )
+{
+	const TenshiArray_t *pSrcArr;
+	TenshiArray_t *pDstArr;
+	TenshiType_t *pType;
+	BulkJob_t Job;
+	const TenshiUInt8_t *pSrc;
+	TenshiUInt8_t *pDst;
+	TenshiUIntPtr_t cItemBytes;
+	TenshiUIntPtr_t i;
+
+	if( !pDstArrayData || !pSrcArrayData ) {
+		return;
+	}
+
+	pDstArr = ArrayFromData( pDstArrayData );
+	pSrcArr = ArrayFromConstData( pSrcArrayData );
+	pType = pDstArr->pItemType;
+	cItemBytes = pDstArr->cItemBytes;
+
+	if( cItemBytes != pSrcArr->cItemBytes || ( !teTypeHasTrivialCopy( pType ) && pType != pSrcArr->pItemType ) ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Can't copy items of %u bytes into an array of different items of %u bytes",
+			( unsigned )pSrcArr->cItemBytes, ( unsigned )cItemBytes );
+		return;
+	}
+
+	cItems = Bulk_ClipRange( pSrcArr->cItems, uSrcFirst, cItems );
+	cItems = Bulk_ClipRange( pDstArr->cItems, uDstFirst, cItems );
+	if( !cItems || ( pDstArrayData == pSrcArrayData && uDstFirst == uSrcFirst ) ) {
+		return;
+	}
+
+	pDst = ( TenshiUInt8_t * )pDstArrayData + uDstFirst*cItemBytes;
+	pSrc = ( const TenshiUInt8_t * )pSrcArrayData + uSrcFirst*cItemBytes;
+
+	if( teTypeHasTrivialCopy( pType ) ) {
+		/* only a range of the same array can overlap */
+		if( pDstArrayData == pSrcArrayData ) {
+			memmove( ( void * )pDst, ( const void * )pSrc, cItems*cItemBytes );
+			return;
+		}
+
+		Job.pDst = pDst;
+		Job.pSrc = pSrc;
+		Job.cItemBytes = cItemBytes;
+
+		teParallelFor( &Bulk_Copy_f, ( void * )&Job, cItems, Bulk_ChunkCount( cItems*cItemBytes ) );
+		return;
+	}
+
+	/* backward when the destination overlaps the end of the source */
+	if( pDst > pSrc ) {
+		for( i = cItems; i-- > 0; ) {
+			teFiniTypeInstance( pType, ( void * )( pDst + i*cItemBytes ) );
+			teCopyTypeInstance( pType, ( void * )( pDst + i*cItemBytes ), ( const void * )( pSrc + i*cItemBytes ) );
+		}
+	} else {
+		for( i = 0; i < cItems; ++i ) {
+			teFiniTypeInstance( pType, ( void * )( pDst + i*cItemBytes ) );
+			teCopyTypeInstance( pType, ( void * )( pDst + i*cItemBytes ), ( const void * )( pSrc + i*cItemBytes ) );
+		}
+	}
+}
+
+/*
+ *  REDUCTION KERNELS
+ *
+ *  Each takes n items (which may be none) and returns whether it has a
+ *  result; integer sums are kept in Out.u, as they wrap.
+ */
+
+#if SSE2_ENABLED
+static TenshiUInt64_t Bulk_SumInt32( const TenshiInt32_t *p, TenshiUIntPtr_t n )
+{
+	TenshiUInt64_t Lanes[ 2 ];
+	TenshiUInt64_t uSum;
+	TenshiUIntPtr_t i;
+	__m128i SumLo;
+	__m128i SumHi;
+	__m128i Sign;
+	__m128i v;
+
+	SumLo = _mm_setzero_si128();
+	SumHi = _mm_setzero_si128();
+	for( i = 0; i + 4 <= n; i += 4 ) {
+		v = _mm_loadu_si128( ( const __m128i * )&p[ i ] );
+		/* sign extend each to 64 bits */
+		Sign = _mm_srai_epi32( v, 31 );
+		SumLo = _mm_add_epi64( SumLo, _mm_unpacklo_epi32( v, Sign ) );
+		SumHi = _mm_add_epi64( SumHi, _mm_unpackhi_epi32( v, Sign ) );
+	}
+	_mm_storeu_si128( ( __m128i * )Lanes, _mm_add_epi64( SumLo, SumHi ) );
+
+	uSum = Lanes[ 0 ] + Lanes[ 1 ];
+	for( ; i < n; ++i ) {
+		uSum += ( TenshiUInt64_t )( TenshiInt64_t )p[ i ];
+	}
+
+	return uSum;
+}
+/* SSE2 has no 32-bit integer min and max, so they're picked with compares */
+static TenshiInt32_t Bulk_MinMaxInt32( const TenshiInt32_t *p, TenshiUIntPtr_t n, TenshiBoolean_t bMax )
+{
+	TenshiInt32_t Lanes[ 4 ];
+	TenshiInt32_t iBest;
+	TenshiUIntPtr_t i;
+	__m128i Best;
+	__m128i Take;
+	__m128i v;
+
+	Best = _mm_set1_epi32( p[ 0 ] );
+	if( bMax ) {
+		for( i = 0; i + 4 <= n; i += 4 ) {
+			v = _mm_loadu_si128( ( const __m128i * )&p[ i ] );
+			Take = _mm_cmpgt_epi32( v, Best );
+			Best = _mm_or_si128( _mm_and_si128( Take, v ), _mm_andnot_si128( Take, Best ) );
+		}
+	} else {
+		for( i = 0; i + 4 <= n; i += 4 ) {
+			v = _mm_loadu_si128( ( const __m128i * )&p[ i ] );
+			Take = _mm_cmplt_epi32( v, Best );
+			Best = _mm_or_si128( _mm_and_si128( Take, v ), _mm_andnot_si128( Take, Best ) );
+		}
+	}
+	_mm_storeu_si128( ( __m128i * )Lanes, Best );
+
+	iBest = Lanes[ 0 ];
+	for( i = 1; i < 4; ++i ) {
+		if( bMax ? Lanes[ i ] > iBest : Lanes[ i ] < iBest ) {
+			iBest = Lanes[ i ];
+		}
+	}
+	for( i = n & ~( TenshiUIntPtr_t )3; i < n; ++i ) {
+		if( bMax ? p[ i ] > iBest : p[ i ] < iBest ) {
+			iBest = p[ i ];
+		}
+	}
+
+	return iBest;
+}
+static double Bulk_SumFloat32( const float *p, TenshiUIntPtr_t n )
+{
+	double Lanes[ 2 ];
+	double Sum;
+	TenshiUIntPtr_t i;
+	__m128d SumLo;
+	__m128d SumHi;
+	__m128 v;
+
+	SumLo = _mm_setzero_pd();
+	SumHi = _mm_setzero_pd();
+	for( i = 0; i + 4 <= n; i += 4 ) {
+		v = _mm_loadu_ps( &p[ i ] );
+		SumLo = _mm_add_pd( SumLo, _mm_cvtps_pd( v ) );
+		SumHi = _mm_add_pd( SumHi, _mm_cvtps_pd( _mm_movehl_ps( v, v ) ) );
+	}
+	_mm_storeu_pd( Lanes, _mm_add_pd( SumLo, SumHi ) );
+
+	Sum = Lanes[ 0 ] + Lanes[ 1 ];
+	for( ; i < n; ++i ) {
+		Sum += p[ i ];
+	}
+
+	return Sum;
+}
+/* p[ 0 ] mustn't be a NaN; the rest are passed over as min and max return their second operand for them */
+static float Bulk_MinMaxFloat32( const float *p, TenshiUIntPtr_t n, TenshiBoolean_t bMax )
+{
+	float Lanes[ 4 ];
+	float Best;
+	TenshiUIntPtr_t i;
+	__m128 BestV;
+
+	BestV = _mm_set1_ps( p[ 0 ] );
+	if( bMax ) {
+		for( i = 0; i + 4 <= n; i += 4 ) {
+			BestV = _mm_max_ps( _mm_loadu_ps( &p[ i ] ), BestV );
+		}
+	} else {
+		for( i = 0; i + 4 <= n; i += 4 ) {
+			BestV = _mm_min_ps( _mm_loadu_ps( &p[ i ] ), BestV );
+		}
+	}
+	_mm_storeu_ps( Lanes, BestV );
+
+	Best = Lanes[ 0 ];
+	for( ; i < n; ++i ) {
+		Best = bMax ? ( p[ i ] > Best ? p[ i ] : Best ) : ( p[ i ] < Best ? p[ i ] : Best );
+	}
+	for( i = 1; i < 4; ++i ) {
+		Best = bMax ? ( Lanes[ i ] > Best ? Lanes[ i ] : Best ) : ( Lanes[ i ] < Best ? Lanes[ i ] : Best );
+	}
+
+	return Best;
+}
+static double Bulk_SumFloat64( const double *p, TenshiUIntPtr_t n )
+{
+	double Lanes[ 2 ];
+	double Sum;
+	TenshiUIntPtr_t i;
+	__m128d SumA;
+	__m128d SumB;
+
+	SumA = _mm_setzero_pd();
+	SumB = _mm_setzero_pd();
+	for( i = 0; i + 4 <= n; i += 4 ) {
+		SumA = _mm_add_pd( SumA, _mm_loadu_pd( &p[ i ] ) );
+		SumB = _mm_add_pd( SumB, _mm_loadu_pd( &p[ i + 2 ] ) );
+	}
+	_mm_storeu_pd( Lanes, _mm_add_pd( SumA, SumB ) );
+
+	Sum = Lanes[ 0 ] + Lanes[ 1 ];
+	for( ; i < n; ++i ) {
+		Sum += p[ i ];
+	}
+
+	return Sum;
+}
+static double Bulk_MinMaxFloat64( const double *p, TenshiUIntPtr_t n, TenshiBoolean_t bMax )
+{
+	double Lanes[ 2 ];
+	double Best;
+	TenshiUIntPtr_t i;
+	__m128d BestV;
+
+	BestV = _mm_set1_pd( p[ 0 ] );
+	if( bMax ) {
+		for( i = 0; i + 2 <= n; i += 2 ) {
+			BestV = _mm_max_pd( _mm_loadu_pd( &p[ i ] ), BestV );
+		}
+	} else {
+		for( i = 0; i + 2 <= n; i += 2 ) {
+			BestV = _mm_min_pd( _mm_loadu_pd( &p[ i ] ), BestV );
+		}
+	}
+	_mm_storeu_pd( Lanes, BestV );
+
+	Best = bMax ? ( Lanes[ 1 ] > Lanes[ 0 ] ? Lanes[ 1 ] : Lanes[ 0 ] ) : ( Lanes[ 1 ] < Lanes[ 0 ] ? Lanes[ 1 ] : Lanes[ 0 ] );
+	for( ; i < n; ++i ) {
+		Best = bMax ? ( p[ i ] > Best ? p[ i ] : Best ) : ( p[ i ] < Best ? p[ i ] : Best );
+	}
+
+	return Best;
+}
+#endif
+
+#define BULK_REDUCE_INTS(T_,W_,Field_)\
+	const T_ *p;\
+	W_ Best;\
+	TenshiUInt64_t uSum;\
+	TenshiUIntPtr_t i;\
+	\
+	if( !n ) {\
+		return TENSHI_FALSE;\
+	}\
+	\
+	p = ( const T_ * )pItems;\
+	if( Op == kTenshiArrayReduce_Sum ) {\
+		uSum = 0;\
+		for( i = 0; i < n; ++i ) {\
+			uSum += ( TenshiUInt64_t )( W_ )p[ i ];\
+		}\
+		pOut->u = uSum;\
+	} else if( Op == kTenshiArrayReduce_Min ) {\
+		Best = ( W_ )p[ 0 ];\
+		for( i = 1; i < n; ++i ) {\
+			Best = ( W_ )p[ i ] < Best ? ( W_ )p[ i ] : Best;\
+		}\
+		pOut->Field_ = Best;\
+	} else {\
+		Best = ( W_ )p[ 0 ];\
+		for( i = 1; i < n; ++i ) {\
+			Best = ( W_ )p[ i ] > Best ? ( W_ )p[ i ] : Best;\
+		}\
+		pOut->Field_ = Best;\
+	}\
+	\
+	return TENSHI_TRUE
+static TenshiBoolean_t Bulk_ReduceInt8( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiInt8_t,TenshiInt64_t,i);
+}
+static TenshiBoolean_t Bulk_ReduceInt16( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiInt16_t,TenshiInt64_t,i);
+}
+static TenshiBoolean_t Bulk_ReduceInt64( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiInt64_t,TenshiInt64_t,i);
+}
+static TenshiBoolean_t Bulk_ReduceUInt8( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiUInt8_t,TenshiUInt64_t,u);
+}
+static TenshiBoolean_t Bulk_ReduceUInt16( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiUInt16_t,TenshiUInt64_t,u);
+}
+static TenshiBoolean_t Bulk_ReduceUInt32( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiUInt32_t,TenshiUInt64_t,u);
+}
+static TenshiBoolean_t Bulk_ReduceUInt64( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiUInt64_t,TenshiUInt64_t,u);
+}
+#if !SSE2_ENABLED
+static TenshiBoolean_t Bulk_ReduceInt32( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_INTS(TenshiInt32_t,TenshiInt64_t,i);
+}
+#else
+static TenshiBoolean_t Bulk_ReduceInt32( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	if( !n ) {
+		return TENSHI_FALSE;
+	}
+
+	if( Op == kTenshiArrayReduce_Sum ) {
+		pOut->u = Bulk_SumInt32( ( const TenshiInt32_t * )pItems, n );
+	} else {
+		pOut->i = Bulk_MinMaxInt32( ( const TenshiInt32_t * )pItems, n, Op == kTenshiArrayReduce_Max );
+	}
+
+	return TENSHI_TRUE;
+}
+#endif
+#undef BULK_REDUCE_INTS
+
+#define BULK_REDUCE_FLOATS(T_)\
+	const T_ *p;\
+	double Sum;\
+	T_ Best;\
+	TenshiUIntPtr_t i;\
+	\
+	p = ( const T_ * )pItems;\
+	if( Op == kTenshiArrayReduce_Sum ) {\
+		if( !n ) {\
+			return TENSHI_FALSE;\
+		}\
+		\
+		Sum = 0.0;\
+		for( i = 0; i < n; ++i ) {\
+			Sum += p[ i ];\
+		}\
+		pOut->f = Sum;\
+		return TENSHI_TRUE;\
+	}\
+	\
+	for( i = 0; i < n && p[ i ] != p[ i ]; ++i ) {\
+	}\
+	if( i == n ) {\
+		return TENSHI_FALSE;\
+	}\
+	\
+	Best = p[ i ];\
+	if( Op == kTenshiArrayReduce_Min ) {\
+		for( ++i; i < n; ++i ) {\
+			Best = p[ i ] < Best ? p[ i ] : Best;\
+		}\
+	} else {\
+		for( ++i; i < n; ++i ) {\
+			Best = p[ i ] > Best ? p[ i ] : Best;\
+		}\
+	}\
+	pOut->f = Best;\
+	\
+	return TENSHI_TRUE
+#if !SSE2_ENABLED
+static TenshiBoolean_t Bulk_ReduceFloat32( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_FLOATS(float);
+}
+static TenshiBoolean_t Bulk_ReduceFloat64( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	BULK_REDUCE_FLOATS(double);
+}
+#else
+static TenshiBoolean_t Bulk_ReduceFloat32( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	const float *p;
+	TenshiUIntPtr_t i;
+
+	p = ( const float * )pItems;
+	if( Op == kTenshiArrayReduce_Sum ) {
+		pOut->f = Bulk_SumFloat32( p, n );
+		return n > 0;
+	}
+
+	/* leading NaNs */
+	for( i = 0; i < n && p[ i ] != p[ i ]; ++i ) {
+	}
+	if( i == n ) {
+		return TENSHI_FALSE;
+	}
+
+	pOut->f = Bulk_MinMaxFloat32( p + i, n - i, Op == kTenshiArrayReduce_Max );
+	return TENSHI_TRUE;
+}
+static TenshiBoolean_t Bulk_ReduceFloat64( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	const double *p;
+	TenshiUIntPtr_t i;
+
+	p = ( const double * )pItems;
+	if( Op == kTenshiArrayReduce_Sum ) {
+		pOut->f = Bulk_SumFloat64( p, n );
+		return n > 0;
+	}
+
+	for( i = 0; i < n && p[ i ] != p[ i ]; ++i ) {
+	}
+	if( i == n ) {
+		return TENSHI_FALSE;
+	}
+
+	pOut->f = Bulk_MinMaxFloat64( p + i, n - i, Op == kTenshiArrayReduce_Max );
+	return TENSHI_TRUE;
+}
+#endif
+#undef BULK_REDUCE_FLOATS
+
+/* strings have no sum; their minimum and maximum are left in Out.psz */
+static TenshiBoolean_t Bulk_ReduceString( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut )
+{
+	const char *const *p;
+	const char *pszBest;
+	TenshiUIntPtr_t i;
+	int iSign;
+
+	if( !n ) {
+		return TENSHI_FALSE;
+	}
+
+	p = ( const char *const * )pItems;
+	iSign = Op == kTenshiArrayReduce_Max ? -1 : 1;
+
+	pszBest = p[ 0 ];
+	for( i = 1; i < n; ++i ) {
+		if( iSign*Bulk_StrCmp( p[ i ], pszBest ) < 0 ) {
+			pszBest = p[ i ];
+		}
+	}
+	pOut->psz = pszBest;
+
+	return TENSHI_TRUE;
+}
+
+typedef TenshiBoolean_t( *BulkFnReduce_t )( const void *pItems, TenshiUIntPtr_t n, TenshiUInt32_t Op, BulkValue_t *pOut );
+
+static const BulkFnReduce_t g_BulkReduce[ kTenshiNumSortKeys ] = {
+	&Bulk_ReduceInt8, &Bulk_ReduceInt16, &Bulk_ReduceInt32, &Bulk_ReduceInt64,
+	&Bulk_ReduceUInt8, &Bulk_ReduceUInt16, &Bulk_ReduceUInt32, &Bulk_ReduceUInt64,
+	&Bulk_ReduceFloat32, &Bulk_ReduceFloat64,
+	&Bulk_ReduceString
+};
+
+/* fold a later chunk's result into those before it */
+static void Bulk_Combine( BulkValue_t *pDst, const BulkValue_t *pSrc, TenshiUInt32_t ValueType, TenshiUInt32_t Op )
+{
+	int iCmp;
+
+	if( Op == kTenshiArrayReduce_Sum ) {
+		if( ValueType >= kTenshiSortKey_Float32 ) {
+			pDst->f += pSrc->f;
+		} else {
+			pDst->u += pSrc->u;
+		}
+		return;
+	}
+
+	if( ValueType <= kTenshiSortKey_Int64 ) {
+		iCmp = pSrc->i < pDst->i ? -1 : pSrc->i > pDst->i ? 1 : 0;
+	} else if( ValueType <= kTenshiSortKey_UInt64 ) {
+		iCmp = pSrc->u < pDst->u ? -1 : pSrc->u > pDst->u ? 1 : 0;
+	} else if( ValueType <= kTenshiSortKey_Float64 ) {
+		iCmp = pSrc->f < pDst->f ? -1 : pSrc->f > pDst->f ? 1 : 0;
+	} else {
+		iCmp = Bulk_StrCmp( pSrc->psz, pDst->psz );
+	}
+
+	if( ( Op == kTenshiArrayReduce_Min && iCmp < 0 ) || ( Op == kTenshiArrayReduce_Max && iCmp > 0 ) ) {
+		*pDst = *pSrc;
+	}
+}
+static void TENSHI_CALL Bulk_Reduce_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	BulkJob_t *pJob;
+
+	pJob = ( BulkJob_t * )pContext;
+	pJob->bPartial[ uChunk ] =
+		g_BulkReduce[ pJob->ValueType ]
+		(
+			( const void * )( pJob->pSrc + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes ),
+			( TenshiUIntPtr_t )( iLast - iFirst ),
+			pJob->Op,
+			&pJob->Partial[ uChunk ]
+		);
+}
+
+/*
+ *  SEARCH KERNELS
+ *
+ *  Each returns the index of the first of n items equal to the value, or -1.
+ */
+
+#define BULK_FIND(T_)\
+	const T_ *p;\
+	T_ Value;\
+	TenshiUIntPtr_t i;\
+	\
+	p = ( const T_ * )pItems;\
+	Value = *( const T_ * )pValue;\
+	for( i = 0; i < n; ++i ) {\
+		if( p[ i ] == Value ) {\
+			return ( TenshiIntPtr_t )i;\
+		}\
+	}\
+	\
+	return -1
+static TenshiIntPtr_t Bulk_Find8( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	BULK_FIND(TenshiUInt8_t);
+}
+static TenshiIntPtr_t Bulk_Find16( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	BULK_FIND(TenshiUInt16_t);
+}
+static TenshiIntPtr_t Bulk_Find64( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	BULK_FIND(TenshiUInt64_t);
+}
+#if !SSE2_ENABLED
+static TenshiIntPtr_t Bulk_Find32( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	BULK_FIND(TenshiUInt32_t);
+}
+static TenshiIntPtr_t Bulk_FindFloat32( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	BULK_FIND(float);
+}
+static TenshiIntPtr_t Bulk_FindFloat64( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	BULK_FIND(double);
+}
+#else
+static TenshiIntPtr_t Bulk_Find32( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	const TenshiUInt32_t *p;
+	TenshiUInt32_t uValue;
+	TenshiUInt32_t uMask;
+	TenshiUIntPtr_t i;
+	__m128i Value;
+
+	p = ( const TenshiUInt32_t * )pItems;
+	uValue = *( const TenshiUInt32_t * )pValue;
+
+	Value = _mm_set1_epi32( ( int )uValue );
+	for( i = 0; i + 4 <= n; i += 4 ) {
+		uMask = ( TenshiUInt32_t )_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_loadu_si128( ( const __m128i * )&p[ i ] ), Value ) ) );
+		if( uMask != 0 ) {
+			return ( TenshiIntPtr_t )( i + g_BulkLowestBit[ uMask ] );
+		}
+	}
+	for( ; i < n; ++i ) {
+		if( p[ i ] == uValue ) {
+			return ( TenshiIntPtr_t )i;
+		}
+	}
+
+	return -1;
+}
+static TenshiIntPtr_t Bulk_FindFloat32( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	const float *p;
+	float fValue;
+	TenshiUInt32_t uMask;
+	TenshiUIntPtr_t i;
+	__m128 Value;
+
+	p = ( const float * )pItems;
+	fValue = *( const float * )pValue;
+
+	Value = _mm_set1_ps( fValue );
+	for( i = 0; i + 4 <= n; i += 4 ) {
+		uMask = ( TenshiUInt32_t )_mm_movemask_ps( _mm_cmpeq_ps( _mm_loadu_ps( &p[ i ] ), Value ) );
+		if( uMask != 0 ) {
+			return ( TenshiIntPtr_t )( i + g_BulkLowestBit[ uMask ] );
+		}
+	}
+	for( ; i < n; ++i ) {
+		if( p[ i ] == fValue ) {
+			return ( TenshiIntPtr_t )i;
+		}
+	}
+
+	return -1;
+}
+static TenshiIntPtr_t Bulk_FindFloat64( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	const double *p;
+	double fValue;
+	TenshiUInt32_t uMask;
+	TenshiUIntPtr_t i;
+	__m128d Value;
+
+	p = ( const double * )pItems;
+	fValue = *( const double * )pValue;
+
+	Value = _mm_set1_pd( fValue );
+	for( i = 0; i + 2 <= n; i += 2 ) {
+		uMask = ( TenshiUInt32_t )_mm_movemask_pd( _mm_cmpeq_pd( _mm_loadu_pd( &p[ i ] ), Value ) );
+		if( uMask != 0 ) {
+			return ( TenshiIntPtr_t )( i + g_BulkLowestBit[ uMask ] );
+		}
+	}
+	if( i < n && p[ i ] == fValue ) {
+		return ( TenshiIntPtr_t )i;
+	}
+
+	return -1;
+}
+#endif
+#undef BULK_FIND
+
+static TenshiIntPtr_t Bulk_FindString( const void *pItems, TenshiUIntPtr_t n, const void *pValue )
+{
+	const char *const *p;
+	const char *pszValue;
+	TenshiUIntPtr_t i;
+
+	p = ( const char *const * )pItems;
+	pszValue = *( const char *const * )pValue;
+	for( i = 0; i < n; ++i ) {
+		if( Bulk_StrCmp( p[ i ], pszValue ) == 0 ) {
+			return ( TenshiIntPtr_t )i;
+		}
+	}
+
+	return -1;
+}
+
+typedef TenshiIntPtr_t( *BulkFnFind_t )( const void *pItems, TenshiUIntPtr_t n, const void *pValue );
+
+/* integers only need comparing bit for bit, whatever their sign */
+static const BulkFnFind_t g_BulkFind[ kTenshiNumSortKeys ] = {
+	&Bulk_Find8, &Bulk_Find16, &Bulk_Find32, &Bulk_Find64,
+	&Bulk_Find8, &Bulk_Find16, &Bulk_Find32, &Bulk_Find64,
+	&Bulk_FindFloat32, &Bulk_FindFloat64,
+	&Bulk_FindString
+};
+
+static void TENSHI_CALL Bulk_Find_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	BulkJob_t *pJob;
+	TenshiIntPtr_t iFound;
+
+	pJob = ( BulkJob_t * )pContext;
+	iFound =
+		g_BulkFind[ pJob->ValueType ]
+		(
+			( const void * )( pJob->pSrc + ( TenshiUIntPtr_t )iFirst*pJob->cItemBytes ),
+			( TenshiUIntPtr_t )( iLast - iFirst ),
+			pJob->pValue
+		);
+
+	pJob->iFound[ uChunk ] = iFound < 0 ? -1 : ( TenshiIntPtr_t )iFirst + iFound;
+}
+
+/* whether the array's items are values of the given type, complaining if not */
+static TenshiBoolean_t Bulk_CheckValueType( const TenshiArray_t *pArr, TenshiUInt32_t ValueType )
+{
+	if( ValueType < kTenshiNumSortKeys && pArr->cItemBytes == g_SortKeyBytes[ ValueType ] ) {
+		return TENSHI_TRUE;
+	}
+
+	teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+		( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+		"Array items of %u bytes aren't values of type %u",
+		( unsigned )pArr->cItemBytes, ( unsigned )ValueType );
+	return TENSHI_FALSE;
+}
+
+TENSHI_FUNC void TENSHI_CALL teArrayReduce( const void *pArrayData, TenshiUInt32_t ValueType, TenshiUInt32_t Op, void *pResult )
+{
+	const TenshiArray_t *pArr;
+	BulkJob_t Job;
+	BulkValue_t Result;
+	TenshiBoolean_t bResult;
+	TenshiUInt32_t cChunks;
+	TenshiUInt32_t uChunk;
+
+	if( !pResult ) {
+		return;
+	}
+
+	Result.u = 0;
+	bResult = TENSHI_FALSE;
+
+	if( Op >= kTenshiNumArrayReduces || ( Op == kTenshiArrayReduce_Sum && ValueType == kTenshiSortKey_String ) ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Can't reduce values of type %u with operation %u", ( unsigned )ValueType, ( unsigned )Op );
+		ValueType = kTenshiSortKey_UInt64;
+		pArrayData = NULL;
+	}
+
+	if( pArrayData != NULL && Bulk_CheckValueType( ArrayFromConstData( pArrayData ), ValueType ) ) {
+		pArr = ArrayFromConstData( pArrayData );
+		cChunks = Bulk_ChunkCount( pArr->cItems*pArr->cItemBytes );
+
+		if( cChunks < 2 ) {
+			bResult = g_BulkReduce[ ValueType ]( pArrayData, pArr->cItems, Op, &Result );
+		} else {
+			Job.pSrc = ( const TenshiUInt8_t * )pArrayData;
+			Job.cItemBytes = pArr->cItemBytes;
+			Job.ValueType = ValueType;
+			Job.Op = Op;
+
+			teParallelFor( &Bulk_Reduce_f, ( void * )&Job, pArr->cItems, cChunks );
+
+			for( uChunk = 0; uChunk < cChunks; ++uChunk ) {
+				if( !Job.bPartial[ uChunk ] ) {
+					continue;
+				}
+
+				if( !bResult ) {
+					Result = Job.Partial[ uChunk ];
+					bResult = TENSHI_TRUE;
+				} else {
+					Bulk_Combine( &Result, &Job.Partial[ uChunk ], ValueType, Op );
+				}
+			}
+		}
+	}
+
+	/* an empty array's result is zero */
+	if( !bResult ) {
+		Result.u = 0;
+		if( ValueType >= kTenshiSortKey_Float32 && ValueType <= kTenshiSortKey_Float64 ) {
+			Result.f = 0.0;
+		} else if( ValueType == kTenshiSortKey_String ) {
+			Result.psz = NULL;
+		}
+	}
+
+	if( Op == kTenshiArrayReduce_Sum ) {
+		*( BulkValue_t * )pResult = Result;
+		return;
+	}
+
+	switch( ValueType ) {
+	case kTenshiSortKey_Int8:    *( TenshiInt8_t * )pResult = ( TenshiInt8_t )Result.i; break;
+	case kTenshiSortKey_Int16:   *( TenshiInt16_t * )pResult = ( TenshiInt16_t )Result.i; break;
+	case kTenshiSortKey_Int32:   *( TenshiInt32_t * )pResult = ( TenshiInt32_t )Result.i; break;
+	case kTenshiSortKey_Int64:   *( TenshiInt64_t * )pResult = Result.i; break;
+	case kTenshiSortKey_UInt8:   *( TenshiUInt8_t * )pResult = ( TenshiUInt8_t )Result.u; break;
+	case kTenshiSortKey_UInt16:  *( TenshiUInt16_t * )pResult = ( TenshiUInt16_t )Result.u; break;
+	case kTenshiSortKey_UInt32:  *( TenshiUInt32_t * )pResult = ( TenshiUInt32_t )Result.u; break;
+	case kTenshiSortKey_UInt64:  *( TenshiUInt64_t * )pResult = Result.u; break;
+	case kTenshiSortKey_Float32: *( float * )pResult = ( float )Result.f; break;
+	case kTenshiSortKey_Float64: *( double * )pResult = Result.f; break;
+	case kTenshiSortKey_String:  *( char ** )pResult = teStrDup( Result.psz ); break;
+	}
+}
+TENSHI_FUNC TenshiIntPtr_t TENSHI_CALL teArrayFind( const void *pArrayData, TenshiUInt32_t ValueType, const void *pValue, TenshiUIntPtr_t uFirst )
+{
+	const TenshiArray_t *pArr;
+	const TenshiUInt8_t *pItems;
+	BulkJob_t Job;
+	TenshiIntPtr_t iFound;
+	TenshiUIntPtr_t cItems;
+	TenshiUIntPtr_t cHead;
+	TenshiUInt32_t cChunks;
+	TenshiUInt32_t uChunk;
+
+	if( !pArrayData || !pValue ) {
+		return -1;
+	}
+
+	pArr = ArrayFromConstData( pArrayData );
+	if( !Bulk_CheckValueType( pArr, ValueType ) || uFirst >= pArr->cItems ) {
+		return -1;
+	}
+
+	pItems = ( const TenshiUInt8_t * )pArrayData + uFirst*pArr->cItemBytes;
+	cItems = pArr->cItems - uFirst;
+
+	/* look near the start before waking the workers */
+	cHead = BULK_PARALLEL_MIN/pArr->cItemBytes;
+	if( cHead > cItems ) {
+		cHead = cItems;
+	}
+
+	iFound = g_BulkFind[ ValueType ]( ( const void * )pItems, cHead, pValue );
+	if( iFound >= 0 || cHead == cItems ) {
+		return iFound < 0 ? -1 : ( TenshiIntPtr_t )uFirst + iFound;
+	}
+
+	Job.pSrc = pItems + cHead*pArr->cItemBytes;
+	Job.cItemBytes = pArr->cItemBytes;
+	Job.ValueType = ValueType;
+	Job.pValue = pValue;
+
+	cChunks = Bulk_ChunkCount( ( cItems - cHead )*pArr->cItemBytes );
+	teParallelFor( &Bulk_Find_f, ( void * )&Job, cItems - cHead, cChunks );
+
+	for( uChunk = 0; uChunk < cChunks; ++uChunk ) {
+		if( Job.iFound[ uChunk ] >= 0 ) {
+			return ( TenshiIntPtr_t )( uFirst + cHead ) + Job.iFound[ uChunk ];
+		}
+	}
+
+	return -1;
+}
+
+
+/*
+===============================================================================
+
+	LINKED LIST
+
+===============================================================================
+*/
+
+#undef TENSHI_FACILITY
+#define TENSHI_FACILITY             kTenshiLog_CoreRT_List
+
+/* items in a list's first slab; each later slab is twice the last, up to the maximum */
+#define LIST_FIRST_SLAB_ITEMS       16
+#define LIST_MAX_SLAB_ITEMS         4096
+/* items (and the slab header) are kept on 16-byte boundaries for SIMD types */
+#define LIST_ALIGN(n)               ( ( ( n ) + 15 ) & ~( TenshiUIntPtr_t )15 )
+#define LIST_SLAB_HEADER_BYTES      LIST_ALIGN( sizeof( TenshiListSlab_t ) )
+
+static TenshiListItem_t *List_AllocItem( TenshiList_t *pList )
+{
+	TenshiListSlab_t *pSlab;
+	TenshiListItem_t *pItem;
+	TenshiUIntPtr_t cSlabItems;
+
+	if( pList->pFreeItems != NULL ) {
+		pItem = pList->pFreeItems;
+		pList->pFreeItems = pItem->pNext;
+
+		return pItem;
+	}
+
+	if( !pList->cSlabItemsLeft ) {
+		cSlabItems = LIST_FIRST_SLAB_ITEMS;
+		if( pList->pSlabs != NULL ) {
+			cSlabItems = pList->pSlabs->cItems < LIST_MAX_SLAB_ITEMS/2 ? pList->pSlabs->cItems*2 : LIST_MAX_SLAB_ITEMS;
+		}
+
+		pSlab = ( TenshiListSlab_t * )teAlloc( LIST_SLAB_HEADER_BYTES + cSlabItems*pList->cItemStride, g_RTGlob.iCurrentMemtag );
+		if( !pSlab ) {
+			return NULL;
+		}
+
+		pSlab->pNext = pList->pSlabs;
+		pSlab->cItems = cSlabItems;
+		pList->pSlabs = pSlab;
+
+		pList->pSlabCursor = ( TenshiUInt8_t * )pSlab + LIST_SLAB_HEADER_BYTES;
+		pList->cSlabItemsLeft = cSlabItems;
+	}
+
+	pItem = ( TenshiListItem_t * )pList->pSlabCursor;
+	pList->pSlabCursor += pList->cItemStride;
+	--pList->cSlabItemsLeft;
+
+	return pItem;
+}
+static void List_FreeItem( TenshiList_t *pList, TenshiListItem_t *pItem )
+{
+	pItem->pPrev = NULL;
+	pItem->pNext = pList->pFreeItems;
+	pList->pFreeItems = pItem;
+}
+static void List_ReleaseSlabs( TenshiList_t *pList )
+{
+	TenshiListSlab_t *pSlab;
+	TenshiListSlab_t *pNext;
+
+	for( pSlab = pList->pSlabs; pSlab != NULL; pSlab = pNext ) {
+		pNext = pSlab->pNext;
+		teDealloc( ( void * )pSlab );
+	}
+
+	pList->pSlabs = NULL;
+	pList->pFreeItems = NULL;
+	pList->pSlabCursor = NULL;
+	pList->cSlabItemsLeft = 0;
+}
+
+static TenshiBoolean_t List_ReserveIndex( TenshiList_t *pList, TenshiUIntPtr_t cIndexItems )
+{
+	TenshiListItem_t **ppIndex;
+	TenshiUIntPtr_t cMaxIndexItems;
+
+	if( cIndexItems <= pList->cMaxIndexItems ) {
+		return TENSHI_TRUE;
+	}
+
+	cMaxIndexItems = pList->cMaxIndexItems > 0 ? pList->cMaxIndexItems*2 : 16;
+	if( cMaxIndexItems < cIndexItems ) {
+		cMaxIndexItems = cIndexItems;
+	}
+
+	ppIndex = ( TenshiListItem_t ** )teRealloc( ( void * )pList->ppIndex, cMaxIndexItems*sizeof( TenshiListItem_t * ), g_RTGlob.iCurrentMemtag );
+	if( !ppIndex ) {
+		return TENSHI_FALSE;
+	}
+
+	pList->ppIndex = ppIndex;
+	pList->cMaxIndexItems = cMaxIndexItems;
+
+	return TENSHI_TRUE;
+}
+static TenshiBoolean_t List_RebuildIndex( TenshiList_t *pList )
+{
+	TenshiListItem_t *pItem;
+	TenshiUIntPtr_t i;
+
+	if( !List_ReserveIndex( pList, ( pList->cItems + TENSHI_LIST_INDEX_STRIDE - 1 )/TENSHI_LIST_INDEX_STRIDE ) ) {
+		return TENSHI_FALSE;
+	}
+
+	pList->cIndexItems = 0;
+	for( pItem = pList->pHead, i = 0; pItem != NULL; pItem = pItem->pNext, ++i ) {
+		if( i % TENSHI_LIST_INDEX_STRIDE == 0 ) {
+			pList->ppIndex[ pList->cIndexItems++ ] = pItem;
+		}
+	}
+
+	pList->bIndexStale = TENSHI_FALSE;
+	return TENSHI_TRUE;
+}
+/* items were added or removed somewhere other than the back */
+static void List_Reordered( TenshiList_t *pList )
+{
+	pList->bIndexStale = TENSHI_TRUE;
+
+	pList->uCachedIndex = 0;
+	pList->pCachedIndex = NULL;
+}
+/* pItem was just added to the back */
+static void List_Appended( TenshiList_t *pList, TenshiListItem_t *pItem )
+{
+	if( pList->bIndexStale || ( pList->cItems - 1 ) % TENSHI_LIST_INDEX_STRIDE != 0 ) {
+		return;
+	}
+
+	if( !List_ReserveIndex( pList, pList->cIndexItems + 1 ) ) {
+		pList->bIndexStale = TENSHI_TRUE;
+		return;
+	}
+
+	pList->ppIndex[ pList->cIndexItems++ ] = pItem;
+}
+
+static void List_Unlink( TenshiList_t *pList, TenshiListItem_t *pItem )
+{
+	if( pItem == pList->pTail ) {
+		/* nothing comes after the back, so the positions are unchanged */
+		if( !pList->bIndexStale && ( pList->cItems - 1 ) % TENSHI_LIST_INDEX_STRIDE == 0 ) {
+			--pList->cIndexItems;
+		}
+
+		if( pList->pCachedIndex == pItem ) {
+			pList->pCachedIndex = pItem->pPrev;
+			pList->uCachedIndex = pItem->pPrev != NULL ? pList->uCachedIndex - 1 : 0;
+		}
+	} else if( pList->pCachedIndex == pItem ) {
+		/* the next item takes this one's position */
+		pList->pCachedIndex = pItem->pNext;
+		pList->bIndexStale = TENSHI_TRUE;
+	} else {
+		List_Reordered( pList );
+	}
+
+	if( pItem->pPrev != NULL ) {
+		pItem->pPrev->pNext = pItem->pNext;
+	} else {
+		pList->pHead = pItem->pNext;
+	}
+
+	if( pItem->pNext != NULL ) {
+		pItem->pNext->pPrev = pItem->pPrev;
+	} else {
+		pList->pTail = pItem->pPrev;
+	}
+
+	pItem->pPrev = NULL;
+	pItem->pNext = NULL;
+
+	if( pList->pCurr == pItem ) {
+		pList->pCurr = NULL;
+	}
+}
+
+TENSHI_FUNC TenshiList_t *TENSHI_CALL teNewList( TenshiType_t *pItemType )
+{
+	TenshiList_t *pList;
+
+	if( !pItemType ) {
+		return NULL;
+	}
+
+	pList = ( TenshiList_t * )teAlloc( sizeof( TenshiList_t ), g_RTGlob.iCurrentMemtag );
+	if( !pList ) {
+		return NULL;
+	}
+
+	pList->pHead = NULL;
+	pList->pTail = NULL;
+	pList->pCurr = NULL;
+
+	pList->cItems = 0;
+	pList->cItemBytes = pItemType->cBytes;
+	pList->pItemType = pItemType;
+
+	pList->uCachedIndex = 0;
+	pList->pCachedIndex = NULL;
+
+	pList->pSlabs = NULL;
+	pList->pFreeItems = NULL;
+	pList->pSlabCursor = NULL;
+	pList->cSlabItemsLeft = 0;
+	pList->cItemStride = LIST_ALIGN( sizeof( TenshiListItem_t ) + pItemType->cBytes );
+
+	pList->ppIndex = NULL;
+	pList->cIndexItems = 0;
+	pList->cMaxIndexItems = 0;
+	pList->bIndexStale = TENSHI_FALSE;
+
+	return pList;
+}
+TENSHI_FUNC TenshiList_t *TENSHI_CALL teDeleteList( TenshiList_t *pList )
+{
+	if( !pList ) {
+		return NULL;
+	}
+
+	teEmptyList( pList );
+	teDealloc( ( void * )pList->ppIndex );
+	teDealloc( ( void * )pList );
+
+	return NULL;
+}
+
+TENSHI_FUNC void *TENSHI_CALL teListNodeItem( TenshiListItem_t *pItem )
+{
+	if( !pItem ) {
+		return NULL;
+	}
+
+	return ( void * )( pItem + 1 );
+}
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListNodeFromItem( void *pData )
+{
+	if( !pData ) {
+		return NULL;
+	}
+
+	return ( ( TenshiListItem_t * )pData ) - 1;
+}
+
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListFrontNode( TenshiList_t *pList )
+{
+	return pList != NULL ? pList->pHead : NULL;
+}
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListBackNode( TenshiList_t *pList )
+{
+	return pList != NULL ? pList->pTail : NULL;
+}
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL tePreviousListNode( TenshiListItem_t *pNode )
+{
+	return pNode != NULL ? pNode->pPrev : NULL;
+}
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teNextListNode( TenshiListItem_t *pNode )
+{
+	return pNode != NULL ? pNode->pNext : NULL;
+}
+
+TENSHI_FUNC void *TENSHI_CALL teListFront( TenshiList_t *pList )
+{
+	return teListNodeItem( pList != NULL ? pList->pHead : NULL );
+}
+TENSHI_FUNC void *TENSHI_CALL teListBack( TenshiList_t *pList )
+{
+	return teListNodeItem( pList != NULL ? pList->pTail : NULL );
+}
+TENSHI_FUNC void *TENSHI_CALL teListPrevious( void *pData )
+{
+	TenshiListItem_t *pItem;
+
+	if( !pData ) {
+		return NULL;
+	}
+
+	pItem = ( ( TenshiListItem_t * )pData ) - 1;
+	return teListNodeItem( pItem->pPrev );
+}
+TENSHI_FUNC void *TENSHI_CALL teListNext( void *pData )
+{
+	TenshiListItem_t *pItem;
+
+	if( !pData ) {
+		return NULL;
+	}
+
+	pItem = ( ( TenshiListItem_t * )pData ) - 1;
+	return teListNodeItem( pItem->pNext );
+}
+
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListInsertBeforeNode( TenshiList_t *pList, TenshiListItem_t *pAfterNode )
+{
+	TenshiListItem_t *pBeforeNode;
+
+	if( !pList ) {
+		return NULL;
+	}
+
+	pBeforeNode = List_AllocItem( pList );
+	if( !pBeforeNode ) {
+		return NULL;
+	}
+	if( !teInitTypeInstance( pList->pItemType, teListNodeItem( pBeforeNode ) ) ) {
+		List_FreeItem( pList, pBeforeNode );
+		return NULL;
+	}
+
+	if( !pAfterNode ) {
+		pBeforeNode->pPrev = pList->pTail;
+		pBeforeNode->pNext = NULL;
+	} else {
+		pBeforeNode->pPrev = pAfterNode->pPrev;
+		pBeforeNode->pNext = pAfterNode;
+	}
+
+	if( pBeforeNode->pPrev != NULL ) {
+		pBeforeNode->pPrev->pNext = pBeforeNode;
+	} else {
+		pList->pHead = pBeforeNode;
+	}
+	if( pBeforeNode->pNext != NULL ) {
+		pBeforeNode->pNext->pPrev = pBeforeNode;
+	} else {
+		pList->pTail = pBeforeNode;
+	}
+
+	++pList->cItems;
+
+	if( !pAfterNode ) {
+		List_Appended( pList, pBeforeNode );
+	} else {
+		List_Reordered( pList );
+	}
+
+	return pBeforeNode;
+}
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListInsertAfterNode( TenshiList_t *pList, TenshiListItem_t *pBeforeNode )
+{
+	return teListInsertBeforeNode( pList, pBeforeNode != NULL ? pBeforeNode->pNext : NULL );
+}
+
+TENSHI_FUNC void *TENSHI_CALL teListInsertBefore( TenshiList_t *pList, void *pAfter )
+{
+	return teListNodeItem( teListInsertBeforeNode( pList, teListNodeFromItem( pAfter ) ) );
+}
+TENSHI_FUNC void *TENSHI_CALL teListInsertAfter( TenshiList_t *pList, void *pBefore )
+{
+	return teListNodeItem( teListInsertAfterNode( pList, teListNodeFromItem( pBefore ) ) );
+}
+
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListInsertNode( TenshiList_t *pList )
+{
+	return teListInsertBeforeNode( pList, pList != NULL ? pList->pCurr : NULL );
+}
+TENSHI_FUNC void *TENSHI_CALL teListInsert( TenshiList_t *pList )
+{
+	return teListNodeItem( teListInsertNode( pList ) );
+}
+
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListAddNodeToFront( TenshiList_t *pList )
+{
+	if( !pList ) {
+		return NULL;
+	}
+
+	return teListInsertBeforeNode( pList, pList->pHead );
+}
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListAddNodeToBack( TenshiList_t *pList )
+{
+	if( !pList ) {
+		return NULL;
+	}
+
+	return teListInsertBeforeNode( pList, NULL );
+}
+TENSHI_FUNC void *TENSHI_CALL teListAddToFront( TenshiList_t *pList )
+{
+	return teListNodeItem( teListAddNodeToFront( pList ) );
+}
+TENSHI_FUNC void *TENSHI_CALL teListAddToBack( TenshiList_t *pList )
+{
+	return teListNodeItem( teListAddNodeToBack( pList ) );
+}
+
+TENSHI_FUNC void TENSHI_CALL teListDeleteNode( TenshiList_t *pList, TenshiListItem_t *pItem )
+{
+	if( !pList || !pItem ) {
+		return;
+	}
+
+	List_Unlink( pList, pItem );
+	--pList->cItems;
+
+	teFiniTypeInstance( pList->pItemType, teListNodeItem( pItem ) );
+	List_FreeItem( pList, pItem );
+}
+
+TENSHI_FUNC void TENSHI_CALL teListDeleteFront( TenshiList_t *pList )
+{
+	if( !pList || !pList->pHead ) {
+		return;
+	}
+
+	teListDeleteNode( pList, pList->pHead );
+}
+TENSHI_FUNC void TENSHI_CALL teListDeleteBack( TenshiList_t *pList )
+{
+	if( !pList || !pList->pTail ) {
+		return;
+	}
+
+	teListDeleteNode( pList, pList->pTail );
+}
+TENSHI_FUNC void TENSHI_CALL teListDelete( TenshiList_t *pList )
+{
+	if( !pList || !pList->pCurr ) {
+		return;
+	}
+
+	teListDeleteNode( pList, pList->pCurr );
+}
+
+TENSHI_FUNC void TENSHI_CALL teListToFront( TenshiList_t *pList )
+{
+	if( !pList ) {
+		return;
+	}
+
+	pList->pCurr = pList->pHead;
+}
+TENSHI_FUNC void TENSHI_CALL teListToBack( TenshiList_t *pList )
+{
+	if( !pList ) {
+		return;
+	}
+
+	pList->pCurr = pList->pTail;
+}
+TENSHI_FUNC void TENSHI_CALL teListToPrevious( TenshiList_t *pList )
+{
+	if( !pList || !pList->pCurr ) {
+		return;
+	}
+
+	pList->pCurr = pList->pCurr->pPrev;
+}
+TENSHI_FUNC void TENSHI_CALL teListToNext( TenshiList_t *pList )
+{
+	if( !pList || !pList->pCurr ) {
+		return;
+	}
+
+	pList->pCurr = pList->pCurr->pNext;
+}
+
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teListIsValid( const TenshiList_t *pList )
+{
+	if( !pList ) {
+		return TENSHI_FALSE;
+	}
+
+	return pList->pCurr != NULL ? TENSHI_TRUE : TENSHI_FALSE;
+}
+
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListCurrentNode( TenshiList_t *pList )
+{
+	return pList != NULL ? pList->pCurr : NULL;
+}
+TENSHI_FUNC void *TENSHI_CALL teListCurrent( TenshiList_t *pList )
+{
+	return teListNodeItem( teListCurrentNode( pList ) );
+}
+TENSHI_FUNC void TENSHI_CALL teListResetCurrent( TenshiList_t *pList )
+{
+	if( !pList ) {
+		return;
+	}
+
+	pList->pCurr = NULL;
+}
+
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teListIsEmpty( const TenshiList_t *pList )
+{
+	if( !pList ) {
+		return TENSHI_TRUE;
+	}
+
+	return pList->pHead == NULL ? TENSHI_TRUE : TENSHI_FALSE;
+}
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teListLen( const TenshiList_t *pList )
+{
+	if( !pList ) {
+		return 0;
+	}
+
+	return pList->cItems;
+}
+TENSHI_FUNC void TENSHI_CALL teEmptyList( TenshiList_t *pList )
+{
+	TenshiListItem_t *pItem;
+
+	if( !pList ) {
+		return;
+	}
+
+	for( pItem = pList->pHead; pItem != NULL; pItem = pItem->pNext ) {
+		teFiniTypeInstance( pList->pItemType, teListNodeItem( pItem ) );
+	}
+
+	List_ReleaseSlabs( pList );
+
+	pList->pHead = NULL;
+	pList->pTail = NULL;
+	pList->pCurr = NULL;
+	pList->cItems = 0;
+
+	pList->uCachedIndex = 0;
+	pList->pCachedIndex = NULL;
+
+	pList->cIndexItems = 0;
+	pList->bIndexStale = TENSHI_FALSE;
+}
+
+TENSHI_FUNC void TENSHI_CALL teListMoveToFront( TenshiList_t *pList )
+{
+	TenshiListItem_t *pCurr;
+
+	if( !pList || !pList->pCurr ) {
+		return;
+	}
+
+	pCurr = pList->pCurr;
+	List_Unlink( pList, pCurr );
+
+	if( pList->pHead != NULL ) {
+		pCurr->pNext = pList->pHead;
+		pList->pHead->pPrev = pCurr;
+	} else {
+		pList->pTail = pCurr;
+	}
+	pList->pHead = pCurr;
+	pList->pCurr = pCurr;
+
+	List_Reordered( pList );
+}
+TENSHI_FUNC void TENSHI_CALL teListMoveToBack( TenshiList_t *pList )
+{
+	TenshiListItem_t *pCurr;
+
+	if( !pList || !pList->pCurr ) {
+		return;
+	}
+
+	pCurr = pList->pCurr;
+	List_Unlink( pList, pCurr );
+
+	if( pList->pTail != NULL ) {
+		pCurr->pPrev = pList->pTail;
+		pList->pTail->pNext = pCurr;
+	} else {
+		pList->pHead = pCurr;
+	}
+	pList->pTail = pCurr;
+	pList->pCurr = pCurr;
+
+	List_Reordered( pList );
+}
+TENSHI_FUNC void TENSHI_CALL teListMoveToPrevious( TenshiList_t *pList )
+{
+	TenshiListItem_t *pNode;
+	TenshiListItem_t *pBefore;
+
+	if( !pList || !pList->pCurr || !pList->pCurr->pPrev ) {
+		return;
+	}
+
+	pNode = pList->pCurr;
+	pBefore = pList->pCurr->pPrev;
+	List_Unlink( pList, pNode );
+
+	pNode->pNext = pBefore;
+	pNode->pPrev = pBefore->pPrev;
+	if( pBefore->pPrev != NULL ) {
+		pBefore->pPrev->pNext = pNode;
+	} else {
+		pList->pHead = pNode;
+	}
+	pBefore->pPrev = pNode;
+	pList->pCurr = pNode;
+
+	List_Reordered( pList );
+}
+TENSHI_FUNC void TENSHI_CALL teListMoveToNext( TenshiList_t *pList )
+{
+	TenshiListItem_t *pNode;
+	TenshiListItem_t *pAfter;
+
+	if( !pList || !pList->pCurr || !pList->pCurr->pNext ) {
+		return;
+	}
+
+	pNode = pList->pCurr;
+	pAfter = pList->pCurr->pNext;
+	List_Unlink( pList, pNode );
+
+	pNode->pPrev = pAfter;
+	pNode->pNext = pAfter->pNext;
+	if( pAfter->pNext != NULL ) {
+		pAfter->pNext->pPrev = pNode;
+	} else {
+		pList->pTail = pNode;
+	}
+	pAfter->pNext = pNode;
+	pList->pCurr = pNode;
+
+	List_Reordered( pList );
+}
+
+TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListNodeAt( TenshiList_t *pList, TenshiUIntPtr_t uIndex )
+{
+	TenshiUIntPtr_t uNearest;
+	TenshiUIntPtr_t cDistance;
+	TenshiUIntPtr_t uEntry;
+
+	if( !pList || uIndex >= pList->cItems ) {
+		return NULL;
+	}
+
+	if( pList->bIndexStale && !List_RebuildIndex( pList ) ) {
+		pList->cIndexItems = 0;
+	}
+
+	/* start from whichever of the ends, the indexed items, or the cache is closest */
+	if( uIndex > pList->cItems/2 ) {
+		uNearest = pList->cItems - 1;
+		cDistance = uNearest - uIndex;
+	} else {
+		uNearest = 0;
+		cDistance = uIndex;
+	}
+
+	uEntry = uIndex/TENSHI_LIST_INDEX_STRIDE;
+	if( uEntry < pList->cIndexItems && uIndex - uEntry*TENSHI_LIST_INDEX_STRIDE < cDistance ) {
+		uNearest = uEntry*TENSHI_LIST_INDEX_STRIDE;
+		cDistance = uIndex - uNearest;
+	}
+	if( uEntry + 1 < pList->cIndexItems && ( uEntry + 1 )*TENSHI_LIST_INDEX_STRIDE - uIndex < cDistance ) {
+		++uEntry;
+		uNearest = uEntry*TENSHI_LIST_INDEX_STRIDE;
+		cDistance = uNearest - uIndex;
+	}
+
+	if( !pList->pCachedIndex || ( pList->uCachedIndex > uIndex ? pList->uCachedIndex - uIndex : uIndex - pList->uCachedIndex ) > cDistance ) {
+		if( uNearest == 0 ) {
+			pList->pCachedIndex = pList->pHead;
+		} else if( uNearest == pList->cItems - 1 ) {
+			pList->pCachedIndex = pList->pTail;
+		} else {
+			pList->pCachedIndex = pList->ppIndex[ uEntry ];
+		}
+
+		pList->uCachedIndex = uNearest;
+	}
+
+	while( pList->uCachedIndex < uIndex ) {
+		pList->pCachedIndex = pList->pCachedIndex->pNext;
+		++pList->uCachedIndex;
+	}
+
+	while( pList->uCachedIndex > uIndex ) {
+		pList->pCachedIndex = pList->pCachedIndex->pPrev;
+		--pList->uCachedIndex;
+	}
+
+	return pList->pCachedIndex;
+}
+TENSHI_FUNC void *TENSHI_CALL teListAt( TenshiList_t *pList, TenshiUIntPtr_t uIndex )
+{
+	return teListNodeItem( teListNodeAt( pList, uIndex ) );
+}
+
+
+/*
+===============================================================================
+
+	BINARY TREE
+
+===============================================================================
+*/
+
+#undef TENSHI_FACILITY
+#define TENSHI_FACILITY             kTenshiLog_CoreRT_BTree
+
+TENSHI_FUNC TenshiBTree_t *TENSHI_CALL teNewBTree( TenshiType_t *pItemType )
+{
+	TenshiBTree_t *pBase;
+
+	if( !pItemType ) {
+		return NULL;
+	}
+
+	pBase = ( TenshiBTree_t * )teAlloc( sizeof( TenshiBTree_t ), g_RTGlob.iCurrentMemtag );
+	if( !pBase ) {
+		return NULL;
+	}
+
+	pBase->pRoot = NULL;
+	pBase->pHead = NULL;
+	pBase->pTail = NULL;
+
+	pBase->pItemType = pItemType;
+	pBase->cItemBytes = pItemType->cBytes;
+
+	return pBase;
+}
+TENSHI_FUNC TenshiBTree_t *TENSHI_CALL teDeleteBTree( TenshiBTree_t *pBase )
+{
+	if( !pBase ) {
+		return NULL;
+	}
+
+	teEmptyBTree( pBase );
+	teDealloc( ( void * )pBase );
+
+	return NULL;
+}
+
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teBTreeIsEmpty( const TenshiBTree_t *pBase )
+{
+	return pBase == NULL || pBase->pHead == NULL ? TENSHI_TRUE : TENSHI_FALSE;
+}
+TENSHI_FUNC void TENSHI_CALL teEmptyBTree( TenshiBTree_t *pBase )
+{
+	TenshiBTreeNode_t *pNode;
+	TenshiBTreeNode_t *pNext;
+
+	if( !pBase ) {
+		return;
+	}
+
+	for( pNode = pBase->pHead; pNode != NULL; pNode = pNext ) {
+		pNext = pNode->pNext;
+
+		pNode->pPrev = NULL;
+		pNode->pNext = NULL;
+		pNode->pPrnt = NULL;
+		pNode->pLeft = NULL;
+		pNode->pRght = NULL;
+		pNode->pBase = NULL;
+
+		teFiniTypeInstance( pBase->pItemType, ( void * )( pNode + 1 ) );
+		teDealloc( ( void * )pNode );
+	}
+
+	pBase->pRoot = NULL;
+	pBase->pHead = NULL;
+	pBase->pTail = NULL;
+}
+
+static void BTree_LinkNode( TenshiBTree_t *pBase, TenshiBTreeNode_t *pNode, TenshiInt32_t iKey )
+{
+	pNode->pBase = pBase;
+
+	pNode->Key = iKey;
+
+	pNode->pPrnt = NULL;
+	pNode->pLeft = NULL;
+	pNode->pRght = NULL;
+
+	pNode->pNext = NULL;
+	pNode->pPrev = pBase->pTail;
+	if( pBase->pTail != NULL ) {
+		pBase->pTail->pNext = pNode;
+	} else {
+		pBase->pHead = pNode;
+	}
+	pBase->pTail = pNode;
+}
+static TenshiBTreeNode_t *BTree_Find( TenshiBTree_t *pBase, TenshiInt32_t iKey, TenshiBTreeNode_t *pCreate )
+{
+	TenshiBTreeNode_t *pNode;
+	TenshiBTreeNode_t *pNext;
+	TenshiBTreeNode_t *pTop;
+	TenshiBTreeNode_t **ppSpot;
 
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListAddNodeToFront( TenshiList_t *pList )
+	if( !pBase->pRoot ) {
+		if( pCreate != NULL ) {
+			BTree_LinkNode( pBase, pCreate, iKey );
+
+			pBase->pRoot = pCreate;
+		}
+
+		return pCreate;
+	}
+
+	pTop = NULL;
+	for( pNode = pBase->pRoot; pNode != NULL; pNode = pNext ) {
+		if( pNode->Key == iKey ) {
+			return pNode;
+		}
+
+		ppSpot = ( iKey < pNode->Key ) ? &pNode->pLeft : &pNode->pRght;
+		pTop = pNode;
+
+		pNext = *ppSpot;
+		if( pNext != NULL ) {
+			continue;
+		}
+
+		if( pCreate != NULL ) {
+			BTree_LinkNode( pBase, pCreate, iKey );
+
+			pCreate->pPrnt = pTop;
+			*ppSpot = pCreate;
+		}
+
+		return pCreate;
+	}
+
+	return NULL;
+}
+
+typedef enum BTreeFindCreateMode_e
 {
-	if( !pList ) {
+	kBTFCMode_FindOnly,
+	kBTFCMode_CreateOnly,
+	kBTFCMode_FindOrCreate
+} BTreeFindCreateMode_t;
+static TenshiBTreeNode_t *BTree_FindCreate( TenshiBTree_t *pBase, TenshiInt32_t iKey, BTreeFindCreateMode_t Mode )
+{
+	static TenshiBTreeNode_t CreateNode;
+	TenshiBTreeNode_t *pNode;
+
+	if( !pBase ) {
+		return NULL;
+	}
+
+	if( Mode == kBTFCMode_FindOnly ) {
+		return BTree_Find( pBase, iKey, NULL );
+	}
+
+	pNode = BTree_Find( pBase, iKey, &CreateNode );
+	if( pNode != &CreateNode ) {
+		return Mode != kBTFCMode_CreateOnly ? pNode : NULL;
+	}
+
+	pNode = ( TenshiBTreeNode_t * )teAlloc( sizeof( TenshiBTreeNode_t ) + pBase->cItemBytes, CURRENT_MEMTAG );
+	if( !pNode || !teInitTypeInstance( pBase->pItemType, ( void * )( pNode + 1 ) ) ) {
+		if( CreateNode.pPrnt != NULL ) {
+			if( CreateNode.pPrnt->pLeft == &CreateNode ) {
+				CreateNode.pPrnt->pLeft = NULL;
+			} else {
+				CreateNode.pPrnt->pRght = NULL;
+			}
+		} else {
+			pBase->pRoot = NULL;
+		}
+
+		if( CreateNode.pPrev != NULL ) {
+			CreateNode.pPrev->pNext = CreateNode.pNext;
+		} else {
+			pBase->pHead = CreateNode.pNext;
+		}
+		if( CreateNode.pNext != NULL ) {
+			CreateNode.pNext->pPrev = CreateNode.pPrev;
+		} else {
+			pBase->pTail = CreateNode.pPrev;
+		}
+
+		teDealloc( ( void * )pNode );
+		return NULL;
+	}
+
+	/* the placeholder was linked in while searching; swap in the real node */
+	*pNode = CreateNode;
+	if( pNode->pPrnt != NULL ) {
+		if( pNode->pPrnt->pLeft == &CreateNode ) {
+			pNode->pPrnt->pLeft = pNode;
+		} else {
+			pNode->pPrnt->pRght = pNode;
+		}
+	} else {
+		pBase->pRoot = pNode;
+	}
+
+	if( pNode->pPrev != NULL ) {
+		pNode->pPrev->pNext = pNode;
+	} else {
+		pBase->pHead = pNode;
+	}
+	pBase->pTail = pNode;
+
+	return pNode;
+}
+
+TENSHI_FUNC void *TENSHI_CALL teBTreeItemFromNode( TenshiBTreeNode_t *pNode )
+{
+	return pNode != NULL ? ( void * )( pNode + 1 ) : NULL;
+}
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeNodeFromItem( void *pItem )
+{
+	return pItem != NULL ? ( ( TenshiBTreeNode_t * )pItem ) - 1 : NULL;
+}
+
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeFindNode( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+{
+	return BTree_Find( pBase, iKey, NULL );
+}
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeLookupNode( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+{
+	return BTree_FindCreate( pBase, iKey, kBTFCMode_FindOrCreate );
+}
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeInsertNode( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+{
+	return BTree_FindCreate( pBase, iKey, kBTFCMode_CreateOnly );
+}
+
+TENSHI_FUNC void *TENSHI_CALL teBTreeFind( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+{
+	return teBTreeItemFromNode( teBTreeFindNode( pBase, iKey ) );
+}
+TENSHI_FUNC void *TENSHI_CALL teBTreeLookup( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+{
+	return teBTreeItemFromNode( teBTreeLookupNode( pBase, iKey ) );
+}
+TENSHI_FUNC void *TENSHI_CALL teBTreeInsert( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+{
+	return teBTreeItemFromNode( teBTreeInsertNode( pBase, iKey ) );
+}
+
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeDeleteNode( TenshiBTree_t *pBase, TenshiBTreeNode_t *pNode )
+{
+	TenshiBTreeNode_t *r, *s;
+
+	if( !pNode || !pNode->pBase || ( pNode->pBase != pBase && pBase != NULL ) ) {
 		return NULL;
 	}
 
-	return teListInsertBeforeNode( pList, pList->pHead );
+	pBase = pNode->pBase;
+
+	r = pNode->pRght;
+	if( !r ) {
+		if( pNode->pPrnt != NULL ) {
+			if( pNode->pPrnt->pLeft == pNode ) {
+				pNode->pPrnt->pLeft = pNode->pLeft;
+			} else {
+				pNode->pPrnt->pRght = pNode->pLeft;
+			}
+		} else {
+			pBase->pRoot = pNode->pLeft;
+		}
+
+		if( pNode->pLeft != NULL ) {
+			pNode->pLeft->pPrnt = pNode->pPrnt;
+		}
+	} else if( !r->pLeft ) {
+		r->pPrnt = pNode->pPrnt;
+
+		r->pLeft = pNode->pLeft;
+		if( r->pLeft != NULL ) {
+			pNode->pLeft->pPrnt = r;
+		}
+
+		if( pNode->pPrnt != NULL ) {
+			pNode->pPrnt->pLeft = r;
+		} else {
+			pBase->pRoot = r;
+		}
+	} else {
+		s = r->pLeft;
+
+		while( s->pLeft != NULL ) {
+			s = s->pLeft;
+		}
+		s->pLeft = pNode->pLeft;
+
+		s->pPrnt->pLeft = s->pRght;
+		if( s->pPrnt->pLeft != NULL ) {
+			s->pRght->pPrnt = s->pPrnt;
+		}
+		s->pRght = r;
+
+		s->pPrnt = pNode->pPrnt;
+		if( s->pPrnt != NULL ) {
+			if( pNode->pPrnt->pLeft == pNode ) {
+				pNode->pPrnt->pLeft = s;
+			} else {
+				pNode->pPrnt->pRght = s;
+			}
+		} else {
+			pBase->pRoot = s;
+		}
+	}
+
+	if( pNode->pPrev != NULL ) {
+		pNode->pPrev->pNext = pNode->pNext;
+	} else {
+		pNode->pBase->pHead = pNode->pNext;
+	}
+
+	if( pNode->pNext != NULL ) {
+		pNode->pNext->pPrev = pNode->pPrev;
+	} else {
+		pNode->pBase->pTail = pNode->pPrev;
+	}
+
+	teFiniTypeInstance( pBase->pItemType, ( void * )( pNode + 1 ) );
+	teDealloc( ( void * )pNode );
+
+	return NULL;
+}
+TENSHI_FUNC void *TENSHI_CALL teBTreeDelete( TenshiBTree_t *pBase, void *pItem )
+{
+	return teBTreeDeleteNode( pBase, teBTreeNodeFromItem( pItem ) );
+}
+TENSHI_FUNC TenshiInt32_t TENSHI_CALL teBTreeNodeKey( const TenshiBTreeNode_t *pNode )
+{
+	return pNode != NULL ? pNode->Key : 0;
+}
+TENSHI_FUNC TenshiInt32_t TENSHI_CALL teBTreeKey( const void *pItem )
+{
+	return teBTreeNodeKey( pItem != NULL ? ( ( const TenshiBTreeNode_t * )pItem ) - 1 : NULL );
+}
+
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeFrontNode( TenshiBTree_t *pBase )
+{
+	return pBase != NULL ? pBase->pHead : NULL;
+}
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeBackNode( TenshiBTree_t *pBase )
+{
+	return pBase != NULL ? pBase->pTail : NULL;
+}
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreePreviousNode( TenshiBTreeNode_t *pNode )
+{
+	return pNode != NULL ? pNode->pPrev : NULL;
+}
+TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeNextNode( TenshiBTreeNode_t *pNode )
+{
+	return pNode != NULL ? pNode->pNext : NULL;
+}
+
+TENSHI_FUNC void *TENSHI_CALL teBTreeFront( TenshiBTree_t *pBase )
+{
+	return teBTreeItemFromNode( teBTreeFrontNode( pBase ) );
 }
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListAddNodeToBack( TenshiList_t *pList )
+TENSHI_FUNC void *TENSHI_CALL teBTreeBack( TenshiBTree_t *pBase )
 {
-	if( !pList ) {
-		return NULL;
-	}
-
-	return teListInsertBeforeNode( pList, NULL );
+	return teBTreeItemFromNode( teBTreeBackNode( pBase ) );
 }
-TENSHI_FUNC void *TENSHI_CALL teListAddToFront( TenshiList_t *pList )
+TENSHI_FUNC void *TENSHI_CALL teBTreePrevious( void *pItem )
 {
-	return teListNodeItem( teListAddNodeToFront( pList ) );
+	return teBTreeItemFromNode( teBTreePreviousNode( teBTreeNodeFromItem( pItem ) ) );
 }
-TENSHI_FUNC void *TENSHI_CALL teListAddToBack( TenshiList_t *pList )
+TENSHI_FUNC void *TENSHI_CALL teBTreeNext( void *pItem )
 {
-	return teListNodeItem( teListAddNodeToBack( pList ) );
+	return teBTreeItemFromNode( teBTreeNextNode( teBTreeNodeFromItem( pItem ) ) );
 }
 
-TENSHI_FUNC void TENSHI_CALL teListDeleteNode( TenshiList_t *pList, TenshiListItem_t *pItem )
-{
-	if( !pList || !pItem ) {
-		return;
-	}
 
-	List_Unlink( pList, pItem );
-	--pList->cItems;
+/*
+===============================================================================
 
-	teFiniTypeInstance( pList->pItemType, teListNodeItem( pItem ) );
-	teDealloc( ( void * )pItem );
-}
+	HASH MAPS
 
-TENSHI_FUNC void TENSHI_CALL teListDeleteFront( TenshiList_t *pList )
-{
-	if( !pList || !pList->pHead ) {
-		return;
-	}
+===============================================================================
+*/
 
-	teListDeleteNode( pList, pList->pHead );
-}
-TENSHI_FUNC void TENSHI_CALL teListDeleteBack( TenshiList_t *pList )
-{
-	if( !pList || !pList->pTail ) {
-		return;
-	}
+#undef TENSHI_FACILITY
+#define TENSHI_FACILITY             kTenshiLog_CoreRT_BTree
 
-	teListDeleteNode( pList, pList->pTail );
-}
-TENSHI_FUNC void TENSHI_CALL teListDelete( TenshiList_t *pList )
-{
-	if( !pList || !pList->pCurr ) {
-		return;
-	}
+/* slots in the smallest index */
+#define MAP_MIN_SLOTS               ( TENSHI_MAP_GROUP_SLOTS*2 )
+/* slots of the old index moved over by each insertion or erasure */
+#ifndef MAP_MIGRATE_SLOTS
+# define MAP_MIGRATE_SLOTS          64
+#endif
 
-	teListDeleteNode( pList, pList->pCurr );
+static TENSHI_FORCEINLINE TenshiUInt32_t Map_SlotLimit( TenshiUInt32_t cSlots )
+{
+	/* past 7/8ths full the probe sequences get long */
+	return cSlots - cSlots/8;
 }
 
-TENSHI_FUNC void TENSHI_CALL teListToFront( TenshiList_t *pList )
+static TENSHI_FORCEINLINE TenshiUInt64_t Map_IntHash( TenshiInt64_t iKey )
 {
-	if( !pList ) {
-		return;
-	}
+	TenshiUInt64_t h;
 
-	pList->pCurr = pList->pHead;
+	h = ( TenshiUInt64_t )iKey;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+
+	return h;
 }
-TENSHI_FUNC void TENSHI_CALL teListToBack( TenshiList_t *pList )
+
+/* bit N is set if control byte N of the group is uCtrl */
+static TENSHI_FORCEINLINE TenshiUInt32_t Map_GroupMatch( const TenshiUInt8_t *pGroup, TenshiUInt8_t uCtrl )
 {
-	if( !pList ) {
-		return;
+#if SSE2_ENABLED
+	const __m128i Ctrl = _mm_loadu_si128( ( const __m128i * )pGroup );
+
+	return ( TenshiUInt32_t )_mm_movemask_epi8( _mm_cmpeq_epi8( Ctrl, _mm_set1_epi8( ( char )uCtrl ) ) );
+#else
+	TenshiUInt32_t uMask;
+	TenshiUInt32_t i;
+
+	uMask = 0;
+	for( i = 0; i < TENSHI_MAP_GROUP_SLOTS; ++i ) {
+		uMask |= ( TenshiUInt32_t )( pGroup[ i ] == uCtrl ) << i;
 	}
 
-	pList->pCurr = pList->pTail;
+	return uMask;
+#endif
 }
-TENSHI_FUNC void TENSHI_CALL teListToPrevious( TenshiList_t *pList )
+/* bit N is set if slot N of the group is empty or erased (high bit set) */
+static TENSHI_FORCEINLINE TenshiUInt32_t Map_GroupMatchFree( const TenshiUInt8_t *pGroup )
 {
-	if( !pList || !pList->pCurr ) {
-		return;
+#if SSE2_ENABLED
+	return ( TenshiUInt32_t )_mm_movemask_epi8( _mm_loadu_si128( ( const __m128i * )pGroup ) );
+#else
+	TenshiUInt32_t uMask;
+	TenshiUInt32_t i;
+
+	uMask = 0;
+	for( i = 0; i < TENSHI_MAP_GROUP_SLOTS; ++i ) {
+		uMask |= ( TenshiUInt32_t )( pGroup[ i ] >> 7 ) << i;
 	}
 
-	pList->pCurr = pList->pCurr->pPrev;
+	return uMask;
+#endif
 }
-TENSHI_FUNC void TENSHI_CALL teListToNext( TenshiList_t *pList )
+static TENSHI_FORCEINLINE TenshiUInt32_t Map_LowestBit( TenshiUInt32_t uMask )
 {
-	if( !pList || !pList->pCurr ) {
-		return;
+#ifdef __GNUC__
+	return ( TenshiUInt32_t )__builtin_ctz( uMask );
+#else
+	TenshiUInt32_t i;
+
+	for( i = 0; !( uMask & 1 ); ++i ) {
+		uMask >>= 1;
 	}
 
-	pList->pCurr = pList->pCurr->pNext;
+	return i;
+#endif
 }
 
-TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teListIsValid( const TenshiList_t *pList )
+static TENSHI_FORCEINLINE TenshiBoolean_t Map_KeyEq( const TenshiMapEntry_t *pEntry, TenshiUInt64_t uHash, const char *pszKey, TenshiInt64_t iKey )
 {
-	if( !pList ) {
+	if( pEntry->uHash != uHash ) {
 		return TENSHI_FALSE;
 	}
 
-	return pList->pCurr != NULL ? TENSHI_TRUE : TENSHI_FALSE;
-}
-
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListCurrentNode( TenshiList_t *pList )
-{
-	return pList != NULL ? pList->pCurr : NULL;
-}
-TENSHI_FUNC void *TENSHI_CALL teListCurrent( TenshiList_t *pList )
-{
-	return teListNodeItem( teListCurrentNode( pList ) );
-}
-TENSHI_FUNC void TENSHI_CALL teListResetCurrent( TenshiList_t *pList )
-{
-	if( !pList ) {
-		return;
+	if( pszKey != NULL ) {
+		return pEntry->pszKey != NULL && strcmp( pEntry->pszKey, pszKey ) == 0;
 	}
 
-	pList->pCurr = NULL;
+	return pEntry->pszKey == NULL && pEntry->iKey == iKey;
 }
 
-TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teListIsEmpty( const TenshiList_t *pList )
+static char *Map_CopyStr( const char *s )
 {
-	if( !pList ) {
-		return TENSHI_TRUE;
+	TenshiUIntPtr_t n;
+	char *p;
+
+	n = strlen( s ) + 1;
+	p = ( char * )teAlloc( n, TENSHI_MEMTAG_MAP );
+	if( !p ) {
+		fprintf( stderr, "ERROR: Out of memory\n" );
+		exit( EXIT_FAILURE );
 	}
 
-	return pList->pHead == NULL ? TENSHI_TRUE : TENSHI_FALSE;
+	memcpy( p, s, n );
+	return p;
 }
-TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teListLen( const TenshiList_t *pList )
+
+static TenshiBoolean_t Map_IndexInit( TenshiMapIndex_t *pIndex, TenshiUInt32_t cSlots )
 {
-	if( !pList ) {
-		return 0;
+	pIndex->pCtrl = ( TenshiUInt8_t * )teAlloc( cSlots, TENSHI_MEMTAG_MAP );
+	pIndex->pSlots = ( TenshiUInt32_t * )teAlloc( cSlots*sizeof( TenshiUInt32_t ), TENSHI_MEMTAG_MAP );
+	if( !pIndex->pCtrl || !pIndex->pSlots ) {
+		teDealloc( ( void * )pIndex->pCtrl );
+		teDealloc( ( void * )pIndex->pSlots );
+		memset( ( void * )pIndex, 0, sizeof( *pIndex ) );
+		return TENSHI_FALSE;
 	}
 
-	return pList->cItems;
+	memset( ( void * )pIndex->pCtrl, TENSHI_MAP_CTRL_EMPTY, cSlots );
+	pIndex->cSlots = cSlots;
+	pIndex->cUsed = 0;
+
+	return TENSHI_TRUE;
 }
-TENSHI_FUNC void TENSHI_CALL teEmptyList( TenshiList_t *pList )
+static void Map_IndexFini( TenshiMapIndex_t *pIndex )
 {
-	if( !pList ) {
-		return;
-	}
-
-	while( !teListIsEmpty( pList ) ) {
-		teListDeleteNode( pList, pList->pTail );
-	}
+	teDealloc( ( void * )pIndex->pCtrl );
+	teDealloc( ( void * )pIndex->pSlots );
+	memset( ( void * )pIndex, 0, sizeof( *pIndex ) );
 }
 
-TENSHI_FUNC void TENSHI_CALL teListMoveToFront( TenshiList_t *pList )
+/*
+	Groups are probed in triangular steps (1, 2, 3, ...) from the one picked
+	by the hash, which visits every group once since there's a power of two
+	of them. The rest of the hash (seven bits) is what goes in the control
+	byte, so only the slots of a group whose byte matches are compared.
+*/
+static TenshiIntPtr_t Map_IndexFind( const TenshiMap_t *pMap, const TenshiMapIndex_t *pIndex, TenshiUInt64_t uHash, const char *pszKey, TenshiInt64_t iKey )
 {
-	TenshiListItem_t *pCurr;
+	const TenshiUInt8_t *pGroup;
+	TenshiUInt32_t uGroupMask;
+	TenshiUInt32_t uGroup;
+	TenshiUInt32_t uStep;
+	TenshiUInt32_t uMatch;
+	TenshiUInt32_t uSlot;
+	TenshiUInt8_t uCtrl;
 
-	if( !pList || !pList->pCurr ) {
-		return;
+	if( !pIndex->pCtrl ) {
+		return -1;
 	}
 
-	pCurr = pList->pCurr;
-	List_Unlink( pList, pCurr );
+	uGroupMask = pIndex->cSlots/TENSHI_MAP_GROUP_SLOTS - 1;
+	uGroup = ( TenshiUInt32_t )( uHash >> 7 ) & uGroupMask;
+	uCtrl = ( TenshiUInt8_t )( uHash & 0x7F );
 
-	if( pList->pHead != NULL ) {
-		pCurr->pNext = pList->pHead;
-		pList->pHead->pPrev = pCurr;
-	}
-	pList->pHead = pCurr;
-}
-TENSHI_FUNC void TENSHI_CALL teListMoveToBack( TenshiList_t *pList )
-{
-	TenshiListItem_t *pCurr;
+	for( uStep = 0; uStep <= uGroupMask; ) {
+		pGroup = &pIndex->pCtrl[ uGroup*TENSHI_MAP_GROUP_SLOTS ];
 
-	if( !pList || !pList->pCurr ) {
-		return;
-	}
+		for( uMatch = Map_GroupMatch( pGroup, uCtrl ); uMatch != 0; uMatch &= uMatch - 1 ) {
+			uSlot = uGroup*TENSHI_MAP_GROUP_SLOTS + Map_LowestBit( uMatch );
 
-	pCurr = pList->pCurr;
-	List_Unlink( pList, pCurr );
+			if( Map_KeyEq( &pMap->pEntries[ pIndex->pSlots[ uSlot ] ], uHash, pszKey, iKey ) ) {
+				return ( TenshiIntPtr_t )uSlot;
+			}
+		}
 
-	if( pList->pTail != NULL ) {
-		pCurr->pPrev = pList->pTail;
-		pList->pTail->pNext = pCurr;
+		/* an insertion would have stopped at the first empty slot */
+		if( Map_GroupMatch( pGroup, TENSHI_MAP_CTRL_EMPTY ) != 0 ) {
+			break;
+		}
+
+		uGroup = ( uGroup + ++uStep ) & uGroupMask;
 	}
-	pList->pTail = pCurr;
+
+	return -1;
 }
-TENSHI_FUNC void TENSHI_CALL teListMoveToPrevious( TenshiList_t *pList )
+/* add an entry that isn't in the index yet (which must have an empty slot) */
+static void Map_IndexInsert( TenshiMapIndex_t *pIndex, TenshiUInt64_t uHash, TenshiUInt32_t uEntry )
 {
-	TenshiListItem_t *pNode;
-	TenshiListItem_t *pBefore;
+	TenshiUInt32_t uGroupMask;
+	TenshiUInt32_t uGroup;
+	TenshiUInt32_t uStep;
+	TenshiUInt32_t uFree;
+	TenshiUInt32_t uSlot;
 
-	if( !pList || !pList->pCurr || !pList->pCurr->pPrev ) {
-		return;
-	}
+	uGroupMask = pIndex->cSlots/TENSHI_MAP_GROUP_SLOTS - 1;
+	uGroup = ( TenshiUInt32_t )( uHash >> 7 ) & uGroupMask;
 
-	pNode = pList->pCurr;
-	pBefore = pList->pCurr->pPrev;
-	List_Unlink( pList, pNode );
+	for( uStep = 0;; ) {
+		uFree = Map_GroupMatchFree( &pIndex->pCtrl[ uGroup*TENSHI_MAP_GROUP_SLOTS ] );
+		if( uFree != 0 ) {
+			break;
+		}
 
-	pNode->pNext = pBefore;
-	pNode->pPrev = pBefore->pPrev;
-	if( pBefore->pPrev != NULL ) {
-		pBefore->pPrev->pNext = pNode;
-	} else {
-		pList->pHead = pNode;
+		uGroup = ( uGroup + ++uStep ) & uGroupMask;
 	}
-	pBefore->pPrev = pNode;
-	pList->pCurr = pNode;
-}
-TENSHI_FUNC void TENSHI_CALL teListMoveToNext( TenshiList_t *pList )
-{
-	TenshiListItem_t *pNode;
-	TenshiListItem_t *pAfter;
 
-	if( !pList || !pList->pCurr || !pList->pCurr->pNext ) {
-		return;
+	uSlot = uGroup*TENSHI_MAP_GROUP_SLOTS + Map_LowestBit( uFree );
+	if( pIndex->pCtrl[ uSlot ] == TENSHI_MAP_CTRL_EMPTY ) {
+		++pIndex->cUsed;
 	}
 
-	pNode = pList->pCurr;
-	pAfter = pList->pCurr->pNext;
-	List_Unlink( pList, pNode );
-
-	pNode->pPrev = pAfter;
-	pNode->pNext = pAfter->pNext;
-	if( pAfter->pNext != NULL ) {
-		pAfter->pNext->pPrev = pNode;
-	} else {
-		pList->pTail = pNode;
-	}
-	pAfter->pNext = pNode;
-	pList->pCurr = pNode;
+	pIndex->pCtrl[ uSlot ] = ( TenshiUInt8_t )( uHash & 0x7F );
+	pIndex->pSlots[ uSlot ] = uEntry;
 }
 
-TENSHI_FUNC TenshiListItem_t *TENSHI_CALL teListNodeAt( TenshiList_t *pList, TenshiUIntPtr_t uIndex )
+/* replace both indexes with one of cSlots slots built from the entries */
+static TenshiBoolean_t Map_Rebuild( TenshiMap_t *pMap, TenshiUInt32_t cSlots )
 {
-	if( !pList || uIndex >= pList->cItems ) {
-		return NULL;
-	}
+	TenshiMapIndex_t NewIndex;
+	TenshiUInt32_t i;
 
-	if( !pList->pCachedIndex ) {
-		if( uIndex > pList->cItems/2 ) {
-			pList->pCachedIndex = pList->pTail;
-			pList->uCachedIndex = pList->cItems - 1;
-		} else {
-			pList->pCachedIndex = pList->pHead;
-			pList->uCachedIndex = 0;
-		}
+	if( !Map_IndexInit( &NewIndex, cSlots ) ) {
+		return TENSHI_FALSE;
 	}
 
-	while( pList->uCachedIndex < uIndex ) {
-		pList->pCachedIndex = pList->pCachedIndex->pNext;
-		++pList->uCachedIndex;
+	for( i = 0; i < pMap->cEntries; ++i ) {
+		if( !pMap->pEntries[ i ].bErased ) {
+			Map_IndexInsert( &NewIndex, pMap->pEntries[ i ].uHash, i );
+		}
 	}
 
-	while( pList->uCachedIndex > uIndex ) {
-		pList->pCachedIndex = pList->pCachedIndex->pPrev;
-		--pList->uCachedIndex;
-	}
+	Map_IndexFini( &pMap->Index );
+	Map_IndexFini( &pMap->OldIndex );
+	pMap->uMigrated = 0;
 
-	return pList->pCachedIndex;
+	pMap->Index = NewIndex;
+	return TENSHI_TRUE;
 }
-TENSHI_FUNC void *TENSHI_CALL teListAt( TenshiList_t *pList, TenshiUIntPtr_t uIndex )
+/* make room in the index for one more entry */
+static TenshiBoolean_t Map_GrowIndex( TenshiMap_t *pMap )
 {
-	return teListNodeItem( teListNodeAt( pList, uIndex ) );
-}
+	TenshiMapIndex_t NewIndex;
+	TenshiUInt32_t cSlots;
 
+	cSlots = pMap->Index.cSlots;
+	if( !cSlots ) {
+		return Map_IndexInit( &pMap->Index, MAP_MIN_SLOTS );
+	}
 
-/*
-===============================================================================
-
-	BINARY TREE
+	/*
+		If most of the used slots were erased, the index is only cleaned up
+		(that's cheap as few entries are left). Otherwise a twice as large
+		index is started, and filled in by Map_Migrate() over the following
+		changes. Even if every one of them is an insertion, the old index is
+		empty well before the new one could fill up.
+	*/
+	if( pMap->cLive < cSlots/2 ) {
+		return Map_Rebuild( pMap, cSlots );
+	}
+	if( pMap->OldIndex.pCtrl != NULL ) {
+		return Map_Rebuild( pMap, cSlots*2 );
+	}
 
-===============================================================================
-*/
+	if( !Map_IndexInit( &NewIndex, cSlots*2 ) ) {
+		return TENSHI_FALSE;
+	}
 
-#undef TENSHI_FACILITY
-#define TENSHI_FACILITY             kTenshiLog_CoreRT_BTree
+	pMap->OldIndex = pMap->Index;
+	pMap->Index = NewIndex;
+	pMap->uMigrated = 0;
 
-TENSHI_FUNC TenshiBTree_t *TENSHI_CALL teNewBTree( TenshiType_t *pItemType )
+	return TENSHI_TRUE;
+}
+/* move up to cSlots slots of the old index to the new one */
+static void Map_Migrate( TenshiMap_t *pMap, TenshiUInt32_t cSlots )
 {
-	TenshiBTree_t *pBase;
+	TenshiMapIndex_t *pOld;
+	TenshiUInt32_t uEntry;
+	TenshiUInt32_t uEnd;
+	TenshiUInt32_t i;
 
-	if( !pItemType ) {
-		return NULL;
+	pOld = &pMap->OldIndex;
+	if( !pOld->pCtrl ) {
+		return;
 	}
 
-	pBase = ( TenshiBTree_t * )teAlloc( sizeof( TenshiBTree_t ), g_RTGlob.iCurrentMemtag );
-	if( !pBase ) {
-		return NULL;
-	}
+	uEnd = pOld->cSlots - pMap->uMigrated > cSlots ? pMap->uMigrated + cSlots : pOld->cSlots;
 
-	pBase->pRoot = NULL;
-	pBase->pHead = NULL;
-	pBase->pTail = NULL;
+	for( i = pMap->uMigrated; i < uEnd; ++i ) {
+		if( pOld->pCtrl[ i ] & 0x80 ) {
+			continue;
+		}
+
+		uEntry = pOld->pSlots[ i ];
+		Map_IndexInsert( &pMap->Index, pMap->pEntries[ uEntry ].uHash, uEntry );
 
-	pBase->pItemType = pItemType;
-	pBase->cItemBytes = pItemType->cBytes;
+		/* keeps the old index's probe sequences intact for lookups */
+		pOld->pCtrl[ i ] = TENSHI_MAP_CTRL_ERASED;
+	}
 
-	return pBase;
+	pMap->uMigrated = uEnd;
+	if( uEnd == pOld->cSlots ) {
+		Map_IndexFini( pOld );
+		pMap->uMigrated = 0;
+	}
 }
-TENSHI_FUNC TenshiBTree_t *TENSHI_CALL teDeleteBTree( TenshiBTree_t *pBase )
+
+static TenshiMapEntry_t *Map_Find( TenshiMap_t *pMap, TenshiUInt64_t uHash, const char *pszKey, TenshiInt64_t iKey, TenshiMapIndex_t **ppIndex, TenshiIntPtr_t *piSlot )
 {
-	if( !pBase ) {
+	TenshiMapIndex_t *pIndex;
+	TenshiIntPtr_t iSlot;
+
+	pIndex = &pMap->Index;
+	iSlot = Map_IndexFind( pMap, pIndex, uHash, pszKey, iKey );
+	if( iSlot < 0 && pMap->OldIndex.pCtrl != NULL ) {
+		pIndex = &pMap->OldIndex;
+		iSlot = Map_IndexFind( pMap, pIndex, uHash, pszKey, iKey );
+	}
+
+	if( iSlot < 0 ) {
 		return NULL;
 	}
 
-	teEmptyBTree( pBase );
-	teDealloc( ( void * )pBase );
+	if( ppIndex != NULL ) {
+		*ppIndex = pIndex;
+	}
+	if( piSlot != NULL ) {
+		*piSlot = iSlot;
+	}
 
-	return NULL;
+	return &pMap->pEntries[ pIndex->pSlots[ iSlot ] ];
 }
 
-TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teBTreeIsEmpty( const TenshiBTree_t *pBase )
+static void Map_FiniEntry( TenshiMapEntry_t *pEntry )
 {
-	return pBase == NULL || pBase->pHead == NULL ? TENSHI_TRUE : TENSHI_FALSE;
+	teDealloc( ( void * )pEntry->pszKey );
+	teDealloc( ( void * )pEntry->pszValue );
+
+	pEntry->pszKey = NULL;
+	pEntry->pszValue = NULL;
+	pEntry->bErased = TENSHI_TRUE;
 }
-TENSHI_FUNC void TENSHI_CALL teEmptyBTree( TenshiBTree_t *pBase )
+static void Map_SetValue( TenshiMapEntry_t *pEntry, TenshiInt64_t iValue, const char *pszValue )
 {
-	TenshiBTreeNode_t *pNode;
-	TenshiBTreeNode_t *pNext;
-
-	if( !pBase ) {
-		return;
-	}
+	teDealloc( ( void * )pEntry->pszValue );
 
-	for( pNode = pBase->pHead; pNode != NULL; pNode = pNext ) {
-		pNext = pNode->pNext;
+	pEntry->iValue = iValue;
+	pEntry->pszValue = pszValue != NULL ? Map_CopyStr( pszValue ) : NULL;
+}
 
-		pNode->pPrev = NULL;
-		pNode->pNext = NULL;
-		pNode->pPrnt = NULL;
-		pNode->pLeft = NULL;
-		pNode->pRght = NULL;
-		pNode->pBase = NULL;
+/* remove the erased entries (positions change, so the index is rebuilt) */
+static TenshiBoolean_t Map_Compact( TenshiMap_t *pMap )
+{
+	TenshiUInt32_t i;
+	TenshiUInt32_t j;
 
-		teFiniTypeInstance( pBase->pItemType, ( void * )( pNode + 1 ) );
-		teDealloc( ( void * )pNode );
+	for( i = 0, j = 0; i < pMap->cEntries; ++i ) {
+		if( !pMap->pEntries[ i ].bErased ) {
+			pMap->pEntries[ j++ ] = pMap->pEntries[ i ];
+		}
 	}
 
-	pBase->pRoot = NULL;
-	pBase->pHead = NULL;
-	pBase->pTail = NULL;
+	pMap->cEntries = j;
+	return Map_Rebuild( pMap, pMap->Index.cSlots > 0 ? pMap->Index.cSlots : MAP_MIN_SLOTS );
 }
 
-static void BTree_LinkNode( TenshiBTree_t *pBase, TenshiBTreeNode_t *pNode, TenshiInt32_t iKey )
+static void Map_Clear( TenshiMap_t *pMap )
 {
-	pNode->pBase = pBase;
+	TenshiUInt32_t i;
 
-	pNode->Key = iKey;
+	for( i = 0; i < pMap->cEntries; ++i ) {
+		Map_FiniEntry( &pMap->pEntries[ i ] );
+	}
 
-	pNode->pPrnt = NULL;
-	pNode->pLeft = NULL;
-	pNode->pRght = NULL;
+	pMap->cEntries = 0;
+	pMap->cLive = 0;
 
-	pNode->pNext = NULL;
-	pNode->pPrev = pBase->pTail;
-	if( pBase->pTail != NULL ) {
-		pBase->pTail->pNext = pNode;
-	} else {
-		pBase->pHead = pNode;
+	Map_IndexFini( &pMap->OldIndex );
+	pMap->uMigrated = 0;
+
+	if( pMap->Index.pCtrl != NULL ) {
+		memset( ( void * )pMap->Index.pCtrl, TENSHI_MAP_CTRL_EMPTY, pMap->Index.cSlots );
+		pMap->Index.cUsed = 0;
 	}
-	pBase->pTail = pNode;
 }
-static TenshiBTreeNode_t *BTree_Find( TenshiBTree_t *pBase, TenshiInt32_t iKey, TenshiBTreeNode_t *pCreate )
+
+static void Map_Insert( TenshiMap_t *pMap, const char *pszKey, TenshiInt64_t iKey, TenshiInt64_t iValue, const char *pszValue )
 {
-	TenshiBTreeNode_t *pNode;
-	TenshiBTreeNode_t *pNext;
-	TenshiBTreeNode_t *pTop;
-	TenshiBTreeNode_t **ppSpot;
+	TenshiMapEntry_t *pEntry;
+	TenshiMapEntry_t *pEntries;
+	TenshiUInt32_t cMaxEntries;
+	TenshiUInt64_t uHash;
 
-	if( !pBase->pRoot ) {
-		if( pCreate != NULL ) {
-			BTree_LinkNode( pBase, pCreate, iKey );
+	uHash = pszKey != NULL ? teStrHash( pszKey, 0 ) : Map_IntHash( iKey );
 
-			pBase->pRoot = pCreate;
-		}
+	Map_Migrate( pMap, MAP_MIGRATE_SLOTS );
 
-		return pCreate;
+	pEntry = Map_Find( pMap, uHash, pszKey, iKey, NULL, NULL );
+	if( pEntry != NULL ) {
+		Map_SetValue( pEntry, iValue, pszValue );
+		return;
 	}
 
-	pTop = NULL;
-	for( pNode = pBase->pRoot; pNode != NULL; pNode = pNext ) {
-		if( pNode->Key == iKey ) {
-			return pNode;
-		}
+	if( pMap->cEntries == pMap->cMaxEntries ) {
+		if( pMap->cLive <= pMap->cEntries/2 && pMap->cEntries > 0 ) {
+			if( !Map_Compact( pMap ) ) {
+				return;
+			}
+		} else {
+			cMaxEntries = pMap->cMaxEntries > 0 ? pMap->cMaxEntries*2 : 16;
 
-		ppSpot = ( iKey < pNode->Key ) ? &pNode->pLeft : &pNode->pRght;
-		pTop = pNode;
+			pEntries = ( TenshiMapEntry_t * )teRealloc( ( void * )pMap->pEntries, cMaxEntries*sizeof( TenshiMapEntry_t ), TENSHI_MEMTAG_MAP );
+			if( !pEntries ) {
+				return;
+			}
 
-		pNext = *ppSpot;
-		if( pNext != NULL ) {
-			continue;
+			pMap->pEntries = pEntries;
+			pMap->cMaxEntries = cMaxEntries;
 		}
+	}
 
-		if( pCreate != NULL ) {
-			BTree_LinkNode( pBase, pCreate, iKey );
-
-			pCreate->pPrnt = pTop;
-			*ppSpot = pCreate;
+	if( pMap->Index.cUsed + 1 > Map_SlotLimit( pMap->Index.cSlots ) ) {
+		if( !Map_GrowIndex( pMap ) ) {
+			return;
 		}
-
-		return pCreate;
 	}
 
-	return NULL;
-}
+	pEntry = &pMap->pEntries[ pMap->cEntries ];
 
-typedef enum BTreeFindCreateMode_e
-{
-	kBTFCMode_FindOnly,
-	kBTFCMode_CreateOnly,
-	kBTFCMode_FindOrCreate
-} BTreeFindCreateMode_t;
-static TenshiBTreeNode_t *BTree_FindCreate( TenshiBTree_t *pBase, TenshiInt32_t iKey, BTreeFindCreateMode_t Mode )
+	pEntry->uHash = uHash;
+	pEntry->pszKey = pszKey != NULL ? Map_CopyStr( pszKey ) : NULL;
+	pEntry->iKey = pszKey != NULL ? 0 : iKey;
+	pEntry->pszValue = NULL;
+	pEntry->bErased = TENSHI_FALSE;
+	Map_SetValue( pEntry, iValue, pszValue );
+
+	Map_IndexInsert( &pMap->Index, uHash, pMap->cEntries );
+
+	++pMap->cEntries;
+	++pMap->cLive;
+}
+static TenshiBoolean_t Map_Erase( TenshiMap_t *pMap, const char *pszKey, TenshiInt64_t iKey )
 {
-	static TenshiBTreeNode_t CreateNode;
-	TenshiBTreeNode_t *pNode;
+	TenshiMapEntry_t *pEntry;
+	TenshiMapIndex_t *pIndex;
+	TenshiIntPtr_t iSlot;
 
-	if( !pBase ) {
-		return NULL;
-	}
+	Map_Migrate( pMap, MAP_MIGRATE_SLOTS );
 
-	if( Mode == kBTFCMode_FindOnly ) {
-		return BTree_Find( pBase, iKey, NULL );
+	pEntry = Map_Find( pMap, pszKey != NULL ? teStrHash( pszKey, 0 ) : Map_IntHash( iKey ), pszKey, iKey, &pIndex, &iSlot );
+	if( !pEntry ) {
+		return TENSHI_FALSE;
 	}
 
-	pNode = BTree_Find( pBase, iKey, &CreateNode );
-	if( pNode != &CreateNode ) {
-		return Mode != kBTFCMode_CreateOnly ? pNode : NULL;
+	pIndex->pCtrl[ iSlot ] = TENSHI_MAP_CTRL_ERASED;
+	Map_FiniEntry( pEntry );
+
+	/* starting over leaves nothing behind for FOREACH to step past */
+	if( --pMap->cLive == 0 ) {
+		Map_Clear( pMap );
 	}
 
-	pNode = ( TenshiBTreeNode_t * )teAlloc( sizeof( TenshiBTreeNode_t ) + pBase->cItemBytes, CURRENT_MEMTAG );
-	if( !pNode || !teInitTypeInstance( pBase->pItemType, ( void * )( pNode + 1 ) ) ) {
-		if( CreateNode.pPrnt != NULL ) {
-			if( CreateNode.pPrnt->pLeft == &CreateNode ) {
-				CreateNode.pPrnt->pLeft = NULL;
-			} else {
-				CreateNode.pPrnt->pRght = NULL;
-			}
-		} else {
-			pBase->pRoot = NULL;
-		}
+	return TENSHI_TRUE;
+}
+TENSHI_FUNC void *TENSHI_CALL teMapAlloc_f( void *pParm )
+{
+	TenshiMap_t *pMap;
 
-		if( CreateNode.pPrev != NULL ) {
-			CreateNode.pPrev->pNext = CreateNode.pNext;
-		} else {
-			pBase->pHead = CreateNode.pNext;
-		}
-		if( CreateNode.pNext != NULL ) {
-			CreateNode.pNext->pPrev = CreateNode.pPrev;
-		} else {
-			pBase->pTail = CreateNode.pPrev;
-		}
+	( ( void )pParm );
 
-		teDealloc( ( void * )pNode );
-		return NULL;
+	pMap = ( TenshiMap_t * )teAlloc( sizeof( TenshiMap_t ), TENSHI_MEMTAG_MAP );
+	if( !pMap ) {
+		return ( void * )0;
 	}
 
-	return pNode;
+	memset( ( void * )pMap, 0, sizeof( *pMap ) );
+	return ( void * )pMap;
 }
-
-TENSHI_FUNC void *TENSHI_CALL teBTreeItemFromNode( TenshiBTreeNode_t *pNode )
+TENSHI_FUNC void TENSHI_CALL teMapDealloc_f( void *p )
 {
-	return pNode != NULL ? ( void * )( pNode + 1 ) : NULL;
+	TenshiMap_t *pMap;
+
+	if( !p ) {
+		return;
+	}
+
+	pMap = ( TenshiMap_t * )p;
+
+	Map_Clear( pMap );
+	Map_IndexFini( &pMap->Index );
+	teDealloc( ( void * )pMap->pEntries );
+	teDealloc( p );
 }
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeNodeFromItem( void *pItem )
+
+static TENSHI_FORCEINLINE TenshiMap_t *teMap( TenshiIndex_t uIndex )
 {
-	return pItem != NULL ? ( ( TenshiBTreeNode_t * )pItem ) - 1 : NULL;
+	return ( TenshiMap_t * )teUnwrapEngineObject( g_MapPool, uIndex );
 }
 
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeFindNode( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+TENSHI_FUNC TenshiIndex_t TENSHI_CALL teAllocMap( void )
 {
-	return BTree_Find( pBase, iKey, NULL );
+	return teAllocEngineObject( g_MapPool, 0, ( void * )0 );
 }
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeLookupNode( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+TENSHI_FUNC void TENSHI_CALL teMakeMap( TenshiIndex_t MapNumber )
 {
-	return BTree_FindCreate( pBase, iKey, kBTFCMode_FindOrCreate );
+	teAllocEngineObject( g_MapPool, MapNumber, ( void * )0 );
 }
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeInsertNode( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+TENSHI_FUNC TenshiIndex_t TENSHI_CALL teDeleteMap( TenshiIndex_t MapNumber )
 {
-	return BTree_FindCreate( pBase, iKey, kBTFCMode_CreateOnly );
+	teDeallocEngineObject( g_MapPool, MapNumber );
+	return 0;
 }
-
-TENSHI_FUNC void *TENSHI_CALL teBTreeFind( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapExist( TenshiIndex_t MapNumber )
 {
-	return teBTreeItemFromNode( teBTreeFindNode( pBase, iKey ) );
+	return teEngineObjectExists( g_MapPool, MapNumber );
 }
-TENSHI_FUNC void *TENSHI_CALL teBTreeLookup( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teMapCount( TenshiIndex_t MapNumber )
 {
-	return teBTreeItemFromNode( teBTreeLookupNode( pBase, iKey ) );
+	TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return 0;
+	}
+
+	return pMap->cLive;
 }
-TENSHI_FUNC void *TENSHI_CALL teBTreeInsert( TenshiBTree_t *pBase, TenshiInt32_t iKey )
+TENSHI_FUNC void TENSHI_CALL teMapClear( TenshiIndex_t MapNumber )
 {
-	return teBTreeItemFromNode( teBTreeInsertNode( pBase, iKey ) );
+	TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return;
+	}
+
+	Map_Clear( pMap );
 }
 
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeDeleteNode( TenshiBTree_t *pBase, TenshiBTreeNode_t *pNode )
+/*
+	Empty strings are passed around as NULL, but a NULL key means an integer
+	key here, hence the "" for string keys
+*/
+TENSHI_FUNC void TENSHI_CALL teMapInsertStr( TenshiIndex_t MapNumber, const char *pszKey, TenshiInt64_t iValue )
 {
-	TenshiBTreeNode_t *r, *s;
+	TenshiMap_t *pMap;
 
-	if( !pNode || !pNode->pBase || ( pNode->pBase != pBase && pBase != NULL ) ) {
-		return NULL;
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return;
 	}
 
-	pBase = pNode->pBase;
-
-	r = pNode->pRght;
-	if( !r ) {
-		if( pNode->pPrnt != NULL ) {
-			if( pNode->pPrnt->pLeft == pNode ) {
-				pNode->pPrnt->pLeft = pNode->pLeft;
-			} else {
-				pNode->pPrnt->pRght = pNode->pLeft;
-			}
-		} else {
-			pBase->pRoot = pNode->pLeft;
-		}
-
-		if( pNode->pLeft != NULL ) {
-			pNode->pLeft->pPrnt = pNode->pPrnt;
-		}
-	} else if( !r->pLeft ) {
-		r->pPrnt = pNode->pPrnt;
+	Map_Insert( pMap, pszKey != NULL ? pszKey : "", 0, iValue, NULL );
+}
+TENSHI_FUNC void TENSHI_CALL teMapInsertInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey, TenshiInt64_t iValue )
+{
+	TenshiMap_t *pMap;
 
-		r->pLeft = pNode->pLeft;
-		if( r->pLeft != NULL ) {
-			pNode->pLeft->pPrnt = r;
-		}
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return;
+	}
 
-		if( pNode->pPrnt != NULL ) {
-			pNode->pPrnt->pLeft = r;
-		} else {
-			pBase->pRoot = r;
-		}
-	} else {
-		s = r->pLeft;
+	Map_Insert( pMap, NULL, iKey, iValue, NULL );
+}
+TENSHI_FUNC void TENSHI_CALL teMapInsertStrStr( TenshiIndex_t MapNumber, const char *pszKey, const char *pszValue )
+{
+	TenshiMap_t *pMap;
 
-		while( s->pLeft != NULL ) {
-			s = s->pLeft;
-		}
-		s->pLeft = pNode->pLeft;
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return;
+	}
 
-		s->pPrnt->pLeft = s->pRght;
-		if( s->pPrnt->pLeft != NULL ) {
-			s->pRght->pPrnt = s->pPrnt;
-		}
-		s->pRght = r;
+	Map_Insert( pMap, pszKey != NULL ? pszKey : "", 0, 0, pszValue != NULL ? pszValue : "" );
+}
+TENSHI_FUNC void TENSHI_CALL teMapInsertIntStr( TenshiIndex_t MapNumber, TenshiInt64_t iKey, const char *pszValue )
+{
+	TenshiMap_t *pMap;
 
-		s->pPrnt = pNode->pPrnt;
-		if( s->pPrnt != NULL ) {
-			if( pNode->pPrnt->pLeft == pNode ) {
-				pNode->pPrnt->pLeft = s;
-			} else {
-				pNode->pPrnt->pRght = s;
-			}
-		} else {
-			pBase->pRoot = s;
-		}
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return;
 	}
 
-	if( pNode->pPrev != NULL ) {
-		pNode->pPrev->pNext = pNode->pNext;
-	} else {
-		pNode->pBase->pHead = pNode->pNext;
-	}
+	Map_Insert( pMap, NULL, iKey, 0, pszValue != NULL ? pszValue : "" );
+}
 
-	if( pNode->pNext != NULL ) {
-		pNode->pNext->pPrev = pNode->pPrev;
-	} else {
-		pNode->pBase->pTail = pNode->pPrev;
+static TenshiMapEntry_t *Map_FindValue( TenshiIndex_t MapNumber, const char *pszKey, TenshiInt64_t iKey )
+{
+	TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return NULL;
 	}
 
-	teFiniTypeInstance( pBase->pItemType, ( void * )( pNode + 1 ) );
-	teDealloc( ( void * )pNode );
+	return Map_Find( pMap, pszKey != NULL ? teStrHash( pszKey, 0 ) : Map_IntHash( iKey ), pszKey, iKey, NULL, NULL );
+}
+/* string values read as 0 */
+TENSHI_FUNC TenshiInt64_t TENSHI_CALL teMapFindStr( TenshiIndex_t MapNumber, const char *pszKey )
+{
+	const TenshiMapEntry_t *pEntry;
 
-	return NULL;
+	pEntry = Map_FindValue( MapNumber, pszKey != NULL ? pszKey : "", 0 );
+	return pEntry != NULL && !pEntry->pszValue ? pEntry->iValue : 0;
 }
-TENSHI_FUNC void *TENSHI_CALL teBTreeDelete( TenshiBTree_t *pBase, void *pItem )
+TENSHI_FUNC TenshiInt64_t TENSHI_CALL teMapFindInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey )
 {
-	return teBTreeDeleteNode( pBase, teBTreeNodeFromItem( pItem ) );
+	const TenshiMapEntry_t *pEntry;
+
+	pEntry = Map_FindValue( MapNumber, NULL, iKey );
+	return pEntry != NULL && !pEntry->pszValue ? pEntry->iValue : 0;
 }
-TENSHI_FUNC TenshiInt32_t TENSHI_CALL teBTreeNodeKey( const TenshiBTreeNode_t *pNode )
+/* integer values read as their text */
+static char *Map_ValueStr( const TenshiMapEntry_t *pEntry )
 {
-	return pNode != NULL ? pNode->Key : 0;
+	if( !pEntry ) {
+		return NULL;
+	}
+
+	if( !pEntry->pszValue ) {
+		return teCastInt64ToStr( pEntry->iValue );
+	}
+
+	return *pEntry->pszValue != '\0' ? teStrDup( pEntry->pszValue ) : NULL;
 }
-TENSHI_FUNC TenshiInt32_t TENSHI_CALL teBTreeKey( const void *pItem )
+TENSHI_FUNC char *TENSHI_CALL teMapFindStrStr( TenshiIndex_t MapNumber, const char *pszKey )
 {
-	return teBTreeNodeKey( pItem != NULL ? ( ( const TenshiBTreeNode_t * )pItem ) - 1 : NULL );
+	return Map_ValueStr( Map_FindValue( MapNumber, pszKey != NULL ? pszKey : "", 0 ) );
+}
+TENSHI_FUNC char *TENSHI_CALL teMapFindIntStr( TenshiIndex_t MapNumber, TenshiInt64_t iKey )
+{
+	return Map_ValueStr( Map_FindValue( MapNumber, NULL, iKey ) );
 }
 
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeFrontNode( TenshiBTree_t *pBase )
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapHasStr( TenshiIndex_t MapNumber, const char *pszKey )
 {
-	return pBase != NULL ? pBase->pHead : NULL;
+	return Map_FindValue( MapNumber, pszKey != NULL ? pszKey : "", 0 ) != NULL ? TENSHI_TRUE : TENSHI_FALSE;
 }
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeBackNode( TenshiBTree_t *pBase )
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapHasInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey )
 {
-	return pBase != NULL ? pBase->pTail : NULL;
+	return Map_FindValue( MapNumber, NULL, iKey ) != NULL ? TENSHI_TRUE : TENSHI_FALSE;
 }
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreePreviousNode( TenshiBTreeNode_t *pNode )
+
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapEraseStr( TenshiIndex_t MapNumber, const char *pszKey )
 {
-	return pNode != NULL ? pNode->pPrev : NULL;
+	TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return TENSHI_FALSE;
+	}
+
+	return Map_Erase( pMap, pszKey != NULL ? pszKey : "", 0 );
 }
-TENSHI_FUNC TenshiBTreeNode_t *TENSHI_CALL teBTreeNextNode( TenshiBTreeNode_t *pNode )
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapEraseInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey )
 {
-	return pNode != NULL ? pNode->pNext : NULL;
+	TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return TENSHI_FALSE;
+	}
+
+	return Map_Erase( pMap, NULL, iKey );
 }
 
-TENSHI_FUNC void *TENSHI_CALL teBTreeFront( TenshiBTree_t *pBase )
+/*
+	FOREACH visits the entries in the order they were added. Erasing keys
+	(including the current one) while iterating is fine; keys added while
+	iterating might or might not be visited, and adding them can compact the
+	entries, which makes the loop skip or revisit some.
+*/
+static const TenshiMapEntry_t *Map_IterEntry( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos )
 {
-	return teBTreeItemFromNode( teBTreeFrontNode( pBase ) );
+	const TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) || uPos - 1 >= pMap->cEntries ) {
+		return NULL;
+	}
+
+	return &pMap->pEntries[ uPos - 1 ];
 }
-TENSHI_FUNC void *TENSHI_CALL teBTreeBack( TenshiBTree_t *pBase )
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teMapIterFirst( TenshiIndex_t MapNumber )
 {
-	return teBTreeItemFromNode( teBTreeBackNode( pBase ) );
+	return teMapIterNext( MapNumber, 0 );
 }
-TENSHI_FUNC void *TENSHI_CALL teBTreePrevious( void *pItem )
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teMapIterNext( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos )
 {
-	return teBTreeItemFromNode( teBTreePreviousNode( teBTreeNodeFromItem( pItem ) ) );
+	const TenshiMap_t *pMap;
+
+	if( !( pMap = teMap( MapNumber ) ) ) {
+		return 0;
+	}
+
+	for( ; uPos < pMap->cEntries; ++uPos ) {
+		if( !pMap->pEntries[ uPos ].bErased ) {
+			return uPos + 1;
+		}
+	}
+
+	return 0;
 }
-TENSHI_FUNC void *TENSHI_CALL teBTreeNext( void *pItem )
+/* string keys read as 0 */
+TENSHI_FUNC TenshiInt64_t TENSHI_CALL teMapIterIntKey( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos )
 {
-	return teBTreeItemFromNode( teBTreeNextNode( teBTreeNodeFromItem( pItem ) ) );
+	const TenshiMapEntry_t *pEntry;
+
+	pEntry = Map_IterEntry( MapNumber, uPos );
+	return pEntry != NULL && !pEntry->pszKey ? pEntry->iKey : 0;
+}
+/* integer keys read as their text */
+TENSHI_FUNC char *TENSHI_CALL teMapIterStrKey( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos )
+{
+	const TenshiMapEntry_t *pEntry;
+
+	if( !( pEntry = Map_IterEntry( MapNumber, uPos ) ) ) {
+		return NULL;
+	}
+
+	if( !pEntry->pszKey ) {
+		return teCastInt64ToStr( pEntry->iKey );
+	}
+
+	return *pEntry->pszKey != '\0' ? teStrDup( pEntry->pszKey ) : NULL;
 }
 
 
@@ -4097,16 +7505,24 @@ TENSHI_FUNC float TENSHI_CALL teExp( float x )
 {
 	return expf( x );
 }
+TENSHI_FUNC float TENSHI_CALL teLog( float x )
+{
+	return logf( x );
+}
 TENSHI_FUNC float TENSHI_CALL teFloor( float x )
 {
 #if 0
 	return floorf( x );
 #else
-	if( ( teFloatToUintBits( x ) & 0x801FFFFF ) > 0x80000000 ) {
-		return ( float )( ( TenshiInt32_t )x - 1 );
+	float t;
+
+	/* floats this large are whole (and NaNs fail the test) */
+	if( !( teAbs( x ) < 8388608.0f ) ) {
+		return x;
 	}
 
-	return ( float )( TenshiInt32_t )x;
+	t = ( float )( TenshiInt32_t )x;
+	return t > x ? t - 1.0f : t;
 #endif
 }
 TENSHI_FUNC float TENSHI_CALL teCeil( float x )
@@ -4471,6 +7887,415 @@ TENSHI_FUNC float TENSHI_CALL teCellNoise( float x )
 }
 
 
+/*
+===============================================================================
+
+	BATCH MATH
+
+===============================================================================
+*/
+
+/*
+	teMathBatch() applies SIN, COS, SQRT, EXP, LOG or NOISE to a run of
+	floats in one call (ARRAY SIN and the like, through teArrayMath()), so
+	procedural generation needn't call into the runtime once per value.
+
+	With SSE2, four values are worked on at a time:
+
+	- SIN and COS reduce the angle exactly, in degrees, to within 45 degrees
+	  of a multiple of 90, then use the Cephes polynomials for sinf and cosf.
+	  teSin() and teCos() convert to radians first, so the batch is the more
+	  accurate of the two for large angles (and exact at multiples of 90).
+	- EXP and LOG use the Cephes polynomials for expf and logf, including
+	  overflow to infinity, denormals, LOG of zero (-infinity) and of
+	  negative numbers (NaN).
+	- SQRT is the SSE2 square root, and NOISE does the same operations as
+	  teNoise(), so both give exactly the scalar results.
+
+	These stay within 2 units in the last place of the exact results (about
+	1.6 for SIN and COS, under 1 for EXP and LOG), which Bench/MathBench.c
+	checks. The
+	kTenshiMathBatchF_Precise flag (ARRAY SIN ... PRECISE) calls the scalar
+	functions for each value instead, giving the same results as SIN() and
+	the rest, as every function does without SSE2.
+
+	Runs of MATH_PARALLEL_MIN values or more are split across the PARALLEL
+	FOR workers. Each chunk finishes its last few values in a buffer, so a
+	value's result doesn't depend on where it falls in the run.
+*/
+
+#undef TENSHI_FACILITY
+#define TENSHI_FACILITY             kTenshiLog_CoreRT_Array
+
+/* shorter runs are worked on by the calling thread */
+#ifndef MATH_PARALLEL_MIN
+# define MATH_PARALLEL_MIN          ( 1<<16 )
+#endif
+
+typedef void( *MathBatchFn_t )( float *pDst, const float *pSrc, TenshiUIntPtr_t n );
+
+typedef struct MathJob_s {
+	float *                         pDst;
+	const float *                   pSrc;
+	MathBatchFn_t                   pfnBatch;
+} MathJob_t;
+
+/* the scalar functions, one value at a time */
+#define MATH_SCALAR_BATCH(Name_,Fn_)\
+	static void Math_Scalar##Name_( float *pDst, const float *pSrc, TenshiUIntPtr_t n )\
+	{\
+		TenshiUIntPtr_t i;\
+		\
+		for( i = 0; i < n; ++i ) {\
+			pDst[ i ] = Fn_( pSrc[ i ] );\
+		}\
+	}
+
+MATH_SCALAR_BATCH(Sin,teSin)
+MATH_SCALAR_BATCH(Cos,teCos)
+MATH_SCALAR_BATCH(Exp,teExp)
+MATH_SCALAR_BATCH(Log,teLog)
+#if !SSE2_ENABLED
+MATH_SCALAR_BATCH(Sqrt,teSqrt)
+MATH_SCALAR_BATCH(Noise,teNoise)
+#endif
+
+#undef MATH_SCALAR_BATCH
+
+#if SSE2_ENABLED
+/* a where Mask is set, b elsewhere */
+static TENSHI_FORCEINLINE __m128 Math_Select( __m128 Mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( Mask, a ), _mm_andnot_ps( Mask, b ) );
+}
+/* low 32 bits of each product (SSE2 only multiplies the even lanes) */
+static TENSHI_FORCEINLINE __m128i Math_MulLo32( __m128i a, __m128i b )
+{
+	__m128i Even, Odd;
+
+	Even = _mm_mul_epu32( a, b );
+	Odd = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), _mm_srli_epi64( b, 32 ) );
+
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( Even, _MM_SHUFFLE( 0, 0, 2, 0 ) ), _mm_shuffle_epi32( Odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+}
+/* 2^n, for n in [-126, 127] */
+static TENSHI_FORCEINLINE __m128 Math_Pow2( __m128i n )
+{
+	return _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( n, _mm_set1_epi32( 127 ) ), 23 ) );
+}
+/* as teFloor() */
+static TENSHI_FORCEINLINE __m128 Math_Floor4( __m128 x )
+{
+	__m128 t;
+	__m128 bWhole;
+
+	t = _mm_cvtepi32_ps( _mm_cvttps_epi32( x ) );
+	t = _mm_sub_ps( t, _mm_and_ps( _mm_cmpgt_ps( t, x ), _mm_set1_ps( 1.0f ) ) );
+
+	bWhole = _mm_cmpnlt_ps( _mm_and_ps( x, _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) ) ), _mm_set1_ps( 8388608.0f ) );
+	return Math_Select( bWhole, x, t );
+}
+
+/* sine of each angle in degrees, or cosine with bCos */
+static TENSHI_FORCEINLINE __m128 Math_SinCos4( __m128 Deg, int bCos )
+{
+	float Lanes[ 4 ];
+	__m128i Quadrant;
+	__m128 Rad, z;
+	__m128 Sin, Cos;
+	__m128 bUseCos;
+	__m128 Sign;
+	int Big;
+	int i;
+
+	/* multiples of 90 aren't exact much past 2^22; bring those into range */
+	Big = _mm_movemask_ps( _mm_cmpnlt_ps( _mm_and_ps( Deg, _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) ) ), _mm_set1_ps( 4194304.0f ) ) );
+	if( Big != 0 ) {
+		_mm_storeu_ps( Lanes, Deg );
+		for( i = 0; i < 4; ++i ) {
+			if( Big & ( 1<<i ) ) {
+				Lanes[ i ] = fmodf( Lanes[ i ], 360.0f );
+			}
+		}
+		Deg = _mm_loadu_ps( Lanes );
+	}
+
+	/* Deg - 90*Quadrant is exact, and within [-45, 45] near enough */
+	Quadrant = _mm_cvtps_epi32( _mm_mul_ps( Deg, _mm_set1_ps( 1.0f/90.0f ) ) );
+	Rad = _mm_sub_ps( Deg, _mm_mul_ps( _mm_cvtepi32_ps( Quadrant ), _mm_set1_ps( 90.0f ) ) );
+	Rad = _mm_mul_ps( Rad, _mm_set1_ps( TENSHI_PI_F/180.0f ) );
+
+	if( bCos ) {
+		Quadrant = _mm_add_epi32( Quadrant, _mm_set1_epi32( 1 ) );
+	}
+
+	z = _mm_mul_ps( Rad, Rad );
+
+	Sin = _mm_set1_ps( -1.9515295891e-4f );
+	Sin = _mm_add_ps( _mm_mul_ps( Sin, z ), _mm_set1_ps( 8.3321608736e-3f ) );
+	Sin = _mm_add_ps( _mm_mul_ps( Sin, z ), _mm_set1_ps( -1.6666654611e-1f ) );
+	Sin = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( Sin, z ), Rad ), Rad );
+
+	Cos = _mm_set1_ps( 2.443315711809948e-5f );
+	Cos = _mm_add_ps( _mm_mul_ps( Cos, z ), _mm_set1_ps( -1.388731625493765e-3f ) );
+	Cos = _mm_add_ps( _mm_mul_ps( Cos, z ), _mm_set1_ps( 4.166664568298827e-2f ) );
+	Cos = _mm_mul_ps( _mm_mul_ps( Cos, z ), z );
+	Cos = _mm_add_ps( _mm_sub_ps( Cos, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) ), _mm_set1_ps( 1.0f ) );
+
+	/* odd quadrants take the other function, and the upper two are negated */
+	bUseCos = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( Quadrant, _mm_set1_epi32( 1 ) ), _mm_set1_epi32( 1 ) ) );
+	Sign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( Quadrant, _mm_set1_epi32( 2 ) ), 30 ) );
+
+	return _mm_xor_ps( Math_Select( bUseCos, Cos, Sin ), Sign );
+}
+static TENSHI_FORCEINLINE __m128 Math_Sin4( __m128 x )
+{
+	return Math_SinCos4( x, 0 );
+}
+static TENSHI_FORCEINLINE __m128 Math_Cos4( __m128 x )
+{
+	return Math_SinCos4( x, 1 );
+}
+static TENSHI_FORCEINLINE __m128 Math_Sqrt4( __m128 x )
+{
+	return _mm_sqrt_ps( x );
+}
+static TENSHI_FORCEINLINE __m128 Math_Exp4( __m128 x )
+{
+	__m128i n, nHalf;
+	__m128 fn;
+	__m128 y, z;
+
+	/* past these the result is infinity or zero anyway (NaNs pass through) */
+	x = _mm_max_ps( _mm_set1_ps( -104.0f ), _mm_min_ps( _mm_set1_ps( 89.0f ), x ) );
+
+	/* x = n*ln(2) + r, with ln(2) in two parts so r is exact */
+	fn = Math_Floor4( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( 1.44269504088896341f ) ), _mm_set1_ps( 0.5f ) ) );
+	x = _mm_sub_ps( x, _mm_mul_ps( fn, _mm_set1_ps( 0.693359375f ) ) );
+	x = _mm_sub_ps( x, _mm_mul_ps( fn, _mm_set1_ps( -2.12194440e-4f ) ) );
+
+	z = _mm_mul_ps( x, x );
+
+	y = _mm_set1_ps( 1.9875691500e-4f );
+	y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 1.3981999507e-3f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 8.3334519073e-3f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 4.1665795894e-2f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 1.6666665459e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 5.0000001201e-1f ) );
+	y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( y, z ), x ), _mm_set1_ps( 1.0f ) );
+
+	/* scale by 2^n in two steps, so overflow and denormals come out right */
+	n = _mm_cvttps_epi32( fn );
+	nHalf = _mm_srai_epi32( n, 1 );
+
+	y = _mm_mul_ps( y, Math_Pow2( nHalf ) );
+	return _mm_mul_ps( y, Math_Pow2( _mm_sub_epi32( n, nHalf ) ) );
+}
+static TENSHI_FORCEINLINE __m128 Math_Log4( __m128 x )
+{
+	__m128i Bits, e;
+	__m128 bDenormal, bSmall;
+	__m128 bNaN, bZero, bInf;
+	__m128 m, y, z, fe;
+
+	bNaN = _mm_or_ps( _mm_cmpunord_ps( x, x ), _mm_cmplt_ps( x, _mm_setzero_ps() ) );
+	bZero = _mm_cmpeq_ps( x, _mm_setzero_ps() );
+	bInf = _mm_cmpeq_ps( x, _mm_castsi128_ps( _mm_set1_epi32( 0x7F800000 ) ) );
+
+	/* bring denormals up to normal numbers first */
+	bDenormal = _mm_cmplt_ps( x, _mm_set1_ps( 1.17549435e-38f ) );
+	x = Math_Select( bDenormal, _mm_mul_ps( x, _mm_set1_ps( 8388608.0f ) ), x );
+
+	/* x = m*2^e, with m in [0.5, 1) */
+	Bits = _mm_castps_si128( x );
+	e = _mm_sub_epi32( _mm_srli_epi32( Bits, 23 ), _mm_set1_epi32( 126 ) );
+	e = _mm_sub_epi32( e, _mm_and_si128( _mm_castps_si128( bDenormal ), _mm_set1_epi32( 23 ) ) );
+	m = _mm_castsi128_ps( _mm_or_si128( _mm_and_si128( Bits, _mm_set1_epi32( 0x007FFFFF ) ), _mm_set1_epi32( 0x3F000000 ) ) );
+
+	/* keep m - 1 within [sqrt(0.5) - 1, sqrt(2) - 1] */
+	bSmall = _mm_cmplt_ps( m, _mm_set1_ps( 0.707106781186547524f ) );
+	e = _mm_add_epi32( e, _mm_castps_si128( bSmall ) );
+	m = _mm_add_ps( _mm_sub_ps( m, _mm_set1_ps( 1.0f ) ), _mm_and_ps( bSmall, m ) );
+
+	z = _mm_mul_ps( m, m );
+
+	y = _mm_set1_ps( 7.0376836292e-2f );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( -1.1514610310e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( 1.1676998740e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( -1.2420140846e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( 1.4249322787e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( -1.6668057665e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( 2.0000714765e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( -2.4999993993e-1f ) );
+	y = _mm_add_ps( _mm_mul_ps( y, m ), _mm_set1_ps( 3.3333331174e-1f ) );
+	y = _mm_mul_ps( _mm_mul_ps( y, m ), z );
+
+	fe = _mm_cvtepi32_ps( e );
+	y = _mm_add_ps( y, _mm_mul_ps( fe, _mm_set1_ps( -2.12194440e-4f ) ) );
+	y = _mm_sub_ps( y, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) );
+	y = _mm_add_ps( _mm_add_ps( m, y ), _mm_mul_ps( fe, _mm_set1_ps( 0.693359375f ) ) );
+
+	y = Math_Select( bInf, x, y );
+	y = Math_Select( bZero, _mm_castsi128_ps( _mm_set1_epi32( ( int )0xFF800000 ) ), y );
+	return Math_Select( bNaN, _mm_castsi128_ps( _mm_set1_epi32( 0x7FC00000 ) ), y );
+}
+/* as teGrad() */
+static TENSHI_FORCEINLINE __m128 Math_Grad4( __m128i n, __m128 x )
+{
+	__m128i h;
+
+	n = _mm_xor_si128( _mm_slli_epi32( n, 13 ), n );
+	h = Math_MulLo32( n, n );
+	h = _mm_add_epi32( Math_MulLo32( h, _mm_set1_epi32( 15731 ) ), _mm_set1_epi32( 789221 ) );
+	n = _mm_add_epi32( Math_MulLo32( n, h ), _mm_set1_epi32( 1376312589 ) );
+
+	/* bit 29 of the hash flips the sign */
+	return _mm_xor_ps( x, _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( n, _mm_set1_epi32( 0x20000000 ) ), 2 ) ) );
+}
+/* as teNoise() */
+static TENSHI_FORCEINLINE __m128 Math_Noise4( __m128 x )
+{
+	__m128i n;
+	__m128 i, f, w;
+	__m128 a, b;
+
+	i = Math_Floor4( x );
+	f = _mm_sub_ps( x, i );
+
+	w = _mm_add_ps( _mm_mul_ps( f, _mm_sub_ps( _mm_mul_ps( f, _mm_set1_ps( 6.0f ) ), _mm_set1_ps( 15.0f ) ) ), _mm_set1_ps( 10.0f ) );
+	w = _mm_mul_ps( _mm_mul_ps( _mm_mul_ps( f, f ), f ), w );
+
+	n = _mm_cvttps_epi32( i );
+	a = Math_Grad4( n, f );
+	b = Math_Grad4( _mm_add_epi32( n, _mm_set1_epi32( 1 ) ), _mm_sub_ps( f, _mm_set1_ps( 1.0f ) ) );
+
+	return _mm_add_ps( a, _mm_mul_ps( _mm_sub_ps( b, a ), w ) );
+}
+
+/* four values at a time, the last few through a buffer */
+# define MATH_SSE2_BATCH(Name_)\
+	static void Math_Batch##Name_( float *pDst, const float *pSrc, TenshiUIntPtr_t n )\
+	{\
+		float Tail[ 4 ];\
+		TenshiUIntPtr_t cTail;\
+		TenshiUIntPtr_t i;\
+		\
+		for( i = 0; i + 4 <= n; i += 4 ) {\
+			_mm_storeu_ps( pDst + i, Math_##Name_##4( _mm_loadu_ps( pSrc + i ) ) );\
+		}\
+		\
+		cTail = n - i;\
+		if( cTail > 0 ) {\
+			_mm_storeu_ps( Tail, _mm_setzero_ps() );\
+			memcpy( ( void * )Tail, ( const void * )( pSrc + i ), cTail*sizeof( float ) );\
+			_mm_storeu_ps( Tail, Math_##Name_##4( _mm_loadu_ps( Tail ) ) );\
+			memcpy( ( void * )( pDst + i ), ( const void * )Tail, cTail*sizeof( float ) );\
+		}\
+	}
+
+MATH_SSE2_BATCH(Sin)
+MATH_SSE2_BATCH(Cos)
+MATH_SSE2_BATCH(Sqrt)
+MATH_SSE2_BATCH(Exp)
+MATH_SSE2_BATCH(Log)
+MATH_SSE2_BATCH(Noise)
+
+# undef MATH_SSE2_BATCH
+
+static const MathBatchFn_t g_MathBatch[ kTenshiNumMathBatches ] = {
+	&Math_BatchSin,
+	&Math_BatchCos,
+	&Math_BatchSqrt,
+	&Math_BatchExp,
+	&Math_BatchLog,
+	&Math_BatchNoise
+};
+/* SQRT and NOISE already give the scalar results */
+static const MathBatchFn_t g_MathBatchPrecise[ kTenshiNumMathBatches ] = {
+	&Math_ScalarSin,
+	&Math_ScalarCos,
+	&Math_BatchSqrt,
+	&Math_ScalarExp,
+	&Math_ScalarLog,
+	&Math_BatchNoise
+};
+#else
+static const MathBatchFn_t g_MathBatch[ kTenshiNumMathBatches ] = {
+	&Math_ScalarSin,
+	&Math_ScalarCos,
+	&Math_ScalarSqrt,
+	&Math_ScalarExp,
+	&Math_ScalarLog,
+	&Math_ScalarNoise
+};
+# define g_MathBatchPrecise         g_MathBatch
+#endif
+
+static void TENSHI_CALL Math_Batch_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
+{
+	const MathJob_t *pJob;
+
+	( void )uChunk;
+
+	pJob = ( const MathJob_t * )pContext;
+	pJob->pfnBatch( pJob->pDst + iFirst, pJob->pSrc + iFirst, ( TenshiUIntPtr_t )( iLast - iFirst ) );
+}
+
+TENSHI_FUNC void TENSHI_CALL teMathBatch( float *pDst, const float *pSrc, TenshiUIntPtr_t cValues, TenshiUInt32_t Func, TenshiUInt32_t Flags )
+{
+	MathJob_t Job;
+	TenshiUInt32_t cChunks;
+
+	if( Func >= kTenshiNumMathBatches ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Invalid batch math function %u", ( unsigned )Func );
+		return;
+	}
+
+	if( !pDst || !pSrc || !cValues ) {
+		return;
+	}
+
+	Job.pDst = pDst;
+	Job.pSrc = pSrc;
+	Job.pfnBatch = ( Flags & kTenshiMathBatchF_Precise ) ? g_MathBatchPrecise[ Func ] : g_MathBatch[ Func ];
+
+	cChunks = 1;
+	if( cValues >= MATH_PARALLEL_MIN ) {
+		cChunks = teGetWorkerCount();
+		if( cChunks > TENSHI_PARALLEL_MAX_WORKERS ) {
+			cChunks = TENSHI_PARALLEL_MAX_WORKERS;
+		}
+	}
+
+	teParallelFor( &Math_Batch_f, ( void * )&Job, cValues, cChunks );
+}
+TENSHI_FUNC void TENSHI_CALL teArrayMath( void *pDstArrayData, const void *pSrcArrayData, TenshiUInt32_t Func, TenshiUInt32_t Flags )
+{
+	TenshiArray_t *pDstArr;
+	TenshiArray_t *pSrcArr;
+	TenshiUIntPtr_t cItems;
+
+	if( !pDstArrayData || !pSrcArrayData ) {
+		return;
+	}
+
+	pDstArr = ArrayFromData( pDstArrayData );
+	pSrcArr = ArrayFromData( ( void * )pSrcArrayData );
+
+	if( pDstArr->cItemBytes != sizeof( float ) || pSrcArr->cItemBytes != sizeof( float ) ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Batch math needs FLOAT items, not items of %u and %u bytes",
+			( unsigned )pDstArr->cItemBytes, ( unsigned )pSrcArr->cItemBytes );
+		return;
+	}
+
+	cItems = pDstArr->cItems < pSrcArr->cItems ? pDstArr->cItems : pSrcArr->cItems;
+	teMathBatch( ( float * )pDstArrayData, ( const float * )pSrcArrayData, cItems, Func, Flags );
+}
+
 /*
 ===============================================================================
 
@@ -4481,6 +8306,75 @@ TENSHI_FUNC float TENSHI_CALL teCellNoise( float x )
 ===============================================================================
 */
 
+/*
+	Each thread has its own default generator (RANDOMIZE, RND), so RND needn't
+	be serialized in the body of a PARALLEL FOR. Each chunk of a loop runs
+	with its own stream split from the default generator of the thread that
+	started the loop (see teRunChunks()), so the values a chunk sees don't
+	depend on which thread runs it, or on how many workers there are. The
+	starting thread's generator moves on by one value after a loop that used
+	RND, so the next loop gets different streams.
+
+	tePCGAdvance() jumps ahead by any number of values with the usual LCG
+	doubling (Brown, "Random Number Generation with Arbitrary Strides"), and
+	tePCGSplit() uses it to hand out streams 2^40 values apart.
+
+	tePCGFill() stores many values in one call (ARRAY RND, FILL MEMBLOCK RND),
+	giving the same values as calling the generator for each. It runs four
+	copies of the generator, each four values apart, so the multiplies don't
+	wait on each other, and splits runs of RND_PARALLEL_MIN values or more
+	across the PARALLEL FOR workers, each starting from the generator
+	advanced to its first value. INTEGERs take two values each, so that the
+	range is covered without a retry loop (and with a bias of at most one
+	part in 2^32), which tePCGBoundedRnd() needs one value for.
+*/
+
+#undef TENSHI_FACILITY
+#define TENSHI_FACILITY             kTenshiLog_CoreRT
+
+#define TENSHI_PCG_MULT             6364136223846793005ULL
+
+/* shorter runs are filled by the calling thread */
+#ifndef RND_PARALLEL_MIN
+# define RND_PARALLEL_MIN           ( 1<<16 )
+#endif
+
+/* the value for a state (before it's stepped) */
+static TENSHI_FORCEINLINE TenshiUInt32_t PCG_Output( TenshiUInt64_t oldstate )
+{
+	TenshiUInt32_t xorshifted, rot;
+
+	xorshifted = ( ( oldstate >> 18 ) ^ oldstate ) >> 27;
+
+	rot = oldstate >> 59;
+	return ( xorshifted >> rot ) | ( xorshifted << ( ( -rot ) & 31 ) );
+}
+/* the multiplier and increment that step a state delta values at once */
+static void PCG_Jump( TenshiUInt64_t delta, TenshiUInt64_t inc, TenshiUInt64_t *pMult, TenshiUInt64_t *pPlus )
+{
+	TenshiUInt64_t curMult, curPlus;
+	TenshiUInt64_t accMult, accPlus;
+
+	curMult = TENSHI_PCG_MULT;
+	curPlus = inc;
+	accMult = 1;
+	accPlus = 0;
+
+	while( delta > 0 ) {
+		if( delta & 1 ) {
+			accMult *= curMult;
+			accPlus = accPlus*curMult + curPlus;
+		}
+
+		curPlus = ( curMult + 1 )*curPlus;
+		curMult *= curMult;
+		delta >>= 1;
+	}
+
+	*pMult = accMult;
+	*pPlus = accPlus;
+}
+
 TENSHI_FUNC void TENSHI_CALL tePCGSeed( TenshiPCGState_t *r, TenshiUInt64_t state, TenshiUInt64_t seq )
 {
 	r->state  = 0;
@@ -4500,42 +8394,252 @@ TENSHI_FUNC void TENSHI_CALL tePCGRandomize( TenshiPCGState_t *r, TenshiUInt32_t
 }
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL tePCGRnd( TenshiPCGState_t *r )
 {
-	TenshiUInt64_t oldstate;
-	TenshiUInt32_t xorshifted, rot;
+	TenshiUInt64_t oldstate;
+
+	oldstate = r->state;
+	r->state = oldstate*TENSHI_PCG_MULT + r->inc;
+
+	return PCG_Output( oldstate );
+}
+TENSHI_FUNC TenshiUInt32_t TENSHI_CALL tePCGBoundedRnd( TenshiPCGState_t *r, TenshiUInt32_t bound )
+{
+	TenshiUInt32_t threshold;
+	TenshiUInt32_t remainingIters;
+	TenshiUInt32_t value;
+
+	threshold = -bound % bound;
+
+	remainingIters = 32;
+	do {
+		value = tePCGRnd( r );
+		if( value >= threshold ) {
+			break;
+		}
+	} while( --remainingIters != 0 );
+
+	return value%bound;
+}
+TENSHI_FUNC TenshiInt32_t TENSHI_CALL tePCGRangedRnd( TenshiPCGState_t *r, TenshiInt32_t lowBound, TenshiInt32_t highBound )
+{
+	return lowBound + tePCGBoundedRnd( r, highBound - lowBound );
+}
+TENSHI_FUNC void TENSHI_CALL tePCGAdvance( TenshiPCGState_t *r, TenshiUInt64_t delta )
+{
+	TenshiUInt64_t mult, plus;
+
+	PCG_Jump( delta, r->inc, &mult, &plus );
+	r->state = r->state*mult + plus;
+}
+TENSHI_FUNC void TENSHI_CALL tePCGSplit( TenshiPCGState_t *pDst, const TenshiPCGState_t *pSrc, TenshiUInt64_t uStream )
+{
+	*pDst = *pSrc;
+	tePCGAdvance( pDst, uStream << 40 );
+}
+
+typedef struct RndFill_s {
+	/* the generator as of the first value */
+	TenshiPCGState_t                Start;
+	TenshiUInt8_t *                 pDst;
+	TenshiUInt32_t                  Kind;
+	double                          Low;
+	double                          Range;
+} RndFill_t;
+
+static TenshiUInt32_t Rnd_DrawsPerValue( TenshiUInt32_t Kind )
+{
+	return Kind == kTenshiRndFill_Int32 || Kind == kTenshiRndFill_Float64 ? 2 : 1;
+}
+static TenshiUIntPtr_t Rnd_ValueBytes( TenshiUInt32_t Kind )
+{
+	return Kind == kTenshiRndFill_Float64 ? sizeof( double ) : sizeof( TenshiUInt32_t );
+}
+
+/* the value of each kind from one or two generator values */
+static TENSHI_FORCEINLINE void Rnd_StoreInt32( TenshiUInt8_t *pDst, TenshiInt32_t iLow, TenshiUInt32_t uBound, TenshiUInt32_t a, TenshiUInt32_t b )
+{
+	TenshiUInt64_t uBits;
+	TenshiUInt32_t uValue;
+
+	/* the high 32 bits of the 64-bit value times the size of the range */
+	uBits = ( TenshiUInt64_t )a*uBound + ( ( ( TenshiUInt64_t )b*uBound ) >> 32 );
+	uValue = ( TenshiUInt32_t )iLow + ( TenshiUInt32_t )( uBits >> 32 );
+
+	memcpy( ( void * )pDst, ( const void * )&uValue, 4 );
+}
+static TENSHI_FORCEINLINE void Rnd_StoreFloat32( TenshiUInt8_t *pDst, float fLow, float fRange, TenshiUInt32_t a )
+{
+	float fValue;
+
+	fValue = fLow + ( float )( a >> 8 )*( 1.0f/16777216.0f )*fRange;
+	memcpy( ( void * )pDst, ( const void * )&fValue, 4 );
+}
+static TENSHI_FORCEINLINE void Rnd_StoreFloat64( TenshiUInt8_t *pDst, double Low, double Range, TenshiUInt32_t a, TenshiUInt32_t b )
+{
+	double Value;
+
+	Value = Low + ( double )( ( ( TenshiUInt64_t )a << 32 | b ) >> 11 )*( 1.0/9007199254740992.0 )*Range;
+	memcpy( ( void * )pDst, ( const void * )&Value, 8 );
+}
+
+/* values [uFirst, uFirst + cValues) of a fill, from four generators a step apart */
+static void Rnd_FillRange( const RndFill_t *pFill, TenshiUIntPtr_t uFirst, TenshiUIntPtr_t cValues )
+{
+	TenshiPCGState_t r;
+	TenshiUInt64_t s0, s1, s2, s3;
+	TenshiUInt64_t Mult, Plus;
+	TenshiUInt32_t d0, d1, d2, d3;
+	TenshiUInt32_t Tail[ 4 ];
+	TenshiUInt8_t *pDst;
+	TenshiUInt32_t cDraws;
+	TenshiUInt32_t uBound;
+	TenshiInt32_t iLow;
+	float fLow, fRange;
+	TenshiUIntPtr_t cBytes;
+	TenshiUIntPtr_t cFull;
+	TenshiUIntPtr_t i;
 
-	oldstate = r->state;
-	r->state = oldstate*6364136223846793005ULL + r->inc;
+	cDraws = Rnd_DrawsPerValue( pFill->Kind );
+	cBytes = Rnd_ValueBytes( pFill->Kind );
+
+	r = pFill->Start;
+	tePCGAdvance( &r, ( TenshiUInt64_t )uFirst*cDraws );
+
+	s0 = r.state;
+	s1 = s0*TENSHI_PCG_MULT + r.inc;
+	s2 = s1*TENSHI_PCG_MULT + r.inc;
+	s3 = s2*TENSHI_PCG_MULT + r.inc;
+	PCG_Jump( 4, r.inc, &Mult, &Plus );
+
+	/* four more values; each generator's multiply only waits on its own */
+#define RND_NEXT4()\
+	d0 = PCG_Output( s0 ); s0 = s0*Mult + Plus;\
+	d1 = PCG_Output( s1 ); s1 = s1*Mult + Plus;\
+	d2 = PCG_Output( s2 ); s2 = s2*Mult + Plus;\
+	d3 = PCG_Output( s3 ); s3 = s3*Mult + Plus
+
+	pDst = pFill->pDst + uFirst*cBytes;
+
+	/* the integer bounds only mean anything for an integer fill */
+	iLow = 0;
+	uBound = 0;
+	fLow = ( float )pFill->Low;
+	fRange = ( float )pFill->Range;
+
+	/* groups of four generator values, then what's left over */
+	cFull = cValues/( 4/cDraws )*( 4/cDraws );
+
+	switch( pFill->Kind ) {
+	case kTenshiRndFill_Bits32:
+		for( i = 0; i < cFull; i += 4 ) {
+			RND_NEXT4();
+			memcpy( ( void * )( pDst + i*4 + 0 ), ( const void * )&d0, 4 );
+			memcpy( ( void * )( pDst + i*4 + 4 ), ( const void * )&d1, 4 );
+			memcpy( ( void * )( pDst + i*4 + 8 ), ( const void * )&d2, 4 );
+			memcpy( ( void * )( pDst + i*4 + 12 ), ( const void * )&d3, 4 );
+		}
+		break;
+
+	case kTenshiRndFill_Int32:
+		iLow = ( TenshiInt32_t )pFill->Low;
+		uBound = ( TenshiUInt32_t )( TenshiInt32_t )( pFill->Low + pFill->Range ) - ( TenshiUInt32_t )iLow;
+		for( i = 0; i < cFull; i += 2 ) {
+			RND_NEXT4();
+			Rnd_StoreInt32( pDst + i*4, iLow, uBound, d0, d1 );
+			Rnd_StoreInt32( pDst + i*4 + 4, iLow, uBound, d2, d3 );
+		}
+		break;
+
+	case kTenshiRndFill_Float32:
+		for( i = 0; i < cFull; i += 4 ) {
+			RND_NEXT4();
+			Rnd_StoreFloat32( pDst + i*4, fLow, fRange, d0 );
+			Rnd_StoreFloat32( pDst + i*4 + 4, fLow, fRange, d1 );
+			Rnd_StoreFloat32( pDst + i*4 + 8, fLow, fRange, d2 );
+			Rnd_StoreFloat32( pDst + i*4 + 12, fLow, fRange, d3 );
+		}
+		break;
 
-	xorshifted = ( ( oldstate >> 18 ) ^ oldstate ) >> 27;
+	case kTenshiRndFill_Float64:
+		for( i = 0; i < cFull; i += 2 ) {
+			RND_NEXT4();
+			Rnd_StoreFloat64( pDst + i*8, pFill->Low, pFill->Range, d0, d1 );
+			Rnd_StoreFloat64( pDst + i*8 + 8, pFill->Low, pFill->Range, d2, d3 );
+		}
+		break;
+	}
 
-	rot = oldstate >> 59;
-	return ( xorshifted >> rot ) | ( xorshifted << ( ( -rot ) & 31 ) );
-}
-TENSHI_FUNC TenshiUInt32_t TENSHI_CALL tePCGBoundedRnd( TenshiPCGState_t *r, TenshiUInt32_t bound )
-{
-	TenshiUInt32_t threshold;
-	TenshiUInt32_t remainingIters;
-	TenshiUInt32_t value;
+	if( cFull == cValues ) {
+		return;
+	}
 
-	threshold = -bound % bound;
+	RND_NEXT4();
+#undef RND_NEXT4
 
-	remainingIters = 32;
-	do {
-		value = tePCGRnd( r );
-		if( value >= threshold ) {
+	Tail[ 0 ] = d0;
+	Tail[ 1 ] = d1;
+	Tail[ 2 ] = d2;
+	Tail[ 3 ] = d3;
+
+	for( i = cFull; i < cValues; ++i ) {
+		switch( pFill->Kind ) {
+		case kTenshiRndFill_Bits32:
+			memcpy( ( void * )( pDst + i*4 ), ( const void * )&Tail[ i - cFull ], 4 );
+			break;
+		case kTenshiRndFill_Int32:
+			Rnd_StoreInt32( pDst + i*4, iLow, uBound, Tail[ ( i - cFull )*2 ], Tail[ ( i - cFull )*2 + 1 ] );
+			break;
+		case kTenshiRndFill_Float32:
+			Rnd_StoreFloat32( pDst + i*4, fLow, fRange, Tail[ i - cFull ] );
+			break;
+		case kTenshiRndFill_Float64:
+			Rnd_StoreFloat64( pDst + i*8, pFill->Low, pFill->Range, Tail[ ( i - cFull )*2 ], Tail[ ( i - cFull )*2 + 1 ] );
 			break;
 		}
-	} while( --remainingIters != 0 );
-
-	return value%bound;
+	}
 }
-TENSHI_FUNC TenshiInt32_t TENSHI_CALL tePCGRangedRnd( TenshiPCGState_t *r, TenshiInt32_t lowBound, TenshiInt32_t highBound )
+static void TENSHI_CALL Rnd_Fill_f( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast )
 {
-	return lowBound + tePCGBoundedRnd( r, highBound - lowBound );
+	( void )uChunk;
+
+	Rnd_FillRange( ( const RndFill_t * )pContext, ( TenshiUIntPtr_t )iFirst, ( TenshiUIntPtr_t )( iLast - iFirst ) );
 }
 
-#undef TENSHI_FACILITY
-#define TENSHI_FACILITY             kTenshiLog_CoreRT
+TENSHI_FUNC void TENSHI_CALL tePCGFill( TenshiPCGState_t *r, void *pDst, TenshiUIntPtr_t cValues, TenshiUInt32_t Kind, double Low, double High )
+{
+	RndFill_t Fill;
+	TenshiUInt32_t cChunks;
+
+	if( Kind >= kTenshiNumRndFills ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Invalid random fill %u", ( unsigned )Kind );
+		return;
+	}
+
+	if( !r || !pDst || !cValues ) {
+		return;
+	}
+
+	Fill.Start = *r;
+	Fill.pDst = ( TenshiUInt8_t * )pDst;
+	Fill.Kind = Kind;
+	Fill.Low = Low;
+	Fill.Range = High - Low;
+
+	cChunks = 1;
+	if( cValues >= RND_PARALLEL_MIN ) {
+		cChunks = teGetWorkerCount();
+		if( cChunks > TENSHI_PARALLEL_MAX_WORKERS ) {
+			cChunks = TENSHI_PARALLEL_MAX_WORKERS;
+		}
+	}
+
+	teParallelFor( &Rnd_Fill_f, ( void * )&Fill, cValues, cChunks );
+
+	/* r may be the default generator, which the loop puts back as it was */
+	*r = Fill.Start;
+	tePCGAdvance( r, ( TenshiUInt64_t )cValues*Rnd_DrawsPerValue( Kind ) );
+}
 
 #define TENSHI_PCG_STATE_INIT       0x853c49e6748fea9bULL
 #define TENSHI_PCG_INC_INIT         0xda3e39cb94b95bdbULL
@@ -4627,8 +8731,29 @@ TENSHI_FUNC TenshiInt32_t TENSHI_CALL teRNGRangedGenerate( TenshiIndex_t RNGNumb
 
 	return tePCGRangedRnd( r, lowBound, highBound );
 }
+TENSHI_FUNC void TENSHI_CALL teRNGAdvance( TenshiIndex_t RNGNumber, TenshiUInt64_t delta )
+{
+	TenshiPCGState_t *r;
+
+	if( !( r = teRNG( RNGNumber ) ) ) {
+		return;
+	}
+
+	tePCGAdvance( r, delta );
+}
+TENSHI_FUNC void TENSHI_CALL teRNGSplit( TenshiIndex_t DstRNGNumber, TenshiIndex_t SrcRNGNumber, TenshiUInt32_t uStream )
+{
+	TenshiPCGState_t *pDst;
+	TenshiPCGState_t *pSrc;
+
+	if( !( pDst = teRNG( DstRNGNumber ) ) || !( pSrc = teRNG( SrcRNGNumber ) ) ) {
+		return;
+	}
+
+	tePCGSplit( pDst, pSrc, uStream );
+}
 
-static TenshiPCGState_t g_RNG = {
+static THREAD_LOCAL TenshiPCGState_t g_RNG = {
 	TENSHI_PCG_STATE_INIT,
 	TENSHI_PCG_INC_INIT
 };
@@ -4648,6 +8773,433 @@ TENSHI_FUNC TenshiInt32_t TENSHI_CALL teRndRanged( TenshiInt32_t lowBound, Tensh
 {
 	return tePCGRangedRnd( &g_RNG, lowBound, highBound );
 }
+TENSHI_FUNC void TENSHI_CALL teRndAdvance( TenshiUInt64_t delta )
+{
+	tePCGAdvance( &g_RNG, delta );
+}
+
+TENSHI_FUNC void TENSHI_CALL teArrayRandomize( void *pArrayData, TenshiIndex_t RNGNumber, TenshiUInt32_t Kind, double Low, double High )
+{
+	TenshiArray_t *pArr;
+	TenshiPCGState_t *r;
+
+	if( !pArrayData || Kind >= kTenshiNumRndFills ) {
+		return;
+	}
+
+	r = RNGNumber != 0 ? teRNG( RNGNumber ) : &g_RNG;
+	if( !r ) {
+		return;
+	}
+
+	pArr = ArrayFromData( pArrayData );
+	if( pArr->cItemBytes != Rnd_ValueBytes( Kind ) ) {
+		teLogf( TELOG_ERROR | TENSHI_FACILITY | TELOG_C_FAIL, TENSHI_MODNAME,
+			( const char * )0, 0, CURRENT_FUNCTION, ( const char * )0,
+			"Random fill %u doesn't suit items of %u bytes", ( unsigned )Kind, ( unsigned )pArr->cItemBytes );
+		return;
+	}
+
+	tePCGFill( r, pArrayData, pArr->cItems, Kind, Low, High );
+}
+
+/* values stored from uPos on, if the memblock is large enough for them all */
+static void Rnd_FillMemblock( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues, TenshiUInt32_t Kind, double Low, double High )
+{
+	TenshiMemblock_t *p;
+	TenshiUIntPtr_t cBytes;
+
+	p = teMemblock( MemblockNumber );
+	if( !p || !cValues ) {
+		return;
+	}
+
+	cBytes = Rnd_ValueBytes( Kind );
+	if( uPos > p->cBytes || cValues > ( p->cBytes - uPos )/cBytes ) {
+		return;
+	}
+
+	tePCGFill( &g_RNG, ( void * )( ( TenshiUInt8_t * )( p + 1 ) + uPos ), cValues, Kind, Low, High );
+}
+TENSHI_FUNC void TENSHI_CALL teFillMemblockRnd( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues )
+{
+	Rnd_FillMemblock( MemblockNumber, uPos, cValues, kTenshiRndFill_Bits32, 0.0, 0.0 );
+}
+TENSHI_FUNC void TENSHI_CALL teFillMemblockRndRanged( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues, TenshiInt32_t lowBound, TenshiInt32_t highBound )
+{
+	Rnd_FillMemblock( MemblockNumber, uPos, cValues, kTenshiRndFill_Int32, ( double )lowBound, ( double )highBound );
+}
+TENSHI_FUNC void TENSHI_CALL teFillMemblockRndFloat( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues, float Low, float High )
+{
+	Rnd_FillMemblock( MemblockNumber, uPos, cValues, kTenshiRndFill_Float32, ( double )Low, ( double )High );
+}
+
+
+/*
+===============================================================================
+
+	PARALLEL LOOPS
+
+===============================================================================
+*/
+
+/*
+	The body of a PARALLEL FOR is outlined by the compiler and handed to
+	teParallelFor() along with the number of chunks to split the iteration
+	range into. The workers follow the job scheduler in AxLibs
+	(Async/Scheduler04): chunks are claimed through an atomic counter,
+	workers sleep between loops, and the thread submitting the loop works on
+	it too rather than waiting idle. (The scheduler itself is C++ and can't be
+	linked into the runtime.)
+
+	Only one loop runs on the workers at a time. A loop started while another
+	is running (e.g., from a FUNCTION called within a PARALLEL FOR) runs all
+	of its chunks on the calling thread.
+
+	Each chunk runs with the thread's default generator set to its own
+	stream of the starting thread's generator (see RANDOM NUMBER).
+*/
+
+typedef struct TenshiParallelLoop_s {
+	TenshiFnParallelBody_t          pfnBody;
+	void *                          pContext;
+	TenshiUInt64_t                  cIterations;
+	TenshiUInt32_t                  cChunks;
+	volatile TenshiUInt32_t         uNextChunk;
+	/* the starting thread's default generator, which chunks split streams from */
+	TenshiPCGState_t                RNG;
+	/* set once a chunk has drawn from its stream */
+	volatile int                    bUsedRNG;
+} TenshiParallelLoop_t;
+
+static struct {
+	/* guards everything below */
+	TenshiMutex_t                   Lock;
+	/* signalled when a loop is submitted (or the workers should quit) */
+	TenshiCondVar_t                 Wake;
+	/* signalled when the last active worker leaves a loop */
+	TenshiCondVar_t                 Done;
+
+	/* serializes thread-unsafe calls made from loop bodies */
+	TenshiMutex_t                   CallLock;
+
+	TenshiThread_t                  Threads[ TENSHI_PARALLEL_MAX_WORKERS ];
+	TenshiUInt32_t                  cThreads;
+	/* number of threads loops run on, including the submitting thread */
+	TenshiUInt32_t                  cWorkers;
+
+	TenshiParallelLoop_t *          pLoop;
+	TenshiUInt32_t                  uGeneration;
+	TenshiUInt32_t                  cActive;
+	int                             bBusy;
+	int                             bQuit;
+} g_Parallel = {
+	.Lock = TENSHI_MUTEX_INIT,
+	.Wake = TENSHI_CONDVAR_INIT,
+	.Done = TENSHI_CONDVAR_INIT,
+	.CallLock = TENSHI_MUTEX_INIT
+};
+
+static TenshiUInt32_t teGetProcessorCount( void )
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+
+	GetSystemInfo( &si );
+	return ( TenshiUInt32_t )si.dwNumberOfProcessors;
+#else
+	long n;
+
+	n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? ( TenshiUInt32_t )n : 1;
+#endif
+}
+
+static void teRunChunks( TenshiParallelLoop_t *pLoop )
+{
+	TenshiUInt64_t cPerChunk, cExtra;
+	TenshiUInt64_t iFirst, iLast;
+	TenshiUInt32_t uChunk;
+	TenshiPCGState_t Stream;
+
+	/* the first (cIterations % cChunks) chunks take one extra iteration */
+	cPerChunk = pLoop->cIterations/pLoop->cChunks;
+	cExtra = pLoop->cIterations%pLoop->cChunks;
+
+	for(;;) {
+		uChunk = teAtomicClaim( &pLoop->uNextChunk );
+		if( uChunk >= pLoop->cChunks ) {
+			break;
+		}
+
+		iFirst = cPerChunk*uChunk + ( uChunk < cExtra ? uChunk : cExtra );
+		iLast = iFirst + cPerChunk + ( uChunk < cExtra ? 1 : 0 );
+
+		/* stream 0 is the starting thread's own */
+		tePCGSplit( &Stream, &pLoop->RNG, ( TenshiUInt64_t )uChunk + 1 );
+		g_RNG = Stream;
+
+		++g_cLoopBodies;
+		pLoop->pfnBody( pLoop->pContext, uChunk, ( TenshiInt64_t )iFirst, ( TenshiInt64_t )iLast );
+		--g_cLoopBodies;
+
+		if( g_RNG.state != Stream.state || g_RNG.inc != Stream.inc ) {
+			pLoop->bUsedRNG = 1;
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI teWorkerThread_f( void *pParm )
+#else
+static void *teWorkerThread_f( void *pParm )
+#endif
+{
+	TenshiParallelLoop_t *pLoop;
+	TenshiUInt32_t uSeenGeneration;
+
+	((void)pParm);
+
+	teMutexLock( &g_Parallel.Lock );
+	uSeenGeneration = g_Parallel.uGeneration;
+
+	for(;;) {
+		while( !g_Parallel.bQuit && g_Parallel.uGeneration == uSeenGeneration ) {
+			teCondWait( &g_Parallel.Wake, &g_Parallel.Lock );
+		}
+		if( g_Parallel.bQuit ) {
+			break;
+		}
+
+		uSeenGeneration = g_Parallel.uGeneration;
+
+		/* the loop may have finished before this thread woke up */
+		pLoop = g_Parallel.pLoop;
+		if( !pLoop ) {
+			continue;
+		}
+
+		++g_Parallel.cActive;
+		teMutexUnlock( &g_Parallel.Lock );
+
+		teRunChunks( pLoop );
+
+		teMutexLock( &g_Parallel.Lock );
+		if( --g_Parallel.cActive == 0 ) {
+			teCondBroadcast( &g_Parallel.Done );
+		}
+	}
+
+	teMutexUnlock( &g_Parallel.Lock );
+	return 0;
+}
+
+/* must be called with g_Parallel.Lock held */
+static void teStartWorkers( void )
+{
+	TenshiUInt32_t i;
+
+	if( !g_Parallel.cWorkers ) {
+		g_Parallel.cWorkers = teGetProcessorCount();
+		if( g_Parallel.cWorkers > TENSHI_PARALLEL_MAX_WORKERS ) {
+			g_Parallel.cWorkers = TENSHI_PARALLEL_MAX_WORKERS;
+		}
+	}
+
+	g_Parallel.bQuit = 0;
+
+	/* the submitting thread is the first worker */
+	for( i = g_Parallel.cThreads; i + 1 < g_Parallel.cWorkers; ++i ) {
+#ifdef _WIN32
+		g_Parallel.Threads[ i ] = CreateThread( NULL, 0, &teWorkerThread_f, NULL, 0, NULL );
+		if( !g_Parallel.Threads[ i ] ) {
+			break;
+		}
+#else
+		if( pthread_create( &g_Parallel.Threads[ i ], NULL, &teWorkerThread_f, NULL ) != 0 ) {
+			break;
+		}
+#endif
+	}
+
+	g_Parallel.cThreads = i;
+}
+static void teStopWorkers( void )
+{
+	TenshiUInt32_t i, cThreads;
+
+	teMutexLock( &g_Parallel.Lock );
+	if( g_Parallel.bBusy ) {
+		teMutexUnlock( &g_Parallel.Lock );
+		return;
+	}
+	cThreads = g_Parallel.cThreads;
+	g_Parallel.cThreads = 0;
+	g_Parallel.bQuit = 1;
+	teCondBroadcast( &g_Parallel.Wake );
+	teMutexUnlock( &g_Parallel.Lock );
+
+	for( i = 0; i < cThreads; ++i ) {
+#ifdef _WIN32
+		WaitForSingleObject( g_Parallel.Threads[ i ], INFINITE );
+		CloseHandle( g_Parallel.Threads[ i ] );
+#else
+		pthread_join( g_Parallel.Threads[ i ], NULL );
+#endif
+	}
+}
+
+TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teGetWorkerCount( void )
+{
+	TenshiUInt32_t cWorkers;
+
+	teMutexLock( &g_Parallel.Lock );
+	if( !g_Parallel.cWorkers ) {
+		g_Parallel.cWorkers = teGetProcessorCount();
+		if( g_Parallel.cWorkers > TENSHI_PARALLEL_MAX_WORKERS ) {
+			g_Parallel.cWorkers = TENSHI_PARALLEL_MAX_WORKERS;
+		}
+	}
+	cWorkers = g_Parallel.cWorkers;
+	teMutexUnlock( &g_Parallel.Lock );
+
+	return cWorkers;
+}
+TENSHI_FUNC void TENSHI_CALL teSetWorkerCount( TenshiUInt32_t cWorkers )
+{
+	if( !cWorkers ) {
+		cWorkers = teGetProcessorCount();
+	}
+	if( cWorkers > TENSHI_PARALLEL_MAX_WORKERS ) {
+		cWorkers = TENSHI_PARALLEL_MAX_WORKERS;
+	}
+
+	/* the workers are restarted with the new count by the next loop */
+	teStopWorkers();
+
+	teMutexLock( &g_Parallel.Lock );
+	if( !g_Parallel.bBusy ) {
+		g_Parallel.cWorkers = cWorkers;
+	}
+	teMutexUnlock( &g_Parallel.Lock );
+}
+
+TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teParallelChunks( TenshiUInt64_t cIterations )
+{
+	TenshiUInt64_t cChunks;
+
+	if( !cIterations ) {
+		return 0;
+	}
+
+	/*
+		plenty of chunks evens out bodies of uneven cost; the count doesn't
+		depend on the workers so reductions (combined per chunk) come out the
+		same no matter how many threads run the loop
+	*/
+	cChunks = TENSHI_PARALLEL_MAX_CHUNKS;
+	if( cChunks > cIterations ) {
+		cChunks = cIterations;
+	}
+
+	return ( TenshiUInt32_t )cChunks;
+}
+/* puts back the starting thread's generator, moved on if the loop drew from it */
+static void teFinishLoopRNG( const TenshiParallelLoop_t *pLoop )
+{
+	g_RNG = pLoop->RNG;
+	if( pLoop->bUsedRNG ) {
+		( void )tePCGRnd( &g_RNG );
+	}
+}
+
+TENSHI_FUNC void TENSHI_CALL teParallelFor( TenshiFnParallelBody_t pfnBody, void *pContext, TenshiUInt64_t cIterations, TenshiUInt32_t cChunks )
+{
+	TenshiParallelLoop_t Loop;
+
+	if( !pfnBody || !cIterations || !cChunks ) {
+		return;
+	}
+
+	Loop.pfnBody = pfnBody;
+	Loop.pContext = pContext;
+	Loop.cIterations = cIterations;
+	Loop.cChunks = cChunks;
+	Loop.uNextChunk = 0;
+	Loop.RNG = g_RNG;
+	Loop.bUsedRNG = 0;
+
+	teMutexLock( &g_Parallel.Lock );
+	if( g_Parallel.bBusy || g_Parallel.cWorkers == 1 || cChunks == 1 ) {
+		teMutexUnlock( &g_Parallel.Lock );
+
+		teRunChunks( &Loop );
+		teFinishLoopRNG( &Loop );
+		return;
+	}
+
+	if( !g_Parallel.cThreads ) {
+		teStartWorkers();
+	}
+
+	g_Parallel.bBusy = 1;
+	g_Parallel.pLoop = &Loop;
+	++g_Parallel.uGeneration;
+	teCondBroadcast( &g_Parallel.Wake );
+	teMutexUnlock( &g_Parallel.Lock );
+
+	teRunChunks( &Loop );
+
+	/* every chunk has been claimed; wait for the ones still running */
+	teMutexLock( &g_Parallel.Lock );
+	g_Parallel.pLoop = NULL;
+	while( g_Parallel.cActive > 0 ) {
+		teCondWait( &g_Parallel.Done, &g_Parallel.Lock );
+	}
+	g_Parallel.bBusy = 0;
+	teMutexUnlock( &g_Parallel.Lock );
+
+	teFinishLoopRNG( &Loop );
+}
+
+/*
+	a serialized function can run a PARALLEL FOR of its own, which runs on the
+	same thread and serializes its own calls, so the lock nests per thread
+*/
+static THREAD_LOCAL TenshiUInt32_t g_cCallLocks = 0;
+
+TENSHI_FUNC void TENSHI_CALL teParallelLock( void )
+{
+	if( g_cCallLocks++ == 0 ) {
+		teMutexLock( &g_Parallel.CallLock );
+	}
+}
+TENSHI_FUNC void TENSHI_CALL teParallelUnlock( void )
+{
+	if( --g_cCallLocks == 0 ) {
+		teMutexUnlock( &g_Parallel.CallLock );
+	}
+}
+
+TENSHI_FUNC TenshiUInt64_t TENSHI_CALL tePerfTimer( void )
+{
+#ifdef _WIN32
+	static LARGE_INTEGER Freq;
+	LARGE_INTEGER Counter;
+
+	if( !Freq.QuadPart ) {
+		QueryPerformanceFrequency( &Freq );
+	}
+	QueryPerformanceCounter( &Counter );
+
+	return ( TenshiUInt64_t )( Counter.QuadPart/Freq.QuadPart*1000000 + Counter.QuadPart%Freq.QuadPart*1000000/Freq.QuadPart );
+#else
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ( TenshiUInt64_t )ts.tv_sec*1000000 + ( TenshiUInt64_t )ts.tv_nsec/1000;
+#endif
+}
 
 
 /*
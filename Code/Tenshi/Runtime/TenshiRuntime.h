@@ -13,6 +13,7 @@
 #define TENSHI_MEMTAG_STRING        1
 #define TENSHI_MEMTAG_MEMBLOCK      2
 #define TENSHI_MEMTAG_RNG           3
+#define TENSHI_MEMTAG_MAP           4
 
 #ifndef TENSHI_MEMTAG
 # define TENSHI_MEMTAG              TENSHI_MEMTAG_DEFAULT
@@ -34,8 +35,12 @@ struct TenshiArray_s;
 struct TenshiString_s;
 struct TenshiList_s;
 struct TenshiListItem_s;
+struct TenshiListSlab_s;
 struct TenshiBTree_s;
 struct TenshiBTreeNode_s;
+struct TenshiMap_s;
+struct TenshiMapIndex_s;
+struct TenshiMapEntry_s;
 struct TenshiObjectPool_s;
 struct TenshiMemblock_s;
 struct TenshiReport_s;
@@ -72,8 +77,12 @@ typedef struct TenshiArray_s        TenshiArray_t;
 typedef struct TenshiString_s       TenshiString_t;
 typedef struct TenshiList_s         TenshiList_t;
 typedef struct TenshiListItem_s     TenshiListItem_t;
+typedef struct TenshiListSlab_s     TenshiListSlab_t;
 typedef struct TenshiBTree_s        TenshiBTree_t;
 typedef struct TenshiBTreeNode_s    TenshiBTreeNode_t;
+typedef struct TenshiMap_s          TenshiMap_t;
+typedef struct TenshiMapIndex_s     TenshiMapIndex_t;
+typedef struct TenshiMapEntry_s     TenshiMapEntry_t;
 typedef struct TenshiObjectPool_s   TenshiObjectPool_t;
 typedef struct TenshiMemblock_s     TenshiMemblock_t;
 typedef struct TenshiReport_s       TenshiReport_t;
@@ -119,6 +128,13 @@ typedef struct TenshiChecklistItem_s TenshiChecklistItem_t;
 #ifndef TENSHI_FUNC
 # define TENSHI_FUNC                TENSHI_EXTRNC TENSHI_IMPORT
 #endif
+#ifndef TENSHI_DATA
+# ifdef __cplusplus
+#  define TENSHI_DATA               TENSHI_EXTRNC TENSHI_IMPORT
+# else
+#  define TENSHI_DATA               extern TENSHI_IMPORT
+# endif
+#endif
 
 #ifndef TENSHI_SELECTANY
 # if defined( _WIN32 ) || defined( _MSC_VER )
@@ -217,7 +233,7 @@ typedef enum TenshiReportFacility_e
 	kTenshiLog_CoreRT_Array         = 0x0038,
 	/* TenshiRuntime.c (linked-list management) */
 	kTenshiLog_CoreRT_List          = 0x0040,
-	/* TenshiRuntime.c (binary-tree management) */
+	/* TenshiRuntime.c (binary-tree and hash map management) */
 	kTenshiLog_CoreRT_BTree         = 0x0048,
 
 	/* Memory-Block API :: Used for more securely managing memory */
@@ -559,7 +575,7 @@ struct TenshiLoggingAPI_s
 	TenshiUInt32_t                  DefaultFlags;
 };
 
-#define TENSHI_RTGLOB_VERSION       150306
+#define TENSHI_RTGLOB_VERSION       261019
 struct TenshiRuntimeGlob_s
 {
 	TenshiUInt32_t                  uRuntimeVersion;
@@ -587,6 +603,9 @@ struct TenshiRuntimeGlob_s
 
 	struct TenshiMemblockAPI_s *    pMemblockAPI;
 	struct TenshiLoggingAPI_s *     pLoggingAPI;
+
+	/* number of loop iterations between calls to pfnSafeSyncCallback */
+	TenshiUInt32_t                  cSyncInterval;
 };
 
 #define TENSHI_TYPE_INT8            ((TenshiType_t*)1)
@@ -632,6 +651,45 @@ struct TenshiTypeObject_s
 #define TENSHI_ARRAY_MAX_DIMENSIONS 9
 #define TENSHI_ARRAY_INVALID_INDEX  ( ~( TenshiUIntPtr_t )0 )
 
+/* type of the key teArraySort() orders items by, and of the items teArrayReduce() and teArrayFind() read */
+typedef enum TenshiSortKey_e
+{
+	kTenshiSortKey_Int8,
+	kTenshiSortKey_Int16,
+	kTenshiSortKey_Int32,
+	kTenshiSortKey_Int64,
+	kTenshiSortKey_UInt8,
+	kTenshiSortKey_UInt16,
+	kTenshiSortKey_UInt32,
+	kTenshiSortKey_UInt64,
+	kTenshiSortKey_Float32,
+	kTenshiSortKey_Float64,
+	/* a string object (char *, null being empty) */
+	kTenshiSortKey_String,
+
+	kTenshiNumSortKeys
+} TenshiSortKey_t;
+
+typedef enum TenshiSortFlag_e
+{
+	/* largest key first */
+	kTenshiSortF_Descending         = 0x01,
+	/* items with equal keys keep their order */
+	kTenshiSortF_Stable             = 0x02
+} TenshiSortFlag_t;
+
+/* what teArrayReduce() computes */
+typedef enum TenshiArrayReduce_e
+{
+	/* as an int64 for signed integers, uint64 for unsigned, or float64 */
+	kTenshiArrayReduce_Sum,
+	/* as the item's own type (a new string for strings) */
+	kTenshiArrayReduce_Min,
+	kTenshiArrayReduce_Max,
+
+	kTenshiNumArrayReduces
+} TenshiArrayReduce_t;
+
 /*
  *  ARRAY [COLLECTION]
  *  =====
@@ -661,7 +719,21 @@ struct TenshiArray_s
  *  ===========
  *  This is the data structure for the base of a linked list. It references list
  *  items, which it can manipulate.
+ *
+ *  Items are carved out of slabs owned by the list (each twice the size of the
+ *  last) so that neighbouring items tend to be neighbours in memory. Removed
+ *  items are reused by later insertions; the slabs are only released when the
+ *  list is emptied or deleted. Items never move, so pointers to them stay valid
+ *  until they're removed.
+ *
+ *  Every TENSHI_LIST_INDEX_STRIDE-th item is recorded in an index, so reaching
+ *  an item by its position walks at most half a stride from a recorded one (or
+ *  from the last item reached by position, whichever is closer). Adding or
+ *  removing items at the back keeps the index up to date; other changes mark it
+ *  stale, and it's rebuilt by the next access by position.
  */
+#define TENSHI_LIST_INDEX_STRIDE    64
+
 struct TenshiList_s
 {
 	/* points to the first item in the list */
@@ -682,12 +754,35 @@ struct TenshiList_s
 	TenshiUIntPtr_t                 uCachedIndex;
 	/* pointer to the currently cached item */
 	TenshiListItem_t *              pCachedIndex;
+
+	/* slabs the items are allocated from (newest first) */
+	TenshiListSlab_t *              pSlabs;
+	/* removed items, available for reuse (linked through pNext) */
+	TenshiListItem_t *              pFreeItems;
+	/* next never-used item of the newest slab, and how many are left there */
+	TenshiUInt8_t *                 pSlabCursor;
+	TenshiUIntPtr_t                 cSlabItemsLeft;
+	/* bytes from one item (header included) to the next within a slab */
+	TenshiUIntPtr_t                 cItemStride;
+
+	/* every TENSHI_LIST_INDEX_STRIDE-th item, from the first */
+	TenshiListItem_t **             ppIndex;
+	TenshiUIntPtr_t                 cIndexItems;
+	TenshiUIntPtr_t                 cMaxIndexItems;
+	/* set when items were added or removed anywhere but the back */
+	TenshiBoolean_t                 bIndexStale;
 };
 struct TenshiListItem_s
 {
 	TenshiListItem_t *              pPrev;
 	TenshiListItem_t *              pNext;
 };
+struct TenshiListSlab_s
+{
+	TenshiListSlab_t *              pNext;
+	/* number of items the slab holds */
+	TenshiUIntPtr_t                 cItems;
+};
 
 /*
  *  BINARY TREE [COLLECTION]
@@ -717,6 +812,63 @@ struct TenshiBTreeNode_s
 	TenshiBTreeNode_t *             pNext;
 };
 
+/*
+ *  HASH MAP [COLLECTION]
+ *  ========
+ *  Associative array keyed on strings or integers (both can be used in the
+ *  same map). Entries are kept in the order they were added, and looked up
+ *  through an open-addressing index with one control byte per slot: the low
+ *  seven bits of the key's hash for a used slot, or TENSHI_MAP_CTRL_EMPTY /
+ *  TENSHI_MAP_CTRL_ERASED. The control bytes are probed a group at a time.
+ *
+ *  When the index gets too full a larger one is started, and the slots of
+ *  the old one are moved over a few at a time by each following insertion
+ *  or erasure (lookups search both until the old one is empty).
+ */
+#define TENSHI_MAP_GROUP_SLOTS      16
+#define TENSHI_MAP_CTRL_EMPTY       0x80
+#define TENSHI_MAP_CTRL_ERASED      0xFE
+
+struct TenshiMapIndex_s
+{
+	/* one control byte per slot */
+	TenshiUInt8_t *                 pCtrl;
+	/* index of the entry each used slot refers to */
+	TenshiUInt32_t *                pSlots;
+	/* number of slots (a power of two; at least one group) */
+	TenshiUInt32_t                  cSlots;
+	/* number of slots that aren't empty (used or erased) */
+	TenshiUInt32_t                  cUsed;
+};
+struct TenshiMapEntry_s
+{
+	TenshiUInt64_t                  uHash;
+	/* copy of the key for string keys (NULL for integer keys) */
+	char *                          pszKey;
+	TenshiInt64_t                   iKey;
+
+	/* string value (NULL if the value is an integer) */
+	char *                          pszValue;
+	TenshiInt64_t                   iValue;
+
+	TenshiBoolean_t                 bErased;
+};
+struct TenshiMap_s
+{
+	/* entries in the order they were added (erased ones stay until compacted) */
+	TenshiMapEntry_t *              pEntries;
+	TenshiUInt32_t                  cEntries;
+	TenshiUInt32_t                  cMaxEntries;
+	/* number of entries that haven't been erased */
+	TenshiUInt32_t                  cLive;
+
+	TenshiMapIndex_t                Index;
+	/* index being replaced by Index (pCtrl is NULL if there isn't one) */
+	TenshiMapIndex_t                OldIndex;
+	/* number of OldIndex slots that have been moved to Index */
+	TenshiUInt32_t                  uMigrated;
+};
+
 /*
  *  MEMORY BLOCK
  *  ============
@@ -756,11 +908,24 @@ struct TenshiChecklistItem_s
 TENSHI_FUNC TenshiRuntimeGlob_t *TENSHI_CALL teGetGlob( void );
 
 TENSHI_FUNC void *TENSHI_CALL teAlloc( TenshiUIntPtr_t cBytes, int Memtag );
+TENSHI_FUNC void *TENSHI_CALL teRealloc( void *pData, TenshiUIntPtr_t cBytes, int Memtag );
 TENSHI_FUNC void TENSHI_CALL teDealloc( void *pData );
 
 TENSHI_FUNC void TENSHI_CALL teAutoprint( const char *pszText );
 TENSHI_FUNC int TENSHI_CALL teSafeSync( void );
 
+/*
+	Generated loops count down from this in a register of their own and only
+	call teSafeSync() once they reach zero. teSafeSync() resets it from
+	cSyncInterval, so a new interval takes effect after the next sync. The
+	register is written back when the function returns or calls another of
+	the program's functions, and reloaded after such a call, so the host can
+	zero this to have a loop sync at its next chance.
+	Within a PARALLEL FOR body teSafeSync() doesn't call the host and just
+	returns 1.
+*/
+TENSHI_DATA TenshiInt32_t teSyncCountdown;
+
 TENSHI_FUNC void TENSHI_CALL tePrintChunk( const char *pszText );
 TENSHI_FUNC void TENSHI_CALL tePrintLine( const char *pszText );
 
@@ -797,6 +962,7 @@ TENSHI_FUNC char *TENSHI_CALL teStrReclaim( char *s );
 
 TENSHI_FUNC char *TENSHI_CALL teStrDup( const char *s );
 TENSHI_FUNC char *TENSHI_CALL teStrConcat( const char *a, const char *b );
+TENSHI_FUNC char *TENSHI_CALL teStrAppend( char *a, const char *b );
 TENSHI_FUNC char *TENSHI_CALL teStrFindRm( const char *a, const char *b );
 TENSHI_FUNC char *TENSHI_CALL teStrRepeat( const char *s, TenshiUIntPtr_t n );
 TENSHI_FUNC char *TENSHI_CALL teStrCatDir( const char *a, const char *b );
@@ -836,6 +1002,7 @@ TENSHI_FUNC int TENSHI_CALL teStr_SortCmp( const char *a, const char *b );
 TENSHI_FUNC int TENSHI_CALL teStr_SortCmpCase( const char *a, const char *b );
 TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teStrEq( const char *a, const char *b );
 TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teStrEqCase( const char *a, const char *b );
+TENSHI_FUNC TenshiUInt64_t TENSHI_CALL teStrHash( const char *s, TenshiUInt32_t seed );
 
 TENSHI_FUNC char *TENSHI_CALL teStr_Left( const char *s, TenshiIntPtr_t n );
 TENSHI_FUNC char *TENSHI_CALL teStr_Mid( const char *s, TenshiIntPtr_t pos );
@@ -887,6 +1054,7 @@ TENSHI_FUNC TenshiType_t *TENSHI_CALL teFixType( TenshiType_t *p );
 TENSHI_FUNC void *TENSHI_CALL teArrayUndim( void *pArrayData );
 TENSHI_FUNC void *TENSHI_CALL teArrayDim( const TenshiUIntPtr_t *pDimensions, TenshiUIntPtr_t cDimensions, TenshiType_t *pItemType );
 TENSHI_FUNC void *TENSHI_CALL teArrayRedim( void *pOldArrayData, const TenshiUIntPtr_t *pDimensions, TenshiUIntPtr_t cDimensions, TenshiType_t *pItemType );
+TENSHI_FUNC void *TENSHI_CALL teArrayCopy( const void *pSrcArrayData );
 
 TENSHI_FUNC void *TENSHI_CALL teArrayInsertElements( void *pArrayData, TenshiUIntPtr_t uBefore, const void *pItems, TenshiUIntPtr_t cItems );
 TENSHI_FUNC void TENSHI_CALL teArrayDeleteElements( void *pArrayData, TenshiUIntPtr_t uFirst, TenshiUIntPtr_t cDeletes );
@@ -924,6 +1092,18 @@ TENSHI_FUNC void TENSHI_CALL teRemoveFromQueue( void *pArrayData );
 TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teArrayCurrentIndex( const void *pArrayData );
 TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teArrayDimensionLen( const void *pArrayData, TenshiUIntPtr_t uDim );
 
+/* called by generated code when a subscript fails its bounds check */
+TENSHI_FUNC void TENSHI_CALL teArrayIndexError( const void *pArrayData, TenshiUIntPtr_t uDim, TenshiUIntPtr_t uIndex );
+
+/* sort all items (in memory order) by the key at uKeyOffset bytes into each */
+TENSHI_FUNC void TENSHI_CALL teArraySort( void *pArrayData, TenshiUIntPtr_t uKeyOffset, TenshiUInt32_t KeyType, TenshiUInt32_t Flags );
+
+/* bulk operations on items in memory order; ranges are clipped to the array */
+TENSHI_FUNC void TENSHI_CALL teArrayFill( void *pArrayData, const void *pValue, TenshiUIntPtr_t uFirst, TenshiUIntPtr_t cItems );
+TENSHI_FUNC void TENSHI_CALL teArrayCopyItems( void *pDstArrayData, TenshiUIntPtr_t uDstFirst, const void *pSrcArrayData, TenshiUIntPtr_t uSrcFirst, TenshiUIntPtr_t cItems );
+TENSHI_FUNC void TENSHI_CALL teArrayReduce( const void *pArrayData, TenshiUInt32_t ValueType, TenshiUInt32_t Op, void *pResult );
+TENSHI_FUNC TenshiIntPtr_t TENSHI_CALL teArrayFind( const void *pArrayData, TenshiUInt32_t ValueType, const void *pValue, TenshiUIntPtr_t uFirst );
+
 
 /*
  *  LINKED LIST FUNCTIONS
@@ -1025,6 +1205,43 @@ TENSHI_FUNC void *TENSHI_CALL teBTreeBack( TenshiBTree_t *pBase );
 TENSHI_FUNC void *TENSHI_CALL teBTreePrevious( void *pItem );
 TENSHI_FUNC void *TENSHI_CALL teBTreeNext( void *pItem );
 
+/*
+ *  HASH MAP FUNCTIONS
+ */
+
+TENSHI_FUNC void *TENSHI_CALL teMapAlloc_f( void *pParm );
+TENSHI_FUNC void TENSHI_CALL teMapDealloc_f( void *p );
+
+TENSHI_FUNC TenshiIndex_t TENSHI_CALL teAllocMap( void );
+TENSHI_FUNC void TENSHI_CALL teMakeMap( TenshiIndex_t MapNumber );
+TENSHI_FUNC TenshiIndex_t TENSHI_CALL teDeleteMap( TenshiIndex_t MapNumber );
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapExist( TenshiIndex_t MapNumber );
+
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teMapCount( TenshiIndex_t MapNumber );
+TENSHI_FUNC void TENSHI_CALL teMapClear( TenshiIndex_t MapNumber );
+
+TENSHI_FUNC void TENSHI_CALL teMapInsertStr( TenshiIndex_t MapNumber, const char *pszKey, TenshiInt64_t iValue );
+TENSHI_FUNC void TENSHI_CALL teMapInsertInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey, TenshiInt64_t iValue );
+TENSHI_FUNC void TENSHI_CALL teMapInsertStrStr( TenshiIndex_t MapNumber, const char *pszKey, const char *pszValue );
+TENSHI_FUNC void TENSHI_CALL teMapInsertIntStr( TenshiIndex_t MapNumber, TenshiInt64_t iKey, const char *pszValue );
+
+TENSHI_FUNC TenshiInt64_t TENSHI_CALL teMapFindStr( TenshiIndex_t MapNumber, const char *pszKey );
+TENSHI_FUNC TenshiInt64_t TENSHI_CALL teMapFindInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey );
+TENSHI_FUNC char *TENSHI_CALL teMapFindStrStr( TenshiIndex_t MapNumber, const char *pszKey );
+TENSHI_FUNC char *TENSHI_CALL teMapFindIntStr( TenshiIndex_t MapNumber, TenshiInt64_t iKey );
+
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapHasStr( TenshiIndex_t MapNumber, const char *pszKey );
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapHasInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey );
+
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapEraseStr( TenshiIndex_t MapNumber, const char *pszKey );
+TENSHI_FUNC TenshiBoolean_t TENSHI_CALL teMapEraseInt( TenshiIndex_t MapNumber, TenshiInt64_t iKey );
+
+/* FOREACH: positions start at 1; 0 means there are no more entries */
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teMapIterFirst( TenshiIndex_t MapNumber );
+TENSHI_FUNC TenshiUIntPtr_t TENSHI_CALL teMapIterNext( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos );
+TENSHI_FUNC TenshiInt64_t TENSHI_CALL teMapIterIntKey( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos );
+TENSHI_FUNC char *TENSHI_CALL teMapIterStrKey( TenshiIndex_t MapNumber, TenshiUIntPtr_t uPos );
+
 /*
  *  MEMBLOCK FUNCTIONS
  */
@@ -1081,6 +1298,7 @@ TENSHI_FUNC float TENSHI_CALL teSq( float x );
 TENSHI_FUNC float TENSHI_CALL teSqrt( float x );
 TENSHI_FUNC float TENSHI_CALL teAbs( float x );
 TENSHI_FUNC float TENSHI_CALL teExp( float x );
+TENSHI_FUNC float TENSHI_CALL teLog( float x );
 TENSHI_FUNC float TENSHI_CALL teFloor( float x );
 TENSHI_FUNC float TENSHI_CALL teCeil( float x );
 TENSHI_FUNC float TENSHI_CALL teRound( float x );
@@ -1140,6 +1358,28 @@ TENSHI_FUNC float TENSHI_CALL teGrad( TenshiInt32_t n, float x );
 TENSHI_FUNC float TENSHI_CALL teNoise( float x );
 TENSHI_FUNC float TENSHI_CALL teCellNoise( float x );
 
+/* functions teMathBatch() applies to each value (SIN and COS take degrees) */
+typedef enum TenshiMathBatch_e {
+	kTenshiMathBatch_Sin,
+	kTenshiMathBatch_Cos,
+	kTenshiMathBatch_Sqrt,
+	kTenshiMathBatch_Exp,
+	kTenshiMathBatch_Log,
+	kTenshiMathBatch_Noise,
+
+	kTenshiNumMathBatches
+} TenshiMathBatch_t;
+/* flags of teMathBatch() */
+typedef enum TenshiMathBatchFlag_e {
+	/* same results as teSin() etc., rather than the faster SSE2 versions */
+	kTenshiMathBatchF_Precise = 0x01
+} TenshiMathBatchFlag_t;
+
+/* pDst may be pSrc, but the two mustn't otherwise overlap */
+TENSHI_FUNC void TENSHI_CALL teMathBatch( float *pDst, const float *pSrc, TenshiUIntPtr_t cValues, TenshiUInt32_t Func, TenshiUInt32_t Flags );
+/* as teMathBatch(), over as many items as both FLOAT arrays have */
+TENSHI_FUNC void TENSHI_CALL teArrayMath( void *pDstArrayData, const void *pSrcArrayData, TenshiUInt32_t Func, TenshiUInt32_t Flags );
+
 /*
  *  RANDOM NUMBER
  */
@@ -1154,6 +1394,27 @@ TENSHI_FUNC void TENSHI_CALL tePCGRandomize( TenshiPCGState_t *r, TenshiUInt32_t
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL tePCGRnd( TenshiPCGState_t *r );
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL tePCGBoundedRnd( TenshiPCGState_t *r, TenshiUInt32_t bound );
 TENSHI_FUNC TenshiInt32_t TENSHI_CALL tePCGRangedRnd( TenshiPCGState_t *r, TenshiInt32_t lowBound, TenshiInt32_t highBound );
+/* skips delta values (in a few dozen steps, however large delta is) */
+TENSHI_FUNC void TENSHI_CALL tePCGAdvance( TenshiPCGState_t *r, TenshiUInt64_t delta );
+/* pSrc moved on by uStream*2^40 values: streams that won't overlap */
+TENSHI_FUNC void TENSHI_CALL tePCGSplit( TenshiPCGState_t *pDst, const TenshiPCGState_t *pSrc, TenshiUInt64_t uStream );
+
+/* what tePCGFill() stores for each value */
+typedef enum TenshiRndFill_e {
+	/* DWORDs, as from tePCGRnd() */
+	kTenshiRndFill_Bits32,
+	/* INTEGERs from Low up to (not including) High, from two values each */
+	kTenshiRndFill_Int32,
+	/* FLOATs from Low to High */
+	kTenshiRndFill_Float32,
+	/* DOUBLEs from Low to High, from two values each */
+	kTenshiRndFill_Float64,
+
+	kTenshiNumRndFills
+} TenshiRndFill_t;
+
+/* the same values in any number of threads, with r left after them; pDst needn't be aligned */
+TENSHI_FUNC void TENSHI_CALL tePCGFill( TenshiPCGState_t *r, void *pDst, TenshiUIntPtr_t cValues, TenshiUInt32_t Kind, double Low, double High );
 
 TENSHI_FUNC void *TENSHI_CALL teRNGAlloc_f( void *pParm );
 TENSHI_FUNC void TENSHI_CALL teRNGDealloc_f( void *p );
@@ -1167,11 +1428,52 @@ TENSHI_FUNC void TENSHI_CALL teRandomizeRNG( TenshiIndex_t RNGNumber, TenshiUInt
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teRNGGenerate( TenshiIndex_t RNGNumber );
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teRNGBoundedGenerate( TenshiIndex_t RNGNumber, TenshiUInt32_t bound );
 TENSHI_FUNC TenshiInt32_t TENSHI_CALL teRNGRangedGenerate( TenshiIndex_t RNGNumber, TenshiInt32_t lowBound, TenshiInt32_t highBound );
+TENSHI_FUNC void TENSHI_CALL teRNGAdvance( TenshiIndex_t RNGNumber, TenshiUInt64_t delta );
+TENSHI_FUNC void TENSHI_CALL teRNGSplit( TenshiIndex_t DstRNGNumber, TenshiIndex_t SrcRNGNumber, TenshiUInt32_t uStream );
 
 TENSHI_FUNC void TENSHI_CALL teRandomize( TenshiUInt32_t seedval );
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teRnd( void );
 TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teRndBounded( TenshiUInt32_t bound );
 TENSHI_FUNC TenshiInt32_t TENSHI_CALL teRndRanged( TenshiInt32_t lowBound, TenshiInt32_t highBound );
+TENSHI_FUNC void TENSHI_CALL teRndAdvance( TenshiUInt64_t delta );
+
+/* RNGNumber 0 is the calling thread's default generator */
+TENSHI_FUNC void TENSHI_CALL teArrayRandomize( void *pArrayData, TenshiIndex_t RNGNumber, TenshiUInt32_t Kind, double Low, double High );
+TENSHI_FUNC void TENSHI_CALL teFillMemblockRnd( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues );
+TENSHI_FUNC void TENSHI_CALL teFillMemblockRndRanged( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues, TenshiInt32_t lowBound, TenshiInt32_t highBound );
+TENSHI_FUNC void TENSHI_CALL teFillMemblockRndFloat( TenshiIndex_t MemblockNumber, TenshiUIntPtr_t uPos, TenshiUIntPtr_t cValues, float Low, float High );
+
+/*
+ *  PARALLEL LOOPS
+ */
+
+/* upper bound on worker threads (matches kMaxWorkers of the AxLibs scheduler) */
+#ifndef TENSHI_PARALLEL_MAX_WORKERS
+# define TENSHI_PARALLEL_MAX_WORKERS 64
+#endif
+/* upper bound on the chunks a loop is split into (the compiler relies on this) */
+#define TENSHI_PARALLEL_MAX_CHUNKS  256
+
+/* runs iterations [iFirst, iLast) of a PARALLEL FOR as chunk number uChunk */
+typedef void( TENSHI_CALL *TenshiFnParallelBody_t )( void *pContext, TenshiUInt32_t uChunk, TenshiInt64_t iFirst, TenshiInt64_t iLast );
+
+TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teGetWorkerCount( void );
+TENSHI_FUNC void TENSHI_CALL teSetWorkerCount( TenshiUInt32_t cWorkers );
+
+TENSHI_FUNC TenshiUInt32_t TENSHI_CALL teParallelChunks( TenshiUInt64_t cIterations );
+TENSHI_FUNC void TENSHI_CALL teParallelFor( TenshiFnParallelBody_t pfnBody, void *pContext, TenshiUInt64_t cIterations, TenshiUInt32_t cChunks );
+
+TENSHI_FUNC void TENSHI_CALL teParallelLock( void );
+TENSHI_FUNC void TENSHI_CALL teParallelUnlock( void );
+
+TENSHI_FUNC TenshiUInt64_t TENSHI_CALL tePerfTimer( void );
+
+/*
+ *  MODULES
+ */
+
+/* runs the init function of the module owning *pState if it hasn't run yet */
+TENSHI_FUNC void TENSHI_CALL teInitModule( TenshiUIntPtr_t *pState );
 
 #endif /*TENSHI_STATIC_LINK_ENABLED*/
 
@@ -1871,6 +2173,7 @@ namespace Tenshi
 #define TE_ERR_EXISTS               2
 #define TE_ERR_BADALLOC             3
 #define TE_ERR_INVALID              4
+#define TE_ERR_ARRAYBOUNDS          5
 
 #define TE_ERR_FS_DIRUNUSED         101
 #define TE_ERR_FS_FILEUNUSED        102
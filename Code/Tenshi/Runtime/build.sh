@@ -1,6 +1,6 @@
 #!/bin/sh
 
-CFLAGS="-W -Wall -pedantic -std=gnu99 -c"
+CFLAGS="-W -Wall -pedantic -std=gnu99 -ffunction-sections -fdata-sections -c"
 CFLAGS_DEBUG="-g -D_DEBUG -DTRACE_ENABLED=0"
 
 RTBINDIR="../../../Build/Bin64"